@@ -0,0 +1,431 @@
+/**
+ * @purpose the benchmark runner: argument parsing, timing, statistics, output and baseline comparison
+ * usage: gf3d_bench [--filter text] [--runs n] [--warmup n] [--format table|csv|json] [--output file]
+ *                   [--baseline file.csv] [--threshold percent] [--list]
+ * --output takes its format from a .csv or .json extension, a baseline is any CSV it wrote
+ * exits 1 if a result check failed, a case got slower than the baseline by more than the threshold, or anything
+ * tracked by gf3d_memory was still allocated once every system and benchmark had cleaned up at exit
+ */
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#define GF3D_BENCH_NULL "NUL"
+#else
+#include <unistd.h>
+#define GF3D_BENCH_NULL "/dev/null"
+#endif
+
+#include "gf3d_bench.h"
+#include "simple_logger.h"
+#include "gf3d_memory.h"
+#include "gf3d_jobs.h"
+
+#define GF3D_BENCH_MAX_CASES    256
+#define GF3D_BENCH_NAME         128
+
+typedef enum
+{
+    BF_Table = 0,
+    BF_CSV,
+    BF_JSON
+}BenchFormat;
+
+typedef struct
+{
+    char            name[GF3D_BENCH_NAME];
+    Uint32          items;
+    BenchRun        prepare;
+    BenchRun        run;
+    int             param;
+    Bool            selected;
+    double          minNs;          /**<all timings are nanoseconds per item*/
+    double          medianNs;
+    double          p90Ns;
+    double          p99Ns;
+    double          meanNs;
+    double          baselineNs;     /**<median of the same case in the baseline, 0 if it has none*/
+}BenchCase;
+
+typedef struct
+{
+    BenchCase       cases[GF3D_BENCH_MAX_CASES];
+    Uint32          caseCount;
+    Uint32          runs;
+    Uint32          warmup;
+    const char     *filter;
+    BenchFormat     format;
+    const char     *output;
+    const char     *baseline;
+    double          threshold;      /**<percent slower than the baseline that counts as a regression*/
+    Bool            list;
+    Uint32          failures;
+    int             savedStdout;    /**<-1 unless stdout is muted*/
+}BenchManager;
+
+static BenchManager gf3d_bench = {0};
+
+void gf3d_bench_add(const char *name,Uint32 items,BenchRun prepare,BenchRun run,int param)
+{
+    BenchCase *c;
+    if ((!name)||(!run)||(!items))return;
+    if (gf3d_bench.caseCount >= GF3D_BENCH_MAX_CASES)
+    {
+        printf("too many benchmark cases, %s dropped\n",name);
+        return;
+    }
+    c = &gf3d_bench.cases[gf3d_bench.caseCount++];
+    memset(c,0,sizeof(BenchCase));
+    snprintf(c->name,GF3D_BENCH_NAME,"%s",name);
+    c->items = items;
+    c->prepare = prepare;
+    c->run = run;
+    c->param = param;
+    c->selected = ((!gf3d_bench.filter)||(strstr(name,gf3d_bench.filter) != NULL));
+}
+
+void gf3d_bench_fail(const char *name,const char *detail)
+{
+    printf("CHECK FAILED %s: %s\n",name,detail);
+    gf3d_bench.failures++;
+}
+
+void gf3d_bench_mute_stdout(Bool mute)
+{
+    FILE *discard;
+    slog_sync();    // the logger writes from its own thread, settle what it has before switching
+    fflush(stdout);
+    if ((mute)&&(gf3d_bench.savedStdout < 0))
+    {
+        discard = fopen(GF3D_BENCH_NULL,"w");
+        if (!discard)return;
+        gf3d_bench.savedStdout = dup(fileno(stdout));
+        dup2(fileno(discard),fileno(stdout));
+        fclose(discard);
+    }
+    else if ((!mute)&&(gf3d_bench.savedStdout >= 0))
+    {
+        dup2(gf3d_bench.savedStdout,fileno(stdout));
+        close(gf3d_bench.savedStdout);
+        gf3d_bench.savedStdout = -1;
+    }
+}
+
+/**
+ * TIMING
+ */
+
+int gf3d_bench_compare_double(const void *a,const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+ * @brief nearest rank percentile of sorted samples
+ */
+double gf3d_bench_percentile(double *sorted,Uint32 count,double percent)
+{
+    Sint32 rank = (Sint32)ceil(percent / 100.0 * count) - 1;
+    if (rank < 0)rank = 0;
+    if (rank >= count)rank = count - 1;
+    return sorted[rank];
+}
+
+void gf3d_bench_run_case(BenchCase *c,double *samples)
+{
+    int i;
+    Uint64 start;
+    double sum = 0;
+    double frequency = (double)SDL_GetPerformanceFrequency();
+
+    for (i = 0; i < gf3d_bench.warmup; i++)
+    {
+        if (c->prepare)c->prepare(c->param);
+        c->run(c->param);
+    }
+    for (i = 0; i < gf3d_bench.runs; i++)
+    {
+        if (c->prepare)c->prepare(c->param);
+        start = SDL_GetPerformanceCounter();
+        c->run(c->param);
+        samples[i] = (double)(SDL_GetPerformanceCounter() - start) * 1000000000.0 / frequency / c->items;
+        sum += samples[i];
+    }
+    gf3d_bench_mute_stdout(false);  // in case the case muted it
+    qsort(samples,gf3d_bench.runs,sizeof(double),gf3d_bench_compare_double);
+    c->minNs = samples[0];
+    c->medianNs = gf3d_bench_percentile(samples,gf3d_bench.runs,50);
+    c->p90Ns = gf3d_bench_percentile(samples,gf3d_bench.runs,90);
+    c->p99Ns = gf3d_bench_percentile(samples,gf3d_bench.runs,99);
+    c->meanNs = sum / gf3d_bench.runs;
+}
+
+/**
+ * BASELINE
+ */
+
+/**
+ * @brief read the medians of a CSV written by --format csv into the matching cases
+ * @return false if the file cannot be read
+ */
+Bool gf3d_bench_baseline_load(const char *filename)
+{
+    int i;
+    FILE *file;
+    char line[512];
+    char name[GF3D_BENCH_NAME];
+    double median;
+    file = fopen(filename,"r");
+    if (!file)
+    {
+        printf("failed to open baseline %s\n",filename);
+        return false;
+    }
+    while (fgets(line,sizeof(line),file))
+    {
+        // name,items,runs,min_ns,median_ns,...
+        if (sscanf(line,"%127[^,],%*u,%*u,%*f,%lf",name,&median) != 2)continue;
+        for (i = 0; i < gf3d_bench.caseCount; i++)
+        {
+            if (strcmp(gf3d_bench.cases[i].name,name) == 0)gf3d_bench.cases[i].baselineNs = median;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief print how every case did against the baseline
+ * @return how many cases regressed beyond the threshold
+ */
+Uint32 gf3d_bench_baseline_compare()
+{
+    int i;
+    double change;
+    Uint32 regressions = 0;
+    BenchCase *c;
+    printf("\n%-44s %12s %12s %9s\n","compared to baseline","baseline ns","median ns","change");
+    for (i = 0; i < gf3d_bench.caseCount; i++)
+    {
+        c = &gf3d_bench.cases[i];
+        if (!c->selected)continue;
+        if (c->baselineNs <= 0)
+        {
+            printf("%-44s %12s %12.3f %9s\n",c->name,"-",c->medianNs,"new");
+            continue;
+        }
+        change = (c->medianNs - c->baselineNs) * 100.0 / c->baselineNs;
+        printf("%-44s %12.3f %12.3f %+8.1f%%%s\n",c->name,c->baselineNs,c->medianNs,change,(change > gf3d_bench.threshold)?"  REGRESSION":"");
+        if (change > gf3d_bench.threshold)regressions++;
+    }
+    return regressions;
+}
+
+/**
+ * OUTPUT
+ */
+
+void gf3d_bench_write(FILE *out,BenchFormat format)
+{
+    int i;
+    Bool first = true;
+    BenchCase *c;
+    switch (format)
+    {
+        case BF_Table:
+            fprintf(out,"%-44s %10s %10s %10s %10s %10s\n","case (ns per item)","min","median","p90","p99","mean");
+            break;
+        case BF_CSV:
+            fprintf(out,"name,items,runs,min_ns,median_ns,p90_ns,p99_ns,mean_ns\n");
+            break;
+        case BF_JSON:
+            fprintf(out,"{\n  \"runs\": %u,\n  \"warmup\": %u,\n  \"cases\": [\n",gf3d_bench.runs,gf3d_bench.warmup);
+            break;
+    }
+    for (i = 0; i < gf3d_bench.caseCount; i++)
+    {
+        c = &gf3d_bench.cases[i];
+        if (!c->selected)continue;
+        switch (format)
+        {
+            case BF_Table:
+                fprintf(out,"%-44s %10.3f %10.3f %10.3f %10.3f %10.3f\n",c->name,c->minNs,c->medianNs,c->p90Ns,c->p99Ns,c->meanNs);
+                break;
+            case BF_CSV:
+                fprintf(out,"%s,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f\n",c->name,c->items,gf3d_bench.runs,c->minNs,c->medianNs,c->p90Ns,c->p99Ns,c->meanNs);
+                break;
+            case BF_JSON:
+                fprintf(out,"%s    {\"name\": \"%s\", \"items\": %u, \"min_ns\": %.4f, \"median_ns\": %.4f, \"p90_ns\": %.4f, \"p99_ns\": %.4f, \"mean_ns\": %.4f}",
+                    first?"":",\n",c->name,c->items,c->minNs,c->medianNs,c->p90Ns,c->p99Ns,c->meanNs);
+                break;
+        }
+        first = false;
+    }
+    if (format == BF_JSON)fprintf(out,"\n  ]\n}\n");
+}
+
+/**
+ * @brief the format to write a file in: from its extension, so --output base.csv makes a baseline, else --format
+ */
+BenchFormat gf3d_bench_output_format(const char *filename)
+{
+    const char *extension = strrchr(filename,'.');
+    if (extension)
+    {
+        if (strcmp(extension,".csv") == 0)return BF_CSV;
+        if (strcmp(extension,".json") == 0)return BF_JSON;
+    }
+    return gf3d_bench.format;
+}
+
+/**
+ * MAIN
+ */
+
+Bool gf3d_bench_parse(int argc,char *argv[])
+{
+    int i;
+    const char *option;
+    gf3d_bench.runs = 30;
+    gf3d_bench.warmup = 3;
+    gf3d_bench.threshold = 10;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i],"--list") == 0)
+        {
+            gf3d_bench.list = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printf("unknown argument or missing value: %s\n",argv[i]);
+            return false;
+        }
+        option = argv[i++];
+        if (strcmp(option,"--filter") == 0)gf3d_bench.filter = argv[i];
+        else if (strcmp(option,"--runs") == 0)gf3d_bench.runs = MAX(1,atoi(argv[i]));
+        else if (strcmp(option,"--warmup") == 0)gf3d_bench.warmup = MAX(0,atoi(argv[i]));
+        else if (strcmp(option,"--output") == 0)gf3d_bench.output = argv[i];
+        else if (strcmp(option,"--baseline") == 0)gf3d_bench.baseline = argv[i];
+        else if (strcmp(option,"--threshold") == 0)gf3d_bench.threshold = atof(argv[i]);
+        else if (strcmp(option,"--format") == 0)
+        {
+            if (strcmp(argv[i],"table") == 0)gf3d_bench.format = BF_Table;
+            else if (strcmp(argv[i],"csv") == 0)gf3d_bench.format = BF_CSV;
+            else if (strcmp(argv[i],"json") == 0)gf3d_bench.format = BF_JSON;
+            else
+            {
+                printf("unknown format %s, expected table, csv or json\n",argv[i]);
+                return false;
+            }
+        }
+        else
+        {
+            printf("unknown argument %s\n",option);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief registered before everything else, so it runs after every close, the memory manager's leak report included.
+ * Whatever is still counted leaked, and fails the run even though main has already returned
+ */
+static void gf3d_bench_check_leaks()
+{
+    int i;
+    Uint32 leaks = 0;
+    MemoryTagStats stats;
+    for (i = 0; i < MT_MAX; i++)
+    {
+        gf3d_memory_get_tag_stats(i,&stats);
+        leaks += stats.host.liveCount + stats.gpu.liveCount;
+    }
+    if (!leaks)return;
+    printf("%u allocations leaked, see gf3d_bench.log: leak check FAILED\n",leaks);
+    fflush(stdout);
+    _exit(1);
+}
+
+int main(int argc,char *argv[])
+{
+    int i;
+    double *samples;
+    FILE *out;
+    Uint32 regressions = 0;
+
+    gf3d_bench.savedStdout = -1;
+    if (!gf3d_bench_parse(argc,argv))
+    {
+        printf("usage: gf3d_bench [--filter text] [--runs n] [--warmup n] [--format table|csv|json] [--output file]\n");
+        printf("                  [--baseline file.csv] [--threshold percent] [--list]\n");
+        return 1;
+    }
+    atexit(gf3d_bench_check_leaks);
+    init_logger("gf3d_bench.log");
+    // first, so it reports last.  The frame arena holds one arena.frame run
+    gf3d_memory_init(2 * 1024 * 1024,64 * 1024);
+    srand(1);
+
+    gf3d_bench_math_register();
+    gf3d_bench_engine_register();
+    gf3d_bench_pool_register();
+    gf3d_jobs_init(0);      // after the engine cases start tracing, workers name their trace threads as they start
+    gf3d_bench_jobs_register();
+    gf3d_bench_ecs_register();
+    gf3d_bench_collision_register();
+    gf3d_bench_cull_register();
+    gf3d_bench_spatial_register();
+    gf3d_bench_render_register();
+
+    if (gf3d_bench.list)
+    {
+        for (i = 0; i < gf3d_bench.caseCount; i++)
+        {
+            if (gf3d_bench.cases[i].selected)printf("%s\n",gf3d_bench.cases[i].name);
+        }
+        return 0;
+    }
+    samples = (double *)gf3d_allocate_array(sizeof(double),gf3d_bench.runs);
+    if (!samples)return 1;
+    for (i = 0; i < gf3d_bench.caseCount; i++)
+    {
+        if (!gf3d_bench.cases[i].selected)continue;
+        gf3d_bench_run_case(&gf3d_bench.cases[i],samples);
+    }
+    free(samples);
+
+    gf3d_bench_write(stdout,gf3d_bench.format);
+    if (gf3d_bench.output)
+    {
+        out = fopen(gf3d_bench.output,"w");
+        if (!out)
+        {
+            printf("failed to open %s for writing\n",gf3d_bench.output);
+            return 1;
+        }
+        gf3d_bench_write(out,gf3d_bench_output_format(gf3d_bench.output));
+        fclose(out);
+    }
+    if (gf3d_bench.baseline)
+    {
+        if (!gf3d_bench_baseline_load(gf3d_bench.baseline))return 1;
+        regressions = gf3d_bench_baseline_compare();
+        printf("%u regressions over %.1f%%\n",regressions,gf3d_bench.threshold);
+    }
+    if (gf3d_bench.failures)printf("%u result checks FAILED\n",gf3d_bench.failures);
+    return ((gf3d_bench.failures)||(regressions))?1:0;
+}
+
+/*eol@eof*/
@@ -0,0 +1,89 @@
+#ifndef __GF3D_BENCH_H__
+#define __GF3D_BENCH_H__
+
+#include "gf3d_types.h"
+
+/**
+ * @purpose headless benchmark suite
+ * each area registers named cases, the runner times every case that matches the filter: warmup runs first, then
+ * repeated timed runs reported as per item minimum, median, percentiles and mean.  Results can be written as a table,
+ * CSV or JSON, and compared against a CSV saved from an earlier run to flag regressions
+ * areas also check the results of what they benchmark before timing it, a wrong answer fails the run
+ */
+
+/**
+ * @brief the work of a benchmark case, or its untimed preparation
+ * @param param the value the case was registered with, such as which kernel set to use
+ */
+typedef void (*BenchRun)(int param);
+
+/**
+ * @brief register a benchmark case
+ * @param name unique, dotted from general to specific: area.function.variant
+ * @param items how many items one run processes, timings are reported per item
+ * @param prepare called before every run outside of the timing, NULL if not needed
+ * @param run the timed work
+ * @param param passed to prepare and run
+ */
+void gf3d_bench_add(const char *name,Uint32 items,BenchRun prepare,BenchRun run,int param);
+
+/**
+ * @brief report a failed result check, the suite will exit with an error
+ * @param name the case or function that failed
+ * @param detail what was wrong
+ */
+void gf3d_bench_fail(const char *name,const char *detail);
+
+/**
+ * @brief stop or resume echoing to stdout, for timing code that logs
+ * @note waits for the logger to write what it has queued first.  The runner resumes stdout after every case
+ * @param mute true to discard stdout until called again with false
+ */
+void gf3d_bench_mute_stdout(Bool mute);
+
+/**
+ * @brief set up, check and register the gf3d_matrix, gf3d_vector, stream, quaternion and transform cases
+ */
+void gf3d_bench_math_register();
+
+/**
+ * @brief set up, check and register the allocator, logger, tracing and file loading cases
+ */
+void gf3d_bench_engine_register();
+
+/**
+ * @brief check and register the object pool cases
+ */
+void gf3d_bench_pool_register();
+
+/**
+ * @brief check the job system and register its cases
+ */
+void gf3d_bench_jobs_register();
+
+/**
+ * @brief set up the entity system, check it and register its cases
+ */
+void gf3d_bench_ecs_register();
+
+/**
+ * @brief set up the collision system, check it and register its cases
+ */
+void gf3d_bench_collision_register();
+
+/**
+ * @brief check the spatial index and register its cases
+ */
+void gf3d_bench_spatial_register();
+
+/**
+ * @brief set up the culling system, check its instruction sets agree and register their cases
+ */
+void gf3d_bench_cull_register();
+
+/**
+ * @brief set up batching and the render queue without a device, check them and register the render submission cases
+ */
+void gf3d_bench_render_register();
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * @purpose collision benchmarks: a full update of 50k moving bodies of every shape bouncing around a box, and single
+ * shape tests that need EPA
+ * the 50k bodies are added the first time their case runs, so filtered out cases cost nothing.  Before timing, known
+ * contacts between each kind of shape are checked against their exact depths, and the contacts an update finds among
+ * a thousand crowded bodies are checked against testing every pair by hand, along with the pairs that begin and end
+ * as they move apart
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_collision.h"
+#include "gf3d_quaternion.h"
+
+#define COLLISION_BODIES        50000
+#define COLLISION_CHECK_COUNT   1000
+#define COLLISION_TEST_COUNT    10000
+#define COLLISION_WORLD_SIZE    100.0f      // about 19k overlapping boxes and 8k contacts among the 50k
+#define COLLISION_CHECK_SIZE    12.0f
+#define COLLISION_DT            (1.0f / 60.0f)
+#define COLLISION_TOLERANCE     1e-3f
+
+typedef enum
+{
+    CT_Step = 0,
+    CT_BoxHull,
+    CT_MAX
+}CollisionTest;
+
+typedef struct
+{
+    CollisionShape *shapes[CS_MAX];
+    float           reach[CS_MAX];      /**<how far each shape reaches from its center, for the brute force check*/
+    Sint32         *bodies;
+    Vector3D       *positions;
+    Vector3D       *velocities;
+    Quaternion     *rotations;
+    Uint8          *kinds;
+    Uint8          *touching;           /**<the brute force result, one per pair of check bodies*/
+    Bool            ready;              /**<the 50k bodies exist*/
+}CollisionBench;
+
+static CollisionBench bench = {0};
+
+static float gf3d_bench_collision_random(float min,float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static Quaternion gf3d_bench_collision_random_rotation()
+{
+    Vector3D axis;
+    axis.x = gf3d_bench_collision_random(-1,1);
+    axis.y = gf3d_bench_collision_random(-1,1);
+    axis.z = gf3d_bench_collision_random(-1,1);
+    return gf3d_quaternion_from_axis_angle(axis,gf3d_bench_collision_random(0,6.2831853f));
+}
+
+/**
+ * @brief scatter bodies of every shape with random rotations and velocities
+ */
+static Bool gf3d_bench_collision_spawn(Uint32 count,float size)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        bench.kinds[i] = i % CS_MAX;
+        bench.positions[i].x = gf3d_bench_collision_random(0,size);
+        bench.positions[i].y = gf3d_bench_collision_random(0,size);
+        bench.positions[i].z = gf3d_bench_collision_random(0,size);
+        bench.velocities[i].x = gf3d_bench_collision_random(-2,2);
+        bench.velocities[i].y = gf3d_bench_collision_random(-2,2);
+        bench.velocities[i].z = gf3d_bench_collision_random(-2,2);
+        bench.rotations[i] = gf3d_bench_collision_random_rotation();
+        bench.bodies[i] = gf3d_collision_body_add(bench.shapes[bench.kinds[i]],bench.positions[i],bench.rotations[i],false,NULL);
+        if (bench.bodies[i] < 0)return false;
+    }
+    return true;
+}
+
+/**
+ * @brief move bodies one step, bouncing off the walls of the world
+ */
+static void gf3d_bench_collision_move(Uint32 count,float size)
+{
+    int i;
+    Vector3D *p,*v;
+    for (i = 0; i < count; i++)
+    {
+        p = &bench.positions[i];
+        v = &bench.velocities[i];
+        p->x += v->x * COLLISION_DT;
+        p->y += v->y * COLLISION_DT;
+        p->z += v->z * COLLISION_DT;
+        if ((p->x < 0)||(p->x > size))v->x = -v->x;
+        if ((p->y < 0)||(p->y > size))v->y = -v->y;
+        if ((p->z < 0)||(p->z > size))v->z = -v->z;
+        gf3d_collision_body_set_transform(bench.bodies[i],*p,bench.rotations[i]);
+    }
+}
+
+/**
+ * CHECKS
+ */
+
+/**
+ * @brief test two shapes and compare the contact with the one expected
+ * @return false if it was wrong, after reporting it
+ */
+static Bool gf3d_bench_collision_expect(
+    const char *name,const CollisionShape *a,Vector3D positionA,Quaternion rotationA,
+    const CollisionShape *b,Vector3D positionB,Quaternion rotationB,float depth,Vector3D normal)
+{
+    CollisionContact contact;
+    if (!gf3d_collision_test(a,positionA,rotationA,b,positionB,rotationB,&contact))
+    {
+        gf3d_bench_fail(name,"touching shapes were not found touching");
+        return false;
+    }
+    if ((fabsf(contact.depth - depth) > COLLISION_TOLERANCE)||
+        (fabsf(contact.normal.x - normal.x) > COLLISION_TOLERANCE)||
+        (fabsf(contact.normal.y - normal.y) > COLLISION_TOLERANCE)||
+        (fabsf(contact.normal.z - normal.z) > COLLISION_TOLERANCE))
+    {
+        gf3d_bench_fail(name,"wrong depth or normal");
+        printf("  depth %f normal %f,%f,%f, expected %f and %f,%f,%f\n",
+            contact.depth,contact.normal.x,contact.normal.y,contact.normal.z,depth,normal.x,normal.y,normal.z);
+        return false;
+    }
+    return true;
+}
+
+static Bool gf3d_bench_collision_check_shapes()
+{
+    Bool ok = true;
+    Quaternion identity = gf3d_quaternion_identity();
+    Quaternion turned = gf3d_quaternion_from_axis_angle(vector3d(0,0,1),0.78539816f);
+    Vector3D origin = vector3d(0,0,0);
+    Vector3D x = vector3d(1,0,0);
+    CollisionShape *sphere = bench.shapes[CS_Sphere];
+    CollisionShape *box = bench.shapes[CS_Box];
+    CollisionShape *capsule = bench.shapes[CS_Capsule];
+    CollisionShape *hull = bench.shapes[CS_Hull];
+
+    // spheres of radius 0.5, boxes and the hull cubes of half size 0.5, capsules of radius 0.25 and half height 0.5
+    ok &= gf3d_bench_collision_expect("collision.sphere_sphere",sphere,origin,identity,sphere,vector3d(0.8,0,0),identity,0.2f,x);
+    ok &= gf3d_bench_collision_expect("collision.box_box",box,origin,identity,box,vector3d(0.75,0.1,0),identity,0.25f,x);
+    ok &= gf3d_bench_collision_expect("collision.box_box.deep",box,origin,identity,box,vector3d(0.1,0,0),identity,0.9f,x);
+    ok &= gf3d_bench_collision_expect("collision.capsule_sphere",capsule,origin,identity,sphere,vector3d(0.6,0.5,0),identity,0.15f,x);
+    ok &= gf3d_bench_collision_expect("collision.capsule_box",capsule,origin,identity,box,vector3d(0.65,0.2,0),identity,0.1f,x);
+    ok &= gf3d_bench_collision_expect("collision.hull_box",hull,origin,identity,box,vector3d(0.75,0.1,0),identity,0.25f,x);
+    ok &= gf3d_bench_collision_expect("collision.hull_hull.deep",hull,origin,identity,hull,vector3d(0.2,0,0.05),identity,0.8f,x);
+    // a box turned 45 degrees about z reaches sqrt(0.5) along x
+    ok &= gf3d_bench_collision_expect("collision.box_sphere.turned",box,origin,turned,sphere,vector3d(1,0,0),identity,0.5f + 0.70710678f - 1,x);
+    if (gf3d_collision_test(box,origin,turned,box,vector3d(1.5,0,0),identity,NULL))
+    {
+        gf3d_bench_fail("collision.box_box.apart","shapes apart were found touching");
+        ok = false;
+    }
+    if (gf3d_collision_test(capsule,origin,identity,capsule,vector3d(0.45,0,0),turned,NULL) !=
+        gf3d_collision_test(capsule,vector3d(0.45,0,0),turned,capsule,origin,identity,NULL))
+    {
+        gf3d_bench_fail("collision.capsule_capsule","the result depends on which shape goes first");
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * @brief compare an update's contacts among crowded bodies with testing every pair, then move them apart and check
+ * every contact ends
+ */
+static Bool gf3d_bench_collision_check_update()
+{
+    int i,j;
+    Uint32 count,expected = 0,ended = 0;
+    Uint32 n = COLLISION_CHECK_COUNT;
+    float reach;
+    Vector3D d;
+    const CollisionContact *contacts;
+    const CollisionPair *pairs;
+    const char *name = "collision.update";
+
+    if (!gf3d_bench_collision_spawn(n,COLLISION_CHECK_SIZE))
+    {
+        gf3d_bench_fail(name,"failed to add the check bodies");
+        return false;
+    }
+    // indexed by body id, the first bodies added get ids from 0 up
+    memset(bench.touching,0,n * n);
+    for (i = 0; i < n; i++)
+    {
+        for (j = i + 1; j < n; j++)
+        {
+            vector3d_sub(d,bench.positions[i],bench.positions[j]);
+            reach = bench.reach[bench.kinds[i]] + bench.reach[bench.kinds[j]];
+            if (vector3d_dot_product(d,d) > reach * reach)continue;
+            if (!gf3d_collision_test(
+                bench.shapes[bench.kinds[i]],bench.positions[i],bench.rotations[i],
+                bench.shapes[bench.kinds[j]],bench.positions[j],bench.rotations[j],NULL))continue;
+            bench.touching[bench.bodies[i] * n + bench.bodies[j]] = 1;
+            bench.touching[bench.bodies[j] * n + bench.bodies[i]] = 1;
+            expected++;
+        }
+    }
+    gf3d_collision_update();
+    contacts = gf3d_collision_get_contacts(&count);
+    if (count != expected)
+    {
+        gf3d_bench_fail(name,"the update found a different number of contacts than testing every pair");
+        printf("  %u contacts, expected %u\n",count,expected);
+        return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if ((contacts[i].bodyA >= contacts[i].bodyB)||(!contacts[i].began)||
+            (!bench.touching[contacts[i].bodyA * n + contacts[i].bodyB]))
+        {
+            gf3d_bench_fail(name,"a contact is not one testing every pair found, or did not begin");
+            return false;
+        }
+    }
+    // a second update with nothing moved finds the same contacts, none of them new
+    gf3d_collision_update();
+    contacts = gf3d_collision_get_contacts(&count);
+    for (i = 0; i < count; i++)
+    {
+        if (contacts[i].began)break;
+    }
+    if ((count != expected)||(i < count))
+    {
+        gf3d_bench_fail(name,"contacts changed with nothing moving");
+        return false;
+    }
+    // spread them out so nothing touches, half by moving and half by removing
+    for (i = 0; i < n; i++)
+    {
+        if (i & 1)gf3d_collision_body_remove(bench.bodies[i]);
+        else gf3d_collision_body_set_transform(bench.bodies[i],vector3d(i * 4.0f,0,0),bench.rotations[i]);
+    }
+    gf3d_collision_update();
+    gf3d_collision_get_contacts(&count);
+    pairs = gf3d_collision_get_ended(&ended);
+    if ((count)||(ended != expected))
+    {
+        gf3d_bench_fail(name,"contacts did not all end when the bodies moved apart or were removed");
+        printf("  %u contacts left, %u ended of %u\n",count,ended,expected);
+        return false;
+    }
+    for (i = 0; i < ended; i++)
+    {
+        if (!bench.touching[pairs[i].bodyA * n + pairs[i].bodyB])
+        {
+            gf3d_bench_fail(name,"a pair that was not touching ended");
+            return false;
+        }
+    }
+    for (i = 0; i < n; i += 2)
+    {
+        gf3d_collision_body_remove(bench.bodies[i]);
+    }
+    gf3d_collision_update();
+    return true;
+}
+
+/**
+ * CASES
+ */
+
+void gf3d_bench_collision_prepare(int param)
+{
+    if ((param != CT_Step)||(bench.ready))return;
+    srand(50);
+    if (!gf3d_bench_collision_spawn(COLLISION_BODIES,COLLISION_WORLD_SIZE))
+    {
+        gf3d_bench_fail("collision.step","failed to add the bodies");
+        return;
+    }
+    gf3d_collision_update();
+    bench.ready = true;
+}
+
+void gf3d_bench_collision_run(int param)
+{
+    int i;
+    CollisionContact contact;
+    Vector3D offset = vector3d(0.6,0.1,0.05);
+
+    switch (param)
+    {
+        case CT_Step:
+            if (!bench.ready)return;
+            gf3d_bench_collision_move(COLLISION_BODIES,COLLISION_WORLD_SIZE);
+            gf3d_collision_update();
+            break;
+        case CT_BoxHull:
+            // deep enough that the cores overlap, so every test runs GJK and then EPA
+            for (i = 0; i < COLLISION_TEST_COUNT; i++)
+            {
+                gf3d_collision_test(
+                    bench.shapes[CS_Box],vector3d(0,0,0),bench.rotations[i & 1023],
+                    bench.shapes[CS_Hull],offset,bench.rotations[(i + 1) & 1023],&contact);
+            }
+            break;
+    }
+}
+
+static void gf3d_bench_collision_close()
+{
+    int i;
+    for (i = 0; i < CS_MAX; i++)
+    {
+        gf3d_collision_shape_free(bench.shapes[i]);
+        bench.shapes[i] = NULL;
+    }
+}
+
+void gf3d_bench_collision_register()
+{
+    static const Uint32 items[CT_MAX] = {COLLISION_BODIES,COLLISION_TEST_COUNT};
+    static const char *names[CT_MAX] = {"collision.step.50k","collision.test.box_hull.10k"};
+    int i;
+    Vector3D corners[8];
+
+    gf3d_collision_init(COLLISION_BODIES + COLLISION_CHECK_COUNT);
+    atexit(gf3d_bench_collision_close);     // after the collision system's own, so it runs first
+    for (i = 0; i < 8; i++)
+    {
+        corners[i].x = (i & 1)?0.5f:-0.5f;
+        corners[i].y = (i & 2)?0.5f:-0.5f;
+        corners[i].z = (i & 4)?0.5f:-0.5f;
+    }
+    bench.shapes[CS_Sphere] = gf3d_collision_shape_sphere(0.5f);
+    bench.shapes[CS_Box] = gf3d_collision_shape_box(vector3d(0.5,0.5,0.5));
+    bench.shapes[CS_Capsule] = gf3d_collision_shape_capsule(0.25f,0.5f);
+    bench.shapes[CS_Hull] = gf3d_collision_shape_hull(corners,8);
+    bench.reach[CS_Sphere] = 0.5f;
+    bench.reach[CS_Box] = bench.reach[CS_Hull] = 0.8660254f;
+    bench.reach[CS_Capsule] = 0.75f;
+    bench.bodies = (Sint32 *)gf3d_allocate_array(sizeof(Sint32),COLLISION_BODIES);
+    bench.positions = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),COLLISION_BODIES);
+    bench.velocities = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),COLLISION_BODIES);
+    bench.rotations = (Quaternion *)gf3d_allocate_array(sizeof(Quaternion),COLLISION_BODIES);
+    bench.kinds = (Uint8 *)gf3d_allocate_array(sizeof(Uint8),COLLISION_BODIES);
+    bench.touching = (Uint8 *)gf3d_allocate_array(sizeof(Uint8),COLLISION_CHECK_COUNT * COLLISION_CHECK_COUNT);
+    for (i = 0; i < CS_MAX; i++)
+    {
+        if (!bench.shapes[i])break;
+    }
+    if ((i < CS_MAX)||(!bench.bodies)||(!bench.positions)||(!bench.velocities)||(!bench.rotations)||(!bench.kinds)||
+        (!bench.touching))
+    {
+        gf3d_bench_fail("collision","failed to set up the collision system");
+        return;
+    }
+    srand(49);
+    if (!gf3d_bench_collision_check_shapes())return;
+    if (!gf3d_bench_collision_check_update())return;
+    for (i = 0; i < CT_MAX; i++)
+    {
+        gf3d_bench_add(names[i],items[i],gf3d_bench_collision_prepare,gf3d_bench_collision_run,i);
+    }
+}
+
+/*eol@eof*/
@@ -0,0 +1,184 @@
+/**
+ * @purpose frustum culling benchmarks: the scalar, SSE and AVX tests over the same 100k spheres and boxes scattered
+ * around a camera, about one in twenty of them visible.  Timings are per object, so the scalar case is the reference the
+ * wider ones are read against
+ * before timing, every instruction set the CPU has is checked to find exactly the objects the scalar test finds, in
+ * the same order, both for the scattered objects and for objects placed right on the frustum planes
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_cull.h"
+
+#define CULL_OBJECTS        100000
+#define CULL_WORLD_SIZE     100.0f      // objects are scattered from -size to size around the camera
+#define CULL_FAR            100.0
+
+typedef struct
+{
+    Frustum     frustum;
+    Sint32     *objects;
+    Uint32     *reference;      /**<what the scalar test found*/
+    Uint32     *visible;
+    Uint32      referenceCount;
+}CullBench;
+
+static CullBench bench = {0};
+
+static const char *cullNames[] = {"cull.frustum.scalar.100k","cull.frustum.sse.100k","cull.frustum.avx.100k"};
+static const char *cullModeNames[] = {"scalar","sse","avx"};
+
+static float gf3d_bench_cull_random(float min,float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+/**
+ * @brief give an object a random sphere and a box that fits inside it, so some pass one test and not the other
+ */
+static void gf3d_bench_cull_scatter(Sint32 object)
+{
+    Vector3D center,extent;
+    float radius;
+
+    center.x = gf3d_bench_cull_random(-CULL_WORLD_SIZE,CULL_WORLD_SIZE);
+    center.y = gf3d_bench_cull_random(-CULL_WORLD_SIZE,CULL_WORLD_SIZE);
+    center.z = gf3d_bench_cull_random(-CULL_WORLD_SIZE,CULL_WORLD_SIZE);
+    radius = gf3d_bench_cull_random(0.5f,3.0f);
+    extent.x = radius * gf3d_bench_cull_random(0.1f,0.577f);
+    extent.y = radius * gf3d_bench_cull_random(0.1f,0.577f);
+    extent.z = radius * gf3d_bench_cull_random(0.1f,0.577f);
+    gf3d_cull_object_set_sphere(object,center,radius);
+    gf3d_cull_object_set_aabb(
+        object,
+        vector3d(center.x - extent.x,center.y - extent.y,center.z - extent.z),
+        vector3d(center.x + extent.x,center.y + extent.y,center.z + extent.z));
+}
+
+/**
+ * @brief place an object so its sphere and box just touch a frustum plane from outside, where rounding decides
+ */
+static void gf3d_bench_cull_touch_plane(Sint32 object,const Vector4D *plane)
+{
+    Vector3D center,point;
+    float radius,t;
+
+    // a point on the plane in front of the camera, then back out along the normal by the radius
+    point.x = gf3d_bench_cull_random(-10,10);
+    point.y = gf3d_bench_cull_random(-10,10);
+    point.z = gf3d_bench_cull_random(-50,-1);
+    t = plane->x * point.x + plane->y * point.y + plane->z * point.z + plane->w;
+    point.x -= plane->x * t;
+    point.y -= plane->y * t;
+    point.z -= plane->z * t;
+    radius = gf3d_bench_cull_random(0.5f,3.0f);
+    center.x = point.x - plane->x * radius;
+    center.y = point.y - plane->y * radius;
+    center.z = point.z - plane->z * radius;
+    gf3d_cull_object_set_sphere(object,center,radius);
+    gf3d_cull_object_set_aabb(
+        object,
+        vector3d(center.x - radius,center.y - radius,center.z - radius),
+        vector3d(center.x + radius,center.y + radius,center.z + radius));
+}
+
+/**
+ * CHECKS
+ */
+
+/**
+ * @brief cull with every mode the CPU has and compare each with the scalar result
+ * @param name what to report a difference as
+ * @param supported output, which modes actually ran rather than falling back
+ * @return false if a mode found different objects, after reporting it
+ */
+static Bool gf3d_bench_cull_check(const char *name,Bool supported[CM_AVX + 1])
+{
+    CullMode mode;
+    CullStats stats;
+    Uint32 count;
+    char detail[128];
+
+    bench.referenceCount = gf3d_cull_frustum(&bench.frustum,CM_Scalar,bench.reference);
+    for (mode = CM_Scalar; mode <= CM_AVX; mode++)
+    {
+        count = gf3d_cull_frustum(&bench.frustum,mode,bench.visible);
+        gf3d_cull_get_stats(&stats);
+        supported[mode] = (stats.mode == mode);
+        if (!supported[mode])continue;
+        if ((count != bench.referenceCount)||(memcmp(bench.visible,bench.reference,sizeof(Uint32) * count) != 0))
+        {
+            snprintf(detail,sizeof(detail),"%s found %u visible, the scalar test %u or in another order",
+                cullModeNames[mode - CM_Scalar],count,bench.referenceCount);
+            gf3d_bench_fail(name,detail);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * CASES
+ */
+
+void gf3d_bench_cull_run(int param)
+{
+    gf3d_cull_frustum(&bench.frustum,(CullMode)param,bench.visible);
+}
+
+void gf3d_bench_cull_register()
+{
+    int i;
+    Matrix4 view,proj,viewProj;
+    Bool supported[CM_AVX + 1];
+
+    gf3d_cull_init(CULL_OBJECTS);
+    bench.objects = (Sint32 *)gf3d_allocate_array(sizeof(Sint32),CULL_OBJECTS);
+    bench.reference = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),CULL_OBJECTS);
+    bench.visible = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),CULL_OBJECTS);
+    if ((!bench.objects)||(!bench.reference)||(!bench.visible))
+    {
+        gf3d_bench_fail("cull","failed to allocate benchmark data");
+        return;
+    }
+    for (i = 0; i < CULL_OBJECTS; i++)
+    {
+        bench.objects[i] = gf3d_cull_object_new();
+        if (bench.objects[i] < 0)
+        {
+            gf3d_bench_fail("cull","failed to add the objects");
+            return;
+        }
+    }
+    gf3d_matrix_view(view,vector3d(0,0,0),vector3d(0,0,-1),vector3d(0,1,0));
+    gf3d_matrix_perspective(proj,45 * GF3D_DEGTORAD,16.0 / 9.0,0.1,CULL_FAR);
+    gf3d_matrix_multiply(viewProj,proj,view);
+    gf3d_cull_frustum_from_matrix(&bench.frustum,viewProj);
+
+    srand(30);
+    for (i = 0; i < CULL_OBJECTS; i++)
+    {
+        gf3d_bench_cull_touch_plane(bench.objects[i],&bench.frustum.planes[i % 6]);
+    }
+    if (!gf3d_bench_cull_check("cull.planes",supported))return;
+    for (i = 0; i < CULL_OBJECTS; i++)
+    {
+        gf3d_bench_cull_scatter(bench.objects[i]);
+    }
+    if (!gf3d_bench_cull_check("cull.scatter",supported))return;
+
+    for (i = CM_Scalar; i <= CM_AVX; i++)
+    {
+        if (!supported[i])
+        {
+            printf("no %s on this CPU, %s skipped\n",cullModeNames[i - CM_Scalar],cullNames[i - CM_Scalar]);
+            continue;
+        }
+        gf3d_bench_add(cullNames[i - CM_Scalar],CULL_OBJECTS,NULL,gf3d_bench_cull_run,i);
+    }
+}
+
+/*eol@eof*/
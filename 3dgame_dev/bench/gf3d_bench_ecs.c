@@ -0,0 +1,335 @@
+/**
+ * @purpose entity system benchmarks: a transform system over a million entities, on one thread and spread over the
+ * job system's threads, and structural changes made through command buffers
+ * the million entities are made the first time one of their cases runs, so filtered out cases cost nothing.  Before
+ * timing, a small world is checked: components surviving moves between archetypes, stale handles, command buffers
+ * recorded from a parallel query, freeing and remaking a command buffer, and world matrices against the positions
+ * they were built from
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_ecs.h"
+#include "gf3d_matrix.h"
+#include "gf3d_quaternion.h"
+
+#define ECS_ENTITIES        1000000
+#define ECS_CHECK_COUNT     1000
+#define ECS_COMMAND_COUNT   10000
+#define ECS_DT              (1.0f / 60.0f)
+
+typedef enum
+{
+    ET_Transform = 0,
+    ET_TransformParallel,
+    ET_MAX
+}EcsTest;
+
+typedef struct
+{
+    Sint32          position;       /**<component ids*/
+    Sint32          velocity;
+    Sint32          rotation;
+    Sint32          scale;
+    Sint32          world;
+    Sint32          marker;         /**<an empty tag the check moves entities in and out of*/
+    ComponentMask   moving;         /**<everything the transform system needs*/
+    EcsCommands    *commands;       /**<one buffer per thread*/
+    Uint32          threads;
+    Entity         *spawned;
+    Bool            ready;          /**<the million entities exist*/
+}EcsBench;
+
+static EcsBench bench = {0};
+
+/**
+ * @brief the system being timed: integrate velocity, then rebuild the world matrix
+ */
+static void gf3d_bench_ecs_transform(EcsChunk *chunk,Uint32 thread,void *data)
+{
+    Uint32 i;
+    Vector3D *position = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.position);
+    Vector3D *velocity = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.velocity);
+    Quaternion *rotation = gf3d_ecs_chunk_get_typed(chunk,Quaternion,bench.rotation);
+    Vector3D *scale = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.scale);
+    Matrix4 *world = gf3d_ecs_chunk_get_typed(chunk,Matrix4,bench.world);
+
+    for (i = 0; i < chunk->count; i++)
+    {
+        position[i].x += velocity[i].x * ECS_DT;
+        position[i].y += velocity[i].y * ECS_DT;
+        position[i].z += velocity[i].z * ECS_DT;
+        gf3d_matrix_compose(world[i],position[i],rotation[i],scale[i]);
+    }
+}
+
+/**
+ * @brief give new entities distinct positions and velocities, a unit scale and a turned rotation
+ */
+static void gf3d_bench_ecs_setup(EcsChunk *chunk,Uint32 thread,void *data)
+{
+    Uint32 i;
+    Uint32 *next = (Uint32 *)data;
+    Vector3D *position = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.position);
+    Vector3D *velocity = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.velocity);
+    Quaternion *rotation = gf3d_ecs_chunk_get_typed(chunk,Quaternion,bench.rotation);
+    Vector3D *scale = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.scale);
+
+    for (i = 0; i < chunk->count; i++,(*next)++)
+    {
+        vector3d_set(position[i],(float)(*next % 1000),(float)(*next / 1000),0);
+        vector3d_set(velocity[i],1,(float)(*next % 7),-1);
+        vector3d_set(scale[i],1,1,1);
+        rotation[i] = gf3d_quaternion_from_axis_angle(vector3d(0,0,1),(float)(*next % 360) * 0.0174533f);
+    }
+}
+
+/**
+ * @brief check that every world matrix carries its entity's position
+ */
+static void gf3d_bench_ecs_verify(EcsChunk *chunk,Uint32 thread,void *data)
+{
+    Uint32 i;
+    Uint32 *wrong = (Uint32 *)data;
+    Vector3D *position = gf3d_ecs_chunk_get_typed(chunk,Vector3D,bench.position);
+    Matrix4 *world = gf3d_ecs_chunk_get_typed(chunk,Matrix4,bench.world);
+    for (i = 0; i < chunk->count; i++)
+    {
+        if ((world[i][3][0] != position[i].x)||(world[i][3][1] != position[i].y)||(world[i][3][2] != position[i].z))(*wrong)++;
+    }
+}
+
+/**
+ * @brief record freeing every marked entity, in the buffer of the thread running the chunk
+ */
+static void gf3d_bench_ecs_free_marked(EcsChunk *chunk,Uint32 thread,void *data)
+{
+    Uint32 i;
+    for (i = 0; i < chunk->count; i++)
+    {
+        gf3d_ecs_command_entity_free(&bench.commands[thread],chunk->entities[i]);
+    }
+}
+
+/**
+ * @brief collect every entity into bench.spawned, to free them after a query
+ */
+static void gf3d_bench_ecs_collect(EcsChunk *chunk,Uint32 thread,void *data)
+{
+    Uint32 *count = (Uint32 *)data;
+    memcpy(&bench.spawned[*count],chunk->entities,sizeof(Entity) * chunk->count);
+    *count += chunk->count;
+}
+
+/**
+ * @brief flush every thread's command buffer
+ */
+static void gf3d_bench_ecs_flush()
+{
+    Uint32 i;
+    for (i = 0; i < gf3d_ecs_get_thread_count(); i++)
+    {
+        gf3d_ecs_commands_flush(&bench.commands[i]);
+    }
+}
+
+/**
+ * @brief check a small world before trusting the timings
+ * @return false if the world could not be made
+ */
+static Bool gf3d_bench_ecs_check()
+{
+    int i;
+    Uint32 count;
+    Uint32 wrong = 0;
+    Uint32 next = 0;
+    Entity entity;
+    Entity stale;
+    Entity *entities = bench.spawned;
+    Vector3D *position;
+    Vector3D value;
+    EcsQuery query = {0};
+    EcsCommands commands;
+    const char *name = "ecs";
+
+    for (i = 0; i < ECS_CHECK_COUNT; i++)
+    {
+        entities[i] = gf3d_ecs_entity_new(bench.moving);
+        if (!entities[i])return false;
+    }
+    query.all = bench.moving;
+    gf3d_ecs_query_each(query,gf3d_bench_ecs_setup,&next);
+    // every third entity moves to another archetype and every fifth loses its velocity, values have to come along
+    for (i = 0; i < ECS_CHECK_COUNT; i++)
+    {
+        if (!(i % 3))gf3d_ecs_add(entities[i],bench.marker,NULL);
+        if (!(i % 5))gf3d_ecs_remove(entities[i],bench.velocity);
+    }
+    for (i = 0; i < ECS_CHECK_COUNT; i++)
+    {
+        position = gf3d_ecs_get_typed(entities[i],Vector3D,bench.position);
+        if ((!position)||(position->x != (float)(i % 1000))||(position->y != (float)(i / 1000)))
+        {
+            gf3d_bench_fail(name,"a component changed when its entity moved archetype");
+            break;
+        }
+        if ((gf3d_ecs_get(entities[i],bench.velocity) != NULL) != ((i % 5) != 0))
+        {
+            gf3d_bench_fail(name,"a removed component is still there, or a kept one is gone");
+            break;
+        }
+    }
+    if (gf3d_ecs_query_count(query) != ECS_CHECK_COUNT - ECS_CHECK_COUNT / 5)gf3d_bench_fail(name,"query counted the wrong entities");
+
+    // a stale handle must not reach the entity that reuses its index
+    stale = entities[1];
+    gf3d_ecs_entity_free(stale);
+    entities[1] = gf3d_ecs_entity_new(bench.moving);
+    if ((gf3d_ecs_entity_alive(stale))||(gf3d_ecs_get(stale,bench.position)))gf3d_bench_fail(name,"a freed handle still resolves");
+
+    gf3d_ecs_query_each_parallel(query,gf3d_bench_ecs_transform,NULL);
+    gf3d_ecs_query_each(query,gf3d_bench_ecs_verify,&wrong);
+    if (wrong)gf3d_bench_fail(name,"world matrices do not match positions after a parallel update");
+
+    // changes recorded during a query only land at the flush
+    value = vector3d(5,6,7);
+    entity = gf3d_ecs_command_entity_new(&bench.commands[0],gf3d_ecs_mask(bench.position));
+    gf3d_ecs_command_add(&bench.commands[0],entity,bench.marker,NULL);
+    gf3d_ecs_command_add(&bench.commands[0],entity,bench.position,&value);
+    if (gf3d_ecs_entity_alive(entity))gf3d_bench_fail(name,"a reserved entity is alive before the flush");
+    query.all = gf3d_ecs_mask(bench.marker);
+    count = gf3d_ecs_query_count(query);
+    gf3d_ecs_query_each_parallel(query,gf3d_bench_ecs_free_marked,NULL);
+    if (gf3d_ecs_query_count(query) != count)gf3d_bench_fail(name,"a recorded change was applied during the query");
+    gf3d_bench_ecs_flush();
+    position = gf3d_ecs_get_typed(entity,Vector3D,bench.position);
+    if ((!position)||(position->z != 7))gf3d_bench_fail(name,"a recorded entity was not made with its component");
+    if (gf3d_ecs_query_count(query) != 1)gf3d_bench_fail(name,"recorded frees were not applied");
+
+    // a buffer that grew can be freed and made again, and works the same after
+    if (!gf3d_ecs_commands_create(&commands,64))return false;
+    for (i = 0; i < 16; i++)gf3d_ecs_command_add(&commands,entity,bench.position,&value);
+    gf3d_ecs_commands_flush(&commands);
+    gf3d_ecs_commands_free(&commands);
+    if ((commands.data)||(commands.capacity)||(commands.size))gf3d_bench_fail(name,"a freed command buffer still holds memory");
+    if (!gf3d_ecs_commands_create(&commands,64))return false;
+    gf3d_ecs_command_entity_free(&commands,entity);
+    gf3d_ecs_commands_flush(&commands);
+    gf3d_ecs_commands_free(&commands);
+    if (gf3d_ecs_entity_alive(entity))gf3d_bench_fail(name,"a command buffer made again did not apply its commands");
+
+    // empty the world again for the timed cases
+    query.all = 0;
+    count = 0;
+    gf3d_ecs_query_each(query,gf3d_bench_ecs_collect,&count);
+    for (i = 0; i < count; i++)gf3d_ecs_entity_free(entities[i]);
+    if (gf3d_ecs_query_count(query))gf3d_bench_fail(name,"entities are left after freeing all of them");
+    return true;
+}
+
+void gf3d_bench_ecs_prepare(int param)
+{
+    int i;
+    Uint32 next = 0;
+    EcsQuery query = {0};
+    if (bench.ready)return;
+    for (i = 0; i < ECS_ENTITIES; i++)
+    {
+        if (!gf3d_ecs_entity_new(bench.moving))
+        {
+            gf3d_bench_fail("ecs.transform","failed to make the entities");
+            return;
+        }
+    }
+    query.all = bench.moving;
+    gf3d_ecs_query_each(query,gf3d_bench_ecs_setup,&next);
+    bench.ready = true;
+}
+
+void gf3d_bench_ecs_run(int param)
+{
+    EcsQuery query = {0};
+    if (!bench.ready)return;
+    query.all = bench.moving;
+    if (param == ET_TransformParallel)gf3d_ecs_query_each_parallel(query,gf3d_bench_ecs_transform,NULL);
+    else gf3d_ecs_query_each(query,gf3d_bench_ecs_transform,NULL);
+}
+
+/**
+ * @brief spawn entities with a component value through a command buffer, then free them the same way
+ */
+void gf3d_bench_ecs_commands_run(int param)
+{
+    int i;
+    Vector3D value = {1,2,3};
+    for (i = 0; i < ECS_COMMAND_COUNT; i++)
+    {
+        bench.spawned[i] = gf3d_ecs_command_entity_new(&bench.commands[0],gf3d_ecs_mask(bench.marker));
+        gf3d_ecs_command_add(&bench.commands[0],bench.spawned[i],bench.position,&value);
+    }
+    gf3d_ecs_commands_flush(&bench.commands[0]);
+    for (i = 0; i < ECS_COMMAND_COUNT; i++)
+    {
+        gf3d_ecs_command_entity_free(&bench.commands[0],bench.spawned[i]);
+    }
+    gf3d_ecs_commands_flush(&bench.commands[0]);
+}
+
+static void gf3d_bench_ecs_close()
+{
+    int i;
+    if (!bench.commands)return;
+    for (i = 0; i < bench.threads; i++)
+    {
+        gf3d_ecs_commands_free(&bench.commands[i]);
+    }
+}
+
+void gf3d_bench_ecs_register()
+{
+    int i;
+    Uint32 threads;
+
+    gf3d_ecs_init(ECS_ENTITIES + ECS_COMMAND_COUNT);
+    atexit(gf3d_bench_ecs_close);
+    bench.position = gf3d_ecs_component_register("position",sizeof(Vector3D));
+    bench.velocity = gf3d_ecs_component_register("velocity",sizeof(Vector3D));
+    bench.rotation = gf3d_ecs_component_register("rotation",sizeof(Quaternion));
+    bench.scale = gf3d_ecs_component_register("scale",sizeof(Vector3D));
+    bench.world = gf3d_ecs_component_register("world",sizeof(Matrix4));
+    bench.marker = gf3d_ecs_component_register("marker",sizeof(Uint8));
+    bench.moving = gf3d_ecs_mask(bench.position) | gf3d_ecs_mask(bench.velocity) | gf3d_ecs_mask(bench.rotation) |
+        gf3d_ecs_mask(bench.scale) | gf3d_ecs_mask(bench.world);
+    threads = gf3d_ecs_get_thread_count();
+    bench.commands = (EcsCommands *)gf3d_allocate_array(sizeof(EcsCommands),threads);
+    bench.spawned = (Entity *)gf3d_allocate_array(sizeof(Entity),ECS_COMMAND_COUNT);
+    if ((bench.marker < 0)||(!bench.commands)||(!bench.spawned))
+    {
+        gf3d_bench_fail("ecs","failed to set up the entity system");
+        return;
+    }
+    bench.threads = threads;
+    for (i = 0; i < threads; i++)
+    {
+        // sized for the command case, so the timing does not include growing the buffer
+        if (!gf3d_ecs_commands_create(&bench.commands[i],(i?4096:ECS_COMMAND_COUNT * 128)))
+        {
+            gf3d_bench_fail("ecs","failed to allocate command buffers");
+            return;
+        }
+    }
+    if (!gf3d_bench_ecs_check())
+    {
+        gf3d_bench_fail("ecs","failed to make the check entities");
+        return;
+    }
+    gf3d_bench_add("ecs.transform.1m",ECS_ENTITIES,gf3d_bench_ecs_prepare,gf3d_bench_ecs_run,ET_Transform);
+    gf3d_bench_add("ecs.transform_parallel.1m",ECS_ENTITIES,gf3d_bench_ecs_prepare,gf3d_bench_ecs_run,ET_TransformParallel);
+    gf3d_bench_add("ecs.commands.spawn_free.10k",ECS_COMMAND_COUNT,NULL,gf3d_bench_ecs_commands_run,0);
+}
+
+/*eol@eof*/
@@ -0,0 +1,201 @@
+/**
+ * @purpose engine benchmarks: the gf3d_types allocator, tracked allocation, the arenas, the logger, tracing and loading files from disk
+ * none of these need a window or a GPU, shader loading only reads the SPIR-V the renderer would hand to vulkan
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "simple_logger.h"
+#include "gf3d_bench.h"
+#include "gf3d_types.h"
+#include "gf3d_shaders.h"
+#include "gf3d_trace.h"
+#include "gf3d_memory.h"
+
+#define ALLOCATION_COUNT    4096
+#define LOG_COUNT           1024        // fits the logger queue, so nothing is dropped
+#define LOAD_COUNT          64
+#define TRACE_COUNT         4096
+
+typedef enum
+{
+    ET_AllocateSmall = 0,
+    ET_AllocateLarge,
+    ET_AllocateTracked,
+    ET_ArenaFrame,
+    ET_ArenaScratch,
+    ET_Log,
+    ET_LogSync,
+    ET_LoadShader,
+    ET_TraceZone,
+    ET_MAX
+}EngineTest;
+
+typedef struct
+{
+    void      **allocations;
+    const char *shader;         /**<the first shader file that was found, NULL for none*/
+}EngineBench;
+
+static EngineBench bench = {0};
+
+static const char *shaderFiles[] = {"shaders/vert.spv","../shaders/vert.spv",NULL};
+
+void gf3d_bench_engine_prepare(int param)
+{
+    if (param == ET_TraceZone)
+    {
+        gf3d_trace_clear();
+        return;
+    }
+    // the logger echoes to stdout, that would measure the terminal.  Muting also empties the queue
+    gf3d_bench_mute_stdout(true);
+}
+
+/**
+ * @brief the same mix of small sizes as allocate_array.small, taken from the arenas
+ */
+static void gf3d_bench_engine_arena(int param)
+{
+    int i;
+    MemoryStats before,after;
+    MemoryScratch scratch = {0};
+    gf3d_memory_get_stats(&before);
+    if (param == ET_ArenaFrame)gf3d_memory_begin_frame();
+    for (i = 0; i < ALLOCATION_COUNT; i++)
+    {
+        if ((param == ET_ArenaScratch)&&(!(i % 16)))scratch = gf3d_scratch_begin();
+        if (param == ET_ArenaFrame)bench.allocations[i] = gf3d_frame_allocate_array(16 + (i % 16) * 16,1);
+        else bench.allocations[i] = gf3d_arena_allocate_array(scratch.arena,16 + (i % 16) * 16,1);
+        if (!bench.allocations[i])
+        {
+            gf3d_bench_fail((param == ET_ArenaFrame)?"arena.frame":"arena.scratch","arena ran out of room");
+            return;
+        }
+        if ((param == ET_ArenaScratch)&&((i % 16) == 15))gf3d_scratch_end(scratch);
+    }
+    gf3d_memory_get_stats(&after);
+    if (after.heapAllocations != before.heapAllocations)
+    {
+        gf3d_bench_fail((param == ET_ArenaFrame)?"arena.frame":"arena.scratch","arena allocation went to the heap");
+    }
+}
+
+void gf3d_bench_engine_run(int param)
+{
+    int i;
+    size_t size;
+    char *data;
+    switch (param)
+    {
+        case ET_ArenaFrame:
+        case ET_ArenaScratch:
+            gf3d_bench_engine_arena(param);
+            break;
+        case ET_AllocateSmall:
+        case ET_AllocateLarge:
+            // sizes vary like real requests do, so the allocator cannot serve every request from one bin
+            for (i = 0; i < ALLOCATION_COUNT; i++)
+            {
+                size = (param == ET_AllocateSmall)?16 + (i % 16) * 16:4096 + (i % 16) * 4096;
+                bench.allocations[i] = gf3d_allocate_array(size,1);
+            }
+            for (i = 0; i < ALLOCATION_COUNT; i++)
+            {
+                free(bench.allocations[i]);
+            }
+            break;
+        case ET_AllocateTracked:
+            // the small mix again, the difference is what tracking costs
+            for (i = 0; i < ALLOCATION_COUNT; i++)
+            {
+                bench.allocations[i] = gf3d_memory_allocate(MT_General,16 + (i % 16) * 16,1);
+            }
+            for (i = 0; i < ALLOCATION_COUNT; i++)
+            {
+                gf3d_memory_free(bench.allocations[i]);
+            }
+            break;
+        case ET_Log:
+        case ET_LogSync:
+            for (i = 0; i < LOG_COUNT; i++)
+            {
+                slog("benchmark line %i of %i: %f",i,LOG_COUNT,i * 0.5f);
+            }
+            // slog only costs the caller the format, waiting for the writes measures the logger thread too
+            if (param == ET_LogSync)slog_sync();
+            break;
+        case ET_TraceZone:
+            gf3d_trace_set_enabled(true);
+            for (i = 0; i < TRACE_COUNT; i++)
+            {
+                GF3D_TRACE_BEGIN("bench zone");
+                GF3D_TRACE_END();
+            }
+            gf3d_trace_set_enabled(false);
+            break;
+        case ET_LoadShader:
+            for (i = 0; i < LOAD_COUNT; i++)
+            {
+                data = gf3d_shaders_load_data((char *)bench.shader,&size);
+                if (data)gf3d_memory_free(data);
+            }
+            break;
+    }
+}
+
+void gf3d_bench_engine_register()
+{
+    int i;
+    size_t size;
+    char *data;
+    FILE *file;
+
+    bench.allocations = (void **)gf3d_allocate_array(sizeof(void *),ALLOCATION_COUNT);
+    if (!bench.allocations)
+    {
+        gf3d_bench_fail("engine","failed to allocate benchmark data");
+        return;
+    }
+    gf3d_bench_add("allocate_array.small",ALLOCATION_COUNT,NULL,gf3d_bench_engine_run,ET_AllocateSmall);
+    gf3d_bench_add("allocate_array.large",ALLOCATION_COUNT,NULL,gf3d_bench_engine_run,ET_AllocateLarge);
+    gf3d_bench_add("memory_allocate.small",ALLOCATION_COUNT,NULL,gf3d_bench_engine_run,ET_AllocateTracked);
+
+    // each run begins a frame, the frame arena main sets up holds one run's allocations
+    gf3d_bench_add("arena.frame",ALLOCATION_COUNT,NULL,gf3d_bench_engine_run,ET_ArenaFrame);
+    gf3d_bench_add("arena.scratch",ALLOCATION_COUNT,NULL,gf3d_bench_engine_run,ET_ArenaScratch);
+    gf3d_bench_add("logger.slog",LOG_COUNT,gf3d_bench_engine_prepare,gf3d_bench_engine_run,ET_Log);
+    gf3d_bench_add("logger.slog_sync",LOG_COUNT,gf3d_bench_engine_prepare,gf3d_bench_engine_run,ET_LogSync);
+
+    // room for one run's zones, cleared before each run.  Nothing is written out
+    gf3d_trace_init(TRACE_COUNT * 2,NULL);
+    gf3d_trace_set_enabled(false);
+    gf3d_bench_add("trace.zone",TRACE_COUNT,gf3d_bench_engine_prepare,gf3d_bench_engine_run,ET_TraceZone);
+
+    for (i = 0; shaderFiles[i]; i++)
+    {
+        file = fopen(shaderFiles[i],"rb");
+        if (!file)continue;
+        fclose(file);
+        bench.shader = shaderFiles[i];
+        break;
+    }
+    if (!bench.shader)
+    {
+        printf("no shader files found, run from the project directory to benchmark shader loading\n");
+        return;
+    }
+    data = gf3d_shaders_load_data((char *)bench.shader,&size);
+    if ((!data)||(size < 4)||(*(Uint32 *)data != 0x07230203))
+    {
+        gf3d_bench_fail("shaders.load_data","did not load a SPIR-V module");
+        if (data)gf3d_memory_free(data);
+        return;
+    }
+    gf3d_memory_free(data);
+    gf3d_bench_add("shaders.load_data",LOAD_COUNT,NULL,gf3d_bench_engine_run,ET_LoadShader);
+}
+
+/*eol@eof*/
@@ -0,0 +1,261 @@
+/**
+ * @purpose job system benchmarks: the cost of starting and waiting on empty jobs, a parallel_for over a million items
+ * against the same loop on one thread, and a chain of jobs each held until the one before it finishes
+ * before timing, the job system is checked: every item of a parallel_for visited exactly once, a chain running in
+ * order, jobs that start jobs and wait on them, and jobs started and waited on from a thread that is not a worker
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_jobs.h"
+
+#define JOBS_EMPTY_COUNT    10000
+#define JOBS_FOR_COUNT      1000000
+#define JOBS_CHAIN_COUNT    1000
+#define JOBS_CHECK_COUNT    100000
+#define JOBS_NESTED_COUNT   64
+
+typedef enum
+{
+    JT_Empty = 0,
+    JT_ParallelFor,
+    JT_SerialFor,
+    JT_Chain,
+    JT_MAX
+}JobsTest;
+
+typedef struct
+{
+    float          *values;         /**<what the for cases work on*/
+    Uint32         *visits;         /**<how often the check parallel_for saw each item*/
+    Uint64         *sums;           /**<one per thread*/
+    JobCounter     *chain;          /**<one counter per link of the chain*/
+    Uint32         *order;          /**<the chain links in the order they ran*/
+    SDL_atomic_t    orderCount;
+    SDL_atomic_t    nested;
+    Bool            ready;
+}JobsBench;
+
+static JobsBench bench = {0};
+
+static const char *jobsNames[JT_MAX] = {
+    "jobs.run_wait.empty.10k",
+    "jobs.parallel_for.1m",
+    "jobs.serial_for.1m",
+    "jobs.chain.1k"
+};
+
+static void gf3d_bench_jobs_empty(void *data)
+{
+}
+
+/**
+ * @brief the work both for cases do, a little arithmetic per item so the split and not the loop is measured
+ */
+static void gf3d_bench_jobs_for(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 i;
+    float *values = bench.values;
+    for (i = first; i < last; i++)
+    {
+        values[i] = sqrtf(values[i] * 0.5f + 1.0f);
+    }
+}
+
+static void gf3d_bench_jobs_link(void *data)
+{
+    int position = SDL_AtomicAdd(&bench.orderCount,1);
+    bench.order[position] = (Uint32)(size_t)data;
+}
+
+/**
+ * CHECKS
+ */
+
+static void gf3d_bench_jobs_visit(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 i;
+    for (i = first; i < last; i++)
+    {
+        bench.visits[i]++;
+        bench.sums[thread] += i;
+    }
+}
+
+static void gf3d_bench_jobs_nested_leaf(void *data)
+{
+    SDL_AtomicIncRef(&bench.nested);
+}
+
+/**
+ * @brief a job that starts jobs of its own and waits for them, which only finishes if waiting helps
+ */
+static void gf3d_bench_jobs_nested(void *data)
+{
+    int i;
+    JobCounter counter = {0};
+    for (i = 0; i < JOBS_NESTED_COUNT; i++)
+    {
+        gf3d_jobs_run(gf3d_bench_jobs_nested_leaf,NULL,&counter);
+    }
+    gf3d_jobs_wait(&counter);
+}
+
+/**
+ * @brief start and wait on jobs from a thread the job system does not own
+ */
+static int gf3d_bench_jobs_outsider(void *data)
+{
+    int i;
+    JobCounter counter = {0};
+    for (i = 0; i < JOBS_NESTED_COUNT; i++)
+    {
+        gf3d_jobs_run(gf3d_bench_jobs_nested_leaf,NULL,&counter);
+    }
+    gf3d_jobs_wait(&counter);
+    return (int)gf3d_jobs_done(&counter);
+}
+
+/**
+ * @brief start a chain where each link waits for the one before it
+ * @param count how many links
+ */
+static void gf3d_bench_jobs_chain_start(Uint32 count)
+{
+    Uint32 i;
+    memset(bench.chain,0,sizeof(JobCounter) * count);
+    SDL_AtomicSet(&bench.orderCount,0);
+    gf3d_jobs_run(gf3d_bench_jobs_link,(void *)(size_t)0,&bench.chain[0]);
+    for (i = 1; i < count; i++)
+    {
+        gf3d_jobs_run_after(&bench.chain[i - 1],gf3d_bench_jobs_link,(void *)(size_t)i,&bench.chain[i]);
+    }
+}
+
+static Bool gf3d_bench_jobs_check()
+{
+    int i;
+    int result = 0;
+    Uint64 sum = 0;
+    Uint32 threads = gf3d_jobs_get_thread_count();
+    JobCounter counter = {0};
+    SDL_Thread *outsider;
+
+    memset(bench.sums,0,sizeof(Uint64) * threads);
+    gf3d_jobs_parallel_for(JOBS_CHECK_COUNT,64,gf3d_bench_jobs_visit,NULL);
+    for (i = 0; i < JOBS_CHECK_COUNT; i++)
+    {
+        if (bench.visits[i] != 1)
+        {
+            gf3d_bench_fail("jobs.parallel_for","an item was not visited exactly once");
+            return false;
+        }
+    }
+    for (i = 0; i < threads; i++)sum += bench.sums[i];
+    if (sum != (Uint64)JOBS_CHECK_COUNT * (JOBS_CHECK_COUNT - 1) / 2)
+    {
+        gf3d_bench_fail("jobs.parallel_for","per thread sums do not add up");
+        return false;
+    }
+
+    gf3d_bench_jobs_chain_start(JOBS_CHAIN_COUNT);
+    gf3d_jobs_wait(&bench.chain[JOBS_CHAIN_COUNT - 1]);
+    for (i = 0; i < JOBS_CHAIN_COUNT; i++)
+    {
+        if (bench.order[i] != i)
+        {
+            gf3d_bench_fail("jobs.run_after","a link ran before the one it waited for");
+            return false;
+        }
+    }
+
+    SDL_AtomicSet(&bench.nested,0);
+    for (i = 0; i < JOBS_NESTED_COUNT; i++)
+    {
+        gf3d_jobs_run(gf3d_bench_jobs_nested,NULL,&counter);
+    }
+    gf3d_jobs_wait(&counter);
+    if (SDL_AtomicGet(&bench.nested) != JOBS_NESTED_COUNT * JOBS_NESTED_COUNT)
+    {
+        gf3d_bench_fail("jobs.wait","jobs started from jobs did not all run");
+        return false;
+    }
+
+    SDL_AtomicSet(&bench.nested,0);
+    outsider = SDL_CreateThread(gf3d_bench_jobs_outsider,"gf3d_bench_jobs",NULL);
+    if (outsider)SDL_WaitThread(outsider,&result);
+    if ((!result)||(SDL_AtomicGet(&bench.nested) != JOBS_NESTED_COUNT))
+    {
+        gf3d_bench_fail("jobs.run","jobs started from another thread did not all run");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * CASES
+ */
+
+void gf3d_bench_jobs_prepare(int param)
+{
+    int i;
+    if ((param != JT_ParallelFor)&&(param != JT_SerialFor))return;
+    for (i = 0; i < JOBS_FOR_COUNT; i++)bench.values[i] = (float)(i & 1023);
+}
+
+void gf3d_bench_jobs_run(int param)
+{
+    int i;
+    JobCounter counter = {0};
+
+    if (!bench.ready)return;
+    switch (param)
+    {
+        case JT_Empty:
+            for (i = 0; i < JOBS_EMPTY_COUNT; i++)
+            {
+                gf3d_jobs_run(gf3d_bench_jobs_empty,NULL,&counter);
+            }
+            gf3d_jobs_wait(&counter);
+            break;
+        case JT_ParallelFor:
+            gf3d_jobs_parallel_for(JOBS_FOR_COUNT,0,gf3d_bench_jobs_for,NULL);
+            break;
+        case JT_SerialFor:
+            gf3d_bench_jobs_for(0,JOBS_FOR_COUNT,0,NULL);
+            break;
+        case JT_Chain:
+            gf3d_bench_jobs_chain_start(JOBS_CHAIN_COUNT);
+            gf3d_jobs_wait(&bench.chain[JOBS_CHAIN_COUNT - 1]);
+            break;
+    }
+}
+
+void gf3d_bench_jobs_register()
+{
+    static const Uint32 items[JT_MAX] = {JOBS_EMPTY_COUNT,JOBS_FOR_COUNT,JOBS_FOR_COUNT,JOBS_CHAIN_COUNT};
+    int i;
+
+    bench.values = (float *)gf3d_allocate_array(sizeof(float),JOBS_FOR_COUNT);
+    bench.visits = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),JOBS_CHECK_COUNT);
+    bench.sums = (Uint64 *)gf3d_allocate_array(sizeof(Uint64),gf3d_jobs_get_thread_count());
+    bench.chain = (JobCounter *)gf3d_allocate_array(sizeof(JobCounter),JOBS_CHAIN_COUNT);
+    bench.order = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),JOBS_CHAIN_COUNT);
+    if ((!bench.values)||(!bench.visits)||(!bench.sums)||(!bench.chain)||(!bench.order))
+    {
+        gf3d_bench_fail("jobs","failed to allocate bench data");
+        return;
+    }
+    if (!gf3d_bench_jobs_check())return;
+    bench.ready = true;
+    for (i = 0; i < JT_MAX; i++)
+    {
+        gf3d_bench_add(jobsNames[i],items[i],gf3d_bench_jobs_prepare,gf3d_bench_jobs_run,i);
+    }
+}
+
+/*eol@eof*/
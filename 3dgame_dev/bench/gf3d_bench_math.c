@@ -0,0 +1,683 @@
+/**
+ * @purpose math benchmarks: gf3d_matrix, gf3d_vector, gf3d_vector_stream, gf3d_quaternion and gf3d_transform
+ * every kernel set the CPU supports is checked against the scalar one and then timed on the same inputs:
+ * matrix products, affine point transforms, transposes and vector streams must match bit for bit, vector transforms
+ * (scalar runs in double) must stay within the rounding error bound of a float dot product.  Inverses and normal
+ * matrices are checked by how far M * inverse is from the identity, gf3d_matrix_decompose by getting back what
+ * gf3d_matrix_compose used, and transform world matrices against a recursive rebuild
+ * compose and decompose are scalar only, so they get a single scalar case each
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_matrix.h"
+#include "gf3d_vector.h"
+#include "gf3d_vector_stream.h"
+#include "gf3d_quaternion.h"
+#include "gf3d_transform.h"
+
+#define MATRIX_COUNT    4096        // small enough to stay in cache, this measures the math
+#define POINT_COUNT     (1 << 16)
+#define NODE_COUNT      100000
+#define NODE_MOVES      1000
+#define RESIDUAL_LIMIT  64.0        // in FLT_EPSILON of the size of the terms, a well conditioned inverse lands near 1
+
+typedef enum
+{
+    MT_Multiply = 0,
+    MT_MultiplyArray,
+    MT_MultiplyPairs,
+    MT_TransformVector4D,
+    MT_TransformPoints,
+    MT_Invert,
+    MT_InvertAffine,
+    MT_InvertRigid,
+    MT_Transpose,
+    MT_Normal,
+    MT_Compose,
+    MT_Decompose,
+    MT_MAX
+}MatrixTest;
+
+typedef enum
+{
+    ST_Add = 0,
+    ST_ScaleAdd,
+    ST_Cross,
+    ST_Dot,
+    ST_Length,
+    ST_Normalize,
+    ST_MAX
+}StreamTest;
+
+typedef enum
+{
+    VT_Magnitude = 0,
+    VT_Normalize,
+    VT_Cross,
+    VT_Slerp,
+    VT_TransformFull,
+    VT_TransformSparse,
+    VT_MAX
+}ScalarTest;
+
+typedef struct
+{
+    Matrix4        *a;
+    Matrix4        *b;
+    Matrix4        *out;
+    Matrix4        *reference;
+    Vector4D       *vectors;
+    Vector4D       *vectorOut;
+    Vector4D       *vectorReference;
+    Vector3D       *points;
+    Vector3D       *pointOut;
+    Vector3D       *pointReference;
+    Matrix4        *trs;            /**<rotation * scale * translation, what most game transforms are*/
+    Matrix4        *rigid;          /**<rotation * translation*/
+    Matrix4        *general;        /**<trs with a projective column, so only the general inverse applies*/
+    Vector3D       *translations;   /**<the parts trs was composed from*/
+    Vector4D       *rotations;
+    Vector3D       *scales;
+    Vector3D       *translationOut;
+    Vector4D       *rotationOut;
+    Vector3D       *scaleOut;
+    VectorStream3D  streamA;
+    VectorStream3D  streamB;
+    VectorStream3D  streamOut;
+    VectorStream3D  streamReference;
+    float          *floatOut;
+    float          *floatReference;
+    Sint32         *nodes;          /**<transform node ids, by creation order*/
+    Sint32         *nodeParents;    /**<index into nodes of each node's parent, -1 for roots*/
+    Uint32         *moves;          /**<nodes moved by the sparse transform update*/
+}MathBench;
+
+static MathBench bench = {0};
+
+static const char *matrixNames[MT_MAX] = {
+    "multiply","multiply_array","multiply_pairs","transform_vector4d","transform_points",
+    "invert","invert_affine","invert_rigid","transpose","normal","compose","decompose"};
+static const char *streamNames[ST_MAX] = {"add","scale_add","cross","dot","length","normalize"};
+
+float gf3d_bench_math_random()
+{
+    return ((rand() / (float)RAND_MAX) * 2.0f) - 1.0f;
+}
+
+/**
+ * MATRIX
+ * param is test * MS_MAX + simd
+ */
+
+void gf3d_bench_matrix_prepare(int param)
+{
+    gf3d_matrix_simd_set(param % MS_MAX);
+}
+
+void gf3d_bench_matrix_run(int param)
+{
+    int i;
+    switch (param / MS_MAX)
+    {
+        case MT_Multiply:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_multiply(bench.out[i],bench.a[i],bench.b[i]);
+            break;
+        case MT_MultiplyArray:
+            gf3d_matrix_multiply_array(bench.out,bench.a[0],bench.b,MATRIX_COUNT);
+            break;
+        case MT_MultiplyPairs:
+            gf3d_matrix_multiply_pairs(bench.out,bench.a,bench.b,MATRIX_COUNT);
+            break;
+        case MT_TransformVector4D:
+            gf3d_matrix_transform_vector4d_array(bench.vectorOut,bench.a[0],bench.vectors,POINT_COUNT);
+            break;
+        case MT_TransformPoints:
+            gf3d_matrix_transform_points(bench.pointOut,bench.a[0],bench.points,POINT_COUNT);
+            break;
+        case MT_Invert:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_invert(bench.out[i],bench.general[i]);
+            break;
+        case MT_InvertAffine:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_invert_affine(bench.out[i],bench.trs[i]);
+            break;
+        case MT_InvertRigid:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_invert_rigid(bench.out[i],bench.rigid[i]);
+            break;
+        case MT_Transpose:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_transpose(bench.out[i],bench.a[i]);
+            break;
+        case MT_Normal:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_normal(bench.out[i],bench.trs[i]);
+            break;
+        case MT_Compose:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_compose(bench.out[i],bench.translations[i],bench.rotations[i],bench.scales[i]);
+            break;
+        case MT_Decompose:
+            for (i = 0; i < MATRIX_COUNT; i++)gf3d_matrix_decompose(bench.trs[i],&bench.translationOut[i],&bench.rotationOut[i],&bench.scaleOut[i]);
+            break;
+    }
+}
+
+/**
+ * @brief worst error of the transformed vectors as a fraction of the float error bound of a 4 term dot product
+ * @note the bound is 4 * FLT_EPSILON * sum |v[k] * m[k][j]|: a plain relative error blows up when the terms cancel
+ * @return 1 or less when every component is within the bound
+ */
+double gf3d_bench_vector_error(Vector4D *out,Vector4D *reference,Matrix4 mat,Vector4D *vec,Uint32 count)
+{
+    int i,j;
+    float *o,*r,*v;
+    double bound,error,worst = 0;
+    for (i = 0; i < count; i++)
+    {
+        o = &out[i].x;
+        r = &reference[i].x;
+        v = &vec[i].x;
+        for (j = 0; j < 4; j++)
+        {
+            bound = fabs(v[0] * mat[0][j]) + fabs(v[1] * mat[1][j]) + fabs(v[2] * mat[2][j]) + fabs(v[3] * mat[3][j]);
+            bound = 4.0 * FLT_EPSILON * bound + FLT_MIN;
+            error = fabs((double)o[j] - (double)r[j]) / bound;
+            if (error > worst)worst = error;
+        }
+    }
+    return worst;
+}
+
+/**
+ * @brief worst distance of the upper size x size block of a * b from the identity, in FLT_EPSILON of |row| * |column|
+ * @note checks an inverse against its matrix without trusting any of the kernels being tested.  The bound is normwise
+ * because the fast inverses assume an exactly orthogonal rotation and a float one is only orthogonal to within epsilon
+ */
+double gf3d_bench_residual(Matrix4 a,Matrix4 b,int size)
+{
+    int i,j,k;
+    double sum,row,column,error,worst = 0;
+    for (i = 0; i < size; i++)
+    {
+        for (j = 0; j < size; j++)
+        {
+            sum = (i == j)?-1.0:0.0;
+            row = column = 0;
+            for (k = 0; k < size; k++)
+            {
+                sum += (double)a[i][k] * (double)b[k][j];
+                row += (double)a[i][k] * (double)a[i][k];
+                column += (double)b[k][j] * (double)b[k][j];
+            }
+            error = fabs(sum) / (FLT_EPSILON * sqrt(row * column) + FLT_MIN);
+            if (error > worst)worst = error;
+        }
+    }
+    return worst;
+}
+
+/**
+ * @brief worst residual of a list of inverses, or of normal matrices when normal is set
+ */
+double gf3d_bench_inverse_error(Matrix4 *in,Matrix4 *inverse,Uint32 count,Bool normal)
+{
+    int i,j,k;
+    double error,worst = 0;
+    Matrix4 transposed;
+    for (i = 0; i < count; i++)
+    {
+        if (normal)
+        {
+            // the normal matrix is the transposed inverse of the upper 3x3
+            for (j = 0; j < 4; j++)
+            {
+                for (k = 0; k < 4; k++)transposed[j][k] = inverse[i][k][j];
+            }
+            error = gf3d_bench_residual(in[i],transposed,3);
+        }
+        else error = gf3d_bench_residual(in[i],inverse[i],4);
+        if (error > worst)worst = error;
+    }
+    return worst;
+}
+
+/**
+ * @brief worst relative error of the decomposed parts against the ones the matrices were composed from
+ */
+double gf3d_bench_decompose_error(Uint32 count)
+{
+    int i;
+    double error,worst = 0;
+    for (i = 0; i < count; i++)
+    {
+        // q and -q are the same rotation
+        error = 1.0 - fabs(
+            bench.rotations[i].x * bench.rotationOut[i].x + bench.rotations[i].y * bench.rotationOut[i].y +
+            bench.rotations[i].z * bench.rotationOut[i].z + bench.rotations[i].w * bench.rotationOut[i].w);
+        if (error > worst)worst = error;
+        error = fabs(bench.scaleOut[i].x - bench.scales[i].x) / fabs(bench.scales[i].x);
+        if (error > worst)worst = error;
+        error = fabs(bench.scaleOut[i].y - bench.scales[i].y) / fabs(bench.scales[i].y);
+        if (error > worst)worst = error;
+        error = fabs(bench.scaleOut[i].z - bench.scales[i].z) / fabs(bench.scales[i].z);
+        if (error > worst)worst = error;
+        if (memcmp(&bench.translationOut[i],&bench.translations[i],sizeof(Vector3D)) != 0)return 1.0;
+    }
+    return worst;
+}
+
+/**
+ * @brief check one matrix test with the kernels currently set against the scalar results saved by the first call
+ */
+void gf3d_bench_matrix_check(MatrixTest test,MatrixSimd simd)
+{
+    char name[128];
+    char detail[128];
+    double error;
+    Bool match = true;
+
+    snprintf(name,sizeof(name),"matrix.%s.%s",matrixNames[test],gf3d_matrix_simd_name(simd));
+    detail[0] = 0;
+    gf3d_bench_matrix_prepare(test * MS_MAX + simd);
+    gf3d_bench_matrix_run(test * MS_MAX + simd);
+    switch (test)
+    {
+        case MT_Multiply:
+        case MT_MultiplyArray:
+        case MT_MultiplyPairs:
+        case MT_Transpose:
+        case MT_Compose:
+            if (simd == MS_Scalar)memcpy(bench.reference,bench.out,sizeof(Matrix4) * MATRIX_COUNT);
+            match = (memcmp(bench.reference,bench.out,sizeof(Matrix4) * MATRIX_COUNT) == 0);
+            if ((match)&&(test == MT_Compose))match = (memcmp(bench.trs,bench.out,sizeof(Matrix4) * MATRIX_COUNT) == 0);
+            snprintf(detail,sizeof(detail),"not bit exact");
+            break;
+        case MT_TransformVector4D:
+            if (simd == MS_Scalar)memcpy(bench.vectorReference,bench.vectorOut,sizeof(Vector4D) * POINT_COUNT);
+            error = gf3d_bench_vector_error(bench.vectorOut,bench.vectorReference,bench.a[0],bench.vectors,POINT_COUNT);
+            match = (error <= 1.0);
+            snprintf(detail,sizeof(detail),"worst error %.0f%% of the bound",error * 100.0);
+            break;
+        case MT_TransformPoints:
+            if (simd == MS_Scalar)memcpy(bench.pointReference,bench.pointOut,sizeof(Vector3D) * POINT_COUNT);
+            match = (memcmp(bench.pointReference,bench.pointOut,sizeof(Vector3D) * POINT_COUNT) == 0);
+            snprintf(detail,sizeof(detail),"not bit exact");
+            break;
+        case MT_Invert:
+        case MT_InvertAffine:
+        case MT_InvertRigid:
+        case MT_Normal:
+            error = gf3d_bench_inverse_error(
+                (test == MT_Invert)?bench.general:(test == MT_InvertRigid)?bench.rigid:bench.trs,
+                bench.out,
+                MATRIX_COUNT,
+                (test == MT_Normal));
+            match = (error <= RESIDUAL_LIMIT);
+            snprintf(detail,sizeof(detail),"worst residual %.1f epsilon",error);
+            break;
+        case MT_Decompose:
+            error = gf3d_bench_decompose_error(MATRIX_COUNT);
+            match = (error <= RESIDUAL_LIMIT * FLT_EPSILON);
+            snprintf(detail,sizeof(detail),"worst round trip error %.1f epsilon",error / FLT_EPSILON);
+            break;
+        default:
+            break;
+    }
+    if (!match)gf3d_bench_fail(name,detail);
+}
+
+/**
+ * VECTOR STREAMS
+ * param is test * MS_MAX + simd
+ */
+
+void gf3d_bench_stream_prepare(int param)
+{
+    gf3d_vector_stream_simd_set(param % MS_MAX);
+}
+
+void gf3d_bench_stream_run(int param)
+{
+    switch (param / MS_MAX)
+    {
+        case ST_Add:
+            gf3d_vector_stream3d_add(bench.streamOut,bench.streamA,bench.streamB,POINT_COUNT);
+            break;
+        case ST_ScaleAdd:
+            gf3d_vector_stream3d_scale_add(bench.streamOut,bench.streamA,bench.streamB,0.016f,POINT_COUNT);
+            break;
+        case ST_Cross:
+            gf3d_vector_stream3d_cross(bench.streamOut,bench.streamA,bench.streamB,POINT_COUNT);
+            break;
+        case ST_Dot:
+            gf3d_vector_stream3d_dot(bench.floatOut,bench.streamA,bench.streamB,POINT_COUNT);
+            break;
+        case ST_Length:
+            gf3d_vector_stream3d_length(bench.floatOut,bench.streamA,POINT_COUNT);
+            break;
+        case ST_Normalize:
+            gf3d_vector_stream3d_normalize(bench.streamOut,bench.streamA,POINT_COUNT);
+            break;
+    }
+}
+
+void gf3d_bench_stream_check(StreamTest test,MatrixSimd simd)
+{
+    char name[128];
+    Bool match;
+    size_t size = sizeof(float) * POINT_COUNT;
+
+    snprintf(name,sizeof(name),"vector_stream.%s.%s",streamNames[test],gf3d_matrix_simd_name(simd));
+    gf3d_bench_stream_prepare(test * MS_MAX + simd);
+    gf3d_bench_stream_run(test * MS_MAX + simd);
+    if ((test == ST_Dot)||(test == ST_Length))
+    {
+        if (simd == MS_Scalar)memcpy(bench.floatReference,bench.floatOut,size);
+        match = (memcmp(bench.floatReference,bench.floatOut,size) == 0);
+    }
+    else
+    {
+        if (simd == MS_Scalar)
+        {
+            memcpy(bench.streamReference.x,bench.streamOut.x,size);
+            memcpy(bench.streamReference.y,bench.streamOut.y,size);
+            memcpy(bench.streamReference.z,bench.streamOut.z,size);
+        }
+        match = ((memcmp(bench.streamReference.x,bench.streamOut.x,size) == 0)&&
+                 (memcmp(bench.streamReference.y,bench.streamOut.y,size) == 0)&&
+                 (memcmp(bench.streamReference.z,bench.streamOut.z,size) == 0));
+    }
+    if (!match)gf3d_bench_fail(name,"not bit exact");
+}
+
+/**
+ * SCALAR MATH
+ * gf3d_vector, gf3d_quaternion and gf3d_transform have one implementation, param is the test
+ */
+
+void gf3d_bench_scalar_prepare(int param)
+{
+    int i;
+    Uint32 node;
+    switch (param)
+    {
+        case VT_TransformFull:
+            // moving every root rebuilds every world matrix
+            for (i = 0; i < NODE_COUNT; i++)
+            {
+                if (bench.nodeParents[i] < 0)gf3d_transform_set_position(bench.nodes[i],bench.points[i % POINT_COUNT]);
+            }
+            break;
+        case VT_TransformSparse:
+            for (i = 0; i < NODE_MOVES; i++)
+            {
+                node = bench.moves[i];
+                gf3d_transform_set_position(bench.nodes[node],bench.points[node % POINT_COUNT]);
+            }
+            break;
+    }
+}
+
+void gf3d_bench_scalar_run(int param)
+{
+    int i;
+    float sum = 0;
+    switch (param)
+    {
+        case VT_Magnitude:
+            for (i = 0; i < POINT_COUNT; i++)sum += vector3d_magnitude(bench.points[i]);
+            bench.floatOut[0] = sum;
+            break;
+        case VT_Normalize:
+            memcpy(bench.pointOut,bench.points,sizeof(Vector3D) * POINT_COUNT);
+            for (i = 0; i < POINT_COUNT; i++)vector3d_normalize(&bench.pointOut[i]);
+            break;
+        case VT_Cross:
+            for (i = 0; i < POINT_COUNT - 1; i++)vector3d_cross_product(&bench.pointOut[i],bench.points[i],bench.points[i + 1]);
+            break;
+        case VT_Slerp:
+            for (i = 0; i < MATRIX_COUNT - 1; i++)
+            {
+                gf3d_quaternion_slerp(&bench.rotationOut[i],bench.rotations[i],bench.rotations[i + 1],(i & 15) / 15.0f);
+            }
+            break;
+        case VT_TransformFull:
+        case VT_TransformSparse:
+            gf3d_transform_update();
+            break;
+    }
+}
+
+/**
+ * @brief rebuild the world matrix of a node the slow way, from its ancestors' local transforms
+ */
+void gf3d_bench_transform_reference(Matrix4 out,Uint32 index)
+{
+    Matrix4 local,parent;
+    Vector3D position,scale;
+    Quaternion rotation;
+    gf3d_transform_get_local(bench.nodes[index],&position,&rotation,&scale);
+    gf3d_matrix_compose(local,position,rotation,scale);
+    if (bench.nodeParents[index] < 0)
+    {
+        gf3d_matrix_copy(out,local);
+        return;
+    }
+    gf3d_bench_transform_reference(parent,bench.nodeParents[index]);
+    gf3d_matrix_multiply(out,parent,local);
+}
+
+void gf3d_bench_transform_check()
+{
+    int i,j,k;
+    Matrix4 world,reference;
+    char detail[128];
+    gf3d_bench_scalar_prepare(VT_TransformSparse);
+    gf3d_transform_update();
+    for (i = 0; i < NODE_COUNT; i += 97)
+    {
+        gf3d_transform_get_world(world,bench.nodes[i]);
+        gf3d_bench_transform_reference(reference,i);
+        for (j = 0; j < 4; j++)
+        {
+            for (k = 0; k < 4; k++)
+            {
+                if (fabs(world[j][k] - reference[j][k]) <= 1e-4 * (1 + fabs(reference[j][k])))continue;
+                snprintf(detail,sizeof(detail),"node %i world matrix differs from its ancestors' transforms",i);
+                gf3d_bench_fail("transform.update",detail);
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * SETUP
+ */
+
+/**
+ * @brief a random unit quaternion
+ */
+Vector4D gf3d_bench_math_rotation()
+{
+    Vector4D q;
+    float length;
+    do
+    {
+        vector4d_set(q,gf3d_bench_math_random(),gf3d_bench_math_random(),gf3d_bench_math_random(),gf3d_bench_math_random());
+        length = sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    }while (length < 0.1f);
+    vector4d_set(q,q.x / length,q.y / length,q.z / length,q.w / length);
+    return q;
+}
+
+Bool gf3d_bench_math_allocate()
+{
+    bench.a = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.b = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.out = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.reference = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.vectors = (Vector4D *)gf3d_allocate_array(sizeof(Vector4D),POINT_COUNT);
+    bench.vectorOut = (Vector4D *)gf3d_allocate_array(sizeof(Vector4D),POINT_COUNT);
+    bench.vectorReference = (Vector4D *)gf3d_allocate_array(sizeof(Vector4D),POINT_COUNT);
+    bench.points = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),POINT_COUNT);
+    bench.pointOut = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),POINT_COUNT);
+    bench.pointReference = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),POINT_COUNT);
+    bench.trs = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.rigid = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.general = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),MATRIX_COUNT);
+    bench.translations = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),MATRIX_COUNT);
+    bench.rotations = (Vector4D *)gf3d_allocate_array(sizeof(Vector4D),MATRIX_COUNT);
+    bench.scales = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),MATRIX_COUNT);
+    bench.translationOut = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),MATRIX_COUNT);
+    bench.rotationOut = (Vector4D *)gf3d_allocate_array(sizeof(Vector4D),MATRIX_COUNT);
+    bench.scaleOut = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),MATRIX_COUNT);
+    bench.floatOut = (float *)gf3d_allocate_array(sizeof(float),POINT_COUNT);
+    bench.floatReference = (float *)gf3d_allocate_array(sizeof(float),POINT_COUNT);
+    bench.nodes = (Sint32 *)gf3d_allocate_array(sizeof(Sint32),NODE_COUNT);
+    bench.nodeParents = (Sint32 *)gf3d_allocate_array(sizeof(Sint32),NODE_COUNT);
+    bench.moves = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),NODE_MOVES);
+    if ((!bench.a)||(!bench.b)||(!bench.out)||(!bench.reference)||(!bench.vectors)||(!bench.vectorOut)||
+        (!bench.vectorReference)||(!bench.points)||(!bench.pointOut)||(!bench.pointReference)||
+        (!bench.trs)||(!bench.rigid)||(!bench.general)||(!bench.translations)||(!bench.rotations)||(!bench.scales)||
+        (!bench.translationOut)||(!bench.rotationOut)||(!bench.scaleOut)||(!bench.floatOut)||(!bench.floatReference)||
+        (!bench.nodes)||(!bench.nodeParents)||(!bench.moves))
+    {
+        return false;
+    }
+    if ((!gf3d_vector_stream3d_new(&bench.streamA,POINT_COUNT))||(!gf3d_vector_stream3d_new(&bench.streamB,POINT_COUNT))||
+        (!gf3d_vector_stream3d_new(&bench.streamOut,POINT_COUNT))||(!gf3d_vector_stream3d_new(&bench.streamReference,POINT_COUNT)))
+    {
+        return false;
+    }
+    return true;
+}
+
+void gf3d_bench_math_fill()
+{
+    int i;
+    Vector3D one = {1,1,1};
+    Vector3D position;
+    for (i = 0; i < MATRIX_COUNT * 16; i++)
+    {
+        (&bench.a[0][0][0])[i] = gf3d_bench_math_random() * 10.0f;
+        (&bench.b[0][0][0])[i] = gf3d_bench_math_random() * 10.0f;
+    }
+    for (i = 0; i < POINT_COUNT; i++)
+    {
+        vector4d_set(bench.vectors[i],gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100,1);
+        vector3d_set(bench.points[i],gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100);
+    }
+    gf3d_vector_stream3d_load(bench.streamA,bench.points,POINT_COUNT);
+    for (i = 0; i < POINT_COUNT; i++)
+    {
+        bench.streamB.x[i] = gf3d_bench_math_random() * 100;
+        bench.streamB.y[i] = gf3d_bench_math_random() * 100;
+        bench.streamB.z[i] = gf3d_bench_math_random() * 100;
+    }
+    // normalize has to handle zero length vectors
+    bench.streamA.x[5] = bench.streamA.y[5] = bench.streamA.z[5] = 0;
+    for (i = 0; i < MATRIX_COUNT; i++)
+    {
+        vector3d_set(bench.translations[i],gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100,gf3d_bench_math_random() * 100);
+        bench.rotations[i] = gf3d_bench_math_rotation();
+        // scales from 0.5 to 2, one in eight mirrored
+        vector3d_set(bench.scales[i],powf(2,gf3d_bench_math_random()),powf(2,gf3d_bench_math_random()),powf(2,gf3d_bench_math_random()));
+        if ((i % 8) == 0)bench.scales[i].x = -bench.scales[i].x;
+        gf3d_matrix_compose(bench.trs[i],bench.translations[i],bench.rotations[i],bench.scales[i]);
+        gf3d_matrix_compose(bench.rigid[i],bench.translations[i],bench.rotations[i],one);
+        gf3d_matrix_copy(bench.general[i],bench.trs[i]);
+        bench.general[i][0][3] = gf3d_bench_math_random() * 0.1f;
+        bench.general[i][1][3] = gf3d_bench_math_random() * 0.1f;
+        bench.general[i][2][3] = gf3d_bench_math_random() * 0.1f;
+    }
+    // a forest of mostly deep, narrow trees, one root in fifty
+    gf3d_transform_init(NODE_COUNT);
+    for (i = 0; i < NODE_COUNT; i++)
+    {
+        bench.nodeParents[i] = ((i == 0)||(rand() % 50 == 0))?-1:(i - 1 - rand() % MIN(i,16));
+        bench.nodes[i] = gf3d_transform_new((bench.nodeParents[i] < 0)?-1:bench.nodes[bench.nodeParents[i]]);
+        vector3d_set(position,gf3d_bench_math_random(),gf3d_bench_math_random(),gf3d_bench_math_random());
+        gf3d_transform_set_local(bench.nodes[i],position,bench.rotations[i % MATRIX_COUNT],one);
+    }
+    gf3d_transform_update();
+    for (i = 0; i < NODE_MOVES; i++)
+    {
+        bench.moves[i] = rand() % NODE_COUNT;
+    }
+}
+
+static void gf3d_bench_math_close()
+{
+    gf3d_vector_stream3d_free(&bench.streamA);
+    gf3d_vector_stream3d_free(&bench.streamB);
+    gf3d_vector_stream3d_free(&bench.streamOut);
+    gf3d_vector_stream3d_free(&bench.streamReference);
+}
+
+void gf3d_bench_math_register()
+{
+    int test;
+    MatrixSimd simd,best,last;
+    char name[128];
+    const char *scalarNames[VT_MAX] = {
+        "vector.magnitude","vector.normalize","vector.cross_product","quaternion.slerp",
+        "transform.update.all","transform.update.sparse"};
+    Uint32 scalarItems[VT_MAX] = {POINT_COUNT,POINT_COUNT,POINT_COUNT - 1,MATRIX_COUNT - 1,NODE_COUNT,NODE_MOVES};
+
+    atexit(gf3d_bench_math_close);
+    if (!gf3d_bench_math_allocate())
+    {
+        gf3d_bench_fail("math","failed to allocate benchmark data");
+        return;
+    }
+    gf3d_bench_math_fill();
+
+    best = gf3d_matrix_simd_set(MS_MAX);
+    printf("best math kernels on this CPU: %s\n",gf3d_matrix_simd_name(best));
+    for (test = 0; test < MT_MAX; test++)
+    {
+        // compose and decompose have no kernels, other sets would time the same scalar code under their names
+        last = ((test == MT_Compose)||(test == MT_Decompose))?MS_Scalar:best;
+        for (simd = MS_Scalar; simd <= last; simd++)
+        {
+            gf3d_bench_matrix_check(test,simd);
+            snprintf(name,sizeof(name),"matrix.%s.%s",matrixNames[test],gf3d_matrix_simd_name(simd));
+            gf3d_bench_add(
+                name,
+                ((test == MT_TransformVector4D)||(test == MT_TransformPoints))?POINT_COUNT:MATRIX_COUNT,
+                gf3d_bench_matrix_prepare,
+                gf3d_bench_matrix_run,
+                test * MS_MAX + simd);
+        }
+    }
+    // in place use has to give the same answer as separate output
+    gf3d_matrix_simd_set(best);
+    gf3d_matrix_multiply_pairs(bench.out,bench.a,bench.b,MATRIX_COUNT);
+    memcpy(bench.reference,bench.b,sizeof(Matrix4) * MATRIX_COUNT);
+    gf3d_matrix_multiply_pairs(bench.reference,bench.a,bench.reference,MATRIX_COUNT);
+    if (memcmp(bench.reference,bench.out,sizeof(Matrix4) * MATRIX_COUNT) != 0)
+    {
+        gf3d_bench_fail("matrix.multiply_pairs","in place result differs");
+    }
+
+    for (test = 0; test < ST_MAX; test++)
+    {
+        for (simd = MS_Scalar; simd <= best; simd++)
+        {
+            gf3d_bench_stream_check(test,simd);
+            snprintf(name,sizeof(name),"vector_stream.%s.%s",streamNames[test],gf3d_matrix_simd_name(simd));
+            gf3d_bench_add(name,POINT_COUNT,gf3d_bench_stream_prepare,gf3d_bench_stream_run,test * MS_MAX + simd);
+        }
+    }
+
+    gf3d_bench_transform_check();
+    for (test = 0; test < VT_MAX; test++)
+    {
+        gf3d_bench_add(scalarNames[test],scalarItems[test],gf3d_bench_scalar_prepare,gf3d_bench_scalar_run,test);
+    }
+}
+
+/*eol@eof*/
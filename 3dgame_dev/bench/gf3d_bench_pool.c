@@ -0,0 +1,305 @@
+/**
+ * @purpose object pool benchmarks: gf3d_pool against the heap and against scanning for a free slot
+ * each size gets its own pool, made the first time one of its cases runs so filtered out sizes cost nothing.  Elements
+ * are freed in a shuffled order, so the free list ends up scattered the way it does in a running game.  Before timing,
+ * a small growing pool is checked: indices, lookups, double frees, walking the live elements and reuse
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_pool.h"
+
+#define POOL_SIZES          3
+#define POOL_CHUNK          4096
+#define POOL_CHECK_COUNT    4096
+#define POOL_FIXED_COUNT    8           // the size pipelines ask for, less than a chunk
+#define SCAN_COUNT          1000        // the scan is quadratic, larger sizes would only measure that
+
+typedef struct
+{
+    Bool        inUse;
+    float       position[3];
+    float       velocity[3];
+    Uint32      id;
+    float       data[4];
+}PoolObject;                            /**<48 bytes, about what a small game object component takes*/
+
+typedef enum
+{
+    PT_NewFree = 0,
+    PT_HeapNewFree,
+    PT_Iterate,
+    PT_MAX
+}PoolTest;
+
+typedef struct
+{
+    ObjectPool      pool;
+    Uint32         *order;              /**<a shuffled order to free in*/
+    Bool            ready;
+}PoolSize;
+
+typedef struct
+{
+    PoolSize        sizes[POOL_SIZES];
+    void          **objects;
+    PoolObject     *scanList;           /**<the preallocated array with in use flags the pool replaces*/
+    float           sum;                /**<written by the walk so it is not optimized away*/
+}PoolBench;
+
+static PoolBench bench = {0};
+
+static const Uint32 poolCounts[POOL_SIZES] = {1000,100000,1000000};
+static const char *poolNames[POOL_SIZES][PT_MAX] = {
+    {"pool.new_free.1k","heap.new_free.1k","pool.iterate.1k"},
+    {"pool.new_free.100k","heap.new_free.100k","pool.iterate.100k"},
+    {"pool.new_free.1m","heap.new_free.1m","pool.iterate.1m"}
+};
+
+/**
+ * @brief fill an array with 0 to count - 1 in a random order
+ */
+static void gf3d_bench_pool_shuffle(Uint32 *order,Uint32 count)
+{
+    Uint32 i,j,swap;
+    for (i = 0; i < count; i++)order[i] = i;
+    for (i = count - 1; i > 0; i--)
+    {
+        j = (((Uint32)rand() << 15) ^ (Uint32)rand()) % (i + 1);
+        swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+}
+
+/**
+ * @brief make the pool and order for a size the first time it is needed
+ * @return false if they could not be allocated
+ */
+static Bool gf3d_bench_pool_size_setup(int size)
+{
+    PoolSize *poolSize = &bench.sizes[size];
+    if (poolSize->ready)return true;
+    poolSize->order = (Uint32 *)gf3d_allocate_array(sizeof(Uint32),poolCounts[size]);
+    if (!poolSize->order)return false;
+    gf3d_bench_pool_shuffle(poolSize->order,poolCounts[size]);
+    // grows a chunk at a time during the first warmup run, after that the chunks are reused
+    if (!gf3d_pool_create_typed(&poolSize->pool,MT_General,PoolObject,POOL_CHUNK,0))return false;
+    poolSize->ready = true;
+    return true;
+}
+
+void gf3d_bench_pool_prepare(int param)
+{
+    int i;
+    int size = param / PT_MAX;
+    Uint32 cursor = 0;
+    PoolSize *poolSize = &bench.sizes[size];
+    PoolObject *object;
+    if (!gf3d_bench_pool_size_setup(size))
+    {
+        gf3d_bench_fail(poolNames[size][param % PT_MAX],"failed to allocate the pool");
+        return;
+    }
+    if ((param % PT_MAX) != PT_Iterate)return;
+    while ((object = gf3d_pool_next_typed(&poolSize->pool,PoolObject,&cursor)) != NULL)
+    {
+        gf3d_pool_free(&poolSize->pool,object);
+    }
+    // every element allocated, then a shuffled half freed: the walk has to skip scattered holes
+    for (i = 0; i < poolCounts[size]; i++)
+    {
+        object = gf3d_pool_new_typed(&poolSize->pool,PoolObject);
+        if (!object)break;
+        object->position[0] = (float)i;
+        bench.objects[i] = object;
+    }
+    for (i = 0; i < poolCounts[size] / 2; i++)
+    {
+        gf3d_pool_free(&poolSize->pool,bench.objects[poolSize->order[i]]);
+    }
+}
+
+void gf3d_bench_pool_run(int param)
+{
+    int i;
+    int size = param / PT_MAX;
+    Uint32 count = poolCounts[size];
+    Uint32 cursor = 0;
+    PoolSize *poolSize = &bench.sizes[size];
+    PoolObject *object;
+    float sum = 0;
+
+    if (!poolSize->ready)return;
+    switch (param % PT_MAX)
+    {
+        case PT_NewFree:
+            for (i = 0; i < count; i++)
+            {
+                object = gf3d_pool_new_typed(&poolSize->pool,PoolObject);
+                object->id = i;
+                bench.objects[i] = object;
+            }
+            for (i = 0; i < count; i++)
+            {
+                gf3d_pool_free(&poolSize->pool,bench.objects[poolSize->order[i]]);
+            }
+            break;
+        case PT_HeapNewFree:
+            for (i = 0; i < count; i++)
+            {
+                object = (PoolObject *)gf3d_allocate_array(sizeof(PoolObject),1);
+                object->id = i;
+                bench.objects[i] = object;
+            }
+            for (i = 0; i < count; i++)
+            {
+                free(bench.objects[poolSize->order[i]]);
+            }
+            break;
+        case PT_Iterate:
+            while ((object = gf3d_pool_next_typed(&poolSize->pool,PoolObject,&cursor)) != NULL)
+            {
+                sum += object->position[0];
+            }
+            bench.sum = sum;
+            break;
+    }
+}
+
+/**
+ * @brief the search gf3d_pool replaced: find the first slot not in use
+ */
+void gf3d_bench_pool_scan_run(int param)
+{
+    int i,j;
+    for (i = 0; i < SCAN_COUNT; i++)
+    {
+        for (j = 0; j < SCAN_COUNT; j++)
+        {
+            if (bench.scanList[j].inUse)continue;
+            bench.scanList[j].inUse = true;
+            bench.objects[i] = &bench.scanList[j];
+            break;
+        }
+    }
+    for (i = 0; i < SCAN_COUNT; i++)
+    {
+        ((PoolObject *)bench.objects[bench.sizes[0].order[i]])->inUse = false;
+    }
+}
+
+/**
+ * @brief check a small pool that has to grow, before trusting the timings
+ * @return false if anything was wrong
+ */
+static Bool gf3d_bench_pool_check()
+{
+    int i;
+    Sint32 index;
+    Uint32 cursor = 0;
+    Uint32 walked = 0;
+    Sint32 last = GF3D_POOL_NONE;
+    ObjectPool pool;
+    ObjectPool other;
+    PoolObject *object;
+    PoolObject **objects = (PoolObject **)bench.objects;
+    const char *name = "pool";
+
+    if (!gf3d_pool_create_typed(&pool,MT_General,PoolObject,64,0))return false;
+    if (!gf3d_pool_create_typed(&other,MT_General,PoolObject,POOL_FIXED_COUNT,1))
+    {
+        gf3d_pool_destroy(&pool);
+        return false;
+    }
+    for (i = 0; i < POOL_CHECK_COUNT; i++)
+    {
+        objects[i] = gf3d_pool_new_typed(&pool,PoolObject);
+        if (!objects[i])
+        {
+            gf3d_bench_fail(name,"a growing pool ran out of elements");
+            break;
+        }
+        if (((size_t)objects[i] % GF3D_POOL_ALIGNMENT)||(gf3d_pool_get_index(&pool,objects[i]) != i))
+        {
+            gf3d_bench_fail(name,"elements are misaligned or out of order");
+            break;
+        }
+        objects[i]->id = i;
+    }
+    if (gf3d_pool_get_index(&other,objects[5]) != GF3D_POOL_NONE)gf3d_bench_fail(name,"another pool claimed an element");
+    for (i = 0; i < POOL_CHECK_COUNT; i += 3)
+    {
+        gf3d_pool_free(&pool,objects[i]);
+    }
+    gf3d_pool_free(&pool,objects[0]);      // a second free is ignored
+    if (pool.count != POOL_CHECK_COUNT - (POOL_CHECK_COUNT + 2) / 3)gf3d_bench_fail(name,"wrong live count after freeing");
+    if ((gf3d_pool_get(&pool,0))||(gf3d_pool_get(&pool,1) != objects[1]))gf3d_bench_fail(name,"lookup by index is wrong");
+    while ((object = gf3d_pool_next_typed(&pool,PoolObject,&cursor)) != NULL)
+    {
+        index = gf3d_pool_get_index(&pool,object);
+        if ((index <= last)||(!(index % 3))||(object->id != index))
+        {
+            gf3d_bench_fail(name,"the walk returned a free element or went out of order");
+            break;
+        }
+        last = index;
+        walked++;
+    }
+    if (walked != pool.count)gf3d_bench_fail(name,"the walk missed live elements");
+    // freed elements come back before the pool grows, zeroed
+    object = gf3d_pool_new_typed(&pool,PoolObject);
+    if ((!object)||(gf3d_pool_get_index(&pool,object) % 3)||(object->id))gf3d_bench_fail(name,"a freed element was not reused");
+    if (gf3d_pool_get_capacity(&pool) != POOL_CHECK_COUNT)gf3d_bench_fail(name,"the pool grew when it had free elements");
+    // its chunk rounds up to 64 elements, the pool still stops at the size asked for
+    for (i = 0; i < POOL_FIXED_COUNT; i++)
+    {
+        if (!gf3d_pool_new(&other))gf3d_bench_fail(name,"a fixed size pool ran out early");
+    }
+    gf3d_bench_mute_stdout(true);   // the full pool logs
+    object = gf3d_pool_new_typed(&other,PoolObject);
+    gf3d_bench_mute_stdout(false);
+    if (object)gf3d_bench_fail(name,"a fixed size pool went past its size");
+    gf3d_pool_destroy(&pool);
+    gf3d_pool_destroy(&other);
+    return true;
+}
+
+static void gf3d_bench_pool_close()
+{
+    int i;
+    // sizes never set up are still zeroed, destroying them does nothing
+    for (i = 0; i < POOL_SIZES; i++)
+    {
+        gf3d_pool_destroy(&bench.sizes[i].pool);
+        free(bench.sizes[i].order);
+        bench.sizes[i].order = NULL;
+        bench.sizes[i].ready = false;
+    }
+}
+
+void gf3d_bench_pool_register()
+{
+    int i;
+    atexit(gf3d_bench_pool_close);
+    bench.objects = (void **)gf3d_allocate_array(sizeof(void *),poolCounts[POOL_SIZES - 1]);
+    bench.scanList = (PoolObject *)gf3d_allocate_array(sizeof(PoolObject),SCAN_COUNT);
+    if ((!bench.objects)||(!bench.scanList)||(!gf3d_bench_pool_check()))
+    {
+        gf3d_bench_fail("pool","failed to allocate benchmark data");
+        return;
+    }
+    for (i = 0; i < POOL_SIZES; i++)
+    {
+        gf3d_bench_add(poolNames[i][PT_NewFree],poolCounts[i],gf3d_bench_pool_prepare,gf3d_bench_pool_run,i * PT_MAX + PT_NewFree);
+        gf3d_bench_add(poolNames[i][PT_HeapNewFree],poolCounts[i],gf3d_bench_pool_prepare,gf3d_bench_pool_run,i * PT_MAX + PT_HeapNewFree);
+        gf3d_bench_add(poolNames[i][PT_Iterate],poolCounts[i],gf3d_bench_pool_prepare,gf3d_bench_pool_run,i * PT_MAX + PT_Iterate);
+    }
+    // shares the 1k shuffled order, the first prepare of the 1k size makes it
+    gf3d_bench_add("scan.new_free.1k",SCAN_COUNT,gf3d_bench_pool_prepare,gf3d_bench_pool_scan_run,PT_HeapNewFree);
+}
+
+/*eol@eof*/
@@ -0,0 +1,286 @@
+/**
+ * @purpose render submission benchmarks: instanced batching of 10k, 100k and 1m objects spread over 16 meshes and 4
+ * pipelines in a random order, timed separately for submitting, packing the instances and recording the draws, and
+ * the render queue sorting the same objects into state order
+ * there is no device, so the batcher packs into host memory and records without a command buffer: the record cases
+ * measure walking the groups, not the driver.  Before timing, the draw calls and binds a frame produces are checked
+ * against the groups that were submitted, at every size, along with objects past the limit being dropped, and the
+ * changes the queue counts after sorting are checked for opaque and for depth ordered layers
+ * the meshes and pipelines here are not in their systems' pools, so their keys share an index and the material alone,
+ * one per group, is what the queue sorts on
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_batch.h"
+#include "gf3d_render_queue.h"
+#include "gf3d_camera.h"
+#include "gf3d_matrix.h"
+
+#define RENDER_SIZES        3
+#define RENDER_MESHES       16
+#define RENDER_PIPELINES    4
+#define RENDER_GROUPS       (RENDER_MESHES * RENDER_PIPELINES)
+#define RENDER_MAX_OBJECTS  1000000
+#define RENDER_MODELS       1024        // distinct model matrices, reused so they stay in cache like a scene's would
+
+typedef enum
+{
+    BT_Submit = 0,
+    BT_Pack,
+    BT_Record,
+    BT_MAX
+}BatchTest;
+
+typedef struct
+{
+    Mesh        meshes[RENDER_MESHES];          /**<batching only compares them, so they need no buffers*/
+    Pipeline    pipelines[RENDER_PIPELINES];
+    Matrix4    *models;
+    Vector3D   *positions;          /**<in front of the camera, one per model*/
+    Uint8      *groups;             /**<the random group of every object*/
+}RenderBench;
+
+static RenderBench bench = {0};
+
+static const Uint32 renderCounts[RENDER_SIZES] = {10000,100000,1000000};
+static const char *batchNames[RENDER_SIZES][BT_MAX] = {
+    {"render.batch.submit.10k","render.batch.pack.10k","render.batch.record.10k"},
+    {"render.batch.submit.100k","render.batch.pack.100k","render.batch.record.100k"},
+    {"render.batch.submit.1m","render.batch.pack.1m","render.batch.record.1m"}
+};
+static const char *queueNames[RENDER_SIZES] = {"render.queue.sort.10k","render.queue.sort.100k","render.queue.sort.1m"};
+
+static void gf3d_bench_render_batch_submit(Uint32 count)
+{
+    int i;
+    Uint8 group;
+    gf3d_batch_begin();
+    for (i = 0; i < count; i++)
+    {
+        group = bench.groups[i];
+        gf3d_batch_submit(
+            &bench.meshes[group % RENDER_MESHES],
+            &bench.pipelines[group / RENDER_MESHES],
+            bench.models[i & (RENDER_MODELS - 1)]);
+    }
+}
+
+static void gf3d_bench_render_queue_submit(Uint32 count)
+{
+    int i;
+    Uint8 group;
+    gf3d_render_queue_begin();
+    for (i = 0; i < count; i++)
+    {
+        group = bench.groups[i];
+        gf3d_render_queue_submit(
+            RL_Opaque,
+            &bench.pipelines[group / RENDER_MESHES],
+            group,
+            &bench.meshes[group % RENDER_MESHES],
+            i & (RENDER_MODELS - 1),
+            bench.positions[i & (RENDER_MODELS - 1)]);
+    }
+}
+
+/**
+ * CHECKS
+ */
+
+/**
+ * @brief run a whole frame and compare its counters with the groups that were submitted
+ * @return false if they were wrong, after reporting it
+ */
+static Bool gf3d_bench_render_check_batch(Uint32 count,Uint32 extra)
+{
+    int i;
+    BatchStats stats;
+    Uint32 expected = (count < RENDER_GROUPS)?count:RENDER_GROUPS;
+
+    // the first objects cover every group before the random ones, as long as there are enough of them
+    gf3d_bench_render_batch_submit(count);
+    for (i = 0; i < extra; i++)
+    {
+        gf3d_batch_submit(&bench.meshes[0],&bench.pipelines[0],bench.models[0]);
+    }
+    gf3d_batch_end(0);
+    gf3d_batch_draw(VK_NULL_HANDLE,0);
+    gf3d_batch_get_stats(&stats);
+    if ((stats.submitted != count)||(stats.dropped != extra))
+    {
+        gf3d_bench_fail("render.batch","objects were dropped that fit, or kept that did not");
+        printf("  %u submitted and %u dropped, expected %u and %u\n",stats.submitted,stats.dropped,count,extra);
+        return false;
+    }
+    // groups are numbered mesh first, so the first few share a pipeline
+    if ((stats.groups != expected)||(stats.drawCalls != expected)||
+        (stats.pipelineBinds != (expected + RENDER_MESHES - 1) / RENDER_MESHES))
+    {
+        gf3d_bench_fail("render.batch","the draws do not match the groups submitted");
+        printf("  %u groups, %u draw calls and %u pipeline binds for %u objects\n",
+            stats.groups,stats.drawCalls,stats.pipelineBinds,count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief sort an opaque frame and compare the changes it counts with the groups that were submitted
+ * @return false if they were wrong, after reporting it
+ */
+static Bool gf3d_bench_render_check_queue(Uint32 count)
+{
+    RenderQueueStats stats;
+    Uint32 expected = (count < RENDER_GROUPS)?count:RENDER_GROUPS;
+    Uint32 pipelines = (expected + RENDER_MESHES - 1) / RENDER_MESHES;
+
+    gf3d_bench_render_queue_submit(count);
+    gf3d_render_queue_end();
+    gf3d_render_queue_get_stats(&stats);
+    if ((stats.submitted != count)||(stats.dropped))
+    {
+        gf3d_bench_fail("render.queue","objects were dropped that fit");
+        return false;
+    }
+    // sorted, every group is drawn in one run
+    if ((stats.pipelineBinds != pipelines)||(stats.materialChanges != expected)||(stats.meshBinds != expected))
+    {
+        gf3d_bench_fail("render.queue","the sorted changes do not match the groups submitted");
+        printf("  %u pipeline, %u material and %u mesh changes for %u groups\n",
+            stats.pipelineBinds,stats.materialChanges,stats.meshBinds,expected);
+        return false;
+    }
+    if ((stats.pipelineBindsAvoided < 0)||(stats.materialChangesAvoided < 0)||(stats.meshBindsAvoided < 0))
+    {
+        gf3d_bench_fail("render.queue","sorting by state added state changes");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief submit transparent draws already grouped by pipeline but interleaved in depth, so sorting back to front
+ * has to add pipeline changes and the counts saved come out negative
+ * @return false if they were wrong, after reporting it
+ */
+static Bool gf3d_bench_render_check_queue_depth()
+{
+    RenderQueueStats stats;
+
+    gf3d_render_queue_begin();
+    gf3d_render_queue_submit(RL_Transparent,&bench.pipelines[0],0,&bench.meshes[0],0,vector3d(0,0,-1));
+    gf3d_render_queue_submit(RL_Transparent,&bench.pipelines[0],0,&bench.meshes[0],1,vector3d(0,0,-3));
+    gf3d_render_queue_submit(RL_Transparent,&bench.pipelines[1],1,&bench.meshes[0],2,vector3d(0,0,-2));
+    gf3d_render_queue_submit(RL_Transparent,&bench.pipelines[1],1,&bench.meshes[0],3,vector3d(0,0,-4));
+    gf3d_render_queue_end();
+    gf3d_render_queue_get_stats(&stats);
+    if ((stats.pipelineBinds != 4)||(stats.pipelineBindsAvoided != -2)||(stats.materialChangesAvoided != -2))
+    {
+        gf3d_bench_fail("render.queue.depth","depth ordering should add two pipeline and two material changes");
+        printf("  %u pipeline changes, %i and %i avoided\n",
+            stats.pipelineBinds,stats.pipelineBindsAvoided,stats.materialChangesAvoided);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * CASES
+ */
+
+void gf3d_bench_render_batch_prepare(int param)
+{
+    Uint32 count = renderCounts[param / BT_MAX];
+    switch (param % BT_MAX)
+    {
+        case BT_Pack:
+            gf3d_bench_render_batch_submit(count);
+            break;
+        case BT_Record:
+            gf3d_bench_render_batch_submit(count);
+            gf3d_batch_end(0);
+            break;
+    }
+}
+
+void gf3d_bench_render_batch_run(int param)
+{
+    switch (param % BT_MAX)
+    {
+        case BT_Submit:
+            gf3d_bench_render_batch_submit(renderCounts[param / BT_MAX]);
+            break;
+        case BT_Pack:
+            gf3d_batch_end(0);
+            break;
+        case BT_Record:
+            gf3d_batch_draw(VK_NULL_HANDLE,0);
+            break;
+    }
+}
+
+void gf3d_bench_render_queue_prepare(int param)
+{
+    gf3d_bench_render_queue_submit(renderCounts[param]);
+}
+
+void gf3d_bench_render_queue_run(int param)
+{
+    gf3d_render_queue_end();
+}
+
+void gf3d_bench_render_register()
+{
+    int i,j;
+
+    gf3d_batch_init(1,RENDER_MAX_OBJECTS,RENDER_GROUPS);
+    gf3d_render_queue_init(RENDER_MAX_OBJECTS);
+    gf3d_camera_init(1);
+    gf3d_camera_look_at(vector3d(0,0,0),vector3d(0,0,-1),vector3d(0,1,0));
+    bench.models = (Matrix4 *)gf3d_allocate_array(sizeof(Matrix4),RENDER_MODELS);
+    bench.positions = (Vector3D *)gf3d_allocate_array(sizeof(Vector3D),RENDER_MODELS);
+    bench.groups = (Uint8 *)gf3d_allocate_array(sizeof(Uint8),RENDER_MAX_OBJECTS);
+    if ((!bench.models)||(!bench.positions)||(!bench.groups)||(!gf3d_batch_get_vertex_input()))
+    {
+        gf3d_bench_fail("render","failed to set up batching");
+        return;
+    }
+    srand(28);
+    for (i = 0; i < RENDER_MODELS; i++)
+    {
+        gf3d_matrix_identity(bench.models[i]);
+        bench.models[i][3][0] = (float)(rand() % 1000);
+        bench.models[i][3][2] = (float)(rand() % 1000);
+        bench.positions[i] = vector3d(bench.models[i][3][0] - 500,0,-1 - bench.models[i][3][2]);
+    }
+    for (i = 0; i < RENDER_MAX_OBJECTS; i++)
+    {
+        bench.groups[i] = (i < RENDER_GROUPS)?i:rand() % RENDER_GROUPS;
+    }
+    if (!gf3d_bench_render_check_batch(RENDER_MESHES + 1,0))return;
+    for (i = 0; i < RENDER_SIZES; i++)
+    {
+        if (!gf3d_bench_render_check_batch(renderCounts[i],0))return;
+    }
+    if (!gf3d_bench_render_check_batch(RENDER_MAX_OBJECTS,100))return;
+    if (!gf3d_bench_render_check_queue(RENDER_MESHES + 1))return;
+    for (i = 0; i < RENDER_SIZES; i++)
+    {
+        if (!gf3d_bench_render_check_queue(renderCounts[i]))return;
+    }
+    if (!gf3d_bench_render_check_queue_depth())return;
+    for (i = 0; i < RENDER_SIZES; i++)
+    {
+        for (j = 0; j < BT_MAX; j++)
+        {
+            gf3d_bench_add(batchNames[i][j],renderCounts[i],gf3d_bench_render_batch_prepare,gf3d_bench_render_batch_run,i * BT_MAX + j);
+        }
+        gf3d_bench_add(queueNames[i],renderCounts[i],gf3d_bench_render_queue_prepare,gf3d_bench_render_queue_run,i);
+    }
+}
+
+/*eol@eof*/
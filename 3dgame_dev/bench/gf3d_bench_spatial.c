@@ -0,0 +1,474 @@
+/**
+ * @purpose spatial index benchmarks: 100k moving objects in a gf3d_spatial tree, timed for one step of moving all of
+ * them, and for sphere, box and ray queries against the tree they leave behind
+ * the 100k tree is built the first time one of its cases runs, so filtered out cases cost nothing.  Before timing, a
+ * smaller tree is checked against testing every object by hand: what each query finds, before and after the objects
+ * move, the closest hit of every ray, and rays parallel to an axis that start exactly on the side of a box.  A tree
+ * grown from a small capacity is checked to keep its node arrays in tracked scene memory and free all of them
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "gf3d_bench.h"
+#include "gf3d_spatial.h"
+#include "gf3d_memory.h"
+
+#define SPATIAL_OBJECTS         100000
+#define SPATIAL_WORLD_SIZE      1000.0f
+#define SPATIAL_CHECK_COUNT     2000
+#define SPATIAL_CHECK_SIZE      100.0f
+#define SPATIAL_CHECK_QUERIES   200
+#define SPATIAL_QUERIES         1000
+#define SPATIAL_QUERY_SIZE      20.0f       // sphere radius and box half size of a query
+#define SPATIAL_RAY_LENGTH      200.0f
+#define SPATIAL_MARGIN          0.5f
+#define SPATIAL_DT              (1.0f / 60.0f)
+
+typedef enum
+{
+    ST_Move = 0,
+    ST_QuerySphere,
+    ST_QueryAABB,
+    ST_Raycast,
+    ST_MAX
+}SpatialTest;
+
+typedef struct
+{
+    Vector3D    position;
+    Vector3D    velocity;
+    float       radius;
+    Sint32      proxy;
+}SpatialObject;
+
+typedef struct
+{
+    Vector3D    origin;
+    Vector3D    direction;      /**<normalized, so ray distances are in world units*/
+    Vector3D    center;         /**<center of the sphere and box queries*/
+}SpatialQuery;
+
+typedef struct
+{
+    SpatialTree    *tree;
+    SpatialTree    *checkTree;
+    SpatialObject  *objects;
+    SpatialQuery   *queries;
+    Uint8          *found;          /**<per object, set by the query callback*/
+    Uint32          hits;           /**<written by the cases so they are not optimized away*/
+    Bool            ready;          /**<the 100k tree exists*/
+}SpatialBench;
+
+static SpatialBench bench = {0};
+
+static const char *spatialNames[ST_MAX] = {
+    "spatial.move.100k","spatial.query_sphere.1k","spatial.query_aabb.1k","spatial.raycast.1k"
+};
+
+static float gf3d_bench_spatial_random(float min,float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static AABB gf3d_bench_spatial_box(Vector3D center,float halfSize)
+{
+    AABB box;
+    box.min = vector3d(center.x - halfSize,center.y - halfSize,center.z - halfSize);
+    box.max = vector3d(center.x + halfSize,center.y + halfSize,center.z + halfSize);
+    return box;
+}
+
+/**
+ * @brief scatter objects with random sizes and velocities and add them to a tree
+ */
+static Bool gf3d_bench_spatial_spawn(SpatialTree *tree,Uint32 count,float size)
+{
+    int i;
+    SpatialObject *object;
+    for (i = 0; i < count; i++)
+    {
+        object = &bench.objects[i];
+        object->position.x = gf3d_bench_spatial_random(0,size);
+        object->position.y = gf3d_bench_spatial_random(0,size);
+        object->position.z = gf3d_bench_spatial_random(0,size);
+        object->velocity.x = gf3d_bench_spatial_random(-5,5);
+        object->velocity.y = gf3d_bench_spatial_random(-5,5);
+        object->velocity.z = gf3d_bench_spatial_random(-5,5);
+        object->radius = gf3d_bench_spatial_random(0.25f,2.0f);
+        object->proxy = gf3d_spatial_insert(tree,gf3d_bench_spatial_box(object->position,object->radius),object);
+        if (object->proxy < 0)return false;
+    }
+    return true;
+}
+
+/**
+ * @brief move objects one step, bouncing off the walls of the world
+ */
+static void gf3d_bench_spatial_move(SpatialTree *tree,Uint32 count,float size)
+{
+    int i;
+    Vector3D displacement;
+    SpatialObject *object;
+    for (i = 0; i < count; i++)
+    {
+        object = &bench.objects[i];
+        displacement.x = object->velocity.x * SPATIAL_DT;
+        displacement.y = object->velocity.y * SPATIAL_DT;
+        displacement.z = object->velocity.z * SPATIAL_DT;
+        object->position.x += displacement.x;
+        object->position.y += displacement.y;
+        object->position.z += displacement.z;
+        if ((object->position.x < 0)||(object->position.x > size))object->velocity.x = -object->velocity.x;
+        if ((object->position.y < 0)||(object->position.y > size))object->velocity.y = -object->velocity.y;
+        if ((object->position.z < 0)||(object->position.z > size))object->velocity.z = -object->velocity.z;
+        gf3d_spatial_move(tree,object->proxy,gf3d_bench_spatial_box(object->position,object->radius),displacement);
+    }
+}
+
+static void gf3d_bench_spatial_make_queries(Uint32 count,float size)
+{
+    int i;
+    SpatialQuery *query;
+    for (i = 0; i < count; i++)
+    {
+        query = &bench.queries[i];
+        query->center.x = gf3d_bench_spatial_random(0,size);
+        query->center.y = gf3d_bench_spatial_random(0,size);
+        query->center.z = gf3d_bench_spatial_random(0,size);
+        query->origin.x = gf3d_bench_spatial_random(0,size);
+        query->origin.y = gf3d_bench_spatial_random(0,size);
+        query->origin.z = gf3d_bench_spatial_random(0,size);
+        query->direction.x = gf3d_bench_spatial_random(-1,1);
+        query->direction.y = gf3d_bench_spatial_random(-1,1);
+        query->direction.z = gf3d_bench_spatial_random(-1,1);
+        vector3d_normalize(&query->direction);
+    }
+}
+
+static Bool gf3d_bench_spatial_mark(Sint32 proxy,void *data,void *userData)
+{
+    bench.found[(SpatialObject *)data - bench.objects] = 1;
+    return true;
+}
+
+/**
+ * @brief ray against the sphere of an object
+ * @param userData the query the ray belongs to
+ */
+static float gf3d_bench_spatial_ray_sphere(Sint32 proxy,void *data,void *userData)
+{
+    SpatialObject *object = (SpatialObject *)data;
+    SpatialQuery *query = (SpatialQuery *)userData;
+    Vector3D offset;
+    float b,c,discriminant;
+
+    offset.x = query->origin.x - object->position.x;
+    offset.y = query->origin.y - object->position.y;
+    offset.z = query->origin.z - object->position.z;
+    b = offset.x * query->direction.x + offset.y * query->direction.y + offset.z * query->direction.z;
+    c = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z - object->radius * object->radius;
+    if (c <= 0)return 0;    // starts inside
+    discriminant = b * b - c;
+    if ((b > 0)||(discriminant < 0))return -1;
+    return -b - sqrtf(discriminant);
+}
+
+/**
+ * CHECKS
+ */
+
+/**
+ * @brief compare the sphere and box queries with testing every object's fat box by hand
+ * @return false if a query found different objects, after reporting it
+ */
+static Bool gf3d_bench_spatial_check_queries(const char *name)
+{
+    int i,j;
+    float d,distance;
+    Uint32 count,expected;
+    AABB fat,box;
+    SpatialQuery *query;
+
+    for (i = 0; i < SPATIAL_CHECK_QUERIES; i++)
+    {
+        query = &bench.queries[i];
+        memset(bench.found,0,SPATIAL_CHECK_COUNT);
+        count = gf3d_spatial_query_sphere(bench.checkTree,query->center,SPATIAL_QUERY_SIZE,gf3d_bench_spatial_mark,NULL);
+        expected = 0;
+        for (j = 0; j < SPATIAL_CHECK_COUNT; j++)
+        {
+            gf3d_spatial_get_fat_box(bench.checkTree,bench.objects[j].proxy,&fat);
+            distance = 0;
+            d = MAX(0,MAX(fat.min.x - query->center.x,query->center.x - fat.max.x));
+            distance += d * d;
+            d = MAX(0,MAX(fat.min.y - query->center.y,query->center.y - fat.max.y));
+            distance += d * d;
+            d = MAX(0,MAX(fat.min.z - query->center.z,query->center.z - fat.max.z));
+            distance += d * d;
+            if (distance > SPATIAL_QUERY_SIZE * SPATIAL_QUERY_SIZE)
+            {
+                if (bench.found[j])break;
+                continue;
+            }
+            if (!bench.found[j])break;
+            expected++;
+        }
+        if ((j < SPATIAL_CHECK_COUNT)||(count != expected))
+        {
+            gf3d_bench_fail(name,"a sphere query found different objects than testing every fat box");
+            return false;
+        }
+
+        memset(bench.found,0,SPATIAL_CHECK_COUNT);
+        box = gf3d_bench_spatial_box(query->center,SPATIAL_QUERY_SIZE);
+        count = gf3d_spatial_query_aabb(bench.checkTree,box,gf3d_bench_spatial_mark,NULL);
+        expected = 0;
+        for (j = 0; j < SPATIAL_CHECK_COUNT; j++)
+        {
+            gf3d_spatial_get_fat_box(bench.checkTree,bench.objects[j].proxy,&fat);
+            if ((fat.max.x < box.min.x)||(fat.min.x > box.max.x)||
+                (fat.max.y < box.min.y)||(fat.min.y > box.max.y)||
+                (fat.max.z < box.min.z)||(fat.min.z > box.max.z))
+            {
+                if (bench.found[j])break;
+                continue;
+            }
+            if (!bench.found[j])break;
+            expected++;
+        }
+        if ((j < SPATIAL_CHECK_COUNT)||(count != expected))
+        {
+            gf3d_bench_fail(name,"a box query found different objects than testing every fat box");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief compare the closest hit of every ray with testing every object's sphere by hand
+ * @return false if a ray hit something else, after reporting it
+ */
+static Bool gf3d_bench_spatial_check_rays(const char *name)
+{
+    int i,j;
+    Sint32 hit,expected;
+    float distance,closest,d;
+    SpatialQuery *query;
+
+    for (i = 0; i < SPATIAL_CHECK_QUERIES; i++)
+    {
+        query = &bench.queries[i];
+        hit = gf3d_spatial_raycast(
+            bench.checkTree,query->origin,query->direction,SPATIAL_RAY_LENGTH,gf3d_bench_spatial_ray_sphere,query,&distance);
+        expected = -1;
+        closest = SPATIAL_RAY_LENGTH;
+        for (j = 0; j < SPATIAL_CHECK_COUNT; j++)
+        {
+            d = gf3d_bench_spatial_ray_sphere(bench.objects[j].proxy,&bench.objects[j],query);
+            if ((d < 0)||(d > closest))continue;
+            closest = d;
+            expected = bench.objects[j].proxy;
+        }
+        // two spheres the same distance away can come back in either order
+        if ((hit != expected)&&((hit < 0)||(expected < 0)||(distance != closest)))
+        {
+            gf3d_bench_fail(name,"a ray hit a different object than testing every sphere");
+            printf("  hit %i at %f, expected %i at %f\n",hit,distance,expected,closest);
+            return false;
+        }
+    }
+    return true;
+}
+
+static float gf3d_bench_spatial_ray_any(Sint32 proxy,void *data,void *userData)
+{
+    return (proxy == *(Sint32 *)userData)?1.0f:-1.0f;
+}
+
+/**
+ * @brief cast rays along an axis that start exactly on a side of an object's fat box, where the slab test of the
+ * other axes would multiply zero by the infinite inverse of the direction
+ */
+static Bool gf3d_bench_spatial_check_axis_rays()
+{
+    int i;
+    Sint32 target;
+    AABB f;
+    Vector3D c;
+    Vector3D origins[4],directions[4];
+
+    target = bench.objects[0].proxy;
+    gf3d_spatial_get_fat_box(bench.checkTree,target,&f);
+    c = vector3d((f.min.x + f.max.x) * 0.5f,(f.min.y + f.max.y) * 0.5f,(f.min.z + f.max.z) * 0.5f);
+    origins[0] = vector3d(f.min.x,c.y,f.min.z - 10);
+    directions[0] = vector3d(0,0,1);
+    origins[1] = vector3d(f.max.x,c.y,f.max.z + 10);
+    directions[1] = vector3d(-0.0,0,-1);    // a negative zero divides to -inf
+    origins[2] = vector3d(f.min.x - 10,f.min.y,f.max.z);
+    directions[2] = vector3d(1,0,0);
+    origins[3] = vector3d(c.x,f.max.y + 10,f.min.z);
+    directions[3] = vector3d(0,-1,-0.0);
+    for (i = 0; i < 4; i++)
+    {
+        if (gf3d_spatial_raycast(bench.checkTree,origins[i],directions[i],SPATIAL_RAY_LENGTH,gf3d_bench_spatial_ray_any,&target,NULL) != target)
+        {
+            gf3d_bench_fail("spatial.raycast","a ray along an axis starting on the side of a box missed it");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief grow a tree from a small capacity and check every node array it went through is tracked and freed
+ * @return false if the tracked scene memory does not add up, after reporting it
+ */
+static Bool gf3d_bench_spatial_check_memory()
+{
+    SpatialTree *tree;
+    MemoryTagStats before,grown,after;
+
+    gf3d_memory_get_tag_stats(MT_Scene,&before);
+    tree = gf3d_spatial_tree_new(16,SPATIAL_MARGIN);
+    if ((!tree)||(!gf3d_bench_spatial_spawn(tree,SPATIAL_CHECK_COUNT,SPATIAL_CHECK_SIZE)))
+    {
+        gf3d_spatial_tree_free(tree);
+        gf3d_bench_fail("spatial.memory","failed to build the growing tree");
+        return false;
+    }
+    gf3d_memory_get_tag_stats(MT_Scene,&grown);
+    gf3d_spatial_tree_free(tree);
+    gf3d_memory_get_tag_stats(MT_Scene,&after);
+    // the tree and its one node array, every array it outgrew was freed
+    if ((grown.host.liveCount != before.host.liveCount + 2)||(grown.host.allocations <= before.host.allocations + 2)||
+        (after.host.liveCount != before.host.liveCount)||(after.host.liveBytes != before.host.liveBytes))
+    {
+        gf3d_bench_fail("spatial.memory","growing nodes is not tracked as scene memory, or leaks");
+        return false;
+    }
+    return true;
+}
+
+static Bool gf3d_bench_spatial_check()
+{
+    int i;
+    SpatialStats stats;
+
+    if (!gf3d_bench_spatial_check_memory())return false;
+    bench.checkTree = gf3d_spatial_tree_new(SPATIAL_CHECK_COUNT,SPATIAL_MARGIN);
+    if ((!bench.checkTree)||(!gf3d_bench_spatial_spawn(bench.checkTree,SPATIAL_CHECK_COUNT,SPATIAL_CHECK_SIZE)))
+    {
+        gf3d_bench_fail("spatial","failed to build the check tree");
+        return false;
+    }
+    gf3d_bench_spatial_make_queries(SPATIAL_CHECK_QUERIES,SPATIAL_CHECK_SIZE);
+    if (!gf3d_bench_spatial_check_queries("spatial.query"))return false;
+    if (!gf3d_bench_spatial_check_rays("spatial.raycast"))return false;
+    if (!gf3d_bench_spatial_check_axis_rays())return false;
+    for (i = 0; i < 120; i++)
+    {
+        gf3d_bench_spatial_move(bench.checkTree,SPATIAL_CHECK_COUNT,SPATIAL_CHECK_SIZE);
+    }
+    gf3d_spatial_get_stats(bench.checkTree,&stats);
+    if ((stats.proxies != SPATIAL_CHECK_COUNT)||(!stats.reinserts))
+    {
+        gf3d_bench_fail("spatial.move","objects were lost, or none left their fat box");
+        return false;
+    }
+    if (!gf3d_bench_spatial_check_queries("spatial.query.moved"))return false;
+    if (!gf3d_bench_spatial_check_rays("spatial.raycast.moved"))return false;
+    gf3d_spatial_tree_free(bench.checkTree);
+    bench.checkTree = NULL;
+    return true;
+}
+
+/**
+ * CASES
+ */
+
+void gf3d_bench_spatial_prepare(int param)
+{
+    if (bench.ready)return;
+    srand(31);
+    bench.tree = gf3d_spatial_tree_new(SPATIAL_OBJECTS,SPATIAL_MARGIN);
+    if ((!bench.tree)||(!gf3d_bench_spatial_spawn(bench.tree,SPATIAL_OBJECTS,SPATIAL_WORLD_SIZE)))
+    {
+        gf3d_bench_fail("spatial.move","failed to add the objects");
+        return;
+    }
+    gf3d_bench_spatial_make_queries(SPATIAL_QUERIES,SPATIAL_WORLD_SIZE);
+    bench.ready = true;
+}
+
+void gf3d_bench_spatial_run(int param)
+{
+    int i;
+    SpatialQuery *query;
+
+    if (!bench.ready)return;
+    switch (param)
+    {
+        case ST_Move:
+            gf3d_bench_spatial_move(bench.tree,SPATIAL_OBJECTS,SPATIAL_WORLD_SIZE);
+            break;
+        case ST_QuerySphere:
+            for (i = 0; i < SPATIAL_QUERIES; i++)
+            {
+                bench.hits += gf3d_spatial_query_sphere(bench.tree,bench.queries[i].center,SPATIAL_QUERY_SIZE,NULL,NULL);
+            }
+            break;
+        case ST_QueryAABB:
+            for (i = 0; i < SPATIAL_QUERIES; i++)
+            {
+                bench.hits += gf3d_spatial_query_aabb(
+                    bench.tree,gf3d_bench_spatial_box(bench.queries[i].center,SPATIAL_QUERY_SIZE),NULL,NULL);
+            }
+            break;
+        case ST_Raycast:
+            for (i = 0; i < SPATIAL_QUERIES; i++)
+            {
+                query = &bench.queries[i];
+                if (gf3d_spatial_raycast(
+                    bench.tree,query->origin,query->direction,SPATIAL_RAY_LENGTH,gf3d_bench_spatial_ray_sphere,query,NULL) >= 0)
+                {
+                    bench.hits++;
+                }
+            }
+            break;
+    }
+}
+
+static void gf3d_bench_spatial_close()
+{
+    gf3d_spatial_tree_free(bench.tree);
+    gf3d_spatial_tree_free(bench.checkTree);
+    bench.tree = bench.checkTree = NULL;
+}
+
+void gf3d_bench_spatial_register()
+{
+    static const Uint32 items[ST_MAX] = {SPATIAL_OBJECTS,SPATIAL_QUERIES,SPATIAL_QUERIES,SPATIAL_QUERIES};
+    int i;
+
+    atexit(gf3d_bench_spatial_close);
+    bench.objects = (SpatialObject *)gf3d_allocate_array(sizeof(SpatialObject),SPATIAL_OBJECTS);
+    bench.queries = (SpatialQuery *)gf3d_allocate_array(sizeof(SpatialQuery),SPATIAL_QUERIES);
+    bench.found = (Uint8 *)gf3d_allocate_array(sizeof(Uint8),SPATIAL_CHECK_COUNT);
+    if ((!bench.objects)||(!bench.queries)||(!bench.found))
+    {
+        gf3d_bench_fail("spatial","failed to allocate benchmark data");
+        return;
+    }
+    srand(431);
+    if (!gf3d_bench_spatial_check())return;
+    for (i = 0; i < ST_MAX; i++)
+    {
+        gf3d_bench_add(spatialNames[i],items[i],gf3d_bench_spatial_prepare,gf3d_bench_spatial_run,i);
+    }
+}
+
+/*eol@eof*/
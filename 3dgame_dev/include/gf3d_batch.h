@@ -0,0 +1,86 @@
+#ifndef __GF3D_BATCH_H__
+#define __GF3D_BATCH_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_matrix.h"
+#include "gf3d_mesh.h"
+#include "gf3d_pipeline.h"
+
+/**
+ * @purpose instanced draw batching
+ * objects submitted during a frame are grouped by mesh and pipeline (the material)
+ * each group's model matrices are packed into a per instance vertex buffer and drawn with one instanced indexed draw
+ * the per instance vertex layout is binding 1, the model matrix rows at locations 3 through 6
+ */
+
+#define GF3D_BATCH_INSTANCE_BINDING     1
+#define GF3D_BATCH_INSTANCE_LOCATION    3
+
+typedef struct
+{
+    Uint32  submitted;          /**<objects submitted this frame*/
+    Uint32  dropped;            /**<objects that did not fit in the instance buffer or group table*/
+    Uint32  groups;             /**<mesh and pipeline combinations with at least one instance*/
+    Uint32  drawCalls;          /**<instanced draws recorded*/
+    Uint32  pipelineBinds;      /**<pipeline changes recorded*/
+    double  buildMs;            /**<CPU time spent packing instances into the instance buffer*/
+    double  recordMs;           /**<CPU time spent recording the draws*/
+}BatchStats;
+
+/**
+ * @brief initialize the batching system.  Will clean itself up at exit
+ * @note without gf3d_buffers initialized instances are packed into host memory, for profiling without a device
+ * @param frameCount how many frames can be in flight, each gets its own region of the instance buffer
+ * @param maxInstances how many objects can be submitted in one frame
+ * @param maxGroups how many distinct mesh and pipeline combinations can be tracked
+ */
+void gf3d_batch_init(Uint32 frameCount,Uint32 maxInstances,Uint32 maxGroups);
+
+/**
+ * @brief get the vertex input state that pipelines drawing batched meshes must be created with
+ * @return NULL if not initialized, otherwise mesh data on binding 0 and instance data on GF3D_BATCH_INSTANCE_BINDING
+ */
+const VkPipelineVertexInputStateCreateInfo *gf3d_batch_get_vertex_input();
+
+/**
+ * @brief start collecting submissions for a new frame, discarding anything submitted before
+ */
+void gf3d_batch_begin();
+
+/**
+ * @brief submit an object for drawing this frame
+ * @param mesh the mesh to draw
+ * @param pipe the pipeline to draw it with, it must be created with gf3d_batch_get_vertex_input
+ * @param model the model matrix for this object, copied on submission
+ */
+void gf3d_batch_submit(Mesh *mesh,Pipeline *pipe,Matrix4 model);
+
+/**
+ * @brief pack the submitted instances into the given frame's region of the instance buffer
+ * @note call once the GPU is done with the frame, before recording it
+ * @param frame the frame index
+ */
+void gf3d_batch_end(Uint32 frame);
+
+/**
+ * @brief record one instanced draw per group into a command buffer inside a render pass
+ * @param commandBuffer the command buffer being recorded, VK_NULL_HANDLE only counts the draws into the stats
+ * @param frame the frame that gf3d_batch_end packed instances for
+ */
+void gf3d_batch_draw(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief record the depth pre-pass draws of the groups whose pipeline has a depthPipeline
+ * @param commandBuffer the command buffer being recorded
+ * @param frame the frame that gf3d_batch_end packed instances for
+ */
+void gf3d_batch_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief get the counters for the most recent frame
+ * @param stats output, the counters are copied here
+ */
+void gf3d_batch_get_stats(BatchStats *stats);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __GF3D_BUFFERS_H__
+#define __GF3D_BUFFERS_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_memory.h"
+
+/**
+ * @purpose creation of vulkan buffers and their backing device memory
+ * every buffer's memory is tracked under the tag it is created with, see gf3d_memory
+ */
+
+typedef struct
+{
+    VkBuffer            buffer;
+    VkDeviceMemory      memory;
+    VkDeviceSize        size;
+    void               *mapped;     /**<persistent mapping for host visible buffers, NULL otherwise*/
+    VkDeviceSize        allocated;  /**<the device memory actually allocated, at least size*/
+    MemoryTag           tag;
+}GpuBuffer;
+
+/**
+ * @brief initialize the buffer system.  Will clean itself up at exit
+ * @param gpu the physical device that memory types and limits are queried from
+ * @param device the logical device buffers are created on
+ */
+void gf3d_buffers_init(VkPhysicalDevice gpu,VkDevice device);
+
+/**
+ * @brief get the limits of the physical device, for alignment and size queries
+ * @return NULL if the buffer system has not been initialized
+ */
+const VkPhysicalDeviceLimits *gf3d_buffers_get_limits();
+
+/**
+ * @brief find a memory type that matches the filter and has all the requested properties
+ * @param typeFilter bit mask of acceptable memory types, from VkMemoryRequirements
+ * @param properties the property flags the memory type must have
+ * @return -1 if nothing matched, the memory type index otherwise
+ */
+Sint32 gf3d_buffers_find_memory_type(Uint32 typeFilter,VkMemoryPropertyFlags properties);
+
+/**
+ * @brief round a size up to the given alignment
+ * @param size the size to align
+ * @param alignment the alignment, zero or a power of two
+ * @return the aligned size
+ */
+VkDeviceSize gf3d_buffers_align(VkDeviceSize size,VkDeviceSize alignment);
+
+/**
+ * @brief create a buffer and bind freshly allocated memory to it
+ * host visible buffers are mapped for their whole lifetime
+ * @param out the buffer to fill in
+ * @param tag what the buffer's memory is tracked as
+ * @param size how many bytes the buffer holds
+ * @param usage how the buffer will be used
+ * @param properties what kind of memory should back the buffer
+ * @return true on success, false on error (out will be zeroed)
+ */
+Bool gf3d_buffer_create(GpuBuffer *out,MemoryTag tag,VkDeviceSize size,VkBufferUsageFlags usage,VkMemoryPropertyFlags properties);
+
+/**
+ * @brief destroy a buffer and free its memory
+ * @param buffer the buffer to free
+ */
+void gf3d_buffer_free(GpuBuffer *buffer);
+
+#endif
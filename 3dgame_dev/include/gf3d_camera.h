@@ -0,0 +1,175 @@
+#ifndef __GF3D_CAMERA_H__
+#define __GF3D_CAMERA_H__
+
+#include "gf3d_matrix.h"
+#include "gf3d_cull.h"
+
+/**
+ * @purpose cameras
+ * any number of cameras can exist, each with its own view and projection.  Everything derived from them (view
+ * projection, inverses and frustum planes) is cached and only rebuilt the first time it is asked for after a change
+ * one camera is active: it is the one the gf3d_camera_ functions without a camera parameter work on, and the one
+ * the renderer draws with
+ */
+
+typedef struct
+{
+    Matrix4     view;               /**<world to camera*/
+    Matrix4     proj;               /**<camera to clip, vulkan clip space*/
+    Matrix4     viewProj;           /**<world to clip*/
+    Matrix4     inverseView;        /**<camera to world, row 3 is the camera position*/
+    Matrix4     inverseViewProj;    /**<clip to world, for picking and rebuilding positions from depth*/
+    Frustum     frustum;            /**<world space planes of viewProj*/
+}CameraMatrices;
+
+/**
+ * @brief initialize the camera system and make camera 0, the active camera.  Will clean itself up at exit
+ * @param maxCameras how many cameras can exist at once
+ */
+void gf3d_camera_init(Uint32 maxCameras);
+
+/**
+ * @brief make a camera at the origin looking down -z, with a 45 degree perspective projection
+ * @return -1 on error, the camera id otherwise
+ */
+Sint32 gf3d_camera_object_new();
+
+/**
+ * @brief free a camera
+ * @note the active camera cannot be freed
+ * @param camera the camera to free
+ */
+void gf3d_camera_object_free(Sint32 camera);
+
+/**
+ * @brief make a camera the one the renderer draws with
+ * @param camera the camera
+ */
+void gf3d_camera_set_active(Sint32 camera);
+
+/**
+ * @brief get the camera the renderer draws with
+ * @return -1 if the camera system is not initialized
+ */
+Sint32 gf3d_camera_get_active();
+
+/**
+ * @brief give a camera a perspective projection
+ * @note the y axis is flipped for vulkan clip space
+ * @param camera the camera
+ * @param fov the vertical field of view, in radians
+ * @param aspect the width of the view divided by its height
+ * @param near the distance to the near clipping plane
+ * @param far the distance to the far clipping plane
+ */
+void gf3d_camera_object_set_perspective(Sint32 camera,float fov,float aspect,float near,float far);
+
+/**
+ * @brief change only the aspect ratio of a perspective camera, such as when the window is resized
+ * @param camera the camera
+ * @param aspect the width of the view divided by its height
+ */
+void gf3d_camera_object_set_aspect(Sint32 camera,float aspect);
+
+/**
+ * @brief give a camera any projection
+ * @param camera the camera
+ * @param proj the projection, camera to vulkan clip space
+ */
+void gf3d_camera_object_set_projection(Sint32 camera,Matrix4 proj);
+
+/**
+ * @brief point a camera at a target
+ * @param camera the camera
+ * @param position the location for the camera
+ * @param target the point the camera should be looking at
+ * @param up the direction considered to be "up"
+ */
+void gf3d_camera_object_look_at(Sint32 camera,Vector3D position,Vector3D target,Vector3D up);
+
+/**
+ * @brief set the view matrix of a camera directly
+ * @param camera the camera
+ * @param view world to camera space, it must be invertible
+ */
+void gf3d_camera_object_set_view(Sint32 camera,Matrix4 view);
+
+/**
+ * @brief move a camera to a position, keeping the way it faces
+ * @param camera the camera
+ * @param position the new position
+ */
+void gf3d_camera_object_set_position(Sint32 camera,Vector3D position);
+
+/**
+ * @brief move a camera by an offset, keeping the way it faces
+ * @param camera the camera
+ * @param move the offset, in world space
+ */
+void gf3d_camera_object_move(Sint32 camera,Vector3D move);
+
+/**
+ * @brief get where a camera is
+ * @param camera the camera
+ * @return the position, the origin if there is no such camera
+ */
+Vector3D gf3d_camera_object_get_position(Sint32 camera);
+
+/**
+ * @brief get the matrices and frustum of a camera, rebuilding whatever changed since they were last asked for
+ * @param camera the camera
+ * @return NULL if there is no such camera.  Stays valid until the camera is freed, its contents until it changes
+ */
+const CameraMatrices *gf3d_camera_object_get_matrices(Sint32 camera);
+
+/**
+ * @brief get the version of a camera, which changes every time its view or projection is modified
+ * @param camera the camera
+ * @return the current version
+ */
+Uint32 gf3d_camera_object_get_version(Sint32 camera);
+
+/**
+ * @brief get the current camera view
+ * @param view output, the matrix provided will be populated with the current camera information
+ */
+void gf3d_camera_get_view(Matrix4 *view);
+
+/**
+ * @brief set the current camera based on the matrix provided
+ * @param view the matrix to copy into the camera
+ */
+void gf3d_camera_set_view(Matrix4 *view);
+
+/**
+ * @brief set the camera properties based on position and direction that the camera should look
+ * @param position the location for the camera
+ * @param target the point the camera should be looking at
+ * @param up the direction considered to be "up"
+ */
+void gf3d_camera_look_at(
+    Vector3D position,
+    Vector3D target,
+    Vector3D up
+);
+
+/**
+ * @brief explicitly set the camera position, holding all other parameters the same
+ * @param position the new position for the camera
+ */
+void gf3d_camera_set_position(Vector3D position);
+
+/**
+ * @brief move the camera relatively based on the vector provided
+ * @param move the ammount to move the camera
+ */
+void gf3d_camera_move(Vector3D move);
+
+/**
+ * @brief get the camera version, which changes every time the active camera is modified or another one is made active
+ * @note compare against a saved version to know when anything derived from the view is stale
+ * @return the current version
+ */
+Uint32 gf3d_camera_get_version();
+
+#endif
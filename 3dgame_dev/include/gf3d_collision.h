@@ -0,0 +1,213 @@
+#ifndef __GF3D_COLLISION_H__
+#define __GF3D_COLLISION_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_quaternion.h"
+
+/**
+ * @purpose collision detection between moving bodies
+ * a body is a shape placed in the world with a position and rotation.  Each update finds every pair of bodies whose
+ * bounding boxes overlap, and then the contact between the shapes of every such pair
+ * broadphase: sweep and prune along x.  Bodies are kept in a list sorted by their lowest x that persists between
+ * updates.  Bodies only move a little each frame so an insertion sort puts it back in order in close to one pass.  The
+ * boxes are then copied in structure of arrays form into slices along z, and the sweep of each slice tests y and z four
+ * boxes at a time, split into jobs.  Slicing keeps a crowd spread over a wide area from meeting every body in its
+ * column of x
+ * the pairs it finds are kept in a cache that lives as long as the boxes overlap, which holds each pair's contact,
+ * whether it is touching, and where the narrowphase should start looking next time
+ * narrowphase: GJK finds the distance between the cores of two shapes, a point for a sphere, a segment for a capsule,
+ * the shape itself for boxes and hulls.  Spheres and capsules are their core plus a radius, so most of their contacts
+ * never need more than that.  When cores overlap, EPA finds how deep and in which direction.  Pairs are split into
+ * jobs across the job system's threads
+ * a contact is one point pair and a normal, the deepest point of the overlap
+ */
+
+#define GF3D_COLLISION_HULL_MAX     64      /**<vertices a hull can have*/
+
+typedef enum
+{
+    CS_Sphere = 0,
+    CS_Box,
+    CS_Capsule,         /**<a segment along local y with a radius around it*/
+    CS_Hull,            /**<the convex hull of a set of points*/
+    CS_MAX
+}CollisionShapeType;
+
+typedef struct
+{
+    CollisionShapeType  type;
+    float               radius;         /**<sphere and capsule*/
+    float               halfHeight;     /**<capsule, half the length of its core segment*/
+    Vector3D            halfExtents;    /**<box*/
+    Uint32              vertexCount;    /**<hull*/
+    float              *hullX;          /**<hull vertices in structure of arrays form, padded to a multiple of 4*/
+    float              *hullY;
+    float              *hullZ;
+    Vector3D            boundsCenter;   /**<local bounding box of a hull*/
+    Vector3D            boundsExtents;
+}CollisionShape;
+
+typedef struct
+{
+    Sint32      bodyA;
+    Sint32      bodyB;          /**<always the higher id of the two*/
+    Vector3D    normal;         /**<unit length, from A towards B*/
+    float       depth;          /**<how far the shapes overlap along the normal*/
+    Vector3D    pointA;         /**<the deepest point of A inside B, world space*/
+    Vector3D    pointB;         /**<the deepest point of B inside A, world space*/
+    Bool        began;          /**<the pair was not touching at the last update*/
+}CollisionContact;
+
+typedef struct
+{
+    Sint32      bodyA;
+    Sint32      bodyB;
+}CollisionPair;
+
+typedef struct
+{
+    Uint32      bodies;
+    Uint32      pairs;          /**<pairs whose bounding boxes overlap*/
+    Uint32      contacts;       /**<pairs whose shapes touch*/
+    Uint32      swaps;          /**<moves the insertion sort made at the last update*/
+    Uint32      bands;          /**<slices along z the last update's sweep was split into*/
+    Uint32      fullSorts;      /**<updates where so many bodies were added that the list was sorted from scratch*/
+    Uint32      epaRuns;        /**<pairs at the last update whose cores overlapped*/
+    double      broadphaseMs;   /**<wall time of the last update's box refresh, sort, sweep and cache update*/
+    double      narrowphaseMs;  /**<wall time of the last update's contact tests*/
+}CollisionStats;
+
+/**
+ * @brief initialize the collision system.  Will clean itself up at exit
+ * @param maxBodies how many bodies can exist at once
+ */
+void gf3d_collision_init(Uint32 maxBodies);
+
+/**
+ * SHAPES
+ * shapes can be shared by any number of bodies, and must outlive them
+ */
+
+/**
+ * @brief make a sphere
+ * @param radius the radius
+ * @return the shape, NULL on error (see logs)
+ */
+CollisionShape *gf3d_collision_shape_sphere(float radius);
+
+/**
+ * @brief make a box
+ * @param halfExtents half its size on each local axis
+ * @return the shape, NULL on error (see logs)
+ */
+CollisionShape *gf3d_collision_shape_box(Vector3D halfExtents);
+
+/**
+ * @brief make a capsule standing along its local y axis
+ * @param radius the radius around the core
+ * @param halfHeight half the length of the core, the capsule is 2 * (halfHeight + radius) tall
+ * @return the shape, NULL on error (see logs)
+ */
+CollisionShape *gf3d_collision_shape_capsule(float radius,float halfHeight);
+
+/**
+ * @brief make the convex hull of a set of points
+ * @note points inside the hull are harmless, they are never the furthest in any direction
+ * @param points the points in local space
+ * @param count how many, up to GF3D_COLLISION_HULL_MAX
+ * @return the shape, NULL on error (see logs)
+ */
+CollisionShape *gf3d_collision_shape_hull(const Vector3D *points,Uint32 count);
+
+/**
+ * @brief free a shape
+ * @param shape the shape, no body may still be using it
+ */
+void gf3d_collision_shape_free(CollisionShape *shape);
+
+/**
+ * BODIES
+ */
+
+/**
+ * @brief add a body
+ * @param shape its shape
+ * @param position where it is
+ * @param rotation how it is turned, a unit quaternion
+ * @param isStatic static bodies are never paired with each other
+ * @param data handed back by gf3d_collision_body_get_data
+ * @return the body id, -1 if there is no room or the shape is NULL
+ */
+Sint32 gf3d_collision_body_add(const CollisionShape *shape,Vector3D position,Quaternion rotation,Bool isStatic,void *data);
+
+/**
+ * @brief remove a body
+ * @note its id is not handed out again until after the next update, so its pairs end cleanly first
+ * @param body the body id
+ */
+void gf3d_collision_body_remove(Sint32 body);
+
+/**
+ * @brief move a body, it takes effect at the next update
+ * @param body the body id
+ * @param position where it is now
+ * @param rotation how it is turned now, a unit quaternion
+ */
+void gf3d_collision_body_set_transform(Sint32 body,Vector3D position,Quaternion rotation);
+
+/**
+ * @brief get the data a body was added with
+ * @param body the body id
+ * @return the data, NULL for bodies that do not exist
+ */
+void *gf3d_collision_body_get_data(Sint32 body);
+
+/**
+ * UPDATE
+ */
+
+/**
+ * @brief find every pair of touching bodies
+ * @note main thread only.  The broadphase sweep and the narrowphase run as jobs, and the caller helps with them
+ */
+void gf3d_collision_update();
+
+/**
+ * @brief get the contacts found by the last update
+ * @param count set to how many there are
+ * @return the contacts, valid until the next update
+ */
+const CollisionContact *gf3d_collision_get_contacts(Uint32 *count);
+
+/**
+ * @brief get the pairs that were touching before the last update and are not any more
+ * @note pairs with a removed body are here too
+ * @param count set to how many there are
+ * @return the pairs, valid until the next update
+ */
+const CollisionPair *gf3d_collision_get_ended(Uint32 *count);
+
+/**
+ * @brief test two shapes directly, without bodies
+ * @param shapeA the first shape
+ * @param positionA where it is
+ * @param rotationA how it is turned
+ * @param shapeB the second shape
+ * @param positionB where it is
+ * @param rotationB how it is turned
+ * @param contact if not NULL, filled in with the contact when they touch.  The body ids are set to -1
+ * @return true if the shapes touch
+ */
+Bool gf3d_collision_test(
+    const CollisionShape *shapeA,Vector3D positionA,Quaternion rotationA,
+    const CollisionShape *shapeB,Vector3D positionB,Quaternion rotationB,
+    CollisionContact *contact);
+
+/**
+ * @brief get the collision system's counters
+ * @param stats filled in with the current values
+ */
+void gf3d_collision_get_stats(CollisionStats *stats);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __GF3D_COMMANDS_H__
+#define __GF3D_COMMANDS_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_pipeline.h"
+
+/**
+ * @brief setup the command pool and one command buffer per swap chain image.  Will clean itself up at exit
+ * @param device the logical device to create the pool on
+ * @param count how many command buffers to allocate
+ */
+void gf3d_command_pool_setup(VkDevice device,Uint32 count);
+
+/**
+ * @brief re-record the command buffer for a swap chain image with this frame's draws
+ * @note the GPU must be done with the previous submission of this buffer
+ * @param index the swap chain image index
+ * @param pipe the pipeline whose render pass the frame is drawn in
+ */
+void gf3d_command_buffer_record(Uint32 index,Pipeline *pipe);
+
+/**
+ * @brief set the viewport and scissor the following frames are drawn with
+ * @note these are dynamic state, so changing them (resolution scaling, a split screen view) rebuilds no pipelines.
+ * the camera projection is not changed, keep its aspect ratio matching the viewport
+ * @param viewport the viewport in swap image pixels, NULL to go back to covering the whole swap image
+ * @param scissor the scissor rectangle, NULL to use the viewport's.  It is clamped to the swap image
+ */
+void gf3d_command_set_viewport(const VkViewport *viewport,const VkRect2D *scissor);
+
+/**
+ * @brief record the current viewport and scissor into a command buffer
+ * @param commandBuffer the command buffer being recorded
+ */
+void gf3d_command_viewport_bind(VkCommandBuffer commandBuffer);
+
+/**
+ * @brief get the command buffer for a swap chain image
+ * @param index the swap chain image index
+ * @return NULL if out of range, a pointer to the command buffer otherwise
+ */
+VkCommandBuffer * gf3d_command_buffer_get_by_index(Uint32 index);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef __GF3D_CULL_H__
+#define __GF3D_CULL_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_matrix.h"
+
+/**
+ * @purpose CPU frustum culling
+ * bounding spheres and AABBs are kept in structure of arrays form so they can be tested 4 (SSE) or 8 (AVX) at a time
+ * large cull requests are split into jobs across the job system's threads
+ */
+
+typedef enum
+{
+    CM_Auto = 0,        /**<widest instruction set the CPU supports*/
+    CM_Scalar,          /**<one object at a time, the reference implementation*/
+    CM_SSE,             /**<4 objects at a time*/
+    CM_AVX              /**<8 objects at a time*/
+}CullMode;
+
+typedef struct
+{
+    Vector4D    planes[6];      /**<left, right, bottom, top, near, far.  xyz normal pointing inward, w distance*/
+}Frustum;
+
+typedef struct
+{
+    Uint32      tested;         /**<objects tested by the last cull*/
+    Uint32      visible;        /**<objects that passed the last cull*/
+    Uint32      threads;        /**<jobs the last cull was split into, at most one per thread*/
+    CullMode    mode;           /**<the instruction set the last cull ran with*/
+    double      cullMs;         /**<wall time of the last cull*/
+}CullStats;
+
+/**
+ * @brief extract normalized frustum planes from a combined view projection matrix
+ * @param frustum output
+ * @param viewProj the view matrix multiplied by the projection matrix
+ */
+void gf3d_cull_frustum_from_matrix(Frustum *frustum,Matrix4 viewProj);
+
+/**
+ * @brief build the frustum of the current gf3d_camera view
+ * @param frustum output
+ * @note gf3d_camera_object_get_matrices has a cached frustum for any camera, this rebuilds it every call
+ * @param proj the projection, as built by gf3d_matrix_perspective
+ */
+void gf3d_cull_frustum_from_camera(Frustum *frustum,Matrix4 proj);
+
+/**
+ * @brief initialize the culling system.  Will clean itself up at exit
+ * @param maxObjects how many objects can have bounding volumes at once
+ */
+void gf3d_cull_init(Uint32 maxObjects);
+
+/**
+ * @brief reserve bounding volumes for an object.  It starts as a zero sized sphere and box at the origin
+ * @return -1 if there is no room, the object id otherwise
+ */
+Sint32 gf3d_cull_object_new();
+
+/**
+ * @brief release an object's bounding volumes
+ * @param object the object to release
+ */
+void gf3d_cull_object_free(Sint32 object);
+
+/**
+ * @brief set the world space bounding sphere of an object
+ * @param object the object to update
+ * @param center the center of the sphere
+ * @param radius the radius of the sphere
+ */
+void gf3d_cull_object_set_sphere(Sint32 object,Vector3D center,float radius);
+
+/**
+ * @brief set the world space bounding box of an object
+ * @param object the object to update
+ * @param min the minimum corner
+ * @param max the maximum corner
+ */
+void gf3d_cull_object_set_aabb(Sint32 object,Vector3D min,Vector3D max);
+
+/**
+ * @brief test every object against a frustum.  An object is visible when both its sphere and its box intersect it
+ * @param frustum the frustum to test against
+ * @param mode which implementation to use, CM_Auto for the fastest available
+ * @param visible output, ids of visible objects.  Must have room for maxObjects ids
+ * @return how many objects are visible
+ */
+Uint32 gf3d_cull_frustum(const Frustum *frustum,CullMode mode,Uint32 *visible);
+
+/**
+ * @brief get the counters of the last cull
+ * @param stats output, the counters are copied here
+ */
+void gf3d_cull_get_stats(CullStats *stats);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef __GF3D_DESCRIPTORS_H__
+#define __GF3D_DESCRIPTORS_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+
+/**
+ * @purpose descriptor set management
+ * transient descriptor sets come out of per frame pools that are reset wholesale at the start of each frame
+ * immutable descriptor sets are cached by a hash of their bindings and are never reallocated or rewritten
+ */
+
+typedef struct
+{
+    Uint32                  binding;        /**<binding slot in the set layout*/
+    VkDescriptorType        type;           /**<what kind of descriptor this is*/
+    VkDescriptorBufferInfo  bufferInfo;     /**<used by buffer descriptor types*/
+    VkDescriptorImageInfo   imageInfo;      /**<used by image and sampler descriptor types*/
+}DescriptorBinding;
+
+typedef struct
+{
+    Uint32  setsAllocated;      /**<descriptor sets allocated from any pool*/
+    Uint32  cacheHits;          /**<cached set lookups served without allocating or writing*/
+    Uint32  cacheMisses;        /**<cached set lookups that had to allocate and write a new set*/
+    Uint32  poolResets;         /**<descriptor pools reset at the start of a frame*/
+    Uint32  poolsCreated;       /**<descriptor pools created to satisfy demand*/
+}DescriptorStats;
+
+/**
+ * @brief initialize the descriptor manager.  Will clean itself up at exit
+ * @param device the logical device to allocate descriptors from
+ * @param frameCount how many frames can be in flight, each gets its own set of pools
+ * @param setsPerPool how many sets each pool can hold before another pool is created
+ */
+void gf3d_descriptors_init(VkDevice device,Uint32 frameCount,Uint32 setsPerPool);
+
+/**
+ * @brief start a new frame, resetting every pool used for that frame
+ * @note the caller must ensure the GPU is done with any sets previously allocated for this frame
+ * @param frameIndex which frame is beginning
+ */
+void gf3d_descriptors_begin_frame(Uint32 frameIndex);
+
+/**
+ * @brief allocate a transient descriptor set that is valid until this frame index comes around again
+ * @param layout the layout of the set to allocate
+ * @return VK_NULL_HANDLE on error, a descriptor set otherwise
+ */
+VkDescriptorSet gf3d_descriptors_allocate(VkDescriptorSetLayout layout);
+
+/**
+ * @brief write a list of bindings into a descriptor set
+ * @param set the set to update
+ * @param bindings the bindings to write
+ * @param count how many bindings there are
+ */
+void gf3d_descriptors_write(VkDescriptorSet set,const DescriptorBinding *bindings,Uint32 count);
+
+/**
+ * @brief get an immutable descriptor set for the given layout and bindings
+ * the first request allocates and writes the set, later identical requests return the same set
+ * @param layout the layout of the set
+ * @param bindings the bindings of the set
+ * @param count how many bindings there are
+ * @return VK_NULL_HANDLE on error, a descriptor set otherwise
+ */
+VkDescriptorSet gf3d_descriptors_get_cached(VkDescriptorSetLayout layout,const DescriptorBinding *bindings,Uint32 count);
+
+/**
+ * @brief get the descriptor manager counters
+ * @param stats output, the counters are copied here
+ */
+void gf3d_descriptors_get_stats(DescriptorStats *stats);
+
+/**
+ * @brief zero the descriptor manager counters
+ */
+void gf3d_descriptors_reset_stats();
+
+#endif
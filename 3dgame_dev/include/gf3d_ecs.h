@@ -0,0 +1,255 @@
+#ifndef __GF3D_ECS_H__
+#define __GF3D_ECS_H__
+
+#include "gf3d_types.h"
+
+/**
+ * @purpose entities and components, stored by archetype
+ * an entity is an id and a set of components.  Every distinct set of components is an archetype, and the entities of
+ * an archetype are stored together in fixed size chunks: each chunk holds one array per component (structure of
+ * arrays), so a system that reads two components of a hundred thousand entities walks two dense arrays and touches
+ * nothing else.  Entities in an archetype are kept packed, every chunk but the last is full
+ * a query names the components an entity must have, and those it must not.  Running one calls a function for every
+ * chunk of every matching archetype, on one thread or spread over the job system's threads
+ * adding or removing a component moves the entity to another archetype.  That cannot happen while chunks are being
+ * walked, so changes made from systems are recorded in command buffers and applied with gf3d_ecs_commands_flush after
+ * the walk.  Outside of a walk the immediate functions may be used from the main thread
+ * pointers to component data are only valid until the next structural change
+ */
+
+#define GF3D_ECS_MAX_COMPONENTS     64      /**<component types that can be registered, one bit each in a mask*/
+#define GF3D_ECS_CHUNK_SIZE         16384   /**<bytes in a chunk, header included*/
+#define GF3D_ECS_NULL               0       /**<never a live entity*/
+
+typedef Uint64 Entity;          /**<index in the low 32 bits, generation in the high 32.  Stale handles do not resolve*/
+typedef Uint64 ComponentMask;   /**<bit n set for component id n*/
+
+#define gf3d_ecs_mask(component) ((ComponentMask)1 << (component))
+
+typedef struct
+{
+    ComponentMask   mask;       /**<the components every entity in the chunk has*/
+    Uint32          count;      /**<entities in the chunk*/
+    Uint32          capacity;   /**<entities the chunk can hold*/
+    Entity         *entities;   /**<the entity in each row*/
+    Uint8          *data;       /**<the component arrays, use gf3d_ecs_chunk_get*/
+    void           *archetype;  /**<private*/
+    Uint32          index;      /**<private, the chunk's place in its archetype*/
+}EcsChunk;
+
+typedef struct
+{
+    ComponentMask   all;        /**<components an entity must have*/
+    ComponentMask   none;       /**<components an entity must not have*/
+}EcsQuery;
+
+typedef struct
+{
+    Uint8          *data;
+    size_t          size;       /**<bytes recorded*/
+    size_t          capacity;
+    Uint32          count;      /**<commands recorded*/
+}EcsCommands;
+
+typedef struct
+{
+    Uint32          entities;   /**<live entities*/
+    Uint32          archetypes;
+    Uint32          chunks;
+    Uint32          threads;    /**<threads that run parallel queries, the main thread included*/
+}EcsStats;
+
+/**
+ * @brief called for every chunk a query matches
+ * @param chunk the chunk, its component arrays hold chunk->count entities
+ * @param thread which thread is running it: 0 for the main thread, up to gf3d_ecs_get_thread_count() - 1.  Use it to
+ * pick a per thread command buffer or accumulator
+ * @param data what was passed to the query
+ */
+typedef void (*EcsChunkFunc)(EcsChunk *chunk,Uint32 thread,void *data);
+
+/**
+ * @brief initialize the entity system.  Will clean itself up at exit
+ * @param maxEntities how many entities can exist at once, reserved ones included
+ */
+void gf3d_ecs_init(Uint32 maxEntities);
+
+/**
+ * @brief register a component type
+ * @param name used in logs, a string that outlives the entity system
+ * @param size the size of the component
+ * @return the component id, -1 on error (see logs)
+ */
+Sint32 gf3d_ecs_component_register(const char *name,size_t size);
+
+#define gf3d_ecs_component_register_typed(type) gf3d_ecs_component_register(#type,sizeof(type))
+
+/**
+ * @brief make an entity with a set of components, all zeroed
+ * @note not while a query is running, use gf3d_ecs_command_entity_new
+ * @param mask the components it starts with
+ * @return the entity, GF3D_ECS_NULL on error (see logs)
+ */
+Entity gf3d_ecs_entity_new(ComponentMask mask);
+
+/**
+ * @brief free an entity and its components
+ * @note not while a query is running, use gf3d_ecs_command_entity_free
+ * @param entity the entity, stale handles are ignored
+ */
+void gf3d_ecs_entity_free(Entity entity);
+
+/**
+ * @brief check that an entity handle refers to a live entity
+ * @param entity the handle
+ * @return false for freed entities, and for entities reserved by a command buffer that has not been flushed
+ */
+Bool gf3d_ecs_entity_alive(Entity entity);
+
+/**
+ * @brief get the components an entity has
+ * @param entity the entity
+ * @return its mask, 0 if it is not alive
+ */
+ComponentMask gf3d_ecs_entity_get_mask(Entity entity);
+
+/**
+ * @brief get an entity's component
+ * @param entity the entity
+ * @param component the component id
+ * @return the component, NULL if the entity is not alive or does not have it
+ */
+void *gf3d_ecs_get(Entity entity,Sint32 component);
+
+#define gf3d_ecs_get_typed(entity,type,component) ((type *)gf3d_ecs_get((entity),(component)))
+
+/**
+ * @brief add a component to an entity, moving it to another archetype
+ * @note not while a query is running, use gf3d_ecs_command_add
+ * @param entity the entity
+ * @param component the component id
+ * @param value copied into the component, NULL to zero it.  If the entity already has the component it is overwritten
+ * @return false on error (see logs)
+ */
+Bool gf3d_ecs_add(Entity entity,Sint32 component,const void *value);
+
+/**
+ * @brief remove a component from an entity, moving it to another archetype
+ * @note not while a query is running, use gf3d_ecs_command_remove
+ * @param entity the entity
+ * @param component the component id, nothing is done if the entity does not have it
+ * @return false on error (see logs)
+ */
+Bool gf3d_ecs_remove(Entity entity,Sint32 component);
+
+/**
+ * @brief get a component array of a chunk
+ * @param chunk the chunk
+ * @param component the component id
+ * @return chunk->count components, NULL if the chunk's archetype does not have the component
+ */
+void *gf3d_ecs_chunk_get(EcsChunk *chunk,Sint32 component);
+
+#define gf3d_ecs_chunk_get_typed(chunk,type,component) ((type *)gf3d_ecs_chunk_get((chunk),(component)))
+
+/**
+ * @brief run a function over every chunk that matches a query, on the calling thread
+ * @param query the components to match
+ * @param func called for each chunk in turn, with thread 0
+ * @param data passed to func
+ * @return how many entities the chunks held
+ */
+Uint32 gf3d_ecs_query_each(EcsQuery query,EcsChunkFunc func,void *data);
+
+/**
+ * @brief run a function over every chunk that matches a query, as jobs spread over every thread
+ * @note main thread only, it runs chunks too and returns when every chunk is done.  func runs concurrently on
+ * different chunks, it may write the chunk it was given but must only read others, and record structural changes in
+ * a command buffer for its thread
+ * @param query the components to match
+ * @param func called once for each chunk
+ * @param data passed to func
+ * @return how many entities the chunks held
+ */
+Uint32 gf3d_ecs_query_each_parallel(EcsQuery query,EcsChunkFunc func,void *data);
+
+/**
+ * @brief count the entities a query matches
+ * @param query the components to match
+ * @return the number of entities
+ */
+Uint32 gf3d_ecs_query_count(EcsQuery query);
+
+/**
+ * @brief get how many threads run parallel queries, for sizing per thread data
+ * @return the job system's thread count, at least 1
+ */
+Uint32 gf3d_ecs_get_thread_count();
+
+/**
+ * @brief get the entity system's counters
+ * @param stats filled in with the current values
+ */
+void gf3d_ecs_get_stats(EcsStats *stats);
+
+/**
+ * COMMAND BUFFERS
+ * a command buffer records structural changes to apply later.  Recording is safe from any thread as long as each
+ * thread has its own buffer.  Commands are applied in the order they were recorded
+ */
+
+/**
+ * @brief set up a command buffer
+ * @param commands the buffer to set up
+ * @param capacity bytes to start with, the buffer grows when it fills
+ * @return false if the memory could not be allocated
+ */
+Bool gf3d_ecs_commands_create(EcsCommands *commands,size_t capacity);
+
+/**
+ * @brief free a command buffer, commands not flushed are dropped
+ * @note entities reserved by dropped commands stay reserved
+ * @param commands the buffer to free
+ */
+void gf3d_ecs_commands_free(EcsCommands *commands);
+
+/**
+ * @brief apply every recorded command, in order, and empty the buffer
+ * @note main thread only, and not while a query is running
+ * @param commands the buffer to apply
+ */
+void gf3d_ecs_commands_flush(EcsCommands *commands);
+
+/**
+ * @brief record making an entity.  Its handle is reserved now, so later commands can refer to it
+ * @param commands the buffer to record in
+ * @param mask the components it starts with, zeroed
+ * @return the entity, which is not alive until the buffer is flushed.  GF3D_ECS_NULL if no entity was free
+ */
+Entity gf3d_ecs_command_entity_new(EcsCommands *commands,ComponentMask mask);
+
+/**
+ * @brief record freeing an entity
+ * @param commands the buffer to record in
+ * @param entity the entity
+ */
+void gf3d_ecs_command_entity_free(EcsCommands *commands,Entity entity);
+
+/**
+ * @brief record adding a component, or overwriting it if the entity already has it
+ * @param commands the buffer to record in
+ * @param entity the entity
+ * @param component the component id
+ * @param value copied into the buffer now, NULL to zero the component
+ */
+void gf3d_ecs_command_add(EcsCommands *commands,Entity entity,Sint32 component,const void *value);
+
+/**
+ * @brief record removing a component
+ * @param commands the buffer to record in
+ * @param entity the entity
+ * @param component the component id
+ */
+void gf3d_ecs_command_remove(EcsCommands *commands,Entity entity,Sint32 component);
+
+#endif
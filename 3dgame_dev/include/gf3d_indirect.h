@@ -0,0 +1,95 @@
+#ifndef __GF3D_INDIRECT_H__
+#define __GF3D_INDIRECT_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_matrix.h"
+#include "gf3d_mesh.h"
+#include "gf3d_pipeline.h"
+
+/**
+ * @purpose GPU driven drawing
+ * instances live on the GPU and are only re-uploaded when they change
+ * each frame a compute pass culls every instance against the camera frustum, packs the survivors per draw
+ * and writes the VkDrawIndexedIndirectCommand entries that the graphics pass then draws from
+ * per frame CPU work depends on the number of draws (mesh and pipeline combinations), not the number of instances
+ * draw pipelines use the same vertex input as gf3d_batch, see gf3d_batch_get_vertex_input
+ */
+
+typedef struct
+{
+    Uint32  instances;          /**<live instances dispatched to the cull pass*/
+    Uint32  instanceUploads;    /**<instance records written into a frame copy*/
+    Uint32  visibleInstances;   /**<instances that survived culling, read back when the frame was last reused*/
+    Uint32  visibleDraws;       /**<draws with at least one visible instance, read back likewise*/
+    Uint32  indirectDraws;      /**<indirect draw calls recorded last frame*/
+}IndirectStats;
+
+/**
+ * @brief initialize GPU driven drawing.  Will clean itself up at exit
+ * @note needs gf3d_buffers, gf3d_descriptors and gf3d_pipeline to be initialized first
+ * @param device the logical device
+ * @param frameCount how many frames can be in flight
+ * @param maxInstances how many instances can exist at once
+ * @param maxDraws how many distinct mesh and pipeline combinations can exist at once
+ * @param cullShader the SPIRV file of the culling compute shader
+ */
+void gf3d_indirect_init(VkDevice device,Uint32 frameCount,Uint32 maxInstances,Uint32 maxDraws,char *cullShader);
+
+/**
+ * @brief create an instance of a mesh drawn with the given pipeline.  It starts with an identity transform
+ * @param mesh the mesh to draw
+ * @param pipe the pipeline to draw it with, created with gf3d_batch_get_vertex_input
+ * @return -1 on error, the instance id otherwise
+ */
+Sint32 gf3d_indirect_instance_new(Mesh *mesh,Pipeline *pipe);
+
+/**
+ * @brief destroy an instance
+ * @param instance the instance to destroy
+ */
+void gf3d_indirect_instance_free(Sint32 instance);
+
+/**
+ * @brief set the model matrix of an instance, it is uploaded to each frame as that frame comes up
+ * @param instance the instance to move
+ * @param model the new model matrix
+ */
+void gf3d_indirect_instance_set_model(Sint32 instance,Matrix4 model);
+
+/**
+ * @brief upload changed instances into the frame's buffers and reset its indirect commands
+ * @note call once the GPU is done with the frame, before recording it
+ * @param frame the frame index
+ */
+void gf3d_indirect_update(Uint32 frame);
+
+/**
+ * @brief record the culling compute pass
+ * @note must be recorded outside of a render pass, before gf3d_indirect_draw
+ * @param commandBuffer the command buffer being recorded
+ * @param frame the frame index
+ */
+void gf3d_indirect_cull(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief record the indirect draws, one per mesh and pipeline combination
+ * @param commandBuffer the command buffer being recorded, inside a render pass
+ * @param frame the frame index
+ */
+void gf3d_indirect_draw(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief record the depth pre-pass draws of the draws whose pipeline has a depthPipeline
+ * @param commandBuffer the command buffer being recorded, inside a render pass
+ * @param frame the frame index
+ */
+void gf3d_indirect_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief get the GPU driven drawing counters
+ * @param stats output, the counters are copied here
+ */
+void gf3d_indirect_get_stats(IndirectStats *stats);
+
+#endif
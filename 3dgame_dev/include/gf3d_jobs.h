@@ -0,0 +1,132 @@
+#ifndef __GF3D_JOBS_H__
+#define __GF3D_JOBS_H__
+
+#include "gf3d_types.h"
+
+/**
+ * @purpose a pool of worker threads, one per core, that run small jobs
+ * the main thread is thread 0 and every worker has its own number after it.  Each of them keeps a queue of the jobs it
+ * made: it takes the newest from its own queue and, once that is empty, steals the oldest from another thread's, so
+ * work spreads to idle threads without a shared queue to fight over
+ * jobs report to a counter.  Starting a job adds one to its counter and finishing it takes one away, so a counter at
+ * zero means everything started against it is done.  Waiting on a counter runs other jobs until it gets there, it
+ * never blocks a thread that could be helping.  A job can also be held until another counter reaches zero, which is
+ * how work is chained without waiting at all.  Counters start zeroed, {0} is ready to use
+ * parallel_for splits a range of items in halves down to a batch size, each half a job that an idle thread can steal
+ * culling, entity queries, command recording, asset decoding and simulation can all be handed to it
+ * threads that are not workers may start jobs and wait on counters, but they sleep while waiting instead of helping.
+ * With no workers, jobs they start run on the spot
+ */
+
+#define GF3D_JOBS_MAX_THREADS   64      /**<the main thread and workers together*/
+#define GF3D_JOBS_QUEUE_SIZE    4096    /**<jobs each thread can have waiting, a power of two*/
+
+/**
+ * @brief the function a job runs
+ * @param data what was given when the job started
+ */
+typedef void (*JobFunc)(void *data);
+
+/**
+ * @brief the function a parallel_for runs on each batch
+ * @param first the first item of the batch
+ * @param last one past the last item of the batch
+ * @param thread which thread is running it, 0 up to gf3d_jobs_get_thread_count() - 1.  Use it to pick a per thread
+ * buffer or accumulator
+ * @param data what was given to the parallel_for
+ */
+typedef void (*JobRangeFunc)(Uint32 first,Uint32 last,Uint32 thread,void *data);
+
+typedef struct
+{
+    SDL_atomic_t    count;      /**<jobs started against this counter that have not finished*/
+    SDL_SpinLock    lock;       /**<private*/
+    void           *waiting;    /**<private, jobs held until the count reaches zero*/
+}JobCounter;
+
+typedef struct
+{
+    Uint32          threads;    /**<the main thread and workers*/
+    Uint64          jobs;       /**<jobs run since start*/
+    Uint64          steals;     /**<jobs taken from another thread's queue*/
+    Uint64          inlined;    /**<jobs run on the spot because a queue was full*/
+}JobStats;
+
+/**
+ * @brief start the worker threads.  Will clean itself up at exit
+ * @note call from the main thread, which becomes thread 0
+ * @param threadCount how many threads run jobs including the main thread, 0 to use one per CPU core
+ */
+void gf3d_jobs_init(Uint32 threadCount);
+
+/**
+ * @brief start a job
+ * @param func the function to run
+ * @param data passed to func
+ * @param counter counts the job until it finishes, NULL when nothing needs to know
+ */
+void gf3d_jobs_run(JobFunc func,void *data,JobCounter *counter);
+
+/**
+ * @brief start a job once every job counted by another counter has finished
+ * @param after the counter to wait for, the job starts now if it is already zero
+ * @param func the function to run
+ * @param data passed to func
+ * @param counter counts the job from now until it finishes, NULL when nothing needs to know
+ */
+void gf3d_jobs_run_after(JobCounter *after,JobFunc func,void *data,JobCounter *counter);
+
+/**
+ * @brief run func over count items, split into batches spread across every thread
+ * @note returns at once, wait on the counter for the batches to finish
+ * @param count how many items
+ * @param minBatch the fewest items worth a batch of their own, 0 to pick one from the thread count
+ * @param func called for each batch
+ * @param data passed to func
+ * @param counter counts the batches until they finish
+ */
+void gf3d_jobs_parallel_for_async(Uint32 count,Uint32 minBatch,JobRangeFunc func,void *data,JobCounter *counter);
+
+/**
+ * @brief run func over count items, split into batches spread across every thread, and wait for them
+ * @param count how many items
+ * @param minBatch the fewest items worth a batch of their own, 0 to pick one from the thread count
+ * @param func called for each batch
+ * @param data passed to func
+ */
+void gf3d_jobs_parallel_for(Uint32 count,Uint32 minBatch,JobRangeFunc func,void *data);
+
+/**
+ * @brief run other jobs until every job counted by a counter has finished
+ * @note once this returns the counter may be reused or freed
+ * @param counter the counter to wait for
+ */
+void gf3d_jobs_wait(JobCounter *counter);
+
+/**
+ * @brief check a counter without waiting
+ * @note once this returns true the counter may be reused or freed
+ * @param counter the counter to check
+ * @return true if every job it counted has finished
+ */
+Bool gf3d_jobs_done(JobCounter *counter);
+
+/**
+ * @brief get how many threads run jobs, for sizing per thread data
+ * @return the workers plus the main thread, at least 1
+ */
+Uint32 gf3d_jobs_get_thread_count();
+
+/**
+ * @brief get the number of the calling thread
+ * @return 0 for the main thread, the worker's number on a worker, and 0 on threads that are not workers
+ */
+Uint32 gf3d_jobs_get_thread_index();
+
+/**
+ * @brief get the job system's counters
+ * @param stats filled in with the current values
+ */
+void gf3d_jobs_get_stats(JobStats *stats);
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef __GF3D_MATRIX_H__
+#define __GF3D_MATRIX_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+
+/**
+ * @purpose 4x4 float matrices in the row vector convention: a point is transformed as p * M, translation is in row 3
+ * the multiply, transform, inverse and transpose kernels have scalar, SSE and AVX versions.  The fastest one the CPU
+ * supports is picked the first time one of them runs, gf3d_matrix_simd_set can force another for testing and benchmarking
+ */
+
+typedef float Matrix4[4][4];
+
+typedef enum
+{
+    MS_Scalar = 0,  /**<plain C, the reference results*/
+    MS_SSE,         /**<4 wide*/
+    MS_AVX,         /**<8 wide, two matrix rows at a time*/
+    MS_MAX
+}MatrixSimd;
+
+/**
+ * @brief log the contents of a matrix
+ * @param mat the matrix to print
+ */
+void gf3d_matrix_slog(Matrix4 mat);
+
+/**
+ * @brief copy the contents of one matrix into another
+ * @param d the destination matrix
+ * @param s the source matrix
+ */
+void gf3d_matrix_copy(Matrix4 d,Matrix4 s);
+
+/**
+ * @brief multiply two matrices together, out = m2 * m1: a point transformed by out is transformed by m2, then by m1
+ * @note out may be the same matrix as m1 or m2
+ * @param out the result
+ * @param m1 the second transform applied
+ * @param m2 the first transform applied
+ */
+void gf3d_matrix_multiply(Matrix4 out,Matrix4 m1,Matrix4 m2);
+
+/**
+ * @brief transform a vector by a matrix, out = vec * mat
+ * @param out the result
+ * @param mat the matrix
+ * @param vec the vector
+ */
+void gf3d_matrix_multiply_vector4d(Vector4D *out,Matrix4 mat,Vector4D vec);
+
+/**
+ * @brief gf3d_matrix_multiply one matrix with each of a list, out[i] = m2[i] * m1
+ * @note handy for moving many model matrices into one space, such as multiplying them all by a view projection
+ * @param out where count results are written, may be m2
+ * @param m1 the matrix shared by every product
+ * @param m2 count matrices
+ * @param count how many matrices to multiply
+ */
+void gf3d_matrix_multiply_array(Matrix4 *out,Matrix4 m1,Matrix4 *m2,Uint32 count);
+
+/**
+ * @brief gf3d_matrix_multiply two lists of matrices pairwise, out[i] = m2[i] * m1[i]
+ * @param out where count results are written, may be m1 or m2
+ * @param m1 count matrices, the second transform of each pair
+ * @param m2 count matrices, the first transform of each pair
+ * @param count how many pairs to multiply
+ */
+void gf3d_matrix_multiply_pairs(Matrix4 *out,Matrix4 *m1,Matrix4 *m2,Uint32 count);
+
+/**
+ * @brief transform a list of vectors by a matrix, out[i] = vec[i] * mat
+ * @param out where count results are written, may be vec
+ * @param mat the matrix
+ * @param vec count vectors
+ * @param count how many vectors to transform
+ */
+void gf3d_matrix_transform_vector4d_array(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count);
+
+/**
+ * @brief transform a list of points by a matrix, treating w as 1 and with no perspective divide
+ * @param out where count results are written, may be points
+ * @param mat an affine matrix
+ * @param points count points
+ * @param count how many points to transform
+ */
+void gf3d_matrix_transform_points(Vector3D *out,Matrix4 mat,Vector3D *points,Uint32 count);
+
+/**
+ * @brief invert any 4x4 matrix
+ * @note out may be in
+ * @param out the inverse, left untouched if there is none
+ * @param in the matrix to invert
+ * @return false if the matrix is singular
+ */
+Bool gf3d_matrix_invert(Matrix4 out,Matrix4 in);
+
+/**
+ * @brief invert an affine matrix built from a rotation, a scale and a translation, cheaper than gf3d_matrix_invert
+ * @note the result is wrong for a matrix with shear or projection, such as a non uniform scale applied after a rotation
+ * @param out the inverse, left untouched if there is none; may be in
+ * @param in the matrix to invert
+ * @return false if a scale is zero
+ */
+Bool gf3d_matrix_invert_affine(Matrix4 out,Matrix4 in);
+
+/**
+ * @brief invert a matrix built only from a rotation and a translation, such as a view matrix
+ * @param out the inverse, may be in
+ * @param in the matrix to invert
+ */
+void gf3d_matrix_invert_rigid(Matrix4 out,Matrix4 in);
+
+/**
+ * @brief transpose a matrix
+ * @param out the result, may be in
+ * @param in the matrix to transpose
+ */
+void gf3d_matrix_transpose(Matrix4 out,Matrix4 in);
+
+/**
+ * @brief build the matrix that transforms normals for a model matrix: the inverse transpose of its upper 3x3
+ * @note the result is not normalized, normals need normalizing after the transform when the model is scaled
+ * @param out the normal matrix, with no translation
+ * @param model the model matrix
+ * @return false if the model matrix flattens space and has no normal matrix
+ */
+Bool gf3d_matrix_normal(Matrix4 out,Matrix4 model);
+
+/**
+ * @brief build a rotation matrix from a quaternion
+ * @param out the result
+ * @param rotation a unit quaternion, (x,y,z) the vector part and w the scalar part
+ */
+void gf3d_matrix_make_rotation(Matrix4 out,Vector4D rotation);
+
+/**
+ * @brief build a matrix that scales, then rotates, then translates
+ * @param out the result
+ * @param translation the translation
+ * @param rotation a unit quaternion, (x,y,z) the vector part and w the scalar part
+ * @param scale the scale along each axis
+ */
+void gf3d_matrix_compose(Matrix4 out,Vector3D translation,Vector4D rotation,Vector3D scale);
+
+/**
+ * @brief split a matrix made by gf3d_matrix_compose back into its parts
+ * @note a mirrored matrix comes back with a negative x scale
+ * @param in the matrix to split
+ * @param translation if not NULL, the translation is written here
+ * @param rotation if not NULL, the rotation is written here as a unit quaternion
+ * @param scale if not NULL, the scale is written here
+ * @return false if a scale is zero
+ */
+Bool gf3d_matrix_decompose(Matrix4 in,Vector3D *translation,Vector4D *rotation,Vector3D *scale);
+
+/**
+ * @brief force which kernels the multiply and transform functions use
+ * @param simd the kernels to use, falls back to the best one the CPU supports if it does not support these
+ * @return the kernels now in use
+ */
+MatrixSimd gf3d_matrix_simd_set(MatrixSimd simd);
+
+/**
+ * @brief get which kernels the multiply and transform functions use
+ */
+MatrixSimd gf3d_matrix_simd_get();
+
+/**
+ * @brief get the name of a kernel set, for logs
+ */
+const char *gf3d_matrix_simd_name(MatrixSimd simd);
+
+/**
+ * @brief set a matrix to all zeros
+ * @param zero the matrix to clear
+ */
+void gf3d_matrix_zero(Matrix4 zero);
+
+/**
+ * @brief set a matrix to the identity
+ * @param one the matrix to set
+ */
+void gf3d_matrix_identity(Matrix4 one);
+
+/**
+ * @brief build a perspective projection
+ * @param out the result
+ * @param fov the vertical field of view, in radians
+ * @param aspect the width of the view divided by its height
+ * @param near the distance to the near clipping plane
+ * @param far the distance to the far clipping plane
+ */
+void gf3d_matrix_perspective(Matrix4 out,double fov,double aspect,double near,double far);
+
+/**
+ * @brief build a view matrix looking from a position at a target
+ * @param out the result
+ * @param position where the camera is
+ * @param target the point the camera looks at
+ * @param up which way is up for the camera
+ */
+void gf3d_matrix_view(Matrix4 out,Vector3D position,Vector3D target,Vector3D up);
+
+/**
+ * @brief build a translation matrix
+ * @param out the result
+ * @param move the translation
+ */
+void gf3d_matrix_make_translation(Matrix4 out,Vector3D move);
+
+/**
+ * @brief apply a translation to a matrix
+ * @param out the matrix to translate
+ * @param move the translation
+ */
+void gf3d_matrix_translate(Matrix4 out,Vector3D move);
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef __GF3D_MEMORY_H__
+#define __GF3D_MEMORY_H__
+
+#include "gf3d_types.h"
+
+/**
+ * @purpose arenas for temporary memory, and tracking of what the heap and the device hold
+ * an arena is one block from the heap that hands out memory by moving an offset forward, and gives it all back at
+ * once by moving the offset back.  Two are kept by the memory manager:
+ * the frame arena is emptied at the start of every frame, anything allocated from it lives until the next
+ * gf3d_vgraphics_clear.  Use it for arrays built and consumed within a frame
+ * the scratch arena is used in scopes: gf3d_scratch_begin marks it and gf3d_scratch_end gives back everything
+ * allocated since, so scopes nest.  Use it for arrays that only live inside one function, such as the enumerations
+ * vulkan hands back at startup
+ * neither arena is thread safe, both belong to the main thread
+ *
+ * every gf3d_allocate_array and gf3d_memory_allocate is counted, and at the start of each frame the count is compared
+ * with the last one.  After GF3D_MEMORY_WARMUP_FRAMES frames a frame that allocated is reported, and the totals are
+ * logged at exit
+ *
+ * memory from gf3d_memory_allocate is tagged with the subsystem that owns it and tracked until gf3d_memory_free: live
+ * bytes, peak bytes and counts per tag, and where each live allocation was made.  Device memory is tracked by the same
+ * tags through gf3d_memory_gpu_allocated and gf3d_memory_gpu_freed.  At exit the usage of every tag is logged, and then
+ * every tracked allocation still outstanding is listed as a leak.  Call gf3d_memory_init before initializing anything
+ * else so that it cleans up last, after every subsystem has freed what it owns
+ */
+
+#define GF3D_ARENA_ALIGNMENT        16      /**<every arena allocation starts on this boundary*/
+#define GF3D_MEMORY_WARMUP_FRAMES   8       /**<frames that may still allocate while pools and caches fill up*/
+
+typedef enum
+{
+    MT_General = 0,     /**<anything without a better tag*/
+    MT_Graphics,        /**<vulkan instance, devices, queues and command buffers*/
+    MT_Swapchain,
+    MT_Pipeline,        /**<pipelines and their shader code*/
+    MT_Descriptors,
+    MT_Mesh,
+    MT_Model,
+    MT_Texture,
+    MT_Render,          /**<batches, the render queue, the render graph, indirect draws and uniforms*/
+    MT_Scene,           /**<entities, transforms, culling, spatial trees and cameras*/
+    MT_Physics,         /**<collision shapes, bodies and pairs*/
+    MT_Logger,
+    MT_Trace,
+    MT_Arena,           /**<the blocks behind the frame and scratch arenas*/
+    MT_MAX
+}MemoryTag;
+
+typedef struct
+{
+    Uint64      liveBytes;
+    Uint64      peakBytes;
+    Uint32      liveCount;
+    Uint32      allocations;    /**<allocations made since start, freed or not*/
+}MemoryUsage;
+
+typedef struct
+{
+    MemoryUsage host;
+    MemoryUsage gpu;
+}MemoryTagStats;
+
+typedef struct
+{
+    const char *name;
+    Uint8      *data;
+    size_t      size;       /**<bytes in data*/
+    size_t      used;       /**<bytes handed out, alignment padding included*/
+    size_t      peak;       /**<the most that was ever used at once*/
+    Uint32      overflows;  /**<allocations that did not fit*/
+}MemoryArena;
+
+typedef struct
+{
+    MemoryArena    *arena;
+    size_t          mark;   /**<where the arena was when the scope began*/
+}MemoryScratch;
+
+typedef struct
+{
+    Uint32      heapAllocations;        /**<gf3d_allocate_array and gf3d_memory_allocate calls since start*/
+    Uint32      frames;                 /**<frames begun*/
+    Uint32      lastFrameAllocations;   /**<heap allocations made during the last complete frame*/
+    Uint32      allocatingFrames;       /**<frames past the warmup that made any heap allocation*/
+    size_t      frameArenaPeak;
+    size_t      scratchArenaPeak;
+    Uint32      arenaOverflows;         /**<frame and scratch allocations that did not fit*/
+}MemoryStats;
+
+/**
+ * @brief make the frame and scratch arenas and start counting.  Will clean itself up at exit
+ * @note call before gf3d_vgraphics_init, its startup enumerations use the scratch arena
+ * @param frameSize bytes in the frame arena
+ * @param scratchSize bytes in the scratch arena
+ */
+void gf3d_memory_init(size_t frameSize,size_t scratchSize);
+
+/**
+ * @brief empty the frame arena and check the last frame's heap allocations, gf3d_vgraphics_clear calls this
+ */
+void gf3d_memory_begin_frame();
+
+/**
+ * @brief count a heap allocation, gf3d_allocate_array and gf3d_memory_allocate call this.  Safe from any thread
+ */
+void gf3d_memory_count_heap();
+
+/**
+ * @brief get the counters
+ * @param stats filled in with the current values
+ */
+void gf3d_memory_get_stats(MemoryStats *stats);
+
+/**
+ * @brief allocate an array from the frame arena, valid until the next frame begins
+ * @param typeSize the size of one element
+ * @param count how many elements
+ * @return zeroed memory, or NULL if the arena is out of room or not initialized
+ */
+void *gf3d_frame_allocate_array(size_t typeSize,size_t count);
+
+/**
+ * @brief open a scope in the scratch arena
+ * @return the scope, allocate from its arena and pass it to gf3d_scratch_end
+ */
+MemoryScratch gf3d_scratch_begin();
+
+/**
+ * @brief give back everything allocated in the scratch arena since the scope began, inner scopes included
+ * @param scratch the scope from gf3d_scratch_begin
+ */
+void gf3d_scratch_end(MemoryScratch scratch);
+
+/**
+ * TAGGED ALLOCATIONS
+ */
+
+/**
+ * @brief allocate a zeroed, tracked array, like gf3d_allocate_array.  Free it with gf3d_memory_free
+ * @param tag the subsystem that owns the memory
+ * @param typeSize the size of one element
+ * @param count how many elements
+ * @return the array, or NULL on error (see logs)
+ */
+#define gf3d_memory_allocate(tag,typeSize,count) _gf3d_memory_allocate((tag),(typeSize),(count),__FILE__,__LINE__)
+void *_gf3d_memory_allocate(MemoryTag tag,size_t typeSize,size_t count,const char *file,int line);
+
+/**
+ * @brief free memory from gf3d_memory_allocate
+ * @note memory that is not tracked, such as memory allocated before a plain free left a stale entry, is just freed
+ * @param data the memory to free, NULL is ignored
+ */
+void gf3d_memory_free(void *data);
+
+/**
+ * @brief count memory that a tag owns but that was not allocated through gf3d_memory_allocate
+ * @param tag the owner
+ * @param bytes how much
+ */
+void gf3d_memory_host_allocated(MemoryTag tag,Uint64 bytes);
+
+/**
+ * @brief stop counting memory added with gf3d_memory_host_allocated
+ * @param tag the owner
+ * @param bytes how much
+ */
+void gf3d_memory_host_freed(MemoryTag tag,Uint64 bytes);
+
+/**
+ * @brief count device memory allocated for a tag
+ * @param tag the owner
+ * @param bytes the size of the allocation
+ */
+void gf3d_memory_gpu_allocated(MemoryTag tag,Uint64 bytes);
+
+/**
+ * @brief count device memory freed for a tag
+ * @param tag the owner
+ * @param bytes the size of the allocation
+ */
+void gf3d_memory_gpu_freed(MemoryTag tag,Uint64 bytes);
+
+/**
+ * @brief get the usage of a tag
+ * @param tag the tag
+ * @param stats filled in with the host and device usage
+ */
+void gf3d_memory_get_tag_stats(MemoryTag tag,MemoryTagStats *stats);
+
+/**
+ * @brief get the name of a tag, for reports
+ * @param tag the tag
+ * @return its name, "unknown" for values out of range
+ */
+const char *gf3d_memory_tag_name(MemoryTag tag);
+
+/**
+ * @brief log the usage of every tag that has been used
+ */
+void gf3d_memory_report();
+
+/**
+ * @brief log every tracked allocation still outstanding, and any device memory not freed
+ * @return how many host allocations are outstanding
+ */
+Uint32 gf3d_memory_report_leaks();
+
+/**
+ * ARENAS
+ */
+
+/**
+ * @brief allocate an arena's memory
+ * @param arena the arena to set up
+ * @param name used in warnings, a string that outlives the arena
+ * @param size bytes to reserve
+ * @return false if the memory could not be allocated
+ */
+Bool gf3d_arena_create(MemoryArena *arena,const char *name,size_t size);
+
+/**
+ * @brief free an arena's memory, everything allocated from it is gone
+ * @param arena the arena to free
+ */
+void gf3d_arena_free(MemoryArena *arena);
+
+/**
+ * @brief allocate from an arena without clearing the memory
+ * @param arena the arena to allocate from
+ * @param size bytes needed
+ * @return the memory, aligned to GF3D_ARENA_ALIGNMENT, or NULL if it does not fit
+ */
+void *gf3d_arena_allocate(MemoryArena *arena,size_t size);
+
+/**
+ * @brief allocate a zeroed array from an arena, like gf3d_allocate_array
+ * @param arena the arena to allocate from
+ * @param typeSize the size of one element
+ * @param count how many elements
+ * @return the array, or NULL if it does not fit
+ */
+void *gf3d_arena_allocate_array(MemoryArena *arena,size_t typeSize,size_t count);
+
+/**
+ * @brief give back everything allocated from an arena
+ * @param arena the arena to empty
+ */
+void gf3d_arena_reset(MemoryArena *arena);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __GF3D_MESH_H__
+#define __GF3D_MESH_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_buffers.h"
+
+/**
+ * @purpose indexed triangle meshes living in GPU buffers
+ */
+
+#define GF3D_MESH_ATTRIBUTE_COUNT 3
+
+typedef struct
+{
+    Vector3D    vertex;
+    Vector3D    normal;
+    Vector2D    texel;
+}Vertex;
+
+typedef struct
+{
+    Bool        inUse;
+    GpuBuffer   vertexBuffer;
+    Uint32      vertexCount;
+    GpuBuffer   indexBuffer;
+    Uint32      indexCount;     /**<three per triangle*/
+    Vector3D    center;         /**<center of the bounding sphere, in model space*/
+    float       radius;         /**<radius of the bounding sphere*/
+}Mesh;
+
+/**
+ * @brief initialize the mesh manager.  Will clean itself up at exit
+ * @note needs gf3d_buffers to be initialized first
+ * @param max_meshes how many meshes can exist at once
+ */
+void gf3d_mesh_init(Uint32 max_meshes);
+
+/**
+ * @brief create a mesh from vertex and index data, the data is copied into GPU buffers
+ * @param vertices the vertex data
+ * @param vertexCount how many vertices there are
+ * @param indices triangle list indices into vertices
+ * @param indexCount how many indices there are
+ * @return NULL on error (see logs) or the new mesh
+ */
+Mesh *gf3d_mesh_new_from_data(const Vertex *vertices,Uint32 vertexCount,const Uint32 *indices,Uint32 indexCount);
+
+/**
+ * @brief free a mesh and its buffers
+ * @param mesh the mesh to free
+ */
+void gf3d_mesh_free(Mesh *mesh);
+
+/**
+ * @brief get the binding description for per vertex mesh data
+ * @param binding the vertex buffer binding slot the mesh will be bound to
+ * @return the binding description
+ */
+VkVertexInputBindingDescription gf3d_mesh_get_binding_description(Uint32 binding);
+
+/**
+ * @brief get the attribute descriptions for per vertex mesh data: position, normal, texel
+ * @param binding the vertex buffer binding slot the mesh will be bound to
+ * @param attributes output, must have room for GF3D_MESH_ATTRIBUTE_COUNT entries.  locations start at 0
+ */
+void gf3d_mesh_get_attribute_descriptions(Uint32 binding,VkVertexInputAttributeDescription *attributes);
+
+/**
+ * @brief get the slot a mesh occupies in the mesh manager, stable for the life of the mesh
+ * @param mesh the mesh
+ * @return 0 for NULL or meshes not owned by the manager, the slot index otherwise
+ */
+Uint32 gf3d_mesh_get_index(Mesh *mesh);
+
+#endif
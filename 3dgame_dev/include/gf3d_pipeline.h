@@ -0,0 +1,110 @@
+#ifndef __GF3D_PIPELINE_H__
+#define __GF3D_PIPELINE_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+
+/**
+ * @purpose graphics pipeline management
+ * every graphics pipeline renders into the same color and depth attachments, so their render passes are compatible
+ * with the swap chain framebuffers.  With the depth pre-pass enabled, opaque pipelines also get a depth only variant:
+ * the pre-pass lays down depth with it and the main pass then shades only the fragments whose depth is EQUAL
+ */
+
+typedef enum
+{
+    PD_Opaque = 0,      /**<depth tested and written*/
+    PD_Transparent,     /**<depth tested against opaque geometry but not written*/
+    PD_None             /**<no depth testing*/
+}PipelineDepth;
+
+typedef struct
+{
+    VkPipeline          graphicsPipeline;
+    VkRenderPass        renderPass;
+    VkPipelineLayout    pipelineLayout;
+    size_t              vertSize;
+    char               *vertShader;
+    VkShaderModule      vertModule;
+    size_t              fragSize;
+    char               *fragShader;
+    VkShaderModule      fragModule;
+    VkPipeline          computePipeline;    /**<set instead of graphicsPipeline for compute pipelines*/
+    size_t              compSize;
+    char               *compShader;
+    VkShaderModule      compModule;
+    VkDevice            device;
+    PipelineDepth       depth;
+    VkPipeline          depthPipeline;      /**<depth only variant for the pre-pass, VK_NULL_HANDLE when there is none*/
+}Pipeline;
+
+/**
+ * @brief setup pipeline system.  Will clean itself up at exit
+ * @param max_pipelines how many concurrent pipelines to support, the pool holds at most this many
+ */
+void gf3d_pipeline_init(Uint32 max_pipelines);
+
+/**
+ * @brief setup an opaque graphics pipeline that takes no vertex input
+ * @param device the logical device that the pipeline will be set up on
+ * @param vertFile the filename of the SPIRV vertex shader to load
+ * @param fragFile the filename of the SPIRV fragment shader to load
+ * @return NULL on error (see logs) or a pointer to a pipeline
+ * @note viewport and scissor are dynamic state, set with vkCmdSetViewport and vkCmdSetScissor before drawing
+ */
+Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragFile);
+
+/**
+ * @brief setup a graphics pipeline that reads vertex buffers
+ * @param device the logical device that the pipeline will be set up on
+ * @param vertFile the filename of the SPIRV vertex shader to load
+ * @param fragFile the filename of the SPIRV fragment shader to load
+ * @param vertexInput the vertex bindings and attributes, NULL for none
+ * @param depth how the pipeline uses the depth buffer
+ * @return NULL on error (see logs) or a pointer to a pipeline
+ * @note viewport and scissor are dynamic state, set with vkCmdSetViewport and vkCmdSetScissor before drawing
+ */
+Pipeline *gf3d_pipeline_graphics_load_with_input(
+    VkDevice device,
+    char *vertFile,
+    char *fragFile,
+    const VkPipelineVertexInputStateCreateInfo *vertexInput,
+    PipelineDepth depth);
+
+/**
+ * @brief choose whether opaque pipelines are drawn with a depth pre-pass
+ * @note only affects pipelines loaded afterward, so set this before gf3d_vgraphics_init loads the default pipeline
+ * @param enable if true opaque pipelines get a depthPipeline and their main pipeline tests depth EQUAL without writing it
+ */
+void gf3d_pipeline_set_depth_prepass(Bool enable);
+
+/**
+ * @brief check if the depth pre-pass is enabled
+ * @return true if opaque pipelines are built for a depth pre-pass
+ */
+Bool gf3d_pipeline_get_depth_prepass();
+
+/**
+ * @brief setup a compute pipeline
+ * @param device the logical device that the pipeline will be set up on
+ * @param compFile the filename of the SPIRV compute shader to load
+ * @param setLayout the descriptor set layout for set 0, VK_NULL_HANDLE for none
+ * @param pushConstantSize how many bytes of push constants the shader reads, 0 for none
+ * @return NULL on error (see logs) or a pointer to a pipeline
+ */
+Pipeline *gf3d_pipeline_compute_load(VkDevice device,char *compFile,VkDescriptorSetLayout setLayout,Uint32 pushConstantSize);
+
+/**
+ * @brief free a pipeline, destroying all of its vulkan objects
+ * @param pipe the pipeline to free
+ */
+void gf3d_pipeline_free(Pipeline *pipe);
+
+/**
+ * @brief get the slot a pipeline occupies in the pipeline manager, stable for the life of the pipeline
+ * @param pipe the pipeline
+ * @return 0 for NULL or pipelines not owned by the manager, the slot index otherwise
+ */
+Uint32 gf3d_pipeline_get_index(Pipeline *pipe);
+
+#endif
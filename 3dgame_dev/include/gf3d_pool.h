@@ -0,0 +1,130 @@
+#ifndef __GF3D_POOL_H__
+#define __GF3D_POOL_H__
+
+#include "gf3d_types.h"
+#include "gf3d_memory.h"
+
+/**
+ * @purpose fixed size object pools
+ * a pool hands out elements of one type from chunks of memory it allocates up front.  Free elements are linked
+ * through their own memory, so getting and freeing an element are both O(1) however many there are.  Elements never
+ * move once allocated, pointers to them stay valid until they are freed
+ * a pool starts with one chunk and can be allowed to add more as it fills.  Every element has an index, stable for its
+ * life, that is small and dense enough to pack into sort keys
+ * live elements are tracked in a bit set, so walking them skips free space 64 elements at a time
+ * a pool's chunks are tracked under the memory tag it is created with
+ * pools are not thread safe
+ */
+
+#define GF3D_POOL_ALIGNMENT     16      /**<every element starts on this boundary*/
+#define GF3D_POOL_NONE          -1
+
+typedef struct
+{
+    const char *name;
+    MemoryTag   tag;            /**<what the pool's memory is tracked as*/
+    size_t      elementSize;    /**<the size of the type stored*/
+    size_t      stride;         /**<bytes from one element to the next, the index header included*/
+    Uint32      chunkShift;     /**<elements per chunk is 1 << chunkShift*/
+    Uint32      chunkCount;
+    Uint32      chunkMax;       /**<most chunks the pool may grow to, 0 for no limit*/
+    Uint32      countMax;       /**<most live elements, chunkSize * chunkMax as asked for before rounding, 0 for no limit*/
+    Uint32      chunkSlots;     /**<room in chunks, and in live for that many chunks*/
+    Uint8     **chunks;
+    Uint64     *live;           /**<one bit per element, set while it is allocated*/
+    Sint32      freeList;       /**<index of the first free element, GF3D_POOL_NONE when every chunk is full*/
+    Uint32      count;          /**<live elements*/
+}ObjectPool;
+
+/**
+ * @brief set up a pool for a type
+ * @param pool the pool to set up
+ * @param tag what the pool's memory is tracked as
+ * @param type the element type
+ * @param chunkSize elements per chunk
+ * @param chunkMax how many chunks the pool may grow to, 1 for a fixed size pool, 0 for no limit
+ */
+#define gf3d_pool_create_typed(pool,tag,type,chunkSize,chunkMax) gf3d_pool_create((pool),#type,(tag),sizeof(type),(chunkSize),(chunkMax))
+
+/**
+ * @brief get a new zeroed element of a type from a pool made with gf3d_pool_create_typed
+ */
+#define gf3d_pool_new_typed(pool,type) ((type *)gf3d_pool_new(pool))
+
+/**
+ * @brief get a live element of a type by index
+ */
+#define gf3d_pool_get_typed(pool,type,index) ((type *)gf3d_pool_get((pool),(index)))
+
+/**
+ * @brief walk the live elements of a type, see gf3d_pool_next
+ */
+#define gf3d_pool_next_typed(pool,type,cursor) ((type *)gf3d_pool_next((pool),(cursor)))
+
+/**
+ * @brief set up a pool and allocate its first chunk
+ * @param pool the pool to set up
+ * @param name used in logs, a string that outlives the pool
+ * @param tag what the pool's memory is tracked as
+ * @param elementSize the size of one element
+ * @param chunkSize elements per chunk, rounded up to a power of two of at least 64
+ * @param chunkMax how many chunks the pool may grow to, 1 for a fixed size pool, 0 for no limit
+ * @note the rounding only sizes the chunks: a limited pool still hands out at most chunkSize * chunkMax elements
+ * @return false if the pool could not be allocated (see logs)
+ */
+Bool gf3d_pool_create(ObjectPool *pool,const char *name,MemoryTag tag,size_t elementSize,Uint32 chunkSize,Uint32 chunkMax);
+
+/**
+ * @brief free all of a pool's memory, every element in it is gone
+ * @note nothing is done for the live elements, clean them up first if they own anything
+ * @param pool the pool to destroy
+ */
+void gf3d_pool_destroy(ObjectPool *pool);
+
+/**
+ * @brief get a free element from a pool, growing the pool if it is full and allowed to
+ * @param pool the pool to allocate from
+ * @return a zeroed element, or NULL if the pool is full
+ */
+void *gf3d_pool_new(ObjectPool *pool);
+
+/**
+ * @brief give an element back to its pool
+ * @param pool the pool it came from
+ * @param element the element, NULL and elements already freed are ignored
+ */
+void gf3d_pool_free(ObjectPool *pool,void *element);
+
+/**
+ * @brief get an element's index in its pool
+ * @param pool the pool it came from
+ * @param element an element from any pool, or NULL
+ * @return the index, or GF3D_POOL_NONE for NULL, free elements and elements of other pools
+ */
+Sint32 gf3d_pool_get_index(ObjectPool *pool,const void *element);
+
+/**
+ * @brief get a live element by index
+ * @param pool the pool
+ * @param index the element's index
+ * @return the element, or NULL if the index is out of range or free
+ */
+void *gf3d_pool_get(ObjectPool *pool,Sint32 index);
+
+/**
+ * @brief walk the live elements in index order.  Start with a cursor of 0
+ * @note the element returned may be freed before the next call, other changes during a walk may or may not be seen
+ * @param pool the pool to walk
+ * @param cursor where to resume from, moved past the element returned
+ * @return the next live element, NULL when there are no more
+ */
+void *gf3d_pool_next(ObjectPool *pool,Uint32 *cursor);
+
+/**
+ * @brief get how many elements the pool can hold before it has to grow
+ * @param pool the pool
+ * @return the number of elements in its chunks
+ */
+Uint32 gf3d_pool_get_capacity(ObjectPool *pool);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __GF3D_QUATERNION_H__
+#define __GF3D_QUATERNION_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_matrix.h"
+
+/**
+ * @purpose rotations as unit quaternions
+ * (x,y,z) is the vector part and w the scalar part, the same layout gf3d_matrix_compose takes.  Unlike chains of
+ * rotate_about calls they compose without gimbal lock and interpolate along the shortest arc
+ */
+
+typedef Vector4D Quaternion;
+
+/**
+ * @brief get the rotation that does nothing
+ */
+Quaternion gf3d_quaternion_identity();
+
+/**
+ * @brief build a rotation about an axis
+ * @param axis the axis to rotate about, does not need to be normalized
+ * @param angle the angle to rotate by, in radians, counter clockwise looking down the axis
+ * @return the rotation, the identity if the axis is zero
+ */
+Quaternion gf3d_quaternion_from_axis_angle(Vector3D axis,float angle);
+
+/**
+ * @brief combine two rotations, out = a * b: rotating by out is rotating by b, then by a
+ * @param out the result, may be a or b
+ * @param a the second rotation applied
+ * @param b the first rotation applied
+ */
+void gf3d_quaternion_multiply(Quaternion *out,Quaternion a,Quaternion b);
+
+/**
+ * @brief scale a quaternion back to unit length, needed now and then after many multiplies
+ * @param q the quaternion to normalize, set to the identity if it is zero
+ */
+void gf3d_quaternion_normalize(Quaternion *q);
+
+/**
+ * @brief get the rotation that undoes a unit quaternion
+ */
+Quaternion gf3d_quaternion_conjugate(Quaternion q);
+
+/**
+ * @brief rotate a vector
+ * @param out the rotated vector
+ * @param q a unit quaternion
+ * @param v the vector to rotate
+ */
+void gf3d_quaternion_rotate_vector(Vector3D *out,Quaternion q,Vector3D v);
+
+/**
+ * @brief interpolate between two rotations at constant angular speed, along the shortest arc
+ * @param out the result
+ * @param a the rotation at t = 0
+ * @param b the rotation at t = 1
+ * @param t how far from a to b
+ */
+void gf3d_quaternion_slerp(Quaternion *out,Quaternion a,Quaternion b,float t);
+
+/**
+ * @brief build a rotation matrix from a unit quaternion
+ * @param out the result
+ * @param q the rotation
+ */
+void gf3d_quaternion_to_matrix(Matrix4 out,Quaternion q);
+
+/**
+ * @brief get the rotation part of a matrix
+ * @param q the rotation, normalized
+ * @param mat a matrix of rotation, scale and translation
+ * @return false if the matrix has a zero scale
+ */
+Bool gf3d_quaternion_from_matrix(Quaternion *q,Matrix4 mat);
+
+#endif
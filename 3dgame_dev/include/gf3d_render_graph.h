@@ -0,0 +1,176 @@
+#ifndef __GF3D_RENDER_GRAPH_H__
+#define __GF3D_RENDER_GRAPH_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+
+/**
+ * @purpose frame render graph
+ * passes declare which resources they read and write and how.  Compiling the graph:
+ *  culls passes whose writes never reach an output resource
+ *  orders the remaining passes (declaration order, a pass can only consume what earlier passes produced)
+ *  computes the layout transitions and hazards between uses, batched into one vkCmdPipelineBarrier per pass
+ *  creates the transient images and lets images whose lifetimes do not overlap share the same memory
+ * imported resources (swap chain images, persistent buffers) are tracked the same way but owned elsewhere
+ */
+
+typedef enum
+{
+    RGU_ColorAttachment = 0,    /**<rendered to as a color attachment*/
+    RGU_DepthAttachment,        /**<depth tested and, when written, depth written*/
+    RGU_Sampled,                /**<sampled in a fragment shader*/
+    RGU_Compute,                /**<storage image or buffer in a compute shader*/
+    RGU_Indirect,               /**<indirect draw or dispatch arguments*/
+    RGU_Vertex,                 /**<vertex or index buffer*/
+    RGU_Transfer,               /**<copy or blit source or destination*/
+    RGU_MAX
+}RenderGraphUsage;
+
+typedef struct
+{
+    Uint32          passes;             /**<passes declared*/
+    Uint32          culledPasses;       /**<passes removed because nothing consumed their output*/
+    Uint32          barrierBatches;     /**<vkCmdPipelineBarrier calls per execution*/
+    Uint32          imageBarriers;      /**<image barriers per execution, layout transitions included*/
+    Uint32          memoryBarriers;     /**<global memory barriers per execution, used for buffers*/
+    Uint32          transientImages;    /**<transient images created*/
+    Uint32          memoryBlocks;       /**<device memory allocations backing them*/
+    VkDeviceSize    transientBytes;     /**<memory the transient images would need without aliasing*/
+    VkDeviceSize    allocatedBytes;     /**<memory actually allocated for them*/
+}RenderGraphStats;
+
+/**
+ * @brief called to record a pass, after the graph has recorded the barriers the pass needs
+ * @param commandBuffer the command buffer being recorded
+ * @param pass the pass being recorded
+ * @param userData the pointer given to gf3d_render_graph_add_pass
+ */
+typedef void (*RenderGraphExecute)(VkCommandBuffer commandBuffer,Sint32 pass,void *userData);
+
+/**
+ * @brief initialize the render graph.  Will clean itself up at exit
+ * @note needs gf3d_buffers to be initialized first
+ * @param device the logical device transient images are created on
+ * @param maxPasses how many passes the graph can hold
+ * @param maxResources how many resources the graph can hold
+ */
+void gf3d_render_graph_init(VkDevice device,Uint32 maxPasses,Uint32 maxResources);
+
+/**
+ * @brief remove every pass and resource, destroying the transient images
+ * @note the GPU must be done with any command buffer the graph was executed into
+ */
+void gf3d_render_graph_reset();
+
+/**
+ * @brief declare a transient image, created by the graph at compile time
+ * @param name for debugging
+ * @param format the image format
+ * @param extent the image size
+ * @return -1 on error, the resource id otherwise
+ */
+Sint32 gf3d_render_graph_create_image(const char *name,VkFormat format,VkExtent2D extent);
+
+/**
+ * @brief declare an image owned outside of the graph
+ * @param name for debugging
+ * @param format the image format, used to pick the aspect of its barriers
+ * @param initialLayout the layout the image is in when the graph starts
+ * @param initialStage the stages that must finish before the first use, such as the stage a semaphore wait covers
+ * @param finalLayout the layout to leave the image in, VK_IMAGE_LAYOUT_UNDEFINED to leave it as the last pass did
+ * @return -1 on error, the resource id otherwise
+ */
+Sint32 gf3d_render_graph_import_image(
+    const char *name,
+    VkFormat format,
+    VkImageLayout initialLayout,
+    VkPipelineStageFlags initialStage,
+    VkImageLayout finalLayout);
+
+/**
+ * @brief declare a buffer owned outside of the graph
+ * @param name for debugging
+ * @return -1 on error, the resource id otherwise
+ */
+Sint32 gf3d_render_graph_import_buffer(const char *name);
+
+/**
+ * @brief set the image behind an imported image resource, such as this frame's swap chain image
+ * @note can change every execution without recompiling
+ * @param resource the imported image resource
+ * @param image the image
+ * @param view a view of the image, VK_NULL_HANDLE if no pass needs one
+ */
+void gf3d_render_graph_set_image(Sint32 resource,VkImage image,VkImageView view);
+
+/**
+ * @brief mark a resource as a result of the graph, passes contributing to it are never culled
+ * @param resource the resource
+ */
+void gf3d_render_graph_set_output(Sint32 resource);
+
+/**
+ * @brief add a pass.  Passes execute in the order they are added, minus the culled ones
+ * @param name for debugging
+ * @param execute called to record the pass
+ * @param userData passed to execute
+ * @return -1 on error, the pass id otherwise
+ */
+Sint32 gf3d_render_graph_add_pass(const char *name,RenderGraphExecute execute,void *userData);
+
+/**
+ * @brief declare that a pass reads a resource
+ * @param pass the pass
+ * @param resource the resource
+ * @param usage how the pass reads it
+ */
+void gf3d_render_graph_read(Sint32 pass,Sint32 resource,RenderGraphUsage usage);
+
+/**
+ * @brief declare that a pass writes a resource.  A write that is not also declared as a read discards the old contents
+ * @param pass the pass
+ * @param resource the resource
+ * @param usage how the pass writes it
+ */
+void gf3d_render_graph_write(Sint32 pass,Sint32 resource,RenderGraphUsage usage);
+
+/**
+ * @brief cull, order, compute barriers and create and alias the transient images
+ * @return false on error (see logs)
+ */
+Bool gf3d_render_graph_compile();
+
+/**
+ * @brief record the compiled graph: each live pass's barriers followed by the pass itself
+ * @param commandBuffer the command buffer being recorded, outside of any render pass
+ */
+void gf3d_render_graph_execute(VkCommandBuffer commandBuffer);
+
+/**
+ * @brief get the image behind a resource
+ * @param resource the resource
+ * @return VK_NULL_HANDLE if it has none
+ */
+VkImage gf3d_render_graph_get_image(Sint32 resource);
+
+/**
+ * @brief get the view of the image behind a resource
+ * @param resource the resource
+ * @return VK_NULL_HANDLE if it has none
+ */
+VkImageView gf3d_render_graph_get_image_view(Sint32 resource);
+
+/**
+ * @brief check if the last compile culled a pass
+ * @param pass the pass
+ * @return true if the pass will not be executed
+ */
+Bool gf3d_render_graph_pass_culled(Sint32 pass);
+
+/**
+ * @brief get the counters of the last compile
+ * @param stats output, the counters are copied here
+ */
+void gf3d_render_graph_get_stats(RenderGraphStats *stats);
+
+#endif
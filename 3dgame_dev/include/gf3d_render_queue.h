@@ -0,0 +1,91 @@
+#ifndef __GF3D_RENDER_QUEUE_H__
+#define __GF3D_RENDER_QUEUE_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_mesh.h"
+#include "gf3d_pipeline.h"
+
+/**
+ * @purpose sorted draw submission
+ * each draw submitted during a frame gets a 64 bit sort key and the keys are radix sorted before recording
+ * opaque keys are layer | pipeline | material | mesh | depth so state changes are minimized and near objects draw first
+ * transparent keys are layer | inverted depth | pipeline | material | mesh so far objects draw first
+ * each draw is a single indexed draw of a mesh on binding 0, with the object's gf3d_uniforms slot bound for its model matrix
+ */
+
+typedef enum
+{
+    RL_Opaque = 0,      /**<sorted by state, then front to back*/
+    RL_Transparent,     /**<sorted back to front*/
+    RL_Overlay,         /**<sorted back to front, drawn after everything else*/
+    RL_MAX
+}RenderLayer;
+
+typedef struct
+{
+    Uint32  submitted;              /**<draws submitted this frame*/
+    Uint32  dropped;                /**<draws that did not fit in the queue*/
+    Uint32  sortPasses;             /**<radix passes run, passes over bytes every key shares are skipped*/
+    Uint32  pipelineBinds;          /**<pipeline changes recorded*/
+    Uint32  materialChanges;        /**<material changes recorded*/
+    Uint32  meshBinds;              /**<vertex and index buffer changes recorded*/
+    Sint32  pipelineBindsAvoided;   /**<pipeline changes that recording in submission order would have added,
+                                        negative if the sort added some, as depth ordered layers can*/
+    Sint32  materialChangesAvoided; /**<material changes that recording in submission order would have added*/
+    Sint32  meshBindsAvoided;       /**<buffer changes that recording in submission order would have added*/
+    double  sortMs;                 /**<CPU time spent building and sorting keys*/
+    double  recordMs;               /**<CPU time spent recording the draws*/
+}RenderQueueStats;
+
+/**
+ * @brief initialize the render queue.  Will clean itself up at exit
+ * @param maxItems how many draws can be submitted in one frame
+ */
+void gf3d_render_queue_init(Uint32 maxItems);
+
+/**
+ * @brief start collecting draws for a new frame, discarding anything submitted before
+ */
+void gf3d_render_queue_begin();
+
+/**
+ * @brief submit a draw for this frame
+ * @param layer which layer the draw belongs to, this decides both its order and its depth sort direction
+ * @param pipe the pipeline to draw with, it must use gf3d_uniforms_get_layout for set 0 and the mesh vertex input on binding 0.
+ * opaque layer draws should use PD_Opaque pipelines, the other layers PD_Transparent or PD_None ones
+ * @param material an application defined material id, draws sharing one are kept together.  Only the low 12 bits are used
+ * @param mesh the mesh to draw
+ * @param object the gf3d_uniforms slot holding the draw's model matrix
+ * @param position the world space position used for depth sorting
+ */
+void gf3d_render_queue_submit(RenderLayer layer,Pipeline *pipe,Uint32 material,Mesh *mesh,Sint32 object,Vector3D position);
+
+/**
+ * @brief build the sort keys from the current camera and sort the submitted draws
+ * @note call after the camera has been set for the frame, before recording
+ */
+void gf3d_render_queue_end();
+
+/**
+ * @brief record the sorted draws into a command buffer inside a render pass
+ * @param commandBuffer the command buffer being recorded
+ * @param frame the frame the command buffer will be submitted for
+ */
+void gf3d_render_queue_draw(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief record the depth pre-pass draws of the opaque layer, for pipelines that have a depthPipeline
+ * @param commandBuffer the command buffer being recorded
+ * @param frame the frame the command buffer will be submitted for
+ */
+void gf3d_render_queue_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame);
+
+/**
+ * @brief get the counters for the most recent frame
+ * @param stats output, the counters are copied here
+ */
+void gf3d_render_queue_get_stats(RenderQueueStats *stats);
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef __GF3D_SPATIAL_H__
+#define __GF3D_SPATIAL_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_cull.h"
+
+/**
+ * @purpose scene spatial index
+ * a dynamic bounding volume hierarchy: leaves are inserted where they add the least surface area (SAH)
+ * and the tree is kept balanced with rotations.  Leaves store a box fattened by a margin, so objects that move
+ * a little only touch their own leaf; objects that leave their fat box are reinserted and only their old and
+ * new paths to the root are refit.  Nothing is ever rebuilt from scratch
+ */
+
+typedef struct
+{
+    Vector3D    min;
+    Vector3D    max;
+}AABB;
+
+typedef struct SpatialTree_S SpatialTree;
+
+/**
+ * @brief called for each object a query finds
+ * @param proxy the object's proxy id
+ * @param data the data the object was inserted with
+ * @param userData passed through from the query
+ * @return false to stop the query
+ */
+typedef Bool (*SpatialQueryCallback)(Sint32 proxy,void *data,void *userData);
+
+/**
+ * @brief called for each object whose fat box a ray touches, to test the object itself
+ * @param proxy the object's proxy id
+ * @param data the data the object was inserted with
+ * @param userData passed through from the query
+ * @return the distance along the ray to the hit, or a negative number for a miss
+ */
+typedef float (*SpatialRayCallback)(Sint32 proxy,void *data,void *userData);
+
+typedef struct
+{
+    Uint32  proxies;        /**<objects in the tree*/
+    Uint32  nodes;          /**<nodes in use, leaves and branches*/
+    Sint32  height;         /**<height of the root, 0 for a single leaf*/
+    Uint32  moves;          /**<moves that stayed inside their fat box*/
+    Uint32  reinserts;      /**<moves that left their fat box and were reinserted*/
+    Uint32  rotations;      /**<rotations performed to keep the tree balanced*/
+    Uint32  nodesVisited;   /**<nodes tested by queries*/
+}SpatialStats;
+
+/**
+ * @brief make a new, empty tree
+ * @param capacity how many objects to make room for up front, the tree grows as needed
+ * @param margin how far boxes are fattened on each side, in world units
+ * @return NULL on error, the tree otherwise
+ */
+SpatialTree *gf3d_spatial_tree_new(Uint32 capacity,float margin);
+
+/**
+ * @brief free a tree and everything in it
+ * @param tree the tree to free
+ */
+void gf3d_spatial_tree_free(SpatialTree *tree);
+
+/**
+ * @brief add an object to the tree
+ * @param tree the tree to add to
+ * @param box the object's world space bounds
+ * @param data returned to query callbacks for this object
+ * @return -1 on error, the object's proxy id otherwise
+ */
+Sint32 gf3d_spatial_insert(SpatialTree *tree,AABB box,void *data);
+
+/**
+ * @brief remove an object from the tree
+ * @param tree the tree
+ * @param proxy the object's proxy id
+ */
+void gf3d_spatial_remove(SpatialTree *tree,Sint32 proxy);
+
+/**
+ * @brief update an object's bounds
+ * @param tree the tree
+ * @param proxy the object's proxy id
+ * @param box the new world space bounds
+ * @param displacement how far the object moved this update, the fat box is stretched in this direction
+ * @return true if the object left its fat box and was reinserted, false if it stayed inside it
+ * @note if reinserting fails the object is removed from the tree and false is returned, after logging it
+ */
+Bool gf3d_spatial_move(SpatialTree *tree,Sint32 proxy,AABB box,Vector3D displacement);
+
+/**
+ * @brief get the data an object was inserted with
+ * @param tree the tree
+ * @param proxy the object's proxy id
+ * @return NULL if the proxy is not in use
+ */
+void *gf3d_spatial_get_data(SpatialTree *tree,Sint32 proxy);
+
+/**
+ * @brief get the fattened bounds the tree stores for an object
+ * @param tree the tree
+ * @param proxy the object's proxy id
+ * @param box output
+ */
+void gf3d_spatial_get_fat_box(SpatialTree *tree,Sint32 proxy,AABB *box);
+
+/**
+ * @brief find every object whose fat box intersects a frustum
+ * @param tree the tree
+ * @param frustum the frustum, see gf3d_cull_frustum_from_matrix
+ * @param callback called for each object found
+ * @param userData passed to the callback
+ * @return how many objects were found
+ */
+Uint32 gf3d_spatial_query_frustum(SpatialTree *tree,const Frustum *frustum,SpatialQueryCallback callback,void *userData);
+
+/**
+ * @brief find every object whose fat box overlaps a sphere
+ * @param tree the tree
+ * @param center the center of the sphere
+ * @param radius the radius of the sphere
+ * @param callback called for each object found
+ * @param userData passed to the callback
+ * @return how many objects were found
+ */
+Uint32 gf3d_spatial_query_sphere(SpatialTree *tree,Vector3D center,float radius,SpatialQueryCallback callback,void *userData);
+
+/**
+ * @brief find every object whose fat box overlaps a box
+ * @param tree the tree
+ * @param box the box to test
+ * @param callback called for each object found
+ * @param userData passed to the callback
+ * @return how many objects were found
+ */
+Uint32 gf3d_spatial_query_aabb(SpatialTree *tree,AABB box,SpatialQueryCallback callback,void *userData);
+
+/**
+ * @brief find the closest object along a ray
+ * @param tree the tree
+ * @param origin where the ray starts
+ * @param direction the direction of the ray, it does not need to be normalized
+ * @param maxDistance how far along the ray to look, in multiples of direction
+ * @param callback tests each candidate object, the search range shrinks to the closest hit so far
+ * @param userData passed to the callback
+ * @param hitDistance output, optional.  Distance to the closest hit
+ * @return -1 if nothing was hit, the proxy id of the closest hit otherwise
+ */
+Sint32 gf3d_spatial_raycast(
+    SpatialTree *tree,
+    Vector3D origin,
+    Vector3D direction,
+    float maxDistance,
+    SpatialRayCallback callback,
+    void *userData,
+    float *hitDistance);
+
+/**
+ * @brief get the tree's counters
+ * @param tree the tree
+ * @param stats output, the counters are copied here
+ */
+void gf3d_spatial_get_stats(SpatialTree *tree,SpatialStats *stats);
+
+#endif
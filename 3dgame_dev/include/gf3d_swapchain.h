@@ -0,0 +1,81 @@
+#ifndef __GF3D_SWAPCHAIN_H__
+#define __GF3D_SWAPCHAIN_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_pipeline.h"
+
+/**
+ * @purpose swap chain images, their depth buffers and the framebuffers that combine them
+ */
+
+/**
+ * @brief query the surface and create the swap chain.  Will clean itself up at exit
+ * @note needs gf3d_buffers to be initialized first
+ * @param device the physical device
+ * @param logicalDevice the logical device the swap chain is created on
+ * @param surface the surface to present to
+ * @param width the requested width of the swap images
+ * @param height the requested height of the swap images
+ */
+void gf3d_swapchain_init(VkPhysicalDevice device,VkDevice logicalDevice,VkSurfaceKHR surface,Uint32 width,Uint32 height);
+
+/**
+ * @brief check that the surface supports at least one format and presentation mode
+ * @return true if the swap chain is usable
+ */
+Bool gf3d_swapchain_validation_check();
+
+/**
+ * @brief get the format of the swap images
+ */
+VkFormat gf3d_swapchain_get_format();
+
+/**
+ * @brief get the format of the depth buffers
+ */
+VkFormat gf3d_swapchain_get_depth_format();
+
+/**
+ * @brief get the resolution of the swap images
+ */
+VkExtent2D gf3d_swapchain_get_extent();
+
+/**
+ * @brief create a depth buffer and a framebuffer for each swap image
+ * @param pipe a pipeline whose render pass the framebuffers must be compatible with
+ */
+void gf3d_swapchain_setup_frame_buffers(Pipeline *pipe);
+
+/**
+ * @brief get how many swap images, and so framebuffers, there are
+ */
+Uint32 gf3d_swapchain_get_frame_buffer_count();
+
+/**
+ * @brief get the swap chain handle
+ */
+VkSwapchainKHR gf3d_swapchain_get();
+
+/**
+ * @brief get the framebuffer for a swap image
+ * @param index the swap image index
+ * @return 0 if out of range, the framebuffer otherwise
+ */
+VkFramebuffer gf3d_swapchain_get_frame_buffer_by_index(Uint32 index);
+
+/**
+ * @brief get a swap image
+ * @param index the swap image index
+ * @return VK_NULL_HANDLE if out of range, the image otherwise
+ */
+VkImage gf3d_swapchain_get_image_by_index(Uint32 index);
+
+/**
+ * @brief get the depth image that goes with a swap image
+ * @param index the swap image index
+ * @return VK_NULL_HANDLE if out of range or not created yet, the image otherwise
+ */
+VkImage gf3d_swapchain_get_depth_image_by_index(Uint32 index);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef __GF3D_TRACE_H__
+#define __GF3D_TRACE_H__
+
+#include "gf3d_types.h"
+
+/**
+ * @purpose CPU tracing
+ * zones, counters and instant events are recorded with a timestamp into a buffer owned by the thread that records
+ * them, so recording takes no locks.  At exit, or when asked, every buffer is written out as Chrome trace event JSON,
+ * which chrome://tracing, Perfetto (ui.perfetto.dev) and speedscope open directly
+ * a full buffer drops new events rather than overwrite old ones, so the startup timeline is always kept.  Zones are
+ * dropped whole: an end is never recorded without its begin
+ * define GF3D_TRACE_DISABLED to compile every trace macro out
+ */
+
+typedef enum
+{
+    TE_Begin = 0,   /**<a zone opens*/
+    TE_End,         /**<the innermost open zone closes*/
+    TE_Counter,     /**<a named value changes*/
+    TE_Instant,     /**<something happened at one moment*/
+    TE_MAX
+}TraceEventType;
+
+#ifndef GF3D_TRACE_DISABLED
+
+/**
+ * @brief open a zone on this thread, close it with GF3D_TRACE_END in the same scope
+ * @param name a string that lives until the trace is written, normally a literal
+ */
+#define GF3D_TRACE_BEGIN(name) gf3d_trace_event(TE_Begin,(name),0)
+
+/**
+ * @brief close the innermost zone opened on this thread
+ */
+#define GF3D_TRACE_END() gf3d_trace_event(TE_End,NULL,0)
+
+/**
+ * @brief record the value of a counter, viewers draw each counter as a graph
+ * @param name a string that lives until the trace is written, normally a literal
+ * @param value the new value
+ */
+#define GF3D_TRACE_COUNTER(name,value) gf3d_trace_event(TE_Counter,(name),(value))
+
+/**
+ * @brief mark a moment on this thread's timeline
+ * @param name a string that lives until the trace is written, normally a literal
+ */
+#define GF3D_TRACE_INSTANT(name) gf3d_trace_event(TE_Instant,(name),0)
+
+#else
+
+#define GF3D_TRACE_BEGIN(name) do {} while (0)
+#define GF3D_TRACE_END() do {} while (0)
+#define GF3D_TRACE_COUNTER(name,value) do {} while (0)
+#define GF3D_TRACE_INSTANT(name) do {} while (0)
+
+#endif
+
+/**
+ * @brief start tracing.  Will write the trace and clean itself up at exit
+ * @param eventsPerThread how many events each thread can record before it drops them
+ * @param filename where to write the trace at exit, NULL to only write it with gf3d_trace_write
+ */
+void gf3d_trace_init(Uint32 eventsPerThread,const char *filename);
+
+/**
+ * @brief record an event on the calling thread, use the GF3D_TRACE_ macros instead
+ * @param type what kind of event
+ * @param name the zone, counter or event name, NULL for TE_End
+ * @param value the counter value, ignored for other types
+ */
+void gf3d_trace_event(TraceEventType type,const char *name,double value);
+
+/**
+ * @brief pause or resume recording
+ * @param enable false to ignore events until enabled again
+ * @note a zone is recorded whole or not at all by whether tracing was enabled when it began, so a zone begun before a
+ * pause still records its end and one begun during a pause records nothing
+ */
+void gf3d_trace_set_enabled(Bool enable);
+
+/**
+ * @brief name the calling thread in the trace, otherwise it shows by id.  The thread that called init is "main"
+ * @param name a string that lives until the trace is written
+ */
+void gf3d_trace_set_thread_name(const char *name);
+
+/**
+ * @brief forget everything recorded so far, such as the loading before the part worth looking at
+ * @note no other thread may be recording while this runs
+ */
+void gf3d_trace_clear();
+
+/**
+ * @brief write everything recorded so far as Chrome trace event JSON
+ * @note zones still open are left open in the file, viewers close them at the end of the trace
+ * @param filename the file to write
+ * @return false if the file could not be written
+ */
+Bool gf3d_trace_write(const char *filename);
+
+/**
+ * @brief get how many events were dropped because a thread's buffer was full
+ * @return the count since init
+ */
+Uint32 gf3d_trace_get_dropped();
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __GF3D_TRANSFORM_H__
+#define __GF3D_TRANSFORM_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_matrix.h"
+#include "gf3d_quaternion.h"
+
+/**
+ * @purpose transform hierarchy
+ * every node has a local translation, rotation and scale relative to its parent.  Nodes are kept in flat arrays sorted
+ * so that a parent always comes before its children, which lets gf3d_transform_update compute every world matrix in
+ * one front to back pass.  Changing a node only flags it: the pass starts at the first flagged node, and a node's
+ * world matrix is only rebuilt if it or one of its ancestors changed
+ */
+
+/**
+ * @brief initialize the transform hierarchy.  Will clean itself up at exit
+ * @param maxNodes how many nodes can exist at once
+ */
+void gf3d_transform_init(Uint32 maxNodes);
+
+/**
+ * @brief make a node with an identity local transform
+ * @param parent the node to attach it to, -1 for a root
+ * @return -1 on error, the node id otherwise
+ */
+Sint32 gf3d_transform_new(Sint32 parent);
+
+/**
+ * @brief free a node and every node below it
+ * @param node the node to free
+ */
+void gf3d_transform_free(Sint32 node);
+
+/**
+ * @brief move a node, and every node below it, under another parent.  The local transform is kept as is
+ * @param node the node to move
+ * @param parent the new parent, -1 to make it a root.  Cannot be the node or one of its descendants
+ * @return false on error (see logs)
+ */
+Bool gf3d_transform_set_parent(Sint32 node,Sint32 parent);
+
+/**
+ * @brief get the parent of a node
+ * @return -1 for a root or on error
+ */
+Sint32 gf3d_transform_get_parent(Sint32 node);
+
+/**
+ * @brief set the local translation of a node
+ */
+void gf3d_transform_set_position(Sint32 node,Vector3D position);
+
+/**
+ * @brief set the local rotation of a node
+ * @param rotation a unit quaternion
+ */
+void gf3d_transform_set_rotation(Sint32 node,Quaternion rotation);
+
+/**
+ * @brief set the local scale of a node
+ */
+void gf3d_transform_set_scale(Sint32 node,Vector3D scale);
+
+/**
+ * @brief set the whole local transform of a node
+ */
+void gf3d_transform_set_local(Sint32 node,Vector3D position,Quaternion rotation,Vector3D scale);
+
+/**
+ * @brief get the local transform of a node
+ * @param position if not NULL, the local translation is written here
+ * @param rotation if not NULL, the local rotation is written here
+ * @param scale if not NULL, the local scale is written here
+ * @return false if the node does not exist
+ */
+Bool gf3d_transform_get_local(Sint32 node,Vector3D *position,Quaternion *rotation,Vector3D *scale);
+
+/**
+ * @brief rebuild the world matrices of every changed node and of everything below them
+ * @note call once a frame, after the game has moved things and before anything reads world matrices
+ * @return how many world matrices were rebuilt
+ */
+Uint32 gf3d_transform_update();
+
+/**
+ * @brief get the world matrix of a node as of the last gf3d_transform_update
+ * @param out the world matrix, local * parent world
+ * @param node the node
+ * @return false if the node does not exist
+ */
+Bool gf3d_transform_get_world(Matrix4 out,Sint32 node);
+
+/**
+ * @brief check if the last gf3d_transform_update rebuilt a node's world matrix
+ * @note lets systems that cache world space data, such as culling bounds, only refresh what moved
+ */
+Bool gf3d_transform_world_changed(Sint32 node);
+
+/**
+ * @brief get how many nodes exist
+ */
+Uint32 gf3d_transform_count();
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef __GF3D_UNIFORMS_H__
+#define __GF3D_UNIFORMS_H__
+
+#include <vulkan/vulkan.h>
+#include "gf3d_types.h"
+#include "gf3d_matrix.h"
+
+/**
+ * @purpose per frame camera and object transform uniforms
+ * set 0, binding 0 holds the camera block, binding 1 holds one model matrix per object through a dynamic offset
+ * data is only written into a frame's copy when the camera or the object has changed since that copy was written
+ */
+
+typedef struct
+{
+    Matrix4 view;
+    Matrix4 proj;
+    Matrix4 viewProj;
+}CameraUniform;
+
+typedef struct
+{
+    Uint32  cameraUploads;      /**<camera blocks written into a frame copy*/
+    Uint32  objectUploads;      /**<model matrices written into a frame copy*/
+}UniformStats;
+
+/**
+ * @brief initialize the uniform system.  Will clean itself up at exit
+ * @note needs gf3d_buffers, gf3d_descriptors and gf3d_camera to be initialized first
+ * @param device the logical device
+ * @param frameCount how many frames can be in flight, each gets its own copy of the uniforms
+ * @param maxObjects how many objects can have transforms at once
+ */
+void gf3d_uniforms_init(VkDevice device,Uint32 frameCount,Uint32 maxObjects);
+
+/**
+ * @brief get the descriptor set layout that pipelines need to include as set 0
+ * @return VK_NULL_HANDLE if not initialized
+ */
+VkDescriptorSetLayout gf3d_uniforms_get_layout();
+
+/**
+ * @brief set the projection of the active camera
+ * @note same as gf3d_camera_object_set_projection on gf3d_camera_get_active
+ * @param proj the projection matrix, such as one built with gf3d_matrix_perspective
+ */
+void gf3d_uniforms_set_projection(Matrix4 proj);
+
+/**
+ * @brief get the camera data that the next update will upload, refreshed from the active gf3d_camera
+ * @param camera output, the view, projection and combined matrices are copied here
+ */
+void gf3d_uniforms_get_camera(CameraUniform *camera);
+
+/**
+ * @brief reserve a transform slot for an object
+ * @return -1 if there are no free slots, the slot index otherwise.  The slot starts as identity
+ */
+Sint32 gf3d_uniforms_object_new();
+
+/**
+ * @brief release a transform slot
+ * @param object the slot to release
+ */
+void gf3d_uniforms_object_free(Sint32 object);
+
+/**
+ * @brief set the model matrix of an object, marking it for upload
+ * @param object the slot to update
+ * @param model the new model matrix
+ */
+void gf3d_uniforms_object_set_model(Sint32 object,Matrix4 model);
+
+/**
+ * @brief write anything that changed into the given frame's copy of the uniforms
+ * @note call once the GPU is done with the frame, before recording or submitting it
+ * @param frame the frame index
+ */
+void gf3d_uniforms_update(Uint32 frame);
+
+/**
+ * @brief bind the uniform descriptor set for drawing an object
+ * @param commandBuffer the command buffer being recorded
+ * @param pipelineLayout the layout of the bound pipeline, it must use gf3d_uniforms_get_layout for set 0
+ * @param frame the frame the command buffer will be submitted for
+ * @param object the object slot whose model matrix should be visible
+ */
+void gf3d_uniforms_bind(VkCommandBuffer commandBuffer,VkPipelineLayout pipelineLayout,Uint32 frame,Sint32 object);
+
+/**
+ * @brief get the uniform descriptor set of a frame, to bind it for many draws without looking it up each time
+ * @param frame the frame the command buffer will be submitted for
+ * @return VK_NULL_HANDLE if uniforms are not initialized or the frame is out of range
+ */
+VkDescriptorSet gf3d_uniforms_get_set(Uint32 frame);
+
+/**
+ * @brief bind a set from gf3d_uniforms_get_set for drawing an object
+ * @param commandBuffer the command buffer being recorded
+ * @param pipelineLayout the layout of the bound pipeline, it must use gf3d_uniforms_get_layout for set 0
+ * @param set the set of the frame the command buffer will be submitted for, nothing is bound if VK_NULL_HANDLE
+ * @param object the object slot whose model matrix should be visible
+ */
+void gf3d_uniforms_bind_set(VkCommandBuffer commandBuffer,VkPipelineLayout pipelineLayout,VkDescriptorSet set,Sint32 object);
+
+/**
+ * @brief get the uniform upload counters
+ * @param stats output, the counters are copied here
+ */
+void gf3d_uniforms_get_stats(UniformStats *stats);
+
+#endif
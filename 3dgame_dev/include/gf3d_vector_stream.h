@@ -0,0 +1,117 @@
+#ifndef __GF3D_VECTOR_STREAM_H__
+#define __GF3D_VECTOR_STREAM_H__
+
+#include "gf3d_types.h"
+#include "gf3d_vector.h"
+#include "gf3d_matrix.h"
+
+/**
+ * @purpose float only vector math over many vectors at once
+ * a stream keeps its components in separate arrays (x[], y[], z[]) so every operation runs 4 (SSE) or 8 (AVX) vectors
+ * at a time with no shuffling.  Meant for particle, physics and culling loops that do the same thing to every element
+ * every operation takes a count and works on the first count vectors of its streams.  Outputs may be the same stream
+ * as an input, but not a slice of it starting somewhere else
+ * the kernels are picked like the gf3d_matrix ones: the fastest one the CPU supports the first time one runs
+ */
+
+typedef struct
+{
+    float  *x;
+    float  *y;
+    float  *z;
+}VectorStream3D;
+
+/**
+ * @brief allocate the arrays of a stream, zeroed
+ * @param stream the stream to set up
+ * @param count how many vectors it holds
+ * @return false on error (see logs)
+ */
+Bool gf3d_vector_stream3d_new(VectorStream3D *stream,Uint32 count);
+
+/**
+ * @brief free the arrays of a stream made by gf3d_vector_stream3d_new
+ * @param stream the stream to free, its pointers are cleared
+ */
+void gf3d_vector_stream3d_free(VectorStream3D *stream);
+
+/**
+ * @brief get a stream starting part way into another one, sharing its arrays
+ * @param stream the whole stream
+ * @param first the index that becomes the slice's first vector
+ * @return the slice
+ */
+VectorStream3D gf3d_vector_stream3d_slice(VectorStream3D stream,Uint32 first);
+
+/**
+ * @brief copy vectors into a stream
+ * @param stream where the vectors are written
+ * @param vectors count vectors
+ * @param count how many to copy
+ */
+void gf3d_vector_stream3d_load(VectorStream3D stream,const Vector3D *vectors,Uint32 count);
+
+/**
+ * @brief copy vectors out of a stream
+ * @param vectors where count vectors are written
+ * @param stream the stream to read
+ * @param count how many to copy
+ */
+void gf3d_vector_stream3d_store(Vector3D *vectors,VectorStream3D stream,Uint32 count);
+
+/**
+ * @brief out = a + b
+ */
+void gf3d_vector_stream3d_add(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count);
+
+/**
+ * @brief out = a - b
+ */
+void gf3d_vector_stream3d_sub(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count);
+
+/**
+ * @brief out = a * scale
+ */
+void gf3d_vector_stream3d_scale(VectorStream3D out,VectorStream3D a,float scale,Uint32 count);
+
+/**
+ * @brief out = a + b * scale, such as position + velocity * time
+ */
+void gf3d_vector_stream3d_scale_add(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 count);
+
+/**
+ * @brief out = a x b
+ */
+void gf3d_vector_stream3d_cross(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count);
+
+/**
+ * @brief the dot product of each pair of vectors
+ * @param out where count results are written
+ */
+void gf3d_vector_stream3d_dot(float *out,VectorStream3D a,VectorStream3D b,Uint32 count);
+
+/**
+ * @brief the length of each vector
+ * @param out where count results are written
+ */
+void gf3d_vector_stream3d_length(float *out,VectorStream3D a,Uint32 count);
+
+/**
+ * @brief scale each vector to a length of 1
+ * @note zero length vectors stay zero, like vector3d_normalize leaves them
+ */
+void gf3d_vector_stream3d_normalize(VectorStream3D out,VectorStream3D a,Uint32 count);
+
+/**
+ * @brief force which kernels the stream operations use
+ * @param simd the kernels to use, falls back to the best one the CPU supports if it does not support these
+ * @return the kernels now in use
+ */
+MatrixSimd gf3d_vector_stream_simd_set(MatrixSimd simd);
+
+/**
+ * @brief get which kernels the stream operations use
+ */
+MatrixSimd gf3d_vector_stream_simd_get();
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef __SIMPLE_LOGGER__
+#define __SIMPLE_LOGGER__
+
+/**
+ * @purpose simple logger
+ * messages are formatted on the calling thread and handed to a background thread through a lock free queue, so
+ * logging costs a format and a copy, not the I/O.  The background thread writes every message to stdout and to the
+ * log file, in the order they were queued.  If the queue is full the message is dropped and counted, and the count is
+ * written to the log once there is room.  Before init_logger and after exit cleanup, logging writes directly
+ *
+ * every message has a level and a category.  The category is SLOG_CATEGORY where the message is logged: define it
+ * before any include to give a module its own, otherwise it is "gf3d".  Each category logs at SLOG_INFO and up
+ * unless configured otherwise at run time, see slog_configure.  Levels below SLOG_MIN_LEVEL are compiled out
+ * completely, arguments included: it defaults to SLOG_INFO when NDEBUG is defined and SLOG_TRACE otherwise
+ */
+
+#define SLOG_TRACE  0       /**<step by step detail*/
+#define SLOG_DEBUG  1       /**<enumerations and choices made, useful when something goes wrong*/
+#define SLOG_INFO   2       /**<what a user would want to see, the default*/
+#define SLOG_WARN   3       /**<something is off, but it was handled*/
+#define SLOG_ERROR  4       /**<something failed*/
+#define SLOG_NONE   5       /**<as a filter level, log nothing*/
+
+#ifndef SLOG_MIN_LEVEL
+#ifdef NDEBUG
+#define SLOG_MIN_LEVEL SLOG_INFO
+#else
+#define SLOG_MIN_LEVEL SLOG_TRACE
+#endif
+#endif
+
+#ifndef SLOG_CATEGORY
+#define SLOG_CATEGORY "gf3d"
+#endif
+
+#define SLOG_CATEGORY_NAME 32   /**<longest category name*/
+
+typedef struct
+{
+    char            name[SLOG_CATEGORY_NAME];
+    volatile int    level;      /**<messages below this level are not logged*/
+    int             set;        /**<the level was configured for this category by name*/
+}SlogCategory;
+
+/**
+ * @brief initializes the simple logger and starts its background thread.  Will automatically cleanup at program exit.
+ * @note the SLOG_FILTER environment variable, if set, is passed to slog_configure
+ * @param log_file_path the file to append the log to, "output.log" if NULL
+ */
+void init_logger(const char *log_file_path);
+
+/**
+ * @brief log a message at a level, if the level is enabled for the category where it is logged
+ * @note the category is looked up once per call site, after that the check is a compare
+ * @param messageLevel SLOG_TRACE to SLOG_ERROR
+ * @param ... a string with tokens and the variables to be put into the tokens
+ */
+#define slog_at(messageLevel,...) do\
+{\
+    static SlogCategory *__slog_category = NULL;\
+    if (!__slog_category)__slog_category = slog_category_get(SLOG_CATEGORY);\
+    if ((messageLevel) >= __slog_category->level)_slog_level((messageLevel),__FILE__,__LINE__,__VA_ARGS__);\
+}while (0)
+
+#if SLOG_MIN_LEVEL <= SLOG_TRACE
+#define slog_trace(...) slog_at(SLOG_TRACE,__VA_ARGS__)
+#else
+#define slog_trace(...) do {} while (0)
+#endif
+
+#if SLOG_MIN_LEVEL <= SLOG_DEBUG
+#define slog_debug(...) slog_at(SLOG_DEBUG,__VA_ARGS__)
+#else
+#define slog_debug(...) do {} while (0)
+#endif
+
+#if SLOG_MIN_LEVEL <= SLOG_INFO
+#define slog_info(...) slog_at(SLOG_INFO,__VA_ARGS__)
+#else
+#define slog_info(...) do {} while (0)
+#endif
+
+#if SLOG_MIN_LEVEL <= SLOG_WARN
+#define slog_warn(...) slog_at(SLOG_WARN,__VA_ARGS__)
+#else
+#define slog_warn(...) do {} while (0)
+#endif
+
+#if SLOG_MIN_LEVEL <= SLOG_ERROR
+#define slog_error(...) slog_at(SLOG_ERROR,__VA_ARGS__)
+#else
+#define slog_error(...) do {} while (0)
+#endif
+
+/**
+ * @brief logs a message to stdout and to the configured log file, at SLOG_INFO
+ * @note messages longer than SLOG_MESSAGE_MAX are cut short
+ * @param msg a string with tokens
+ * @param ... variables to be put into the tokens.
+ */
+#define slog(...) slog_info(__VA_ARGS__)
+
+#define SLOG_MESSAGE_MAX 512    /**<longest message, file and line included*/
+
+/**
+ * @brief log a message unconditionally, use the macros instead
+ */
+void _slog(char *f,int l,char *msg,...);
+void _slog_level(int level,char *f,int l,char *msg,...);
+
+/**
+ * @brief find or add a category
+ * @param name the category name
+ * @return the category, never NULL: if there are too many categories a shared one is returned
+ */
+SlogCategory *slog_category_get(const char *name);
+
+/**
+ * @brief set the level a category logs at
+ * @param category the category name, NULL for the default: every category not configured by name, now or later
+ * @param level the lowest level to log, SLOG_NONE to log nothing
+ * @note a category configured by name keeps its level when the default changes, so "*=warn,swapchain=debug" and
+ * "swapchain=debug,*=warn" configure the same levels
+ */
+void slog_set_level(const char *category,int level);
+
+/**
+ * @brief get the level a category logs at
+ * @param category the category name, NULL for the default
+ * @return the lowest level it logs
+ */
+int slog_get_level(const char *category);
+
+/**
+ * @brief configure the levels from a filter string
+ * @param filter comma separated category=level entries, category * for every category, level one of trace, debug,
+ * info, warn, error or none.  Such as "*=warn,swapchain=debug"
+ * @return 0 if any entry could not be read, entries before it are still applied
+ */
+int slog_configure(const char *filter);
+
+/**
+ * @brief wait until every message logged before this call has been written and flushed to stdout and the log file
+ */
+void slog_sync();
+
+/**
+ * @brief get how many messages were dropped because the queue was full
+ * @return the count since init_logger
+ */
+unsigned int slog_get_dropped();
+
+/**
+ * @brief get how many messages were cut short to fit SLOG_MESSAGE_MAX
+ * @return the count since init_logger
+ */
+unsigned int slog_get_truncated();
+
+/**
+ * @brief get how much memory the logger holds, for memory reports
+ * @return the bytes in the message queue, 0 before init_logger
+ */
+unsigned int slog_get_memory_usage();
+
+#endif
@@ -1,12 +1,28 @@
-#version 300 es
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraUniform
+{
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} camera;
+
+layout(set = 0, binding = 1) uniform ObjectUniform
+{
+    mat4 model;
+} object;
 
 layout(location = 0) in vec3 vertexBuffer;
 
-uniform mat4 MVP;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+// the depth pre-pass and the EQUAL tested main pass must compute bit identical positions
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = MVP * vec4(vertexBuffer,1);
-//    gl_Position.xyz = vertexBuffer;
-//    gl_Position.w = 1.0;
-}
\ No newline at end of file
+    gl_Position = camera.viewProj * object.model * vec4(vertexBuffer,1);
+}
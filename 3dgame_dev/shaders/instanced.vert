@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraUniform
+{
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} camera;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexel;
+layout(location = 3) in mat4 instanceModel;    // locations 3 through 6, one per matrix row
+
+layout(location = 0) out vec3 fragColor;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+// the depth pre-pass and the EQUAL tested main pass must compute bit identical positions
+invariant gl_Position;
+
+void main()
+{
+    vec3 normal = normalize(mat3(instanceModel) * inNormal);
+    gl_Position = camera.viewProj * instanceModel * vec4(inPosition,1);
+    fragColor = vec3(0.5) + normal * 0.5;
+}
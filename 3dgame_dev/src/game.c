@@ -6,6 +6,10 @@
 #include "gf3d_model.h"
 #include "gf3d_matrix.h"
 #include "gf3d_camera.h"
+#include "gf3d_trace.h"
+#include "gf3d_memory.h"
+#include "gf3d_jobs.h"
+#include "gf3d_ecs.h"
 
 int main(int argc,char *argv[])
 {
@@ -13,7 +17,11 @@ int main(int argc,char *argv[])
     const Uint8 * keys;
     
     init_logger("gf3d.log");
+    gf3d_memory_init(1024 * 1024,256 * 1024);   // frame and scratch arenas, and tracking, before anything allocates
+    gf3d_trace_init(65536,"gf3d_trace.json");  // open in chrome://tracing or ui.perfetto.dev
+    gf3d_jobs_init(0);                          // one worker per core, the main thread helps while it waits
     slog("gf3d begin");
+    gf3d_pipeline_set_depth_prepass(0);     // enable for scenes with heavy overdraw
     gf3d_vgraphics_init(
         "gf3d",                 //program name
         1200,                   //screen width
@@ -22,6 +30,7 @@ int main(int argc,char *argv[])
         0,                      //fullscreen
         1                       //validation
     );
+    gf3d_ecs_init(65536);       // game entities, parallel queries run as jobs
     
     // main game loop
     while(!done)
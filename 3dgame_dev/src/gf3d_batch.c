@@ -0,0 +1,335 @@
+#include "gf3d_batch.h"
+
+#include <SDL.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_buffers.h"
+#include "gf3d_uniforms.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+typedef struct
+{
+    Mesh       *mesh;
+    Pipeline   *pipe;
+    Uint32      count;      /**<instances submitted this frame*/
+    Uint32      first;      /**<first instance of this group in the frame's region*/
+    Uint32      cursor;     /**<next instance to write while packing*/
+}BatchGroup;
+
+typedef struct
+{
+    Uint32                                  frameCount;
+    Uint32                                  maxInstances;
+    GpuBuffer                               instanceBuffer;     /**<frameCount regions of maxInstances model matrices*/
+    Matrix4                                *hostInstances;      /**<the same regions in host memory when there is no device*/
+    Matrix4                                *pending;            /**<model matrices in submission order*/
+    Uint32                                 *pendingGroup;       /**<group of each pending matrix*/
+    Uint32                                  pendingCount;
+    Uint32                                  maxGroups;
+    Uint32                                  groupCount;
+    BatchGroup                             *groupList;
+    Uint32                                 *drawOrder;          /**<group indices sorted by pipeline, then mesh*/
+    Sint32                                 *groupTable;         /**<open addressed, maps mesh and pipeline to a group*/
+    Uint32                                  tableSize;
+    Sint32                                  lastGroup;          /**<consecutive submissions usually share a group*/
+    VkVertexInputBindingDescription         bindings[2];
+    VkVertexInputAttributeDescription       attributes[GF3D_MESH_ATTRIBUTE_COUNT + 4];
+    VkPipelineVertexInputStateCreateInfo    vertexInput;
+    BatchStats                              stats;
+}BatchManager;
+
+static BatchManager gf3d_batch = {0};
+
+void gf3d_batch_close();
+void gf3d_batch_vertex_input_setup();
+
+void gf3d_batch_init(Uint32 frameCount,Uint32 maxInstances,Uint32 maxGroups)
+{
+    int i;
+    if ((!frameCount)||(!maxInstances)||(!maxGroups))
+    {
+        slog("cannot initialize batching with zero frames, instances or groups");
+        return;
+    }
+    if (!gf3d_buffers_get_limits())
+    {
+        // headless, for profiling: instances are packed the same way but nothing can be drawn
+        gf3d_batch.hostInstances = (Matrix4 *)gf3d_memory_allocate(MT_Render,sizeof(Matrix4),maxInstances * frameCount);
+        if (!gf3d_batch.hostInstances)
+        {
+            slog("failed to allocate host instances");
+            return;
+        }
+        slog("no device, batching into host memory");
+    }
+    else if (!gf3d_buffer_create(
+        &gf3d_batch.instanceBuffer,
+        MT_Render,
+        sizeof(Matrix4) * maxInstances * frameCount,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        slog("failed to create instance buffer");
+        return;
+    }
+    gf3d_batch.frameCount = frameCount;
+    gf3d_batch.maxInstances = maxInstances;
+    gf3d_batch.maxGroups = maxGroups;
+    gf3d_batch.tableSize = 1;
+    while (gf3d_batch.tableSize < maxGroups * 2)gf3d_batch.tableSize <<= 1;
+
+    gf3d_batch.pending = (Matrix4 *)gf3d_memory_allocate(MT_Render,sizeof(Matrix4),maxInstances);
+    gf3d_batch.pendingGroup = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxInstances);
+    gf3d_batch.groupList = (BatchGroup *)gf3d_memory_allocate(MT_Render,sizeof(BatchGroup),maxGroups);
+    gf3d_batch.drawOrder = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxGroups);
+    gf3d_batch.groupTable = (Sint32 *)gf3d_memory_allocate(MT_Render,sizeof(Sint32),gf3d_batch.tableSize);
+    if ((!gf3d_batch.pending)||(!gf3d_batch.pendingGroup)||(!gf3d_batch.groupList)||(!gf3d_batch.drawOrder)||(!gf3d_batch.groupTable))
+    {
+        slog("failed to allocate batch manager");
+        gf3d_batch_close();
+        return;
+    }
+    for (i = 0; i < gf3d_batch.tableSize; i++)
+    {
+        gf3d_batch.groupTable[i] = -1;
+    }
+    gf3d_batch.lastGroup = -1;
+    gf3d_batch_vertex_input_setup();
+    slog("batching initialized for %i instances per frame",maxInstances);
+    atexit(gf3d_batch_close);
+}
+
+void gf3d_batch_close()
+{
+    gf3d_buffer_free(&gf3d_batch.instanceBuffer);
+    if (gf3d_batch.hostInstances)gf3d_memory_free(gf3d_batch.hostInstances);
+    if (gf3d_batch.pending)gf3d_memory_free(gf3d_batch.pending);
+    if (gf3d_batch.pendingGroup)gf3d_memory_free(gf3d_batch.pendingGroup);
+    if (gf3d_batch.groupList)gf3d_memory_free(gf3d_batch.groupList);
+    if (gf3d_batch.drawOrder)gf3d_memory_free(gf3d_batch.drawOrder);
+    if (gf3d_batch.groupTable)gf3d_memory_free(gf3d_batch.groupTable);
+    memset(&gf3d_batch,0,sizeof(BatchManager));
+}
+
+void gf3d_batch_vertex_input_setup()
+{
+    int i;
+    VkVertexInputAttributeDescription *row;
+
+    gf3d_batch.bindings[0] = gf3d_mesh_get_binding_description(0);
+    gf3d_batch.bindings[1].binding = GF3D_BATCH_INSTANCE_BINDING;
+    gf3d_batch.bindings[1].stride = sizeof(Matrix4);
+    gf3d_batch.bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    gf3d_mesh_get_attribute_descriptions(0,gf3d_batch.attributes);
+    // a mat4 attribute takes four consecutive locations, one per row
+    for (i = 0; i < 4; i++)
+    {
+        row = &gf3d_batch.attributes[GF3D_MESH_ATTRIBUTE_COUNT + i];
+        row->location = GF3D_BATCH_INSTANCE_LOCATION + i;
+        row->binding = GF3D_BATCH_INSTANCE_BINDING;
+        row->format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        row->offset = sizeof(float) * 4 * i;
+    }
+
+    gf3d_batch.vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    gf3d_batch.vertexInput.vertexBindingDescriptionCount = 2;
+    gf3d_batch.vertexInput.pVertexBindingDescriptions = gf3d_batch.bindings;
+    gf3d_batch.vertexInput.vertexAttributeDescriptionCount = GF3D_MESH_ATTRIBUTE_COUNT + 4;
+    gf3d_batch.vertexInput.pVertexAttributeDescriptions = gf3d_batch.attributes;
+}
+
+const VkPipelineVertexInputStateCreateInfo *gf3d_batch_get_vertex_input()
+{
+    if (!gf3d_batch.frameCount)return NULL;
+    return &gf3d_batch.vertexInput;
+}
+
+/**
+ * GROUPS
+ */
+
+Uint32 gf3d_batch_hash(Mesh *mesh,Pipeline *pipe)
+{
+    size_t key;
+    key = ((size_t)mesh * 2654435761u) ^ ((size_t)pipe * 40503u);
+    key ^= key >> 15;
+    return (Uint32)key;
+}
+
+int gf3d_batch_group_compare(const void *a,const void *b)
+{
+    const BatchGroup *ga = &gf3d_batch.groupList[*(const Uint32 *)a];
+    const BatchGroup *gb = &gf3d_batch.groupList[*(const Uint32 *)b];
+    if (ga->pipe != gb->pipe)return (ga->pipe < gb->pipe)?-1:1;
+    if (ga->mesh != gb->mesh)return (ga->mesh < gb->mesh)?-1:1;
+    return 0;
+}
+
+Sint32 gf3d_batch_group_get(Mesh *mesh,Pipeline *pipe)
+{
+    Uint32 slot;
+    Sint32 index;
+    BatchGroup *group;
+
+    slot = gf3d_batch_hash(mesh,pipe) & (gf3d_batch.tableSize - 1);
+    while ((index = gf3d_batch.groupTable[slot]) >= 0)
+    {
+        group = &gf3d_batch.groupList[index];
+        if ((group->mesh == mesh)&&(group->pipe == pipe))return index;
+        slot = (slot + 1) & (gf3d_batch.tableSize - 1);
+    }
+    if (gf3d_batch.groupCount >= gf3d_batch.maxGroups)
+    {
+        return -1;
+    }
+    index = gf3d_batch.groupCount++;
+    gf3d_batch.groupList[index].mesh = mesh;
+    gf3d_batch.groupList[index].pipe = pipe;
+    gf3d_batch.groupTable[slot] = index;
+    // groups persist between frames, so the draw order only changes when one is added
+    gf3d_batch.drawOrder[index] = index;
+    qsort(gf3d_batch.drawOrder,gf3d_batch.groupCount,sizeof(Uint32),gf3d_batch_group_compare);
+    return index;
+}
+
+/**
+ * SUBMISSION
+ */
+
+void gf3d_batch_begin()
+{
+    int i;
+    for (i = 0; i < gf3d_batch.groupCount; i++)
+    {
+        gf3d_batch.groupList[i].count = 0;
+    }
+    gf3d_batch.pendingCount = 0;
+    gf3d_batch.stats.submitted = 0;
+    gf3d_batch.stats.dropped = 0;
+}
+
+void gf3d_batch_submit(Mesh *mesh,Pipeline *pipe,Matrix4 model)
+{
+    Sint32 index;
+    BatchGroup *group;
+
+    if ((!mesh)||(!pipe)||(!model))return;
+    if (gf3d_batch.pendingCount >= gf3d_batch.maxInstances)
+    {
+        gf3d_batch.stats.dropped++;
+        return;
+    }
+    index = gf3d_batch.lastGroup;
+    if ((index < 0)||(gf3d_batch.groupList[index].mesh != mesh)||(gf3d_batch.groupList[index].pipe != pipe))
+    {
+        index = gf3d_batch_group_get(mesh,pipe);
+        if (index < 0)
+        {
+            gf3d_batch.stats.dropped++;
+            return;
+        }
+        gf3d_batch.lastGroup = index;
+    }
+    group = &gf3d_batch.groupList[index];
+    group->count++;
+    memcpy(gf3d_batch.pending[gf3d_batch.pendingCount],model,sizeof(Matrix4));
+    gf3d_batch.pendingGroup[gf3d_batch.pendingCount] = index;
+    gf3d_batch.pendingCount++;
+    gf3d_batch.stats.submitted++;
+}
+
+void gf3d_batch_end(Uint32 frame)
+{
+    int i;
+    Uint32 first = 0;
+    Uint64 start;
+    BatchGroup *group;
+    Matrix4 *region;
+
+    if (frame >= gf3d_batch.frameCount)return;
+    start = SDL_GetPerformanceCounter();
+    if (gf3d_batch.hostInstances)region = gf3d_batch.hostInstances + (frame * gf3d_batch.maxInstances);
+    else region = (Matrix4 *)gf3d_batch.instanceBuffer.mapped + (frame * gf3d_batch.maxInstances);
+
+    // counting sort: ranges are laid out in draw order, then every pending matrix is copied once into its range
+    gf3d_batch.stats.groups = 0;
+    for (i = 0; i < gf3d_batch.groupCount; i++)
+    {
+        group = &gf3d_batch.groupList[gf3d_batch.drawOrder[i]];
+        group->first = group->cursor = first;
+        first += group->count;
+        if (group->count)gf3d_batch.stats.groups++;
+    }
+    for (i = 0; i < gf3d_batch.pendingCount; i++)
+    {
+        group = &gf3d_batch.groupList[gf3d_batch.pendingGroup[i]];
+        memcpy(region[group->cursor++],gf3d_batch.pending[i],sizeof(Matrix4));
+    }
+    gf3d_batch.stats.buildMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void gf3d_batch_record(VkCommandBuffer commandBuffer,Uint32 frame,Bool depthOnly)
+{
+    int i;
+    Uint64 start;
+    BatchGroup *group;
+    Pipeline *bound = NULL;
+    VkBuffer buffers[2];
+    VkDeviceSize offsets[2] = {0};
+
+    if (!depthOnly)
+    {
+        gf3d_batch.stats.drawCalls = 0;
+        gf3d_batch.stats.pipelineBinds = 0;
+    }
+    if (frame >= gf3d_batch.frameCount)return;
+    start = SDL_GetPerformanceCounter();
+    buffers[1] = gf3d_batch.instanceBuffer.buffer;
+    offsets[1] = sizeof(Matrix4) * gf3d_batch.maxInstances * frame;
+    for (i = 0; i < gf3d_batch.groupCount; i++)
+    {
+        group = &gf3d_batch.groupList[gf3d_batch.drawOrder[i]];
+        if (!group->count)continue;
+        if ((depthOnly)&&(!group->pipe->depthPipeline))continue;
+        if (group->pipe != bound)
+        {
+            bound = group->pipe;
+            if (commandBuffer)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly?bound->depthPipeline:bound->graphicsPipeline);
+                gf3d_uniforms_bind(commandBuffer, bound->pipelineLayout, frame, 0);
+            }
+            if (!depthOnly)gf3d_batch.stats.pipelineBinds++;
+        }
+        if (commandBuffer)
+        {
+            buffers[0] = group->mesh->vertexBuffer.buffer;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, group->mesh->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexed(commandBuffer, group->mesh->indexCount, group->count, 0, 0, group->first);
+        }
+        if (!depthOnly)gf3d_batch.stats.drawCalls++;
+    }
+    if (!depthOnly)gf3d_batch.stats.recordMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void gf3d_batch_draw(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_batch_record(commandBuffer,frame,false);
+}
+
+void gf3d_batch_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_batch_record(commandBuffer,frame,true);
+}
+
+void gf3d_batch_get_stats(BatchStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_batch.stats,sizeof(BatchStats));
+}
+
+/*eol@eof*/
@@ -0,0 +1,150 @@
+#include "gf3d_buffers.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "simple_logger.h"
+
+typedef struct
+{
+    VkPhysicalDevice                    gpu;
+    VkDevice                            device;
+    VkPhysicalDeviceProperties          properties;
+    VkPhysicalDeviceMemoryProperties    memoryProperties;
+    Bool                                initialized;
+}BufferManager;
+
+static BufferManager gf3d_buffers = {0};
+
+void gf3d_buffers_close();
+
+void gf3d_buffers_init(VkPhysicalDevice gpu,VkDevice device)
+{
+    gf3d_buffers.gpu = gpu;
+    gf3d_buffers.device = device;
+    vkGetPhysicalDeviceProperties(gpu, &gf3d_buffers.properties);
+    vkGetPhysicalDeviceMemoryProperties(gpu, &gf3d_buffers.memoryProperties);
+    gf3d_buffers.initialized = true;
+    slog("device has %i memory types",gf3d_buffers.memoryProperties.memoryTypeCount);
+    atexit(gf3d_buffers_close);
+}
+
+void gf3d_buffers_close()
+{
+    memset(&gf3d_buffers,0,sizeof(BufferManager));
+}
+
+const VkPhysicalDeviceLimits *gf3d_buffers_get_limits()
+{
+    if (!gf3d_buffers.initialized)return NULL;
+    return &gf3d_buffers.properties.limits;
+}
+
+Sint32 gf3d_buffers_find_memory_type(Uint32 typeFilter,VkMemoryPropertyFlags properties)
+{
+    Uint32 i;
+    for (i = 0; i < gf3d_buffers.memoryProperties.memoryTypeCount; i++)
+    {
+        if (!(typeFilter & (1 << i)))continue;
+        if ((gf3d_buffers.memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+    slog("no memory type matches filter %i with properties %i",typeFilter,properties);
+    return -1;
+}
+
+VkDeviceSize gf3d_buffers_align(VkDeviceSize size,VkDeviceSize alignment)
+{
+    if (!alignment)return size;
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+Bool gf3d_buffer_create(GpuBuffer *out,MemoryTag tag,VkDeviceSize size,VkBufferUsageFlags usage,VkMemoryPropertyFlags properties)
+{
+    Sint32 memoryType;
+    VkBufferCreateInfo bufferInfo = {0};
+    VkMemoryAllocateInfo allocInfo = {0};
+    VkMemoryRequirements memRequirements;
+
+    if (!out)return false;
+    memset(out,0,sizeof(GpuBuffer));
+    if (!gf3d_buffers.initialized)
+    {
+        slog("buffer system not initialized");
+        return false;
+    }
+    if (!size)
+    {
+        slog("cannot create a buffer of zero size");
+        return false;
+    }
+
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(gf3d_buffers.device, &bufferInfo, NULL, &out->buffer) != VK_SUCCESS)
+    {
+        slog("failed to create buffer of size %i",(int)size);
+        return false;
+    }
+
+    vkGetBufferMemoryRequirements(gf3d_buffers.device, out->buffer, &memRequirements);
+    memoryType = gf3d_buffers_find_memory_type(memRequirements.memoryTypeBits, properties);
+    if (memoryType < 0)
+    {
+        gf3d_buffer_free(out);
+        return false;
+    }
+
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(gf3d_buffers.device, &allocInfo, NULL, &out->memory) != VK_SUCCESS)
+    {
+        slog("failed to allocate buffer memory");
+        gf3d_buffer_free(out);
+        return false;
+    }
+    out->allocated = memRequirements.size;
+    out->tag = tag;
+    gf3d_memory_gpu_allocated(tag,out->allocated);
+    vkBindBufferMemory(gf3d_buffers.device, out->buffer, out->memory, 0);
+    out->size = size;
+
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(gf3d_buffers.device, out->memory, 0, size, 0, &out->mapped) != VK_SUCCESS)
+        {
+            slog("failed to map buffer memory");
+            gf3d_buffer_free(out);
+            return false;
+        }
+    }
+    return true;
+}
+
+void gf3d_buffer_free(GpuBuffer *buffer)
+{
+    if (!buffer)return;
+    if (buffer->mapped)
+    {
+        vkUnmapMemory(gf3d_buffers.device, buffer->memory);
+    }
+    if (buffer->buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(gf3d_buffers.device, buffer->buffer, NULL);
+    }
+    if (buffer->memory != VK_NULL_HANDLE)
+    {
+        vkFreeMemory(gf3d_buffers.device, buffer->memory, NULL);
+        gf3d_memory_gpu_freed(buffer->tag,buffer->allocated);
+    }
+    memset(buffer,0,sizeof(GpuBuffer));
+}
+
+/*eol@eof*/
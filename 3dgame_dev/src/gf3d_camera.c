@@ -1,19 +1,292 @@
-#include "gf3d_matrix.h"
+#include "gf3d_camera.h"
 
+#include <stdlib.h>
 #include <string.h>
 
-Matrix4 gf3d_camera = {0};
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+typedef enum
+{
+    CD_Inverse  = 1,    /**<inverseView is stale*/
+    CD_Combined = 2     /**<viewProj, inverseViewProj and frustum are stale*/
+}CameraDirty;
+
+typedef struct
+{
+    Bool            inUse;
+    Uint32          version;        /**<bumped on every change*/
+    Uint32          dirty;          /**<CameraDirty bits*/
+    Bool            rigid;          /**<the view is a rotation and a translation, so it has a cheap inverse*/
+    Vector3D        position;
+    float           fov;            /**<perspective parameters, fov is 0 for a projection set directly*/
+    float           aspect;
+    float           near;
+    float           far;
+    CameraMatrices  matrices;
+}Camera;
+
+typedef struct
+{
+    Uint32          maxCameras;
+    Camera         *cameras;
+    Sint32          active;
+    Uint32          version;        /**<bumped when the active camera changes or is modified*/
+}CameraManager;
+
+static CameraManager gf3d_camera = {0};
+
+void gf3d_camera_close();
+
+void gf3d_camera_init(Uint32 maxCameras)
+{
+    if (!maxCameras)
+    {
+        slog("cannot initialize the camera system for zero cameras");
+        return;
+    }
+    gf3d_camera.cameras = (Camera *)gf3d_memory_allocate(MT_Scene,sizeof(Camera),maxCameras);
+    if (!gf3d_camera.cameras)
+    {
+        slog("failed to allocate cameras");
+        return;
+    }
+    gf3d_camera.maxCameras = maxCameras;
+    gf3d_camera.active = gf3d_camera_object_new();
+    atexit(gf3d_camera_close);
+    slog("camera system initialized for %i cameras",maxCameras);
+}
+
+void gf3d_camera_close()
+{
+    if (gf3d_camera.cameras)gf3d_memory_free(gf3d_camera.cameras);
+    memset(&gf3d_camera,0,sizeof(CameraManager));
+}
+
+/**
+ * @brief get a live camera by id
+ * @return NULL if there is no such camera
+ */
+static inline Camera *gf3d_camera_get(Sint32 camera)
+{
+    if ((camera < 0)||(camera >= gf3d_camera.maxCameras))return NULL;
+    if (!gf3d_camera.cameras[camera].inUse)return NULL;
+    return &gf3d_camera.cameras[camera];
+}
+
+/**
+ * @brief flag what a change made stale and bump the versions
+ */
+static inline void gf3d_camera_changed(Sint32 camera,Uint32 dirty)
+{
+    Camera *cam = &gf3d_camera.cameras[camera];
+    cam->dirty |= dirty;
+    cam->version++;
+    if (camera == gf3d_camera.active)gf3d_camera.version++;
+}
+
+/**
+ * CAMERAS
+ */
+
+Sint32 gf3d_camera_object_new()
+{
+    int i;
+    Camera *cam;
+    for (i = 0; i < gf3d_camera.maxCameras; i++)
+    {
+        cam = &gf3d_camera.cameras[i];
+        if (cam->inUse)continue;
+        memset(cam,0,sizeof(Camera));
+        cam->inUse = true;
+        cam->rigid = true;
+        gf3d_matrix_identity(cam->matrices.view);
+        gf3d_camera_object_set_perspective(i,45 * GF3D_DEGTORAD,1,0.1,100);
+        return i;
+    }
+    slog("no free cameras");
+    return -1;
+}
+
+void gf3d_camera_object_free(Sint32 camera)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return;
+    if (camera == gf3d_camera.active)
+    {
+        slog("cannot free the active camera");
+        return;
+    }
+    cam->inUse = false;
+}
+
+void gf3d_camera_set_active(Sint32 camera)
+{
+    if (!gf3d_camera_get(camera))
+    {
+        slog("cannot make missing camera %i active",camera);
+        return;
+    }
+    if (camera == gf3d_camera.active)return;
+    gf3d_camera.active = camera;
+    gf3d_camera.version++;
+}
+
+Sint32 gf3d_camera_get_active()
+{
+    if (!gf3d_camera.cameras)return -1;
+    return gf3d_camera.active;
+}
+
+/**
+ * PROJECTION
+ */
+
+void gf3d_camera_object_set_perspective(Sint32 camera,float fov,float aspect,float near,float far)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return;
+    cam->fov = fov;
+    cam->aspect = aspect;
+    cam->near = near;
+    cam->far = far;
+    gf3d_matrix_perspective(cam->matrices.proj,fov,aspect,near,far);
+    cam->matrices.proj[1][1] *= -1;   // vulkan clip space has y pointing down
+    gf3d_camera_changed(camera,CD_Combined);
+}
+
+void gf3d_camera_object_set_aspect(Sint32 camera,float aspect)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return;
+    if (cam->fov == 0)
+    {
+        slog("camera %i does not have a perspective projection",camera);
+        return;
+    }
+    if (cam->aspect == aspect)return;
+    gf3d_camera_object_set_perspective(camera,cam->fov,aspect,cam->near,cam->far);
+}
+
+void gf3d_camera_object_set_projection(Sint32 camera,Matrix4 proj)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if ((!cam)||(!proj))return;
+    cam->fov = 0;
+    gf3d_matrix_copy(cam->matrices.proj,proj);
+    gf3d_camera_changed(camera,CD_Combined);
+}
+
+/**
+ * VIEW
+ */
+
+void gf3d_camera_object_look_at(Sint32 camera,Vector3D position,Vector3D target,Vector3D up)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return;
+    gf3d_matrix_view(cam->matrices.view,position,target,up);
+    cam->position = position;
+    cam->rigid = true;
+    gf3d_camera_changed(camera,CD_Inverse | CD_Combined);
+}
+
+void gf3d_camera_object_set_view(Sint32 camera,Matrix4 view)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if ((!cam)||(!view))return;
+    if (!gf3d_matrix_invert(cam->matrices.inverseView,view))
+    {
+        slog("camera %i cannot use a view matrix with no inverse",camera);
+        return;
+    }
+    gf3d_matrix_copy(cam->matrices.view,view);
+    // the inverse was needed anyway to know where the camera is
+    vector3d_set(cam->position,cam->matrices.inverseView[3][0],cam->matrices.inverseView[3][1],cam->matrices.inverseView[3][2]);
+    cam->rigid = false;
+    gf3d_camera_changed(camera,CD_Combined);
+}
+
+void gf3d_camera_object_set_position(Sint32 camera,Vector3D position)
+{
+    int j;
+    Camera *cam = gf3d_camera_get(camera);
+    float (*view)[4];
+    if (!cam)return;
+    view = cam->matrices.view;
+    // row vector convention: the translation lives in row 3, and is the position carried through the rotation, negated
+    for (j = 0; j < 3; j++)
+    {
+        view[3][j] = -(position.x * view[0][j] + position.y * view[1][j] + position.z * view[2][j]);
+    }
+    cam->position = position;
+    gf3d_camera_changed(camera,CD_Inverse | CD_Combined);
+}
+
+void gf3d_camera_object_move(Sint32 camera,Vector3D move)
+{
+    Vector3D position;
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return;
+    vector3d_add(position,cam->position,move);
+    gf3d_camera_object_set_position(camera,position);
+}
+
+Vector3D gf3d_camera_object_get_position(Sint32 camera)
+{
+    Vector3D origin = {0};
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return origin;
+    return cam->position;
+}
+
+/**
+ * CACHED MATRICES
+ */
+
+const CameraMatrices *gf3d_camera_object_get_matrices(Sint32 camera)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    CameraMatrices *m;
+    if (!cam)return NULL;
+    m = &cam->matrices;
+    if (cam->dirty & CD_Inverse)
+    {
+        if (cam->rigid)gf3d_matrix_invert_rigid(m->inverseView,m->view);
+        else gf3d_matrix_invert(m->inverseView,m->view);
+    }
+    if (cam->dirty & CD_Combined)
+    {
+        gf3d_matrix_multiply(m->viewProj,m->proj,m->view);
+        if (!gf3d_matrix_invert(m->inverseViewProj,m->viewProj))gf3d_matrix_identity(m->inverseViewProj);
+        gf3d_cull_frustum_from_matrix(&m->frustum,m->viewProj);
+    }
+    cam->dirty = 0;
+    return m;
+}
+
+Uint32 gf3d_camera_object_get_version(Sint32 camera)
+{
+    Camera *cam = gf3d_camera_get(camera);
+    if (!cam)return 0;
+    return cam->version;
+}
+
+/**
+ * ACTIVE CAMERA
+ */
 
 void gf3d_camera_get_view(Matrix4 *view)
 {
-    if (!view)return;
-    memcpy(view,gf3d_camera,sizeof(Matrix4));
+    Camera *cam = gf3d_camera_get(gf3d_camera.active);
+    if ((!view)||(!cam))return;
+    memcpy(view,cam->matrices.view,sizeof(Matrix4));
 }
 
 void gf3d_camera_set_view(Matrix4 *view)
 {
     if (!view)return;
-    memcpy(gf3d_camera,view,sizeof(Matrix4));
+    gf3d_camera_object_set_view(gf3d_camera.active,*view);
 }
 
 void gf3d_camera_look_at(
@@ -22,26 +295,22 @@ void gf3d_camera_look_at(
     Vector3D up
 )
 {
-    gf3d_matrix_view(
-        gf3d_camera,
-        position,
-        target,
-        up
-    );
+    gf3d_camera_object_look_at(gf3d_camera.active,position,target,up);
 }
 
 void gf3d_camera_set_position(Vector3D position)
 {
-    gf3d_camera[0][3] = position.x;
-    gf3d_camera[1][3] = position.y;
-    gf3d_camera[2][3] = position.z;
+    gf3d_camera_object_set_position(gf3d_camera.active,position);
 }
 
 void gf3d_camera_move(Vector3D move)
 {
-    gf3d_camera[0][3] += move.x;
-    gf3d_camera[1][3] += move.y;
-    gf3d_camera[2][3] += move.z;
+    gf3d_camera_object_move(gf3d_camera.active,move);
+}
+
+Uint32 gf3d_camera_get_version()
+{
+    return gf3d_camera.version;
 }
 
 /*eol@eof*/
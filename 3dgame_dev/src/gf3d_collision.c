@@ -0,0 +1,1860 @@
+#define SLOG_CATEGORY "collision"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "gf3d_collision.h"
+#include "gf3d_jobs.h"
+#include "gf3d_memory.h"
+#include "gf3d_trace.h"
+#include "simple_logger.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GF3D_COLLISION_SSE
+#include <emmintrin.h>
+#endif
+
+#define GF3D_COLLISION_GJK_ITERATIONS   32
+#define GF3D_COLLISION_GJK_TOLERANCE    1e-5f   // GJK stops when a step gets this little closer, relative
+#define GF3D_COLLISION_EPA_ITERATIONS   48
+#define GF3D_COLLISION_EPA_TOLERANCE    1e-4f   // EPA stops when a step pushes the polytope out less than this
+#define GF3D_COLLISION_EPA_VERTICES     (GF3D_COLLISION_EPA_ITERATIONS + 4)
+#define GF3D_COLLISION_EPA_FACES        256
+#define GF3D_COLLISION_EPA_EDGES        128
+#define GF3D_COLLISION_CORE_EPSILON     1e-4f   // cores closer than this count as overlapping
+#define GF3D_COLLISION_SWEEP_BATCH      1024    // sorted boxes per sweep job
+#define GF3D_COLLISION_BOUNDS_BATCH     4096    // bodies per bounds and gather job
+#define GF3D_COLLISION_BANDS_MAX        32      // slices along z the sweep can be split into
+#define GF3D_COLLISION_BAND_BODIES      2048    // bodies it takes to be worth another slice
+#define GF3D_COLLISION_BAND_DEPTH       4       // a slice is at least this many times as deep as the average box
+#define GF3D_COLLISION_PAIR_BATCH       128     // pairs per narrowphase job
+#define GF3D_COLLISION_FULL_SORT        16      // more than one body in this many new and the list is sorted afresh
+#define GF3D_COLLISION_PAIRS_DEFAULT    4096    // pairs the cache and each sweep buffer start with
+#define GF3D_COLLISION_PADDING          4       // sentinels after the sorted boxes, so the sweep can read 4 past the end
+
+typedef enum
+{
+    BS_Free = 0,
+    BS_Alive,
+    BS_Removed      /**<removed, its id comes back after the next update*/
+}CollisionBodyState;
+
+typedef struct
+{
+    const CollisionShape   *shape;
+    Vector3D                position;
+    float                   m[9];       /**<rotation, row major, world = m * local*/
+    float                   radius;     /**<what the shape adds around its core*/
+}CollisionPose;
+
+typedef struct
+{
+    Vector3D    min;
+    Vector3D    max;
+}CollisionBounds;
+
+typedef struct
+{
+    float       minX;
+    Uint32      body;
+}CollisionSortEntry;
+
+typedef struct
+{
+    float       minZ;
+    float       maxZ;
+    double      depth;          /**<the z extents of the boxes added up*/
+}CollisionBoundsRange;
+
+typedef struct
+{
+    Uint64     *keys;           /**<lower body id in the high 32 bits*/
+    Uint32      count;
+    Uint32      max;
+}CollisionPairBuffer;
+
+typedef struct
+{
+    Uint64      key;            /**<as the sweep makes them*/
+    Sint32      index;          /**<into the pairs, -1 for an empty slot*/
+}CollisionPairSlot;
+
+typedef struct
+{
+    Uint32              bodyA;
+    Uint32              bodyB;
+    Uint32              frame;          /**<the last update that found the boxes overlapping*/
+    Bool                touching;
+    Bool                wasTouching;
+    Vector3D            direction;      /**<where GJK starts next time, the last closest point of A - B*/
+    CollisionContact    contact;
+}CollisionPairEntry;
+
+typedef struct
+{
+    Vector3D    w[4];           /**<points of A - B*/
+    Vector3D    a[4];           /**<the points of A and B they came from*/
+    Vector3D    b[4];
+    float       lambda[4];      /**<weights of the closest point to the origin*/
+    int         count;
+}CollisionSimplex;
+
+typedef struct
+{
+    int         a,b,c;
+    Vector3D    normal;
+    float       distance;       /**<from the origin to the face's plane*/
+    Bool        alive;
+}CollisionEpaFace;
+
+typedef struct
+{
+    Bool                    initialized;
+    Uint32                  maxBodies;
+    Uint32                  bodyCount;
+    CollisionPose          *poses;
+    CollisionBounds        *bounds;
+    void                  **data;
+    Uint8                  *state;
+    Uint8                  *isStatic;
+    Uint32                 *freeIds;
+    Uint32                  freeCount;
+    Uint32                 *removedIds;
+    Uint32                  removedCount;
+    CollisionSortEntry     *sorted;         /**<every body, in order of its lowest x*/
+    Uint32                  sortedCount;
+    Uint32                  added;          /**<bodies appended to the sorted list since the last update*/
+    CollisionBoundsRange    ranges[GF3D_JOBS_MAX_THREADS];     /**<z extent of every box, gathered per thread*/
+    Uint32                  bandCount;      /**<slices along z this update's sweep is split into*/
+    float                   bandMin;        /**<where the first slice starts*/
+    float                   bandScale;      /**<slices per unit of z*/
+    Uint32                 *bandStarts;     /**<where each gather chunk writes into each slice*/
+    float                  *sMinX;          /**<the boxes slice by slice, each in sorted order and followed by sentinels*/
+    float                  *sMaxX;
+    float                  *sMinY;
+    float                  *sMaxY;
+    float                  *sMinZ;
+    float                  *sMaxZ;
+    Uint32                 *sBody;
+    Uint8                  *sStatic;
+    Uint8                  *sBand;          /**<the slice each box was copied into*/
+    Uint32                  slotCount;
+    Uint32                  slotMax;
+    CollisionPairBuffer     buffers[GF3D_JOBS_MAX_THREADS];
+    CollisionPairEntry     *pairs;          /**<dense, tableSize / 2 of them*/
+    Uint32                  pairCount;
+    CollisionPairSlot      *table;          /**<open addressing from body pair to pair index*/
+    Uint32                  tableSize;
+    Uint32                  frame;
+    CollisionContact       *contacts;
+    Uint32                  contactCount;
+    Uint32                  contactMax;
+    CollisionPair          *ended;
+    Uint32                  endedCount;
+    Uint32                  endedMax;
+    SDL_atomic_t            epaRuns;
+    CollisionStats          stats;
+}CollisionManager;
+
+static CollisionManager gf3d_collision = {0};
+
+void gf3d_collision_close();
+
+/**
+ * VECTORS
+ */
+
+static Vector3D gf3d_collision_cross(Vector3D a,Vector3D b)
+{
+    Vector3D out;
+    out.x = a.y * b.z - a.z * b.y;
+    out.y = a.z * b.x - a.x * b.z;
+    out.z = a.x * b.y - a.y * b.x;
+    return out;
+}
+
+/**
+ * @brief turn a direction from world space into a pose's local space
+ */
+static Vector3D gf3d_collision_to_local(const CollisionPose *pose,Vector3D d)
+{
+    Vector3D out;
+    out.x = pose->m[0] * d.x + pose->m[3] * d.y + pose->m[6] * d.z;
+    out.y = pose->m[1] * d.x + pose->m[4] * d.y + pose->m[7] * d.z;
+    out.z = pose->m[2] * d.x + pose->m[5] * d.y + pose->m[8] * d.z;
+    return out;
+}
+
+/**
+ * @brief turn a point from a pose's local space into world space
+ */
+static Vector3D gf3d_collision_to_world(const CollisionPose *pose,Vector3D p)
+{
+    Vector3D out;
+    out.x = pose->position.x + pose->m[0] * p.x + pose->m[1] * p.y + pose->m[2] * p.z;
+    out.y = pose->position.y + pose->m[3] * p.x + pose->m[4] * p.y + pose->m[5] * p.z;
+    out.z = pose->position.z + pose->m[6] * p.x + pose->m[7] * p.y + pose->m[8] * p.z;
+    return out;
+}
+
+static void gf3d_collision_pose_set(CollisionPose *pose,const CollisionShape *shape,Vector3D position,Quaternion q)
+{
+    float xx = q.x * q.x,yy = q.y * q.y,zz = q.z * q.z;
+    float xy = q.x * q.y,xz = q.x * q.z,yz = q.y * q.z;
+    float wx = q.w * q.x,wy = q.w * q.y,wz = q.w * q.z;
+
+    pose->shape = shape;
+    pose->position = position;
+    pose->m[0] = 1 - 2 * (yy + zz);
+    pose->m[1] = 2 * (xy - wz);
+    pose->m[2] = 2 * (xz + wy);
+    pose->m[3] = 2 * (xy + wz);
+    pose->m[4] = 1 - 2 * (xx + zz);
+    pose->m[5] = 2 * (yz - wx);
+    pose->m[6] = 2 * (xz - wy);
+    pose->m[7] = 2 * (yz + wx);
+    pose->m[8] = 1 - 2 * (xx + yy);
+    pose->radius = ((shape->type == CS_Sphere)||(shape->type == CS_Capsule))?shape->radius:0;
+}
+
+/**
+ * SHAPES
+ */
+
+static CollisionShape *gf3d_collision_shape_new(CollisionShapeType type)
+{
+    CollisionShape *shape = (CollisionShape *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionShape),1);
+    if (!shape)return NULL;
+    shape->type = type;
+    return shape;
+}
+
+CollisionShape *gf3d_collision_shape_sphere(float radius)
+{
+    CollisionShape *shape;
+    if (radius <= 0)
+    {
+        slog("cannot make a sphere with radius %f",radius);
+        return NULL;
+    }
+    shape = gf3d_collision_shape_new(CS_Sphere);
+    if (!shape)return NULL;
+    shape->radius = radius;
+    return shape;
+}
+
+CollisionShape *gf3d_collision_shape_box(Vector3D halfExtents)
+{
+    CollisionShape *shape;
+    if ((halfExtents.x <= 0)||(halfExtents.y <= 0)||(halfExtents.z <= 0))
+    {
+        slog("cannot make a box with half extents %f,%f,%f",halfExtents.x,halfExtents.y,halfExtents.z);
+        return NULL;
+    }
+    shape = gf3d_collision_shape_new(CS_Box);
+    if (!shape)return NULL;
+    shape->halfExtents = halfExtents;
+    return shape;
+}
+
+CollisionShape *gf3d_collision_shape_capsule(float radius,float halfHeight)
+{
+    CollisionShape *shape;
+    if ((radius <= 0)||(halfHeight < 0))
+    {
+        slog("cannot make a capsule with radius %f and half height %f",radius,halfHeight);
+        return NULL;
+    }
+    shape = gf3d_collision_shape_new(CS_Capsule);
+    if (!shape)return NULL;
+    shape->radius = radius;
+    shape->halfHeight = halfHeight;
+    return shape;
+}
+
+CollisionShape *gf3d_collision_shape_hull(const Vector3D *points,Uint32 count)
+{
+    int i;
+    Uint32 padded;
+    Vector3D min,max;
+    CollisionShape *shape;
+
+    if ((!points)||(!count)||(count > GF3D_COLLISION_HULL_MAX))
+    {
+        slog("cannot make a hull from %u points, 1 to %i are allowed",count,GF3D_COLLISION_HULL_MAX);
+        return NULL;
+    }
+    shape = gf3d_collision_shape_new(CS_Hull);
+    if (!shape)return NULL;
+    // padded with copies of the first point, so the support search needs no tail loop
+    padded = (count + 3) & ~3;
+    shape->hullX = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),padded);
+    shape->hullY = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),padded);
+    shape->hullZ = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),padded);
+    if ((!shape->hullX)||(!shape->hullY)||(!shape->hullZ))
+    {
+        slog("failed to allocate hull vertices");
+        gf3d_collision_shape_free(shape);
+        return NULL;
+    }
+    shape->vertexCount = count;
+    min = max = points[0];
+    for (i = 0; i < padded; i++)
+    {
+        shape->hullX[i] = points[i < count?i:0].x;
+        shape->hullY[i] = points[i < count?i:0].y;
+        shape->hullZ[i] = points[i < count?i:0].z;
+        min.x = MIN(min.x,shape->hullX[i]);
+        min.y = MIN(min.y,shape->hullY[i]);
+        min.z = MIN(min.z,shape->hullZ[i]);
+        max.x = MAX(max.x,shape->hullX[i]);
+        max.y = MAX(max.y,shape->hullY[i]);
+        max.z = MAX(max.z,shape->hullZ[i]);
+    }
+    vector3d_add(shape->boundsCenter,min,max);
+    vector3d_scale(shape->boundsCenter,shape->boundsCenter,0.5f);
+    vector3d_sub(shape->boundsExtents,max,min);
+    vector3d_scale(shape->boundsExtents,shape->boundsExtents,0.5f);
+    return shape;
+}
+
+void gf3d_collision_shape_free(CollisionShape *shape)
+{
+    if (!shape)return;
+    gf3d_memory_free(shape->hullX);
+    gf3d_memory_free(shape->hullY);
+    gf3d_memory_free(shape->hullZ);
+    gf3d_memory_free(shape);
+}
+
+/**
+ * @brief the furthest vertex of a hull along a local direction, four vertices at a time
+ */
+static Vector3D gf3d_collision_hull_support(const CollisionShape *shape,Vector3D d)
+{
+    int i;
+    int best = 0;
+    Uint32 padded = (shape->vertexCount + 3) & ~3;
+    Vector3D out;
+#ifdef GF3D_COLLISION_SSE
+    float dots[4];
+    float indices[4];
+    __m128 dx = _mm_set1_ps(d.x);
+    __m128 dy = _mm_set1_ps(d.y);
+    __m128 dz = _mm_set1_ps(d.z);
+    __m128 bestDot = _mm_set1_ps(-FLT_MAX);
+    __m128 bestIndex = _mm_setzero_ps();
+    __m128 index = _mm_set_ps(3,2,1,0);
+    __m128 four = _mm_set1_ps(4);
+    __m128 dot,greater;
+
+    for (i = 0; i < padded; i += 4)
+    {
+        dot = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_loadu_ps(&shape->hullX[i]),dx),
+            _mm_mul_ps(_mm_loadu_ps(&shape->hullY[i]),dy)),
+            _mm_mul_ps(_mm_loadu_ps(&shape->hullZ[i]),dz));
+        greater = _mm_cmpgt_ps(dot,bestDot);
+        bestDot = _mm_max_ps(dot,bestDot);
+        bestIndex = _mm_or_ps(_mm_and_ps(greater,index),_mm_andnot_ps(greater,bestIndex));
+        index = _mm_add_ps(index,four);
+    }
+    _mm_storeu_ps(dots,bestDot);
+    _mm_storeu_ps(indices,bestIndex);
+    for (i = 1; i < 4; i++)
+    {
+        if (dots[i] > dots[best])best = i;
+    }
+    best = (int)indices[best];
+#else
+    float dot;
+    float bestDot = -FLT_MAX;
+    for (i = 0; i < padded; i++)
+    {
+        dot = shape->hullX[i] * d.x + shape->hullY[i] * d.y + shape->hullZ[i] * d.z;
+        if (dot > bestDot)
+        {
+            bestDot = dot;
+            best = i;
+        }
+    }
+#endif
+    out.x = shape->hullX[best];
+    out.y = shape->hullY[best];
+    out.z = shape->hullZ[best];
+    return out;
+}
+
+/**
+ * @brief the furthest point of a pose's shape along a world direction
+ * @param withRadius false for the core alone, true for the whole shape
+ */
+static Vector3D gf3d_collision_support(const CollisionPose *pose,Vector3D d,Bool withRadius)
+{
+    float length;
+    Vector3D out = {0};
+    Vector3D local = gf3d_collision_to_local(pose,d);
+    const CollisionShape *shape = pose->shape;
+
+    switch (shape->type)
+    {
+        case CS_Sphere:
+            break;
+        case CS_Capsule:
+            out.y = (local.y >= 0)?shape->halfHeight:-shape->halfHeight;
+            break;
+        case CS_Box:
+            out.x = (local.x >= 0)?shape->halfExtents.x:-shape->halfExtents.x;
+            out.y = (local.y >= 0)?shape->halfExtents.y:-shape->halfExtents.y;
+            out.z = (local.z >= 0)?shape->halfExtents.z:-shape->halfExtents.z;
+            break;
+        case CS_Hull:
+            out = gf3d_collision_hull_support(shape,local);
+            break;
+        default:
+            break;
+    }
+    out = gf3d_collision_to_world(pose,out);
+    if ((withRadius)&&(pose->radius > 0))
+    {
+        length = vector3d_dot_product(d,d);
+        if (length > 0)
+        {
+            length = pose->radius / sqrtf(length);
+            out.x += d.x * length;
+            out.y += d.y * length;
+            out.z += d.z * length;
+        }
+    }
+    return out;
+}
+
+static void gf3d_collision_pose_bounds(const CollisionPose *pose,CollisionBounds *bounds)
+{
+    Vector3D center = pose->position;
+    Vector3D extents;
+    const float *m = pose->m;
+    const CollisionShape *shape = pose->shape;
+
+    switch (shape->type)
+    {
+        case CS_Sphere:
+            extents.x = extents.y = extents.z = shape->radius;
+            break;
+        case CS_Capsule:
+            // the core is the local y axis, the second column of the rotation
+            extents.x = fabsf(m[1]) * shape->halfHeight + shape->radius;
+            extents.y = fabsf(m[4]) * shape->halfHeight + shape->radius;
+            extents.z = fabsf(m[7]) * shape->halfHeight + shape->radius;
+            break;
+        case CS_Box:
+        case CS_Hull:
+        default:
+            if (shape->type == CS_Hull)
+            {
+                center = gf3d_collision_to_world(pose,shape->boundsCenter);
+                extents = shape->boundsExtents;
+            }
+            else extents = shape->halfExtents;
+            // a rotated box's extent on each world axis is the sum of its local extents projected onto it
+            {
+                Vector3D e = extents;
+                extents.x = fabsf(m[0]) * e.x + fabsf(m[1]) * e.y + fabsf(m[2]) * e.z;
+                extents.y = fabsf(m[3]) * e.x + fabsf(m[4]) * e.y + fabsf(m[5]) * e.z;
+                extents.z = fabsf(m[6]) * e.x + fabsf(m[7]) * e.y + fabsf(m[8]) * e.z;
+            }
+            break;
+    }
+    vector3d_sub(bounds->min,center,extents);
+    vector3d_add(bounds->max,center,extents);
+}
+
+/**
+ * GJK
+ */
+
+/**
+ * @brief keep some of a simplex's points, in order, with the weights of its closest point
+ */
+static void gf3d_collision_simplex_keep(CollisionSimplex *simplex,const int *keep,const float *lambda,int count)
+{
+    int i;
+    CollisionSimplex kept;
+    for (i = 0; i < count; i++)
+    {
+        kept.w[i] = simplex->w[keep[i]];
+        kept.a[i] = simplex->a[keep[i]];
+        kept.b[i] = simplex->b[keep[i]];
+        kept.lambda[i] = lambda[i];
+    }
+    kept.count = count;
+    *simplex = kept;
+}
+
+/**
+ * @brief reduce a simplex of 2 points to the part closest to the origin
+ */
+static void gf3d_collision_closest_segment(CollisionSimplex *simplex,const int *index)
+{
+    float t,length;
+    float lambda[2];
+    Vector3D ab;
+    Vector3D a = simplex->w[index[0]];
+
+    vector3d_sub(ab,simplex->w[index[1]],a);
+    length = vector3d_dot_product(ab,ab);
+    t = (length > 0)?-vector3d_dot_product(a,ab) / length:0;
+    if (t <= 0)
+    {
+        lambda[0] = 1;
+        gf3d_collision_simplex_keep(simplex,index,lambda,1);
+        return;
+    }
+    if (t >= 1)
+    {
+        lambda[0] = 1;
+        gf3d_collision_simplex_keep(simplex,&index[1],lambda,1);
+        return;
+    }
+    lambda[0] = 1 - t;
+    lambda[1] = t;
+    gf3d_collision_simplex_keep(simplex,index,lambda,2);
+}
+
+/**
+ * @brief reduce a simplex of 3 points to the part closest to the origin, by which Voronoi region holds it
+ */
+static void gf3d_collision_closest_triangle(CollisionSimplex *simplex,const int *index)
+{
+    float d1,d2,d3,d4,d5,d6,va,vb,vc,v,w,denominator;
+    float lambda[3];
+    int keep[2];
+    Vector3D ab,ac;
+    Vector3D a = simplex->w[index[0]];
+    Vector3D b = simplex->w[index[1]];
+    Vector3D c = simplex->w[index[2]];
+
+    vector3d_sub(ab,b,a);
+    vector3d_sub(ac,c,a);
+    d1 = -vector3d_dot_product(ab,a);
+    d2 = -vector3d_dot_product(ac,a);
+    if ((d1 <= 0)&&(d2 <= 0))
+    {
+        lambda[0] = 1;
+        gf3d_collision_simplex_keep(simplex,index,lambda,1);
+        return;
+    }
+    d3 = -vector3d_dot_product(ab,b);
+    d4 = -vector3d_dot_product(ac,b);
+    if ((d3 >= 0)&&(d4 <= d3))
+    {
+        lambda[0] = 1;
+        gf3d_collision_simplex_keep(simplex,&index[1],lambda,1);
+        return;
+    }
+    vc = d1 * d4 - d3 * d2;
+    if ((vc <= 0)&&(d1 >= 0)&&(d3 <= 0))
+    {
+        v = d1 / (d1 - d3);
+        lambda[0] = 1 - v;
+        lambda[1] = v;
+        gf3d_collision_simplex_keep(simplex,index,lambda,2);
+        return;
+    }
+    d5 = -vector3d_dot_product(ab,c);
+    d6 = -vector3d_dot_product(ac,c);
+    if ((d6 >= 0)&&(d5 <= d6))
+    {
+        lambda[0] = 1;
+        gf3d_collision_simplex_keep(simplex,&index[2],lambda,1);
+        return;
+    }
+    vb = d5 * d2 - d1 * d6;
+    if ((vb <= 0)&&(d2 >= 0)&&(d6 <= 0))
+    {
+        w = d2 / (d2 - d6);
+        keep[0] = index[0];
+        keep[1] = index[2];
+        lambda[0] = 1 - w;
+        lambda[1] = w;
+        gf3d_collision_simplex_keep(simplex,keep,lambda,2);
+        return;
+    }
+    va = d3 * d6 - d5 * d4;
+    if ((va <= 0)&&((d4 - d3) >= 0)&&((d5 - d6) >= 0))
+    {
+        w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        lambda[0] = 1 - w;
+        lambda[1] = w;
+        gf3d_collision_simplex_keep(simplex,&index[1],lambda,2);
+        return;
+    }
+    denominator = 1.0f / (va + vb + vc);
+    v = vb * denominator;
+    w = vc * denominator;
+    lambda[0] = 1 - v - w;
+    lambda[1] = v;
+    lambda[2] = w;
+    gf3d_collision_simplex_keep(simplex,index,lambda,3);
+}
+
+/**
+ * @brief the weighted sum of a simplex's points, its closest point to the origin
+ */
+static Vector3D gf3d_collision_simplex_point(const CollisionSimplex *simplex,const Vector3D *points)
+{
+    int i;
+    Vector3D out = {0};
+    for (i = 0; i < simplex->count; i++)
+    {
+        out.x += points[i].x * simplex->lambda[i];
+        out.y += points[i].y * simplex->lambda[i];
+        out.z += points[i].z * simplex->lambda[i];
+    }
+    return out;
+}
+
+/**
+ * @brief reduce a simplex of 4 points to the face closest to the origin
+ * @return false if the origin is inside, the simplex is then left whole
+ */
+static Bool gf3d_collision_closest_tetrahedron(CollisionSimplex *simplex)
+{
+    static const int faces[4][4] = {{0,1,2,3},{0,2,3,1},{0,3,1,2},{1,3,2,0}};
+    int i;
+    float side,opposite,distance;
+    float bestDistance = FLT_MAX;
+    Bool outside = false;
+    Vector3D normal,ab,ac,ad,point;
+    CollisionSimplex face,best;
+
+    for (i = 0; i < 4; i++)
+    {
+        vector3d_sub(ab,simplex->w[faces[i][1]],simplex->w[faces[i][0]]);
+        vector3d_sub(ac,simplex->w[faces[i][2]],simplex->w[faces[i][0]]);
+        vector3d_sub(ad,simplex->w[faces[i][3]],simplex->w[faces[i][0]]);
+        normal = gf3d_collision_cross(ab,ac);
+        side = -vector3d_dot_product(simplex->w[faces[i][0]],normal);
+        opposite = vector3d_dot_product(ad,normal);
+        // the origin is on the other side of this face from the fourth point, or the tetrahedron is flat
+        if ((side * opposite >= 0)&&(opposite != 0))continue;
+        outside = true;
+        face = *simplex;
+        gf3d_collision_closest_triangle(&face,faces[i]);
+        point = gf3d_collision_simplex_point(&face,face.w);
+        distance = vector3d_dot_product(point,point);
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            best = face;
+        }
+    }
+    if (!outside)return false;
+    *simplex = best;
+    return true;
+}
+
+/**
+ * @brief find the closest points of two shapes' cores, or of the whole shapes
+ * @param direction where to start looking, the last result for this pair.  Set to the closest point of A - B
+ * @param simplex left holding the final simplex, which encloses the origin when the shapes overlap
+ * @param closestA set to the closest point on A
+ * @param closestB set to the closest point on B
+ * @param withRadius false to test the cores, true for the whole shapes
+ * @return the distance between them, 0 when they overlap
+ */
+static float gf3d_collision_gjk(
+    const CollisionPose *A,const CollisionPose *B,Vector3D *direction,CollisionSimplex *simplex,
+    Vector3D *closestA,Vector3D *closestB,Bool withRadius)
+{
+    static const int order[4] = {0,1,2,3};
+    int i,iteration;
+    float vv,vw,previous = FLT_MAX;
+    Vector3D v = *direction;
+    Vector3D negative,w,a,b;
+
+    if (vector3d_dot_product(v,v) < 1e-12f)vector3d_sub(v,A->position,B->position);
+    if (vector3d_dot_product(v,v) < 1e-12f)v = vector3d(1,0,0);
+    simplex->count = 0;
+    for (iteration = 0; iteration < GF3D_COLLISION_GJK_ITERATIONS; iteration++)
+    {
+        vector3d_scale(negative,v,-1);
+        a = gf3d_collision_support(A,negative,withRadius);
+        b = gf3d_collision_support(B,v,withRadius);
+        vector3d_sub(w,a,b);
+        if (simplex->count)
+        {
+            // the new point gets no closer than v already is
+            vv = vector3d_dot_product(v,v);
+            vw = vector3d_dot_product(v,w);
+            if (vv - vw <= GF3D_COLLISION_GJK_TOLERANCE * vv)break;
+            for (i = 0; i < simplex->count; i++)
+            {
+                if ((simplex->w[i].x == w.x)&&(simplex->w[i].y == w.y)&&(simplex->w[i].z == w.z))break;
+            }
+            if (i < simplex->count)break;
+        }
+        simplex->w[simplex->count] = w;
+        simplex->a[simplex->count] = a;
+        simplex->b[simplex->count] = b;
+        simplex->count++;
+        switch (simplex->count)
+        {
+            case 1:
+                simplex->lambda[0] = 1;
+                break;
+            case 2:
+                gf3d_collision_closest_segment(simplex,order);
+                break;
+            case 3:
+                gf3d_collision_closest_triangle(simplex,order);
+                break;
+            case 4:
+                if (!gf3d_collision_closest_tetrahedron(simplex))
+                {
+                    *closestA = *closestB = A->position;
+                    return 0;
+                }
+                break;
+        }
+        v = gf3d_collision_simplex_point(simplex,simplex->w);
+        vv = vector3d_dot_product(v,v);
+        if (vv < 1e-12f)break;
+        // rounding can make it wander once it is as close as it gets
+        if (vv >= previous)break;
+        previous = vv;
+    }
+    *direction = v;
+    *closestA = gf3d_collision_simplex_point(simplex,simplex->a);
+    *closestB = gf3d_collision_simplex_point(simplex,simplex->b);
+    vv = vector3d_dot_product(v,v);
+    if (vv < 1e-12f)return 0;
+    return sqrtf(vv);
+}
+
+/**
+ * EPA
+ */
+
+/**
+ * @brief add a face to the polytope, with its normal facing away from the origin
+ * @return false if there is no room
+ */
+static Bool gf3d_collision_epa_face(CollisionEpaFace *faces,int *faceCount,const Vector3D *w,int a,int b,int c)
+{
+    float length;
+    Vector3D ab,ac;
+    CollisionEpaFace *face;
+
+    if (*faceCount >= GF3D_COLLISION_EPA_FACES)return false;
+    face = &faces[(*faceCount)++];
+    face->a = a;
+    face->b = b;
+    face->c = c;
+    face->alive = true;
+    vector3d_sub(ab,w[b],w[a]);
+    vector3d_sub(ac,w[c],w[a]);
+    face->normal = gf3d_collision_cross(ab,ac);
+    length = sqrtf(vector3d_dot_product(face->normal,face->normal));
+    if (length < 1e-12f)
+    {
+        // a sliver, never the closest face
+        face->normal = vector3d(0,0,0);
+        face->distance = FLT_MAX;
+        return true;
+    }
+    vector3d_scale(face->normal,face->normal,1.0f / length);
+    face->distance = vector3d_dot_product(face->normal,w[a]);
+    return true;
+}
+
+/**
+ * @brief add an edge of the hole left by removed faces, or drop it if the face on its other side was removed too
+ */
+static void gf3d_collision_epa_edge(int edges[][2],int *edgeCount,int a,int b)
+{
+    int i;
+    for (i = 0; i < *edgeCount; i++)
+    {
+        if ((edges[i][0] == b)&&(edges[i][1] == a))
+        {
+            edges[i][0] = edges[*edgeCount - 1][0];
+            edges[i][1] = edges[*edgeCount - 1][1];
+            (*edgeCount)--;
+            return;
+        }
+    }
+    if (*edgeCount >= GF3D_COLLISION_EPA_EDGES)return;
+    edges[*edgeCount][0] = a;
+    edges[*edgeCount][1] = b;
+    (*edgeCount)++;
+}
+
+/**
+ * @brief grow a simplex that touches the origin into a tetrahedron, searching out from it
+ * @return false if the shapes only touch and no volume can be found
+ */
+static Bool gf3d_collision_epa_expand(const CollisionPose *A,const CollisionPose *B,CollisionSimplex *simplex)
+{
+    static const Vector3D axes[6] = {{1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1}};
+    int i,j;
+    float distance;
+    Vector3D d,a,b,w,edge,offset,normal,search[6];
+
+    for (i = 0; (i < 6)&&(simplex->count < 4); i++)
+    {
+        switch (simplex->count)
+        {
+            case 1:
+                search[i] = axes[i];
+                break;
+            case 2:
+                // around the segment
+                vector3d_sub(edge,simplex->w[1],simplex->w[0]);
+                normal = gf3d_collision_cross(edge,axes[(i / 2) * 2]);
+                if (vector3d_dot_product(normal,normal) < 1e-12f)normal = gf3d_collision_cross(edge,axes[((i / 2 + 1) % 3) * 2]);
+                if (i & 1)vector3d_scale(normal,normal,-1);
+                search[i] = normal;
+                break;
+            case 3:
+                // off either side of the triangle
+                vector3d_sub(edge,simplex->w[1],simplex->w[0]);
+                vector3d_sub(offset,simplex->w[2],simplex->w[0]);
+                normal = gf3d_collision_cross(edge,offset);
+                if (i & 1)vector3d_scale(normal,normal,-1);
+                search[i] = normal;
+                break;
+        }
+        d = search[i];
+        if (vector3d_dot_product(d,d) < 1e-12f)continue;
+        a = gf3d_collision_support(A,d,true);
+        vector3d_scale(d,d,-1);
+        b = gf3d_collision_support(B,d,true);
+        vector3d_sub(w,a,b);
+        // only keep it if it adds a dimension
+        distance = FLT_MAX;
+        for (j = 0; j < simplex->count; j++)
+        {
+            vector3d_sub(offset,w,simplex->w[j]);
+            distance = MIN(distance,vector3d_dot_product(offset,offset));
+        }
+        if (distance < 1e-10f)continue;
+        if (simplex->count == 2)
+        {
+            vector3d_sub(edge,simplex->w[1],simplex->w[0]);
+            vector3d_sub(offset,w,simplex->w[0]);
+            normal = gf3d_collision_cross(edge,offset);
+            if (vector3d_dot_product(normal,normal) < 1e-10f)continue;
+        }
+        if (simplex->count == 3)
+        {
+            vector3d_sub(edge,simplex->w[1],simplex->w[0]);
+            vector3d_sub(offset,simplex->w[2],simplex->w[0]);
+            normal = gf3d_collision_cross(edge,offset);
+            vector3d_sub(offset,w,simplex->w[0]);
+            if (fabsf(vector3d_dot_product(normal,offset)) < 1e-10f)continue;
+        }
+        simplex->w[simplex->count] = w;
+        simplex->a[simplex->count] = a;
+        simplex->b[simplex->count] = b;
+        simplex->count++;
+        i = -1;     // a new simplex, search all its directions
+    }
+    return simplex->count == 4;
+}
+
+/**
+ * @brief find how deep two overlapping shapes go into each other
+ * @param simplex the simplex GJK ended with on the whole shapes, it touches or encloses the origin
+ * @param contact filled in with the normal, depth and points
+ * @return false if the shapes only touch
+ */
+static Bool gf3d_collision_epa(const CollisionPose *A,const CollisionPose *B,CollisionSimplex *simplex,CollisionContact *contact)
+{
+    static const int tetrahedron[4][4] = {{0,1,2,3},{0,3,1,2},{0,2,3,1},{1,3,2,0}};
+    int i,iteration;
+    int faceCount = 0;
+    int edgeCount = 0;
+    int vertexCount;
+    float d00,d01,d11,d20,d21,denominator,u,v,w,gain;
+    Vector3D W[GF3D_COLLISION_EPA_VERTICES];
+    Vector3D VA[GF3D_COLLISION_EPA_VERTICES];
+    Vector3D VB[GF3D_COLLISION_EPA_VERTICES];
+    CollisionEpaFace faces[GF3D_COLLISION_EPA_FACES];
+    int edges[GF3D_COLLISION_EPA_EDGES][2];
+    CollisionEpaFace *closest;
+    CollisionEpaFace best;      // a copy, faces move when the array is compacted
+    Vector3D ab,ac,opposite,point,ap,a,b,p;
+
+    if ((simplex->count < 4)&&(!gf3d_collision_epa_expand(A,B,simplex)))return false;
+    for (i = 0; i < 4; i++)
+    {
+        W[i] = simplex->w[i];
+        VA[i] = simplex->a[i];
+        VB[i] = simplex->b[i];
+    }
+    vertexCount = 4;
+    for (i = 0; i < 4; i++)
+    {
+        // wind each face so its normal points away from the vertex it does not use
+        vector3d_sub(ab,W[tetrahedron[i][1]],W[tetrahedron[i][0]]);
+        vector3d_sub(ac,W[tetrahedron[i][2]],W[tetrahedron[i][0]]);
+        vector3d_sub(opposite,W[tetrahedron[i][3]],W[tetrahedron[i][0]]);
+        point = gf3d_collision_cross(ab,ac);
+        if (vector3d_dot_product(point,opposite) > 0)
+        {
+            gf3d_collision_epa_face(faces,&faceCount,W,tetrahedron[i][0],tetrahedron[i][2],tetrahedron[i][1]);
+        }
+        else gf3d_collision_epa_face(faces,&faceCount,W,tetrahedron[i][0],tetrahedron[i][1],tetrahedron[i][2]);
+    }
+    for (iteration = 0; iteration < GF3D_COLLISION_EPA_ITERATIONS; iteration++)
+    {
+        closest = NULL;
+        for (i = 0; i < faceCount; i++)
+        {
+            if (!faces[i].alive)continue;
+            if ((!closest)||(faces[i].distance < closest->distance))closest = &faces[i];
+        }
+        if ((!closest)||(closest->distance == FLT_MAX))return false;
+        best = *closest;
+        a = gf3d_collision_support(A,best.normal,true);
+        vector3d_scale(p,best.normal,-1);
+        b = gf3d_collision_support(B,p,true);
+        vector3d_sub(p,a,b);
+        gain = vector3d_dot_product(p,best.normal) - best.distance;
+        if ((gain < GF3D_COLLISION_EPA_TOLERANCE)||(vertexCount >= GF3D_COLLISION_EPA_VERTICES))break;
+        W[vertexCount] = p;
+        VA[vertexCount] = a;
+        VB[vertexCount] = b;
+        // carve out every face the new point can see, leaving a hole bounded by edges
+        edgeCount = 0;
+        for (i = 0; i < faceCount; i++)
+        {
+            if (!faces[i].alive)continue;
+            vector3d_sub(ap,p,W[faces[i].a]);
+            if (vector3d_dot_product(faces[i].normal,ap) <= 0)continue;
+            faces[i].alive = false;
+            gf3d_collision_epa_edge(edges,&edgeCount,faces[i].a,faces[i].b);
+            gf3d_collision_epa_edge(edges,&edgeCount,faces[i].b,faces[i].c);
+            gf3d_collision_epa_edge(edges,&edgeCount,faces[i].c,faces[i].a);
+        }
+        // and close it with faces out to the new point
+        for (i = 0; i < edgeCount; i++)
+        {
+            if (!gf3d_collision_epa_face(faces,&faceCount,W,edges[i][0],edges[i][1],vertexCount))break;
+        }
+        vertexCount++;
+        if (i < edgeCount)break;
+        // compact dead faces out once the array is filling up
+        if (faceCount > GF3D_COLLISION_EPA_FACES - GF3D_COLLISION_EPA_EDGES)
+        {
+            int kept = 0;
+            for (i = 0; i < faceCount; i++)
+            {
+                if (faces[i].alive)faces[kept++] = faces[i];
+            }
+            faceCount = kept;
+        }
+    }
+    // the origin projected onto the closest face, as weights of its corners
+    vector3d_scale(point,best.normal,best.distance);
+    vector3d_sub(ab,W[best.b],W[best.a]);
+    vector3d_sub(ac,W[best.c],W[best.a]);
+    vector3d_sub(ap,point,W[best.a]);
+    d00 = vector3d_dot_product(ab,ab);
+    d01 = vector3d_dot_product(ab,ac);
+    d11 = vector3d_dot_product(ac,ac);
+    d20 = vector3d_dot_product(ap,ab);
+    d21 = vector3d_dot_product(ap,ac);
+    denominator = d00 * d11 - d01 * d01;
+    if (fabsf(denominator) > 1e-12f)
+    {
+        v = (d11 * d20 - d01 * d21) / denominator;
+        w = (d00 * d21 - d01 * d20) / denominator;
+        u = 1 - v - w;
+    }
+    else
+    {
+        u = 1;
+        v = w = 0;
+    }
+    contact->normal = best.normal;
+    contact->depth = best.distance;
+    contact->pointA.x = VA[best.a].x * u + VA[best.b].x * v + VA[best.c].x * w;
+    contact->pointA.y = VA[best.a].y * u + VA[best.b].y * v + VA[best.c].y * w;
+    contact->pointA.z = VA[best.a].z * u + VA[best.b].z * v + VA[best.c].z * w;
+    contact->pointB.x = VB[best.a].x * u + VB[best.b].x * v + VB[best.c].x * w;
+    contact->pointB.y = VB[best.a].y * u + VB[best.b].y * v + VB[best.c].y * w;
+    contact->pointB.z = VB[best.a].z * u + VB[best.b].z * v + VB[best.c].z * w;
+    return true;
+}
+
+/**
+ * NARROWPHASE
+ */
+
+/**
+ * @brief find the contact between two posed shapes
+ * @param direction where GJK starts, updated for next time
+ * @param epaRuns counts the tests that needed EPA
+ * @return true if they touch
+ */
+static Bool gf3d_collision_contact(const CollisionPose *A,const CollisionPose *B,Vector3D *direction,CollisionContact *contact,Uint32 *epaRuns)
+{
+    float distance,radius;
+    Vector3D closestA,closestB,d;
+    CollisionSimplex simplex;
+
+    radius = A->radius + B->radius;
+    // two spheres are two points, nothing to iterate
+    if ((A->shape->type == CS_Sphere)&&(B->shape->type == CS_Sphere))
+    {
+        vector3d_sub(d,B->position,A->position);
+        distance = vector3d_dot_product(d,d);
+        if (distance > radius * radius)return false;
+        distance = sqrtf(distance);
+        if (distance > GF3D_COLLISION_CORE_EPSILON)vector3d_scale(contact->normal,d,1.0f / distance);
+        else contact->normal = vector3d(0,1,0);
+        closestA = A->position;
+        closestB = B->position;
+    }
+    else
+    {
+        distance = gf3d_collision_gjk(A,B,direction,&simplex,&closestA,&closestB,false);
+        if (distance > radius)return false;
+        if (distance <= GF3D_COLLISION_CORE_EPSILON)
+        {
+            // the cores touch, so the depth has to come from the whole shapes
+            (*epaRuns)++;
+            if ((radius > 0)&&(gf3d_collision_gjk(A,B,direction,&simplex,&closestA,&closestB,true) > GF3D_COLLISION_CORE_EPSILON))
+            {
+                return false;
+            }
+            if (!gf3d_collision_epa(A,B,&simplex,contact))
+            {
+                // only touching, with nothing to push apart
+                vector3d_sub(d,B->position,A->position);
+                distance = vector3d_dot_product(d,d);
+                if (distance > 1e-12f)vector3d_scale(contact->normal,d,1.0f / sqrtf(distance));
+                else contact->normal = vector3d(0,1,0);
+                contact->depth = 0;
+                contact->pointA = contact->pointB = closestA;
+            }
+            direction->x = -contact->normal.x;
+            direction->y = -contact->normal.y;
+            direction->z = -contact->normal.z;
+            return true;
+        }
+        vector3d_sub(d,closestB,closestA);
+        vector3d_scale(contact->normal,d,1.0f / distance);
+    }
+    contact->depth = radius - distance;
+    contact->pointA.x = closestA.x + contact->normal.x * A->radius;
+    contact->pointA.y = closestA.y + contact->normal.y * A->radius;
+    contact->pointA.z = closestA.z + contact->normal.z * A->radius;
+    contact->pointB.x = closestB.x - contact->normal.x * B->radius;
+    contact->pointB.y = closestB.y - contact->normal.y * B->radius;
+    contact->pointB.z = closestB.z - contact->normal.z * B->radius;
+    return true;
+}
+
+Bool gf3d_collision_test(
+    const CollisionShape *shapeA,Vector3D positionA,Quaternion rotationA,
+    const CollisionShape *shapeB,Vector3D positionB,Quaternion rotationB,
+    CollisionContact *contact)
+{
+    Uint32 epaRuns = 0;
+    Vector3D direction = {0};
+    CollisionPose A,B;
+    CollisionContact result;
+
+    if ((!shapeA)||(!shapeB))return false;
+    gf3d_collision_pose_set(&A,shapeA,positionA,rotationA);
+    gf3d_collision_pose_set(&B,shapeB,positionB,rotationB);
+    if (!gf3d_collision_contact(&A,&B,&direction,&result,&epaRuns))return false;
+    if (contact)
+    {
+        result.bodyA = result.bodyB = -1;
+        result.began = false;
+        *contact = result;
+    }
+    return true;
+}
+
+/**
+ * INIT
+ */
+
+/**
+ * @brief free the arrays the boxes are copied into for the sweep
+ */
+static void gf3d_collision_slots_free()
+{
+    gf3d_memory_free(gf3d_collision.sMinX);
+    gf3d_memory_free(gf3d_collision.sMaxX);
+    gf3d_memory_free(gf3d_collision.sMinY);
+    gf3d_memory_free(gf3d_collision.sMaxY);
+    gf3d_memory_free(gf3d_collision.sMinZ);
+    gf3d_memory_free(gf3d_collision.sMaxZ);
+    gf3d_memory_free(gf3d_collision.sBody);
+    gf3d_memory_free(gf3d_collision.sStatic);
+    gf3d_memory_free(gf3d_collision.sBand);
+    gf3d_collision.sMinX = gf3d_collision.sMaxX = NULL;
+    gf3d_collision.sMinY = gf3d_collision.sMaxY = NULL;
+    gf3d_collision.sMinZ = gf3d_collision.sMaxZ = NULL;
+    gf3d_collision.sBody = NULL;
+    gf3d_collision.sStatic = gf3d_collision.sBand = NULL;
+    gf3d_collision.slotMax = 0;
+}
+
+/**
+ * @brief make room for the boxes the sweep works on, a box that spans several slices is copied into each
+ * @note the contents are not kept, they are written afresh every update
+ * @return false if they could not be allocated
+ */
+static Bool gf3d_collision_slots_reserve(Uint32 needed)
+{
+    Uint32 max;
+    if (needed <= gf3d_collision.slotMax)return true;
+    max = MAX(needed + needed / 4,gf3d_collision.slotMax * 2);
+    gf3d_collision_slots_free();
+    gf3d_collision.sMinX = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sMaxX = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sMinY = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sMaxY = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sMinZ = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sMaxZ = (float *)gf3d_memory_allocate(MT_Physics,sizeof(float),max);
+    gf3d_collision.sBody = (Uint32 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint32),max);
+    gf3d_collision.sStatic = (Uint8 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint8),max);
+    gf3d_collision.sBand = (Uint8 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint8),max);
+    if ((!gf3d_collision.sMinX)||(!gf3d_collision.sMaxX)||(!gf3d_collision.sMinY)||(!gf3d_collision.sMaxY)||
+        (!gf3d_collision.sMinZ)||(!gf3d_collision.sMaxZ)||(!gf3d_collision.sBody)||(!gf3d_collision.sStatic)||
+        (!gf3d_collision.sBand))
+    {
+        slog("failed to allocate room to sweep %u boxes",needed);
+        gf3d_collision_slots_free();
+        return false;
+    }
+    gf3d_collision.slotMax = max;
+    return true;
+}
+
+void gf3d_collision_init(Uint32 maxBodies)
+{
+    int i;
+
+    if (gf3d_collision.initialized)
+    {
+        slog("collision is already initialized");
+        return;
+    }
+    if (!maxBodies)
+    {
+        slog("cannot initialize collision for zero bodies");
+        return;
+    }
+    atexit(gf3d_collision_close);
+    gf3d_collision.poses = (CollisionPose *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionPose),maxBodies);
+    gf3d_collision.bounds = (CollisionBounds *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionBounds),maxBodies);
+    gf3d_collision.data = (void **)gf3d_memory_allocate(MT_Physics,sizeof(void *),maxBodies);
+    gf3d_collision.state = (Uint8 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint8),maxBodies);
+    gf3d_collision.isStatic = (Uint8 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint8),maxBodies);
+    gf3d_collision.freeIds = (Uint32 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint32),maxBodies);
+    gf3d_collision.removedIds = (Uint32 *)gf3d_memory_allocate(MT_Physics,sizeof(Uint32),maxBodies);
+    gf3d_collision.sorted = (CollisionSortEntry *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionSortEntry),maxBodies);
+    gf3d_collision.bandStarts = (Uint32 *)gf3d_memory_allocate(
+        MT_Physics,sizeof(Uint32),(maxBodies / GF3D_COLLISION_BOUNDS_BATCH + 1) * GF3D_COLLISION_BANDS_MAX);
+    gf3d_collision.tableSize = GF3D_COLLISION_PAIRS_DEFAULT * 2;
+    gf3d_collision.table = (CollisionPairSlot *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionPairSlot),gf3d_collision.tableSize);
+    gf3d_collision.pairs = (CollisionPairEntry *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionPairEntry),gf3d_collision.tableSize / 2);
+    if ((!gf3d_collision.poses)||(!gf3d_collision.bounds)||(!gf3d_collision.data)||(!gf3d_collision.state)||
+        (!gf3d_collision.isStatic)||(!gf3d_collision.freeIds)||(!gf3d_collision.removedIds)||(!gf3d_collision.sorted)||
+        (!gf3d_collision.bandStarts)||(!gf3d_collision.table)||(!gf3d_collision.pairs)||
+        (!gf3d_collision_slots_reserve(maxBodies + GF3D_COLLISION_PADDING * GF3D_COLLISION_BANDS_MAX)))
+    {
+        slog("failed to allocate collision bodies");
+        gf3d_collision_close();
+        return;
+    }
+    for (i = 0; i < gf3d_collision.tableSize; i++)
+    {
+        gf3d_collision.table[i].index = -1;
+    }
+    for (i = 0; i < maxBodies; i++)
+    {
+        gf3d_collision.freeIds[i] = maxBodies - 1 - i;
+    }
+    gf3d_collision.freeCount = maxBodies;
+    gf3d_collision.maxBodies = maxBodies;
+    gf3d_collision.initialized = true;
+    slog("collision initialized for %u bodies",maxBodies);
+}
+
+void gf3d_collision_close()
+{
+    int i;
+
+    gf3d_collision_slots_free();
+    for (i = 0; i < GF3D_JOBS_MAX_THREADS; i++)
+    {
+        gf3d_memory_free(gf3d_collision.buffers[i].keys);
+    }
+    gf3d_memory_free(gf3d_collision.poses);
+    gf3d_memory_free(gf3d_collision.bounds);
+    gf3d_memory_free(gf3d_collision.data);
+    gf3d_memory_free(gf3d_collision.state);
+    gf3d_memory_free(gf3d_collision.isStatic);
+    gf3d_memory_free(gf3d_collision.freeIds);
+    gf3d_memory_free(gf3d_collision.removedIds);
+    gf3d_memory_free(gf3d_collision.sorted);
+    gf3d_memory_free(gf3d_collision.bandStarts);
+    gf3d_memory_free(gf3d_collision.table);
+    gf3d_memory_free(gf3d_collision.pairs);
+    gf3d_memory_free(gf3d_collision.contacts);
+    gf3d_memory_free(gf3d_collision.ended);
+    memset(&gf3d_collision,0,sizeof(CollisionManager));
+}
+
+/**
+ * BODIES
+ */
+
+Sint32 gf3d_collision_body_add(const CollisionShape *shape,Vector3D position,Quaternion rotation,Bool isStatic,void *data)
+{
+    Uint32 body;
+    if ((!shape)||(!gf3d_collision.initialized))return -1;
+    if (!gf3d_collision.freeCount)
+    {
+        slog("no room for another collision body");
+        return -1;
+    }
+    body = gf3d_collision.freeIds[--gf3d_collision.freeCount];
+    gf3d_collision_pose_set(&gf3d_collision.poses[body],shape,position,rotation);
+    gf3d_collision.data[body] = data;
+    gf3d_collision.isStatic[body] = isStatic?1:0;
+    gf3d_collision.state[body] = BS_Alive;
+    // its place in the sorted list is found at the next update
+    gf3d_collision.sorted[gf3d_collision.sortedCount].body = body;
+    gf3d_collision.sorted[gf3d_collision.sortedCount].minX = 0;
+    gf3d_collision.sortedCount++;
+    gf3d_collision.added++;
+    gf3d_collision.bodyCount++;
+    return body;
+}
+
+void gf3d_collision_body_remove(Sint32 body)
+{
+    if ((body < 0)||(body >= gf3d_collision.maxBodies))return;
+    if (gf3d_collision.state[body] != BS_Alive)return;
+    gf3d_collision.state[body] = BS_Removed;
+    gf3d_collision.data[body] = NULL;
+    gf3d_collision.removedIds[gf3d_collision.removedCount++] = body;
+    gf3d_collision.bodyCount--;
+}
+
+void gf3d_collision_body_set_transform(Sint32 body,Vector3D position,Quaternion rotation)
+{
+    if ((body < 0)||(body >= gf3d_collision.maxBodies))return;
+    if (gf3d_collision.state[body] != BS_Alive)return;
+    gf3d_collision_pose_set(&gf3d_collision.poses[body],gf3d_collision.poses[body].shape,position,rotation);
+}
+
+void *gf3d_collision_body_get_data(Sint32 body)
+{
+    if ((body < 0)||(body >= gf3d_collision.maxBodies))return NULL;
+    if (gf3d_collision.state[body] != BS_Alive)return NULL;
+    return gf3d_collision.data[body];
+}
+
+/**
+ * PAIR CACHE
+ */
+
+static Uint32 gf3d_collision_pair_hash(Uint64 key)
+{
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (Uint32)(key >> 32) & (gf3d_collision.tableSize - 1);
+}
+
+static Uint64 gf3d_collision_pair_key(const CollisionPairEntry *pair)
+{
+    return ((Uint64)pair->bodyA << 32) | pair->bodyB;
+}
+
+/**
+ * @brief find where a pair sits in the table
+ * @param key the pair's key, lower body id in the high 32 bits
+ * @return the slot, or the empty slot where it would go
+ */
+static Uint32 gf3d_collision_pair_slot(Uint64 key)
+{
+    Uint32 mask = gf3d_collision.tableSize - 1;
+    Uint32 slot = gf3d_collision_pair_hash(key);
+    while ((gf3d_collision.table[slot].index >= 0)&&(gf3d_collision.table[slot].key != key))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief double the table and the pair array
+ */
+static Bool gf3d_collision_pairs_grow()
+{
+    int i;
+    Uint32 slot;
+    Uint32 size = gf3d_collision.tableSize * 2;
+    CollisionPairSlot *table = (CollisionPairSlot *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionPairSlot),size);
+    CollisionPairEntry *pairs = (CollisionPairEntry *)gf3d_memory_allocate(MT_Physics,sizeof(CollisionPairEntry),size / 2);
+
+    if ((!table)||(!pairs))
+    {
+        slog("failed to grow the pair cache past %u pairs",gf3d_collision.pairCount);
+        gf3d_memory_free(table);
+        gf3d_memory_free(pairs);
+        return false;
+    }
+    memcpy(pairs,gf3d_collision.pairs,sizeof(CollisionPairEntry) * gf3d_collision.pairCount);
+    gf3d_memory_free(gf3d_collision.pairs);
+    gf3d_memory_free(gf3d_collision.table);
+    for (i = 0; i < size; i++)
+    {
+        table[i].index = -1;
+    }
+    gf3d_collision.pairs = pairs;
+    gf3d_collision.table = table;
+    gf3d_collision.tableSize = size;
+    for (i = 0; i < gf3d_collision.pairCount; i++)
+    {
+        slot = gf3d_collision_pair_slot(gf3d_collision_pair_key(&pairs[i]));
+        table[slot].key = gf3d_collision_pair_key(&pairs[i]);
+        table[slot].index = i;
+    }
+    return true;
+}
+
+/**
+ * @brief mark a pair as seen by this update, adding it if it is new
+ * @param key the pair's key, lower body id in the high 32 bits
+ */
+static void gf3d_collision_pair_touch(Uint64 key)
+{
+    Uint32 slot = gf3d_collision_pair_slot(key);
+    Sint32 index = gf3d_collision.table[slot].index;
+    CollisionPairEntry *pair;
+
+    if (index < 0)
+    {
+        // kept at most half full
+        if ((gf3d_collision.pairCount + 1) * 2 > gf3d_collision.tableSize)
+        {
+            if (!gf3d_collision_pairs_grow())return;
+            slot = gf3d_collision_pair_slot(key);
+        }
+        index = gf3d_collision.pairCount++;
+        gf3d_collision.table[slot].key = key;
+        gf3d_collision.table[slot].index = index;
+        pair = &gf3d_collision.pairs[index];
+        memset(pair,0,sizeof(CollisionPairEntry));
+        pair->bodyA = (Uint32)(key >> 32);
+        pair->bodyB = (Uint32)key;
+    }
+    gf3d_collision.pairs[index].frame = gf3d_collision.frame;
+}
+
+/**
+ * @brief take a pair out of the cache, moving the last pair into its place
+ */
+static void gf3d_collision_pair_remove(Uint32 index)
+{
+    Uint32 hole,i,home;
+    Uint32 last = gf3d_collision.pairCount - 1;
+    Uint32 mask = gf3d_collision.tableSize - 1;
+    CollisionPairEntry *pair = &gf3d_collision.pairs[index];
+    CollisionPairSlot *table = gf3d_collision.table;
+
+    hole = gf3d_collision_pair_slot(gf3d_collision_pair_key(pair));
+    i = hole;
+    for (;;)
+    {
+        i = (i + 1) & mask;
+        if (table[i].index < 0)break;
+        home = gf3d_collision_pair_hash(table[i].key);
+        // an entry can fill the hole if the hole lies between where it belongs and where it is
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole].index = -1;
+    if (index != last)
+    {
+        table[gf3d_collision_pair_slot(gf3d_collision_pair_key(&gf3d_collision.pairs[last]))].index = index;
+        *pair = gf3d_collision.pairs[last];
+    }
+    gf3d_collision.pairCount--;
+}
+
+/**
+ * @brief make room in a growing array
+ * @return false if it could not grow
+ */
+static Bool gf3d_collision_reserve(void **array,Uint32 *max,Uint32 needed,size_t size)
+{
+    Uint32 newMax;
+    void *grown;
+    if (needed <= *max)return true;
+    newMax = MAX(MAX(*max * 2,needed),GF3D_COLLISION_PAIRS_DEFAULT);
+    grown = gf3d_memory_allocate(MT_Physics,size,newMax);
+    if (!grown)return false;
+    if (*array)
+    {
+        memcpy(grown,*array,size * *max);
+        gf3d_memory_free(*array);
+    }
+    *array = grown;
+    *max = newMax;
+    return true;
+}
+
+/**
+ * UPDATE
+ */
+
+static void gf3d_collision_bounds_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 body;
+    CollisionBounds *bounds;
+    CollisionBoundsRange *range = &gf3d_collision.ranges[thread];
+    for (; first < last; first++)
+    {
+        body = gf3d_collision.sorted[first].body;
+        bounds = &gf3d_collision.bounds[body];
+        gf3d_collision_pose_bounds(&gf3d_collision.poses[body],bounds);
+        gf3d_collision.sorted[first].minX = bounds->min.x;
+        range->minZ = MIN(range->minZ,bounds->min.z);
+        range->maxZ = MAX(range->maxZ,bounds->max.z);
+        range->depth += bounds->max.z - bounds->min.z;
+    }
+}
+
+/**
+ * @brief which slice along z a height falls in
+ */
+static Uint32 gf3d_collision_band(float z)
+{
+    float band = (z - gf3d_collision.bandMin) * gf3d_collision.bandScale;
+    if (band <= 0)return 0;
+    if (band >= gf3d_collision.bandCount)return gf3d_collision.bandCount - 1;
+    return (Uint32)band;
+}
+
+/**
+ * @brief split the sweep into slices along z, so boxes only meet the boxes beside them in z as well as in x
+ * @note a crowd of bodies spread over a wide area sees far more neighbours along one axis than it overlaps, slices cut
+ * that down as long as they stay deeper than the boxes
+ */
+static void gf3d_collision_bands_choose(Uint32 count)
+{
+    int i;
+    Uint32 bands;
+    float depth,limit;
+    CollisionBoundsRange range = {FLT_MAX,-FLT_MAX,0};
+
+    for (i = 0; i < GF3D_JOBS_MAX_THREADS; i++)
+    {
+        range.minZ = MIN(range.minZ,gf3d_collision.ranges[i].minZ);
+        range.maxZ = MAX(range.maxZ,gf3d_collision.ranges[i].maxZ);
+        range.depth += gf3d_collision.ranges[i].depth;
+    }
+    bands = count / GF3D_COLLISION_BAND_BODIES;
+    if ((count)&&(range.maxZ > range.minZ))
+    {
+        depth = (float)(range.depth / count) * GF3D_COLLISION_BAND_DEPTH;
+        limit = (depth > 0)?(range.maxZ - range.minZ) / depth:GF3D_COLLISION_BANDS_MAX;
+        if (limit < bands)bands = (Uint32)limit;
+    }
+    else bands = 1;
+    bands = MAX(1,MIN(bands,GF3D_COLLISION_BANDS_MAX));
+    gf3d_collision.bandCount = bands;
+    gf3d_collision.bandMin = range.minZ;
+    gf3d_collision.bandScale = (bands > 1)?bands / (range.maxZ - range.minZ):0;
+}
+
+/**
+ * @brief count how many boxes of a chunk of the sorted list land in each slice
+ */
+static void gf3d_collision_count_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 i,end,band,lastBand;
+    Uint32 *counts;
+    CollisionBounds *bounds;
+    for (; first < last; first++)
+    {
+        counts = &gf3d_collision.bandStarts[first * GF3D_COLLISION_BANDS_MAX];
+        memset(counts,0,sizeof(Uint32) * GF3D_COLLISION_BANDS_MAX);
+        end = MIN((first + 1) * GF3D_COLLISION_BOUNDS_BATCH,gf3d_collision.sortedCount);
+        for (i = first * GF3D_COLLISION_BOUNDS_BATCH; i < end; i++)
+        {
+            bounds = &gf3d_collision.bounds[gf3d_collision.sorted[i].body];
+            lastBand = gf3d_collision_band(bounds->max.z);
+            for (band = gf3d_collision_band(bounds->min.z); band <= lastBand; band++)counts[band]++;
+        }
+    }
+}
+
+/**
+ * @brief copy a chunk of the sorted list into the slices, which stay in sorted order because chunks are in order
+ */
+static void gf3d_collision_gather_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 i,end,body,band,lastBand,slot;
+    Uint32 starts[GF3D_COLLISION_BANDS_MAX];
+    CollisionBounds *bounds;
+    for (; first < last; first++)
+    {
+        memcpy(starts,&gf3d_collision.bandStarts[first * GF3D_COLLISION_BANDS_MAX],sizeof(Uint32) * gf3d_collision.bandCount);
+        end = MIN((first + 1) * GF3D_COLLISION_BOUNDS_BATCH,gf3d_collision.sortedCount);
+        for (i = first * GF3D_COLLISION_BOUNDS_BATCH; i < end; i++)
+        {
+            body = gf3d_collision.sorted[i].body;
+            bounds = &gf3d_collision.bounds[body];
+            lastBand = gf3d_collision_band(bounds->max.z);
+            for (band = gf3d_collision_band(bounds->min.z); band <= lastBand; band++)
+            {
+                slot = starts[band]++;
+                gf3d_collision.sMinX[slot] = bounds->min.x;
+                gf3d_collision.sMaxX[slot] = bounds->max.x;
+                gf3d_collision.sMinY[slot] = bounds->min.y;
+                gf3d_collision.sMaxY[slot] = bounds->max.y;
+                gf3d_collision.sMinZ[slot] = bounds->min.z;
+                gf3d_collision.sMaxZ[slot] = bounds->max.z;
+                gf3d_collision.sBody[slot] = body;
+                gf3d_collision.sStatic[slot] = gf3d_collision.isStatic[body];
+                gf3d_collision.sBand[slot] = band;
+            }
+        }
+    }
+}
+
+/**
+ * @brief lay the slices out one after another, each followed by sentinels, and copy the boxes into them
+ * @return false if there was no room
+ */
+static Bool gf3d_collision_gather(Uint32 count)
+{
+    Uint32 c,band,n,i,slot;
+    Uint32 offset = 0;
+    Uint32 chunks = (count + GF3D_COLLISION_BOUNDS_BATCH - 1) / GF3D_COLLISION_BOUNDS_BATCH;
+    Uint32 ends[GF3D_COLLISION_BANDS_MAX];
+    Uint32 *starts = gf3d_collision.bandStarts;
+
+    gf3d_jobs_parallel_for(chunks,1,gf3d_collision_count_run,NULL);
+    for (band = 0; band < gf3d_collision.bandCount; band++)
+    {
+        for (c = 0; c < chunks; c++)
+        {
+            n = starts[c * GF3D_COLLISION_BANDS_MAX + band];
+            starts[c * GF3D_COLLISION_BANDS_MAX + band] = offset;
+            offset += n;
+        }
+        ends[band] = offset;
+        offset += GF3D_COLLISION_PADDING;
+    }
+    if (!gf3d_collision_slots_reserve(offset))
+    {
+        gf3d_collision.slotCount = 0;
+        return false;
+    }
+    gf3d_collision.slotCount = offset;
+    for (band = 0; band < gf3d_collision.bandCount; band++)
+    {
+        // a sentinel starts past every box and ends before any, so sweeps stop at it and it finds nothing itself
+        for (i = 0; i < GF3D_COLLISION_PADDING; i++)
+        {
+            slot = ends[band] + i;
+            gf3d_collision.sMinX[slot] = FLT_MAX;
+            gf3d_collision.sMaxX[slot] = -FLT_MAX;
+            gf3d_collision.sBand[slot] = band;
+        }
+    }
+    gf3d_jobs_parallel_for(chunks,1,gf3d_collision_gather_run,NULL);
+    return true;
+}
+
+static int gf3d_collision_sort_compare(const void *a,const void *b)
+{
+    float minA = ((const CollisionSortEntry *)a)->minX;
+    float minB = ((const CollisionSortEntry *)b)->minX;
+    if (minA < minB)return -1;
+    if (minA > minB)return 1;
+    return 0;
+}
+
+/**
+ * @brief put the sorted list back in order.  Bodies barely move between updates, so each one only shifts a few places
+ */
+static void gf3d_collision_sort()
+{
+    int i,j;
+    Uint32 swaps = 0;
+    CollisionSortEntry entry;
+    CollisionSortEntry *sorted = gf3d_collision.sorted;
+
+    if (gf3d_collision.added * GF3D_COLLISION_FULL_SORT > gf3d_collision.sortedCount)
+    {
+        qsort(sorted,gf3d_collision.sortedCount,sizeof(CollisionSortEntry),gf3d_collision_sort_compare);
+        gf3d_collision.stats.fullSorts++;
+    }
+    else
+    {
+        for (i = 1; i < gf3d_collision.sortedCount; i++)
+        {
+            if (sorted[i - 1].minX <= sorted[i].minX)continue;
+            entry = sorted[i];
+            for (j = i; (j > 0)&&(sorted[j - 1].minX > entry.minX); j--)
+            {
+                sorted[j] = sorted[j - 1];
+            }
+            swaps += i - j;
+            sorted[j] = entry;
+        }
+    }
+    gf3d_collision.added = 0;
+    gf3d_collision.stats.swaps = swaps;
+}
+
+static void gf3d_collision_emit(CollisionPairBuffer *buffer,Uint32 a,Uint32 b)
+{
+    if (buffer->count >= buffer->max)
+    {
+        if (!gf3d_collision_reserve((void **)&buffer->keys,&buffer->max,buffer->count + 1,sizeof(Uint64)))return;
+    }
+    if (a > b)buffer->keys[buffer->count++] = ((Uint64)b << 32) | a;
+    else buffer->keys[buffer->count++] = ((Uint64)a << 32) | b;
+}
+
+/**
+ * @brief find the overlaps of a run of boxes with the boxes after them in the same slice
+ * @note a pair that shares several slices is only reported by the one holding the bottom of their overlap
+ */
+static void gf3d_collision_sweep_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 i,j,k,bits,inX,band;
+    float maxX,minY,maxY,minZ,maxZ;
+    Uint8 isStatic;
+    Bool banded = gf3d_collision.bandCount > 1;
+    CollisionPairBuffer *buffer = &gf3d_collision.buffers[thread];
+    const float *sMinX = gf3d_collision.sMinX;
+    const float *sMinY = gf3d_collision.sMinY;
+    const float *sMaxY = gf3d_collision.sMaxY;
+    const float *sMinZ = gf3d_collision.sMinZ;
+    const float *sMaxZ = gf3d_collision.sMaxZ;
+#ifdef GF3D_COLLISION_SSE
+    __m128 maxX4,minY4,maxY4,minZ4,maxZ4,x,overlap;
+#endif
+
+    for (i = first; i < last; i++)
+    {
+        if (sMinX[i] == FLT_MAX)continue;   // a sentinel
+        maxX = gf3d_collision.sMaxX[i];
+        minY = sMinY[i];
+        maxY = sMaxY[i];
+        minZ = sMinZ[i];
+        maxZ = sMaxZ[i];
+        isStatic = gf3d_collision.sStatic[i];
+        band = gf3d_collision.sBand[i];
+#ifdef GF3D_COLLISION_SSE
+        maxX4 = _mm_set1_ps(maxX);
+        minY4 = _mm_set1_ps(minY);
+        maxY4 = _mm_set1_ps(maxY);
+        minZ4 = _mm_set1_ps(minZ);
+        maxZ4 = _mm_set1_ps(maxZ);
+        // boxes after i start at or past its lowest x, so they overlap on x until the first one that starts past its
+        // highest.  The sentinels at the end of the slice never do
+        for (j = i + 1;; j += 4)
+        {
+            x = _mm_cmple_ps(_mm_loadu_ps(&sMinX[j]),maxX4);
+            inX = _mm_movemask_ps(x);
+            if (!inX)break;
+            overlap = _mm_and_ps(x,_mm_and_ps(
+                _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&sMinY[j]),maxY4),_mm_cmpge_ps(_mm_loadu_ps(&sMaxY[j]),minY4)),
+                _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&sMinZ[j]),maxZ4),_mm_cmpge_ps(_mm_loadu_ps(&sMaxZ[j]),minZ4))));
+            bits = _mm_movemask_ps(overlap);
+            for (k = j; bits; k++,bits >>= 1)
+            {
+                if (!(bits & 1))continue;
+                if ((isStatic)&&(gf3d_collision.sStatic[k]))continue;
+                if ((banded)&&(gf3d_collision_band(MAX(minZ,sMinZ[k])) != band))continue;
+                gf3d_collision_emit(buffer,gf3d_collision.sBody[i],gf3d_collision.sBody[k]);
+            }
+            if (inX != 15)break;
+        }
+#else
+        for (j = i + 1; sMinX[j] <= maxX; j++)
+        {
+            if ((sMinY[j] > maxY)||(sMaxY[j] < minY)||(sMinZ[j] > maxZ)||(sMaxZ[j] < minZ))continue;
+            if ((isStatic)&&(gf3d_collision.sStatic[j]))continue;
+            if ((banded)&&(gf3d_collision_band(MAX(minZ,sMinZ[j])) != band))continue;
+            gf3d_collision_emit(buffer,gf3d_collision.sBody[i],gf3d_collision.sBody[j]);
+        }
+#endif
+    }
+}
+
+static void gf3d_collision_narrow_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    Uint32 epaRuns = 0;
+    CollisionPairEntry *pair;
+    for (; first < last; first++)
+    {
+        pair = &gf3d_collision.pairs[first];
+        pair->touching = gf3d_collision_contact(
+            &gf3d_collision.poses[pair->bodyA],&gf3d_collision.poses[pair->bodyB],&pair->direction,&pair->contact,&epaRuns);
+    }
+    if (epaRuns)SDL_AtomicAdd(&gf3d_collision.epaRuns,epaRuns);
+}
+
+/**
+ * @brief drop removed bodies from the sorted list
+ */
+static void gf3d_collision_compact()
+{
+    int i;
+    Uint32 kept = 0;
+    if (!gf3d_collision.removedCount)return;
+    for (i = 0; i < gf3d_collision.sortedCount; i++)
+    {
+        if (gf3d_collision.state[gf3d_collision.sorted[i].body] != BS_Alive)continue;
+        gf3d_collision.sorted[kept++] = gf3d_collision.sorted[i];
+    }
+    gf3d_collision.sortedCount = kept;
+}
+
+/**
+ * @brief add an ended pair to the list for this update
+ */
+static void gf3d_collision_end_pair(CollisionPairEntry *pair)
+{
+    if (!gf3d_collision_reserve((void **)&gf3d_collision.ended,&gf3d_collision.endedMax,gf3d_collision.endedCount + 1,sizeof(CollisionPair)))return;
+    gf3d_collision.ended[gf3d_collision.endedCount].bodyA = pair->bodyA;
+    gf3d_collision.ended[gf3d_collision.endedCount].bodyB = pair->bodyB;
+    gf3d_collision.endedCount++;
+}
+
+void gf3d_collision_update()
+{
+    int i,j;
+    Uint32 count;
+    Uint64 start;
+    CollisionPairEntry *pair;
+    CollisionPairBuffer *buffer;
+
+    if (!gf3d_collision.initialized)return;
+    GF3D_TRACE_BEGIN("collision broadphase");
+    start = SDL_GetPerformanceCounter();
+    gf3d_collision.frame++;
+    gf3d_collision.contactCount = 0;
+    gf3d_collision.endedCount = 0;
+    gf3d_collision_compact();
+    count = gf3d_collision.sortedCount;
+
+    for (i = 0; i < GF3D_JOBS_MAX_THREADS; i++)
+    {
+        gf3d_collision.ranges[i].minZ = FLT_MAX;
+        gf3d_collision.ranges[i].maxZ = -FLT_MAX;
+        gf3d_collision.ranges[i].depth = 0;
+        gf3d_collision.buffers[i].count = 0;
+    }
+    gf3d_jobs_parallel_for(count,GF3D_COLLISION_BOUNDS_BATCH,gf3d_collision_bounds_run,NULL);
+    gf3d_collision_sort();
+    gf3d_collision_bands_choose(count);
+    if (gf3d_collision_gather(count))
+    {
+        gf3d_jobs_parallel_for(gf3d_collision.slotCount,GF3D_COLLISION_SWEEP_BATCH,gf3d_collision_sweep_run,NULL);
+    }
+
+    // every pair the sweep found is marked with this frame, the rest stopped overlapping
+    for (i = 0; i < GF3D_JOBS_MAX_THREADS; i++)
+    {
+        buffer = &gf3d_collision.buffers[i];
+        for (j = 0; j < buffer->count; j++)
+        {
+            gf3d_collision_pair_touch(buffer->keys[j]);
+        }
+    }
+    for (i = 0; i < gf3d_collision.pairCount;)
+    {
+        pair = &gf3d_collision.pairs[i];
+        if (pair->frame == gf3d_collision.frame)
+        {
+            i++;
+            continue;
+        }
+        if (pair->wasTouching)gf3d_collision_end_pair(pair);
+        gf3d_collision_pair_remove(i);
+    }
+    gf3d_collision.stats.broadphaseMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    GF3D_TRACE_END();
+
+    GF3D_TRACE_BEGIN("collision narrowphase");
+    start = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&gf3d_collision.epaRuns,0);
+    gf3d_jobs_parallel_for(gf3d_collision.pairCount,GF3D_COLLISION_PAIR_BATCH,gf3d_collision_narrow_run,NULL);
+    for (i = 0; i < gf3d_collision.pairCount; i++)
+    {
+        pair = &gf3d_collision.pairs[i];
+        if (pair->touching)
+        {
+            if (gf3d_collision_reserve((void **)&gf3d_collision.contacts,&gf3d_collision.contactMax,gf3d_collision.contactCount + 1,sizeof(CollisionContact)))
+            {
+                pair->contact.bodyA = pair->bodyA;
+                pair->contact.bodyB = pair->bodyB;
+                pair->contact.began = !pair->wasTouching;
+                gf3d_collision.contacts[gf3d_collision.contactCount++] = pair->contact;
+            }
+        }
+        else if (pair->wasTouching)gf3d_collision_end_pair(pair);
+        pair->wasTouching = pair->touching;
+    }
+    // removed bodies' pairs have ended, their ids can be handed out again
+    for (i = 0; i < gf3d_collision.removedCount; i++)
+    {
+        gf3d_collision.state[gf3d_collision.removedIds[i]] = BS_Free;
+        gf3d_collision.freeIds[gf3d_collision.freeCount++] = gf3d_collision.removedIds[i];
+    }
+    gf3d_collision.removedCount = 0;
+
+    gf3d_collision.stats.bodies = gf3d_collision.bodyCount;
+    gf3d_collision.stats.pairs = gf3d_collision.pairCount;
+    gf3d_collision.stats.contacts = gf3d_collision.contactCount;
+    gf3d_collision.stats.bands = gf3d_collision.bandCount;
+    gf3d_collision.stats.epaRuns = SDL_AtomicGet(&gf3d_collision.epaRuns);
+    gf3d_collision.stats.narrowphaseMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    GF3D_TRACE_END();
+}
+
+const CollisionContact *gf3d_collision_get_contacts(Uint32 *count)
+{
+    if (count)*count = gf3d_collision.contactCount;
+    return gf3d_collision.contacts;
+}
+
+const CollisionPair *gf3d_collision_get_ended(Uint32 *count)
+{
+    if (count)*count = gf3d_collision.endedCount;
+    return gf3d_collision.ended;
+}
+
+void gf3d_collision_get_stats(CollisionStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_collision.stats,sizeof(CollisionStats));
+}
+
+/*eol@eof*/
@@ -1,6 +1,12 @@
 #include "gf3d_commands.h"
 #include "gf3d_vqueues.h"
 #include "gf3d_swapchain.h"
+#include "gf3d_uniforms.h"
+#include "gf3d_batch.h"
+#include "gf3d_indirect.h"
+#include "gf3d_render_queue.h"
+#include "gf3d_render_graph.h"
+#include "gf3d_memory.h"
 #include "simple_logger.h"
 
 #include <string.h>
@@ -11,14 +17,23 @@ typedef struct
     VkCommandBuffer    *commandBuffers;
     Uint32              commandBufferCount;
     VkDevice            device;
+    Sint32              swapImage;      /**<render graph resources of the frame graph*/
+    Sint32              depthImage;
+    Sint32              indirectBuffer;
+    Pipeline           *pipe;           /**<what the frame being recorded draws with*/
+    VkFramebuffer       framebuffer;
+    Uint32              frame;
+    Bool                customViewport; /**<if false the viewport and scissor cover the whole swap image*/
+    VkViewport          viewport;
+    VkRect2D            scissor;
 }Commands;
 
 static Commands gf3d_commands = {0};
 
 void gf3d_command_pool_close();
-void gf3d_command_buffer_begin(Pipeline *pipe);
+void gf3d_command_frame_graph_setup();
 
-void gf3d_command_pool_setup(VkDevice device,Uint32 count,Pipeline *pipe)
+void gf3d_command_pool_setup(VkDevice device,Uint32 count)
 {
     VkCommandPoolCreateInfo poolInfo = {0};
     VkCommandBufferAllocateInfo allocInfo = {0};
@@ -26,7 +41,7 @@ void gf3d_command_pool_setup(VkDevice device,Uint32 count,Pipeline *pipe)
     gf3d_commands.device = device;
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = gf3d_vqueues_get_graphics_queue_family();
-    poolInfo.flags = 0; // Optional    
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;   // buffers are re-recorded every frame
     
     if (vkCreateCommandPool(device, &poolInfo, NULL, &gf3d_commands.commandPool) != VK_SUCCESS)
     {
@@ -34,7 +49,7 @@ void gf3d_command_pool_setup(VkDevice device,Uint32 count,Pipeline *pipe)
         return;
     }
     
-    gf3d_commands.commandBuffers = (VkCommandBuffer*)gf3d_allocate_array(sizeof(VkCommandBuffer),count);
+    gf3d_commands.commandBuffers = (VkCommandBuffer*)gf3d_memory_allocate(MT_Graphics,sizeof(VkCommandBuffer),count);
     if (!gf3d_commands.commandBuffers)
     {
         slog("failed to allocate command buffer array");
@@ -55,9 +70,8 @@ void gf3d_command_pool_setup(VkDevice device,Uint32 count,Pipeline *pipe)
         return;
     }
     
-    gf3d_command_buffer_begin(pipe);
-    
     slog("created command buffers");
+    gf3d_command_frame_graph_setup();
     atexit(gf3d_command_pool_close);
 }
 
@@ -65,67 +79,199 @@ void gf3d_command_pool_close()
 {
     if (gf3d_commands.commandBuffers)
     {
-        free(gf3d_commands.commandBuffers);
+        gf3d_memory_free(gf3d_commands.commandBuffers);
     }
     vkDestroyCommandPool(gf3d_commands.device, gf3d_commands.commandPool, NULL);
     memset(&gf3d_commands,0,sizeof(Commands));
 }
 
-void gf3d_command_execute_render_pass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,VkFramebuffer framebuffer,VkPipeline graphicsPipeline)
+void gf3d_command_set_viewport(const VkViewport *viewport,const VkRect2D *scissor)
 {
-    VkClearValue clearColor = {0};
-    VkRenderPassBeginInfo renderPassInfo = {0};
-    VkCommandBufferBeginInfo beginInfo = {0};
-    
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    beginInfo.pInheritanceInfo = NULL; // Optional
+    VkExtent2D extent;
+    if (!viewport)
+    {
+        gf3d_commands.customViewport = false;
+        return;
+    }
+    gf3d_commands.viewport = *viewport;
+    if (scissor)
+    {
+        gf3d_commands.scissor = *scissor;
+    }
+    else
+    {
+        gf3d_commands.scissor.offset.x = (Sint32)MAX(0,viewport->x);
+        gf3d_commands.scissor.offset.y = (Sint32)MAX(0,viewport->y);
+        gf3d_commands.scissor.extent.width = (Uint32)MAX(0,viewport->width);
+        gf3d_commands.scissor.extent.height = (Uint32)MAX(0,viewport->height);
+    }
+    // a scissor reaching past the framebuffer is invalid, so keep it inside the swap image
+    extent = gf3d_swapchain_get_extent();
+    gf3d_commands.scissor.offset.x = MAX(0,gf3d_commands.scissor.offset.x);
+    gf3d_commands.scissor.offset.y = MAX(0,gf3d_commands.scissor.offset.y);
+    gf3d_commands.scissor.offset.x = MIN(gf3d_commands.scissor.offset.x,extent.width);
+    gf3d_commands.scissor.offset.y = MIN(gf3d_commands.scissor.offset.y,extent.height);
+    gf3d_commands.scissor.extent.width = MIN(gf3d_commands.scissor.extent.width,extent.width - gf3d_commands.scissor.offset.x);
+    gf3d_commands.scissor.extent.height = MIN(gf3d_commands.scissor.extent.height,extent.height - gf3d_commands.scissor.offset.y);
+    gf3d_commands.customViewport = true;
+}
 
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+void gf3d_command_viewport_bind(VkCommandBuffer commandBuffer)
+{
+    VkViewport viewport = {0};
+    VkRect2D scissor = {0};
+    VkExtent2D extent;
+
+    if (gf3d_commands.customViewport)
     {
-        slog("failed to begin recording command buffer!");
+        vkCmdSetViewport(commandBuffer, 0, 1, &gf3d_commands.viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &gf3d_commands.scissor);
+        return;
     }
-    
-    clearColor.color.float32[3] = 1.0;
+    extent = gf3d_swapchain_get_extent();
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    scissor.extent = extent;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void gf3d_command_cull_pass(VkCommandBuffer commandBuffer,Sint32 pass,void *userData)
+{
+    gf3d_indirect_cull(commandBuffer, gf3d_commands.frame);
+}
+
+void gf3d_command_main_pass(VkCommandBuffer commandBuffer,Sint32 pass,void *userData)
+{
+    VkClearValue clearValues[2] = {0};
+    VkRenderPassBeginInfo renderPassInfo = {0};
+    Pipeline *pipe = gf3d_commands.pipe;
+    Uint32 frame = gf3d_commands.frame;
+
+    clearValues[0].color.float32[3] = 1.0;
+    clearValues[1].depthStencil.depth = 1.0;
+    clearValues[1].depthStencil.stencil = 0;
     
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderPass = pipe->renderPass;
+    renderPassInfo.framebuffer = gf3d_commands.framebuffer;
     renderPassInfo.renderArea.offset.x = 0;
     renderPassInfo.renderArea.offset.y = 0;
     renderPassInfo.renderArea.extent = gf3d_swapchain_get_extent();
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
     
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    // every graphics pipeline takes these as dynamic state, and binding a pipeline keeps them
+    gf3d_command_viewport_bind(commandBuffer);
+    if (gf3d_pipeline_get_depth_prepass())
+    {
+        // lay down depth for all opaque geometry first so the draws below only shade visible fragments
+        if (pipe->depthPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->depthPipeline);
+            gf3d_uniforms_bind(commandBuffer, pipe->pipelineLayout, frame, 0);
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
+        gf3d_batch_draw_depth(commandBuffer, frame);
+        gf3d_indirect_draw_depth(commandBuffer, frame);
+        gf3d_render_queue_draw_depth(commandBuffer, frame);
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->graphicsPipeline);
+    gf3d_uniforms_bind(commandBuffer, pipe->pipelineLayout, frame, 0);
     //vertexCount: Even though we don't have a vertex buffer, we technically still have 3 vertices to draw.
     //instanceCount: Used for instanced rendering, use 1 if you're not doing that.
     //firstVertex: Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
     //firstInstance: Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
     vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    gf3d_batch_draw(commandBuffer, frame);
+    gf3d_indirect_draw(commandBuffer, frame);
+    gf3d_render_queue_draw(commandBuffer, frame);
     vkCmdEndRenderPass(commandBuffer);
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+}
+
+/**
+ * @brief declare the frame: a compute cull pass feeding the indirect draws of the main pass, which renders to the swap image
+ * @note the graph works out the barrier between them and the layout transitions of both attachments, ending in PRESENT
+ */
+void gf3d_command_frame_graph_setup()
+{
+    Sint32 cull,scene;
+
+    gf3d_render_graph_reset();
+    // the image acquire semaphore is waited on at the color attachment stage, so the first transition has to wait there too
+    gf3d_commands.swapImage = gf3d_render_graph_import_image(
+        "swap image",
+        gf3d_swapchain_get_format(),
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    gf3d_commands.depthImage = gf3d_render_graph_import_image(
+        "depth",
+        gf3d_swapchain_get_depth_format(),
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED);
+    gf3d_commands.indirectBuffer = gf3d_render_graph_import_buffer("indirect draws");
+    gf3d_render_graph_set_output(gf3d_commands.swapImage);
+
+    // compute work has to be recorded outside of the render pass
+    cull = gf3d_render_graph_add_pass("indirect cull",gf3d_command_cull_pass,NULL);
+    gf3d_render_graph_write(cull,gf3d_commands.indirectBuffer,RGU_Compute);
+
+    scene = gf3d_render_graph_add_pass("main",gf3d_command_main_pass,NULL);
+    gf3d_render_graph_read(scene,gf3d_commands.indirectBuffer,RGU_Indirect);
+    gf3d_render_graph_read(scene,gf3d_commands.indirectBuffer,RGU_Vertex);
+    gf3d_render_graph_write(scene,gf3d_commands.depthImage,RGU_DepthAttachment);
+    gf3d_render_graph_write(scene,gf3d_commands.swapImage,RGU_ColorAttachment);
+
+    if (!gf3d_render_graph_compile())
     {
-        slog("failed to record command buffer!");
+        slog("failed to compile the frame render graph");
     }
-    else
+}
+
+void gf3d_command_execute_render_pass(VkCommandBuffer commandBuffer, Pipeline *pipe,VkFramebuffer framebuffer,Uint32 frame)
+{
+    VkCommandBufferBeginInfo beginInfo = {0};
+    
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = NULL; // Optional
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        slog("failed to begin recording command buffer!");
+    }
+    
+    gf3d_commands.pipe = pipe;
+    gf3d_commands.framebuffer = framebuffer;
+    gf3d_commands.frame = frame;
+    gf3d_render_graph_set_image(gf3d_commands.swapImage,gf3d_swapchain_get_image_by_index(frame),VK_NULL_HANDLE);
+    gf3d_render_graph_set_image(gf3d_commands.depthImage,gf3d_swapchain_get_depth_image_by_index(frame),VK_NULL_HANDLE);
+    gf3d_render_graph_execute(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
     {
-        slog("created renderpass command");
+        slog("failed to record command buffer!");
     }
 }
 
-void gf3d_command_buffer_begin(Pipeline *pipe)
+void gf3d_command_buffer_record(Uint32 index,Pipeline *pipe)
 {
-    size_t i = 0;
-    for (i = 0; i < gf3d_commands.commandBufferCount; i++)
+    if (index >= gf3d_commands.commandBufferCount)
     {
-        gf3d_command_execute_render_pass(
-            gf3d_commands.commandBuffers[i], 
-            pipe->renderPass,
-            gf3d_swapchain_get_frame_buffer_by_index(i),
-            pipe->graphicsPipeline);
+        slog("cannot record command buffer %i, exceeds count",index);
+        return;
     }
+    if (!pipe)return;
+    gf3d_command_execute_render_pass(
+        gf3d_commands.commandBuffers[index], 
+        pipe,
+        gf3d_swapchain_get_frame_buffer_by_index(index),
+        index);
 }
 
 VkCommandBuffer * gf3d_command_buffer_get_by_index(Uint32 index)
@@ -0,0 +1,514 @@
+#include "gf3d_cull.h"
+
+#include <SDL.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "gf3d_camera.h"
+#include "gf3d_jobs.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GF3D_CULL_SSE
+#define GF3D_CULL_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(GF3D_CULL_AVX)
+#include <intrin.h>
+#define GF3D_CULL_TARGET_AVX
+#elif defined(GF3D_CULL_AVX)
+#define GF3D_CULL_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+#define GF3D_CULL_MIN_PER_THREAD 4096  // below this, handing a range to another thread costs more than it saves
+
+typedef struct
+{
+    Uint32          first;          /**<first dense index of the range*/
+    Uint32          last;           /**<one past the last dense index*/
+    Uint32          visibleCount;   /**<results are written to the output starting at first*/
+}CullRange;
+
+typedef struct
+{
+    Uint32          maxObjects;
+    Uint32          objectCount;    /**<dense, the first objectCount entries of every array are live*/
+    float          *sphereX;
+    float          *sphereY;
+    float          *sphereZ;
+    float          *sphereR;
+    float          *boxX;           /**<box center*/
+    float          *boxY;
+    float          *boxZ;
+    float          *boxEX;          /**<box half extents*/
+    float          *boxEY;
+    float          *boxEZ;
+    Sint32         *denseIndex;     /**<by object id: dense index, -1 when free*/
+    Uint32         *objectId;       /**<by dense index: object id*/
+    Uint32         *freeIds;        /**<stack of unused object ids*/
+    Uint32          freeCount;
+    Bool            hasAVX;
+    CullRange       ranges[GF3D_JOBS_MAX_THREADS];
+    const Frustum  *frustum;        /**<the request the jobs are running*/
+    CullMode        mode;
+    Uint32         *visible;
+    CullStats       stats;
+}CullManager;
+
+static CullManager gf3d_cull = {0};
+
+void gf3d_cull_close();
+
+/**
+ * FRUSTUM
+ */
+
+void gf3d_cull_frustum_from_matrix(Frustum *frustum,Matrix4 viewProj)
+{
+    int i;
+    int axis;
+    float sign;
+    float length;
+    Vector4D *plane;
+
+    if (!frustum)return;
+    // row vector convention: clip space coordinate j is the dot product with column j, w is column 3
+    for (i = 0; i < 6; i++)
+    {
+        plane = &frustum->planes[i];
+        axis = i / 2;
+        sign = (i % 2)?-1:1;
+        plane->x = viewProj[0][3] + sign * viewProj[0][axis];
+        plane->y = viewProj[1][3] + sign * viewProj[1][axis];
+        plane->z = viewProj[2][3] + sign * viewProj[2][axis];
+        plane->w = viewProj[3][3] + sign * viewProj[3][axis];
+        length = sqrt(plane->x * plane->x + plane->y * plane->y + plane->z * plane->z);
+        if (length == 0)continue;
+        plane->x /= length;
+        plane->y /= length;
+        plane->z /= length;
+        plane->w /= length;
+    }
+}
+
+void gf3d_cull_frustum_from_camera(Frustum *frustum,Matrix4 proj)
+{
+    Matrix4 view;
+    Matrix4 viewProj;
+    if ((!frustum)||(!proj))return;
+    gf3d_camera_get_view(&view);
+    gf3d_matrix_multiply(viewProj,proj,view);
+    gf3d_cull_frustum_from_matrix(frustum,viewProj);
+}
+
+/**
+ * SETUP
+ */
+
+Bool gf3d_cull_cpu_has_avx()
+{
+#if defined(_MSC_VER) && defined(GF3D_CULL_AVX)
+    int info[4];
+    __cpuid(info,1);
+    // the CPU must support AVX and the OS must save the YMM registers
+    if (!((info[2] & (1 << 27)) && (info[2] & (1 << 28))))return false;
+    return ((_xgetbv(0) & 6) == 6);
+#elif defined(GF3D_CULL_AVX)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+void gf3d_cull_init(Uint32 maxObjects)
+{
+    int i;
+    float **arrays[10];
+
+    if (!maxObjects)
+    {
+        slog("cannot initialize culling for zero objects");
+        return;
+    }
+    arrays[0] = &gf3d_cull.sphereX;
+    arrays[1] = &gf3d_cull.sphereY;
+    arrays[2] = &gf3d_cull.sphereZ;
+    arrays[3] = &gf3d_cull.sphereR;
+    arrays[4] = &gf3d_cull.boxX;
+    arrays[5] = &gf3d_cull.boxY;
+    arrays[6] = &gf3d_cull.boxZ;
+    arrays[7] = &gf3d_cull.boxEX;
+    arrays[8] = &gf3d_cull.boxEY;
+    arrays[9] = &gf3d_cull.boxEZ;
+    atexit(gf3d_cull_close);
+    for (i = 0; i < 10; i++)
+    {
+        *arrays[i] = (float *)gf3d_memory_allocate(MT_Scene,sizeof(float),maxObjects);
+        if (!*arrays[i])
+        {
+            slog("failed to allocate culling volumes");
+            gf3d_cull_close();
+            return;
+        }
+    }
+    gf3d_cull.denseIndex = (Sint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Sint32),maxObjects);
+    gf3d_cull.objectId = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxObjects);
+    gf3d_cull.freeIds = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxObjects);
+    if ((!gf3d_cull.denseIndex)||(!gf3d_cull.objectId)||(!gf3d_cull.freeIds))
+    {
+        slog("failed to allocate culling object lists");
+        gf3d_cull_close();
+        return;
+    }
+    for (i = 0; i < maxObjects; i++)
+    {
+        gf3d_cull.denseIndex[i] = -1;
+        gf3d_cull.freeIds[i] = maxObjects - 1 - i;
+    }
+    gf3d_cull.freeCount = maxObjects;
+    gf3d_cull.maxObjects = maxObjects;
+    gf3d_cull.hasAVX = gf3d_cull_cpu_has_avx();
+
+    slog("culling initialized for %i objects, avx: %i",maxObjects,gf3d_cull.hasAVX);
+}
+
+void gf3d_cull_close()
+{
+    int i;
+    float *arrays[10];
+
+    arrays[0] = gf3d_cull.sphereX;
+    arrays[1] = gf3d_cull.sphereY;
+    arrays[2] = gf3d_cull.sphereZ;
+    arrays[3] = gf3d_cull.sphereR;
+    arrays[4] = gf3d_cull.boxX;
+    arrays[5] = gf3d_cull.boxY;
+    arrays[6] = gf3d_cull.boxZ;
+    arrays[7] = gf3d_cull.boxEX;
+    arrays[8] = gf3d_cull.boxEY;
+    arrays[9] = gf3d_cull.boxEZ;
+    for (i = 0; i < 10; i++)
+    {
+        if (arrays[i])gf3d_memory_free(arrays[i]);
+    }
+    if (gf3d_cull.denseIndex)gf3d_memory_free(gf3d_cull.denseIndex);
+    if (gf3d_cull.objectId)gf3d_memory_free(gf3d_cull.objectId);
+    if (gf3d_cull.freeIds)gf3d_memory_free(gf3d_cull.freeIds);
+    memset(&gf3d_cull,0,sizeof(CullManager));
+}
+
+/**
+ * OBJECTS
+ */
+
+Sint32 gf3d_cull_object_new()
+{
+    int i;
+    Uint32 dense;
+    if (gf3d_cull.objectCount >= gf3d_cull.maxObjects)
+    {
+        slog("no free culling objects");
+        return -1;
+    }
+    i = gf3d_cull.freeIds[--gf3d_cull.freeCount];
+    dense = gf3d_cull.objectCount++;
+    gf3d_cull.denseIndex[i] = dense;
+    gf3d_cull.objectId[dense] = i;
+    gf3d_cull.sphereX[dense] = gf3d_cull.sphereY[dense] = gf3d_cull.sphereZ[dense] = gf3d_cull.sphereR[dense] = 0;
+    gf3d_cull.boxX[dense] = gf3d_cull.boxY[dense] = gf3d_cull.boxZ[dense] = 0;
+    gf3d_cull.boxEX[dense] = gf3d_cull.boxEY[dense] = gf3d_cull.boxEZ[dense] = 0;
+    return i;
+}
+
+void gf3d_cull_object_free(Sint32 object)
+{
+    Uint32 dense,last;
+    if ((object < 0)||(object >= gf3d_cull.maxObjects))return;
+    if (gf3d_cull.denseIndex[object] < 0)return;
+    dense = gf3d_cull.denseIndex[object];
+    gf3d_cull.denseIndex[object] = -1;
+    gf3d_cull.freeIds[gf3d_cull.freeCount++] = object;
+    // move the last object into the hole so the arrays stay packed
+    last = --gf3d_cull.objectCount;
+    if (dense == last)return;
+    gf3d_cull.sphereX[dense] = gf3d_cull.sphereX[last];
+    gf3d_cull.sphereY[dense] = gf3d_cull.sphereY[last];
+    gf3d_cull.sphereZ[dense] = gf3d_cull.sphereZ[last];
+    gf3d_cull.sphereR[dense] = gf3d_cull.sphereR[last];
+    gf3d_cull.boxX[dense] = gf3d_cull.boxX[last];
+    gf3d_cull.boxY[dense] = gf3d_cull.boxY[last];
+    gf3d_cull.boxZ[dense] = gf3d_cull.boxZ[last];
+    gf3d_cull.boxEX[dense] = gf3d_cull.boxEX[last];
+    gf3d_cull.boxEY[dense] = gf3d_cull.boxEY[last];
+    gf3d_cull.boxEZ[dense] = gf3d_cull.boxEZ[last];
+    gf3d_cull.objectId[dense] = gf3d_cull.objectId[last];
+    gf3d_cull.denseIndex[gf3d_cull.objectId[dense]] = dense;
+}
+
+void gf3d_cull_object_set_sphere(Sint32 object,Vector3D center,float radius)
+{
+    Uint32 dense;
+    if ((object < 0)||(object >= gf3d_cull.maxObjects))return;
+    if (gf3d_cull.denseIndex[object] < 0)return;
+    dense = gf3d_cull.denseIndex[object];
+    gf3d_cull.sphereX[dense] = center.x;
+    gf3d_cull.sphereY[dense] = center.y;
+    gf3d_cull.sphereZ[dense] = center.z;
+    gf3d_cull.sphereR[dense] = radius;
+}
+
+void gf3d_cull_object_set_aabb(Sint32 object,Vector3D min,Vector3D max)
+{
+    Uint32 dense;
+    if ((object < 0)||(object >= gf3d_cull.maxObjects))return;
+    if (gf3d_cull.denseIndex[object] < 0)return;
+    dense = gf3d_cull.denseIndex[object];
+    // stored as center and half extents, the form the plane test wants
+    gf3d_cull.boxX[dense] = (min.x + max.x) * 0.5;
+    gf3d_cull.boxY[dense] = (min.y + max.y) * 0.5;
+    gf3d_cull.boxZ[dense] = (min.z + max.z) * 0.5;
+    gf3d_cull.boxEX[dense] = (max.x - min.x) * 0.5;
+    gf3d_cull.boxEY[dense] = (max.y - min.y) * 0.5;
+    gf3d_cull.boxEZ[dense] = (max.z - min.z) * 0.5;
+}
+
+/**
+ * TESTS
+ * each test covers dense indices [first,last) and writes the ids of visible objects to out
+ */
+
+Uint32 gf3d_cull_range_scalar(const Frustum *frustum,Uint32 first,Uint32 last,Uint32 *out)
+{
+    int i,p;
+    Uint32 count = 0;
+    float d,r;
+    const Vector4D *plane;
+
+    for (i = first; i < last; i++)
+    {
+        for (p = 0; p < 6; p++)
+        {
+            plane = &frustum->planes[p];
+            d = plane->x * gf3d_cull.sphereX[i] + plane->y * gf3d_cull.sphereY[i] + plane->z * gf3d_cull.sphereZ[i] + plane->w;
+            if (d < -gf3d_cull.sphereR[i])break;
+            d = plane->x * gf3d_cull.boxX[i] + plane->y * gf3d_cull.boxY[i] + plane->z * gf3d_cull.boxZ[i] + plane->w;
+            r = fabs(plane->x) * gf3d_cull.boxEX[i] + fabs(plane->y) * gf3d_cull.boxEY[i] + fabs(plane->z) * gf3d_cull.boxEZ[i];
+            if (d < -r)break;
+        }
+        if (p == 6)out[count++] = gf3d_cull.objectId[i];
+    }
+    return count;
+}
+
+#ifdef GF3D_CULL_SSE
+Uint32 gf3d_cull_range_sse(const Frustum *frustum,Uint32 first,Uint32 last,Uint32 *out)
+{
+    int i,p,lane,bits;
+    Uint32 count = 0;
+    __m128 sx,sy,sz,sr,bx,by,bz,ex,ey,ez;
+    __m128 nx,ny,nz,nw,ax,ay,az;
+    __m128 d,r,mask;
+    __m128 signMask = _mm_set1_ps(-0.0f);
+
+    for (i = first; i + 4 <= last; i += 4)
+    {
+        sx = _mm_loadu_ps(&gf3d_cull.sphereX[i]);
+        sy = _mm_loadu_ps(&gf3d_cull.sphereY[i]);
+        sz = _mm_loadu_ps(&gf3d_cull.sphereZ[i]);
+        sr = _mm_loadu_ps(&gf3d_cull.sphereR[i]);
+        bx = _mm_loadu_ps(&gf3d_cull.boxX[i]);
+        by = _mm_loadu_ps(&gf3d_cull.boxY[i]);
+        bz = _mm_loadu_ps(&gf3d_cull.boxZ[i]);
+        ex = _mm_loadu_ps(&gf3d_cull.boxEX[i]);
+        ey = _mm_loadu_ps(&gf3d_cull.boxEY[i]);
+        ez = _mm_loadu_ps(&gf3d_cull.boxEZ[i]);
+        mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (p = 0; p < 6; p++)
+        {
+            nx = _mm_set1_ps(frustum->planes[p].x);
+            ny = _mm_set1_ps(frustum->planes[p].y);
+            nz = _mm_set1_ps(frustum->planes[p].z);
+            nw = _mm_set1_ps(frustum->planes[p].w);
+            ax = _mm_andnot_ps(signMask,nx);
+            ay = _mm_andnot_ps(signMask,ny);
+            az = _mm_andnot_ps(signMask,nz);
+
+            d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx,sx),_mm_mul_ps(ny,sy)),_mm_add_ps(_mm_mul_ps(nz,sz),nw));
+            mask = _mm_and_ps(mask,_mm_cmpge_ps(d,_mm_xor_ps(sr,signMask)));
+
+            d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx,bx),_mm_mul_ps(ny,by)),_mm_add_ps(_mm_mul_ps(nz,bz),nw));
+            r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax,ex),_mm_mul_ps(ay,ey)),_mm_mul_ps(az,ez));
+            mask = _mm_and_ps(mask,_mm_cmpge_ps(d,_mm_xor_ps(r,signMask)));
+        }
+        bits = _mm_movemask_ps(mask);
+        for (lane = 0; bits; lane++, bits >>= 1)
+        {
+            if (bits & 1)out[count++] = gf3d_cull.objectId[i + lane];
+        }
+    }
+    if (i < last)count += gf3d_cull_range_scalar(frustum,i,last,&out[count]);
+    return count;
+}
+#endif
+
+#ifdef GF3D_CULL_AVX
+GF3D_CULL_TARGET_AVX Uint32 gf3d_cull_range_avx(const Frustum *frustum,Uint32 first,Uint32 last,Uint32 *out)
+{
+    int i,p,lane,bits;
+    Uint32 count = 0;
+    __m256 sx,sy,sz,sr,bx,by,bz,ex,ey,ez;
+    __m256 nx,ny,nz,nw,ax,ay,az;
+    __m256 d,r,mask;
+    __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    for (i = first; i + 8 <= last; i += 8)
+    {
+        sx = _mm256_loadu_ps(&gf3d_cull.sphereX[i]);
+        sy = _mm256_loadu_ps(&gf3d_cull.sphereY[i]);
+        sz = _mm256_loadu_ps(&gf3d_cull.sphereZ[i]);
+        sr = _mm256_loadu_ps(&gf3d_cull.sphereR[i]);
+        bx = _mm256_loadu_ps(&gf3d_cull.boxX[i]);
+        by = _mm256_loadu_ps(&gf3d_cull.boxY[i]);
+        bz = _mm256_loadu_ps(&gf3d_cull.boxZ[i]);
+        ex = _mm256_loadu_ps(&gf3d_cull.boxEX[i]);
+        ey = _mm256_loadu_ps(&gf3d_cull.boxEY[i]);
+        ez = _mm256_loadu_ps(&gf3d_cull.boxEZ[i]);
+        mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (p = 0; p < 6; p++)
+        {
+            nx = _mm256_set1_ps(frustum->planes[p].x);
+            ny = _mm256_set1_ps(frustum->planes[p].y);
+            nz = _mm256_set1_ps(frustum->planes[p].z);
+            nw = _mm256_set1_ps(frustum->planes[p].w);
+            ax = _mm256_andnot_ps(signMask,nx);
+            ay = _mm256_andnot_ps(signMask,ny);
+            az = _mm256_andnot_ps(signMask,nz);
+
+            d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx,sx),_mm256_mul_ps(ny,sy)),_mm256_add_ps(_mm256_mul_ps(nz,sz),nw));
+            mask = _mm256_and_ps(mask,_mm256_cmp_ps(d,_mm256_xor_ps(sr,signMask),_CMP_GE_OQ));
+
+            d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx,bx),_mm256_mul_ps(ny,by)),_mm256_add_ps(_mm256_mul_ps(nz,bz),nw));
+            r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax,ex),_mm256_mul_ps(ay,ey)),_mm256_mul_ps(az,ez));
+            mask = _mm256_and_ps(mask,_mm256_cmp_ps(d,_mm256_xor_ps(r,signMask),_CMP_GE_OQ));
+        }
+        bits = _mm256_movemask_ps(mask);
+        for (lane = 0; bits; lane++, bits >>= 1)
+        {
+            if (bits & 1)out[count++] = gf3d_cull.objectId[i + lane];
+        }
+    }
+    if (i < last)count += gf3d_cull_range_scalar(frustum,i,last,&out[count]);
+    return count;
+}
+#endif
+
+Uint32 gf3d_cull_range(const Frustum *frustum,CullMode mode,Uint32 first,Uint32 last,Uint32 *out)
+{
+    switch (mode)
+    {
+#ifdef GF3D_CULL_AVX
+        case CM_AVX:
+            return gf3d_cull_range_avx(frustum,first,last,out);
+#endif
+#ifdef GF3D_CULL_SSE
+        case CM_SSE:
+            return gf3d_cull_range_sse(frustum,first,last,out);
+#endif
+        default:
+            return gf3d_cull_range_scalar(frustum,first,last,out);
+    }
+}
+
+CullMode gf3d_cull_resolve_mode(CullMode mode)
+{
+    // step down to the widest instruction set that is actually available
+    if ((mode == CM_Auto)||(mode == CM_AVX))
+    {
+#ifdef GF3D_CULL_AVX
+        if (gf3d_cull.hasAVX)return CM_AVX;
+#endif
+        mode = CM_SSE;
+    }
+    if (mode == CM_SSE)
+    {
+#ifdef GF3D_CULL_SSE
+        return CM_SSE;
+#endif
+    }
+    return CM_Scalar;
+}
+
+/**
+ * JOBS
+ */
+
+static void gf3d_cull_job_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    CullRange *range;
+    for (; first < last; first++)
+    {
+        range = &gf3d_cull.ranges[first];
+        range->visibleCount = gf3d_cull_range(gf3d_cull.frustum,gf3d_cull.mode,range->first,range->last,&gf3d_cull.visible[range->first]);
+    }
+}
+
+Uint32 gf3d_cull_frustum(const Frustum *frustum,CullMode mode,Uint32 *visible)
+{
+    int i;
+    Uint32 jobs;
+    Uint32 chunk;
+    Uint32 count;
+    Uint64 start;
+    CullRange *range;
+
+    if ((!frustum)||(!visible))return 0;
+    start = SDL_GetPerformanceCounter();
+    mode = gf3d_cull_resolve_mode(mode);
+
+    // one range per thread at most; ranges are multiples of 8 so every lane stays full
+    jobs = gf3d_cull.objectCount / GF3D_CULL_MIN_PER_THREAD;
+    jobs = MAX(1,MIN(jobs,gf3d_jobs_get_thread_count()));
+    chunk = ((gf3d_cull.objectCount / jobs) + 7) & ~7;
+    for (i = 0; i < jobs; i++)
+    {
+        range = &gf3d_cull.ranges[i];
+        range->first = MIN(chunk * i,gf3d_cull.objectCount);
+        range->last = MIN(chunk * (i + 1),gf3d_cull.objectCount);
+        if (i == jobs - 1)range->last = gf3d_cull.objectCount;
+    }
+
+    gf3d_cull.frustum = frustum;
+    gf3d_cull.mode = mode;
+    gf3d_cull.visible = visible;
+    gf3d_jobs_parallel_for(jobs,1,gf3d_cull_job_run,NULL);
+    // each range was written at its own start, pack the results down behind the first
+    count = gf3d_cull.ranges[0].visibleCount;
+    for (i = 1; i < jobs; i++)
+    {
+        range = &gf3d_cull.ranges[i];
+        if (count != range->first)
+        {
+            memmove(&visible[count],&visible[range->first],sizeof(Uint32) * range->visibleCount);
+        }
+        count += range->visibleCount;
+    }
+
+    gf3d_cull.stats.tested = gf3d_cull.objectCount;
+    gf3d_cull.stats.visible = count;
+    gf3d_cull.stats.threads = jobs;
+    gf3d_cull.stats.mode = mode;
+    gf3d_cull.stats.cullMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    return count;
+}
+
+void gf3d_cull_get_stats(CullStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_cull.stats,sizeof(CullStats));
+}
+
+/*eol@eof*/
@@ -0,0 +1,470 @@
+#include "gf3d_descriptors.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "simple_logger.h"
+#include "gf3d_memory.h"
+
+#define GF3D_DESCRIPTORS_FNV_OFFSET 14695981039346656037ULL
+#define GF3D_DESCRIPTORS_FNV_PRIME  1099511628211ULL
+#define GF3D_DESCRIPTORS_LOCAL_WRITES 16
+
+typedef struct
+{
+    VkDescriptorType    type;
+    Uint32              perSet;     /**<descriptors of this type reserved per set in a pool*/
+}DescriptorPoolRatio;
+
+static const DescriptorPoolRatio gf3d_descriptors_pool_ratios[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,4},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,1},
+    {VK_DESCRIPTOR_TYPE_SAMPLER,1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,1}
+};
+
+#define GF3D_DESCRIPTORS_RATIO_COUNT (sizeof(gf3d_descriptors_pool_ratios)/sizeof(DescriptorPoolRatio))
+
+typedef struct
+{
+    VkDescriptorPool   *pools;
+    Uint32              poolCount;      /**<pools created for this list*/
+    Uint32              poolMax;        /**<size of the pools array*/
+    Uint32              current;        /**<the pool that allocations are coming from*/
+}DescriptorPoolList;
+
+typedef struct
+{
+    Uint64                  hash;
+    VkDescriptorSetLayout   layout;
+    DescriptorBinding      *bindings;
+    Uint32                  bindingCount;
+    VkDescriptorSet         set;            /**<VK_NULL_HANDLE marks an empty slot*/
+}DescriptorCacheEntry;
+
+typedef struct
+{
+    VkDevice                device;
+    Uint32                  setsPerPool;
+    Uint32                  frameCount;
+    Uint32                  currentFrame;
+    DescriptorPoolList     *framePools;     /**<one pool list per frame in flight*/
+    DescriptorPoolList      cachePools;     /**<pools for immutable sets, never reset*/
+    DescriptorCacheEntry   *cache;          /**<open addressed hash table*/
+    Uint32                  cacheSize;      /**<always a power of two*/
+    Uint32                  cacheCount;
+    DescriptorStats         stats;
+}DescriptorManager;
+
+static DescriptorManager gf3d_descriptors = {0};
+
+void gf3d_descriptors_close();
+void gf3d_descriptors_pool_list_close(DescriptorPoolList *list);
+Bool gf3d_descriptors_cache_resize(Uint32 size);
+
+void gf3d_descriptors_init(VkDevice device,Uint32 frameCount,Uint32 setsPerPool)
+{
+    if (!frameCount)
+    {
+        slog("cannot initialize descriptors for zero frames");
+        return;
+    }
+    if (!setsPerPool)
+    {
+        slog("cannot initialize descriptor pools with zero sets");
+        return;
+    }
+    gf3d_descriptors.framePools = (DescriptorPoolList *)gf3d_memory_allocate(MT_Descriptors,sizeof(DescriptorPoolList),frameCount);
+    if (!gf3d_descriptors.framePools)
+    {
+        slog("failed to allocate descriptor frame pools");
+        return;
+    }
+    gf3d_descriptors.device = device;
+    gf3d_descriptors.frameCount = frameCount;
+    gf3d_descriptors.setsPerPool = setsPerPool;
+    if (!gf3d_descriptors_cache_resize(64))
+    {
+        gf3d_descriptors_close();
+        return;
+    }
+    slog("descriptor manager initialized for %i frames",frameCount);
+    atexit(gf3d_descriptors_close);
+}
+
+void gf3d_descriptors_close()
+{
+    int i;
+    slog("cleaning up descriptors: %i sets allocated, %i cache hits, %i pool resets",
+         gf3d_descriptors.stats.setsAllocated,
+         gf3d_descriptors.stats.cacheHits,
+         gf3d_descriptors.stats.poolResets);
+    if (gf3d_descriptors.framePools)
+    {
+        for (i = 0; i < gf3d_descriptors.frameCount; i++)
+        {
+            gf3d_descriptors_pool_list_close(&gf3d_descriptors.framePools[i]);
+        }
+        gf3d_memory_free(gf3d_descriptors.framePools);
+    }
+    gf3d_descriptors_pool_list_close(&gf3d_descriptors.cachePools);
+    if (gf3d_descriptors.cache)
+    {
+        for (i = 0; i < gf3d_descriptors.cacheSize; i++)
+        {
+            if (gf3d_descriptors.cache[i].bindings)
+            {
+                gf3d_memory_free(gf3d_descriptors.cache[i].bindings);
+            }
+        }
+        gf3d_memory_free(gf3d_descriptors.cache);
+    }
+    memset(&gf3d_descriptors,0,sizeof(DescriptorManager));
+}
+
+/**
+ * POOL MANAGEMENT
+ */
+
+void gf3d_descriptors_pool_list_close(DescriptorPoolList *list)
+{
+    int i;
+    if (!list)return;
+    if (list->pools)
+    {
+        for (i = 0; i < list->poolCount; i++)
+        {
+            vkDestroyDescriptorPool(gf3d_descriptors.device, list->pools[i], NULL);
+        }
+        gf3d_memory_free(list->pools);
+    }
+    memset(list,0,sizeof(DescriptorPoolList));
+}
+
+VkDescriptorPool gf3d_descriptors_pool_create()
+{
+    int i;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorPoolSize poolSizes[GF3D_DESCRIPTORS_RATIO_COUNT];
+    VkDescriptorPoolCreateInfo poolInfo = {0};
+
+    for (i = 0; i < GF3D_DESCRIPTORS_RATIO_COUNT; i++)
+    {
+        poolSizes[i].type = gf3d_descriptors_pool_ratios[i].type;
+        poolSizes[i].descriptorCount = gf3d_descriptors_pool_ratios[i].perSet * gf3d_descriptors.setsPerPool;
+    }
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;     // sets are never freed individually, only by resetting the whole pool
+    poolInfo.maxSets = gf3d_descriptors.setsPerPool;
+    poolInfo.poolSizeCount = GF3D_DESCRIPTORS_RATIO_COUNT;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(gf3d_descriptors.device, &poolInfo, NULL, &pool) != VK_SUCCESS)
+    {
+        slog("failed to create descriptor pool");
+        return VK_NULL_HANDLE;
+    }
+    gf3d_descriptors.stats.poolsCreated++;
+    return pool;
+}
+
+/**
+ * @brief move the list on to its next pool, creating one if every existing pool has been used up
+ */
+Bool gf3d_descriptors_pool_list_advance(DescriptorPoolList *list)
+{
+    VkDescriptorPool *pools;
+    VkDescriptorPool pool;
+    Uint32 newMax;
+    if (list->current + 1 < list->poolCount)
+    {
+        list->current++;
+        return true;
+    }
+    pool = gf3d_descriptors_pool_create();
+    if (pool == VK_NULL_HANDLE)return false;
+    if (list->poolCount >= list->poolMax)
+    {
+        newMax = list->poolMax?list->poolMax * 2:4;
+        pools = (VkDescriptorPool *)gf3d_memory_allocate(MT_Descriptors,sizeof(VkDescriptorPool),newMax);
+        if (!pools)
+        {
+            vkDestroyDescriptorPool(gf3d_descriptors.device, pool, NULL);
+            return false;
+        }
+        if (list->pools)
+        {
+            memcpy(pools,list->pools,sizeof(VkDescriptorPool)*list->poolCount);
+            gf3d_memory_free(list->pools);
+        }
+        list->pools = pools;
+        list->poolMax = newMax;
+    }
+    list->pools[list->poolCount] = pool;
+    list->current = list->poolCount++;
+    return true;
+}
+
+VkDescriptorSet gf3d_descriptors_pool_list_allocate(DescriptorPoolList *list,VkDescriptorSetLayout layout)
+{
+    VkResult result;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+
+    if (!list->poolCount)
+    {
+        if (!gf3d_descriptors_pool_list_advance(list))return VK_NULL_HANDLE;
+    }
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    allocInfo.descriptorPool = list->pools[list->current];
+
+    result = vkAllocateDescriptorSets(gf3d_descriptors.device, &allocInfo, &set);
+    if ((result == VK_ERROR_OUT_OF_POOL_MEMORY)||(result == VK_ERROR_FRAGMENTED_POOL))
+    {
+        // this pool is full, grow on to the next one and try once more
+        if (!gf3d_descriptors_pool_list_advance(list))return VK_NULL_HANDLE;
+        allocInfo.descriptorPool = list->pools[list->current];
+        result = vkAllocateDescriptorSets(gf3d_descriptors.device, &allocInfo, &set);
+    }
+    if (result != VK_SUCCESS)
+    {
+        slog("failed to allocate descriptor set: %i",result);
+        return VK_NULL_HANDLE;
+    }
+    gf3d_descriptors.stats.setsAllocated++;
+    return set;
+}
+
+void gf3d_descriptors_begin_frame(Uint32 frameIndex)
+{
+    int i;
+    DescriptorPoolList *list;
+    if (!gf3d_descriptors.framePools)return;
+    gf3d_descriptors.currentFrame = frameIndex % gf3d_descriptors.frameCount;
+    list = &gf3d_descriptors.framePools[gf3d_descriptors.currentFrame];
+    // only the pools that were drawn from last time need resetting
+    for (i = 0; (i <= list->current) && (i < list->poolCount); i++)
+    {
+        vkResetDescriptorPool(gf3d_descriptors.device, list->pools[i], 0);
+        gf3d_descriptors.stats.poolResets++;
+    }
+    list->current = 0;
+}
+
+VkDescriptorSet gf3d_descriptors_allocate(VkDescriptorSetLayout layout)
+{
+    if (!gf3d_descriptors.framePools)
+    {
+        slog("descriptor manager not initialized");
+        return VK_NULL_HANDLE;
+    }
+    return gf3d_descriptors_pool_list_allocate(&gf3d_descriptors.framePools[gf3d_descriptors.currentFrame],layout);
+}
+
+void gf3d_descriptors_write(VkDescriptorSet set,const DescriptorBinding *bindings,Uint32 count)
+{
+    int i;
+    VkWriteDescriptorSet localWrites[GF3D_DESCRIPTORS_LOCAL_WRITES] = {0};
+    VkWriteDescriptorSet *writes = localWrites;
+    if ((!bindings)||(!count))return;
+    if (count > GF3D_DESCRIPTORS_LOCAL_WRITES)
+    {
+        // vulkan is done with the writes when the update returns, the frame arena takes them back next frame
+        writes = (VkWriteDescriptorSet *)gf3d_frame_allocate_array(sizeof(VkWriteDescriptorSet),count);
+        if (!writes)return;
+    }
+    for (i = 0; i < count; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = bindings[i].binding;
+        writes[i].dstArrayElement = 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = bindings[i].type;
+        switch (bindings[i].type)
+        {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                writes[i].pBufferInfo = &bindings[i].bufferInfo;
+            break;
+            default:
+                writes[i].pImageInfo = &bindings[i].imageInfo;
+            break;
+        }
+    }
+    vkUpdateDescriptorSets(gf3d_descriptors.device, count, writes, 0, NULL);
+}
+
+/**
+ * IMMUTABLE SET CACHE
+ */
+
+Uint64 gf3d_descriptors_hash_bytes(Uint64 hash,const void *data,size_t size)
+{
+    size_t i;
+    const Uint8 *bytes = (const Uint8 *)data;
+    for (i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= GF3D_DESCRIPTORS_FNV_PRIME;
+    }
+    return hash;
+}
+
+Uint64 gf3d_descriptors_hash(VkDescriptorSetLayout layout,const DescriptorBinding *bindings,Uint32 count)
+{
+    int i;
+    Uint64 hash = GF3D_DESCRIPTORS_FNV_OFFSET;
+    // hash field by field so struct padding never leaks into the key
+    hash = gf3d_descriptors_hash_bytes(hash,&layout,sizeof(VkDescriptorSetLayout));
+    for (i = 0; i < count; i++)
+    {
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].binding,sizeof(Uint32));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].type,sizeof(VkDescriptorType));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].bufferInfo.buffer,sizeof(VkBuffer));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].bufferInfo.offset,sizeof(VkDeviceSize));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].bufferInfo.range,sizeof(VkDeviceSize));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].imageInfo.sampler,sizeof(VkSampler));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].imageInfo.imageView,sizeof(VkImageView));
+        hash = gf3d_descriptors_hash_bytes(hash,&bindings[i].imageInfo.imageLayout,sizeof(VkImageLayout));
+    }
+    return hash;
+}
+
+Bool gf3d_descriptors_bindings_match(const DescriptorBinding *a,const DescriptorBinding *b,Uint32 count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if ((a[i].binding != b[i].binding)||
+            (a[i].type != b[i].type)||
+            (a[i].bufferInfo.buffer != b[i].bufferInfo.buffer)||
+            (a[i].bufferInfo.offset != b[i].bufferInfo.offset)||
+            (a[i].bufferInfo.range != b[i].bufferInfo.range)||
+            (a[i].imageInfo.sampler != b[i].imageInfo.sampler)||
+            (a[i].imageInfo.imageView != b[i].imageInfo.imageView)||
+            (a[i].imageInfo.imageLayout != b[i].imageInfo.imageLayout))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DescriptorCacheEntry *gf3d_descriptors_cache_find_slot(DescriptorCacheEntry *table,Uint32 size,Uint64 hash,VkDescriptorSetLayout layout,const DescriptorBinding *bindings,Uint32 count)
+{
+    Uint32 i;
+    DescriptorCacheEntry *entry;
+    for (i = (Uint32)hash & (size - 1);;i = (i + 1) & (size - 1))
+    {
+        entry = &table[i];
+        if (entry->set == VK_NULL_HANDLE)return entry;
+        if ((entry->hash == hash)&&
+            (entry->layout == layout)&&
+            (entry->bindingCount == count)&&
+            (gf3d_descriptors_bindings_match(entry->bindings,bindings,count)))
+        {
+            return entry;
+        }
+    }
+}
+
+Bool gf3d_descriptors_cache_resize(Uint32 size)
+{
+    int i;
+    Uint32 slot;
+    DescriptorCacheEntry *table;
+    table = (DescriptorCacheEntry *)gf3d_memory_allocate(MT_Descriptors,sizeof(DescriptorCacheEntry),size);
+    if (!table)
+    {
+        slog("failed to allocate descriptor set cache");
+        return false;
+    }
+    if (gf3d_descriptors.cache)
+    {
+        for (i = 0; i < gf3d_descriptors.cacheSize; i++)
+        {
+            if (gf3d_descriptors.cache[i].set == VK_NULL_HANDLE)continue;
+            // entries are unique already, so only an empty slot is needed
+            for (slot = (Uint32)gf3d_descriptors.cache[i].hash & (size - 1);
+                 table[slot].set != VK_NULL_HANDLE;
+                 slot = (slot + 1) & (size - 1));
+            memcpy(&table[slot],&gf3d_descriptors.cache[i],sizeof(DescriptorCacheEntry));
+        }
+        gf3d_memory_free(gf3d_descriptors.cache);
+    }
+    gf3d_descriptors.cache = table;
+    gf3d_descriptors.cacheSize = size;
+    return true;
+}
+
+VkDescriptorSet gf3d_descriptors_get_cached(VkDescriptorSetLayout layout,const DescriptorBinding *bindings,Uint32 count)
+{
+    Uint64 hash;
+    DescriptorCacheEntry *entry;
+    VkDescriptorSet set;
+
+    if (!gf3d_descriptors.cache)
+    {
+        slog("descriptor manager not initialized");
+        return VK_NULL_HANDLE;
+    }
+    if ((!bindings)||(!count))
+    {
+        slog("cannot cache a descriptor set with no bindings");
+        return VK_NULL_HANDLE;
+    }
+    hash = gf3d_descriptors_hash(layout,bindings,count);
+    entry = gf3d_descriptors_cache_find_slot(gf3d_descriptors.cache,gf3d_descriptors.cacheSize,hash,layout,bindings,count);
+    if (entry->set != VK_NULL_HANDLE)
+    {
+        gf3d_descriptors.stats.cacheHits++;
+        return entry->set;
+    }
+    gf3d_descriptors.stats.cacheMisses++;
+
+    set = gf3d_descriptors_pool_list_allocate(&gf3d_descriptors.cachePools,layout);
+    if (set == VK_NULL_HANDLE)return VK_NULL_HANDLE;
+    gf3d_descriptors_write(set,bindings,count);
+
+    entry->bindings = (DescriptorBinding *)gf3d_memory_allocate(MT_Descriptors,sizeof(DescriptorBinding),count);
+    if (!entry->bindings)
+    {
+        // the set is still usable, it just won't be found again
+        return set;
+    }
+    memcpy(entry->bindings,bindings,sizeof(DescriptorBinding)*count);
+    entry->hash = hash;
+    entry->layout = layout;
+    entry->bindingCount = count;
+    entry->set = set;
+    gf3d_descriptors.cacheCount++;
+
+    // keep the load factor under one half so probe chains stay short
+    if (gf3d_descriptors.cacheCount * 2 > gf3d_descriptors.cacheSize)
+    {
+        gf3d_descriptors_cache_resize(gf3d_descriptors.cacheSize * 2);
+    }
+    return set;
+}
+
+void gf3d_descriptors_get_stats(DescriptorStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_descriptors.stats,sizeof(DescriptorStats));
+}
+
+void gf3d_descriptors_reset_stats()
+{
+    memset(&gf3d_descriptors.stats,0,sizeof(DescriptorStats));
+}
+
+/*eol@eof*/
@@ -0,0 +1,898 @@
+#define SLOG_CATEGORY "ecs"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gf3d_ecs.h"
+#include "gf3d_jobs.h"
+#include "gf3d_pool.h"
+#include "gf3d_memory.h"
+#include "gf3d_trace.h"
+#include "simple_logger.h"
+
+#define GF3D_ECS_ALIGNMENT          16      // every component array starts on this boundary
+#define GF3D_ECS_CHUNKS_PER_BLOCK   64      // chunks the pool allocates at a time, a megabyte
+#define GF3D_ECS_COMMANDS_DEFAULT   4096    // bytes a command buffer starts with when no capacity is given
+#define GF3D_ECS_INDEX_MASK         0xFFFFFFFFULL
+
+typedef enum
+{
+    ES_Free = 0,
+    ES_Reserved,    /**<handed out by a command buffer, made when the buffer is flushed*/
+    ES_Alive
+}EcsEntityState;
+
+typedef enum
+{
+    EC_EntityNew = 0,
+    EC_EntityFree,
+    EC_Add,
+    EC_Remove
+}EcsCommandType;
+
+typedef struct
+{
+    Entity          entity;
+    ComponentMask   mask;       /**<the starting components, for EC_EntityNew*/
+    Uint32          type;
+    Sint32          component;
+    Uint32          size;       /**<bytes of component value that follow, 0 for none*/
+    Uint32          padding;
+}EcsCommand;
+
+typedef struct
+{
+    const char     *name;
+    size_t          size;
+}EcsComponentInfo;
+
+typedef struct
+{
+    ComponentMask   mask;
+    Uint32          capacity;                               /**<entities per chunk*/
+    Uint32          offsets[GF3D_ECS_MAX_COMPONENTS];       /**<where each component's array starts in chunk data*/
+    Sint32          components[GF3D_ECS_MAX_COMPONENTS];    /**<the component ids in the mask, lowest first*/
+    Uint32          componentCount;
+    EcsChunk      **chunks;         /**<every chunk but the last is full*/
+    Uint32          chunkCount;
+    Uint32          chunkMax;
+    Uint32          entityCount;
+}EcsArchetype;
+
+typedef struct
+{
+    EcsChunk       *chunk;          /**<where a live entity is stored*/
+    Uint32          row;
+    Uint32          generation;     /**<bumped when the entity is freed, so old handles stop resolving*/
+    EcsEntityState  state;
+}EcsRecord;
+
+typedef struct
+{
+    Bool                initialized;
+    Uint32              maxEntities;
+    Uint32              entityCount;
+    EcsRecord          *records;        /**<by entity index*/
+    Uint32             *freeIds;        /**<stack of unused entity indices*/
+    Uint32              freeCount;
+    SDL_SpinLock        idLock;         /**<guards the free ids, command buffers reserve entities from any thread*/
+    EcsComponentInfo    components[GF3D_ECS_MAX_COMPONENTS];
+    Uint32              componentCount;
+    EcsArchetype      **archetypes;
+    Uint32              archetypeCount;
+    Uint32              archetypeMax;
+    ObjectPool          chunkPool;
+    Uint32              chunkCount;
+    Bool                iterating;      /**<a query is running, structural changes have to wait*/
+    EcsChunk          **jobList;        /**<the chunks of the parallel query being run*/
+    Uint32              jobCount;
+    Uint32              jobMax;
+    EcsChunkFunc        jobFunc;
+    void               *jobData;
+}EcsManager;
+
+static EcsManager gf3d_ecs = {0};
+
+void gf3d_ecs_close();
+
+static size_t gf3d_ecs_align(size_t size)
+{
+    return (size + GF3D_ECS_ALIGNMENT - 1) & ~(size_t)(GF3D_ECS_ALIGNMENT - 1);
+}
+
+void gf3d_ecs_init(Uint32 maxEntities)
+{
+    int i;
+
+    if (gf3d_ecs.initialized)
+    {
+        slog("entity system is already initialized");
+        return;
+    }
+    if (!maxEntities)
+    {
+        slog("cannot initialize the entity system for zero entities");
+        return;
+    }
+    atexit(gf3d_ecs_close);
+    gf3d_ecs.records = (EcsRecord *)gf3d_memory_allocate(MT_Scene,sizeof(EcsRecord),maxEntities);
+    gf3d_ecs.freeIds = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxEntities);
+    if ((!gf3d_ecs.records)||(!gf3d_ecs.freeIds))
+    {
+        slog("failed to allocate entity records");
+        gf3d_ecs_close();
+        return;
+    }
+    // low indices are handed out first, generations start at 1 so no handle is GF3D_ECS_NULL
+    for (i = 0; i < maxEntities; i++)
+    {
+        gf3d_ecs.records[i].generation = 1;
+        gf3d_ecs.freeIds[i] = maxEntities - 1 - i;
+    }
+    gf3d_ecs.freeCount = maxEntities;
+    gf3d_ecs.maxEntities = maxEntities;
+    if (!gf3d_pool_create(&gf3d_ecs.chunkPool,"ecs chunks",MT_Scene,GF3D_ECS_CHUNK_SIZE,GF3D_ECS_CHUNKS_PER_BLOCK,0))
+    {
+        gf3d_ecs_close();
+        return;
+    }
+
+    gf3d_ecs.initialized = true;
+    slog("entity system initialized for %u entities",maxEntities);
+}
+
+void gf3d_ecs_close()
+{
+    int i;
+
+    for (i = 0; i < gf3d_ecs.archetypeCount; i++)
+    {
+        gf3d_memory_free(gf3d_ecs.archetypes[i]->chunks);
+        gf3d_memory_free(gf3d_ecs.archetypes[i]);
+    }
+    gf3d_memory_free(gf3d_ecs.archetypes);
+    gf3d_memory_free(gf3d_ecs.jobList);
+    // the chunks themselves all belong to the pool
+    gf3d_pool_destroy(&gf3d_ecs.chunkPool);
+    gf3d_memory_free(gf3d_ecs.records);
+    gf3d_memory_free(gf3d_ecs.freeIds);
+    memset(&gf3d_ecs,0,sizeof(EcsManager));
+}
+
+Sint32 gf3d_ecs_component_register(const char *name,size_t size)
+{
+    Sint32 component;
+    if (!gf3d_ecs.initialized)
+    {
+        slog("entity system not initialized");
+        return -1;
+    }
+    if (!size)
+    {
+        slog("cannot register component %s of zero size",name);
+        return -1;
+    }
+    if (gf3d_ecs.componentCount >= GF3D_ECS_MAX_COMPONENTS)
+    {
+        slog("cannot register component %s, all %i component ids are in use",name,GF3D_ECS_MAX_COMPONENTS);
+        return -1;
+    }
+    component = gf3d_ecs.componentCount++;
+    gf3d_ecs.components[component].name = name;
+    gf3d_ecs.components[component].size = size;
+    slog_debug("component %s registered as %i, %u bytes",name,component,(Uint32)size);
+    return component;
+}
+
+/**
+ * ENTITIES
+ */
+
+static Entity gf3d_ecs_handle(Uint32 index)
+{
+    return ((Entity)gf3d_ecs.records[index].generation << 32) | index;
+}
+
+/**
+ * @brief get the record an entity handle refers to
+ * @return NULL for out of range and stale handles
+ */
+static EcsRecord *gf3d_ecs_record(Entity entity)
+{
+    Uint32 index = (Uint32)(entity & GF3D_ECS_INDEX_MASK);
+    if ((!gf3d_ecs.records)||(index >= gf3d_ecs.maxEntities))return NULL;
+    if (gf3d_ecs.records[index].generation != (Uint32)(entity >> 32))return NULL;
+    return &gf3d_ecs.records[index];
+}
+
+/**
+ * @brief take an unused entity index.  Safe from any thread
+ * @return the index, -1 if every entity is in use
+ */
+static Sint32 gf3d_ecs_id_reserve()
+{
+    Sint32 index = -1;
+    SDL_AtomicLock(&gf3d_ecs.idLock);
+    if (gf3d_ecs.freeCount)index = gf3d_ecs.freeIds[--gf3d_ecs.freeCount];
+    SDL_AtomicUnlock(&gf3d_ecs.idLock);
+    if (index < 0)slog("no free entities, all %u are in use",gf3d_ecs.maxEntities);
+    return index;
+}
+
+/**
+ * @brief give an entity index back, handles to it stop resolving
+ */
+static void gf3d_ecs_id_release(Uint32 index)
+{
+    EcsRecord *record = &gf3d_ecs.records[index];
+    record->generation++;
+    if (!record->generation)record->generation = 1;
+    record->state = ES_Free;
+    record->chunk = NULL;
+    SDL_AtomicLock(&gf3d_ecs.idLock);
+    gf3d_ecs.freeIds[gf3d_ecs.freeCount++] = index;
+    SDL_AtomicUnlock(&gf3d_ecs.idLock);
+}
+
+/**
+ * @brief check that structural changes can be made now
+ * @param what the change, for the log
+ */
+static Bool gf3d_ecs_structural_allowed(const char *what)
+{
+    if (!gf3d_ecs.initialized)
+    {
+        slog("entity system not initialized");
+        return false;
+    }
+    if (gf3d_ecs.iterating)
+    {
+        slog_error("cannot %s while a query is running, record it in a command buffer",what);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * ARCHETYPES
+ */
+
+/**
+ * @brief bytes a chunk of an archetype needs for a number of entities, the entity array included
+ */
+static size_t gf3d_ecs_archetype_size(EcsArchetype *archetype,Uint32 capacity)
+{
+    int i;
+    size_t size = gf3d_ecs_align(sizeof(Entity) * capacity);
+    for (i = 0; i < archetype->componentCount; i++)
+    {
+        size += gf3d_ecs_align(gf3d_ecs.components[archetype->components[i]].size * capacity);
+    }
+    return size;
+}
+
+/**
+ * @brief find the archetype for a set of components, making it if it is new
+ * @return NULL on error (see logs)
+ */
+static EcsArchetype *gf3d_ecs_archetype_get(ComponentMask mask)
+{
+    int i;
+    size_t offset;
+    size_t perEntity;
+    size_t room = GF3D_ECS_CHUNK_SIZE - gf3d_ecs_align(sizeof(EcsChunk));
+    ComponentMask registered;
+    EcsArchetype *archetype;
+    EcsArchetype **archetypes;
+
+    for (i = 0; i < gf3d_ecs.archetypeCount; i++)
+    {
+        if (gf3d_ecs.archetypes[i]->mask == mask)return gf3d_ecs.archetypes[i];
+    }
+    registered = (gf3d_ecs.componentCount >= GF3D_ECS_MAX_COMPONENTS)?~(ComponentMask)0:gf3d_ecs_mask(gf3d_ecs.componentCount) - 1;
+    if (mask & ~registered)
+    {
+        slog("component mask %llx includes components that were never registered",(unsigned long long)mask);
+        return NULL;
+    }
+    if (gf3d_ecs.archetypeCount >= gf3d_ecs.archetypeMax)
+    {
+        archetypes = (EcsArchetype **)gf3d_memory_allocate(MT_Scene,sizeof(EcsArchetype *),gf3d_ecs.archetypeMax?gf3d_ecs.archetypeMax * 2:16);
+        if (!archetypes)return NULL;
+        if (gf3d_ecs.archetypes)
+        {
+            memcpy(archetypes,gf3d_ecs.archetypes,sizeof(EcsArchetype *) * gf3d_ecs.archetypeCount);
+            gf3d_memory_free(gf3d_ecs.archetypes);
+        }
+        gf3d_ecs.archetypes = archetypes;
+        gf3d_ecs.archetypeMax = gf3d_ecs.archetypeMax?gf3d_ecs.archetypeMax * 2:16;
+    }
+    archetype = (EcsArchetype *)gf3d_memory_allocate(MT_Scene,sizeof(EcsArchetype),1);
+    if (!archetype)return NULL;
+    archetype->mask = mask;
+    perEntity = sizeof(Entity);
+    for (i = 0; i < gf3d_ecs.componentCount; i++)
+    {
+        if (!(mask & gf3d_ecs_mask(i)))continue;
+        archetype->components[archetype->componentCount++] = i;
+        perEntity += gf3d_ecs.components[i].size;
+    }
+    // the estimate ignores the padding between arrays, take entities off until it fits
+    archetype->capacity = room / perEntity;
+    while ((archetype->capacity)&&(gf3d_ecs_archetype_size(archetype,archetype->capacity) > room))archetype->capacity--;
+    if (!archetype->capacity)
+    {
+        slog("components of mask %llx take %u bytes, more than a chunk holds",(unsigned long long)mask,(Uint32)perEntity);
+        gf3d_memory_free(archetype);
+        return NULL;
+    }
+    offset = gf3d_ecs_align(sizeof(Entity) * archetype->capacity);
+    for (i = 0; i < archetype->componentCount; i++)
+    {
+        archetype->offsets[archetype->components[i]] = (Uint32)offset;
+        offset += gf3d_ecs_align(gf3d_ecs.components[archetype->components[i]].size * archetype->capacity);
+    }
+    gf3d_ecs.archetypes[gf3d_ecs.archetypeCount++] = archetype;
+    slog_debug("archetype %llx made, %u entities per chunk",(unsigned long long)mask,archetype->capacity);
+    return archetype;
+}
+
+/**
+ * @brief add an empty chunk to the end of an archetype
+ * @return NULL on error (see logs)
+ */
+static EcsChunk *gf3d_ecs_chunk_new(EcsArchetype *archetype)
+{
+    EcsChunk *chunk;
+    EcsChunk **chunks;
+    Uint32 chunkMax;
+
+    if (archetype->chunkCount >= archetype->chunkMax)
+    {
+        chunkMax = archetype->chunkMax?archetype->chunkMax * 2:4;
+        chunks = (EcsChunk **)gf3d_memory_allocate(MT_Scene,sizeof(EcsChunk *),chunkMax);
+        if (!chunks)return NULL;
+        if (archetype->chunks)
+        {
+            memcpy(chunks,archetype->chunks,sizeof(EcsChunk *) * archetype->chunkCount);
+            gf3d_memory_free(archetype->chunks);
+        }
+        archetype->chunks = chunks;
+        archetype->chunkMax = chunkMax;
+    }
+    chunk = (EcsChunk *)gf3d_pool_new(&gf3d_ecs.chunkPool);
+    if (!chunk)return NULL;
+    chunk->mask = archetype->mask;
+    chunk->capacity = archetype->capacity;
+    chunk->data = (Uint8 *)chunk + gf3d_ecs_align(sizeof(EcsChunk));
+    chunk->entities = (Entity *)chunk->data;
+    chunk->archetype = archetype;
+    chunk->index = archetype->chunkCount;
+    archetype->chunks[archetype->chunkCount++] = chunk;
+    gf3d_ecs.chunkCount++;
+    return chunk;
+}
+
+#define gf3d_ecs_component_at(chunk,archetype,component,row) \
+    ((chunk)->data + (archetype)->offsets[(component)] + (size_t)(row) * gf3d_ecs.components[(component)].size)
+
+/**
+ * @brief take a row at the end of an archetype, its components are zeroed
+ * @param row set to the row in the chunk returned
+ * @return the chunk the row is in, NULL on error
+ */
+static EcsChunk *gf3d_ecs_row_new(EcsArchetype *archetype,Uint32 *row)
+{
+    int i;
+    Sint32 component;
+    EcsChunk *chunk = NULL;
+
+    if (archetype->chunkCount)chunk = archetype->chunks[archetype->chunkCount - 1];
+    if ((!chunk)||(chunk->count >= chunk->capacity))
+    {
+        chunk = gf3d_ecs_chunk_new(archetype);
+        if (!chunk)return NULL;
+    }
+    *row = chunk->count++;
+    archetype->entityCount++;
+    // rows are reused, a fresh chunk is already zero but a row given back is not
+    for (i = 0; i < archetype->componentCount; i++)
+    {
+        component = archetype->components[i];
+        memset(gf3d_ecs_component_at(chunk,archetype,component,*row),0,gf3d_ecs.components[component].size);
+    }
+    return chunk;
+}
+
+/**
+ * @brief give a row back to its archetype.  The archetype's last entity moves into it, so the archetype stays packed
+ */
+static void gf3d_ecs_row_free(EcsChunk *chunk,Uint32 row)
+{
+    int i;
+    Sint32 component;
+    Entity moved;
+    EcsArchetype *archetype = (EcsArchetype *)chunk->archetype;
+    EcsChunk *last = archetype->chunks[archetype->chunkCount - 1];
+    Uint32 lastRow = last->count - 1;
+
+    if ((last != chunk)||(lastRow != row))
+    {
+        for (i = 0; i < archetype->componentCount; i++)
+        {
+            component = archetype->components[i];
+            memcpy(
+                gf3d_ecs_component_at(chunk,archetype,component,row),
+                gf3d_ecs_component_at(last,archetype,component,lastRow),
+                gf3d_ecs.components[component].size);
+        }
+        moved = last->entities[lastRow];
+        chunk->entities[row] = moved;
+        gf3d_ecs.records[moved & GF3D_ECS_INDEX_MASK].chunk = chunk;
+        gf3d_ecs.records[moved & GF3D_ECS_INDEX_MASK].row = row;
+    }
+    last->count--;
+    archetype->entityCount--;
+    if (!last->count)
+    {
+        archetype->chunkCount--;
+        gf3d_pool_free(&gf3d_ecs.chunkPool,last);
+        gf3d_ecs.chunkCount--;
+    }
+}
+
+/**
+ * STRUCTURAL CHANGES
+ * these assume gf3d_ecs_structural_allowed was checked
+ */
+
+/**
+ * @brief put a reserved entity index in the archetype for a mask
+ * @return false on error, the index is still reserved
+ */
+static Bool gf3d_ecs_entity_make(Uint32 index,ComponentMask mask)
+{
+    Uint32 row;
+    EcsChunk *chunk;
+    EcsArchetype *archetype;
+    EcsRecord *record = &gf3d_ecs.records[index];
+
+    archetype = gf3d_ecs_archetype_get(mask);
+    if (!archetype)return false;
+    chunk = gf3d_ecs_row_new(archetype,&row);
+    if (!chunk)
+    {
+        slog("failed to allocate a chunk for a new entity");
+        return false;
+    }
+    chunk->entities[row] = gf3d_ecs_handle(index);
+    record->chunk = chunk;
+    record->row = row;
+    record->state = ES_Alive;
+    gf3d_ecs.entityCount++;
+    return true;
+}
+
+/**
+ * @brief free a live or reserved entity
+ */
+static void gf3d_ecs_entity_destroy(EcsRecord *record)
+{
+    if (record->state == ES_Alive)
+    {
+        gf3d_ecs_row_free(record->chunk,record->row);
+        gf3d_ecs.entityCount--;
+    }
+    gf3d_ecs_id_release((Uint32)(record - gf3d_ecs.records));
+}
+
+/**
+ * @brief change a live entity's components, moving it to the archetype for its new mask
+ * @param record the entity
+ * @param mask the components it should have
+ * @param component a component to write after the move, -1 for none
+ * @param value what to write to it, NULL to zero it
+ * @return false on error (see logs), the entity is left as it was
+ */
+static Bool gf3d_ecs_entity_change(EcsRecord *record,ComponentMask mask,Sint32 component,const void *value)
+{
+    int i;
+    Uint32 row;
+    Sint32 id;
+    EcsChunk *from = record->chunk;
+    EcsChunk *chunk = from;
+    EcsArchetype *source = (EcsArchetype *)from->archetype;
+    EcsArchetype *target;
+
+    row = record->row;
+    if (mask != source->mask)
+    {
+        target = gf3d_ecs_archetype_get(mask);
+        if (!target)return false;
+        chunk = gf3d_ecs_row_new(target,&row);
+        if (!chunk)
+        {
+            slog("failed to allocate a chunk to move an entity to");
+            return false;
+        }
+        for (i = 0; i < target->componentCount; i++)
+        {
+            id = target->components[i];
+            if (!(source->mask & gf3d_ecs_mask(id)))continue;
+            memcpy(
+                gf3d_ecs_component_at(chunk,target,id,row),
+                gf3d_ecs_component_at(from,source,id,record->row),
+                gf3d_ecs.components[id].size);
+        }
+        chunk->entities[row] = from->entities[record->row];
+        // may move another entity into the old row, and free the old chunk
+        gf3d_ecs_row_free(from,record->row);
+        record->chunk = chunk;
+        record->row = row;
+    }
+    if (component < 0)return true;
+    target = (EcsArchetype *)chunk->archetype;
+    if (value)memcpy(gf3d_ecs_component_at(chunk,target,component,row),value,gf3d_ecs.components[component].size);
+    else memset(gf3d_ecs_component_at(chunk,target,component,row),0,gf3d_ecs.components[component].size);
+    return true;
+}
+
+/**
+ * @brief add or remove one component
+ */
+static Bool gf3d_ecs_entity_set_component(Entity entity,Sint32 component,const void *value,Bool add)
+{
+    EcsRecord *record;
+    ComponentMask mask;
+
+    if ((component < 0)||(component >= gf3d_ecs.componentCount))
+    {
+        slog("component %i is not registered",component);
+        return false;
+    }
+    record = gf3d_ecs_record(entity);
+    if ((!record)||(record->state != ES_Alive))
+    {
+        slog_debug("entity %llx is not alive",(unsigned long long)entity);
+        return false;
+    }
+    mask = record->chunk->mask;
+    if (add)return gf3d_ecs_entity_change(record,mask | gf3d_ecs_mask(component),component,value);
+    if (!(mask & gf3d_ecs_mask(component)))return true;
+    return gf3d_ecs_entity_change(record,mask & ~gf3d_ecs_mask(component),-1,NULL);
+}
+
+Entity gf3d_ecs_entity_new(ComponentMask mask)
+{
+    Sint32 index;
+    if (!gf3d_ecs_structural_allowed("make an entity"))return GF3D_ECS_NULL;
+    index = gf3d_ecs_id_reserve();
+    if (index < 0)return GF3D_ECS_NULL;
+    if (!gf3d_ecs_entity_make(index,mask))
+    {
+        gf3d_ecs_id_release(index);
+        return GF3D_ECS_NULL;
+    }
+    return gf3d_ecs_handle(index);
+}
+
+void gf3d_ecs_entity_free(Entity entity)
+{
+    EcsRecord *record;
+    if (!gf3d_ecs_structural_allowed("free an entity"))return;
+    record = gf3d_ecs_record(entity);
+    if ((!record)||(record->state != ES_Alive))return;
+    gf3d_ecs_entity_destroy(record);
+}
+
+Bool gf3d_ecs_entity_alive(Entity entity)
+{
+    EcsRecord *record = gf3d_ecs_record(entity);
+    return ((record)&&(record->state == ES_Alive));
+}
+
+ComponentMask gf3d_ecs_entity_get_mask(Entity entity)
+{
+    EcsRecord *record = gf3d_ecs_record(entity);
+    if ((!record)||(record->state != ES_Alive))return 0;
+    return record->chunk->mask;
+}
+
+void *gf3d_ecs_get(Entity entity,Sint32 component)
+{
+    EcsRecord *record = gf3d_ecs_record(entity);
+    if ((!record)||(record->state != ES_Alive))return NULL;
+    if ((component < 0)||(component >= GF3D_ECS_MAX_COMPONENTS))return NULL;
+    if (!(record->chunk->mask & gf3d_ecs_mask(component)))return NULL;
+    return gf3d_ecs_component_at(record->chunk,(EcsArchetype *)record->chunk->archetype,component,record->row);
+}
+
+Bool gf3d_ecs_add(Entity entity,Sint32 component,const void *value)
+{
+    if (!gf3d_ecs_structural_allowed("add a component"))return false;
+    return gf3d_ecs_entity_set_component(entity,component,value,true);
+}
+
+Bool gf3d_ecs_remove(Entity entity,Sint32 component)
+{
+    if (!gf3d_ecs_structural_allowed("remove a component"))return false;
+    return gf3d_ecs_entity_set_component(entity,component,NULL,false);
+}
+
+void *gf3d_ecs_chunk_get(EcsChunk *chunk,Sint32 component)
+{
+    if ((!chunk)||(component < 0)||(component >= GF3D_ECS_MAX_COMPONENTS))return NULL;
+    if (!(chunk->mask & gf3d_ecs_mask(component)))return NULL;
+    return chunk->data + ((EcsArchetype *)chunk->archetype)->offsets[component];
+}
+
+/**
+ * QUERIES
+ */
+
+static Bool gf3d_ecs_query_match(EcsQuery *query,ComponentMask mask)
+{
+    return (((mask & query->all) == query->all)&&(!(mask & query->none)));
+}
+
+Uint32 gf3d_ecs_query_each(EcsQuery query,EcsChunkFunc func,void *data)
+{
+    int i,j;
+    Uint32 count = 0;
+    Bool iterating = gf3d_ecs.iterating;
+    EcsArchetype *archetype;
+
+    if (!func)return 0;
+    gf3d_ecs.iterating = true;
+    for (i = 0; i < gf3d_ecs.archetypeCount; i++)
+    {
+        archetype = gf3d_ecs.archetypes[i];
+        if ((!archetype->entityCount)||(!gf3d_ecs_query_match(&query,archetype->mask)))continue;
+        for (j = 0; j < archetype->chunkCount; j++)
+        {
+            count += archetype->chunks[j]->count;
+            func(archetype->chunks[j],0,data);
+        }
+    }
+    gf3d_ecs.iterating = iterating;
+    return count;
+}
+
+/**
+ * @brief run a batch of chunks of the current parallel query
+ */
+static void gf3d_ecs_jobs_run(Uint32 first,Uint32 last,Uint32 thread,void *data)
+{
+    for (; first < last; first++)
+    {
+        gf3d_ecs.jobFunc(gf3d_ecs.jobList[first],thread,gf3d_ecs.jobData);
+    }
+}
+
+Uint32 gf3d_ecs_query_each_parallel(EcsQuery query,EcsChunkFunc func,void *data)
+{
+    int i,j;
+    Uint32 count = 0;
+    Uint32 jobMax;
+    EcsChunk **jobList;
+    EcsArchetype *archetype;
+
+    if (!func)return 0;
+    // the chunk list belongs to the outer query
+    if (gf3d_ecs.iterating)return gf3d_ecs_query_each(query,func,data);
+    gf3d_ecs.jobCount = 0;
+    for (i = 0; i < gf3d_ecs.archetypeCount; i++)
+    {
+        archetype = gf3d_ecs.archetypes[i];
+        if ((!archetype->entityCount)||(!gf3d_ecs_query_match(&query,archetype->mask)))continue;
+        if (gf3d_ecs.jobCount + archetype->chunkCount > gf3d_ecs.jobMax)
+        {
+            jobMax = MAX(gf3d_ecs.jobMax * 2,gf3d_ecs.jobCount + archetype->chunkCount);
+            jobList = (EcsChunk **)gf3d_memory_allocate(MT_Scene,sizeof(EcsChunk *),jobMax);
+            if (!jobList)
+            {
+                slog("failed to allocate the chunk list, running the query on one thread");
+                return gf3d_ecs_query_each(query,func,data);
+            }
+            if (gf3d_ecs.jobList)
+            {
+                memcpy(jobList,gf3d_ecs.jobList,sizeof(EcsChunk *) * gf3d_ecs.jobCount);
+                gf3d_memory_free(gf3d_ecs.jobList);
+            }
+            gf3d_ecs.jobList = jobList;
+            gf3d_ecs.jobMax = jobMax;
+        }
+        for (j = 0; j < archetype->chunkCount; j++)
+        {
+            count += archetype->chunks[j]->count;
+            gf3d_ecs.jobList[gf3d_ecs.jobCount++] = archetype->chunks[j];
+        }
+    }
+    if (!gf3d_ecs.jobCount)return 0;
+    GF3D_TRACE_BEGIN("ecs parallel query");
+    gf3d_ecs.iterating = true;
+    gf3d_ecs.jobFunc = func;
+    gf3d_ecs.jobData = data;
+    // a chunk per batch, chunks already hold enough entities to be worth a job each
+    gf3d_jobs_parallel_for(gf3d_ecs.jobCount,1,gf3d_ecs_jobs_run,NULL);
+    gf3d_ecs.iterating = false;
+    GF3D_TRACE_END();
+    return count;
+}
+
+Uint32 gf3d_ecs_query_count(EcsQuery query)
+{
+    int i;
+    Uint32 count = 0;
+    for (i = 0; i < gf3d_ecs.archetypeCount; i++)
+    {
+        if (!gf3d_ecs_query_match(&query,gf3d_ecs.archetypes[i]->mask))continue;
+        count += gf3d_ecs.archetypes[i]->entityCount;
+    }
+    return count;
+}
+
+Uint32 gf3d_ecs_get_thread_count()
+{
+    return gf3d_jobs_get_thread_count();
+}
+
+void gf3d_ecs_get_stats(EcsStats *stats)
+{
+    if (!stats)return;
+    stats->entities = gf3d_ecs.entityCount;
+    stats->archetypes = gf3d_ecs.archetypeCount;
+    stats->chunks = gf3d_ecs.chunkCount;
+    stats->threads = gf3d_jobs_get_thread_count();
+}
+
+/**
+ * COMMAND BUFFERS
+ */
+
+Bool gf3d_ecs_commands_create(EcsCommands *commands,size_t capacity)
+{
+    if (!commands)return false;
+    memset(commands,0,sizeof(EcsCommands));
+    if (!capacity)capacity = GF3D_ECS_COMMANDS_DEFAULT;
+    commands->data = (Uint8 *)gf3d_memory_allocate(MT_Scene,1,capacity);
+    if (!commands->data)return false;
+    commands->capacity = capacity;
+    return true;
+}
+
+void gf3d_ecs_commands_free(EcsCommands *commands)
+{
+    if (!commands)return;
+    gf3d_memory_free(commands->data);
+    memset(commands,0,sizeof(EcsCommands));
+}
+
+/**
+ * @brief append a command, growing the buffer if it is full
+ * @param size bytes of component value that will follow it
+ * @return the command, its value goes right after it.  NULL on error
+ */
+static EcsCommand *gf3d_ecs_command_push(EcsCommands *commands,EcsCommandType type,Entity entity,Sint32 component,Uint32 size)
+{
+    size_t need;
+    size_t capacity;
+    Uint8 *data;
+    EcsCommand *command;
+
+    if ((!commands)||(!commands->data))
+    {
+        slog("command buffer was not created");
+        return NULL;
+    }
+    // values are padded so the next command stays aligned
+    need = sizeof(EcsCommand) + ((size + 7) & ~7);
+    if (commands->size + need > commands->capacity)
+    {
+        capacity = commands->capacity * 2;
+        while (commands->size + need > capacity)capacity *= 2;
+        data = (Uint8 *)gf3d_memory_allocate(MT_Scene,1,capacity);
+        if (!data)
+        {
+            slog("failed to grow a command buffer to %u bytes, command dropped",(Uint32)capacity);
+            return NULL;
+        }
+        memcpy(data,commands->data,commands->size);
+        gf3d_memory_free(commands->data);
+        commands->data = data;
+        commands->capacity = capacity;
+    }
+    command = (EcsCommand *)(commands->data + commands->size);
+    memset(command,0,sizeof(EcsCommand));
+    command->entity = entity;
+    command->type = type;
+    command->component = component;
+    command->size = size;
+    commands->size += need;
+    commands->count++;
+    return command;
+}
+
+Entity gf3d_ecs_command_entity_new(EcsCommands *commands,ComponentMask mask)
+{
+    Sint32 index;
+    EcsCommand *command;
+
+    if (!gf3d_ecs.initialized)return GF3D_ECS_NULL;
+    index = gf3d_ecs_id_reserve();
+    if (index < 0)return GF3D_ECS_NULL;
+    gf3d_ecs.records[index].state = ES_Reserved;
+    command = gf3d_ecs_command_push(commands,EC_EntityNew,gf3d_ecs_handle(index),-1,0);
+    if (!command)
+    {
+        gf3d_ecs_id_release(index);
+        return GF3D_ECS_NULL;
+    }
+    command->mask = mask;
+    return command->entity;
+}
+
+void gf3d_ecs_command_entity_free(EcsCommands *commands,Entity entity)
+{
+    gf3d_ecs_command_push(commands,EC_EntityFree,entity,-1,0);
+}
+
+void gf3d_ecs_command_add(EcsCommands *commands,Entity entity,Sint32 component,const void *value)
+{
+    EcsCommand *command;
+    if ((component < 0)||(component >= gf3d_ecs.componentCount))
+    {
+        slog("component %i is not registered",component);
+        return;
+    }
+    command = gf3d_ecs_command_push(commands,EC_Add,entity,component,value?(Uint32)gf3d_ecs.components[component].size:0);
+    if ((command)&&(value))memcpy(command + 1,value,command->size);
+}
+
+void gf3d_ecs_command_remove(EcsCommands *commands,Entity entity,Sint32 component)
+{
+    gf3d_ecs_command_push(commands,EC_Remove,entity,component,0);
+}
+
+void gf3d_ecs_commands_flush(EcsCommands *commands)
+{
+    size_t offset = 0;
+    EcsRecord *record;
+    EcsCommand *command;
+
+    if ((!commands)||(!commands->count))return;
+    if (!gf3d_ecs_structural_allowed("flush a command buffer"))return;
+    while (offset < commands->size)
+    {
+        command = (EcsCommand *)(commands->data + offset);
+        offset += sizeof(EcsCommand) + ((command->size + 7) & ~7);
+        switch (command->type)
+        {
+            case EC_EntityNew:
+                record = gf3d_ecs_record(command->entity);
+                if ((!record)||(record->state != ES_Reserved))break;
+                if (!gf3d_ecs_entity_make((Uint32)(command->entity & GF3D_ECS_INDEX_MASK),command->mask))
+                {
+                    gf3d_ecs_id_release((Uint32)(command->entity & GF3D_ECS_INDEX_MASK));
+                }
+                break;
+            case EC_EntityFree:
+                // a reserved entity freed before it was made just gives its index back
+                record = gf3d_ecs_record(command->entity);
+                if ((!record)||(record->state == ES_Free))break;
+                gf3d_ecs_entity_destroy(record);
+                break;
+            case EC_Add:
+                gf3d_ecs_entity_set_component(command->entity,command->component,command->size?command + 1:NULL,true);
+                break;
+            case EC_Remove:
+                gf3d_ecs_entity_set_component(command->entity,command->component,NULL,false);
+                break;
+        }
+    }
+    commands->size = 0;
+    commands->count = 0;
+}
+
+/*eol@eof*/
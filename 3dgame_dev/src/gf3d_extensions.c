@@ -1,6 +1,9 @@
+#define SLOG_CATEGORY "extensions"
+
 #include "gf3d_extensions.h"
 #include "gf3d_vector.h"
 
+#include "gf3d_memory.h"
 #include "simple_logger.h"
 
 #include <string.h>
@@ -27,35 +30,35 @@ void gf3d_extensions_device_init(VkPhysicalDevice device)
     Uint32 i;
     
     vkEnumerateDeviceExtensionProperties(device,NULL, &gf3d_device_extensions.available_extension_count, NULL);
-    slog("Total available device extensions: %i",gf3d_device_extensions.available_extension_count);
+    slog_debug("Total available device extensions: %i",gf3d_device_extensions.available_extension_count);
     if (!gf3d_device_extensions.available_extension_count)return;
 
-    gf3d_device_extensions.available_extensions = (VkExtensionProperties*)gf3d_allocate_array(sizeof (VkExtensionProperties),gf3d_device_extensions.available_extension_count);    
+    gf3d_device_extensions.available_extensions = (VkExtensionProperties*)gf3d_memory_allocate(MT_Graphics,sizeof (VkExtensionProperties),gf3d_device_extensions.available_extension_count);    
 
     if (!gf3d_device_extensions.available_extensions)return;
 
-    gf3d_device_extensions.enabled_extension_names = gf3d_allocate_array(sizeof(const char *),gf3d_device_extensions.available_extension_count);
+    gf3d_device_extensions.enabled_extension_names = gf3d_memory_allocate(MT_Graphics,sizeof(const char *),gf3d_device_extensions.available_extension_count);
     if (!gf3d_device_extensions.enabled_extension_names)return;
 
     vkEnumerateDeviceExtensionProperties(device,NULL, &gf3d_device_extensions.available_extension_count, gf3d_device_extensions.available_extensions);
     
     for (i = 0;i < gf3d_device_extensions.available_extension_count; i++)
     {
-        slog("available device extension: %s",gf3d_device_extensions.available_extensions[i].extensionName);
+        slog_debug("available device extension: %s",gf3d_device_extensions.available_extensions[i].extensionName);
     }
     atexit(gf3d_extensions_device_close);
 }
 
 void gf3d_extensions_device_close()
 {
-    slog("cleaning up device extensions");
+    slog_debug("cleaning up device extensions");
     if (gf3d_device_extensions.available_extensions)
     {
-        free(gf3d_device_extensions.available_extensions);
+        gf3d_memory_free(gf3d_device_extensions.available_extensions);
     }
     if (gf3d_device_extensions.enabled_extension_names)
     {
-        free(gf3d_device_extensions.enabled_extension_names);
+        gf3d_memory_free(gf3d_device_extensions.enabled_extension_names);
     }
     memset(&gf3d_device_extensions,0,sizeof(vExtensions));
 }
@@ -65,34 +68,34 @@ void gf3d_extensions_instance_init()
     int i;
     
     vkEnumerateInstanceExtensionProperties(NULL, &gf3d_instance_extensions.available_extension_count, NULL);
-    slog("Total available instance extensions: %i",gf3d_instance_extensions.available_extension_count);
+    slog_debug("Total available instance extensions: %i",gf3d_instance_extensions.available_extension_count);
     if (!gf3d_instance_extensions.available_extension_count)return;
 
-    gf3d_instance_extensions.available_extensions = (VkExtensionProperties*)gf3d_allocate_array(sizeof (VkExtensionProperties),gf3d_instance_extensions.available_extension_count);    
+    gf3d_instance_extensions.available_extensions = (VkExtensionProperties*)gf3d_memory_allocate(MT_Graphics,sizeof (VkExtensionProperties),gf3d_instance_extensions.available_extension_count);    
     if (!gf3d_instance_extensions.available_extensions)return;
 
-    gf3d_instance_extensions.enabled_extension_names = gf3d_allocate_array(sizeof(const char *),gf3d_instance_extensions.available_extension_count);
+    gf3d_instance_extensions.enabled_extension_names = gf3d_memory_allocate(MT_Graphics,sizeof(const char *),gf3d_instance_extensions.available_extension_count);
     if (!gf3d_instance_extensions.enabled_extension_names)return;
 
     vkEnumerateInstanceExtensionProperties(NULL, &gf3d_instance_extensions.available_extension_count, gf3d_instance_extensions.available_extensions);
     
     for (i = 0;i < gf3d_instance_extensions.available_extension_count; i++)
     {
-        slog("available instance extension: %s",gf3d_instance_extensions.available_extensions[i].extensionName);
+        slog_debug("available instance extension: %s",gf3d_instance_extensions.available_extensions[i].extensionName);
     }
     atexit(gf3d_extensions_instance_close);
 }
 
 void gf3d_extensions_instance_close()
 {
-    slog("cleaning up instance extentions");
+    slog_debug("cleaning up instance extentions");
     if (gf3d_instance_extensions.available_extensions)
     {
-        free(gf3d_instance_extensions.available_extensions);
+        gf3d_memory_free(gf3d_instance_extensions.available_extensions);
     }
     if (gf3d_instance_extensions.enabled_extension_names)
     {
-        free(gf3d_instance_extensions.enabled_extension_names);
+        gf3d_memory_free(gf3d_instance_extensions.enabled_extension_names);
     }
     memset(&gf3d_instance_extensions,0,sizeof(vExtensions));
 }
@@ -110,7 +113,7 @@ Bool gf3d_extensions_check_available(vExtensions *extensions,const char *extensi
             return true;
         }
     }
-    slog("Extension '%s' not available",extensionName);
+    slog_warn("Extension '%s' not available",extensionName);
     return false;
 }
 
@@ -127,21 +130,21 @@ Bool gf3d_extensions_enable(ExtensionType extType, const char *extensionName)
             extensions = &gf3d_device_extensions;
         break;
         default:
-            slog("unknown extension type");
+            slog_error("unknown extension type");
             return false;
     }
     for (i = 0; i < extensions->enabled_extension_count;i++)
     {
         if (strcmp(extensions->enabled_extension_names[i],extensionName) == 0)
         {
-            slog("Extension '%s' already enabled",extensionName);
+            slog_warn("Extension '%s' already enabled",extensionName);
             return false;
         }
     }
     if (!gf3d_extensions_check_available(extensions,extensionName))return false;
     if (extensions->enabled_extension_count >= extensions->available_extension_count)
     {
-        slog("cannot enable extension '%s' no more space",extensionName);
+        slog_error("cannot enable extension '%s' no more space",extensionName);
         return false;
     }
     
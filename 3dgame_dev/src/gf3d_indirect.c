@@ -0,0 +1,528 @@
+#include "gf3d_indirect.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_buffers.h"
+#include "gf3d_descriptors.h"
+#include "gf3d_uniforms.h"
+#include "gf3d_cull.h"
+#include "gf3d_camera.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#define GF3D_INDIRECT_MAX_FRAMES    32      // frame dirty bits are tracked in a Uint32
+#define GF3D_INDIRECT_GROUP_SIZE    64      // must match local_size_x in cull.comp
+#define GF3D_INDIRECT_BINDINGS      5
+
+/**
+ * the next four structures are read by cull.comp with std430 layout, keep them in sync
+ */
+
+typedef struct
+{
+    Matrix4     model;
+    Uint32      draw;               /**<index into the draw table*/
+    Uint32      padding[3];
+}IndirectInstanceData;
+
+typedef struct
+{
+    float       sphere[4];          /**<mesh bounding sphere in model space: center xyz, radius w*/
+    Uint32      indexCount;
+    Uint32      outputBase;         /**<first slot of this draw's range in the visible instance buffer*/
+    Uint32      padding[2];
+}IndirectDrawData;
+
+typedef struct
+{
+    Uint32      drawCount;          /**<draws that received at least one instance*/
+    Uint32      visibleCount;       /**<instances that passed culling*/
+}IndirectCounts;
+
+typedef struct
+{
+    Vector4D    planes[6];          /**<frustum planes, xyz normal pointing inward, w distance*/
+    Uint32      instanceCount;
+    Uint32      padding[3];
+}IndirectCullConstants;
+
+typedef struct
+{
+    Mesh       *mesh;
+    Pipeline   *pipe;
+    Uint32      instanceCount;      /**<how many live instances use this draw*/
+    Uint32      outputBase;
+    Bool        inUse;
+}IndirectDraw;
+
+typedef struct
+{
+    VkDevice                device;
+    Uint32                  frameCount;
+    Uint32                  allFrames;
+    Uint32                  maxInstances;
+    Uint32                  maxDraws;
+    Pipeline               *cullPipe;
+    VkDescriptorSetLayout   layout;
+    GpuBuffer               instanceBuffer;     /**<per frame copies of the instance records*/
+    GpuBuffer               drawBuffer;         /**<per frame copies of the draw table*/
+    GpuBuffer               commandBuffer;      /**<per frame indirect commands, filled in by the cull pass*/
+    GpuBuffer               countBuffer;        /**<per frame counters, read back once the frame comes around again*/
+    GpuBuffer               outputBuffer;       /**<per frame model matrices of visible instances, grouped by draw*/
+    VkDeviceSize            instanceStride;     /**<size of each frame's region, aligned for use as a buffer offset*/
+    VkDeviceSize            drawStride;
+    VkDeviceSize            commandStride;
+    VkDeviceSize            countStride;
+    VkDeviceSize            outputStride;
+    IndirectDraw           *drawList;
+    IndirectInstanceData   *instances;          /**<dense, the first instanceCount entries are live*/
+    Uint32                  instanceCount;
+    Uint32                 *staleFrames;        /**<by dense index: bit per frame whose copy is out of date*/
+    Bool                   *queued;             /**<by dense index: already in the dirty list*/
+    Uint32                 *dirtyList;          /**<dense indices that may have stale frames*/
+    Uint32                  dirtyCount;
+    Sint32                 *denseIndex;         /**<by instance id: dense index, -1 when free*/
+    Uint32                 *instanceId;         /**<by dense index: instance id*/
+    Uint32                 *freeIds;            /**<stack of unused instance ids*/
+    Uint32                  freeCount;
+    IndirectStats           stats;
+}IndirectManager;
+
+static IndirectManager gf3d_indirect = {0};
+
+void gf3d_indirect_close();
+void gf3d_indirect_layout_create();
+Bool gf3d_indirect_buffers_create();
+
+void gf3d_indirect_init(VkDevice device,Uint32 frameCount,Uint32 maxInstances,Uint32 maxDraws,char *cullShader)
+{
+    int i;
+
+    if ((!frameCount)||(frameCount > GF3D_INDIRECT_MAX_FRAMES))
+    {
+        slog("cannot initialize indirect drawing for %i frames",frameCount);
+        return;
+    }
+    if ((!maxInstances)||(!maxDraws))
+    {
+        slog("cannot initialize indirect drawing for zero instances or draws");
+        return;
+    }
+    gf3d_indirect.device = device;
+    gf3d_indirect.frameCount = frameCount;
+    gf3d_indirect.allFrames = (frameCount == 32)?0xFFFFFFFF:((1U << frameCount) - 1);
+    gf3d_indirect.maxInstances = maxInstances;
+    gf3d_indirect.maxDraws = maxDraws;
+    atexit(gf3d_indirect_close);
+
+    gf3d_indirect.drawList = (IndirectDraw *)gf3d_memory_allocate(MT_Render,sizeof(IndirectDraw),maxDraws);
+    gf3d_indirect.instances = (IndirectInstanceData *)gf3d_memory_allocate(MT_Render,sizeof(IndirectInstanceData),maxInstances);
+    gf3d_indirect.staleFrames = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxInstances);
+    gf3d_indirect.queued = (Bool *)gf3d_memory_allocate(MT_Render,sizeof(Bool),maxInstances);
+    gf3d_indirect.dirtyList = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxInstances);
+    gf3d_indirect.denseIndex = (Sint32 *)gf3d_memory_allocate(MT_Render,sizeof(Sint32),maxInstances);
+    gf3d_indirect.instanceId = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxInstances);
+    gf3d_indirect.freeIds = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxInstances);
+    if ((!gf3d_indirect.drawList)||(!gf3d_indirect.instances)||(!gf3d_indirect.staleFrames)||(!gf3d_indirect.queued)||
+        (!gf3d_indirect.dirtyList)||(!gf3d_indirect.denseIndex)||(!gf3d_indirect.instanceId)||(!gf3d_indirect.freeIds))
+    {
+        slog("failed to allocate indirect instance lists");
+        gf3d_indirect_close();
+        return;
+    }
+    for (i = 0; i < maxInstances; i++)
+    {
+        gf3d_indirect.denseIndex[i] = -1;
+        gf3d_indirect.freeIds[i] = maxInstances - 1 - i;
+    }
+    gf3d_indirect.freeCount = maxInstances;
+
+    if (!gf3d_indirect_buffers_create())
+    {
+        gf3d_indirect_close();
+        return;
+    }
+    gf3d_indirect_layout_create();
+    if (gf3d_indirect.layout == VK_NULL_HANDLE)
+    {
+        gf3d_indirect_close();
+        return;
+    }
+    gf3d_indirect.cullPipe = gf3d_pipeline_compute_load(device,cullShader,gf3d_indirect.layout,sizeof(IndirectCullConstants));
+    if (!gf3d_indirect.cullPipe)
+    {
+        slog("failed to load cull shader %s, indirect drawing disabled",cullShader);
+        gf3d_indirect_close();
+        return;
+    }
+    slog("indirect drawing initialized for %i instances and %i draws",maxInstances,maxDraws);
+}
+
+void gf3d_indirect_close()
+{
+    if (gf3d_indirect.cullPipe)
+    {
+        gf3d_pipeline_free(gf3d_indirect.cullPipe);
+    }
+    if (gf3d_indirect.layout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(gf3d_indirect.device, gf3d_indirect.layout, NULL);
+    }
+    gf3d_buffer_free(&gf3d_indirect.instanceBuffer);
+    gf3d_buffer_free(&gf3d_indirect.drawBuffer);
+    gf3d_buffer_free(&gf3d_indirect.commandBuffer);
+    gf3d_buffer_free(&gf3d_indirect.countBuffer);
+    gf3d_buffer_free(&gf3d_indirect.outputBuffer);
+    if (gf3d_indirect.drawList)gf3d_memory_free(gf3d_indirect.drawList);
+    if (gf3d_indirect.instances)gf3d_memory_free(gf3d_indirect.instances);
+    if (gf3d_indirect.staleFrames)gf3d_memory_free(gf3d_indirect.staleFrames);
+    if (gf3d_indirect.queued)gf3d_memory_free(gf3d_indirect.queued);
+    if (gf3d_indirect.dirtyList)gf3d_memory_free(gf3d_indirect.dirtyList);
+    if (gf3d_indirect.denseIndex)gf3d_memory_free(gf3d_indirect.denseIndex);
+    if (gf3d_indirect.instanceId)gf3d_memory_free(gf3d_indirect.instanceId);
+    if (gf3d_indirect.freeIds)gf3d_memory_free(gf3d_indirect.freeIds);
+    memset(&gf3d_indirect,0,sizeof(IndirectManager));
+}
+
+Bool gf3d_indirect_buffers_create()
+{
+    VkDeviceSize alignment;
+    const VkPhysicalDeviceLimits *limits;
+    VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    limits = gf3d_buffers_get_limits();
+    if (!limits)
+    {
+        slog("indirect drawing needs the buffer system to be initialized");
+        return false;
+    }
+    alignment = limits->minStorageBufferOffsetAlignment;
+    gf3d_indirect.instanceStride = gf3d_buffers_align(sizeof(IndirectInstanceData) * gf3d_indirect.maxInstances,alignment);
+    gf3d_indirect.drawStride = gf3d_buffers_align(sizeof(IndirectDrawData) * gf3d_indirect.maxDraws,alignment);
+    gf3d_indirect.commandStride = gf3d_buffers_align(sizeof(VkDrawIndexedIndirectCommand) * gf3d_indirect.maxDraws,alignment);
+    gf3d_indirect.countStride = gf3d_buffers_align(sizeof(IndirectCounts),alignment);
+    gf3d_indirect.outputStride = gf3d_buffers_align(sizeof(Matrix4) * gf3d_indirect.maxInstances,alignment);
+
+    if ((!gf3d_buffer_create(&gf3d_indirect.instanceBuffer,MT_Render,gf3d_indirect.instanceStride * gf3d_indirect.frameCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,hostMemory))||
+        (!gf3d_buffer_create(&gf3d_indirect.drawBuffer,MT_Render,gf3d_indirect.drawStride * gf3d_indirect.frameCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,hostMemory))||
+        (!gf3d_buffer_create(&gf3d_indirect.commandBuffer,MT_Render,gf3d_indirect.commandStride * gf3d_indirect.frameCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,hostMemory))||
+        (!gf3d_buffer_create(&gf3d_indirect.countBuffer,MT_Render,gf3d_indirect.countStride * gf3d_indirect.frameCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,hostMemory))||
+        (!gf3d_buffer_create(&gf3d_indirect.outputBuffer,MT_Render,gf3d_indirect.outputStride * gf3d_indirect.frameCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)))
+    {
+        slog("failed to create indirect drawing buffers");
+        return false;
+    }
+    memset(gf3d_indirect.countBuffer.mapped,0,gf3d_indirect.countStride * gf3d_indirect.frameCount);
+    return true;
+}
+
+void gf3d_indirect_layout_create()
+{
+    int i;
+    VkDescriptorSetLayoutBinding bindings[GF3D_INDIRECT_BINDINGS] = {0};
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+
+    // instances, draws, commands, visible instances, counters
+    for (i = 0; i < GF3D_INDIRECT_BINDINGS; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = GF3D_INDIRECT_BINDINGS;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(gf3d_indirect.device, &layoutInfo, NULL, &gf3d_indirect.layout) != VK_SUCCESS)
+    {
+        slog("failed to create indirect descriptor set layout");
+    }
+}
+
+/**
+ * INSTANCES
+ */
+
+void gf3d_indirect_layout_update()
+{
+    int i;
+    Uint32 base = 0;
+    // each draw owns a range of the visible instance buffer big enough for all of its instances
+    for (i = 0; i < gf3d_indirect.maxDraws; i++)
+    {
+        gf3d_indirect.drawList[i].outputBase = base;
+        base += gf3d_indirect.drawList[i].instanceCount;
+    }
+}
+
+Sint32 gf3d_indirect_draw_get(Mesh *mesh,Pipeline *pipe)
+{
+    int i;
+    Sint32 unused = -1;
+    for (i = 0; i < gf3d_indirect.maxDraws; i++)
+    {
+        if (!gf3d_indirect.drawList[i].inUse)
+        {
+            if (unused < 0)unused = i;
+            continue;
+        }
+        if ((gf3d_indirect.drawList[i].mesh == mesh)&&(gf3d_indirect.drawList[i].pipe == pipe))return i;
+    }
+    if (unused < 0)
+    {
+        slog("no free indirect draws");
+        return -1;
+    }
+    gf3d_indirect.drawList[unused].mesh = mesh;
+    gf3d_indirect.drawList[unused].pipe = pipe;
+    gf3d_indirect.drawList[unused].instanceCount = 0;
+    gf3d_indirect.drawList[unused].inUse = true;
+    return unused;
+}
+
+void gf3d_indirect_mark_stale(Uint32 dense)
+{
+    gf3d_indirect.staleFrames[dense] = gf3d_indirect.allFrames;
+    if (gf3d_indirect.queued[dense])return;
+    gf3d_indirect.queued[dense] = true;
+    gf3d_indirect.dirtyList[gf3d_indirect.dirtyCount++] = dense;
+}
+
+Sint32 gf3d_indirect_instance_new(Mesh *mesh,Pipeline *pipe)
+{
+    int i;
+    Sint32 draw;
+    Uint32 dense;
+
+    if ((!mesh)||(!pipe))return -1;
+    if (!gf3d_indirect.cullPipe)return -1;
+    if (gf3d_indirect.instanceCount >= gf3d_indirect.maxInstances)
+    {
+        slog("no free indirect instances");
+        return -1;
+    }
+    draw = gf3d_indirect_draw_get(mesh,pipe);
+    if (draw < 0)return -1;
+    i = gf3d_indirect.freeIds[--gf3d_indirect.freeCount];
+    dense = gf3d_indirect.instanceCount++;
+    gf3d_indirect.denseIndex[i] = dense;
+    gf3d_indirect.instanceId[dense] = i;
+    gf3d_matrix_identity(gf3d_indirect.instances[dense].model);
+    gf3d_indirect.instances[dense].draw = draw;
+    gf3d_indirect.drawList[draw].instanceCount++;
+    gf3d_indirect_layout_update();
+    gf3d_indirect_mark_stale(dense);
+    return i;
+}
+
+void gf3d_indirect_instance_free(Sint32 instance)
+{
+    Uint32 dense,last;
+    IndirectDraw *draw;
+
+    if ((instance < 0)||(instance >= gf3d_indirect.maxInstances))return;
+    if (gf3d_indirect.denseIndex[instance] < 0)return;
+    dense = gf3d_indirect.denseIndex[instance];
+    draw = &gf3d_indirect.drawList[gf3d_indirect.instances[dense].draw];
+    if (--draw->instanceCount == 0)
+    {
+        draw->inUse = false;
+    }
+    gf3d_indirect.denseIndex[instance] = -1;
+    gf3d_indirect.freeIds[gf3d_indirect.freeCount++] = instance;
+
+    // keep the live instances packed so the cull pass never visits holes
+    last = --gf3d_indirect.instanceCount;
+    if (dense != last)
+    {
+        memcpy(&gf3d_indirect.instances[dense],&gf3d_indirect.instances[last],sizeof(IndirectInstanceData));
+        gf3d_indirect.instanceId[dense] = gf3d_indirect.instanceId[last];
+        gf3d_indirect.denseIndex[gf3d_indirect.instanceId[dense]] = dense;
+        gf3d_indirect_mark_stale(dense);
+    }
+    gf3d_indirect.staleFrames[last] = 0;
+    gf3d_indirect_layout_update();
+}
+
+void gf3d_indirect_instance_set_model(Sint32 instance,Matrix4 model)
+{
+    Uint32 dense;
+    if ((instance < 0)||(instance >= gf3d_indirect.maxInstances))return;
+    if ((!model)||(gf3d_indirect.denseIndex[instance] < 0))return;
+    dense = gf3d_indirect.denseIndex[instance];
+    gf3d_matrix_copy(gf3d_indirect.instances[dense].model,model);
+    gf3d_indirect_mark_stale(dense);
+}
+
+/**
+ * FRAME
+ */
+
+void gf3d_indirect_update(Uint32 frame)
+{
+    int i;
+    Uint32 bit;
+    Uint32 dense;
+    IndirectCounts *counts;
+    IndirectDrawData *drawData;
+    IndirectInstanceData *instanceData;
+    VkDrawIndexedIndirectCommand *commands;
+
+    if (!gf3d_indirect.cullPipe)return;
+    if (frame >= gf3d_indirect.frameCount)return;
+    bit = 1U << frame;
+
+    // the fence for this frame has been waited on, so its counters hold the results of its last cull pass
+    counts = (IndirectCounts *)((Uint8 *)gf3d_indirect.countBuffer.mapped + (gf3d_indirect.countStride * frame));
+    gf3d_indirect.stats.visibleInstances = counts->visibleCount;
+    gf3d_indirect.stats.visibleDraws = counts->drawCount;
+    memset(counts,0,sizeof(IndirectCounts));
+
+    instanceData = (IndirectInstanceData *)((Uint8 *)gf3d_indirect.instanceBuffer.mapped + (gf3d_indirect.instanceStride * frame));
+    for (i = 0; i < gf3d_indirect.dirtyCount;)
+    {
+        dense = gf3d_indirect.dirtyList[i];
+        if ((dense < gf3d_indirect.instanceCount)&&(gf3d_indirect.staleFrames[dense] & bit))
+        {
+            memcpy(&instanceData[dense],&gf3d_indirect.instances[dense],sizeof(IndirectInstanceData));
+            gf3d_indirect.staleFrames[dense] &= ~bit;
+            gf3d_indirect.stats.instanceUploads++;
+        }
+        if ((dense >= gf3d_indirect.instanceCount)||(!gf3d_indirect.staleFrames[dense]))
+        {
+            gf3d_indirect.queued[dense] = false;
+            gf3d_indirect.dirtyList[i] = gf3d_indirect.dirtyList[--gf3d_indirect.dirtyCount];
+            continue;
+        }
+        i++;
+    }
+
+    // the draw table and command templates scale with the number of draws, so they are simply rewritten
+    drawData = (IndirectDrawData *)((Uint8 *)gf3d_indirect.drawBuffer.mapped + (gf3d_indirect.drawStride * frame));
+    commands = (VkDrawIndexedIndirectCommand *)((Uint8 *)gf3d_indirect.commandBuffer.mapped + (gf3d_indirect.commandStride * frame));
+    for (i = 0; i < gf3d_indirect.maxDraws; i++)
+    {
+        memset(&commands[i],0,sizeof(VkDrawIndexedIndirectCommand));
+        if (!gf3d_indirect.drawList[i].inUse)continue;
+        drawData[i].sphere[0] = gf3d_indirect.drawList[i].mesh->center.x;
+        drawData[i].sphere[1] = gf3d_indirect.drawList[i].mesh->center.y;
+        drawData[i].sphere[2] = gf3d_indirect.drawList[i].mesh->center.z;
+        drawData[i].sphere[3] = gf3d_indirect.drawList[i].mesh->radius;
+        drawData[i].indexCount = gf3d_indirect.drawList[i].mesh->indexCount;
+        drawData[i].outputBase = gf3d_indirect.drawList[i].outputBase;
+        commands[i].indexCount = gf3d_indirect.drawList[i].mesh->indexCount;
+    }
+    gf3d_indirect.stats.instances = gf3d_indirect.instanceCount;
+}
+
+void gf3d_indirect_cull(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    VkDescriptorSet set;
+    const CameraMatrices *camera;
+    IndirectCullConstants constants = {0};
+    DescriptorBinding bindings[GF3D_INDIRECT_BINDINGS] = {0};
+    GpuBuffer *buffers[GF3D_INDIRECT_BINDINGS];
+    VkDeviceSize strides[GF3D_INDIRECT_BINDINGS];
+    int i;
+
+    if (!gf3d_indirect.cullPipe)return;
+    if (frame >= gf3d_indirect.frameCount)return;
+    if (!gf3d_indirect.instanceCount)return;
+
+    buffers[0] = &gf3d_indirect.instanceBuffer;
+    strides[0] = gf3d_indirect.instanceStride;
+    buffers[1] = &gf3d_indirect.drawBuffer;
+    strides[1] = gf3d_indirect.drawStride;
+    buffers[2] = &gf3d_indirect.commandBuffer;
+    strides[2] = gf3d_indirect.commandStride;
+    buffers[3] = &gf3d_indirect.outputBuffer;
+    strides[3] = gf3d_indirect.outputStride;
+    buffers[4] = &gf3d_indirect.countBuffer;
+    strides[4] = gf3d_indirect.countStride;
+    for (i = 0; i < GF3D_INDIRECT_BINDINGS; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].bufferInfo.buffer = buffers[i]->buffer;
+        bindings[i].bufferInfo.offset = strides[i] * frame;
+        bindings[i].bufferInfo.range = strides[i];
+    }
+    set = gf3d_descriptors_get_cached(gf3d_indirect.layout,bindings,GF3D_INDIRECT_BINDINGS);
+    if (set == VK_NULL_HANDLE)return;
+
+    camera = gf3d_camera_object_get_matrices(gf3d_camera_get_active());
+    if (!camera)return;
+    memcpy(constants.planes,camera->frustum.planes,sizeof(camera->frustum.planes));
+    constants.instanceCount = gf3d_indirect.instanceCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gf3d_indirect.cullPipe->computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gf3d_indirect.cullPipe->pipelineLayout, 0, 1, &set, 0, NULL);
+    vkCmdPushConstants(commandBuffer, gf3d_indirect.cullPipe->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(IndirectCullConstants), &constants);
+    vkCmdDispatch(commandBuffer, (gf3d_indirect.instanceCount + GF3D_INDIRECT_GROUP_SIZE - 1) / GF3D_INDIRECT_GROUP_SIZE, 1, 1);
+}
+
+void gf3d_indirect_record(VkCommandBuffer commandBuffer,Uint32 frame,Bool depthOnly)
+{
+    int i;
+    IndirectDraw *draw;
+    Pipeline *bound = NULL;
+    VkBuffer buffers[2];
+    VkDeviceSize offsets[2];
+
+    if (!depthOnly)gf3d_indirect.stats.indirectDraws = 0;
+    if (!gf3d_indirect.cullPipe)return;
+    if (frame >= gf3d_indirect.frameCount)return;
+    if (!gf3d_indirect.instanceCount)return;
+    buffers[1] = gf3d_indirect.outputBuffer.buffer;
+    offsets[0] = 0;
+    for (i = 0; i < gf3d_indirect.maxDraws; i++)
+    {
+        draw = &gf3d_indirect.drawList[i];
+        if ((!draw->inUse)||(!draw->instanceCount))continue;
+        if ((depthOnly)&&(!draw->pipe->depthPipeline))continue;
+        if (draw->pipe != bound)
+        {
+            bound = draw->pipe;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly?bound->depthPipeline:bound->graphicsPipeline);
+            gf3d_uniforms_bind(commandBuffer, bound->pipelineLayout, frame, 0);
+        }
+        // the draw's visible instances start at its output base, so firstInstance stays 0 in the command
+        buffers[0] = draw->mesh->vertexBuffer.buffer;
+        offsets[1] = (gf3d_indirect.outputStride * frame) + (sizeof(Matrix4) * draw->outputBase);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, draw->mesh->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(
+            commandBuffer,
+            gf3d_indirect.commandBuffer.buffer,
+            (gf3d_indirect.commandStride * frame) + (sizeof(VkDrawIndexedIndirectCommand) * i),
+            1,
+            sizeof(VkDrawIndexedIndirectCommand));
+        if (!depthOnly)gf3d_indirect.stats.indirectDraws++;
+    }
+}
+
+void gf3d_indirect_draw(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_indirect_record(commandBuffer,frame,false);
+}
+
+void gf3d_indirect_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_indirect_record(commandBuffer,frame,true);
+}
+
+void gf3d_indirect_get_stats(IndirectStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_indirect.stats,sizeof(IndirectStats));
+}
+
+/*eol@eof*/
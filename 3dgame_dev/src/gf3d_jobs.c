@@ -0,0 +1,632 @@
+#define SLOG_CATEGORY "jobs"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gf3d_jobs.h"
+#include "gf3d_memory.h"
+#include "gf3d_trace.h"
+#include "simple_logger.h"
+
+#ifdef _MSC_VER
+#include <emmintrin.h>
+#define GF3D_THREAD_LOCAL __declspec(thread)
+#define GF3D_JOBS_FENCE() _mm_mfence()
+#else
+#define GF3D_THREAD_LOCAL __thread
+#define GF3D_JOBS_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define GF3D_JOBS_QUEUE_MASK        (GF3D_JOBS_QUEUE_SIZE - 1)
+#define GF3D_JOBS_SPIN_COUNT        64  // empty searches before an idle thread stops spinning
+#define GF3D_JOBS_SLEEP_MS          1   // bounds how long a missed wake up can leave a worker asleep
+#define GF3D_JOBS_BATCHES_PER_THREAD 4  // with no minimum batch given, ranges are cut this fine
+#define GF3D_JOBS_SLOT_PROBES       16  // slots looked at for a free one, past that the queue is as good as full
+
+typedef enum
+{
+    JK_Func = 0,
+    JK_Range
+}JobKind;
+
+typedef struct Job_S
+{
+    SDL_atomic_t    used;       /**<set while the slot holds a job that has not started*/
+    JobKind         kind;
+    JobFunc         func;
+    JobRangeFunc    rangeFunc;
+    void           *data;
+    JobCounter     *counter;
+    Uint32          first;      /**<the range still to run, for JK_Range*/
+    Uint32          last;
+    Uint32          minBatch;
+    struct Job_S   *next;       /**<in a counter's waiting list, or the shared queue*/
+}Job;
+
+/**
+ * a Chase-Lev deque: the owner pushes and pops at the bottom, thieves take from the top.  Only taking the last job
+ * needs the owner and a thief to agree, everything else is a load and a store
+ */
+typedef struct
+{
+    SDL_atomic_t    top;        /**<the oldest job, thieves move it*/
+    SDL_atomic_t    bottom;     /**<one past the newest job, only the owner moves it*/
+    Job * volatile *jobs;       /**<GF3D_JOBS_QUEUE_SIZE slots, indexed by position masked*/
+}JobDeque;
+
+typedef struct
+{
+    JobDeque        deque;
+    Job            *slots;      /**<storage for the jobs this thread starts*/
+    Uint32          cursor;     /**<where to look for the next free slot*/
+    Uint32          index;
+    Uint32          seed;       /**<picks which thread to steal from first*/
+    SDL_Thread     *thread;     /**<NULL for the main thread*/
+    Uint64          jobs;
+    Uint64          steals;
+    Uint64          inlined;
+}JobThread;
+
+typedef struct
+{
+    Bool            initialized;
+    Uint32          threadCount;    /**<threads running, the main thread included*/
+    Uint32          threadMax;      /**<threads allocated*/
+    JobThread      *threads;        /**<the main thread first, then the workers*/
+    SDL_sem        *wake;
+    SDL_atomic_t    sleeping;       /**<workers that went to sleep and have not been woken*/
+    SDL_atomic_t    quit;
+    SDL_SpinLock    sharedLock;     /**<guards the shared queue and its slots*/
+    SDL_atomic_t    sharedCount;    /**<jobs in the shared queue, checked without the lock*/
+    Job            *sharedHead;     /**<jobs started by threads that are not workers, oldest first*/
+    Job            *sharedTail;
+    Job            *sharedSlots;
+    Uint32          sharedCursor;
+}JobManager;
+
+static JobManager gf3d_jobs = {0};
+static GF3D_THREAD_LOCAL JobThread *gf3d_jobs_self = NULL;  /**<NULL on threads that are not workers*/
+
+void gf3d_jobs_close();
+int gf3d_jobs_worker_run(void *data);
+static void gf3d_jobs_execute(JobThread *self,Job *job);
+
+void gf3d_jobs_init(Uint32 threadCount)
+{
+    int i;
+
+    if (gf3d_jobs.initialized)
+    {
+        slog("job system is already initialized");
+        return;
+    }
+    if (!threadCount)threadCount = SDL_GetCPUCount();
+    threadCount = MAX(1,MIN(threadCount,GF3D_JOBS_MAX_THREADS));
+    atexit(gf3d_jobs_close);
+    gf3d_jobs.threads = (JobThread *)gf3d_memory_allocate(MT_General,sizeof(JobThread),threadCount);
+    gf3d_jobs.sharedSlots = (Job *)gf3d_memory_allocate(MT_General,sizeof(Job),GF3D_JOBS_QUEUE_SIZE);
+    gf3d_jobs.wake = SDL_CreateSemaphore(0);
+    if ((!gf3d_jobs.threads)||(!gf3d_jobs.sharedSlots)||(!gf3d_jobs.wake))
+    {
+        slog("failed to set up the job system");
+        gf3d_jobs_close();
+        return;
+    }
+    gf3d_jobs.threadMax = threadCount;
+    for (i = 0; i < threadCount; i++)
+    {
+        gf3d_jobs.threads[i].index = i;
+        gf3d_jobs.threads[i].seed = i + 1;
+        gf3d_jobs.threads[i].deque.jobs = (Job * volatile *)gf3d_memory_allocate(MT_General,sizeof(Job *),GF3D_JOBS_QUEUE_SIZE);
+        gf3d_jobs.threads[i].slots = (Job *)gf3d_memory_allocate(MT_General,sizeof(Job),GF3D_JOBS_QUEUE_SIZE);
+        if ((!gf3d_jobs.threads[i].deque.jobs)||(!gf3d_jobs.threads[i].slots))
+        {
+            slog("failed to allocate job queues");
+            gf3d_jobs_close();
+            return;
+        }
+    }
+    // workers steal from every thread up to the count, so it is set before they start and only ever lowered
+    gf3d_jobs.threadCount = threadCount;
+    gf3d_jobs_self = &gf3d_jobs.threads[0];
+    gf3d_jobs.initialized = true;
+    for (i = 1; i < threadCount; i++)
+    {
+        gf3d_jobs.threads[i].thread = SDL_CreateThread(gf3d_jobs_worker_run,"gf3d_jobs",&gf3d_jobs.threads[i]);
+        if (!gf3d_jobs.threads[i].thread)
+        {
+            slog("failed to start job worker %i, running with %i threads",i,i);
+            gf3d_jobs.threadCount = i;
+            break;
+        }
+    }
+    slog("job system initialized with %u threads",gf3d_jobs.threadCount);
+}
+
+void gf3d_jobs_close()
+{
+    int i;
+
+    // jobs still queued are dropped, whatever started them has already shut down
+    SDL_AtomicSet(&gf3d_jobs.quit,1);
+    for (i = 1; i < gf3d_jobs.threadCount; i++)
+    {
+        SDL_SemPost(gf3d_jobs.wake);
+    }
+    for (i = 1; i < gf3d_jobs.threadCount; i++)
+    {
+        SDL_WaitThread(gf3d_jobs.threads[i].thread,NULL);
+    }
+    if (gf3d_jobs.threads)
+    {
+        for (i = 0; i < gf3d_jobs.threadMax; i++)
+        {
+            gf3d_memory_free((void *)gf3d_jobs.threads[i].deque.jobs);
+            gf3d_memory_free(gf3d_jobs.threads[i].slots);
+        }
+        gf3d_memory_free(gf3d_jobs.threads);
+    }
+    if (gf3d_jobs.wake)SDL_DestroySemaphore(gf3d_jobs.wake);
+    gf3d_memory_free(gf3d_jobs.sharedSlots);
+    gf3d_jobs_self = NULL;
+    memset(&gf3d_jobs,0,sizeof(JobManager));
+}
+
+/**
+ * DEQUE
+ */
+
+static Bool gf3d_jobs_deque_push(JobDeque *deque,Job *job)
+{
+    Uint32 bottom = SDL_AtomicGet(&deque->bottom);
+    Uint32 top = SDL_AtomicGet(&deque->top);
+
+    if ((Sint32)(bottom - top) >= GF3D_JOBS_QUEUE_SIZE)return false;
+    deque->jobs[bottom & GF3D_JOBS_QUEUE_MASK] = job;
+    // the job has to be in its slot before a thief can see the new bottom
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&deque->bottom,bottom + 1);
+    return true;
+}
+
+static Job *gf3d_jobs_deque_pop(JobDeque *deque)
+{
+    Job *job;
+    Sint32 size;
+    Uint32 top;
+    Uint32 bottom = SDL_AtomicGet(&deque->bottom) - 1;
+
+    // claim the bottom slot first, then look at the top: a thief does the reverse, so at most one of them wins the
+    // last job without the compare and swap
+    SDL_AtomicSet(&deque->bottom,bottom);
+    GF3D_JOBS_FENCE();
+    top = SDL_AtomicGet(&deque->top);
+    size = (Sint32)(bottom - top);
+    if (size < 0)
+    {
+        SDL_AtomicSet(&deque->bottom,top);
+        return NULL;
+    }
+    job = deque->jobs[bottom & GF3D_JOBS_QUEUE_MASK];
+    if (size > 0)return job;
+    // the last job, a thief may be after it too
+    if (!SDL_AtomicCAS(&deque->top,top,top + 1))job = NULL;
+    SDL_AtomicSet(&deque->bottom,top + 1);
+    return job;
+}
+
+static Job *gf3d_jobs_deque_steal(JobDeque *deque)
+{
+    Job *job;
+    Uint32 bottom;
+    Uint32 top = SDL_AtomicGet(&deque->top);
+
+    GF3D_JOBS_FENCE();
+    bottom = SDL_AtomicGet(&deque->bottom);
+    if ((Sint32)(bottom - top) <= 0)return NULL;
+    job = deque->jobs[top & GF3D_JOBS_QUEUE_MASK];
+    // losing the race means the owner or another thief took it, the caller looks elsewhere
+    if (!SDL_AtomicCAS(&deque->top,top,top + 1))return NULL;
+    return job;
+}
+
+/**
+ * STARTING AND FINISHING
+ */
+
+static Job *gf3d_jobs_slot_take(Job *slots,Uint32 *cursor)
+{
+    int i;
+    Job *job;
+    // slots free up roughly in the order they were taken, so a free one is next to the cursor or nowhere
+    for (i = 0; i < GF3D_JOBS_SLOT_PROBES; i++)
+    {
+        job = &slots[(*cursor + i) & GF3D_JOBS_QUEUE_MASK];
+        if (SDL_AtomicGet(&job->used))continue;
+        *cursor = (*cursor + i + 1) & GF3D_JOBS_QUEUE_MASK;
+        SDL_AtomicSet(&job->used,1);
+        return job;
+    }
+    return NULL;
+}
+
+/**
+ * @brief get a free job from the calling thread's slots
+ * @return the job, NULL if the slots near the cursor all hold jobs that have not started
+ */
+static Job *gf3d_jobs_job_new(JobThread *self)
+{
+    Job *job;
+    if (self)return gf3d_jobs_slot_take(self->slots,&self->cursor);
+    SDL_AtomicLock(&gf3d_jobs.sharedLock);
+    job = gf3d_jobs_slot_take(gf3d_jobs.sharedSlots,&gf3d_jobs.sharedCursor);
+    SDL_AtomicUnlock(&gf3d_jobs.sharedLock);
+    return job;
+}
+
+/**
+ * @brief check that a job started from a thread will be picked up
+ * @param self the calling thread, NULL if it is not a worker
+ * @return false when the job has to run on the spot: before init, or from outside when there are no workers to take
+ * the shared queue
+ */
+static Bool gf3d_jobs_can_queue(JobThread *self)
+{
+    if (!gf3d_jobs.initialized)return false;
+    return (self)||(gf3d_jobs.threadCount > 1);
+}
+
+/**
+ * @brief take one worker off the sleeping count
+ * @return false if none was counted
+ */
+static Bool gf3d_jobs_claim_sleeper()
+{
+    int sleeping;
+    while ((sleeping = SDL_AtomicGet(&gf3d_jobs.sleeping)) > 0)
+    {
+        if (SDL_AtomicCAS(&gf3d_jobs.sleeping,sleeping,sleeping - 1))return true;
+    }
+    return false;
+}
+
+/**
+ * @brief wake one sleeping worker, if there is one
+ */
+static void gf3d_jobs_wake()
+{
+    if (gf3d_jobs_claim_sleeper())SDL_SemPost(gf3d_jobs.wake);
+}
+
+/**
+ * @brief make a job available to run
+ * @param self the calling thread, NULL if it is not a worker
+ * @param job the job, already counted
+ */
+static void gf3d_jobs_push(JobThread *self,Job *job)
+{
+    if (!self)
+    {
+        job->next = NULL;
+        SDL_AtomicLock(&gf3d_jobs.sharedLock);
+        if (gf3d_jobs.sharedTail)gf3d_jobs.sharedTail->next = job;
+        else gf3d_jobs.sharedHead = job;
+        gf3d_jobs.sharedTail = job;
+        SDL_AtomicIncRef(&gf3d_jobs.sharedCount);
+        SDL_AtomicUnlock(&gf3d_jobs.sharedLock);
+    }
+    else if (!gf3d_jobs_deque_push(&self->deque,job))
+    {
+        self->inlined++;
+        gf3d_jobs_execute(self,job);
+        return;
+    }
+    gf3d_jobs_wake();
+}
+
+/**
+ * @brief count a job as finished, and start whatever was held until its counter reached zero
+ */
+static void gf3d_jobs_finish(JobThread *self,JobCounter *counter)
+{
+    Job *held = NULL;
+    Job *next;
+
+    if (!counter)return;
+    // the decrement happens under the lock so that a waiter, which takes the lock once it sees zero, knows this
+    // thread is done with the counter
+    SDL_AtomicLock(&counter->lock);
+    if (SDL_AtomicAdd(&counter->count,-1) == 1)
+    {
+        held = (Job *)counter->waiting;
+        counter->waiting = NULL;
+    }
+    SDL_AtomicUnlock(&counter->lock);
+    for (;held;held = next)
+    {
+        next = held->next;
+        gf3d_jobs_push(self,held);
+    }
+}
+
+static void gf3d_jobs_range_start(JobThread *self,Uint32 first,Uint32 last,Uint32 minBatch,JobRangeFunc func,void *data,JobCounter *counter)
+{
+    Job *job = gf3d_jobs_job_new(self);
+    if (!job)
+    {
+        if (self)self->inlined++;
+        func(first,last,self?self->index:0,data);
+        return;
+    }
+    job->kind = JK_Range;
+    job->rangeFunc = func;
+    job->data = data;
+    job->counter = counter;
+    job->first = first;
+    job->last = last;
+    job->minBatch = minBatch;
+    if (counter)SDL_AtomicIncRef(&counter->count);
+    gf3d_jobs_push(self,job);
+}
+
+static void gf3d_jobs_execute(JobThread *self,Job *job)
+{
+    Uint32 middle;
+    Job run;
+
+    // the slot is free as soon as the job has been read
+    memcpy(&run,job,sizeof(Job));
+    SDL_AtomicSet(&job->used,0);
+    if (run.kind == JK_Range)
+    {
+        // keep the front half and offer the back half to thieves, down to the batch size
+        while (run.last - run.first > run.minBatch)
+        {
+            middle = run.first + ((run.last - run.first) / 2);
+            gf3d_jobs_range_start(self,middle,run.last,run.minBatch,run.rangeFunc,run.data,run.counter);
+            run.last = middle;
+        }
+        run.rangeFunc(run.first,run.last,self->index,run.data);
+    }
+    else run.func(run.data);
+    self->jobs++;
+    gf3d_jobs_finish(self,run.counter);
+}
+
+/**
+ * @brief find a job for a worker: its own newest, then the shared queue, then another thread's oldest
+ */
+static Job *gf3d_jobs_find(JobThread *self)
+{
+    int i;
+    Uint32 first;
+    Uint32 count;
+    Job *job;
+
+    job = gf3d_jobs_deque_pop(&self->deque);
+    if (job)return job;
+    if (SDL_AtomicGet(&gf3d_jobs.sharedCount))
+    {
+        SDL_AtomicLock(&gf3d_jobs.sharedLock);
+        job = gf3d_jobs.sharedHead;
+        if (job)
+        {
+            gf3d_jobs.sharedHead = job->next;
+            if (!gf3d_jobs.sharedHead)gf3d_jobs.sharedTail = NULL;
+            SDL_AtomicAdd(&gf3d_jobs.sharedCount,-1);
+        }
+        SDL_AtomicUnlock(&gf3d_jobs.sharedLock);
+        if (job)return job;
+    }
+    // start from a different thread each time so that thieves do not all pile onto the same one
+    count = gf3d_jobs.threadCount;
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    first = self->seed % count;
+    for (i = 0; i < count; i++)
+    {
+        if ((first + i) % count == self->index)continue;
+        job = gf3d_jobs_deque_steal(&gf3d_jobs.threads[(first + i) % count].deque);
+        if (job)
+        {
+            self->steals++;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+int gf3d_jobs_worker_run(void *data)
+{
+    Job *job;
+    Uint32 spins = 0;
+    JobThread *self = (JobThread *)data;
+
+    gf3d_jobs_self = self;
+    gf3d_trace_set_thread_name("jobs");
+    while (!SDL_AtomicGet(&gf3d_jobs.quit))
+    {
+        job = gf3d_jobs_find(self);
+        if (job)
+        {
+            gf3d_jobs_execute(self,job);
+            spins = 0;
+            continue;
+        }
+        if (++spins < GF3D_JOBS_SPIN_COUNT)continue;
+        spins = 0;
+        // say it is going to sleep before the last look, so a job pushed after that look always wakes someone
+        SDL_AtomicIncRef(&gf3d_jobs.sleeping);
+        job = gf3d_jobs_find(self);
+        if (job)
+        {
+            gf3d_jobs_claim_sleeper();
+            gf3d_jobs_execute(self,job);
+            continue;
+        }
+        if (SDL_SemWaitTimeout(gf3d_jobs.wake,GF3D_JOBS_SLEEP_MS) == SDL_MUTEX_TIMEDOUT)
+        {
+            // nobody woke it, so nobody took it off the count
+            gf3d_jobs_claim_sleeper();
+        }
+    }
+    return 0;
+}
+
+/**
+ * PUBLIC
+ */
+
+void gf3d_jobs_run(JobFunc func,void *data,JobCounter *counter)
+{
+    Job *job;
+    JobThread *self = gf3d_jobs_self;
+
+    if (!func)return;
+    if (!gf3d_jobs_can_queue(self))
+    {
+        func(data);
+        return;
+    }
+    job = gf3d_jobs_job_new(self);
+    if (!job)
+    {
+        if (self)self->inlined++;
+        func(data);
+        return;
+    }
+    job->kind = JK_Func;
+    job->func = func;
+    job->data = data;
+    job->counter = counter;
+    if (counter)SDL_AtomicIncRef(&counter->count);
+    gf3d_jobs_push(self,job);
+}
+
+void gf3d_jobs_run_after(JobCounter *after,JobFunc func,void *data,JobCounter *counter)
+{
+    Job *job;
+    JobThread *self = gf3d_jobs_self;
+
+    if (!func)return;
+    if (!gf3d_jobs_can_queue(self))
+    {
+        // everything this thread could be waiting for already ran when it was started
+        func(data);
+        return;
+    }
+    // a held job cannot run on the spot, so keep helping until a slot frees up
+    while (!(job = gf3d_jobs_job_new(self)))
+    {
+        if ((self)&&((job = gf3d_jobs_find(self)) != NULL))gf3d_jobs_execute(self,job);
+        else SDL_Delay(0);
+    }
+    job->kind = JK_Func;
+    job->func = func;
+    job->data = data;
+    job->counter = counter;
+    if (counter)SDL_AtomicIncRef(&counter->count);
+    if (after)
+    {
+        SDL_AtomicLock(&after->lock);
+        if (SDL_AtomicGet(&after->count) > 0)
+        {
+            job->next = (Job *)after->waiting;
+            after->waiting = job;
+            job = NULL;
+        }
+        SDL_AtomicUnlock(&after->lock);
+        if (!job)return;
+    }
+    gf3d_jobs_push(self,job);
+}
+
+void gf3d_jobs_parallel_for_async(Uint32 count,Uint32 minBatch,JobRangeFunc func,void *data,JobCounter *counter)
+{
+    if ((!count)||(!func))return;
+    if (!gf3d_jobs_can_queue(gf3d_jobs_self))
+    {
+        func(0,count,0,data);
+        return;
+    }
+    if (!minBatch)minBatch = MAX(1,count / (gf3d_jobs.threadCount * GF3D_JOBS_BATCHES_PER_THREAD));
+    gf3d_jobs_range_start(gf3d_jobs_self,0,count,minBatch,func,data,counter);
+}
+
+void gf3d_jobs_parallel_for(Uint32 count,Uint32 minBatch,JobRangeFunc func,void *data)
+{
+    JobCounter counter = {0};
+    gf3d_jobs_parallel_for_async(count,minBatch,func,data,&counter);
+    gf3d_jobs_wait(&counter);
+}
+
+void gf3d_jobs_wait(JobCounter *counter)
+{
+    Job *job;
+    Uint32 spins = 0;
+    JobThread *self = gf3d_jobs_self;
+
+    if (!counter)return;
+    while (SDL_AtomicGet(&counter->count) > 0)
+    {
+        if (!self)
+        {
+            SDL_Delay(1);
+            continue;
+        }
+        job = gf3d_jobs_find(self);
+        if (job)
+        {
+            gf3d_jobs_execute(self,job);
+            spins = 0;
+            continue;
+        }
+        // whatever is left is running on other threads, give them the core if they need it
+        if (++spins >= GF3D_JOBS_SPIN_COUNT)
+        {
+            SDL_Delay(0);
+            spins = 0;
+        }
+    }
+    // the thread that finished the last job may still hold the lock
+    SDL_AtomicLock(&counter->lock);
+    SDL_AtomicUnlock(&counter->lock);
+}
+
+Bool gf3d_jobs_done(JobCounter *counter)
+{
+    if (!counter)return true;
+    if (SDL_AtomicGet(&counter->count) > 0)return false;
+    SDL_AtomicLock(&counter->lock);
+    SDL_AtomicUnlock(&counter->lock);
+    return true;
+}
+
+Uint32 gf3d_jobs_get_thread_count()
+{
+    return MAX(1,gf3d_jobs.threadCount);
+}
+
+Uint32 gf3d_jobs_get_thread_index()
+{
+    if (!gf3d_jobs_self)return 0;
+    return gf3d_jobs_self->index;
+}
+
+void gf3d_jobs_get_stats(JobStats *stats)
+{
+    int i;
+    if (!stats)return;
+    memset(stats,0,sizeof(JobStats));
+    stats->threads = gf3d_jobs_get_thread_count();
+    for (i = 0; i < gf3d_jobs.threadCount; i++)
+    {
+        stats->jobs += gf3d_jobs.threads[i].jobs;
+        stats->steals += gf3d_jobs.threads[i].steals;
+        stats->inlined += gf3d_jobs.threads[i].inlined;
+    }
+}
+
+/*eol@eof*/
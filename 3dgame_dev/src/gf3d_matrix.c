@@ -4,6 +4,45 @@
 #include "gf3d_matrix.h"
 #include "simple_logger.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GF3D_MATRIX_SSE
+#define GF3D_MATRIX_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(GF3D_MATRIX_AVX)
+#include <intrin.h>
+#define GF3D_MATRIX_TARGET_AVX
+#elif defined(GF3D_MATRIX_AVX)
+#define GF3D_MATRIX_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+#define GF3D_MATRIX_EPSILON 1e-12f     // below this a scale or determinant is treated as zero
+
+/**
+ * @brief out[i] = m2[i] * m1[i * m1Step], m1Step is 0 to share one m1 across the list
+ */
+typedef void (*MatrixMultiplyKernel)(Matrix4 *out,Matrix4 *m1,Uint32 m1Step,Matrix4 *m2,Uint32 count);
+typedef void (*MatrixTransformKernel)(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count);
+typedef void (*MatrixPointsKernel)(Vector3D *out,Matrix4 mat,Vector3D *points,Uint32 count);
+typedef Bool (*MatrixInvertKernel)(Matrix4 out,Matrix4 in);
+typedef void (*MatrixUnaryKernel)(Matrix4 out,Matrix4 in);
+
+typedef struct
+{
+    MatrixSimd              simd;
+    MatrixMultiplyKernel    multiply;
+    MatrixTransformKernel   transform;
+    MatrixPointsKernel      points;
+    MatrixInvertKernel      invert;
+    MatrixInvertKernel      invertAffine;
+    MatrixUnaryKernel       invertRigid;
+    MatrixUnaryKernel       transpose;
+    MatrixInvertKernel      normal;
+}MatrixKernels;
+
+static MatrixKernels gf3d_matrix_kernels = {0};
+
 void gf3d_matrix_slog(Matrix4 mat)
 {
     slog("%f,%f,%f,%f",mat[0][0],mat[0][1],mat[0][2],mat[0][3]);
@@ -23,32 +62,715 @@ void gf3d_matrix_copy(
 }
 
 
+/**
+ * SCALAR KERNELS
+ */
+
+void gf3d_matrix_multiply_scalar(Matrix4 *out,Matrix4 *m1list,Uint32 m1Step,Matrix4 *m2list,Uint32 count)
+{
+    int i;
+    Matrix4 temp;
+    float (*m1)[4];
+    float (*m2)[4];
+    for (i = 0; i < count; i++)
+    {
+        m1 = m1list[i * m1Step];
+        m2 = m2list[i];
+
+        temp[0][0] = m2[0][0]*m1[0][0] + m2[0][1]*m1[1][0] + m2[0][2]*m1[2][0] + m2[0][3]*m1[3][0];
+        temp[0][1] = m2[0][0]*m1[0][1] + m2[0][1]*m1[1][1] + m2[0][2]*m1[2][1] + m2[0][3]*m1[3][1];
+        temp[0][2] = m2[0][0]*m1[0][2] + m2[0][1]*m1[1][2] + m2[0][2]*m1[2][2] + m2[0][3]*m1[3][2];
+        temp[0][3] = m2[0][0]*m1[0][3] + m2[0][1]*m1[1][3] + m2[0][2]*m1[2][3] + m2[0][3]*m1[3][3];
+
+        temp[1][0] = m2[1][0]*m1[0][0] + m2[1][1]*m1[1][0] + m2[1][2]*m1[2][0] + m2[1][3]*m1[3][0];
+        temp[1][1] = m2[1][0]*m1[0][1] + m2[1][1]*m1[1][1] + m2[1][2]*m1[2][1] + m2[1][3]*m1[3][1];
+        temp[1][2] = m2[1][0]*m1[0][2] + m2[1][1]*m1[1][2] + m2[1][2]*m1[2][2] + m2[1][3]*m1[3][2];
+        temp[1][3] = m2[1][0]*m1[0][3] + m2[1][1]*m1[1][3] + m2[1][2]*m1[2][3] + m2[1][3]*m1[3][3];
+
+        temp[2][0] = m2[2][0]*m1[0][0] + m2[2][1]*m1[1][0] + m2[2][2]*m1[2][0] + m2[2][3]*m1[3][0];
+        temp[2][1] = m2[2][0]*m1[0][1] + m2[2][1]*m1[1][1] + m2[2][2]*m1[2][1] + m2[2][3]*m1[3][1];
+        temp[2][2] = m2[2][0]*m1[0][2] + m2[2][1]*m1[1][2] + m2[2][2]*m1[2][2] + m2[2][3]*m1[3][2];
+        temp[2][3] = m2[2][0]*m1[0][3] + m2[2][1]*m1[1][3] + m2[2][2]*m1[2][3] + m2[2][3]*m1[3][3];
+
+        temp[3][0] = m2[3][0]*m1[0][0] + m2[3][1]*m1[1][0] + m2[3][2]*m1[2][0] + m2[3][3]*m1[3][0];
+        temp[3][1] = m2[3][0]*m1[0][1] + m2[3][1]*m1[1][1] + m2[3][2]*m1[2][1] + m2[3][3]*m1[3][1];
+        temp[3][2] = m2[3][0]*m1[0][2] + m2[3][1]*m1[1][2] + m2[3][2]*m1[2][2] + m2[3][3]*m1[3][2];
+        temp[3][3] = m2[3][0]*m1[0][3] + m2[3][1]*m1[1][3] + m2[3][2]*m1[2][3] + m2[3][3]*m1[3][3];
+
+        memcpy(out[i],temp,sizeof(Matrix4));
+    }
+}
+
+void gf3d_matrix_transform_scalar(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count)
+{
+    int i;
+    double x,y,z,w;
+    for (i = 0; i < count; i++)
+    {
+        x=vec[i].x;
+        y=vec[i].y;
+        z=vec[i].z;
+        w=vec[i].w;
+        out[i].x = x*mat[0][0] + y*mat[1][0] + mat[2][0]*z + mat[3][0]*w;
+        out[i].y = x*mat[0][1] + y*mat[1][1] + mat[2][1]*z + mat[3][1]*w;
+        out[i].z = x*mat[0][2] + y*mat[1][2] + mat[2][2]*z + mat[3][2]*w;
+        out[i].w = x*mat[0][3] + y*mat[1][3] + mat[2][3]*z + mat[3][3]*w;
+    }
+}
+
+void gf3d_matrix_points_scalar(Vector3D *out,Matrix4 mat,Vector3D *points,Uint32 count)
+{
+    int i;
+    float x,y,z;
+    for (i = 0; i < count; i++)
+    {
+        x = points[i].x;
+        y = points[i].y;
+        z = points[i].z;
+        out[i].x = x*mat[0][0] + y*mat[1][0] + z*mat[2][0] + mat[3][0];
+        out[i].y = x*mat[0][1] + y*mat[1][1] + z*mat[2][1] + mat[3][1];
+        out[i].z = x*mat[0][2] + y*mat[1][2] + z*mat[2][2] + mat[3][2];
+    }
+}
+
+void gf3d_matrix_transpose_scalar(Matrix4 out,Matrix4 in)
+{
+    int i,j;
+    Matrix4 temp;
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            temp[j][i] = in[i][j];
+        }
+    }
+    memcpy(out,temp,sizeof(Matrix4));
+}
+
+/**
+ * @brief inverse by cofactor expansion, each 2x2 minor of the top and bottom halves is shared by several cofactors
+ */
+Bool gf3d_matrix_invert_scalar(Matrix4 out,Matrix4 m)
+{
+    int i,j;
+    float s0,s1,s2,s3,s4,s5;
+    float c0,c1,c2,c3,c4,c5;
+    float det,invDet;
+    Matrix4 temp;
+
+    s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+    s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+    s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+    s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+    s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+    s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+    c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+    c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+    det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0)return false;
+    invDet = 1.0f / det;
+
+    temp[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3);
+    temp[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3);
+    temp[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3);
+    temp[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3);
+
+    temp[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1);
+    temp[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1);
+    temp[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1);
+    temp[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1);
+
+    temp[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0);
+    temp[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0);
+    temp[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0);
+    temp[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0);
+
+    temp[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0);
+    temp[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0);
+    temp[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0);
+    temp[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0);
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            out[i][j] = temp[i][j] * invDet;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief inverse of rotation * scale * translation: the rotation part is orthogonal, so its inverse is its transpose
+ * with each row divided by its squared length
+ */
+Bool gf3d_matrix_invert_affine_scalar(Matrix4 out,Matrix4 m)
+{
+    int i,j;
+    float lengthSq;
+    Matrix4 temp;
+    for (i = 0; i < 3; i++)
+    {
+        lengthSq = m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2];
+        if (lengthSq < GF3D_MATRIX_EPSILON)return false;
+        for (j = 0; j < 3; j++)
+        {
+            temp[j][i] = m[i][j] / lengthSq;
+        }
+        temp[i][3] = 0;
+    }
+    for (j = 0; j < 3; j++)
+    {
+        temp[3][j] = -(m[3][0] * temp[0][j] + m[3][1] * temp[1][j] + m[3][2] * temp[2][j]);
+    }
+    temp[3][3] = 1;
+    memcpy(out,temp,sizeof(Matrix4));
+    return true;
+}
+
+void gf3d_matrix_invert_rigid_scalar(Matrix4 out,Matrix4 m)
+{
+    int i,j;
+    Matrix4 temp;
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            temp[j][i] = m[i][j];
+        }
+        temp[i][3] = 0;
+    }
+    for (j = 0; j < 3; j++)
+    {
+        temp[3][j] = -(m[3][0] * temp[0][j] + m[3][1] * temp[1][j] + m[3][2] * temp[2][j]);
+    }
+    temp[3][3] = 1;
+    memcpy(out,temp,sizeof(Matrix4));
+}
+
+/**
+ * @brief inverse transpose of the upper 3x3: its rows are the cross products of the other two rows over the determinant
+ */
+Bool gf3d_matrix_normal_scalar(Matrix4 out,Matrix4 m)
+{
+    int i;
+    float det;
+    Vector3D r[3],n[3];
+    for (i = 0; i < 3; i++)
+    {
+        vector3d_set(r[i],m[i][0],m[i][1],m[i][2]);
+    }
+    vector3d_cross_product(&n[0],r[1],r[2]);
+    vector3d_cross_product(&n[1],r[2],r[0]);
+    vector3d_cross_product(&n[2],r[0],r[1]);
+    det = vector3d_dot_product(r[0],n[0]);
+    if (fabs(det) < GF3D_MATRIX_EPSILON)return false;
+    gf3d_matrix_identity(out);
+    for (i = 0; i < 3; i++)
+    {
+        out[i][0] = n[i].x / det;
+        out[i][1] = n[i].y / det;
+        out[i][2] = n[i].z / det;
+    }
+    return true;
+}
+
+#ifdef GF3D_MATRIX_SSE
+
+/**
+ * SSE KERNELS
+ * row i of m2 * m1 is the sum of m2[i][k] times row k of m1.  The sums run in the same order as the scalar code
+ * and there is no fused multiply-add, so the multiply and point results match the scalar kernels bit for bit
+ */
+
+#define GF3D_MATRIX_SPLAT(v,k) _mm_shuffle_ps(v,v,_MM_SHUFFLE(k,k,k,k))
+
+void gf3d_matrix_multiply_sse(Matrix4 *out,Matrix4 *m1,Uint32 m1Step,Matrix4 *m2,Uint32 count)
+{
+    int i;
+    __m128 r0,r1,r2,r3;
+    __m128 a0,a1,a2,a3;
+    __m128 o0,o1,o2,o3;
+    float *b = &m1[0][0][0];
+    r0 = _mm_loadu_ps(b);
+    r1 = _mm_loadu_ps(b + 4);
+    r2 = _mm_loadu_ps(b + 8);
+    r3 = _mm_loadu_ps(b + 12);
+    for (i = 0; i < count; i++)
+    {
+        if ((i)&&(m1Step))
+        {
+            b = &m1[i * m1Step][0][0];
+            r0 = _mm_loadu_ps(b);
+            r1 = _mm_loadu_ps(b + 4);
+            r2 = _mm_loadu_ps(b + 8);
+            r3 = _mm_loadu_ps(b + 12);
+        }
+        a0 = _mm_loadu_ps(m2[i][0]);
+        a1 = _mm_loadu_ps(m2[i][1]);
+        a2 = _mm_loadu_ps(m2[i][2]);
+        a3 = _mm_loadu_ps(m2[i][3]);
+        o0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a0,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(a0,1),r1)),
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a0,2),r2)),_mm_mul_ps(GF3D_MATRIX_SPLAT(a0,3),r3));
+        o1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a1,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(a1,1),r1)),
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a1,2),r2)),_mm_mul_ps(GF3D_MATRIX_SPLAT(a1,3),r3));
+        o2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a2,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(a2,1),r1)),
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a2,2),r2)),_mm_mul_ps(GF3D_MATRIX_SPLAT(a2,3),r3));
+        o3 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a3,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(a3,1),r1)),
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(a3,2),r2)),_mm_mul_ps(GF3D_MATRIX_SPLAT(a3,3),r3));
+        // everything is read before anything is written, so out may alias either input
+        _mm_storeu_ps(out[i][0],o0);
+        _mm_storeu_ps(out[i][1],o1);
+        _mm_storeu_ps(out[i][2],o2);
+        _mm_storeu_ps(out[i][3],o3);
+    }
+}
+
+void gf3d_matrix_transform_sse(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count)
+{
+    int i;
+    __m128 r0,r1,r2,r3;
+    __m128 v;
+    r0 = _mm_loadu_ps(mat[0]);
+    r1 = _mm_loadu_ps(mat[1]);
+    r2 = _mm_loadu_ps(mat[2]);
+    r3 = _mm_loadu_ps(mat[3]);
+    for (i = 0; i < count; i++)
+    {
+        v = _mm_loadu_ps(&vec[i].x);
+        v = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(v,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(v,1),r1)),
+            _mm_mul_ps(GF3D_MATRIX_SPLAT(v,2),r2)),_mm_mul_ps(GF3D_MATRIX_SPLAT(v,3),r3));
+        _mm_storeu_ps(&out[i].x,v);
+    }
+}
+
+void gf3d_matrix_points_sse(Vector3D *out,Matrix4 mat,Vector3D *points,Uint32 count)
+{
+    int i;
+    __m128 r0,r1,r2,r3;
+    __m128 v;
+    r0 = _mm_loadu_ps(mat[0]);
+    r1 = _mm_loadu_ps(mat[1]);
+    r2 = _mm_loadu_ps(mat[2]);
+    r3 = _mm_loadu_ps(mat[3]);
+    for (i = 0; i < count; i++)
+    {
+        v = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(points[i].x),r0),_mm_mul_ps(_mm_set1_ps(points[i].y),r1)),
+            _mm_mul_ps(_mm_set1_ps(points[i].z),r2)),r3);
+        // a 4 wide store would run into the next point, which may not have been read yet
+        _mm_store_ss(&out[i].x,v);
+        _mm_store_ss(&out[i].y,GF3D_MATRIX_SPLAT(v,1));
+        _mm_store_ss(&out[i].z,GF3D_MATRIX_SPLAT(v,2));
+    }
+}
+
+void gf3d_matrix_transpose_sse(Matrix4 out,Matrix4 in)
+{
+    __m128 r0,r1,r2,r3;
+    r0 = _mm_loadu_ps(in[0]);
+    r1 = _mm_loadu_ps(in[1]);
+    r2 = _mm_loadu_ps(in[2]);
+    r3 = _mm_loadu_ps(in[3]);
+    _MM_TRANSPOSE4_PS(r0,r1,r2,r3);
+    _mm_storeu_ps(out[0],r0);
+    _mm_storeu_ps(out[1],r1);
+    _mm_storeu_ps(out[2],r2);
+    _mm_storeu_ps(out[3],r3);
+}
+
+// shuffles of 2x2 blocks stored as (m00,m01,m10,m11)
+#define GF3D_MATRIX_SWIZZLE(v,x,y,z,w) _mm_shuffle_ps(v,v,_MM_SHUFFLE(w,z,y,x))
+#define GF3D_MATRIX_SHUFFLE(a,b,x,y,z,w) _mm_shuffle_ps(a,b,_MM_SHUFFLE(w,z,y,x))
+
+/**
+ * @brief 2x2 a * b
+ */
+static inline __m128 gf3d_matrix_mat2_mul(__m128 a,__m128 b)
+{
+    return _mm_add_ps(
+        _mm_mul_ps(a,GF3D_MATRIX_SWIZZLE(b,0,3,0,3)),
+        _mm_mul_ps(GF3D_MATRIX_SWIZZLE(a,1,0,3,2),GF3D_MATRIX_SWIZZLE(b,2,1,2,1)));
+}
+
+/**
+ * @brief 2x2 adjugate(a) * b
+ */
+static inline __m128 gf3d_matrix_mat2_adj_mul(__m128 a,__m128 b)
+{
+    return _mm_sub_ps(
+        _mm_mul_ps(GF3D_MATRIX_SWIZZLE(a,3,3,0,0),b),
+        _mm_mul_ps(GF3D_MATRIX_SWIZZLE(a,1,1,2,2),GF3D_MATRIX_SWIZZLE(b,2,3,0,1)));
+}
+
+/**
+ * @brief 2x2 a * adjugate(b)
+ */
+static inline __m128 gf3d_matrix_mat2_mul_adj(__m128 a,__m128 b)
+{
+    return _mm_sub_ps(
+        _mm_mul_ps(a,GF3D_MATRIX_SWIZZLE(b,3,0,3,0)),
+        _mm_mul_ps(GF3D_MATRIX_SWIZZLE(a,1,0,3,2),GF3D_MATRIX_SWIZZLE(b,2,1,2,1)));
+}
+
+/**
+ * @brief inverse by 2x2 blocks: with M = |A B|, every block of the inverse is built from 2x2 products and adjugates
+ *                                        |C D|
+ */
+Bool gf3d_matrix_invert_sse(Matrix4 out,Matrix4 in)
+{
+    __m128 r0,r1,r2,r3;
+    __m128 a,b,c,d;
+    __m128 detSub,detA,detB,detC,detD,detM;
+    __m128 ab,dc,x,y,z,w,tr,rDetM;
+
+    r0 = _mm_loadu_ps(in[0]);
+    r1 = _mm_loadu_ps(in[1]);
+    r2 = _mm_loadu_ps(in[2]);
+    r3 = _mm_loadu_ps(in[3]);
+    a = _mm_movelh_ps(r0,r1);
+    b = _mm_movehl_ps(r1,r0);
+    c = _mm_movelh_ps(r2,r3);
+    d = _mm_movehl_ps(r3,r2);
+
+    // the four block determinants at once
+    detSub = _mm_sub_ps(
+        _mm_mul_ps(GF3D_MATRIX_SHUFFLE(r0,r2,0,2,0,2),GF3D_MATRIX_SHUFFLE(r1,r3,1,3,1,3)),
+        _mm_mul_ps(GF3D_MATRIX_SHUFFLE(r0,r2,1,3,1,3),GF3D_MATRIX_SHUFFLE(r1,r3,0,2,0,2)));
+    detA = GF3D_MATRIX_SWIZZLE(detSub,0,0,0,0);
+    detB = GF3D_MATRIX_SWIZZLE(detSub,1,1,1,1);
+    detC = GF3D_MATRIX_SWIZZLE(detSub,2,2,2,2);
+    detD = GF3D_MATRIX_SWIZZLE(detSub,3,3,3,3);
+
+    dc = gf3d_matrix_mat2_adj_mul(d,c);
+    ab = gf3d_matrix_mat2_adj_mul(a,b);
+    x = _mm_sub_ps(_mm_mul_ps(detD,a),gf3d_matrix_mat2_mul(b,dc));
+    w = _mm_sub_ps(_mm_mul_ps(detA,d),gf3d_matrix_mat2_mul(c,ab));
+    y = _mm_sub_ps(_mm_mul_ps(detB,c),gf3d_matrix_mat2_mul_adj(d,ab));
+    z = _mm_sub_ps(_mm_mul_ps(detC,b),gf3d_matrix_mat2_mul_adj(a,dc));
+
+    // |M| = |A||D| + |B||C| - trace(adj(A)B adj(D)C)
+    tr = _mm_mul_ps(ab,GF3D_MATRIX_SWIZZLE(dc,0,2,1,3));
+    tr = _mm_add_ps(tr,GF3D_MATRIX_SWIZZLE(tr,1,0,3,2));
+    tr = _mm_add_ps(tr,GF3D_MATRIX_SWIZZLE(tr,2,3,0,1));
+    detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA,detD),_mm_mul_ps(detB,detC)),tr);
+    if (_mm_cvtss_f32(detM) == 0)return false;
+
+    rDetM = _mm_div_ps(_mm_setr_ps(1.0f,-1.0f,-1.0f,1.0f),detM);
+    x = _mm_mul_ps(x,rDetM);
+    y = _mm_mul_ps(y,rDetM);
+    z = _mm_mul_ps(z,rDetM);
+    w = _mm_mul_ps(w,rDetM);
+
+    // the last adjugate swap is folded into the shuffles back to rows
+    _mm_storeu_ps(out[0],GF3D_MATRIX_SHUFFLE(x,y,3,1,3,1));
+    _mm_storeu_ps(out[1],GF3D_MATRIX_SHUFFLE(x,y,2,0,2,0));
+    _mm_storeu_ps(out[2],GF3D_MATRIX_SHUFFLE(z,w,3,1,3,1));
+    _mm_storeu_ps(out[3],GF3D_MATRIX_SHUFFLE(z,w,2,0,2,0));
+    return true;
+}
+
+/**
+ * @brief shared tail of the affine inverses: transpose the prepared 3x3 rows and move the translation into its space
+ */
+static inline void gf3d_matrix_affine_finish_sse(Matrix4 out,__m128 r0,__m128 r1,__m128 r2,__m128 t)
+{
+    __m128 r3 = _mm_setzero_ps();
+    __m128 inverseT;
+    _MM_TRANSPOSE4_PS(r0,r1,r2,r3);
+    // the rows came in with w = 0, so the transposed columns are (x,y,z,0) and r3 is all zero
+    inverseT = _mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(GF3D_MATRIX_SPLAT(t,0),r0),_mm_mul_ps(GF3D_MATRIX_SPLAT(t,1),r1)),
+        _mm_mul_ps(GF3D_MATRIX_SPLAT(t,2),r2));
+    inverseT = _mm_sub_ps(_mm_setr_ps(0.0f,0.0f,0.0f,1.0f),inverseT);
+    _mm_storeu_ps(out[0],r0);
+    _mm_storeu_ps(out[1],r1);
+    _mm_storeu_ps(out[2],r2);
+    _mm_storeu_ps(out[3],inverseT);
+}
+
+Bool gf3d_matrix_invert_affine_sse(Matrix4 out,Matrix4 in)
+{
+    __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1,-1,-1,0));
+    __m128 r0,r1,r2,t;
+    __m128 lengthSq;
+
+    r0 = _mm_and_ps(_mm_loadu_ps(in[0]),mask);
+    r1 = _mm_and_ps(_mm_loadu_ps(in[1]),mask);
+    r2 = _mm_and_ps(_mm_loadu_ps(in[2]),mask);
+    t = _mm_loadu_ps(in[3]);
+    // squared row lengths in lanes 0,1,2
+    {
+        __m128 s0 = _mm_mul_ps(r0,r0);
+        __m128 s1 = _mm_mul_ps(r1,r1);
+        __m128 s2 = _mm_mul_ps(r2,r2);
+        __m128 s3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(s0,s1,s2,s3);
+        lengthSq = _mm_add_ps(_mm_add_ps(s0,s1),s2);
+    }
+    if (_mm_movemask_ps(_mm_cmplt_ps(lengthSq,_mm_set1_ps(GF3D_MATRIX_EPSILON))) & 7)return false;
+    lengthSq = _mm_or_ps(lengthSq,_mm_andnot_ps(mask,_mm_set1_ps(1.0f)));   // keep lane 3 away from 0/0
+    r0 = _mm_div_ps(r0,GF3D_MATRIX_SPLAT(lengthSq,0));
+    r1 = _mm_div_ps(r1,GF3D_MATRIX_SPLAT(lengthSq,1));
+    r2 = _mm_div_ps(r2,GF3D_MATRIX_SPLAT(lengthSq,2));
+    gf3d_matrix_affine_finish_sse(out,r0,r1,r2,t);
+    return true;
+}
+
+void gf3d_matrix_invert_rigid_sse(Matrix4 out,Matrix4 in)
+{
+    __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1,-1,-1,0));
+    gf3d_matrix_affine_finish_sse(
+        out,
+        _mm_and_ps(_mm_loadu_ps(in[0]),mask),
+        _mm_and_ps(_mm_loadu_ps(in[1]),mask),
+        _mm_and_ps(_mm_loadu_ps(in[2]),mask),
+        _mm_loadu_ps(in[3]));
+}
+
+/**
+ * @brief a x b for (x,y,z,0) vectors, the w lane stays 0
+ */
+static inline __m128 gf3d_matrix_cross_sse(__m128 a,__m128 b)
+{
+    __m128 c = _mm_sub_ps(
+        _mm_mul_ps(a,GF3D_MATRIX_SWIZZLE(b,1,2,0,3)),
+        _mm_mul_ps(GF3D_MATRIX_SWIZZLE(a,1,2,0,3),b));
+    return GF3D_MATRIX_SWIZZLE(c,1,2,0,3);
+}
+
+Bool gf3d_matrix_normal_sse(Matrix4 out,Matrix4 in)
+{
+    __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1,-1,-1,0));
+    __m128 r0,r1,r2,n0,n1,n2,det;
+
+    r0 = _mm_and_ps(_mm_loadu_ps(in[0]),mask);
+    r1 = _mm_and_ps(_mm_loadu_ps(in[1]),mask);
+    r2 = _mm_and_ps(_mm_loadu_ps(in[2]),mask);
+    n0 = gf3d_matrix_cross_sse(r1,r2);
+    n1 = gf3d_matrix_cross_sse(r2,r0);
+    n2 = gf3d_matrix_cross_sse(r0,r1);
+    det = _mm_mul_ps(r0,n0);
+    det = _mm_add_ps(det,GF3D_MATRIX_SWIZZLE(det,1,0,3,2));
+    det = _mm_add_ps(det,GF3D_MATRIX_SWIZZLE(det,2,3,0,1));
+    if (fabs(_mm_cvtss_f32(det)) < GF3D_MATRIX_EPSILON)return false;
+    _mm_storeu_ps(out[0],_mm_div_ps(n0,det));
+    _mm_storeu_ps(out[1],_mm_div_ps(n1,det));
+    _mm_storeu_ps(out[2],_mm_div_ps(n2,det));
+    _mm_storeu_ps(out[3],_mm_setr_ps(0.0f,0.0f,0.0f,1.0f));
+    return true;
+}
+
+#endif
+
+#ifdef GF3D_MATRIX_AVX
+
+/**
+ * AVX KERNELS
+ * two matrix rows, or two vectors, per register: lane 0 holds one and lane 1 the next.  _mm256_permute_ps
+ * broadcasts within each lane, so each lane does exactly the SSE arithmetic
+ */
+
+#define GF3D_MATRIX_SPLAT8(v,k) _mm256_permute_ps(v,_MM_SHUFFLE(k,k,k,k))
+
+GF3D_MATRIX_TARGET_AVX void gf3d_matrix_multiply_avx(Matrix4 *out,Matrix4 *m1,Uint32 m1Step,Matrix4 *m2,Uint32 count)
+{
+    int i;
+    __m256 r0,r1,r2,r3;
+    __m256 a01,a23;
+    __m256 o01,o23;
+    float *b = &m1[0][0][0];
+    r0 = _mm256_broadcast_ps((const __m128 *)b);
+    r1 = _mm256_broadcast_ps((const __m128 *)(b + 4));
+    r2 = _mm256_broadcast_ps((const __m128 *)(b + 8));
+    r3 = _mm256_broadcast_ps((const __m128 *)(b + 12));
+    for (i = 0; i < count; i++)
+    {
+        if ((i)&&(m1Step))
+        {
+            b = &m1[i * m1Step][0][0];
+            r0 = _mm256_broadcast_ps((const __m128 *)b);
+            r1 = _mm256_broadcast_ps((const __m128 *)(b + 4));
+            r2 = _mm256_broadcast_ps((const __m128 *)(b + 8));
+            r3 = _mm256_broadcast_ps((const __m128 *)(b + 12));
+        }
+        a01 = _mm256_loadu_ps(m2[i][0]);
+        a23 = _mm256_loadu_ps(m2[i][2]);
+        o01 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(a01,0),r0),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(a01,1),r1)),
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(a01,2),r2)),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(a01,3),r3));
+        o23 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(a23,0),r0),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(a23,1),r1)),
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(a23,2),r2)),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(a23,3),r3));
+        _mm256_storeu_ps(out[i][0],o01);
+        _mm256_storeu_ps(out[i][2],o23);
+    }
+    _mm256_zeroupper();
+}
+
+GF3D_MATRIX_TARGET_AVX void gf3d_matrix_transform_avx(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count)
+{
+    int i;
+    __m256 r0,r1,r2,r3;
+    __m256 v;
+    r0 = _mm256_broadcast_ps((const __m128 *)mat[0]);
+    r1 = _mm256_broadcast_ps((const __m128 *)mat[1]);
+    r2 = _mm256_broadcast_ps((const __m128 *)mat[2]);
+    r3 = _mm256_broadcast_ps((const __m128 *)mat[3]);
+    for (i = 0; i + 2 <= count; i += 2)
+    {
+        v = _mm256_loadu_ps(&vec[i].x);
+        v = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(v,0),r0),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(v,1),r1)),
+            _mm256_mul_ps(GF3D_MATRIX_SPLAT8(v,2),r2)),_mm256_mul_ps(GF3D_MATRIX_SPLAT8(v,3),r3));
+        _mm256_storeu_ps(&out[i].x,v);
+    }
+    _mm256_zeroupper();
+    if (i < count)gf3d_matrix_transform_sse(&out[i],mat,&vec[i],count - i);
+}
+
+#endif
+
+/**
+ * DISPATCH
+ */
+
+Bool gf3d_matrix_cpu_has_avx()
+{
+#if defined(_MSC_VER) && defined(GF3D_MATRIX_AVX)
+    int info[4];
+    __cpuid(info,1);
+    // the CPU must support AVX and the OS must save the YMM registers
+    if (!((info[2] & (1 << 27)) && (info[2] & (1 << 28))))return false;
+    return ((_xgetbv(0) & 6) == 6);
+#elif defined(GF3D_MATRIX_AVX)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+MatrixSimd gf3d_matrix_simd_set(MatrixSimd simd)
+{
+    if ((simd >= MS_AVX)&&(!gf3d_matrix_cpu_has_avx()))simd = MS_SSE;
+#ifndef GF3D_MATRIX_SSE
+    simd = MS_Scalar;
+#endif
+    switch (simd)
+    {
+#ifdef GF3D_MATRIX_AVX
+        case MS_AVX:
+        case MS_MAX:
+            gf3d_matrix_kernels.multiply = gf3d_matrix_multiply_avx;
+            gf3d_matrix_kernels.transform = gf3d_matrix_transform_avx;
+            // three float stores per point cost more than the math, two points per register does not pay
+            gf3d_matrix_kernels.points = gf3d_matrix_points_sse;
+            // a single matrix fits in four SSE registers, these have nothing to fill the other half with
+            gf3d_matrix_kernels.invert = gf3d_matrix_invert_sse;
+            gf3d_matrix_kernels.invertAffine = gf3d_matrix_invert_affine_sse;
+            gf3d_matrix_kernels.invertRigid = gf3d_matrix_invert_rigid_sse;
+            gf3d_matrix_kernels.transpose = gf3d_matrix_transpose_sse;
+            gf3d_matrix_kernels.normal = gf3d_matrix_normal_sse;
+            simd = MS_AVX;
+            break;
+#endif
+#ifdef GF3D_MATRIX_SSE
+        case MS_SSE:
+            gf3d_matrix_kernels.multiply = gf3d_matrix_multiply_sse;
+            gf3d_matrix_kernels.transform = gf3d_matrix_transform_sse;
+            gf3d_matrix_kernels.points = gf3d_matrix_points_sse;
+            gf3d_matrix_kernels.invert = gf3d_matrix_invert_sse;
+            gf3d_matrix_kernels.invertAffine = gf3d_matrix_invert_affine_sse;
+            gf3d_matrix_kernels.invertRigid = gf3d_matrix_invert_rigid_sse;
+            gf3d_matrix_kernels.transpose = gf3d_matrix_transpose_sse;
+            gf3d_matrix_kernels.normal = gf3d_matrix_normal_sse;
+            break;
+#endif
+        default:
+            gf3d_matrix_kernels.multiply = gf3d_matrix_multiply_scalar;
+            gf3d_matrix_kernels.transform = gf3d_matrix_transform_scalar;
+            gf3d_matrix_kernels.points = gf3d_matrix_points_scalar;
+            gf3d_matrix_kernels.invert = gf3d_matrix_invert_scalar;
+            gf3d_matrix_kernels.invertAffine = gf3d_matrix_invert_affine_scalar;
+            gf3d_matrix_kernels.invertRigid = gf3d_matrix_invert_rigid_scalar;
+            gf3d_matrix_kernels.transpose = gf3d_matrix_transpose_scalar;
+            gf3d_matrix_kernels.normal = gf3d_matrix_normal_scalar;
+            simd = MS_Scalar;
+            break;
+    }
+    gf3d_matrix_kernels.simd = simd;
+    return simd;
+}
+
+/**
+ * @brief pick the best kernels the first time they are needed
+ * @note racing threads all store the same pointers, so no lock is needed
+ */
+static inline void gf3d_matrix_kernels_check()
+{
+    if (!gf3d_matrix_kernels.multiply)gf3d_matrix_simd_set(MS_MAX);
+}
+
+MatrixSimd gf3d_matrix_simd_get()
+{
+    gf3d_matrix_kernels_check();
+    return gf3d_matrix_kernels.simd;
+}
+
+const char *gf3d_matrix_simd_name(MatrixSimd simd)
+{
+    switch (simd)
+    {
+        case MS_Scalar:
+            return "scalar";
+        case MS_SSE:
+            return "sse";
+        case MS_AVX:
+            return "avx";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * MULTIPLY
+ */
+
 void gf3d_matrix_multiply(
     Matrix4 out,
     Matrix4 m1,
     Matrix4 m2
   )
 {
+    if ((!out)||(!m1)||(!m2))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.multiply((Matrix4 *)out,(Matrix4 *)m1,0,(Matrix4 *)m2,1);
+}
 
-  out[0][0] = m2[0][0]*m1[0][0] + m2[0][1]*m1[1][0] + m2[0][2]*m1[2][0] + m2[0][3]*m1[3][0];
-  out[0][1] = m2[0][0]*m1[0][1] + m2[0][1]*m1[1][1] + m2[0][2]*m1[2][1] + m2[0][3]*m1[3][1];
-  out[0][2] = m2[0][0]*m1[0][2] + m2[0][1]*m1[1][2] + m2[0][2]*m1[2][2] + m2[0][3]*m1[3][2];
-  out[0][3] = m2[0][0]*m1[0][3] + m2[0][1]*m1[1][3] + m2[0][2]*m1[2][3] + m2[0][3]*m1[3][3];
-
-  out[1][0] = m2[1][0]*m1[0][0] + m2[1][1]*m1[1][0] + m2[1][2]*m1[2][0] + m2[1][3]*m1[3][0];
-  out[1][1] = m2[1][0]*m1[0][1] + m2[1][1]*m1[1][1] + m2[1][2]*m1[2][1] + m2[1][3]*m1[3][1];
-  out[1][2] = m2[1][0]*m1[0][2] + m2[1][1]*m1[1][2] + m2[1][2]*m1[2][2] + m2[1][3]*m1[3][2];
-  out[1][3] = m2[1][0]*m1[0][3] + m2[1][1]*m1[1][3] + m2[1][2]*m1[2][3] + m2[1][3]*m1[3][3];
-
-  out[2][0] = m2[2][0]*m1[0][0] + m2[2][1]*m1[1][0] + m2[2][2]*m1[2][0] + m2[2][3]*m1[3][0];
-  out[2][1] = m2[2][0]*m1[0][1] + m2[2][1]*m1[1][1] + m2[2][2]*m1[2][1] + m2[2][3]*m1[3][1];
-  out[2][2] = m2[2][0]*m1[0][2] + m2[2][1]*m1[1][2] + m2[2][2]*m1[2][2] + m2[2][3]*m1[3][2];
-  out[2][3] = m2[2][0]*m1[0][3] + m2[2][1]*m1[1][3] + m2[2][2]*m1[2][3] + m2[2][3]*m1[3][3];
+void gf3d_matrix_multiply_array(Matrix4 *out,Matrix4 m1,Matrix4 *m2,Uint32 count)
+{
+    if ((!out)||(!m1)||(!m2)||(!count))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.multiply(out,(Matrix4 *)m1,0,m2,count);
+}
 
-  out[3][0] = m2[3][0]*m1[0][0] + m2[3][1]*m1[1][0] + m2[3][2]*m1[2][0] + m2[3][3]*m1[3][0];
-  out[3][1] = m2[3][0]*m1[0][1] + m2[3][1]*m1[1][1] + m2[3][2]*m1[2][1] + m2[3][3]*m1[3][1];
-  out[3][2] = m2[3][0]*m1[0][2] + m2[3][1]*m1[1][2] + m2[3][2]*m1[2][2] + m2[3][3]*m1[3][2];
-  out[3][3] = m2[3][0]*m1[0][3] + m2[3][1]*m1[1][3] + m2[3][2]*m1[2][3] + m2[3][3]*m1[3][3];
+void gf3d_matrix_multiply_pairs(Matrix4 *out,Matrix4 *m1,Matrix4 *m2,Uint32 count)
+{
+    if ((!out)||(!m1)||(!m2)||(!count))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.multiply(out,m1,1,m2,count);
 }
 
 void gf3d_matrix_multiply_vector4d(
@@ -57,21 +779,163 @@ void gf3d_matrix_multiply_vector4d(
   Vector4D   vec
 )
 {
-  double x,y,z,w;
-  double ox,oy,oz,ow;
   if (!out)return;
-  x=vec.x;
-  y=vec.y;
-  z=vec.z;
-  w=vec.w;
-  ox=x*mat[0][0] + y*mat[1][0] + mat[2][0]*z + mat[3][0]*w;
-  oy=x*mat[0][1] + y*mat[1][1] + mat[2][1]*z + mat[3][1]*w;
-  oz=x*mat[0][2] + y*mat[1][2] + mat[2][2]*z + mat[3][2]*w;
-  ow=x*mat[0][3] + y*mat[1][3] + mat[2][3]*z + mat[3][3]*w;
-  out->x = ox;
-  out->y = oy;
-  out->z = oz;
-  out->w = ow;
+  gf3d_matrix_kernels_check();
+  gf3d_matrix_kernels.transform(out,mat,&vec,1);
+}
+
+void gf3d_matrix_transform_vector4d_array(Vector4D *out,Matrix4 mat,Vector4D *vec,Uint32 count)
+{
+    if ((!out)||(!mat)||(!vec)||(!count))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.transform(out,mat,vec,count);
+}
+
+void gf3d_matrix_transform_points(Vector3D *out,Matrix4 mat,Vector3D *points,Uint32 count)
+{
+    if ((!out)||(!mat)||(!points)||(!count))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.points(out,mat,points,count);
+}
+
+/**
+ * INVERSE AND TRANSPOSE
+ */
+
+Bool gf3d_matrix_invert(Matrix4 out,Matrix4 in)
+{
+    if ((!out)||(!in))return false;
+    gf3d_matrix_kernels_check();
+    return gf3d_matrix_kernels.invert(out,in);
+}
+
+Bool gf3d_matrix_invert_affine(Matrix4 out,Matrix4 in)
+{
+    if ((!out)||(!in))return false;
+    gf3d_matrix_kernels_check();
+    return gf3d_matrix_kernels.invertAffine(out,in);
+}
+
+void gf3d_matrix_invert_rigid(Matrix4 out,Matrix4 in)
+{
+    if ((!out)||(!in))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.invertRigid(out,in);
+}
+
+void gf3d_matrix_transpose(Matrix4 out,Matrix4 in)
+{
+    if ((!out)||(!in))return;
+    gf3d_matrix_kernels_check();
+    gf3d_matrix_kernels.transpose(out,in);
+}
+
+Bool gf3d_matrix_normal(Matrix4 out,Matrix4 model)
+{
+    if ((!out)||(!model))return false;
+    gf3d_matrix_kernels_check();
+    return gf3d_matrix_kernels.normal(out,model);
+}
+
+/**
+ * TRS
+ */
+
+void gf3d_matrix_make_rotation(Matrix4 out,Vector4D rotation)
+{
+    float x = rotation.x,y = rotation.y,z = rotation.z,w = rotation.w;
+    if (!out)return;
+    gf3d_matrix_identity(out);
+    // row i is where axis i ends up
+    out[0][0] = 1 - 2 * (y * y + z * z);
+    out[0][1] = 2 * (x * y + w * z);
+    out[0][2] = 2 * (x * z - w * y);
+    out[1][0] = 2 * (x * y - w * z);
+    out[1][1] = 1 - 2 * (x * x + z * z);
+    out[1][2] = 2 * (y * z + w * x);
+    out[2][0] = 2 * (x * z + w * y);
+    out[2][1] = 2 * (y * z - w * x);
+    out[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+void gf3d_matrix_compose(Matrix4 out,Vector3D translation,Vector4D rotation,Vector3D scale)
+{
+    int i;
+    if (!out)return;
+    gf3d_matrix_make_rotation(out,rotation);
+    for (i = 0; i < 3; i++)
+    {
+        out[0][i] *= scale.x;
+        out[1][i] *= scale.y;
+        out[2][i] *= scale.z;
+    }
+    out[3][0] = translation.x;
+    out[3][1] = translation.y;
+    out[3][2] = translation.z;
+}
+
+Bool gf3d_matrix_decompose(Matrix4 in,Vector3D *translation,Vector4D *rotation,Vector3D *scale)
+{
+    int i;
+    float s[3];
+    float r[3][3];
+    float trace,root;
+    Vector3D row[3],cross;
+
+    if (!in)return false;
+    if (translation)vector3d_set((*translation),in[3][0],in[3][1],in[3][2]);
+    for (i = 0; i < 3; i++)
+    {
+        vector3d_set(row[i],in[i][0],in[i][1],in[i][2]);
+        s[i] = vector3d_magnitude(row[i]);
+        if (s[i] < GF3D_MATRIX_EPSILON)return false;
+    }
+    // a mirrored basis is reported as a negative x scale
+    vector3d_cross_product(&cross,row[0],row[1]);
+    if (vector3d_dot_product(cross,row[2]) < 0)s[0] = -s[0];
+    if (scale)vector3d_set((*scale),s[0],s[1],s[2]);
+    if (!rotation)return true;
+    for (i = 0; i < 3; i++)
+    {
+        r[i][0] = in[i][0] / s[i];
+        r[i][1] = in[i][1] / s[i];
+        r[i][2] = in[i][2] / s[i];
+    }
+    // the inverse of gf3d_matrix_make_rotation, from the largest of w, x, y, z to stay accurate
+    trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0)
+    {
+        root = sqrt(trace + 1.0f) * 2;
+        rotation->w = 0.25f * root;
+        rotation->x = (r[1][2] - r[2][1]) / root;
+        rotation->y = (r[2][0] - r[0][2]) / root;
+        rotation->z = (r[0][1] - r[1][0]) / root;
+    }
+    else if ((r[0][0] > r[1][1])&&(r[0][0] > r[2][2]))
+    {
+        root = sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2;
+        rotation->w = (r[1][2] - r[2][1]) / root;
+        rotation->x = 0.25f * root;
+        rotation->y = (r[1][0] + r[0][1]) / root;
+        rotation->z = (r[2][0] + r[0][2]) / root;
+    }
+    else if (r[1][1] > r[2][2])
+    {
+        root = sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2;
+        rotation->w = (r[2][0] - r[0][2]) / root;
+        rotation->x = (r[1][0] + r[0][1]) / root;
+        rotation->y = 0.25f * root;
+        rotation->z = (r[2][1] + r[1][2]) / root;
+    }
+    else
+    {
+        root = sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2;
+        rotation->w = (r[0][1] - r[1][0]) / root;
+        rotation->x = (r[2][0] + r[0][2]) / root;
+        rotation->y = (r[2][1] + r[1][2]) / root;
+        rotation->z = 0.25f * root;
+    }
+    return true;
 }
 
 void gf3d_matrix_zero(Matrix4 zero)
@@ -169,9 +1033,9 @@ void gf3d_matrix_make_translation(
 {
     if (!out)return;
     gf3d_matrix_identity(out);
-    out[0][3] = move.x;
-    out[1][3] = move.y;
-    out[2][3] = move.z;
+    out[3][0] = move.x;
+    out[3][1] = move.y;
+    out[3][2] = move.z;
 }
 
 void gf3d_matrix_translate(
@@ -0,0 +1,563 @@
+#define SLOG_CATEGORY "memory"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gf3d_memory.h"
+#include "gf3d_trace.h"
+#include "simple_logger.h"
+
+#define GF3D_MEMORY_TABLE_START     1024    // tracked allocations before the table first grows, a power of two
+#define GF3D_MEMORY_LEAK_SITES      64      // leaks from more places than this are only counted
+
+typedef struct
+{
+    void           *data;       /**<NULL for an empty entry*/
+    Uint64          size;
+    const char     *file;
+    Uint32          line;
+    MemoryTag       tag;
+}MemoryRecord;
+
+typedef struct
+{
+    const char     *file;
+    Uint32          line;
+    MemoryTag       tag;
+    Uint32          count;
+    Uint64          bytes;
+}MemoryLeakSite;
+
+typedef struct
+{
+    SDL_SpinLock    lock;
+    MemoryRecord   *table;      /**<open addressing by address, at most half full*/
+    Uint32          tableSize;
+    Uint32          recordCount;
+    MemoryTagStats  tags[MT_MAX];
+}MemoryTracker;
+
+typedef struct
+{
+    MemoryArena     frame;
+    MemoryArena     scratch;
+    SDL_atomic_t    heapAllocations;
+    Uint32          frameStartAllocations;  /**<the heap count when the current frame began*/
+    Uint32          frames;
+    Uint32          lastFrameAllocations;
+    Uint32          allocatingFrames;
+}MemoryManager;
+
+static MemoryManager gf3d_memory = {0};
+
+// kept apart from the manager: tracking works before init and after close
+static MemoryTracker gf3d_memory_tracker = {0};
+
+static const char *gf3d_memory_tag_names[MT_MAX] = {
+    "general",
+    "graphics",
+    "swapchain",
+    "pipeline",
+    "descriptors",
+    "mesh",
+    "model",
+    "texture",
+    "render",
+    "scene",
+    "physics",
+    "logger",
+    "trace",
+    "arena"
+};
+
+void gf3d_memory_close();
+
+void gf3d_memory_init(size_t frameSize,size_t scratchSize)
+{
+    if (gf3d_memory.frame.data)
+    {
+        slog("memory manager is already initialized");
+        return;
+    }
+    if (!gf3d_arena_create(&gf3d_memory.frame,"frame",frameSize))return;
+    if (!gf3d_arena_create(&gf3d_memory.scratch,"scratch",scratchSize))
+    {
+        gf3d_arena_free(&gf3d_memory.frame);
+        return;
+    }
+    // the logger starts first and cleans up after this, so its queue is counted while the memory manager runs
+    gf3d_memory_host_allocated(MT_Logger,slog_get_memory_usage());
+    atexit(gf3d_memory_close);
+    slog("memory initialized with a %u byte frame arena and a %u byte scratch arena",(Uint32)frameSize,(Uint32)scratchSize);
+}
+
+void gf3d_memory_close()
+{
+    MemoryStats stats;
+    gf3d_memory_get_stats(&stats);
+    slog("memory: %u heap allocations, %u frames, %u of them past the warmup allocated from the heap",
+        stats.heapAllocations,
+        stats.frames,
+        stats.allocatingFrames);
+    slog("memory: frame arena peak %u of %u bytes, scratch arena peak %u of %u bytes, %u overflows",
+        (Uint32)stats.frameArenaPeak,
+        (Uint32)gf3d_memory.frame.size,
+        (Uint32)stats.scratchArenaPeak,
+        (Uint32)gf3d_memory.scratch.size,
+        stats.arenaOverflows);
+    gf3d_arena_free(&gf3d_memory.frame);
+    gf3d_arena_free(&gf3d_memory.scratch);
+    gf3d_memory_report();
+    gf3d_memory_host_freed(MT_Logger,slog_get_memory_usage());
+    gf3d_memory_report_leaks();
+    memset(&gf3d_memory,0,sizeof(MemoryManager));
+}
+
+void gf3d_memory_begin_frame()
+{
+    Uint32 heap;
+    heap = SDL_AtomicGet(&gf3d_memory.heapAllocations);
+    if (gf3d_memory.frames)
+    {
+        gf3d_memory.lastFrameAllocations = heap - gf3d_memory.frameStartAllocations;
+        if ((gf3d_memory.lastFrameAllocations)&&(gf3d_memory.frames > GF3D_MEMORY_WARMUP_FRAMES))
+        {
+            // once is enough to go looking, the total is logged at exit
+            if (!gf3d_memory.allocatingFrames)
+            {
+                slog_warn("frame %u made %u heap allocations, steady state frames should make none",
+                    gf3d_memory.frames,
+                    gf3d_memory.lastFrameAllocations);
+            }
+            gf3d_memory.allocatingFrames++;
+        }
+        GF3D_TRACE_COUNTER("frame heap allocations",gf3d_memory.lastFrameAllocations);
+        GF3D_TRACE_COUNTER("frame arena bytes",gf3d_memory.frame.used);
+    }
+    gf3d_arena_reset(&gf3d_memory.frame);
+    gf3d_memory.frameStartAllocations = heap;
+    gf3d_memory.frames++;
+}
+
+void gf3d_memory_count_heap()
+{
+    SDL_AtomicIncRef(&gf3d_memory.heapAllocations);
+}
+
+void gf3d_memory_get_stats(MemoryStats *stats)
+{
+    if (!stats)return;
+    stats->heapAllocations = SDL_AtomicGet(&gf3d_memory.heapAllocations);
+    stats->frames = gf3d_memory.frames;
+    stats->lastFrameAllocations = gf3d_memory.lastFrameAllocations;
+    stats->allocatingFrames = gf3d_memory.allocatingFrames;
+    stats->frameArenaPeak = gf3d_memory.frame.peak;
+    stats->scratchArenaPeak = gf3d_memory.scratch.peak;
+    stats->arenaOverflows = gf3d_memory.frame.overflows + gf3d_memory.scratch.overflows;
+}
+
+void *gf3d_frame_allocate_array(size_t typeSize,size_t count)
+{
+    return gf3d_arena_allocate_array(&gf3d_memory.frame,typeSize,count);
+}
+
+MemoryScratch gf3d_scratch_begin()
+{
+    MemoryScratch scratch;
+    scratch.arena = &gf3d_memory.scratch;
+    scratch.mark = gf3d_memory.scratch.used;
+    return scratch;
+}
+
+void gf3d_scratch_end(MemoryScratch scratch)
+{
+    if (!scratch.arena)return;
+    if (scratch.mark > scratch.arena->used)
+    {
+        slog_error("scratch scopes ended out of order");
+        return;
+    }
+    scratch.arena->used = scratch.mark;
+}
+
+/**
+ * TAGGED ALLOCATIONS
+ */
+
+/**
+ * @brief where the search for an address starts in a table of a size
+ */
+static Uint32 gf3d_memory_hash(const void *data,Uint32 tableSize)
+{
+    Uint64 key = (Uint64)(size_t)data >> 4;    // heap addresses are aligned, the low bits say nothing
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (Uint32)(key >> 32) & (tableSize - 1);
+}
+
+/**
+ * @brief find the entry for an address, or the empty entry where it would go.  Call with the lock held
+ */
+static MemoryRecord *gf3d_memory_find(const void *data)
+{
+    Uint32 i;
+    i = gf3d_memory_hash(data,gf3d_memory_tracker.tableSize);
+    while ((gf3d_memory_tracker.table[i].data)&&(gf3d_memory_tracker.table[i].data != data))
+    {
+        i = (i + 1) & (gf3d_memory_tracker.tableSize - 1);
+    }
+    return &gf3d_memory_tracker.table[i];
+}
+
+/**
+ * @brief double the table, or make it.  Call with the lock held
+ * @return false if the memory could not be allocated
+ */
+static Bool gf3d_memory_table_grow()
+{
+    Uint32 i;
+    Uint32 oldSize = gf3d_memory_tracker.tableSize;
+    MemoryRecord *old = gf3d_memory_tracker.table;
+    MemoryRecord *table;
+    Uint32 size = oldSize?oldSize * 2:GF3D_MEMORY_TABLE_START;
+
+    // the table is the tracker's own memory, it is not tracked or counted
+    table = (MemoryRecord *)calloc(size,sizeof(MemoryRecord));
+    if (!table)return false;
+    gf3d_memory_tracker.table = table;
+    gf3d_memory_tracker.tableSize = size;
+    for (i = 0; i < oldSize; i++)
+    {
+        if (!old[i].data)continue;
+        *gf3d_memory_find(old[i].data) = old[i];
+    }
+    if (old)free(old);
+    return true;
+}
+
+/**
+ * @brief take an entry out of the table, moving back later entries of its run so every search still finds them.
+ * Call with the lock held
+ */
+static void gf3d_memory_remove(MemoryRecord *record)
+{
+    Uint32 hole,i,home;
+    Uint32 mask = gf3d_memory_tracker.tableSize - 1;
+    MemoryUsage *usage = &gf3d_memory_tracker.tags[record->tag].host;
+
+    usage->liveBytes -= record->size;
+    usage->liveCount--;
+    gf3d_memory_tracker.recordCount--;
+    hole = (Uint32)(record - gf3d_memory_tracker.table);
+    i = hole;
+    for (;;)
+    {
+        i = (i + 1) & mask;
+        if (!gf3d_memory_tracker.table[i].data)break;
+        home = gf3d_memory_hash(gf3d_memory_tracker.table[i].data,gf3d_memory_tracker.tableSize);
+        // an entry can fill the hole if the hole lies between where it belongs and where it is
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            gf3d_memory_tracker.table[hole] = gf3d_memory_tracker.table[i];
+            hole = i;
+        }
+    }
+    memset(&gf3d_memory_tracker.table[hole],0,sizeof(MemoryRecord));
+}
+
+/**
+ * @brief add to a usage count
+ */
+static void gf3d_memory_usage_add(MemoryUsage *usage,Uint64 bytes)
+{
+    usage->liveBytes += bytes;
+    usage->liveCount++;
+    usage->allocations++;
+    if (usage->liveBytes > usage->peakBytes)usage->peakBytes = usage->liveBytes;
+}
+
+/**
+ * @brief take from a usage count, never below zero
+ */
+static void gf3d_memory_usage_remove(MemoryUsage *usage,Uint64 bytes)
+{
+    usage->liveBytes -= MIN(bytes,usage->liveBytes);
+    if (usage->liveCount)usage->liveCount--;
+}
+
+void *_gf3d_memory_allocate(MemoryTag tag,size_t typeSize,size_t count,const char *file,int line)
+{
+    void *data;
+    MemoryRecord *record;
+    if ((tag < 0)||(tag >= MT_MAX))tag = MT_General;
+    if ((!typeSize)||(!count))
+    {
+        slog("cannot allocate zero elements");
+        return NULL;
+    }
+    if (count > ((size_t)-1) / typeSize)
+    {
+        slog_error("array of %u elements of size %u is too large",(Uint32)count,(Uint32)typeSize);
+        return NULL;
+    }
+    data = calloc(count,typeSize);
+    if (!data)
+    {
+        slog_error("failed to allocate %u elements of size %u for %s",(Uint32)count,(Uint32)typeSize,gf3d_memory_tag_names[tag]);
+        return NULL;
+    }
+    gf3d_memory_count_heap();
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    if ((gf3d_memory_tracker.recordCount + 1) * 2 > gf3d_memory_tracker.tableSize)
+    {
+        if (!gf3d_memory_table_grow())
+        {
+            // still usable, just not tracked
+            SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+            return data;
+        }
+    }
+    record = gf3d_memory_find(data);
+    if (record->data)
+    {
+        // the address was plainly freed while tracked and the heap has handed it out again
+        gf3d_memory_remove(record);
+        record = gf3d_memory_find(data);
+    }
+    record->data = data;
+    record->size = (Uint64)typeSize * count;
+    record->file = file;
+    record->line = line;
+    record->tag = tag;
+    gf3d_memory_tracker.recordCount++;
+    gf3d_memory_usage_add(&gf3d_memory_tracker.tags[tag].host,record->size);
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+    return data;
+}
+
+void gf3d_memory_free(void *data)
+{
+    MemoryRecord *record;
+    if (!data)return;
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    if (gf3d_memory_tracker.table)
+    {
+        record = gf3d_memory_find(data);
+        if (record->data)gf3d_memory_remove(record);
+    }
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+    free(data);
+}
+
+void gf3d_memory_host_allocated(MemoryTag tag,Uint64 bytes)
+{
+    if ((tag < 0)||(tag >= MT_MAX)||(!bytes))return;
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    gf3d_memory_usage_add(&gf3d_memory_tracker.tags[tag].host,bytes);
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+}
+
+void gf3d_memory_host_freed(MemoryTag tag,Uint64 bytes)
+{
+    if ((tag < 0)||(tag >= MT_MAX)||(!bytes))return;
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    gf3d_memory_usage_remove(&gf3d_memory_tracker.tags[tag].host,bytes);
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+}
+
+void gf3d_memory_gpu_allocated(MemoryTag tag,Uint64 bytes)
+{
+    if ((tag < 0)||(tag >= MT_MAX))return;
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    gf3d_memory_usage_add(&gf3d_memory_tracker.tags[tag].gpu,bytes);
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+}
+
+void gf3d_memory_gpu_freed(MemoryTag tag,Uint64 bytes)
+{
+    if ((tag < 0)||(tag >= MT_MAX))return;
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    gf3d_memory_usage_remove(&gf3d_memory_tracker.tags[tag].gpu,bytes);
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+}
+
+void gf3d_memory_get_tag_stats(MemoryTag tag,MemoryTagStats *stats)
+{
+    if (!stats)return;
+    if ((tag < 0)||(tag >= MT_MAX))
+    {
+        memset(stats,0,sizeof(MemoryTagStats));
+        return;
+    }
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    *stats = gf3d_memory_tracker.tags[tag];
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+}
+
+const char *gf3d_memory_tag_name(MemoryTag tag)
+{
+    if ((tag < 0)||(tag >= MT_MAX))return "unknown";
+    return gf3d_memory_tag_names[tag];
+}
+
+void gf3d_memory_report()
+{
+    int i;
+    MemoryTagStats stats;
+    slog("memory usage by tag, in bytes: host live / peak (live allocations of total), gpu live / peak (live of total)");
+    for (i = 0; i < MT_MAX; i++)
+    {
+        gf3d_memory_get_tag_stats(i,&stats);
+        if ((!stats.host.allocations)&&(!stats.gpu.allocations))continue;
+        slog("%-12s host %10llu / %10llu (%u of %u), gpu %10llu / %10llu (%u of %u)",
+            gf3d_memory_tag_names[i],
+            (unsigned long long)stats.host.liveBytes,
+            (unsigned long long)stats.host.peakBytes,
+            stats.host.liveCount,
+            stats.host.allocations,
+            (unsigned long long)stats.gpu.liveBytes,
+            (unsigned long long)stats.gpu.peakBytes,
+            stats.gpu.liveCount,
+            stats.gpu.allocations);
+    }
+}
+
+Uint32 gf3d_memory_report_leaks()
+{
+    Uint32 i,j;
+    Uint32 siteCount = 0;
+    Uint32 leaks = 0;
+    Uint32 unlisted = 0;
+    Uint64 bytes = 0;
+    MemoryRecord *record;
+    MemoryLeakSite sites[GF3D_MEMORY_LEAK_SITES];
+    SDL_AtomicLock(&gf3d_memory_tracker.lock);
+    // a leak in a loop leaks many times over from one line, report each line once
+    for (i = 0; i < gf3d_memory_tracker.tableSize; i++)
+    {
+        record = &gf3d_memory_tracker.table[i];
+        if (!record->data)continue;
+        leaks++;
+        bytes += record->size;
+        for (j = 0; j < siteCount; j++)
+        {
+            if ((sites[j].line == record->line)&&(sites[j].tag == record->tag)&&(strcmp(sites[j].file,record->file) == 0))break;
+        }
+        if (j == siteCount)
+        {
+            if (siteCount == GF3D_MEMORY_LEAK_SITES)
+            {
+                unlisted++;
+                continue;
+            }
+            sites[j].file = record->file;
+            sites[j].line = record->line;
+            sites[j].tag = record->tag;
+            sites[j].count = 0;
+            sites[j].bytes = 0;
+            siteCount++;
+        }
+        sites[j].count++;
+        sites[j].bytes += record->size;
+    }
+    for (j = 0; j < siteCount; j++)
+    {
+        slog_warn("leak: %llu bytes of %s in %u allocations made at %s:%u",
+            (unsigned long long)sites[j].bytes,
+            gf3d_memory_tag_names[sites[j].tag],
+            sites[j].count,
+            sites[j].file,
+            sites[j].line);
+    }
+    if (unlisted)slog_warn("leak: %u more allocations made elsewhere",unlisted);
+    for (i = 0; i < MT_MAX; i++)
+    {
+        if (!gf3d_memory_tracker.tags[i].gpu.liveCount)continue;
+        slog_warn("leak: %llu bytes of %s device memory in %u allocations",
+            (unsigned long long)gf3d_memory_tracker.tags[i].gpu.liveBytes,
+            gf3d_memory_tag_names[i],
+            gf3d_memory_tracker.tags[i].gpu.liveCount);
+    }
+    SDL_AtomicUnlock(&gf3d_memory_tracker.lock);
+    if (leaks)slog_warn("%u tracked allocations, %llu bytes, were never freed",leaks,(unsigned long long)bytes);
+    else slog("no tracked allocations leaked");
+    return leaks;
+}
+
+/**
+ * ARENAS
+ */
+
+Bool gf3d_arena_create(MemoryArena *arena,const char *name,size_t size)
+{
+    if (!arena)return false;
+    memset(arena,0,sizeof(MemoryArena));
+    arena->name = name;
+    arena->data = (Uint8 *)gf3d_memory_allocate(MT_Arena,size,1);
+    if (!arena->data)
+    {
+        slog_error("failed to allocate %u bytes for the %s arena",(Uint32)size,name);
+        return false;
+    }
+    arena->size = size;
+    return true;
+}
+
+void gf3d_arena_free(MemoryArena *arena)
+{
+    if (!arena)return;
+    if (arena->data)gf3d_memory_free(arena->data);
+    memset(arena,0,sizeof(MemoryArena));
+}
+
+void *gf3d_arena_allocate(MemoryArena *arena,size_t size)
+{
+    size_t start;
+    if ((!arena)||(!arena->data))
+    {
+        slog_error("cannot allocate from an arena that was not created");
+        return NULL;
+    }
+    // align the address, not the offset, so the arena's own block alignment does not matter
+    start = (((size_t)(arena->data + arena->used) + (GF3D_ARENA_ALIGNMENT - 1)) & ~(size_t)(GF3D_ARENA_ALIGNMENT - 1)) - (size_t)arena->data;
+    if ((start > arena->size)||(size > arena->size - start))
+    {
+        // a full frame arena would say so every frame, the first time is enough
+        if (!arena->overflows)
+        {
+            slog_warn("the %s arena is out of room for %u bytes, %u of %u used",arena->name,(Uint32)size,(Uint32)arena->used,(Uint32)arena->size);
+        }
+        arena->overflows++;
+        return NULL;
+    }
+    arena->used = start + size;
+    if (arena->used > arena->peak)arena->peak = arena->used;
+    return arena->data + start;
+}
+
+void *gf3d_arena_allocate_array(MemoryArena *arena,size_t typeSize,size_t count)
+{
+    void *array;
+    if ((!typeSize)||(!count))
+    {
+        slog("cannot allocate zero elements");
+        return NULL;
+    }
+    if (count > ((size_t)-1) / typeSize)
+    {
+        slog_error("array of %u elements of size %u is too large",(Uint32)count,(Uint32)typeSize);
+        return NULL;
+    }
+    array = gf3d_arena_allocate(arena,typeSize * count);
+    if (!array)return NULL;
+    memset(array,0,typeSize * count);
+    return array;
+}
+
+void gf3d_arena_reset(MemoryArena *arena)
+{
+    if (!arena)return;
+    arena->used = 0;
+}
+
+/*eol@eof*/
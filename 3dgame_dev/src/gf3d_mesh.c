@@ -0,0 +1,172 @@
+#include "gf3d_mesh.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+typedef struct
+{
+    Uint32      maxMeshes;
+    Mesh       *meshList;
+}MeshManager;
+
+static MeshManager gf3d_mesh = {0};
+
+void gf3d_mesh_close();
+
+void gf3d_mesh_init(Uint32 max_meshes)
+{
+    if (max_meshes == 0)
+    {
+        slog("cannot initialize zero meshes");
+        return;
+    }
+    gf3d_mesh.meshList = (Mesh *)gf3d_memory_allocate(MT_Mesh,sizeof(Mesh),max_meshes);
+    if (!gf3d_mesh.meshList)
+    {
+        slog("failed to allocate mesh manager");
+        return;
+    }
+    gf3d_mesh.maxMeshes = max_meshes;
+    atexit(gf3d_mesh_close);
+}
+
+void gf3d_mesh_close()
+{
+    int i;
+    slog("cleaning up meshes");
+    if (gf3d_mesh.meshList != NULL)
+    {
+        for (i = 0; i < gf3d_mesh.maxMeshes; i++)
+        {
+            gf3d_mesh_free(&gf3d_mesh.meshList[i]);
+        }
+        gf3d_memory_free(gf3d_mesh.meshList);
+    }
+    memset(&gf3d_mesh,0,sizeof(MeshManager));
+}
+
+Mesh *gf3d_mesh_new()
+{
+    int i;
+    for (i = 0; i < gf3d_mesh.maxMeshes; i++)
+    {
+        if (gf3d_mesh.meshList[i].inUse)continue;
+        gf3d_mesh.meshList[i].inUse = true;
+        return &gf3d_mesh.meshList[i];
+    }
+    slog("no free meshes");
+    return NULL;
+}
+
+void gf3d_mesh_calculate_bounds(Mesh *mesh,const Vertex *vertices,Uint32 vertexCount);
+
+Mesh *gf3d_mesh_new_from_data(const Vertex *vertices,Uint32 vertexCount,const Uint32 *indices,Uint32 indexCount)
+{
+    Mesh *mesh;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    if ((!vertices)||(!vertexCount)||(!indices)||(!indexCount))
+    {
+        slog("cannot create a mesh without vertices and indices");
+        return NULL;
+    }
+    mesh = gf3d_mesh_new();
+    if (!mesh)return NULL;
+
+    if (!gf3d_buffer_create(&mesh->vertexBuffer,MT_Mesh,sizeof(Vertex)*vertexCount,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,properties))
+    {
+        slog("failed to create mesh vertex buffer");
+        gf3d_mesh_free(mesh);
+        return NULL;
+    }
+    if (!gf3d_buffer_create(&mesh->indexBuffer,MT_Mesh,sizeof(Uint32)*indexCount,VK_BUFFER_USAGE_INDEX_BUFFER_BIT,properties))
+    {
+        slog("failed to create mesh index buffer");
+        gf3d_mesh_free(mesh);
+        return NULL;
+    }
+    memcpy(mesh->vertexBuffer.mapped,vertices,sizeof(Vertex)*vertexCount);
+    memcpy(mesh->indexBuffer.mapped,indices,sizeof(Uint32)*indexCount);
+    mesh->vertexCount = vertexCount;
+    mesh->indexCount = indexCount;
+    gf3d_mesh_calculate_bounds(mesh,vertices,vertexCount);
+    return mesh;
+}
+
+void gf3d_mesh_calculate_bounds(Mesh *mesh,const Vertex *vertices,Uint32 vertexCount)
+{
+    int i;
+    float distance;
+    Vector3D min,max,delta;
+
+    min = max = vertices[0].vertex;
+    for (i = 1; i < vertexCount; i++)
+    {
+        min.x = MIN(min.x,vertices[i].vertex.x);
+        min.y = MIN(min.y,vertices[i].vertex.y);
+        min.z = MIN(min.z,vertices[i].vertex.z);
+        max.x = MAX(max.x,vertices[i].vertex.x);
+        max.y = MAX(max.y,vertices[i].vertex.y);
+        max.z = MAX(max.z,vertices[i].vertex.z);
+    }
+    vector3d_add(mesh->center,min,max);
+    vector3d_scale(mesh->center,mesh->center,0.5);
+    mesh->radius = 0;
+    for (i = 0; i < vertexCount; i++)
+    {
+        vector3d_sub(delta,vertices[i].vertex,mesh->center);
+        distance = vector3d_magnitude_squared(delta);
+        if (distance > mesh->radius)mesh->radius = distance;
+    }
+    mesh->radius = sqrt(mesh->radius);
+}
+
+void gf3d_mesh_free(Mesh *mesh)
+{
+    if (!mesh)return;
+    if (!mesh->inUse)return;
+    gf3d_buffer_free(&mesh->vertexBuffer);
+    gf3d_buffer_free(&mesh->indexBuffer);
+    memset(mesh,0,sizeof(Mesh));
+}
+
+VkVertexInputBindingDescription gf3d_mesh_get_binding_description(Uint32 binding)
+{
+    VkVertexInputBindingDescription description = {0};
+    description.binding = binding;
+    description.stride = sizeof(Vertex);
+    description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return description;
+}
+
+void gf3d_mesh_get_attribute_descriptions(Uint32 binding,VkVertexInputAttributeDescription *attributes)
+{
+    if (!attributes)return;
+    attributes[0].location = 0;
+    attributes[0].binding = binding;
+    attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[0].offset = offsetof(Vertex,vertex);
+
+    attributes[1].location = 1;
+    attributes[1].binding = binding;
+    attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[1].offset = offsetof(Vertex,normal);
+
+    attributes[2].location = 2;
+    attributes[2].binding = binding;
+    attributes[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributes[2].offset = offsetof(Vertex,texel);
+}
+
+Uint32 gf3d_mesh_get_index(Mesh *mesh)
+{
+    if ((!mesh)||(!gf3d_mesh.meshList))return 0;
+    if ((mesh < gf3d_mesh.meshList)||(mesh >= gf3d_mesh.meshList + gf3d_mesh.maxMeshes))return 0;
+    return (Uint32)(mesh - gf3d_mesh.meshList);
+}
+
+/*eol@eof*/
@@ -1,15 +1,19 @@
 #include "gf3d_pipeline.h"
 #include "gf3d_swapchain.h"
 #include "gf3d_shaders.h"
+#include "gf3d_uniforms.h"
+#include "gf3d_pool.h"
 
 #include <string.h>
 #include <stdio.h>
+#include "gf3d_memory.h"
 #include "simple_logger.h"
+#include "gf3d_trace.h"
 
 typedef struct
 {
-    Uint32      maxPipelines;
-    Pipeline   *pipelineList;
+    ObjectPool  pipelinePool;
+    Bool        depthPrepass;
 }PipelineManager;
 
 static PipelineManager gf3d_pipeline = {0};
@@ -23,82 +27,85 @@ void gf3d_pipeline_init(Uint32 max_pipelines)
         slog("cannot initialize zero pipelines");
         return;
     }
-    gf3d_pipeline.pipelineList = (Pipeline *)gf3d_allocate_array(sizeof(Pipeline),max_pipelines);
-    if (!gf3d_pipeline.pipelineList)
+    // a single chunk: pipeline indices are packed into render queue sort keys, so the count stays bounded.
+    // the chunk rounds up to 64 elements but the pool still stops at max_pipelines
+    if (!gf3d_pool_create_typed(&gf3d_pipeline.pipelinePool,MT_Pipeline,Pipeline,max_pipelines,1))
     {
         slog("failed to allocate pipeline manager");
         return;
     }
-    gf3d_pipeline.maxPipelines = max_pipelines;
     atexit(gf3d_pipeline_close);
 }
 
 void gf3d_pipeline_close()
 {
-    int i;
+    Uint32 cursor = 0;
+    Pipeline *pipe;
     slog("cleaning up pipelines");
-    if (gf3d_pipeline.pipelineList != 0)
+    while ((pipe = gf3d_pool_next_typed(&gf3d_pipeline.pipelinePool,Pipeline,&cursor)) != NULL)
     {
-        for (i = 0; i < gf3d_pipeline.maxPipelines; i++)
-        {
-            gf3d_pipeline_free(&gf3d_pipeline.pipelineList[i]);
-        }
-        free(gf3d_pipeline.pipelineList);
+        gf3d_pipeline_free(pipe);
     }
+    gf3d_pool_destroy(&gf3d_pipeline.pipelinePool);
     memset(&gf3d_pipeline,0,sizeof(PipelineManager));
 }
 
 Pipeline *gf3d_pipeline_new()
 {
-    int i;
-    for (i = 0; i < gf3d_pipeline.maxPipelines; i++)
+    Pipeline *pipe;
+    pipe = gf3d_pool_new_typed(&gf3d_pipeline.pipelinePool,Pipeline);
+    if (!pipe)
     {
-        if (gf3d_pipeline.pipelineList[i].inUse)continue;
-        gf3d_pipeline.pipelineList[i].inUse = true;
-        return &gf3d_pipeline.pipelineList[i];
+        slog("no free pipelines");
+        return NULL;
     }
-    slog("no free pipelines");
-    return NULL;
+    return pipe;
 }
 
 void gf3d_pipeline_render_pass_setup(Pipeline *pipe)
 {
-    VkAttachmentDescription colorAttachment = {0};
+    VkAttachmentDescription attachments[2] = {0};
     VkAttachmentReference colorAttachmentRef = {0};
+    VkAttachmentReference depthAttachmentRef = {0};
     VkSubpassDescription subpass = {0};
     VkRenderPassCreateInfo renderPassInfo = {0};
-    VkSubpassDependency dependency = {0};
     
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    colorAttachment.format = gf3d_swapchain_get_format();
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // the render graph moves the attachments in and out of these layouts and orders them against other passes
+    attachments[0].format = gf3d_swapchain_get_format();
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // depth is only needed while the pass runs
+    attachments[1].format = gf3d_swapchain_get_depth_format();
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
     
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
 
     if (vkCreateRenderPass(pipe->device, &renderPassInfo, NULL, &pipe->renderPass) != VK_SUCCESS)
     {
@@ -107,12 +114,34 @@ void gf3d_pipeline_render_pass_setup(Pipeline *pipe)
     }
 }
 
+void gf3d_pipeline_set_depth_prepass(Bool enable)
+{
+    gf3d_pipeline.depthPrepass = enable;
+}
+
+Bool gf3d_pipeline_get_depth_prepass()
+{
+    return gf3d_pipeline.depthPrepass;
+}
+
+Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragFile)
+{
+    return gf3d_pipeline_graphics_load_with_input(device,vertFile,fragFile,NULL,PD_Opaque);
+}
 
-Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragFile,VkExtent2D extent)
+/**
+ * @brief everything gf3d_pipeline_graphics_load_with_input does, it only adds the trace zone
+ */
+static Pipeline *gf3d_pipeline_graphics_build(
+    VkDevice device,
+    char *vertFile,
+    char *fragFile,
+    const VkPipelineVertexInputStateCreateInfo *vertexInput,
+    PipelineDepth depth)
 {
     Pipeline *pipe;
-    VkRect2D scissor = {0};
-    VkViewport viewport = {0};
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {0};
     VkGraphicsPipelineCreateInfo pipelineInfo = {0};
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
     VkPipelineViewportStateCreateInfo viewportState = {0};
@@ -125,6 +154,11 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
     VkPipelineMultisampleStateCreateInfo multisampling = {0};
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
     VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+    VkPipelineColorBlendAttachmentState depthBlendAttachment = {0};
+    VkPipelineColorBlendStateCreateInfo depthBlending = {0};
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {0};
+    VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = {0};
+    VkDescriptorSetLayout setLayout;
 
     pipe = gf3d_pipeline_new();
     if (!pipe)return NULL;
@@ -136,6 +170,7 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
     pipe->fragModule = gf3d_shaders_create_module(pipe->fragShader,pipe->fragSize,device);
 
     pipe->device = device;
+    pipe->depth = depth;
     
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -150,33 +185,34 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
     shaderStages[0] = vertShaderStageInfo;
     shaderStages[1] = fragShaderStageInfo;
     
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = NULL; // Optional
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = NULL; // Optional    return pipe;
+    if (vertexInput)
+    {
+        vertexInputInfo = *vertexInput;
+    }
+    else
+    {
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 0;
+        vertexInputInfo.pVertexBindingDescriptions = NULL; // Optional
+        vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        vertexInputInfo.pVertexAttributeDescriptions = NULL; // Optional
+    }
 
     // TODO: pull all this information from config file
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
     
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) extent.width;
-    viewport.height = (float) extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent = extent;
-    
+    // set per command buffer, so a resolution change or a split screen needs no new pipelines
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = NULL;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = NULL;
+
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = sizeof(dynamicStates)/sizeof(VkDynamicState);
+    dynamicState.pDynamicStates = dynamicStates;
     
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
@@ -217,9 +253,34 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = (depth != PD_None)?VK_TRUE:VK_FALSE;
+    depthStencil.depthWriteEnable = (depth == PD_Opaque)?VK_TRUE:VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f; // Optional
+    depthStencil.maxDepthBounds = 1.0f; // Optional
+
+    if ((depth == PD_Opaque)&&(gf3d_pipeline.depthPrepass))
+    {
+        // the pre-pass already wrote the nearest depth, only the fragments matching it are shaded
+        prepassDepthStencil = depthStencil;
+        prepassDepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthWriteEnable = VK_FALSE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+        depthBlendAttachment.colorWriteMask = 0;
+        depthBlendAttachment.blendEnable = VK_FALSE;
+        depthBlending = colorBlending;
+        depthBlending.pAttachments = &depthBlendAttachment;
+    }
+
+    // set 0 is always the camera and object transforms
+    setLayout = gf3d_uniforms_get_layout();
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = NULL; // Optional
+    pipelineLayoutInfo.setLayoutCount = (setLayout != VK_NULL_HANDLE)?1:0;
+    pipelineLayoutInfo.pSetLayouts = (setLayout != VK_NULL_HANDLE)?&setLayout:NULL;
     pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
     pipelineLayoutInfo.pPushConstantRanges = NULL; // Optional
 
@@ -240,9 +301,9 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = NULL; // Optional
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = NULL; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipe->pipelineLayout;
     pipelineInfo.renderPass = pipe->renderPass;
     pipelineInfo.subpass = 0;
@@ -255,17 +316,117 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,char *vertFile,char *fragF
         gf3d_pipeline_free(pipe);
         return NULL;
     }
+    if ((depth == PD_Opaque)&&(gf3d_pipeline.depthPrepass))
+    {
+        // vertex stage only: the pre-pass writes no color, so it runs no fragment shader
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pDepthStencilState = &prepassDepthStencil;
+        pipelineInfo.pColorBlendState = &depthBlending;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipe->depthPipeline) != VK_SUCCESS)
+        {
+            slog("failed to create depth pre-pass pipeline!");
+            gf3d_pipeline_free(pipe);
+            return NULL;
+        }
+    }
+    return pipe;
+}
+
+Pipeline *gf3d_pipeline_graphics_load_with_input(
+    VkDevice device,
+    char *vertFile,
+    char *fragFile,
+    const VkPipelineVertexInputStateCreateInfo *vertexInput,
+    PipelineDepth depth)
+{
+    Pipeline *pipe;
+    GF3D_TRACE_BEGIN("gf3d_pipeline_graphics_load");
+    pipe = gf3d_pipeline_graphics_build(device,vertFile,fragFile,vertexInput,depth);
+    GF3D_TRACE_END();
+    return pipe;
+}
+
+/**
+ * @brief everything gf3d_pipeline_compute_load does, it only adds the trace zone
+ */
+static Pipeline *gf3d_pipeline_compute_build(VkDevice device,char *compFile,VkDescriptorSetLayout setLayout,Uint32 pushConstantSize)
+{
+    Pipeline *pipe;
+    VkComputePipelineCreateInfo pipelineInfo = {0};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+    VkPushConstantRange pushConstantRange = {0};
+
+    pipe = gf3d_pipeline_new();
+    if (!pipe)return NULL;
+
+    pipe->device = device;
+    pipe->compShader = gf3d_shaders_load_data(compFile,&pipe->compSize);
+    if (!pipe->compShader)
+    {
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+    pipe->compModule = gf3d_shaders_create_module(pipe->compShader,pipe->compSize,device);
+
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = (setLayout != VK_NULL_HANDLE)?1:0;
+    pipelineLayoutInfo.pSetLayouts = (setLayout != VK_NULL_HANDLE)?&setLayout:NULL;
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize?1:0;
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantSize?&pushConstantRange:NULL;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipe->pipelineLayout) != VK_SUCCESS)
+    {
+        slog("failed to create compute pipeline layout!");
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = pipe->compModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipe->pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipe->computePipeline) != VK_SUCCESS)
+    {
+        slog("failed to create compute pipeline!");
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+    return pipe;
+}
+
+Pipeline *gf3d_pipeline_compute_load(VkDevice device,char *compFile,VkDescriptorSetLayout setLayout,Uint32 pushConstantSize)
+{
+    Pipeline *pipe;
+    GF3D_TRACE_BEGIN("gf3d_pipeline_compute_load");
+    pipe = gf3d_pipeline_compute_build(device,compFile,setLayout,pushConstantSize);
+    GF3D_TRACE_END();
     return pipe;
 }
 
 void gf3d_pipeline_free(Pipeline *pipe)
 {
-    if (!pipe)return;
-    if (!pipe->inUse)return;
+    if (gf3d_pool_get_index(&gf3d_pipeline.pipelinePool,pipe) == GF3D_POOL_NONE)return;
     if (pipe->graphicsPipeline)
     {
         vkDestroyPipeline(pipe->device, pipe->graphicsPipeline, NULL);
     }
+    if (pipe->depthPipeline)
+    {
+        vkDestroyPipeline(pipe->device, pipe->depthPipeline, NULL);
+    }
+    if (pipe->computePipeline)
+    {
+        vkDestroyPipeline(pipe->device, pipe->computePipeline, NULL);
+    }
     if (pipe->pipelineLayout)
     {
         vkDestroyPipelineLayout(pipe->device, pipe->pipelineLayout, NULL);
@@ -282,15 +443,31 @@ void gf3d_pipeline_free(Pipeline *pipe)
     {
         vkDestroyShaderModule(pipe->device, pipe->vertModule, NULL);
     }
+    if (pipe->compModule != VK_NULL_HANDLE)
+    {
+        vkDestroyShaderModule(pipe->device, pipe->compModule, NULL);
+    }
+    if (pipe->compShader != NULL)
+    {
+        gf3d_memory_free(pipe->compShader);
+    }
     if (pipe->fragShader != NULL)
     {
-        free(pipe->fragShader);
+        gf3d_memory_free(pipe->fragShader);
     }
     if (pipe->vertShader != NULL)
     {
-        free (pipe->vertShader);
+        gf3d_memory_free(pipe->vertShader);
     }
-    memset(pipe,0,sizeof(Pipeline));
+    gf3d_pool_free(&gf3d_pipeline.pipelinePool,pipe);
+}
+
+Uint32 gf3d_pipeline_get_index(Pipeline *pipe)
+{
+    Sint32 index;
+    index = gf3d_pool_get_index(&gf3d_pipeline.pipelinePool,pipe);
+    if (index == GF3D_POOL_NONE)return 0;
+    return (Uint32)index;
 }
 
 /*eol@eof*/
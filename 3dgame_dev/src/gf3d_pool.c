@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gf3d_pool.h"
+#include "simple_logger.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define GF3D_POOL_MIN_SHIFT     6       // a chunk holds whole words of the live bit set
+#define GF3D_POOL_MAX_SHIFT     24
+#define GF3D_POOL_MAX_ELEMENTS  0x7FFFFFFF
+
+typedef struct
+{
+    Uint32  index;      /**<the element's index, so a pointer finds its slot without a search*/
+}PoolHeader;
+
+/**
+ * @brief the lowest set bit of a non zero word
+ */
+static int gf3d_pool_lowest_bit(Uint64 bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index,bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+/**
+ * @brief get the header in front of the element at an index, the index must be in range
+ */
+static PoolHeader *gf3d_pool_header(ObjectPool *pool,Uint32 index)
+{
+    return (PoolHeader *)(pool->chunks[index >> pool->chunkShift] + (size_t)(index & ((1 << pool->chunkShift) - 1)) * pool->stride);
+}
+
+#define gf3d_pool_element(header) ((void *)((Uint8 *)(header) + GF3D_POOL_ALIGNMENT))
+#define gf3d_pool_link(element) (*(Sint32 *)(element))
+
+/**
+ * @brief add a chunk and put all of its elements on the free list
+ * @return false if the pool may not grow, or the memory could not be allocated
+ */
+static Bool gf3d_pool_grow(ObjectPool *pool)
+{
+    int i;
+    Uint8 **chunks;
+    Uint64 *live;
+    Uint32 slots;
+    Uint32 words;
+    Uint32 first;
+    Uint32 chunkSize = 1 << pool->chunkShift;
+    PoolHeader *header;
+
+    if ((pool->chunkMax)&&(pool->chunkCount >= pool->chunkMax))return false;
+    if ((Uint64)(pool->chunkCount + 1) * chunkSize > GF3D_POOL_MAX_ELEMENTS)
+    {
+        slog("pool %s cannot grow past %u elements",pool->name,pool->chunkCount * chunkSize);
+        return false;
+    }
+    words = chunkSize / 64;
+    if (pool->chunkCount >= pool->chunkSlots)
+    {
+        slots = pool->chunkSlots?pool->chunkSlots * 2:4;
+        if ((pool->chunkMax)&&(slots > pool->chunkMax))slots = pool->chunkMax;
+        chunks = (Uint8 **)gf3d_memory_allocate(pool->tag,sizeof(Uint8 *),slots);
+        live = (Uint64 *)gf3d_memory_allocate(pool->tag,sizeof(Uint64),(size_t)slots * words);
+        if ((!chunks)||(!live))
+        {
+            gf3d_memory_free(chunks);
+            gf3d_memory_free(live);
+            return false;
+        }
+        if (pool->chunks)
+        {
+            memcpy(chunks,pool->chunks,sizeof(Uint8 *) * pool->chunkCount);
+            memcpy(live,pool->live,sizeof(Uint64) * pool->chunkCount * words);
+            gf3d_memory_free(pool->chunks);
+            gf3d_memory_free(pool->live);
+        }
+        pool->chunks = chunks;
+        pool->live = live;
+        pool->chunkSlots = slots;
+    }
+    pool->chunks[pool->chunkCount] = (Uint8 *)gf3d_memory_allocate(pool->tag,pool->stride,chunkSize);
+    if (!pool->chunks[pool->chunkCount])return false;
+    first = pool->chunkCount * chunkSize;
+    pool->chunkCount++;
+    // lowest index first, so a pool that never frees hands elements out in order
+    for (i = 0; i < chunkSize; i++)
+    {
+        header = gf3d_pool_header(pool,first + i);
+        header->index = first + i;
+        gf3d_pool_link(gf3d_pool_element(header)) = (i + 1 < chunkSize)?(Sint32)(first + i + 1):pool->freeList;
+    }
+    pool->freeList = first;
+    return true;
+}
+
+Bool gf3d_pool_create(ObjectPool *pool,const char *name,MemoryTag tag,size_t elementSize,Uint32 chunkSize,Uint32 chunkMax)
+{
+    if (!pool)return false;
+    memset(pool,0,sizeof(ObjectPool));
+    if ((!elementSize)||(!chunkSize))
+    {
+        slog("cannot create pool %s for zero elements or zero sized elements",name);
+        return false;
+    }
+    pool->name = name;
+    pool->tag = tag;
+    pool->elementSize = elementSize;
+    // the free list link is kept in the element, so every element has room for one
+    pool->stride = GF3D_POOL_ALIGNMENT + ((MAX(elementSize,sizeof(Sint32)) + GF3D_POOL_ALIGNMENT - 1) & ~(size_t)(GF3D_POOL_ALIGNMENT - 1));
+    pool->chunkShift = GF3D_POOL_MIN_SHIFT;
+    while ((pool->chunkShift < GF3D_POOL_MAX_SHIFT)&&((1U << pool->chunkShift) < chunkSize))pool->chunkShift++;
+    pool->chunkMax = chunkMax;
+    pool->countMax = (Uint32)MIN((Uint64)chunkSize * chunkMax,GF3D_POOL_MAX_ELEMENTS);
+    pool->freeList = GF3D_POOL_NONE;
+    if (!gf3d_pool_grow(pool))
+    {
+        slog("failed to allocate pool %s",name);
+        gf3d_pool_destroy(pool);
+        return false;
+    }
+    return true;
+}
+
+void gf3d_pool_destroy(ObjectPool *pool)
+{
+    int i;
+    if (!pool)return;
+    for (i = 0; i < pool->chunkCount; i++)
+    {
+        gf3d_memory_free(pool->chunks[i]);
+    }
+    gf3d_memory_free(pool->chunks);
+    gf3d_memory_free(pool->live);
+    memset(pool,0,sizeof(ObjectPool));
+}
+
+void *gf3d_pool_new(ObjectPool *pool)
+{
+    Sint32 index;
+    void *element;
+    if ((!pool)||(!pool->chunks))return NULL;
+    if ((pool->countMax)&&(pool->count >= pool->countMax))
+    {
+        slog("pool %s is full at %u elements",pool->name,pool->countMax);
+        return NULL;
+    }
+    if ((pool->freeList == GF3D_POOL_NONE)&&(!gf3d_pool_grow(pool)))
+    {
+        slog("no free elements in pool %s",pool->name);
+        return NULL;
+    }
+    index = pool->freeList;
+    element = gf3d_pool_element(gf3d_pool_header(pool,index));
+    pool->freeList = gf3d_pool_link(element);
+    pool->live[index >> 6] |= (Uint64)1 << (index & 63);
+    pool->count++;
+    memset(element,0,pool->elementSize);
+    return element;
+}
+
+Sint32 gf3d_pool_get_index(ObjectPool *pool,const void *element)
+{
+    Uint32 index;
+    if ((!pool)||(!pool->chunks)||(!element))return GF3D_POOL_NONE;
+    index = ((const PoolHeader *)((const Uint8 *)element - GF3D_POOL_ALIGNMENT))->index;
+    if (index >= (pool->chunkCount << pool->chunkShift))return GF3D_POOL_NONE;
+    // an element of another pool can carry an index that is in range here too
+    if (gf3d_pool_element(gf3d_pool_header(pool,index)) != element)return GF3D_POOL_NONE;
+    if (!(pool->live[index >> 6] & ((Uint64)1 << (index & 63))))return GF3D_POOL_NONE;
+    return (Sint32)index;
+}
+
+void gf3d_pool_free(ObjectPool *pool,void *element)
+{
+    Sint32 index;
+    index = gf3d_pool_get_index(pool,element);
+    if (index == GF3D_POOL_NONE)return;
+    pool->live[index >> 6] &= ~((Uint64)1 << (index & 63));
+    gf3d_pool_link(element) = pool->freeList;
+    pool->freeList = index;
+    pool->count--;
+}
+
+void *gf3d_pool_get(ObjectPool *pool,Sint32 index)
+{
+    if ((!pool)||(index < 0)||(index >= (pool->chunkCount << pool->chunkShift)))return NULL;
+    if (!(pool->live[index >> 6] & ((Uint64)1 << (index & 63))))return NULL;
+    return gf3d_pool_element(gf3d_pool_header(pool,index));
+}
+
+void *gf3d_pool_next(ObjectPool *pool,Uint32 *cursor)
+{
+    Uint32 word;
+    Uint32 words;
+    Uint64 bits;
+    Uint32 index;
+    if ((!pool)||(!cursor)||(!pool->chunks))return NULL;
+    words = (pool->chunkCount << pool->chunkShift) >> 6;
+    word = *cursor >> 6;
+    if (word >= words)return NULL;
+    // mask off the elements before the cursor in its word, then skip empty words whole
+    bits = pool->live[word] & (~(Uint64)0 << (*cursor & 63));
+    while (!bits)
+    {
+        if (++word >= words)
+        {
+            *cursor = words << 6;
+            return NULL;
+        }
+        bits = pool->live[word];
+    }
+    index = (word << 6) + gf3d_pool_lowest_bit(bits);
+    *cursor = index + 1;
+    return gf3d_pool_element(gf3d_pool_header(pool,index));
+}
+
+Uint32 gf3d_pool_get_capacity(ObjectPool *pool)
+{
+    if (!pool)return 0;
+    return pool->chunkCount << pool->chunkShift;
+}
+
+/*eol@eof*/
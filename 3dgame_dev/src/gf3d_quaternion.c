@@ -0,0 +1,110 @@
+#include <math.h>
+#include "gf3d_quaternion.h"
+#include "simple_logger.h"
+
+#define GF3D_QUATERNION_SLERP_LINEAR 0.9995f   // closer than this, the sine in slerp loses precision and lerp is exact enough
+
+Quaternion gf3d_quaternion_identity()
+{
+    Quaternion q;
+    vector4d_set(q,0,0,0,1);
+    return q;
+}
+
+Quaternion gf3d_quaternion_from_axis_angle(Vector3D axis,float angle)
+{
+    Quaternion q;
+    float length,s;
+    length = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (length == 0)return gf3d_quaternion_identity();
+    s = sinf(angle * 0.5f) / length;
+    vector4d_set(q,axis.x * s,axis.y * s,axis.z * s,cosf(angle * 0.5f));
+    return q;
+}
+
+void gf3d_quaternion_multiply(Quaternion *out,Quaternion a,Quaternion b)
+{
+    if (!out)return;
+    out->x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    out->y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    out->z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    out->w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+}
+
+void gf3d_quaternion_normalize(Quaternion *q)
+{
+    float length;
+    if (!q)return;
+    length = sqrtf(q->x * q->x + q->y * q->y + q->z * q->z + q->w * q->w);
+    if (length == 0)
+    {
+        *q = gf3d_quaternion_identity();
+        return;
+    }
+    q->x /= length;
+    q->y /= length;
+    q->z /= length;
+    q->w /= length;
+}
+
+Quaternion gf3d_quaternion_conjugate(Quaternion q)
+{
+    Quaternion c;
+    vector4d_set(c,-q.x,-q.y,-q.z,q.w);
+    return c;
+}
+
+void gf3d_quaternion_rotate_vector(Vector3D *out,Quaternion q,Vector3D v)
+{
+    float tx,ty,tz;
+    if (!out)return;
+    // v + w * t + q.xyz x t with t = 2 * (q.xyz x v), cheaper than q * v * conjugate(q)
+    tx = 2 * (q.y * v.z - q.z * v.y);
+    ty = 2 * (q.z * v.x - q.x * v.z);
+    tz = 2 * (q.x * v.y - q.y * v.x);
+    out->x = v.x + q.w * tx + (q.y * tz - q.z * ty);
+    out->y = v.y + q.w * ty + (q.z * tx - q.x * tz);
+    out->z = v.z + q.w * tz + (q.x * ty - q.y * tx);
+}
+
+void gf3d_quaternion_slerp(Quaternion *out,Quaternion a,Quaternion b,float t)
+{
+    float cosine,angle,sine,wa,wb;
+    if (!out)return;
+    cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    // q and -q are the same rotation, flip one to take the short way around
+    if (cosine < 0)
+    {
+        vector4d_set(b,-b.x,-b.y,-b.z,-b.w);
+        cosine = -cosine;
+    }
+    if (cosine > GF3D_QUATERNION_SLERP_LINEAR)
+    {
+        wa = 1 - t;
+        wb = t;
+    }
+    else
+    {
+        angle = acosf(cosine);
+        sine = sinf(angle);
+        wa = sinf((1 - t) * angle) / sine;
+        wb = sinf(t * angle) / sine;
+    }
+    vector4d_set((*out),a.x * wa + b.x * wb,a.y * wa + b.y * wb,a.z * wa + b.z * wb,a.w * wa + b.w * wb);
+    if (cosine > GF3D_QUATERNION_SLERP_LINEAR)gf3d_quaternion_normalize(out);
+}
+
+void gf3d_quaternion_to_matrix(Matrix4 out,Quaternion q)
+{
+    gf3d_matrix_make_rotation(out,q);
+}
+
+Bool gf3d_quaternion_from_matrix(Quaternion *q,Matrix4 mat)
+{
+    if (!q)return false;
+    if (!gf3d_matrix_decompose(mat,NULL,q,NULL))return false;
+    gf3d_quaternion_normalize(q);
+    return true;
+}
+
+/*eol@eof*/
@@ -0,0 +1,946 @@
+#include "gf3d_render_graph.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#define GF3D_RENDER_GRAPH_MAX_USES  16
+#define GF3D_RENDER_GRAPH_NAME_LEN  32
+
+typedef struct
+{
+    VkPipelineStageFlags    stage;
+    VkAccessFlags           readAccess;
+    VkAccessFlags           writeAccess;
+    VkImageLayout           readLayout;
+    VkImageLayout           writeLayout;
+    VkImageUsageFlags       imageUsage;     /**<what a transient image used this way has to be created with*/
+}RenderGraphUsageInfo;
+
+static const RenderGraphUsageInfo gf3d_render_graph_usage_info[RGU_MAX] =
+{
+    {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+    },
+    {
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+    },
+    {
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        0,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT
+    },
+    {
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL,
+        VK_IMAGE_LAYOUT_GENERAL,
+        VK_IMAGE_USAGE_STORAGE_BIT
+    },
+    {
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        0,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        0
+    },
+    {
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+        0,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        0
+    },
+    {
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    }
+};
+
+typedef struct
+{
+    Sint32              resource;
+    RenderGraphUsage    usage;
+    Bool                write;
+}RenderGraphUse;
+
+typedef struct
+{
+    char                name[GF3D_RENDER_GRAPH_NAME_LEN];
+    RenderGraphExecute  execute;
+    void               *userData;
+    RenderGraphUse      uses[GF3D_RENDER_GRAPH_MAX_USES];
+    Uint32              useCount;
+    Bool                culled;
+    VkPipelineStageFlags srcStage;          /**<the pass's barrier batch*/
+    VkPipelineStageFlags dstStage;
+    VkMemoryBarrier     memoryBarrier;      /**<covers every buffer hazard, sType is 0 when there is none*/
+    Uint32              barrierFirst;       /**<range in the graph's image barrier list*/
+    Uint32              barrierCount;
+}RenderGraphPass;
+
+typedef struct
+{
+    char                    name[GF3D_RENDER_GRAPH_NAME_LEN];
+    Bool                    isImage;
+    Bool                    imported;
+    Bool                    output;
+    VkFormat                format;
+    VkExtent2D              extent;
+    VkImageLayout           initialLayout;
+    VkPipelineStageFlags    initialStage;
+    VkImageLayout           finalLayout;
+    VkImage                 image;
+    VkImageView             view;
+    VkImageUsageFlags       imageUsage;     /**<gathered from the uses at compile time*/
+    VkMemoryRequirements    requirements;
+    Sint32                  first;          /**<first and last live pass using the resource, -1 when unused*/
+    Sint32                  last;
+    Sint32                  block;          /**<memory block backing a transient image*/
+    Sint32                  previous;       /**<resource that used the same memory before this one, -1 for none*/
+}RenderGraphResource;
+
+typedef struct
+{
+    VkDeviceMemory  memory;
+    VkDeviceSize    size;
+    Uint32          typeBits;
+}RenderGraphBlock;
+
+/**
+ * @brief where the tracked state of a resource stands while barriers are computed
+ */
+typedef struct
+{
+    VkImageLayout           layout;
+    VkPipelineStageFlags    writeStage;     /**<stage of the last write, or of the initial state*/
+    VkAccessFlags           writeAccess;
+    VkPipelineStageFlags    readStages;     /**<stages that read since the last write, a later write must wait on them*/
+    VkPipelineStageFlags    visibleStages;  /**<stages the last write has been made visible to*/
+}RenderGraphState;
+
+typedef struct
+{
+    VkDevice                device;
+    Uint32                  maxPasses;
+    Uint32                  passCount;
+    RenderGraphPass        *passList;
+    Uint32                  maxResources;
+    Uint32                  resourceCount;
+    RenderGraphResource    *resourceList;
+    RenderGraphState       *stateList;
+    RenderGraphBlock       *blockList;
+    Uint32                  blockCount;
+    Sint32                 *order;              /**<transient images, largest first, used while aliasing*/
+    Bool                   *needed;             /**<used while culling*/
+    VkImageMemoryBarrier   *imageBarriers;      /**<every pass's image barriers, then the final transitions*/
+    Sint32                 *barrierResource;    /**<resource of each image barrier, the image is filled in at execution*/
+    Uint32                  barrierCount;
+    Uint32                  maxBarriers;
+    RenderGraphPass         finalPass;          /**<barrier batch that leaves imported images in their final layout*/
+    Bool                    compiled;
+    RenderGraphStats        stats;
+}RenderGraphManager;
+
+static RenderGraphManager gf3d_render_graph = {0};
+
+void gf3d_render_graph_close();
+
+void gf3d_render_graph_init(VkDevice device,Uint32 maxPasses,Uint32 maxResources)
+{
+    if ((!maxPasses)||(!maxResources))
+    {
+        slog("cannot initialize a render graph with zero passes or resources");
+        return;
+    }
+    gf3d_render_graph.maxBarriers = (maxPasses * GF3D_RENDER_GRAPH_MAX_USES) + maxResources;
+    gf3d_render_graph.passList = (RenderGraphPass *)gf3d_memory_allocate(MT_Render,sizeof(RenderGraphPass),maxPasses);
+    gf3d_render_graph.resourceList = (RenderGraphResource *)gf3d_memory_allocate(MT_Render,sizeof(RenderGraphResource),maxResources);
+    gf3d_render_graph.stateList = (RenderGraphState *)gf3d_memory_allocate(MT_Render,sizeof(RenderGraphState),maxResources);
+    gf3d_render_graph.blockList = (RenderGraphBlock *)gf3d_memory_allocate(MT_Render,sizeof(RenderGraphBlock),maxResources);
+    gf3d_render_graph.order = (Sint32 *)gf3d_memory_allocate(MT_Render,sizeof(Sint32),maxResources);
+    gf3d_render_graph.needed = (Bool *)gf3d_memory_allocate(MT_Render,sizeof(Bool),maxResources);
+    gf3d_render_graph.imageBarriers = (VkImageMemoryBarrier *)gf3d_memory_allocate(MT_Render,sizeof(VkImageMemoryBarrier),gf3d_render_graph.maxBarriers);
+    gf3d_render_graph.barrierResource = (Sint32 *)gf3d_memory_allocate(MT_Render,sizeof(Sint32),gf3d_render_graph.maxBarriers);
+    if ((!gf3d_render_graph.passList)||(!gf3d_render_graph.resourceList)||(!gf3d_render_graph.stateList)||
+        (!gf3d_render_graph.blockList)||(!gf3d_render_graph.order)||(!gf3d_render_graph.needed)||
+        (!gf3d_render_graph.imageBarriers)||(!gf3d_render_graph.barrierResource))
+    {
+        slog("failed to allocate render graph");
+        gf3d_render_graph_close();
+        return;
+    }
+    gf3d_render_graph.device = device;
+    gf3d_render_graph.maxPasses = maxPasses;
+    gf3d_render_graph.maxResources = maxResources;
+    atexit(gf3d_render_graph_close);
+}
+
+void gf3d_render_graph_transients_free()
+{
+    int i;
+    RenderGraphResource *resource;
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[i];
+        if (resource->imported)continue;
+        if (resource->view != VK_NULL_HANDLE)vkDestroyImageView(gf3d_render_graph.device, resource->view, NULL);
+        if (resource->image != VK_NULL_HANDLE)vkDestroyImage(gf3d_render_graph.device, resource->image, NULL);
+        resource->view = VK_NULL_HANDLE;
+        resource->image = VK_NULL_HANDLE;
+    }
+    for (i = 0; i < gf3d_render_graph.blockCount; i++)
+    {
+        if (gf3d_render_graph.blockList[i].memory != VK_NULL_HANDLE)
+        {
+            vkFreeMemory(gf3d_render_graph.device, gf3d_render_graph.blockList[i].memory, NULL);
+            gf3d_memory_gpu_freed(MT_Render,gf3d_render_graph.blockList[i].size);
+        }
+    }
+    gf3d_render_graph.blockCount = 0;
+    gf3d_render_graph.compiled = false;
+}
+
+void gf3d_render_graph_close()
+{
+    gf3d_render_graph_transients_free();
+    if (gf3d_render_graph.passList)gf3d_memory_free(gf3d_render_graph.passList);
+    if (gf3d_render_graph.resourceList)gf3d_memory_free(gf3d_render_graph.resourceList);
+    if (gf3d_render_graph.stateList)gf3d_memory_free(gf3d_render_graph.stateList);
+    if (gf3d_render_graph.blockList)gf3d_memory_free(gf3d_render_graph.blockList);
+    if (gf3d_render_graph.order)gf3d_memory_free(gf3d_render_graph.order);
+    if (gf3d_render_graph.needed)gf3d_memory_free(gf3d_render_graph.needed);
+    if (gf3d_render_graph.imageBarriers)gf3d_memory_free(gf3d_render_graph.imageBarriers);
+    if (gf3d_render_graph.barrierResource)gf3d_memory_free(gf3d_render_graph.barrierResource);
+    memset(&gf3d_render_graph,0,sizeof(RenderGraphManager));
+}
+
+void gf3d_render_graph_reset()
+{
+    gf3d_render_graph_transients_free();
+    memset(gf3d_render_graph.passList,0,sizeof(RenderGraphPass) * gf3d_render_graph.maxPasses);
+    memset(gf3d_render_graph.resourceList,0,sizeof(RenderGraphResource) * gf3d_render_graph.maxResources);
+    gf3d_render_graph.passCount = 0;
+    gf3d_render_graph.resourceCount = 0;
+    memset(&gf3d_render_graph.stats,0,sizeof(RenderGraphStats));
+}
+
+/**
+ * DECLARATION
+ */
+
+RenderGraphResource *gf3d_render_graph_resource_new(const char *name,Sint32 *id)
+{
+    RenderGraphResource *resource;
+    if (gf3d_render_graph.resourceCount >= gf3d_render_graph.maxResources)
+    {
+        slog("render graph is out of resources");
+        return NULL;
+    }
+    *id = gf3d_render_graph.resourceCount++;
+    resource = &gf3d_render_graph.resourceList[*id];
+    memset(resource,0,sizeof(RenderGraphResource));
+    if (name)strncpy(resource->name,name,GF3D_RENDER_GRAPH_NAME_LEN - 1);
+    resource->first = resource->last = -1;
+    resource->block = resource->previous = -1;
+    gf3d_render_graph.compiled = false;
+    return resource;
+}
+
+Sint32 gf3d_render_graph_create_image(const char *name,VkFormat format,VkExtent2D extent)
+{
+    Sint32 id;
+    RenderGraphResource *resource;
+    resource = gf3d_render_graph_resource_new(name,&id);
+    if (!resource)return -1;
+    resource->isImage = true;
+    resource->format = format;
+    resource->extent = extent;
+    resource->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource->initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    resource->finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return id;
+}
+
+Sint32 gf3d_render_graph_import_image(
+    const char *name,
+    VkFormat format,
+    VkImageLayout initialLayout,
+    VkPipelineStageFlags initialStage,
+    VkImageLayout finalLayout)
+{
+    Sint32 id;
+    RenderGraphResource *resource;
+    resource = gf3d_render_graph_resource_new(name,&id);
+    if (!resource)return -1;
+    resource->isImage = true;
+    resource->imported = true;
+    resource->format = format;
+    resource->initialLayout = initialLayout;
+    resource->initialStage = initialStage?initialStage:VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    resource->finalLayout = finalLayout;
+    return id;
+}
+
+Sint32 gf3d_render_graph_import_buffer(const char *name)
+{
+    Sint32 id;
+    RenderGraphResource *resource;
+    resource = gf3d_render_graph_resource_new(name,&id);
+    if (!resource)return -1;
+    resource->imported = true;
+    resource->initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    return id;
+}
+
+void gf3d_render_graph_set_image(Sint32 resource,VkImage image,VkImageView view)
+{
+    if ((resource < 0)||(resource >= gf3d_render_graph.resourceCount))return;
+    if (!gf3d_render_graph.resourceList[resource].imported)
+    {
+        slog("render graph resource %s is transient, its image belongs to the graph",gf3d_render_graph.resourceList[resource].name);
+        return;
+    }
+    gf3d_render_graph.resourceList[resource].image = image;
+    gf3d_render_graph.resourceList[resource].view = view;
+}
+
+void gf3d_render_graph_set_output(Sint32 resource)
+{
+    if ((resource < 0)||(resource >= gf3d_render_graph.resourceCount))return;
+    gf3d_render_graph.resourceList[resource].output = true;
+    gf3d_render_graph.compiled = false;
+}
+
+Sint32 gf3d_render_graph_add_pass(const char *name,RenderGraphExecute execute,void *userData)
+{
+    Sint32 id;
+    RenderGraphPass *pass;
+    if (gf3d_render_graph.passCount >= gf3d_render_graph.maxPasses)
+    {
+        slog("render graph is out of passes");
+        return -1;
+    }
+    id = gf3d_render_graph.passCount++;
+    pass = &gf3d_render_graph.passList[id];
+    memset(pass,0,sizeof(RenderGraphPass));
+    if (name)strncpy(pass->name,name,GF3D_RENDER_GRAPH_NAME_LEN - 1);
+    pass->execute = execute;
+    pass->userData = userData;
+    gf3d_render_graph.compiled = false;
+    return id;
+}
+
+void gf3d_render_graph_use(Sint32 pass,Sint32 resource,RenderGraphUsage usage,Bool write)
+{
+    RenderGraphPass *p;
+    if ((pass < 0)||(pass >= gf3d_render_graph.passCount))return;
+    if ((resource < 0)||(resource >= gf3d_render_graph.resourceCount))return;
+    if ((usage < 0)||(usage >= RGU_MAX))return;
+    p = &gf3d_render_graph.passList[pass];
+    if (p->useCount >= GF3D_RENDER_GRAPH_MAX_USES)
+    {
+        slog("render graph pass %s uses too many resources",p->name);
+        return;
+    }
+    if ((write)&&(!gf3d_render_graph_usage_info[usage].writeAccess))
+    {
+        slog("render graph pass %s cannot write %s with a read only usage",p->name,gf3d_render_graph.resourceList[resource].name);
+        return;
+    }
+    p->uses[p->useCount].resource = resource;
+    p->uses[p->useCount].usage = usage;
+    p->uses[p->useCount].write = write;
+    p->useCount++;
+    gf3d_render_graph.compiled = false;
+}
+
+void gf3d_render_graph_read(Sint32 pass,Sint32 resource,RenderGraphUsage usage)
+{
+    gf3d_render_graph_use(pass,resource,usage,false);
+}
+
+void gf3d_render_graph_write(Sint32 pass,Sint32 resource,RenderGraphUsage usage)
+{
+    gf3d_render_graph_use(pass,resource,usage,true);
+}
+
+/**
+ * COMPILATION
+ */
+
+/**
+ * @brief walk the passes backward keeping only those whose writes something later needs
+ * @note a write that is not also a read replaces the contents, so whatever wrote the resource before is not needed for it
+ */
+void gf3d_render_graph_cull()
+{
+    int i,u;
+    Bool alive;
+    RenderGraphPass *pass;
+    RenderGraphUse *use;
+
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        gf3d_render_graph.needed[i] = gf3d_render_graph.resourceList[i].output;
+    }
+    gf3d_render_graph.stats.culledPasses = 0;
+    for (i = gf3d_render_graph.passCount - 1; i >= 0; i--)
+    {
+        pass = &gf3d_render_graph.passList[i];
+        alive = false;
+        for (u = 0; u < pass->useCount; u++)
+        {
+            use = &pass->uses[u];
+            if ((use->write)&&(gf3d_render_graph.needed[use->resource]))alive = true;
+        }
+        pass->culled = !alive;
+        if (!alive)
+        {
+            gf3d_render_graph.stats.culledPasses++;
+            continue;
+        }
+        for (u = 0; u < pass->useCount; u++)
+        {
+            use = &pass->uses[u];
+            if (use->write)gf3d_render_graph.needed[use->resource] = false;
+        }
+        for (u = 0; u < pass->useCount; u++)
+        {
+            use = &pass->uses[u];
+            if (!use->write)gf3d_render_graph.needed[use->resource] = true;
+        }
+    }
+}
+
+void gf3d_render_graph_lifetimes()
+{
+    int i,u;
+    RenderGraphPass *pass;
+    RenderGraphResource *resource;
+
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[i];
+        resource->first = resource->last = -1;
+        resource->imageUsage = 0;
+        resource->block = resource->previous = -1;
+    }
+    for (i = 0; i < gf3d_render_graph.passCount; i++)
+    {
+        pass = &gf3d_render_graph.passList[i];
+        if (pass->culled)continue;
+        for (u = 0; u < pass->useCount; u++)
+        {
+            resource = &gf3d_render_graph.resourceList[pass->uses[u].resource];
+            if (resource->first < 0)resource->first = i;
+            resource->last = i;
+            resource->imageUsage |= gf3d_render_graph_usage_info[pass->uses[u].usage].imageUsage;
+        }
+    }
+}
+
+VkImageAspectFlags gf3d_render_graph_aspect(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+Bool gf3d_render_graph_image_create(RenderGraphResource *resource)
+{
+    VkImageCreateInfo imageInfo = {0};
+
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = resource->format;
+    imageInfo.extent.width = resource->extent.width;
+    imageInfo.extent.height = resource->extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = resource->imageUsage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(gf3d_render_graph.device, &imageInfo, NULL, &resource->image) != VK_SUCCESS)
+    {
+        slog("failed to create render graph image %s",resource->name);
+        return false;
+    }
+    vkGetImageMemoryRequirements(gf3d_render_graph.device, resource->image, &resource->requirements);
+    return true;
+}
+
+Bool gf3d_render_graph_view_create(RenderGraphResource *resource)
+{
+    VkImageViewCreateInfo viewInfo = {0};
+
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = resource->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = resource->format;
+    viewInfo.subresourceRange.aspectMask = gf3d_render_graph_aspect(resource->format);
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(gf3d_render_graph.device, &viewInfo, NULL, &resource->view) != VK_SUCCESS)
+    {
+        slog("failed to create render graph image view %s",resource->name);
+        return false;
+    }
+    return true;
+}
+
+Bool gf3d_render_graph_block_fits(Uint32 block,RenderGraphResource *resource)
+{
+    int i;
+    RenderGraphResource *other;
+    if (!(gf3d_render_graph.blockList[block].typeBits & resource->requirements.memoryTypeBits))return false;
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        other = &gf3d_render_graph.resourceList[i];
+        if (other->block != block)continue;
+        if ((other->first <= resource->last)&&(resource->first <= other->last))return false;
+    }
+    return true;
+}
+
+/**
+ * @brief create every live transient image and place them in as few memory blocks as their lifetimes allow
+ * @note greedy, largest first: each image goes into the first block it is compatible with and whose images are all
+ * dead before it starts or born after it ends.  Images in a block are all bound at offset 0
+ */
+Bool gf3d_render_graph_alias()
+{
+    int i,j;
+    Sint32 swap;
+    Uint32 count = 0;
+    Uint32 block;
+    Sint32 memoryType;
+    RenderGraphResource *resource,*other;
+    RenderGraphBlock *memory;
+    VkMemoryAllocateInfo allocInfo = {0};
+
+    gf3d_render_graph.stats.transientImages = 0;
+    gf3d_render_graph.stats.transientBytes = 0;
+    gf3d_render_graph.stats.allocatedBytes = 0;
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[i];
+        if ((resource->imported)||(!resource->isImage)||(resource->first < 0))continue;
+        if (!gf3d_render_graph_image_create(resource))return false;
+        gf3d_render_graph.order[count++] = i;
+        gf3d_render_graph.stats.transientImages++;
+        gf3d_render_graph.stats.transientBytes += resource->requirements.size;
+    }
+    // insertion sort, graphs hold a handful of transients
+    for (i = 1; i < count; i++)
+    {
+        for (j = i; j > 0; j--)
+        {
+            resource = &gf3d_render_graph.resourceList[gf3d_render_graph.order[j]];
+            other = &gf3d_render_graph.resourceList[gf3d_render_graph.order[j - 1]];
+            if (resource->requirements.size <= other->requirements.size)break;
+            swap = gf3d_render_graph.order[j];
+            gf3d_render_graph.order[j] = gf3d_render_graph.order[j - 1];
+            gf3d_render_graph.order[j - 1] = swap;
+        }
+    }
+    for (i = 0; i < count; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[gf3d_render_graph.order[i]];
+        for (block = 0; block < gf3d_render_graph.blockCount; block++)
+        {
+            if (gf3d_render_graph_block_fits(block,resource))break;
+        }
+        memory = &gf3d_render_graph.blockList[block];
+        if (block == gf3d_render_graph.blockCount)
+        {
+            gf3d_render_graph.blockCount++;
+            memory->memory = VK_NULL_HANDLE;
+            memory->size = 0;
+            memory->typeBits = resource->requirements.memoryTypeBits;
+        }
+        resource->block = block;
+        memory->typeBits &= resource->requirements.memoryTypeBits;
+        // offset 0 satisfies any alignment, only the size has to cover the largest member
+        memory->size = MAX(memory->size,resource->requirements.size);
+    }
+    // the previous occupant is the one that ends last before this one starts, the first use has to wait on it
+    for (i = 0; i < count; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[gf3d_render_graph.order[i]];
+        for (j = 0; j < count; j++)
+        {
+            other = &gf3d_render_graph.resourceList[gf3d_render_graph.order[j]];
+            if ((other == resource)||(other->block != resource->block))continue;
+            if (other->last >= resource->first)continue;
+            if ((resource->previous < 0)||(other->last > gf3d_render_graph.resourceList[resource->previous].last))
+            {
+                resource->previous = gf3d_render_graph.order[j];
+            }
+        }
+    }
+    for (block = 0; block < gf3d_render_graph.blockCount; block++)
+    {
+        memory = &gf3d_render_graph.blockList[block];
+        memoryType = gf3d_buffers_find_memory_type(memory->typeBits,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (memoryType < 0)
+        {
+            slog("no device local memory type for render graph images");
+            return false;
+        }
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memory->size;
+        allocInfo.memoryTypeIndex = memoryType;
+        if (vkAllocateMemory(gf3d_render_graph.device, &allocInfo, NULL, &memory->memory) != VK_SUCCESS)
+        {
+            slog("failed to allocate render graph memory");
+            return false;
+        }
+        gf3d_memory_gpu_allocated(MT_Render,memory->size);
+        gf3d_render_graph.stats.allocatedBytes += memory->size;
+    }
+    gf3d_render_graph.stats.memoryBlocks = gf3d_render_graph.blockCount;
+    for (i = 0; i < count; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[gf3d_render_graph.order[i]];
+        vkBindImageMemory(gf3d_render_graph.device, resource->image, gf3d_render_graph.blockList[resource->block].memory, 0);
+        if (!gf3d_render_graph_view_create(resource))return false;
+    }
+    return true;
+}
+
+void gf3d_render_graph_image_barrier_add(
+    RenderGraphPass *pass,
+    Sint32 resource,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier *barrier;
+    if (gf3d_render_graph.barrierCount >= gf3d_render_graph.maxBarriers)
+    {
+        slog("render graph is out of barriers");
+        return;
+    }
+    gf3d_render_graph.barrierResource[gf3d_render_graph.barrierCount] = resource;
+    barrier = &gf3d_render_graph.imageBarriers[gf3d_render_graph.barrierCount++];
+    memset(barrier,0,sizeof(VkImageMemoryBarrier));
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->srcAccessMask = srcAccess;
+    barrier->dstAccessMask = dstAccess;
+    barrier->oldLayout = oldLayout;
+    barrier->newLayout = newLayout;
+    barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->subresourceRange.aspectMask = gf3d_render_graph_aspect(gf3d_render_graph.resourceList[resource].format);
+    barrier->subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    pass->barrierCount++;
+}
+
+void gf3d_render_graph_memory_barrier_add(RenderGraphPass *pass,VkAccessFlags srcAccess,VkAccessFlags dstAccess)
+{
+    pass->memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    pass->memoryBarrier.srcAccessMask |= srcAccess;
+    pass->memoryBarrier.dstAccessMask |= dstAccess;
+}
+
+void gf3d_render_graph_state_reset()
+{
+    int i;
+    RenderGraphResource *resource;
+    RenderGraphState *state;
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[i];
+        state = &gf3d_render_graph.stateList[i];
+        state->layout = resource->initialLayout;
+        state->writeStage = resource->initialStage;
+        state->writeAccess = 0;
+        state->readStages = 0;
+        state->visibleStages = 0;
+    }
+}
+
+/**
+ * @brief work out the barrier one pass needs for one resource, folding together everything the pass does with it
+ */
+void gf3d_render_graph_pass_resource_barrier(RenderGraphPass *pass,Sint32 resource)
+{
+    int u;
+    Bool read = false,write = false,hazard = false;
+    VkPipelineStageFlags stage = 0;
+    VkAccessFlags access = 0,writeAccess = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags srcStage = 0;
+    VkAccessFlags srcAccess = 0;
+    const RenderGraphUsageInfo *info;
+    RenderGraphResource *res = &gf3d_render_graph.resourceList[resource];
+    RenderGraphState *state = &gf3d_render_graph.stateList[resource];
+    RenderGraphState *previous;
+
+    for (u = 0; u < pass->useCount; u++)
+    {
+        if (pass->uses[u].resource != resource)continue;
+        info = &gf3d_render_graph_usage_info[pass->uses[u].usage];
+        stage |= info->stage;
+        if (pass->uses[u].write)
+        {
+            write = true;
+            writeAccess |= info->writeAccess;
+            access |= info->writeAccess | info->readAccess;     // attachments writes also read for blending and testing
+            layout = info->writeLayout;
+        }
+        else
+        {
+            read = true;
+            access |= info->readAccess;
+            if (layout == VK_IMAGE_LAYOUT_UNDEFINED)layout = info->readLayout;
+        }
+    }
+    if ((res->first >= 0)&&(pass == &gf3d_render_graph.passList[res->first])&&(res->previous >= 0))
+    {
+        // the memory was last used by another image, so wait for that one to be done with it
+        previous = &gf3d_render_graph.stateList[res->previous];
+        state->writeStage = previous->writeStage | previous->readStages;
+        state->writeAccess = previous->writeAccess;
+        state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    if ((res->isImage)&&(state->layout != layout))
+    {
+        // a layout transition is a write, it has to wait for every earlier read and write
+        hazard = true;
+        srcStage = state->writeStage | state->readStages;
+        srcAccess = state->writeAccess;
+    }
+    else if (write)
+    {
+        // write after write and write after read
+        hazard = true;
+        srcStage = state->writeStage | state->readStages;
+        srcAccess = state->writeAccess;
+    }
+    else if ((state->writeAccess)&&(stage & ~state->visibleStages))
+    {
+        // read after write, unless an earlier barrier already made the write visible to these stages
+        hazard = true;
+        srcStage = state->writeStage;
+        srcAccess = state->writeAccess;
+    }
+    if ((hazard)&&(!state->writeAccess)&&(!state->readStages)&&(!res->isImage || (state->layout == layout)))
+    {
+        // nothing has touched the resource yet and there is no transition to make
+        hazard = false;
+    }
+    if (hazard)
+    {
+        pass->srcStage |= srcStage;
+        pass->dstStage |= stage;
+        if (res->isImage)
+        {
+            gf3d_render_graph_image_barrier_add(pass,resource,(write && !read)?VK_IMAGE_LAYOUT_UNDEFINED:state->layout,layout,srcAccess,access);
+        }
+        else
+        {
+            gf3d_render_graph_memory_barrier_add(pass,srcAccess,access);
+        }
+    }
+
+    if (res->isImage)state->layout = layout;
+    if (write)
+    {
+        state->writeStage = stage;
+        state->writeAccess = writeAccess;
+        state->readStages = read?stage:0;
+        state->visibleStages = stage;
+    }
+    else
+    {
+        state->readStages |= stage;
+        if (hazard)state->visibleStages |= stage;
+    }
+}
+
+void gf3d_render_graph_barriers()
+{
+    int i,u,v;
+    Bool seen;
+    RenderGraphPass *pass;
+    RenderGraphResource *resource;
+    RenderGraphState *state;
+
+    gf3d_render_graph.barrierCount = 0;
+    gf3d_render_graph_state_reset();
+    for (i = 0; i < gf3d_render_graph.passCount; i++)
+    {
+        pass = &gf3d_render_graph.passList[i];
+        pass->srcStage = pass->dstStage = 0;
+        memset(&pass->memoryBarrier,0,sizeof(VkMemoryBarrier));
+        pass->barrierFirst = gf3d_render_graph.barrierCount;
+        pass->barrierCount = 0;
+        if (pass->culled)continue;
+        for (u = 0; u < pass->useCount; u++)
+        {
+            // each resource once per pass, however many ways the pass uses it
+            seen = false;
+            for (v = 0; v < u; v++)
+            {
+                if (pass->uses[v].resource == pass->uses[u].resource)seen = true;
+            }
+            if (seen)continue;
+            gf3d_render_graph_pass_resource_barrier(pass,pass->uses[u].resource);
+        }
+    }
+    // leave imported images how their owner expects them
+    pass = &gf3d_render_graph.finalPass;
+    memset(pass,0,sizeof(RenderGraphPass));
+    pass->barrierFirst = gf3d_render_graph.barrierCount;
+    for (i = 0; i < gf3d_render_graph.resourceCount; i++)
+    {
+        resource = &gf3d_render_graph.resourceList[i];
+        state = &gf3d_render_graph.stateList[i];
+        if ((!resource->imported)||(!resource->isImage)||(resource->first < 0))continue;
+        if ((resource->finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)||(resource->finalLayout == state->layout))continue;
+        pass->srcStage |= state->writeStage | state->readStages;
+        pass->dstStage |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        gf3d_render_graph_image_barrier_add(pass,i,state->layout,resource->finalLayout,state->writeAccess,0);
+    }
+}
+
+Bool gf3d_render_graph_compile()
+{
+    int i;
+    RenderGraphPass *pass;
+
+    if (!gf3d_render_graph.passList)return false;
+    gf3d_render_graph_transients_free();
+    gf3d_render_graph_cull();
+    gf3d_render_graph_lifetimes();
+    if (!gf3d_render_graph_alias())
+    {
+        gf3d_render_graph_transients_free();
+        return false;
+    }
+    gf3d_render_graph_barriers();
+
+    gf3d_render_graph.stats.passes = gf3d_render_graph.passCount;
+    gf3d_render_graph.stats.barrierBatches = 0;
+    gf3d_render_graph.stats.memoryBarriers = 0;
+    gf3d_render_graph.stats.imageBarriers = gf3d_render_graph.barrierCount;
+    for (i = 0; i <= gf3d_render_graph.passCount; i++)
+    {
+        pass = (i < gf3d_render_graph.passCount)?&gf3d_render_graph.passList[i]:&gf3d_render_graph.finalPass;
+        if (pass->memoryBarrier.sType)gf3d_render_graph.stats.memoryBarriers++;
+        if ((pass->barrierCount)||(pass->memoryBarrier.sType))gf3d_render_graph.stats.barrierBatches++;
+    }
+    gf3d_render_graph.compiled = true;
+    return true;
+}
+
+/**
+ * EXECUTION
+ */
+
+void gf3d_render_graph_barrier_record(VkCommandBuffer commandBuffer,RenderGraphPass *pass)
+{
+    int i;
+    if ((!pass->barrierCount)&&(!pass->memoryBarrier.sType))return;
+    for (i = 0; i < pass->barrierCount; i++)
+    {
+        gf3d_render_graph.imageBarriers[pass->barrierFirst + i].image =
+            gf3d_render_graph.resourceList[gf3d_render_graph.barrierResource[pass->barrierFirst + i]].image;
+    }
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        pass->srcStage?pass->srcStage:VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        pass->dstStage,
+        0,
+        pass->memoryBarrier.sType?1:0, &pass->memoryBarrier,
+        0, NULL,
+        pass->barrierCount, &gf3d_render_graph.imageBarriers[pass->barrierFirst]);
+}
+
+void gf3d_render_graph_execute(VkCommandBuffer commandBuffer)
+{
+    int i;
+    RenderGraphPass *pass;
+
+    if (!gf3d_render_graph.compiled)
+    {
+        if (!gf3d_render_graph_compile())return;
+    }
+    for (i = 0; i < gf3d_render_graph.passCount; i++)
+    {
+        pass = &gf3d_render_graph.passList[i];
+        if (pass->culled)continue;
+        gf3d_render_graph_barrier_record(commandBuffer,pass);
+        if (pass->execute)pass->execute(commandBuffer,i,pass->userData);
+    }
+    gf3d_render_graph_barrier_record(commandBuffer,&gf3d_render_graph.finalPass);
+}
+
+VkImage gf3d_render_graph_get_image(Sint32 resource)
+{
+    if ((resource < 0)||(resource >= gf3d_render_graph.resourceCount))return VK_NULL_HANDLE;
+    return gf3d_render_graph.resourceList[resource].image;
+}
+
+VkImageView gf3d_render_graph_get_image_view(Sint32 resource)
+{
+    if ((resource < 0)||(resource >= gf3d_render_graph.resourceCount))return VK_NULL_HANDLE;
+    return gf3d_render_graph.resourceList[resource].view;
+}
+
+Bool gf3d_render_graph_pass_culled(Sint32 pass)
+{
+    if ((pass < 0)||(pass >= gf3d_render_graph.passCount))return true;
+    return gf3d_render_graph.passList[pass].culled;
+}
+
+void gf3d_render_graph_get_stats(RenderGraphStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_render_graph.stats,sizeof(RenderGraphStats));
+}
+
+/*eol@eof*/
@@ -0,0 +1,342 @@
+#include "gf3d_render_queue.h"
+
+#include <SDL.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_uniforms.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#define GF3D_RQ_LAYER_SHIFT     60
+#define GF3D_RQ_ID_BITS         12
+#define GF3D_RQ_ID_MASK         0xFFF
+#define GF3D_RQ_DEPTH_BITS      24
+#define GF3D_RQ_DEPTH_MASK      0xFFFFFF
+
+typedef struct
+{
+    Pipeline   *pipe;
+    Mesh       *mesh;
+    Uint32      material;
+    Sint32      object;
+    Vector3D    position;
+    RenderLayer layer;
+}RenderItem;
+
+typedef struct
+{
+    Uint64      key;
+    Uint32      item;
+}RenderKey;
+
+typedef struct
+{
+    Uint32              maxItems;
+    Uint32              itemCount;
+    RenderItem         *itemList;
+    RenderKey          *keyList;        /**<sorted keys after gf3d_render_queue_end*/
+    RenderKey          *keyScratch;     /**<the other half of the radix sort ping pong*/
+    RenderQueueStats    stats;
+}RenderQueueManager;
+
+static RenderQueueManager gf3d_render_queue = {0};
+
+void gf3d_render_queue_close();
+
+void gf3d_render_queue_init(Uint32 maxItems)
+{
+    if (!maxItems)
+    {
+        slog("cannot initialize a render queue with zero items");
+        return;
+    }
+    gf3d_render_queue.itemList = (RenderItem *)gf3d_memory_allocate(MT_Render,sizeof(RenderItem),maxItems);
+    gf3d_render_queue.keyList = (RenderKey *)gf3d_memory_allocate(MT_Render,sizeof(RenderKey),maxItems);
+    gf3d_render_queue.keyScratch = (RenderKey *)gf3d_memory_allocate(MT_Render,sizeof(RenderKey),maxItems);
+    if ((!gf3d_render_queue.itemList)||(!gf3d_render_queue.keyList)||(!gf3d_render_queue.keyScratch))
+    {
+        slog("failed to allocate render queue");
+        gf3d_render_queue_close();
+        return;
+    }
+    gf3d_render_queue.maxItems = maxItems;
+    slog("render queue initialized for %i draws per frame",maxItems);
+    atexit(gf3d_render_queue_close);
+}
+
+void gf3d_render_queue_close()
+{
+    if (gf3d_render_queue.itemList)gf3d_memory_free(gf3d_render_queue.itemList);
+    if (gf3d_render_queue.keyList)gf3d_memory_free(gf3d_render_queue.keyList);
+    if (gf3d_render_queue.keyScratch)gf3d_memory_free(gf3d_render_queue.keyScratch);
+    memset(&gf3d_render_queue,0,sizeof(RenderQueueManager));
+}
+
+void gf3d_render_queue_begin()
+{
+    gf3d_render_queue.itemCount = 0;
+    gf3d_render_queue.stats.submitted = 0;
+    gf3d_render_queue.stats.dropped = 0;
+}
+
+void gf3d_render_queue_submit(RenderLayer layer,Pipeline *pipe,Uint32 material,Mesh *mesh,Sint32 object,Vector3D position)
+{
+    RenderItem *item;
+    if ((!pipe)||(!mesh)||(layer < 0)||(layer >= RL_MAX))return;
+    if (gf3d_render_queue.itemCount >= gf3d_render_queue.maxItems)
+    {
+        gf3d_render_queue.stats.dropped++;
+        return;
+    }
+    item = &gf3d_render_queue.itemList[gf3d_render_queue.itemCount++];
+    item->layer = layer;
+    item->pipe = pipe;
+    item->material = material;
+    item->mesh = mesh;
+    item->object = object;
+    item->position = position;
+    gf3d_render_queue.stats.submitted++;
+}
+
+/**
+ * KEYS
+ */
+
+/**
+ * @brief quantize a view depth to 24 bits that sort in the same order as the depth
+ * @note the bits of a positive float already sort like the float, so the top 24 below the sign bit are kept.
+ * this gives more precision near the camera and needs no near or far range
+ */
+Uint32 gf3d_render_queue_quantize_depth(float depth)
+{
+    union
+    {
+        float   f;
+        Uint32  u;
+    }bits;
+    if (!(depth > 0))return 0;  // also catches NaN
+    bits.f = depth;
+    return (bits.u >> (31 - GF3D_RQ_DEPTH_BITS)) & GF3D_RQ_DEPTH_MASK;
+}
+
+Uint64 gf3d_render_queue_make_key(RenderItem *item,Matrix4 view)
+{
+    Uint64 key;
+    Uint64 pipe,material,mesh,depth;
+    float viewZ;
+
+    // the camera looks down -z in view space
+    viewZ = item->position.x * view[0][2] + item->position.y * view[1][2] + item->position.z * view[2][2] + view[3][2];
+    depth = gf3d_render_queue_quantize_depth(-viewZ);
+    // ids past 12 bits alias, which only costs sort quality: recording compares the real pointers
+    pipe = gf3d_pipeline_get_index(item->pipe) & GF3D_RQ_ID_MASK;
+    material = item->material & GF3D_RQ_ID_MASK;
+    mesh = gf3d_mesh_get_index(item->mesh) & GF3D_RQ_ID_MASK;
+
+    key = (Uint64)item->layer << GF3D_RQ_LAYER_SHIFT;
+    if (item->layer == RL_Opaque)
+    {
+        key |= pipe << 48;
+        key |= material << 36;
+        key |= mesh << 24;
+        key |= depth;
+    }
+    else
+    {
+        key |= (GF3D_RQ_DEPTH_MASK - depth) << 36;
+        key |= pipe << 24;
+        key |= material << 12;
+        key |= mesh;
+    }
+    return key;
+}
+
+/**
+ * @brief least significant digit radix sort of the key list, one byte per pass
+ * @return how many passes were run
+ */
+Uint32 gf3d_render_queue_radix_sort(Uint32 count)
+{
+    int i,pass;
+    Uint32 passes = 0;
+    Uint32 sum,digit;
+    Uint32 histogram[8][256];
+    RenderKey *src = gf3d_render_queue.keyList;
+    RenderKey *dst = gf3d_render_queue.keyScratch;
+    RenderKey *swap;
+
+    // every histogram is gathered in one read of the keys
+    memset(histogram,0,sizeof(histogram));
+    for (i = 0; i < count; i++)
+    {
+        for (pass = 0; pass < 8; pass++)
+        {
+            histogram[pass][(src[i].key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+    for (pass = 0; pass < 8; pass++)
+    {
+        // a byte that every key shares would leave the order untouched
+        if (histogram[pass][(src[0].key >> (pass * 8)) & 0xFF] == count)continue;
+        sum = 0;
+        for (i = 0; i < 256; i++)
+        {
+            digit = histogram[pass][i];
+            histogram[pass][i] = sum;
+            sum += digit;
+        }
+        for (i = 0; i < count; i++)
+        {
+            dst[histogram[pass][(src[i].key >> (pass * 8)) & 0xFF]++] = src[i];
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+        passes++;
+    }
+    gf3d_render_queue.keyList = src;
+    gf3d_render_queue.keyScratch = dst;
+    return passes;
+}
+
+/**
+ * @brief count the state changes recording the items in an order would take
+ * @param sorted if true walk the sorted key list, otherwise walk submission order
+ */
+void gf3d_render_queue_count_changes(Bool sorted,Uint32 *pipelineBinds,Uint32 *materialChanges,Uint32 *meshBinds)
+{
+    int i;
+    RenderItem *item;
+    Pipeline *pipe = NULL;
+    Mesh *mesh = NULL;
+    Uint32 material = 0;
+
+    *pipelineBinds = *materialChanges = *meshBinds = 0;
+    for (i = 0; i < gf3d_render_queue.itemCount; i++)
+    {
+        if (sorted)item = &gf3d_render_queue.itemList[gf3d_render_queue.keyList[i].item];
+        else item = &gf3d_render_queue.itemList[i];
+        if (item->pipe != pipe)
+        {
+            pipe = item->pipe;
+            (*pipelineBinds)++;
+            // a new pipeline needs its material state set again
+            material = item->material;
+            (*materialChanges)++;
+        }
+        else if (item->material != material)
+        {
+            material = item->material;
+            (*materialChanges)++;
+        }
+        if (item->mesh != mesh)
+        {
+            mesh = item->mesh;
+            (*meshBinds)++;
+        }
+    }
+}
+
+void gf3d_render_queue_end()
+{
+    int i;
+    Uint64 start;
+    Uint32 pipelineBinds,materialChanges,meshBinds;
+    CameraUniform camera;
+    RenderQueueStats *stats = &gf3d_render_queue.stats;
+
+    stats->sortPasses = 0;
+    if (!gf3d_render_queue.itemCount)
+    {
+        stats->pipelineBinds = stats->materialChanges = stats->meshBinds = 0;
+        stats->pipelineBindsAvoided = stats->materialChangesAvoided = stats->meshBindsAvoided = 0;
+        stats->sortMs = 0;
+        return;
+    }
+    start = SDL_GetPerformanceCounter();
+    gf3d_uniforms_get_camera(&camera);
+    for (i = 0; i < gf3d_render_queue.itemCount; i++)
+    {
+        gf3d_render_queue.keyList[i].key = gf3d_render_queue_make_key(&gf3d_render_queue.itemList[i],camera.view);
+        gf3d_render_queue.keyList[i].item = i;
+    }
+    stats->sortPasses = gf3d_render_queue_radix_sort(gf3d_render_queue.itemCount);
+    stats->sortMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    gf3d_render_queue_count_changes(false,&pipelineBinds,&materialChanges,&meshBinds);
+    gf3d_render_queue_count_changes(true,&stats->pipelineBinds,&stats->materialChanges,&stats->meshBinds);
+    stats->pipelineBindsAvoided = (Sint32)pipelineBinds - (Sint32)stats->pipelineBinds;
+    stats->materialChangesAvoided = (Sint32)materialChanges - (Sint32)stats->materialChanges;
+    stats->meshBindsAvoided = (Sint32)meshBinds - (Sint32)stats->meshBinds;
+}
+
+void gf3d_render_queue_record(VkCommandBuffer commandBuffer,Uint32 frame,Bool depthOnly)
+{
+    int i;
+    Uint64 start;
+    RenderItem *item;
+    Pipeline *pipe = NULL;
+    Mesh *mesh = NULL;
+    Sint32 object = 0;
+    VkDeviceSize offset = 0;
+    VkDescriptorSet set;
+
+    if (!gf3d_render_queue.itemCount)
+    {
+        if (!depthOnly)gf3d_render_queue.stats.recordMs = 0;
+        return;
+    }
+    start = SDL_GetPerformanceCounter();
+    // every draw of a frame uses the same set, only the dynamic offset selecting the model matrix moves
+    set = gf3d_uniforms_get_set(frame);
+    for (i = 0; i < gf3d_render_queue.itemCount; i++)
+    {
+        item = &gf3d_render_queue.itemList[gf3d_render_queue.keyList[i].item];
+        if (depthOnly)
+        {
+            // opaque keys sort first, so the pre-pass is done at the first other layer
+            if (item->layer != RL_Opaque)break;
+            if (!item->pipe->depthPipeline)continue;
+        }
+        if (item->pipe != pipe)
+        {
+            pipe = item->pipe;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly?pipe->depthPipeline:pipe->graphicsPipeline);
+            // a new layout needs the set bound again
+            gf3d_uniforms_bind_set(commandBuffer, pipe->pipelineLayout, set, item->object);
+            object = item->object;
+        }
+        else if (item->object != object)
+        {
+            gf3d_uniforms_bind_set(commandBuffer, pipe->pipelineLayout, set, item->object);
+            object = item->object;
+        }
+        if (item->mesh != mesh)
+        {
+            mesh = item->mesh;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->vertexBuffer.buffer, &offset);
+            vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        }
+        vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, 0);
+    }
+    if (!depthOnly)gf3d_render_queue.stats.recordMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void gf3d_render_queue_draw(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_render_queue_record(commandBuffer,frame,false);
+}
+
+void gf3d_render_queue_draw_depth(VkCommandBuffer commandBuffer,Uint32 frame)
+{
+    gf3d_render_queue_record(commandBuffer,frame,true);
+}
+
+void gf3d_render_queue_get_stats(RenderQueueStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_render_queue.stats,sizeof(RenderQueueStats));
+}
+
+/*eol@eof*/
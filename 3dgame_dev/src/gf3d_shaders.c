@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include "gf3d_shaders.h"
+#include "gf3d_memory.h"
 #include "simple_logger.h"
 
 
@@ -41,7 +42,7 @@ char *gf3d_shaders_load_data(char * filename,size_t *rsize)
         return NULL;
     }
     rewind(file);
-    buffer = gf3d_allocate_array(sizeof(char),size);
+    buffer = gf3d_memory_allocate(MT_Pipeline,sizeof(char),size);
     if (!buffer)
     {
         slog("failed to allocate memory for shader file %s",filename);
@@ -0,0 +1,688 @@
+#include "gf3d_spatial.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "simple_logger.h"
+#include "gf3d_memory.h"
+
+#define GF3D_SPATIAL_NULL           -1
+#define GF3D_SPATIAL_STACK_SIZE     256     // deeper than any balanced tree can get
+#define GF3D_SPATIAL_DISPLACEMENT   4.0     // how many frames of motion the fat box is stretched by
+
+typedef struct
+{
+    AABB        box;            /**<fat box for leaves, union of the children for branches*/
+    void       *data;
+    Sint32      parent;         /**<doubles as the next link while the node is free*/
+    Sint32      child1;         /**<GF3D_SPATIAL_NULL for leaves*/
+    Sint32      child2;
+    Sint32      height;         /**<0 for leaves, -1 while free*/
+}SpatialNode;
+
+struct SpatialTree_S
+{
+    SpatialNode    *nodeList;
+    Uint32          nodeMax;
+    Sint32          root;
+    Sint32          freeList;
+    float           margin;
+    SpatialStats    stats;
+};
+
+/**
+ * BOXES
+ */
+
+static AABB gf3d_spatial_union(AABB a,AABB b)
+{
+    AABB out;
+    out.min.x = MIN(a.min.x,b.min.x);
+    out.min.y = MIN(a.min.y,b.min.y);
+    out.min.z = MIN(a.min.z,b.min.z);
+    out.max.x = MAX(a.max.x,b.max.x);
+    out.max.y = MAX(a.max.y,b.max.y);
+    out.max.z = MAX(a.max.z,b.max.z);
+    return out;
+}
+
+static float gf3d_spatial_area(AABB a)
+{
+    float x = a.max.x - a.min.x;
+    float y = a.max.y - a.min.y;
+    float z = a.max.z - a.min.z;
+    return 2 * (x * y + y * z + z * x);
+}
+
+static Bool gf3d_spatial_contains(AABB outer,AABB inner)
+{
+    return (outer.min.x <= inner.min.x)&&(outer.min.y <= inner.min.y)&&(outer.min.z <= inner.min.z)&&
+           (outer.max.x >= inner.max.x)&&(outer.max.y >= inner.max.y)&&(outer.max.z >= inner.max.z);
+}
+
+static Bool gf3d_spatial_overlaps(AABB a,AABB b)
+{
+    if ((a.max.x < b.min.x)||(a.min.x > b.max.x))return false;
+    if ((a.max.y < b.min.y)||(a.min.y > b.max.y))return false;
+    if ((a.max.z < b.min.z)||(a.min.z > b.max.z))return false;
+    return true;
+}
+
+/**
+ * NODES
+ */
+
+SpatialTree *gf3d_spatial_tree_new(Uint32 capacity,float margin)
+{
+    int i;
+    SpatialTree *tree;
+
+    if (!capacity)capacity = 16;
+    tree = (SpatialTree *)gf3d_memory_allocate(MT_Scene,sizeof(SpatialTree),1);
+    if (!tree)
+    {
+        slog("failed to allocate spatial tree");
+        return NULL;
+    }
+    // a tree of n leaves has n - 1 branches
+    tree->nodeMax = capacity * 2;
+    tree->nodeList = (SpatialNode *)gf3d_memory_allocate(MT_Scene,sizeof(SpatialNode),tree->nodeMax);
+    if (!tree->nodeList)
+    {
+        slog("failed to allocate spatial tree nodes");
+        gf3d_memory_free(tree);
+        return NULL;
+    }
+    for (i = 0; i < tree->nodeMax; i++)
+    {
+        tree->nodeList[i].parent = (i + 1 < tree->nodeMax)?(i + 1):GF3D_SPATIAL_NULL;
+        tree->nodeList[i].height = -1;
+    }
+    tree->freeList = 0;
+    tree->root = GF3D_SPATIAL_NULL;
+    tree->margin = margin;
+    return tree;
+}
+
+void gf3d_spatial_tree_free(SpatialTree *tree)
+{
+    if (!tree)return;
+    if (tree->nodeList)gf3d_memory_free(tree->nodeList);
+    gf3d_memory_free(tree);
+}
+
+static Sint32 gf3d_spatial_node_new(SpatialTree *tree)
+{
+    int i;
+    Sint32 node;
+    Uint32 oldMax;
+    SpatialNode *nodeList;
+
+    if (tree->freeList == GF3D_SPATIAL_NULL)
+    {
+        // nodes are referred to by index, so growing the array does not invalidate anything
+        oldMax = tree->nodeMax;
+        nodeList = (SpatialNode *)gf3d_memory_allocate(MT_Scene,sizeof(SpatialNode),oldMax * 2);
+        if (!nodeList)
+        {
+            slog("failed to grow spatial tree to %i nodes",oldMax * 2);
+            return GF3D_SPATIAL_NULL;
+        }
+        memcpy(nodeList,tree->nodeList,sizeof(SpatialNode) * oldMax);
+        gf3d_memory_free(tree->nodeList);
+        tree->nodeList = nodeList;
+        tree->nodeMax = oldMax * 2;
+        for (i = oldMax; i < tree->nodeMax; i++)
+        {
+            tree->nodeList[i].parent = (i + 1 < tree->nodeMax)?(i + 1):GF3D_SPATIAL_NULL;
+            tree->nodeList[i].height = -1;
+        }
+        tree->freeList = oldMax;
+    }
+    node = tree->freeList;
+    tree->freeList = tree->nodeList[node].parent;
+    tree->nodeList[node].parent = GF3D_SPATIAL_NULL;
+    tree->nodeList[node].child1 = GF3D_SPATIAL_NULL;
+    tree->nodeList[node].child2 = GF3D_SPATIAL_NULL;
+    tree->nodeList[node].height = 0;
+    tree->nodeList[node].data = NULL;
+    tree->stats.nodes++;
+    return node;
+}
+
+static void gf3d_spatial_node_free(SpatialTree *tree,Sint32 node)
+{
+    tree->nodeList[node].parent = tree->freeList;
+    tree->nodeList[node].height = -1;
+    tree->freeList = node;
+    tree->stats.nodes--;
+}
+
+/**
+ * BALANCING
+ */
+
+/**
+ * @brief if node a is unbalanced, rotate its taller child up into its place
+ * @return the node now at a's position
+ */
+static Sint32 gf3d_spatial_balance(SpatialTree *tree,Sint32 iA)
+{
+    Sint32 iB,iC,iUp,iF,iG;
+    Sint32 balance;
+    SpatialNode *A,*B,*C,*Up,*F,*G;
+
+    A = &tree->nodeList[iA];
+    if ((A->child1 == GF3D_SPATIAL_NULL)||(A->height < 2))return iA;
+
+    iB = A->child1;
+    iC = A->child2;
+    B = &tree->nodeList[iB];
+    C = &tree->nodeList[iC];
+    balance = C->height - B->height;
+    if ((balance <= 1)&&(balance >= -1))return iA;
+
+    // the taller child moves up, and the shorter of its children takes its place under A
+    if (balance > 1)
+    {
+        iUp = iC;
+        Up = C;
+    }
+    else
+    {
+        iUp = iB;
+        Up = B;
+        B = C;      // B is now the child that stays under A
+        iB = iC;
+    }
+    iF = Up->child1;
+    iG = Up->child2;
+    F = &tree->nodeList[iF];
+    G = &tree->nodeList[iG];
+
+    Up->child1 = iA;
+    Up->parent = A->parent;
+    A->parent = iUp;
+    if (Up->parent != GF3D_SPATIAL_NULL)
+    {
+        if (tree->nodeList[Up->parent].child1 == iA)tree->nodeList[Up->parent].child1 = iUp;
+        else tree->nodeList[Up->parent].child2 = iUp;
+    }
+    else
+    {
+        tree->root = iUp;
+    }
+
+    if (F->height > G->height)
+    {
+        Up->child2 = iF;
+        if (A->child1 == iUp)A->child1 = iG;
+        else A->child2 = iG;
+        G->parent = iA;
+        A->box = gf3d_spatial_union(B->box,G->box);
+        Up->box = gf3d_spatial_union(A->box,F->box);
+        A->height = 1 + MAX(B->height,G->height);
+        Up->height = 1 + MAX(A->height,F->height);
+    }
+    else
+    {
+        Up->child2 = iG;
+        if (A->child1 == iUp)A->child1 = iF;
+        else A->child2 = iF;
+        F->parent = iA;
+        A->box = gf3d_spatial_union(B->box,F->box);
+        Up->box = gf3d_spatial_union(A->box,G->box);
+        A->height = 1 + MAX(B->height,F->height);
+        Up->height = 1 + MAX(A->height,G->height);
+    }
+    tree->stats.rotations++;
+    return iUp;
+}
+
+static void gf3d_spatial_refit(SpatialTree *tree,Sint32 index)
+{
+    SpatialNode *node;
+    // walk to the root fixing bounds and heights, rebalancing along the way
+    while (index != GF3D_SPATIAL_NULL)
+    {
+        index = gf3d_spatial_balance(tree,index);
+        node = &tree->nodeList[index];
+        node->height = 1 + MAX(tree->nodeList[node->child1].height,tree->nodeList[node->child2].height);
+        node->box = gf3d_spatial_union(tree->nodeList[node->child1].box,tree->nodeList[node->child2].box);
+        index = node->parent;
+    }
+}
+
+/**
+ * INSERTION
+ */
+
+static Sint32 gf3d_spatial_pick_sibling(SpatialTree *tree,AABB leafBox)
+{
+    Sint32 index = tree->root;
+    Sint32 child;
+    int c;
+    float area,combinedArea,cost,inheritance;
+    float childCost[2];
+    SpatialNode *node;
+    AABB combined;
+
+    // descend toward whichever child adds the least surface area, stopping when making a new parent here is cheaper
+    while (tree->nodeList[index].child1 != GF3D_SPATIAL_NULL)
+    {
+        node = &tree->nodeList[index];
+        area = gf3d_spatial_area(node->box);
+        combinedArea = gf3d_spatial_area(gf3d_spatial_union(node->box,leafBox));
+        cost = 2 * combinedArea;
+        inheritance = 2 * (combinedArea - area);
+        for (c = 0; c < 2; c++)
+        {
+            child = c?node->child2:node->child1;
+            combined = gf3d_spatial_union(leafBox,tree->nodeList[child].box);
+            if (tree->nodeList[child].child1 == GF3D_SPATIAL_NULL)
+            {
+                childCost[c] = gf3d_spatial_area(combined) + inheritance;
+            }
+            else
+            {
+                childCost[c] = gf3d_spatial_area(combined) - gf3d_spatial_area(tree->nodeList[child].box) + inheritance;
+            }
+        }
+        if ((cost < childCost[0])&&(cost < childCost[1]))break;
+        index = (childCost[0] < childCost[1])?node->child1:node->child2;
+    }
+    return index;
+}
+
+static Bool gf3d_spatial_insert_leaf(SpatialTree *tree,Sint32 leaf)
+{
+    Sint32 sibling,oldParent,newParent;
+    AABB leafBox;
+
+    if (tree->root == GF3D_SPATIAL_NULL)
+    {
+        tree->root = leaf;
+        tree->nodeList[leaf].parent = GF3D_SPATIAL_NULL;
+        return true;
+    }
+    leafBox = tree->nodeList[leaf].box;
+    sibling = gf3d_spatial_pick_sibling(tree,leafBox);
+
+    newParent = gf3d_spatial_node_new(tree);
+    if (newParent == GF3D_SPATIAL_NULL)return false;
+    oldParent = tree->nodeList[sibling].parent;
+    tree->nodeList[newParent].parent = oldParent;
+    tree->nodeList[newParent].box = gf3d_spatial_union(leafBox,tree->nodeList[sibling].box);
+    tree->nodeList[newParent].height = tree->nodeList[sibling].height + 1;
+    tree->nodeList[newParent].child1 = sibling;
+    tree->nodeList[newParent].child2 = leaf;
+    tree->nodeList[sibling].parent = newParent;
+    tree->nodeList[leaf].parent = newParent;
+    if (oldParent != GF3D_SPATIAL_NULL)
+    {
+        if (tree->nodeList[oldParent].child1 == sibling)tree->nodeList[oldParent].child1 = newParent;
+        else tree->nodeList[oldParent].child2 = newParent;
+    }
+    else
+    {
+        tree->root = newParent;
+    }
+    gf3d_spatial_refit(tree,oldParent);
+    return true;
+}
+
+static void gf3d_spatial_remove_leaf(SpatialTree *tree,Sint32 leaf)
+{
+    Sint32 parent,grandParent,sibling;
+
+    if (leaf == tree->root)
+    {
+        tree->root = GF3D_SPATIAL_NULL;
+        return;
+    }
+    // the leaf's parent goes away and the sibling takes its place
+    parent = tree->nodeList[leaf].parent;
+    grandParent = tree->nodeList[parent].parent;
+    sibling = (tree->nodeList[parent].child1 == leaf)?tree->nodeList[parent].child2:tree->nodeList[parent].child1;
+    if (grandParent != GF3D_SPATIAL_NULL)
+    {
+        if (tree->nodeList[grandParent].child1 == parent)tree->nodeList[grandParent].child1 = sibling;
+        else tree->nodeList[grandParent].child2 = sibling;
+        tree->nodeList[sibling].parent = grandParent;
+        gf3d_spatial_node_free(tree,parent);
+        gf3d_spatial_refit(tree,grandParent);
+    }
+    else
+    {
+        tree->root = sibling;
+        tree->nodeList[sibling].parent = GF3D_SPATIAL_NULL;
+        gf3d_spatial_node_free(tree,parent);
+    }
+}
+
+static AABB gf3d_spatial_fatten(SpatialTree *tree,AABB box)
+{
+    box.min.x -= tree->margin;
+    box.min.y -= tree->margin;
+    box.min.z -= tree->margin;
+    box.max.x += tree->margin;
+    box.max.y += tree->margin;
+    box.max.z += tree->margin;
+    return box;
+}
+
+static Bool gf3d_spatial_proxy_valid(SpatialTree *tree,Sint32 proxy)
+{
+    if (!tree)return false;
+    if ((proxy < 0)||(proxy >= tree->nodeMax))return false;
+    // only leaves are handed out as proxies
+    return (tree->nodeList[proxy].height == 0);
+}
+
+Sint32 gf3d_spatial_insert(SpatialTree *tree,AABB box,void *data)
+{
+    Sint32 proxy;
+    if (!tree)return GF3D_SPATIAL_NULL;
+    proxy = gf3d_spatial_node_new(tree);
+    if (proxy == GF3D_SPATIAL_NULL)return GF3D_SPATIAL_NULL;
+    tree->nodeList[proxy].box = gf3d_spatial_fatten(tree,box);
+    tree->nodeList[proxy].data = data;
+    if (!gf3d_spatial_insert_leaf(tree,proxy))
+    {
+        gf3d_spatial_node_free(tree,proxy);
+        return GF3D_SPATIAL_NULL;
+    }
+    tree->stats.proxies++;
+    return proxy;
+}
+
+void gf3d_spatial_remove(SpatialTree *tree,Sint32 proxy)
+{
+    if (!gf3d_spatial_proxy_valid(tree,proxy))return;
+    gf3d_spatial_remove_leaf(tree,proxy);
+    gf3d_spatial_node_free(tree,proxy);
+    tree->stats.proxies--;
+}
+
+Bool gf3d_spatial_move(SpatialTree *tree,Sint32 proxy,AABB box,Vector3D displacement)
+{
+    AABB fat;
+    if (!gf3d_spatial_proxy_valid(tree,proxy))return false;
+    if (gf3d_spatial_contains(tree->nodeList[proxy].box,box))
+    {
+        tree->stats.moves++;
+        return false;
+    }
+    // stretch the new fat box ahead of the motion so a steadily moving object is not reinserted every frame
+    fat = gf3d_spatial_fatten(tree,box);
+    if (displacement.x < 0)fat.min.x += displacement.x * GF3D_SPATIAL_DISPLACEMENT;
+    else fat.max.x += displacement.x * GF3D_SPATIAL_DISPLACEMENT;
+    if (displacement.y < 0)fat.min.y += displacement.y * GF3D_SPATIAL_DISPLACEMENT;
+    else fat.max.y += displacement.y * GF3D_SPATIAL_DISPLACEMENT;
+    if (displacement.z < 0)fat.min.z += displacement.z * GF3D_SPATIAL_DISPLACEMENT;
+    else fat.max.z += displacement.z * GF3D_SPATIAL_DISPLACEMENT;
+
+    gf3d_spatial_remove_leaf(tree,proxy);
+    tree->nodeList[proxy].box = fat;
+    if (!gf3d_spatial_insert_leaf(tree,proxy))
+    {
+        slog("failed to reinsert spatial proxy %i, it has been removed",proxy);
+        gf3d_spatial_node_free(tree,proxy);
+        tree->stats.proxies--;
+        return false;
+    }
+    tree->stats.reinserts++;
+    return true;
+}
+
+void *gf3d_spatial_get_data(SpatialTree *tree,Sint32 proxy)
+{
+    if (!gf3d_spatial_proxy_valid(tree,proxy))return NULL;
+    return tree->nodeList[proxy].data;
+}
+
+void gf3d_spatial_get_fat_box(SpatialTree *tree,Sint32 proxy,AABB *box)
+{
+    if (!box)return;
+    if (!gf3d_spatial_proxy_valid(tree,proxy))return;
+    *box = tree->nodeList[proxy].box;
+}
+
+/**
+ * QUERIES
+ */
+
+Uint32 gf3d_spatial_query_frustum(SpatialTree *tree,const Frustum *frustum,SpatialQueryCallback callback,void *userData)
+{
+    int p;
+    Uint32 found = 0;
+    Sint32 stack[GF3D_SPATIAL_STACK_SIZE];
+    Uint8 maskStack[GF3D_SPATIAL_STACK_SIZE];
+    Sint32 count = 0;
+    Sint32 index;
+    Uint8 mask;
+    float d,r;
+    Vector3D center,extent;
+    const Vector4D *plane;
+    SpatialNode *node;
+
+    if ((!tree)||(!frustum)||(tree->root == GF3D_SPATIAL_NULL))return 0;
+    stack[count] = tree->root;
+    maskStack[count++] = 0x3F;
+    while (count)
+    {
+        index = stack[--count];
+        mask = maskStack[count];
+        node = &tree->nodeList[index];
+        tree->stats.nodesVisited++;
+        // planes a parent was fully inside of are not tested again for its children
+        center.x = (node->box.min.x + node->box.max.x) * 0.5;
+        center.y = (node->box.min.y + node->box.max.y) * 0.5;
+        center.z = (node->box.min.z + node->box.max.z) * 0.5;
+        extent.x = (node->box.max.x - node->box.min.x) * 0.5;
+        extent.y = (node->box.max.y - node->box.min.y) * 0.5;
+        extent.z = (node->box.max.z - node->box.min.z) * 0.5;
+        for (p = 0; p < 6; p++)
+        {
+            if (!(mask & (1 << p)))continue;
+            plane = &frustum->planes[p];
+            d = plane->x * center.x + plane->y * center.y + plane->z * center.z + plane->w;
+            r = fabs(plane->x) * extent.x + fabs(plane->y) * extent.y + fabs(plane->z) * extent.z;
+            if (d < -r)break;
+            if (d >= r)mask &= ~(1 << p);
+        }
+        if (p < 6)continue;
+        if (node->child1 == GF3D_SPATIAL_NULL)
+        {
+            found++;
+            if ((callback)&&(!callback(index,node->data,userData)))return found;
+            continue;
+        }
+        if (count + 2 > GF3D_SPATIAL_STACK_SIZE)
+        {
+            slog("spatial tree too deep for frustum query");
+            return found;
+        }
+        stack[count] = node->child1;
+        maskStack[count++] = mask;
+        stack[count] = node->child2;
+        maskStack[count++] = mask;
+    }
+    return found;
+}
+
+Uint32 gf3d_spatial_query_sphere(SpatialTree *tree,Vector3D center,float radius,SpatialQueryCallback callback,void *userData)
+{
+    Uint32 found = 0;
+    Sint32 stack[GF3D_SPATIAL_STACK_SIZE];
+    Sint32 count = 0;
+    Sint32 index;
+    float d,distance;
+    SpatialNode *node;
+
+    if ((!tree)||(tree->root == GF3D_SPATIAL_NULL))return 0;
+    stack[count++] = tree->root;
+    while (count)
+    {
+        index = stack[--count];
+        node = &tree->nodeList[index];
+        tree->stats.nodesVisited++;
+        // squared distance from the center to the closest point of the box
+        distance = 0;
+        if (center.x < node->box.min.x)d = node->box.min.x - center.x;
+        else if (center.x > node->box.max.x)d = center.x - node->box.max.x;
+        else d = 0;
+        distance += d * d;
+        if (center.y < node->box.min.y)d = node->box.min.y - center.y;
+        else if (center.y > node->box.max.y)d = center.y - node->box.max.y;
+        else d = 0;
+        distance += d * d;
+        if (center.z < node->box.min.z)d = node->box.min.z - center.z;
+        else if (center.z > node->box.max.z)d = center.z - node->box.max.z;
+        else d = 0;
+        distance += d * d;
+        if (distance > radius * radius)continue;
+        if (node->child1 == GF3D_SPATIAL_NULL)
+        {
+            found++;
+            if ((callback)&&(!callback(index,node->data,userData)))return found;
+            continue;
+        }
+        if (count + 2 > GF3D_SPATIAL_STACK_SIZE)
+        {
+            slog("spatial tree too deep for sphere query");
+            return found;
+        }
+        stack[count++] = node->child1;
+        stack[count++] = node->child2;
+    }
+    return found;
+}
+
+Uint32 gf3d_spatial_query_aabb(SpatialTree *tree,AABB box,SpatialQueryCallback callback,void *userData)
+{
+    Uint32 found = 0;
+    Sint32 stack[GF3D_SPATIAL_STACK_SIZE];
+    Sint32 count = 0;
+    Sint32 index;
+    SpatialNode *node;
+
+    if ((!tree)||(tree->root == GF3D_SPATIAL_NULL))return 0;
+    stack[count++] = tree->root;
+    while (count)
+    {
+        index = stack[--count];
+        node = &tree->nodeList[index];
+        tree->stats.nodesVisited++;
+        if (!gf3d_spatial_overlaps(node->box,box))continue;
+        if (node->child1 == GF3D_SPATIAL_NULL)
+        {
+            found++;
+            if ((callback)&&(!callback(index,node->data,userData)))return found;
+            continue;
+        }
+        if (count + 2 > GF3D_SPATIAL_STACK_SIZE)
+        {
+            slog("spatial tree too deep for box query");
+            return found;
+        }
+        stack[count++] = node->child1;
+        stack[count++] = node->child2;
+    }
+    return found;
+}
+
+/**
+ * @brief clip a ray's range to the slab between two planes of a box along one axis
+ * @return false if nothing of the range is left
+ */
+static Bool gf3d_spatial_ray_slab(float min,float max,float origin,float direction,float inverse,float *tmin,float *tmax)
+{
+    float t1,t2;
+    if (direction == 0)
+    {
+        // parallel to the slab, the whole ray is inside it or none is.  The inverse would make 0 * inf = NaN here
+        return ((origin >= min)&&(origin <= max));
+    }
+    t1 = (min - origin) * inverse;
+    t2 = (max - origin) * inverse;
+    *tmin = MAX(*tmin,MIN(t1,t2));
+    *tmax = MIN(*tmax,MAX(t1,t2));
+    return (*tmin <= *tmax);
+}
+
+/**
+ * @brief slab test of a ray against a box
+ * @return the entry distance, or a negative number if the ray misses within [0,maxDistance]
+ */
+static float gf3d_spatial_ray_box(AABB box,Vector3D origin,Vector3D direction,Vector3D inverse,float maxDistance)
+{
+    float tmin = 0,tmax = maxDistance;
+
+    if (!gf3d_spatial_ray_slab(box.min.x,box.max.x,origin.x,direction.x,inverse.x,&tmin,&tmax))return -1;
+    if (!gf3d_spatial_ray_slab(box.min.y,box.max.y,origin.y,direction.y,inverse.y,&tmin,&tmax))return -1;
+    if (!gf3d_spatial_ray_slab(box.min.z,box.max.z,origin.z,direction.z,inverse.z,&tmin,&tmax))return -1;
+    return tmin;
+}
+
+Sint32 gf3d_spatial_raycast(
+    SpatialTree *tree,
+    Vector3D origin,
+    Vector3D direction,
+    float maxDistance,
+    SpatialRayCallback callback,
+    void *userData,
+    float *hitDistance)
+{
+    Sint32 stack[GF3D_SPATIAL_STACK_SIZE];
+    Sint32 count = 0;
+    Sint32 index;
+    Sint32 hit = GF3D_SPATIAL_NULL;
+    float distance;
+    Vector3D inverse;
+    SpatialNode *node;
+
+    if ((!tree)||(!callback)||(tree->root == GF3D_SPATIAL_NULL))return GF3D_SPATIAL_NULL;
+    // a zero component divides to infinity, the slab test checks the direction before using it
+    inverse.x = 1.0 / direction.x;
+    inverse.y = 1.0 / direction.y;
+    inverse.z = 1.0 / direction.z;
+    stack[count++] = tree->root;
+    while (count)
+    {
+        index = stack[--count];
+        node = &tree->nodeList[index];
+        tree->stats.nodesVisited++;
+        if (gf3d_spatial_ray_box(node->box,origin,direction,inverse,maxDistance) < 0)continue;
+        if (node->child1 == GF3D_SPATIAL_NULL)
+        {
+            distance = callback(index,node->data,userData);
+            if ((distance >= 0)&&(distance <= maxDistance))
+            {
+                // everything further than this hit can be skipped from now on
+                maxDistance = distance;
+                hit = index;
+            }
+            continue;
+        }
+        if (count + 2 > GF3D_SPATIAL_STACK_SIZE)
+        {
+            slog("spatial tree too deep for raycast");
+            break;
+        }
+        stack[count++] = node->child1;
+        stack[count++] = node->child2;
+    }
+    if ((hit != GF3D_SPATIAL_NULL)&&(hitDistance))*hitDistance = maxDistance;
+    return hit;
+}
+
+void gf3d_spatial_get_stats(SpatialTree *tree,SpatialStats *stats)
+{
+    if ((!tree)||(!stats))return;
+    tree->stats.height = (tree->root == GF3D_SPATIAL_NULL)?0:tree->nodeList[tree->root].height;
+    memcpy(stats,&tree->stats,sizeof(SpatialStats));
+}
+
+/*eol@eof*/
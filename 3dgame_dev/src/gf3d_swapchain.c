@@ -1,21 +1,24 @@
+#define SLOG_CATEGORY "swapchain"
+
 #include "gf3d_swapchain.h"
 #include "gf3d_vqueues.h"
+#include "gf3d_buffers.h"
 
 #include <string.h>
 #include <stdio.h>
 
 #include "simple_logger.h"
+#include "gf3d_trace.h"
+#include "gf3d_memory.h"
 
 typedef struct
 {
     VkDevice                    device;
     VkSurfaceCapabilitiesKHR    capabilities;
     Uint32                      formatCount;
-    VkSurfaceFormatKHR         *formats;
     Uint32                      presentModeCount;
-    VkPresentModeKHR           *presentModes;
-    int                         chosenFormat;
-    int                         chosenPresentMode;
+    VkSurfaceFormatKHR          format;                 // the surface format chosen from those supported
+    VkPresentModeKHR            presentMode;
     VkExtent2D                  extent;                 // resolution of the swap buffers
     Uint32                      swapChainCount;
     VkSwapchainKHR              swapChain;
@@ -24,102 +27,226 @@ typedef struct
     VkImageView                *imageViews;
     VkFramebuffer              *frameBuffers;
     Uint32                      framebufferCount;
+    VkFormat                    depthFormat;
+    VkImage                    *depthImages;            // one per swap image, frames in flight never share one
+    VkDeviceMemory             *depthMemory;
+    VkDeviceSize                depthMemorySize;        // of each depth image, they are all the same size
+    VkImageView                *depthViews;
 }vSwapChain;
 
 static vSwapChain gf3d_swapchain = {0};
 
 void gf3d_swapchain_create(VkDevice device,VkSurfaceKHR surface);
 void gf3d_swapchain_close();
-int gf3d_swapchain_choose_format();
-int gf3d_swapchain_get_presentation_mode();
+int gf3d_swapchain_choose_format(VkSurfaceFormatKHR *formats,Uint32 formatCount);
+int gf3d_swapchain_get_presentation_mode(VkPresentModeKHR *presentModes,Uint32 presentModeCount);
 VkExtent2D gf3d_swapchain_configure_extent(Uint32 width,Uint32 height);
 VkImageView gf3d_swapchain_create_imageview(VkDevice device,VkImage image);
+VkFormat gf3d_swapchain_choose_depth_format(VkPhysicalDevice device);
+Bool gf3d_swapchain_create_depth_image(Uint32 index);
 
 void gf3d_swapchain_init(VkPhysicalDevice device,VkDevice logicalDevice,VkSurfaceKHR surface,Uint32 width,Uint32 height)
 {
     int i;
+    int chosen;
+    MemoryScratch scratch;
+    VkSurfaceFormatKHR *formats = NULL;
+    VkPresentModeKHR *presentModes = NULL;
 
+    GF3D_TRACE_BEGIN("gf3d_swapchain_init");
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &gf3d_swapchain.capabilities);
     
+    // only the choices are kept, the lists go back to the scratch arena
+    scratch = gf3d_scratch_begin();
     vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &gf3d_swapchain.formatCount, NULL);
 
-    slog("device supports %i surface formats",gf3d_swapchain.formatCount);
+    slog_debug("device supports %i surface formats",gf3d_swapchain.formatCount);
     if (gf3d_swapchain.formatCount != 0)
     {
-        gf3d_swapchain.formats = (VkSurfaceFormatKHR*)gf3d_allocate_array(sizeof(VkSurfaceFormatKHR),gf3d_swapchain.formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &gf3d_swapchain.formatCount, gf3d_swapchain.formats);
+        formats = (VkSurfaceFormatKHR*)gf3d_arena_allocate_array(scratch.arena,sizeof(VkSurfaceFormatKHR),gf3d_swapchain.formatCount);
+        if (!formats)gf3d_swapchain.formatCount = 0;
+        else vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &gf3d_swapchain.formatCount, formats);
         for (i = 0; i < gf3d_swapchain.formatCount; i++)
         {
-            slog("surface format %i:",i);
-            slog("format: %i",gf3d_swapchain.formats[i].format);
-            slog("colorspace: %i",gf3d_swapchain.formats[i].colorSpace);
+            slog_debug("surface format %i:",i);
+            slog_debug("format: %i",formats[i].format);
+            slog_debug("colorspace: %i",formats[i].colorSpace);
         }
     }
     
     vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &gf3d_swapchain.presentModeCount, NULL);
 
-    slog("device supports %i presentation modes",gf3d_swapchain.presentModeCount);
+    slog_debug("device supports %i presentation modes",gf3d_swapchain.presentModeCount);
     if (gf3d_swapchain.presentModeCount != 0)
     {
-        gf3d_swapchain.presentModes = (VkPresentModeKHR*)gf3d_allocate_array(sizeof(VkPresentModeKHR),gf3d_swapchain.presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &gf3d_swapchain.presentModeCount, gf3d_swapchain.presentModes);
+        presentModes = (VkPresentModeKHR*)gf3d_arena_allocate_array(scratch.arena,sizeof(VkPresentModeKHR),gf3d_swapchain.presentModeCount);
+        if (!presentModes)gf3d_swapchain.presentModeCount = 0;
+        else vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &gf3d_swapchain.presentModeCount, presentModes);
         for (i = 0; i < gf3d_swapchain.presentModeCount; i++)
         {
-            slog("presentation mode: %i is %i",i,gf3d_swapchain.presentModes[i]);
+            slog_debug("presentation mode: %i is %i",i,presentModes[i]);
         }
     }
     
-    gf3d_swapchain.chosenFormat = gf3d_swapchain_choose_format();
-    slog("chosing surface format %i",gf3d_swapchain.chosenFormat);
+    chosen = gf3d_swapchain_choose_format(formats,gf3d_swapchain.formatCount);
+    slog_debug("chosing surface format %i",chosen);
+    if (chosen >= 0)gf3d_swapchain.format = formats[chosen];
     
-    gf3d_swapchain.chosenPresentMode = gf3d_swapchain_get_presentation_mode();
-    slog("chosing presentation mode %i",gf3d_swapchain.chosenPresentMode);
+    chosen = gf3d_swapchain_get_presentation_mode(presentModes,gf3d_swapchain.presentModeCount);
+    slog_debug("chosing presentation mode %i",chosen);
+    // FIFO is the one mode every driver has to support
+    gf3d_swapchain.presentMode = (chosen >= 0)?presentModes[chosen]:VK_PRESENT_MODE_FIFO_KHR;
+    gf3d_scratch_end(scratch);
     
     gf3d_swapchain.extent = gf3d_swapchain_configure_extent(width,height);
-    slog("chosing swap chain extent of (%i,%i)",gf3d_swapchain.extent.width,gf3d_swapchain.extent.height);
+    slog_debug("chosing swap chain extent of (%i,%i)",gf3d_swapchain.extent.width,gf3d_swapchain.extent.height);
+
+    gf3d_swapchain.depthFormat = gf3d_swapchain_choose_depth_format(device);
+    slog_debug("chosing depth format %i",gf3d_swapchain.depthFormat);
     
+    GF3D_TRACE_BEGIN("gf3d_swapchain_create");
     gf3d_swapchain_create(logicalDevice,surface);
+    GF3D_TRACE_END();
     gf3d_swapchain.device = logicalDevice;
     
     atexit(gf3d_swapchain_close);
+    GF3D_TRACE_END();
 }
 
-void gf3d_swapchain_create_frame_buffer(VkFramebuffer *buffer,VkImageView *imageView,Pipeline *pipe)
+void gf3d_swapchain_create_frame_buffer(VkFramebuffer *buffer,VkImageView *imageView,VkImageView *depthView,Pipeline *pipe)
 {
     VkFramebufferCreateInfo framebufferInfo = {0};
+    VkImageView attachments[2];
 
+    attachments[0] = *imageView;
+    attachments[1] = *depthView;
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = pipe->renderPass;
-    framebufferInfo.attachmentCount = 1;
-    framebufferInfo.pAttachments = imageView;
+    framebufferInfo.attachmentCount = 2;
+    framebufferInfo.pAttachments = attachments;
     framebufferInfo.width = gf3d_swapchain.extent.width;
     framebufferInfo.height = gf3d_swapchain.extent.height;
     framebufferInfo.layers = 1;
 
     if (vkCreateFramebuffer(gf3d_swapchain.device, &framebufferInfo, NULL, buffer) != VK_SUCCESS)
     {
-        slog("failed to create framebuffer!");
+        slog_error("failed to create framebuffer!");
     }
     else
     {
-        slog("created framebuffer");
+        slog_debug("created framebuffer");
     }
 }
 
 void gf3d_swapchain_setup_frame_buffers(Pipeline *pipe)
 {
     int i;
-    gf3d_swapchain.frameBuffers = (VkFramebuffer *)gf3d_allocate_array(sizeof(VkFramebuffer),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.depthImages = (VkImage *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkImage),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.depthMemory = (VkDeviceMemory *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkDeviceMemory),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.depthViews = (VkImageView *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkImageView),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.frameBuffers = (VkFramebuffer *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkFramebuffer),gf3d_swapchain.swapImageCount);
     for (i = 0; i < gf3d_swapchain.swapImageCount;i++)
     {
-        gf3d_swapchain_create_frame_buffer(&gf3d_swapchain.frameBuffers[i],&gf3d_swapchain.imageViews[i],pipe);
+        if (!gf3d_swapchain_create_depth_image(i))continue;
+        gf3d_swapchain_create_frame_buffer(&gf3d_swapchain.frameBuffers[i],&gf3d_swapchain.imageViews[i],&gf3d_swapchain.depthViews[i],pipe);
     }
     gf3d_swapchain.framebufferCount = gf3d_swapchain.swapImageCount;
 }
 
 VkFormat gf3d_swapchain_get_format()
 {
-    return gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].format;
+    return gf3d_swapchain.format.format;
+}
+
+VkFormat gf3d_swapchain_get_depth_format()
+{
+    return gf3d_swapchain.depthFormat;
+}
+
+VkFormat gf3d_swapchain_choose_depth_format(VkPhysicalDevice device)
+{
+    int i;
+    VkFormatProperties properties;
+    // most precise first, stencil is not used yet so a pure depth format is preferred
+    VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT,VK_FORMAT_D32_SFLOAT_S8_UINT,VK_FORMAT_D24_UNORM_S8_UINT,VK_FORMAT_D16_UNORM};
+
+    for (i = 0; i < sizeof(candidates)/sizeof(VkFormat); i++)
+    {
+        vkGetPhysicalDeviceFormatProperties(device, candidates[i], &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            return candidates[i];
+        }
+    }
+    slog_error("no supported depth format found");
+    return VK_FORMAT_D16_UNORM;    // required to be supported by the spec
+}
+
+Bool gf3d_swapchain_create_depth_image(Uint32 index)
+{
+    Sint32 memoryType;
+    VkImageCreateInfo imageInfo = {0};
+    VkImageViewCreateInfo viewInfo = {0};
+    VkMemoryAllocateInfo allocInfo = {0};
+    VkMemoryRequirements requirements;
+
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = gf3d_swapchain.depthFormat;
+    imageInfo.extent.width = gf3d_swapchain.extent.width;
+    imageInfo.extent.height = gf3d_swapchain.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;   // the render pass transitions it
+
+    if (vkCreateImage(gf3d_swapchain.device, &imageInfo, NULL, &gf3d_swapchain.depthImages[index]) != VK_SUCCESS)
+    {
+        slog_error("failed to create depth image");
+        return false;
+    }
+    vkGetImageMemoryRequirements(gf3d_swapchain.device, gf3d_swapchain.depthImages[index], &requirements);
+    memoryType = gf3d_buffers_find_memory_type(requirements.memoryTypeBits,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryType < 0)
+    {
+        slog_error("no device local memory type for the depth image");
+        return false;
+    }
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+    if (vkAllocateMemory(gf3d_swapchain.device, &allocInfo, NULL, &gf3d_swapchain.depthMemory[index]) != VK_SUCCESS)
+    {
+        slog_error("failed to allocate depth image memory");
+        return false;
+    }
+    gf3d_swapchain.depthMemorySize = requirements.size;
+    gf3d_memory_gpu_allocated(MT_Swapchain,requirements.size);
+    vkBindImageMemory(gf3d_swapchain.device, gf3d_swapchain.depthImages[index], gf3d_swapchain.depthMemory[index], 0);
+
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = gf3d_swapchain.depthImages[index];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = gf3d_swapchain.depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if ((gf3d_swapchain.depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)||(gf3d_swapchain.depthFormat == VK_FORMAT_D24_UNORM_S8_UINT))
+    {
+        viewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(gf3d_swapchain.device, &viewInfo, NULL, &gf3d_swapchain.depthViews[index]) != VK_SUCCESS)
+    {
+        slog_error("failed to create depth image view");
+        return false;
+    }
+    return true;
 }
 
 void gf3d_swapchain_create(VkDevice device,VkSurfaceKHR surface)
@@ -130,17 +257,17 @@ void gf3d_swapchain_create(VkDevice device,VkSurfaceKHR surface)
     VkSwapchainCreateInfoKHR createInfo = {0};
     Uint32 queueFamilyIndices[2];
     
-    slog("minimum images needed for swap chain: %i",gf3d_swapchain.capabilities.minImageCount);
-    slog("Maximum images needed for swap chain: %i",gf3d_swapchain.capabilities.maxImageCount);
+    slog_debug("minimum images needed for swap chain: %i",gf3d_swapchain.capabilities.minImageCount);
+    slog_debug("Maximum images needed for swap chain: %i",gf3d_swapchain.capabilities.maxImageCount);
     gf3d_swapchain.swapChainCount = gf3d_swapchain.capabilities.minImageCount + 1;
     if (gf3d_swapchain.capabilities.maxImageCount)gf3d_swapchain.swapChainCount = MIN(gf3d_swapchain.swapChainCount,gf3d_swapchain.capabilities.maxImageCount);
-    slog("using %i images for the swap chain",gf3d_swapchain.swapChainCount);
+    slog_debug("using %i images for the swap chain",gf3d_swapchain.swapChainCount);
     
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.surface = surface;
     createInfo.minImageCount = gf3d_swapchain.swapChainCount;
-    createInfo.imageFormat = gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].format;
-    createInfo.imageColorSpace = gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].colorSpace;
+    createInfo.imageFormat = gf3d_swapchain.format.format;
+    createInfo.imageColorSpace = gf3d_swapchain.format.colorSpace;
     createInfo.imageExtent = gf3d_swapchain.extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
@@ -165,36 +292,36 @@ void gf3d_swapchain_create(VkDevice device,VkSurfaceKHR surface)
     createInfo.preTransform = gf3d_swapchain.capabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;  // our window is opaque, but it doesn't have to be
 
-    createInfo.presentMode = gf3d_swapchain.presentModes[gf3d_swapchain.chosenPresentMode];
+    createInfo.presentMode = gf3d_swapchain.presentMode;
     createInfo.clipped = VK_TRUE;
     
     createInfo.oldSwapchain = VK_NULL_HANDLE;
     
     if (vkCreateSwapchainKHR(device, &createInfo, NULL, &gf3d_swapchain.swapChain) != VK_SUCCESS)
     {
-        slog("failed to create swap chain!");
+        slog_error("failed to create swap chain!");
         gf3d_swapchain_close();
         return;
     }
-    slog("created a swap chain with length %i",gf3d_swapchain.swapChainCount);
+    slog_debug("created a swap chain with length %i",gf3d_swapchain.swapChainCount);
     
     vkGetSwapchainImagesKHR(device, gf3d_swapchain.swapChain, &gf3d_swapchain.swapImageCount, NULL);
     if (gf3d_swapchain.swapImageCount == 0)
     {
-        slog("failed to create any swap images!");
+        slog_error("failed to create any swap images!");
         gf3d_swapchain_close();
         return;
     }
-    gf3d_swapchain.swapImages = (VkImage *)gf3d_allocate_array(sizeof(VkImage),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.swapImages = (VkImage *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkImage),gf3d_swapchain.swapImageCount);
     vkGetSwapchainImagesKHR(device, gf3d_swapchain.swapChain, &gf3d_swapchain.swapImageCount,gf3d_swapchain.swapImages );
-    slog("created swap chain with %i images",gf3d_swapchain.swapImageCount);
+    slog_info("created swap chain with %i images",gf3d_swapchain.swapImageCount);
     
-    gf3d_swapchain.imageViews = (VkImageView *)gf3d_allocate_array(sizeof(VkImageView),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.imageViews = (VkImageView *)gf3d_memory_allocate(MT_Swapchain,sizeof(VkImageView),gf3d_swapchain.swapImageCount);
     for (i = 0 ; i < gf3d_swapchain.swapImageCount; i++)
     {
         gf3d_swapchain.imageViews[i] = gf3d_swapchain_create_imageview(device,gf3d_swapchain.swapImages[i]);
     }
-    slog("create image views");
+    slog_debug("create image views");
 }
 
 VkImageView gf3d_swapchain_create_imageview(VkDevice device,VkImage image)
@@ -205,7 +332,7 @@ VkImageView gf3d_swapchain_create_imageview(VkDevice device,VkImage image)
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     createInfo.image = image;
     createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    createInfo.format = gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].format;
+    createInfo.format = gf3d_swapchain.format.format;
     createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -218,7 +345,7 @@ VkImageView gf3d_swapchain_create_imageview(VkDevice device,VkImage image)
     
     if (vkCreateImageView(device, &createInfo, NULL, &imageView) != VK_SUCCESS)
     {
-        slog("failed to create image view");
+        slog_error("failed to create image view");
         return NULL;
     }
     return imageView;
@@ -227,9 +354,9 @@ VkImageView gf3d_swapchain_create_imageview(VkDevice device,VkImage image)
 VkExtent2D gf3d_swapchain_configure_extent(Uint32 width,Uint32 height)
 {
     VkExtent2D actualExtent;
-    slog("Requested resolution: (%i,%i)",width,height);
-    slog("Minimum resolution: (%i,%i)",gf3d_swapchain.capabilities.minImageExtent.width,gf3d_swapchain.capabilities.minImageExtent.height);
-    slog("Maximum resolution: (%i,%i)",gf3d_swapchain.capabilities.maxImageExtent.width,gf3d_swapchain.capabilities.maxImageExtent.height);
+    slog_debug("Requested resolution: (%i,%i)",width,height);
+    slog_debug("Minimum resolution: (%i,%i)",gf3d_swapchain.capabilities.minImageExtent.width,gf3d_swapchain.capabilities.minImageExtent.height);
+    slog_debug("Maximum resolution: (%i,%i)",gf3d_swapchain.capabilities.maxImageExtent.width,gf3d_swapchain.capabilities.maxImageExtent.height);
     
     actualExtent.width = MAX(gf3d_swapchain.capabilities.minImageExtent.width,MIN(width,gf3d_swapchain.capabilities.maxImageExtent.width));
     actualExtent.height = MAX(gf3d_swapchain.capabilities.minImageExtent.height,MIN(height,gf3d_swapchain.capabilities.maxImageExtent.height));
@@ -242,27 +369,27 @@ VkExtent2D gf3d_swapchain_get_extent()
 }
 
 
-int gf3d_swapchain_get_presentation_mode()
+int gf3d_swapchain_get_presentation_mode(VkPresentModeKHR *presentModes,Uint32 presentModeCount)
 {
     int i;
     int chosen = -1;
-    for (i = 0; i < gf3d_swapchain.formatCount; i++)
+    for (i = 0; i < presentModeCount; i++)
     {
-        if (gf3d_swapchain.presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
+        if (presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
             return i;
         chosen = i;
     }
     return chosen;
 }
 
-int gf3d_swapchain_choose_format()
+int gf3d_swapchain_choose_format(VkSurfaceFormatKHR *formats,Uint32 formatCount)
 {
     int i;
     int chosen = -1;
-    for (i = 0; i < gf3d_swapchain.formatCount; i++)
+    for (i = 0; i < formatCount; i++)
     {
-        if ((gf3d_swapchain.formats[i].format == VK_FORMAT_B8G8R8A8_UNORM) &&
-            (gf3d_swapchain.formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR))
+        if ((formats[i].format == VK_FORMAT_B8G8R8A8_UNORM) &&
+            (formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR))
             return i;
         chosen = i;
     }
@@ -272,14 +399,40 @@ int gf3d_swapchain_choose_format()
 void gf3d_swapchain_close()
 {
     int i;
-    slog("cleaning up swapchain");
+    slog_debug("cleaning up swapchain");
     if (gf3d_swapchain.frameBuffers)
     {
         for (i = 0;i < gf3d_swapchain.framebufferCount; i++)
         {
             vkDestroyFramebuffer(gf3d_swapchain.device, gf3d_swapchain.frameBuffers[i], NULL);
         }
-        free (gf3d_swapchain.frameBuffers);
+        gf3d_memory_free(gf3d_swapchain.frameBuffers);
+    }
+    if (gf3d_swapchain.depthViews)
+    {
+        for (i = 0;i < gf3d_swapchain.swapImageCount; i++)
+        {
+            if (gf3d_swapchain.depthViews[i])vkDestroyImageView(gf3d_swapchain.device, gf3d_swapchain.depthViews[i], NULL);
+        }
+        gf3d_memory_free(gf3d_swapchain.depthViews);
+    }
+    if (gf3d_swapchain.depthImages)
+    {
+        for (i = 0;i < gf3d_swapchain.swapImageCount; i++)
+        {
+            if (gf3d_swapchain.depthImages[i])vkDestroyImage(gf3d_swapchain.device, gf3d_swapchain.depthImages[i], NULL);
+        }
+        gf3d_memory_free(gf3d_swapchain.depthImages);
+    }
+    if (gf3d_swapchain.depthMemory)
+    {
+        for (i = 0;i < gf3d_swapchain.swapImageCount; i++)
+        {
+            if (!gf3d_swapchain.depthMemory[i])continue;
+            vkFreeMemory(gf3d_swapchain.device, gf3d_swapchain.depthMemory[i], NULL);
+            gf3d_memory_gpu_freed(MT_Swapchain,gf3d_swapchain.depthMemorySize);
+        }
+        gf3d_memory_free(gf3d_swapchain.depthMemory);
     }
     vkDestroySwapchainKHR(gf3d_swapchain.device, gf3d_swapchain.swapChain, NULL);
     if (gf3d_swapchain.imageViews)
@@ -288,19 +441,11 @@ void gf3d_swapchain_close()
         {
             vkDestroyImageView(gf3d_swapchain.device,gf3d_swapchain.imageViews[i],NULL);
         }
-        free(gf3d_swapchain.imageViews);
+        gf3d_memory_free(gf3d_swapchain.imageViews);
     }
     if (gf3d_swapchain.swapImages)
     {
-        free(gf3d_swapchain.swapImages);
-    }
-    if (gf3d_swapchain.formats)
-    {
-        free(gf3d_swapchain.formats);
-    }
-    if (gf3d_swapchain.presentModes)
-    {
-        free(gf3d_swapchain.presentModes);
+        gf3d_memory_free(gf3d_swapchain.swapImages);
     }
     memset(&gf3d_swapchain,0,sizeof(vSwapChain));
 }
@@ -309,12 +454,12 @@ Bool gf3d_swapchain_validation_check()
 {
     if (!gf3d_swapchain.presentModeCount)
     {
-        slog("swapchain has no usable presentation modes");
+        slog_error("swapchain has no usable presentation modes");
         return false;
     }
     if (!gf3d_swapchain.formatCount)
     {
-        slog("swapchain has no usable surface formats");
+        slog_error("swapchain has no usable surface formats");
         return false;
     }
     return true;
@@ -322,7 +467,8 @@ Bool gf3d_swapchain_validation_check()
 
 Uint32 gf3d_swapchain_get_frame_buffer_count()
 {
-    return gf3d_swapchain.framebufferCount;
+    // there is one framebuffer per swap image, and per frame systems ask before the framebuffers exist
+    return gf3d_swapchain.swapImageCount;
 }
 
 VkSwapchainKHR gf3d_swapchain_get()
@@ -334,10 +480,30 @@ VkFramebuffer gf3d_swapchain_get_frame_buffer_by_index(Uint32 index)
 {
     if (index >= gf3d_swapchain.framebufferCount)
     {
-        slog("FATAL: index for framebuffer out of range");
+        slog_error("FATAL: index for framebuffer out of range");
         return 0;
     }
     return gf3d_swapchain.frameBuffers[index];
 }
 
+VkImage gf3d_swapchain_get_image_by_index(Uint32 index)
+{
+    if ((!gf3d_swapchain.swapImages)||(index >= gf3d_swapchain.swapImageCount))
+    {
+        slog_error("index for swap image out of range");
+        return VK_NULL_HANDLE;
+    }
+    return gf3d_swapchain.swapImages[index];
+}
+
+VkImage gf3d_swapchain_get_depth_image_by_index(Uint32 index)
+{
+    if ((!gf3d_swapchain.depthImages)||(index >= gf3d_swapchain.swapImageCount))
+    {
+        slog_error("index for depth image out of range");
+        return VK_NULL_HANDLE;
+    }
+    return gf3d_swapchain.depthImages[index];
+}
+
 /*eol@eof*/
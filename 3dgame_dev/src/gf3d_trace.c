@@ -0,0 +1,286 @@
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_trace.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#ifdef _MSC_VER
+#define GF3D_THREAD_LOCAL __declspec(thread)
+#else
+#define GF3D_THREAD_LOCAL __thread
+#endif
+
+#define GF3D_TRACE_MAX_DEPTH    256     // zones nested deeper than this are never recorded
+
+typedef struct
+{
+    Uint64          time;       /**<performance counter ticks*/
+    const char     *name;
+    double          value;
+    TraceEventType  type;
+}TraceEvent;
+
+typedef struct TraceBuffer_S
+{
+    SDL_threadID            thread;
+    const char             *threadName;
+    TraceEvent             *events;
+    volatile Uint32         count;      /**<written last, so a reader never sees an event that is not filled in*/
+    Uint32                  open;       /**<recorded zones begun and not ended, each has room kept for its end*/
+    Uint32                  depth;      /**<every zone begun and not ended, recorded or not*/
+    Uint64                  recorded[GF3D_TRACE_MAX_DEPTH / 64];/**<per nesting depth, whether that zone's begin
+                                                                    was recorded and so its end must be*/
+    struct TraceBuffer_S   *next;
+}TraceBuffer;
+
+typedef struct
+{
+    Uint32          eventsPerThread;
+    const char     *filename;
+    volatile int    enabled;
+    Uint32          generation;     /**<bumped by every init, thread buffers from an earlier one are stale*/
+    Uint64          start;          /**<performance counter at init, the trace's time zero*/
+    Uint64          frequency;
+    SDL_SpinLock    lock;           /**<guards the buffer list*/
+    TraceBuffer    *buffers;
+    SDL_atomic_t    dropped;
+    SDL_threadID    mainThread;
+}TraceManager;
+
+static TraceManager gf3d_trace = {0};
+
+static GF3D_THREAD_LOCAL TraceBuffer *gf3d_trace_thread = NULL;
+static GF3D_THREAD_LOCAL Uint32 gf3d_trace_thread_generation = 0;
+
+void gf3d_trace_close();
+
+void gf3d_trace_init(Uint32 eventsPerThread,const char *filename)
+{
+    if (!eventsPerThread)
+    {
+        slog("cannot initialize tracing for zero events");
+        return;
+    }
+    if (gf3d_trace.eventsPerThread)
+    {
+        slog("tracing is already initialized");
+        return;
+    }
+    gf3d_trace.eventsPerThread = eventsPerThread;
+    gf3d_trace.filename = filename;
+    gf3d_trace.generation++;
+    gf3d_trace.frequency = SDL_GetPerformanceFrequency();
+    gf3d_trace.start = SDL_GetPerformanceCounter();
+    gf3d_trace.mainThread = SDL_ThreadID();
+    gf3d_trace.enabled = 1;
+    atexit(gf3d_trace_close);
+    slog("tracing initialized for %i events per thread",eventsPerThread);
+}
+
+void gf3d_trace_close()
+{
+    TraceBuffer *buffer,*next;
+    Uint32 generation;
+    gf3d_trace.enabled = 0;
+    if (gf3d_trace.filename)gf3d_trace_write(gf3d_trace.filename);
+    for (buffer = gf3d_trace.buffers; buffer; buffer = next)
+    {
+        next = buffer->next;
+        if (buffer->events)gf3d_memory_free(buffer->events);
+        gf3d_memory_free(buffer);
+    }
+    generation = gf3d_trace.generation;
+    memset(&gf3d_trace,0,sizeof(TraceManager));
+    gf3d_trace.generation = generation;
+}
+
+/**
+ * @brief get the calling thread's buffer, making it on its first event
+ * @return NULL if it could not be allocated
+ */
+static TraceBuffer *gf3d_trace_get_thread_buffer()
+{
+    TraceBuffer *buffer;
+    if ((gf3d_trace_thread)&&(gf3d_trace_thread_generation == gf3d_trace.generation))return gf3d_trace_thread;
+    buffer = (TraceBuffer *)gf3d_memory_allocate(MT_Trace,sizeof(TraceBuffer),1);
+    if (!buffer)return NULL;
+    buffer->events = (TraceEvent *)gf3d_memory_allocate(MT_Trace,sizeof(TraceEvent),gf3d_trace.eventsPerThread);
+    if (!buffer->events)
+    {
+        gf3d_memory_free(buffer);
+        return NULL;
+    }
+    buffer->thread = SDL_ThreadID();
+    if (buffer->thread == gf3d_trace.mainThread)buffer->threadName = "main";
+    SDL_AtomicLock(&gf3d_trace.lock);
+    buffer->next = gf3d_trace.buffers;
+    gf3d_trace.buffers = buffer;
+    SDL_AtomicUnlock(&gf3d_trace.lock);
+    gf3d_trace_thread = buffer;
+    gf3d_trace_thread_generation = gf3d_trace.generation;
+    return buffer;
+}
+
+#define gf3d_trace_zone_bit(depth) ((Uint64)1 << ((depth) & 63))
+
+void gf3d_trace_event(TraceEventType type,const char *name,double value)
+{
+    TraceBuffer *buffer;
+    TraceEvent *event;
+    Uint32 needed;
+    Uint32 depth;
+    // zones are tracked while paused too, so pausing inside one neither loses its end nor ends an outer one
+    if ((!gf3d_trace.enabled)&&(type != TE_Begin)&&(type != TE_End))return;
+    if (!gf3d_trace.eventsPerThread)return;
+    buffer = gf3d_trace_get_thread_buffer();
+    if (!buffer)return;
+    switch (type)
+    {
+        case TE_Begin:
+            depth = buffer->depth++;
+            if (depth >= GF3D_TRACE_MAX_DEPTH)return;
+            buffer->recorded[depth >> 6] &= ~gf3d_trace_zone_bit(depth);
+            if (!gf3d_trace.enabled)return;
+            needed = 2;     // itself and its end
+            break;
+        case TE_End:
+            if (!buffer->depth)return;  // an end with no begin would unbalance every zone after it
+            depth = --buffer->depth;
+            if (depth >= GF3D_TRACE_MAX_DEPTH)return;
+            if (!(buffer->recorded[depth >> 6] & gf3d_trace_zone_bit(depth)))return;
+            needed = 0;     // kept when the zone began
+            break;
+        default:
+            needed = 1;
+            break;
+    }
+    if (buffer->count + buffer->open + needed > gf3d_trace.eventsPerThread)
+    {
+        SDL_AtomicIncRef(&gf3d_trace.dropped);
+        return;
+    }
+    if (type == TE_Begin)buffer->recorded[depth >> 6] |= gf3d_trace_zone_bit(depth);
+    event = &buffer->events[buffer->count];
+    event->time = SDL_GetPerformanceCounter();
+    event->name = name;
+    event->value = value;
+    event->type = type;
+    if (type == TE_Begin)buffer->open++;
+    else if (type == TE_End)buffer->open--;
+    buffer->count++;
+}
+
+void gf3d_trace_set_enabled(Bool enable)
+{
+    if (!gf3d_trace.eventsPerThread)return;
+    gf3d_trace.enabled = enable?1:0;
+}
+
+void gf3d_trace_set_thread_name(const char *name)
+{
+    TraceBuffer *buffer;
+    if (!gf3d_trace.eventsPerThread)return;
+    buffer = gf3d_trace_get_thread_buffer();
+    if (!buffer)return;
+    buffer->threadName = name;
+}
+
+void gf3d_trace_clear()
+{
+    TraceBuffer *buffer;
+    SDL_AtomicLock(&gf3d_trace.lock);
+    for (buffer = gf3d_trace.buffers; buffer; buffer = buffer->next)
+    {
+        // zones open now would get their end recorded without their begin: drop those ends too
+        memset(buffer->recorded,0,sizeof(buffer->recorded));
+        buffer->open = 0;
+        buffer->count = 0;
+    }
+    SDL_AtomicUnlock(&gf3d_trace.lock);
+    SDL_AtomicSet(&gf3d_trace.dropped,0);
+}
+
+Uint32 gf3d_trace_get_dropped()
+{
+    return SDL_AtomicGet(&gf3d_trace.dropped);
+}
+
+/**
+ * OUTPUT
+ */
+
+/**
+ * @brief write a string as a JSON string, quotes included
+ */
+static void gf3d_trace_write_string(FILE *file,const char *text)
+{
+    fputc('"',file);
+    for (; (text)&&(*text); text++)
+    {
+        if ((*text == '"')||(*text == '\\'))fputc('\\',file);
+        if ((Uint8)*text < 0x20)fputc(' ',file);
+        else fputc(*text,file);
+    }
+    fputc('"',file);
+}
+
+Bool gf3d_trace_write(const char *filename)
+{
+    int i;
+    FILE *file;
+    TraceBuffer *buffer;
+    TraceEvent *event;
+    Uint32 count;
+    unsigned long thread;
+    double toMicroseconds;
+    const char *phases[TE_MAX] = {"B","E","C","i"};
+
+    if ((!filename)||(!gf3d_trace.frequency))return false;
+    file = fopen(filename,"w");
+    if (!file)
+    {
+        slog("failed to open trace file %s for writing",filename);
+        return false;
+    }
+    toMicroseconds = 1000000.0 / (double)gf3d_trace.frequency;
+    fprintf(file,"{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%u},\"traceEvents\":[\n",gf3d_trace_get_dropped());
+    fprintf(file,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"gf3d\"}}");
+    SDL_AtomicLock(&gf3d_trace.lock);
+    for (buffer = gf3d_trace.buffers; buffer; buffer = buffer->next)
+    {
+        thread = (unsigned long)buffer->thread;
+        if (buffer->threadName)
+        {
+            fprintf(file,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":",thread);
+            gf3d_trace_write_string(file,buffer->threadName);
+            fprintf(file,"}}");
+        }
+        count = buffer->count;
+        for (i = 0; i < count; i++)
+        {
+            event = &buffer->events[i];
+            fprintf(file,",\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f",
+                phases[event->type],
+                thread,
+                (double)(event->time - gf3d_trace.start) * toMicroseconds);
+            if (event->type != TE_End)
+            {
+                fprintf(file,",\"cat\":\"gf3d\",\"name\":");
+                gf3d_trace_write_string(file,event->name);
+            }
+            if (event->type == TE_Counter)fprintf(file,",\"args\":{\"value\":%.17g}",event->value);
+            if (event->type == TE_Instant)fprintf(file,",\"s\":\"t\"");
+            fprintf(file,"}");
+        }
+    }
+    SDL_AtomicUnlock(&gf3d_trace.lock);
+    fprintf(file,"\n]}\n");
+    fclose(file);
+    slog("wrote trace to %s",filename);
+    return true;
+}
+
+/*eol@eof*/
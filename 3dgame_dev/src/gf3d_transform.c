@@ -0,0 +1,400 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gf3d_transform.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+typedef struct
+{
+    Uint32          maxNodes;
+    Uint32          nodeCount;      /**<dense, the first nodeCount entries of every array are live, parents first*/
+    Vector3D       *position;       /**<by dense index: local translation*/
+    Quaternion     *rotation;       /**<by dense index: local rotation*/
+    Vector3D       *scale;          /**<by dense index: local scale*/
+    Sint32         *parent;         /**<by dense index: dense index of the parent, -1 for roots*/
+    Matrix4        *world;          /**<by dense index: world matrix as of the last update*/
+    Uint8          *dirty;          /**<by dense index: local transform changed since the last update*/
+    Uint32         *changed;        /**<by dense index: the update pass that last rebuilt the world matrix*/
+    Uint32          pass;           /**<counts update passes*/
+    Uint32          firstDirty;     /**<no dense index below this is dirty*/
+    Sint32         *denseIndex;     /**<by node id: dense index, -1 when free*/
+    Uint32         *nodeId;         /**<by dense index: node id*/
+    Uint32         *freeIds;        /**<stack of unused node ids*/
+    Uint32          freeCount;
+    Uint32         *order;          /**<reordering scratch: new dense index to old*/
+    Sint32         *remap;          /**<reordering scratch: old dense index to new, -1 if dropped*/
+    Uint8          *marked;         /**<reordering scratch: in the subtree being moved or freed*/
+    Uint8          *scratch;        /**<reordering scratch, room for a copy of the largest array*/
+}TransformManager;
+
+static TransformManager gf3d_transform = {0};
+
+void gf3d_transform_close();
+
+void gf3d_transform_init(Uint32 maxNodes)
+{
+    int i;
+    if (!maxNodes)
+    {
+        slog("cannot initialize the transform hierarchy for zero nodes");
+        return;
+    }
+    atexit(gf3d_transform_close);
+    gf3d_transform.position = (Vector3D *)gf3d_memory_allocate(MT_Scene,sizeof(Vector3D),maxNodes);
+    gf3d_transform.rotation = (Quaternion *)gf3d_memory_allocate(MT_Scene,sizeof(Quaternion),maxNodes);
+    gf3d_transform.scale = (Vector3D *)gf3d_memory_allocate(MT_Scene,sizeof(Vector3D),maxNodes);
+    gf3d_transform.parent = (Sint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Sint32),maxNodes);
+    gf3d_transform.world = (Matrix4 *)gf3d_memory_allocate(MT_Scene,sizeof(Matrix4),maxNodes);
+    gf3d_transform.dirty = (Uint8 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint8),maxNodes);
+    gf3d_transform.changed = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxNodes);
+    gf3d_transform.denseIndex = (Sint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Sint32),maxNodes);
+    gf3d_transform.nodeId = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxNodes);
+    gf3d_transform.freeIds = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxNodes);
+    gf3d_transform.order = (Uint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint32),maxNodes);
+    gf3d_transform.remap = (Sint32 *)gf3d_memory_allocate(MT_Scene,sizeof(Sint32),maxNodes);
+    gf3d_transform.marked = (Uint8 *)gf3d_memory_allocate(MT_Scene,sizeof(Uint8),maxNodes);
+    gf3d_transform.scratch = (Uint8 *)gf3d_memory_allocate(MT_Scene,sizeof(Matrix4),maxNodes);
+    if ((!gf3d_transform.position)||(!gf3d_transform.rotation)||(!gf3d_transform.scale)||(!gf3d_transform.parent)||
+        (!gf3d_transform.world)||(!gf3d_transform.dirty)||(!gf3d_transform.changed)||(!gf3d_transform.denseIndex)||
+        (!gf3d_transform.nodeId)||(!gf3d_transform.freeIds)||(!gf3d_transform.order)||(!gf3d_transform.remap)||
+        (!gf3d_transform.marked)||(!gf3d_transform.scratch))
+    {
+        slog("failed to allocate the transform hierarchy");
+        gf3d_transform_close();
+        return;
+    }
+    for (i = 0; i < maxNodes; i++)
+    {
+        gf3d_transform.denseIndex[i] = -1;
+        gf3d_transform.freeIds[i] = maxNodes - 1 - i;
+    }
+    gf3d_transform.freeCount = maxNodes;
+    gf3d_transform.maxNodes = maxNodes;
+    slog("transform hierarchy initialized for %i nodes",maxNodes);
+}
+
+void gf3d_transform_close()
+{
+    if (gf3d_transform.position)gf3d_memory_free(gf3d_transform.position);
+    if (gf3d_transform.rotation)gf3d_memory_free(gf3d_transform.rotation);
+    if (gf3d_transform.scale)gf3d_memory_free(gf3d_transform.scale);
+    if (gf3d_transform.parent)gf3d_memory_free(gf3d_transform.parent);
+    if (gf3d_transform.world)gf3d_memory_free(gf3d_transform.world);
+    if (gf3d_transform.dirty)gf3d_memory_free(gf3d_transform.dirty);
+    if (gf3d_transform.changed)gf3d_memory_free(gf3d_transform.changed);
+    if (gf3d_transform.denseIndex)gf3d_memory_free(gf3d_transform.denseIndex);
+    if (gf3d_transform.nodeId)gf3d_memory_free(gf3d_transform.nodeId);
+    if (gf3d_transform.freeIds)gf3d_memory_free(gf3d_transform.freeIds);
+    if (gf3d_transform.order)gf3d_memory_free(gf3d_transform.order);
+    if (gf3d_transform.remap)gf3d_memory_free(gf3d_transform.remap);
+    if (gf3d_transform.marked)gf3d_memory_free(gf3d_transform.marked);
+    if (gf3d_transform.scratch)gf3d_memory_free(gf3d_transform.scratch);
+    memset(&gf3d_transform,0,sizeof(TransformManager));
+}
+
+/**
+ * @brief get the dense index of a node id
+ * @return -1 if there is no such node
+ */
+static inline Sint32 gf3d_transform_dense(Sint32 node)
+{
+    if ((node < 0)||(node >= gf3d_transform.maxNodes))return -1;
+    return gf3d_transform.denseIndex[node];
+}
+
+/**
+ * @brief flag a node's local transform as changed
+ */
+static inline void gf3d_transform_dirty(Sint32 dense)
+{
+    gf3d_transform.dirty[dense] = 1;
+    gf3d_transform.firstDirty = MIN(gf3d_transform.firstDirty,dense);
+}
+
+/**
+ * REORDERING
+ * nodes are only ever reordered by moving or dropping a whole subtree, which keeps parents ahead of their children
+ */
+
+/**
+ * @brief flag the subtree under a dense index in marked
+ * @note descendants always come after their ancestors, so one pass from the root of the subtree finds them all
+ */
+void gf3d_transform_mark_subtree(Sint32 root)
+{
+    int i;
+    Sint32 parent;
+    memset(gf3d_transform.marked,0,gf3d_transform.nodeCount);
+    gf3d_transform.marked[root] = 1;
+    for (i = root + 1; i < gf3d_transform.nodeCount; i++)
+    {
+        parent = gf3d_transform.parent[i];
+        if ((parent >= root)&&(gf3d_transform.marked[parent]))gf3d_transform.marked[i] = 1;
+    }
+}
+
+/**
+ * @brief rearrange one array by order
+ */
+void gf3d_transform_permute(void *array,size_t size,Uint32 count)
+{
+    int i;
+    Uint8 *data = (Uint8 *)array;
+    for (i = 0; i < count; i++)
+    {
+        memcpy(gf3d_transform.scratch + i * size,data + gf3d_transform.order[i] * size,size);
+    }
+    memcpy(data,gf3d_transform.scratch,count * size);
+}
+
+/**
+ * @brief rearrange every array so new dense index i holds what was at order[i], keeping count nodes
+ * @note remap must already map every old dense index to its new one, or to -1 for nodes that are dropped
+ */
+void gf3d_transform_reorder(Uint32 count)
+{
+    int i;
+    Sint32 parent;
+    gf3d_transform_permute(gf3d_transform.position,sizeof(Vector3D),count);
+    gf3d_transform_permute(gf3d_transform.rotation,sizeof(Quaternion),count);
+    gf3d_transform_permute(gf3d_transform.scale,sizeof(Vector3D),count);
+    gf3d_transform_permute(gf3d_transform.world,sizeof(Matrix4),count);
+    gf3d_transform_permute(gf3d_transform.dirty,sizeof(Uint8),count);
+    gf3d_transform_permute(gf3d_transform.changed,sizeof(Uint32),count);
+    gf3d_transform_permute(gf3d_transform.nodeId,sizeof(Uint32),count);
+    gf3d_transform_permute(gf3d_transform.parent,sizeof(Sint32),count);
+    for (i = 0; i < count; i++)
+    {
+        parent = gf3d_transform.parent[i];
+        if (parent >= 0)gf3d_transform.parent[i] = gf3d_transform.remap[parent];
+        gf3d_transform.denseIndex[gf3d_transform.nodeId[i]] = i;
+    }
+    gf3d_transform.nodeCount = count;
+}
+
+/**
+ * NODES
+ */
+
+Sint32 gf3d_transform_new(Sint32 parent)
+{
+    Sint32 parentDense = -1;
+    Uint32 node,dense;
+    if (gf3d_transform.nodeCount >= gf3d_transform.maxNodes)
+    {
+        slog("no free transform nodes");
+        return -1;
+    }
+    if (parent >= 0)
+    {
+        parentDense = gf3d_transform_dense(parent);
+        if (parentDense < 0)
+        {
+            slog("cannot attach a transform to missing parent %i",parent);
+            return -1;
+        }
+    }
+    node = gf3d_transform.freeIds[--gf3d_transform.freeCount];
+    // appended after everything, so after its parent
+    dense = gf3d_transform.nodeCount++;
+    gf3d_transform.denseIndex[node] = dense;
+    gf3d_transform.nodeId[dense] = node;
+    gf3d_transform.parent[dense] = parentDense;
+    vector3d_set(gf3d_transform.position[dense],0,0,0);
+    gf3d_transform.rotation[dense] = gf3d_quaternion_identity();
+    vector3d_set(gf3d_transform.scale[dense],1,1,1);
+    gf3d_matrix_identity(gf3d_transform.world[dense]);
+    gf3d_transform.changed[dense] = 0;
+    gf3d_transform_dirty(dense);
+    return node;
+}
+
+void gf3d_transform_free(Sint32 node)
+{
+    int i;
+    Sint32 dense;
+    Uint32 count = 0;
+    dense = gf3d_transform_dense(node);
+    if (dense < 0)return;
+    gf3d_transform_mark_subtree(dense);
+    for (i = 0; i < gf3d_transform.nodeCount; i++)
+    {
+        if (gf3d_transform.marked[i])
+        {
+            gf3d_transform.remap[i] = -1;
+            gf3d_transform.denseIndex[gf3d_transform.nodeId[i]] = -1;
+            gf3d_transform.freeIds[gf3d_transform.freeCount++] = gf3d_transform.nodeId[i];
+            continue;
+        }
+        gf3d_transform.remap[i] = count;
+        gf3d_transform.order[count++] = i;
+    }
+    gf3d_transform_reorder(count);
+    // everything that moved slid down to dense or later
+    gf3d_transform.firstDirty = MIN(gf3d_transform.firstDirty,dense);
+}
+
+Bool gf3d_transform_set_parent(Sint32 node,Sint32 parent)
+{
+    int i;
+    Sint32 dense,parentDense = -1;
+    Uint32 count = 0;
+    dense = gf3d_transform_dense(node);
+    if (dense < 0)
+    {
+        slog("cannot reparent missing transform %i",node);
+        return false;
+    }
+    if (parent >= 0)
+    {
+        parentDense = gf3d_transform_dense(parent);
+        if (parentDense < 0)
+        {
+            slog("cannot attach transform %i to missing parent %i",node,parent);
+            return false;
+        }
+    }
+    if (parentDense > dense)
+    {
+        gf3d_transform_mark_subtree(dense);
+        if (gf3d_transform.marked[parentDense])
+        {
+            slog("cannot attach transform %i below itself",node);
+            return false;
+        }
+        // the subtree moves to the end, after the new parent, keeping its own order
+        for (i = 0; i < gf3d_transform.nodeCount; i++)
+        {
+            if (gf3d_transform.marked[i])continue;
+            gf3d_transform.remap[i] = count;
+            gf3d_transform.order[count++] = i;
+        }
+        for (i = dense; i < gf3d_transform.nodeCount; i++)
+        {
+            if (!gf3d_transform.marked[i])continue;
+            gf3d_transform.remap[i] = count;
+            gf3d_transform.order[count++] = i;
+        }
+        gf3d_transform_reorder(count);
+        gf3d_transform.firstDirty = MIN(gf3d_transform.firstDirty,dense);
+        parentDense = gf3d_transform.remap[parentDense];
+        dense = gf3d_transform.denseIndex[node];
+    }
+    else if (parentDense == dense)
+    {
+        slog("cannot attach transform %i to itself",node);
+        return false;
+    }
+    gf3d_transform.parent[dense] = parentDense;
+    gf3d_transform_dirty(dense);
+    return true;
+}
+
+Sint32 gf3d_transform_get_parent(Sint32 node)
+{
+    Sint32 dense,parent;
+    dense = gf3d_transform_dense(node);
+    if (dense < 0)return -1;
+    parent = gf3d_transform.parent[dense];
+    if (parent < 0)return -1;
+    return gf3d_transform.nodeId[parent];
+}
+
+Uint32 gf3d_transform_count()
+{
+    return gf3d_transform.nodeCount;
+}
+
+/**
+ * LOCAL TRANSFORMS
+ */
+
+void gf3d_transform_set_position(Sint32 node,Vector3D position)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return;
+    gf3d_transform.position[dense] = position;
+    gf3d_transform_dirty(dense);
+}
+
+void gf3d_transform_set_rotation(Sint32 node,Quaternion rotation)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return;
+    gf3d_transform.rotation[dense] = rotation;
+    gf3d_transform_dirty(dense);
+}
+
+void gf3d_transform_set_scale(Sint32 node,Vector3D scale)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return;
+    gf3d_transform.scale[dense] = scale;
+    gf3d_transform_dirty(dense);
+}
+
+void gf3d_transform_set_local(Sint32 node,Vector3D position,Quaternion rotation,Vector3D scale)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return;
+    gf3d_transform.position[dense] = position;
+    gf3d_transform.rotation[dense] = rotation;
+    gf3d_transform.scale[dense] = scale;
+    gf3d_transform_dirty(dense);
+}
+
+Bool gf3d_transform_get_local(Sint32 node,Vector3D *position,Quaternion *rotation,Vector3D *scale)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return false;
+    if (position)*position = gf3d_transform.position[dense];
+    if (rotation)*rotation = gf3d_transform.rotation[dense];
+    if (scale)*scale = gf3d_transform.scale[dense];
+    return true;
+}
+
+/**
+ * WORLD MATRICES
+ */
+
+Uint32 gf3d_transform_update()
+{
+    int i;
+    Sint32 parent;
+    Uint32 pass,rebuilt = 0;
+    Matrix4 local;
+
+    pass = ++gf3d_transform.pass;
+    for (i = gf3d_transform.firstDirty; i < gf3d_transform.nodeCount; i++)
+    {
+        parent = gf3d_transform.parent[i];
+        // parents come first, so a parent rebuilt in this pass already has its new world matrix
+        if ((!gf3d_transform.dirty[i])&&((parent < 0)||(gf3d_transform.changed[parent] != pass)))continue;
+        gf3d_matrix_compose(local,gf3d_transform.position[i],gf3d_transform.rotation[i],gf3d_transform.scale[i]);
+        if (parent < 0)gf3d_matrix_copy(gf3d_transform.world[i],local);
+        else gf3d_matrix_multiply(gf3d_transform.world[i],gf3d_transform.world[parent],local);
+        gf3d_transform.dirty[i] = 0;
+        gf3d_transform.changed[i] = pass;
+        rebuilt++;
+    }
+    gf3d_transform.firstDirty = gf3d_transform.nodeCount;
+    return rebuilt;
+}
+
+Bool gf3d_transform_get_world(Matrix4 out,Sint32 node)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if ((!out)||(dense < 0))return false;
+    gf3d_matrix_copy(out,gf3d_transform.world[dense]);
+    return true;
+}
+
+Bool gf3d_transform_world_changed(Sint32 node)
+{
+    Sint32 dense = gf3d_transform_dense(node);
+    if (dense < 0)return false;
+    return (gf3d_transform.changed[dense] == gf3d_transform.pass);
+}
+
+/*eol@eof*/
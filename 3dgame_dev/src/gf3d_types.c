@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #include "simple_logger.h"
+#include "gf3d_memory.h"
 
 void *gf3d_allocate_array(size_t typeSize,size_t count)
 {
@@ -25,6 +26,7 @@ void *gf3d_allocate_array(size_t typeSize,size_t count)
         return NULL;
     }
     memset(array,0,typeSize*count);
+    gf3d_memory_count_heap();
     return array;
 }
 
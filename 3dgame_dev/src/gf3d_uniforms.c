@@ -0,0 +1,333 @@
+#include "gf3d_uniforms.h"
+#include "gf3d_buffers.h"
+#include "gf3d_descriptors.h"
+#include "gf3d_swapchain.h"
+#include "gf3d_camera.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#define GF3D_UNIFORMS_MAX_FRAMES 32     // frame dirty bits are tracked in a Uint32
+
+typedef struct
+{
+    Matrix4     model;
+    Uint32      staleFrames;        /**<bit per frame whose copy of this model matrix is out of date*/
+    Bool        inUse;
+}UniformObject;
+
+typedef struct
+{
+    VkDevice                device;
+    Uint32                  frameCount;
+    Uint32                  allFrames;          /**<mask with a bit set for every frame*/
+    Uint32                  maxObjects;
+    VkDeviceSize            cameraStride;       /**<size of the camera block, aligned for use as a buffer offset*/
+    VkDeviceSize            objectStride;       /**<size of one model matrix, aligned for use as a dynamic offset*/
+    VkDeviceSize            frameStride;        /**<camera block plus every object block*/
+    GpuBuffer               buffer;             /**<every frame's uniforms, persistently mapped*/
+    VkDescriptorSetLayout   layout;
+    CameraUniform           camera;             /**<latest camera data, copied into frames as they go stale*/
+    Uint32                  cameraVersion;      /**<gf3d_camera version that camera was copied from*/
+    Uint32                  cameraStaleFrames;  /**<bit per frame whose camera block is out of date*/
+    UniformObject          *objects;
+    Uint32                 *dirtyObjects;       /**<objects with at least one stale frame*/
+    Uint32                  dirtyCount;
+    UniformStats            stats;
+}UniformManager;
+
+static UniformManager gf3d_uniforms = {0};
+
+void gf3d_uniforms_close();
+void gf3d_uniforms_layout_create();
+void gf3d_uniforms_camera_refresh();
+
+void gf3d_uniforms_init(VkDevice device,Uint32 frameCount,Uint32 maxObjects)
+{
+    int i,j;
+    VkExtent2D extent;
+    const VkPhysicalDeviceLimits *limits;
+
+    if ((!frameCount)||(frameCount > GF3D_UNIFORMS_MAX_FRAMES))
+    {
+        slog("cannot initialize uniforms for %i frames",frameCount);
+        return;
+    }
+    if (!maxObjects)
+    {
+        slog("cannot initialize uniforms for zero objects");
+        return;
+    }
+    limits = gf3d_buffers_get_limits();
+    if (!limits)
+    {
+        slog("uniforms need the buffer system to be initialized");
+        return;
+    }
+    gf3d_uniforms.device = device;
+    gf3d_uniforms.frameCount = frameCount;
+    gf3d_uniforms.allFrames = (frameCount == 32)?0xFFFFFFFF:((1U << frameCount) - 1);
+    gf3d_uniforms.maxObjects = maxObjects;
+    gf3d_uniforms.cameraStride = gf3d_buffers_align(sizeof(CameraUniform),limits->minUniformBufferOffsetAlignment);
+    gf3d_uniforms.objectStride = gf3d_buffers_align(sizeof(Matrix4),limits->minUniformBufferOffsetAlignment);
+    gf3d_uniforms.frameStride = gf3d_uniforms.cameraStride + (gf3d_uniforms.objectStride * maxObjects);
+
+    gf3d_uniforms.objects = (UniformObject *)gf3d_memory_allocate(MT_Render,sizeof(UniformObject),maxObjects);
+    gf3d_uniforms.dirtyObjects = (Uint32 *)gf3d_memory_allocate(MT_Render,sizeof(Uint32),maxObjects);
+    if ((!gf3d_uniforms.objects)||(!gf3d_uniforms.dirtyObjects))
+    {
+        slog("failed to allocate uniform object list");
+        gf3d_uniforms_close();
+        return;
+    }
+    for (i = 0; i < maxObjects; i++)
+    {
+        gf3d_matrix_identity(gf3d_uniforms.objects[i].model);
+    }
+
+    if (!gf3d_buffer_create(
+        &gf3d_uniforms.buffer,
+        MT_Render,
+        gf3d_uniforms.frameStride * frameCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        slog("failed to create uniform buffer");
+        gf3d_uniforms_close();
+        return;
+    }
+    // every slot starts out as identity, so every frame's copy needs it once
+    for (i = 0; i < frameCount; i++)
+    {
+        for (j = 0; j < maxObjects; j++)
+        {
+            memcpy((Uint8*)gf3d_uniforms.buffer.mapped + (gf3d_uniforms.frameStride * i) + gf3d_uniforms.cameraStride + (gf3d_uniforms.objectStride * j),
+                   gf3d_uniforms.objects[j].model,
+                   sizeof(Matrix4));
+        }
+    }
+
+    gf3d_uniforms_layout_create();
+
+    extent = gf3d_swapchain_get_extent();
+    gf3d_camera_object_set_aspect(gf3d_camera_get_active(),extent.height?(extent.width/(float)extent.height):1);
+    gf3d_uniforms.cameraVersion = gf3d_camera_get_version() - 1;     // force the first copy
+    gf3d_uniforms_camera_refresh();
+
+    slog("uniforms initialized for %i objects over %i frames",maxObjects,frameCount);
+    atexit(gf3d_uniforms_close);
+}
+
+void gf3d_uniforms_close()
+{
+    if (gf3d_uniforms.layout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(gf3d_uniforms.device, gf3d_uniforms.layout, NULL);
+    }
+    gf3d_buffer_free(&gf3d_uniforms.buffer);
+    if (gf3d_uniforms.objects)
+    {
+        gf3d_memory_free(gf3d_uniforms.objects);
+    }
+    if (gf3d_uniforms.dirtyObjects)
+    {
+        gf3d_memory_free(gf3d_uniforms.dirtyObjects);
+    }
+    memset(&gf3d_uniforms,0,sizeof(UniformManager));
+}
+
+void gf3d_uniforms_layout_create()
+{
+    VkDescriptorSetLayoutBinding bindings[2] = {0};
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(gf3d_uniforms.device, &layoutInfo, NULL, &gf3d_uniforms.layout) != VK_SUCCESS)
+    {
+        slog("failed to create uniform descriptor set layout");
+    }
+}
+
+VkDescriptorSetLayout gf3d_uniforms_get_layout()
+{
+    return gf3d_uniforms.layout;
+}
+
+void gf3d_uniforms_set_projection(Matrix4 proj)
+{
+    if (!proj)return;
+    gf3d_camera_object_set_projection(gf3d_camera_get_active(),proj);
+}
+
+void gf3d_uniforms_camera_refresh()
+{
+    const CameraMatrices *matrices;
+    Uint32 version = gf3d_camera_get_version();
+    if (version == gf3d_uniforms.cameraVersion)return;
+    matrices = gf3d_camera_object_get_matrices(gf3d_camera_get_active());
+    if (!matrices)return;
+    gf3d_uniforms.cameraVersion = version;
+    memcpy(gf3d_uniforms.camera.view,matrices->view,sizeof(Matrix4));
+    memcpy(gf3d_uniforms.camera.proj,matrices->proj,sizeof(Matrix4));
+    memcpy(gf3d_uniforms.camera.viewProj,matrices->viewProj,sizeof(Matrix4));
+    gf3d_uniforms.cameraStaleFrames = gf3d_uniforms.allFrames;
+}
+
+void gf3d_uniforms_get_camera(CameraUniform *camera)
+{
+    if (!camera)return;
+    gf3d_uniforms_camera_refresh();
+    memcpy(camera,&gf3d_uniforms.camera,sizeof(CameraUniform));
+}
+
+Sint32 gf3d_uniforms_object_new()
+{
+    int i;
+    for (i = 0; i < gf3d_uniforms.maxObjects; i++)
+    {
+        if (gf3d_uniforms.objects[i].inUse)continue;
+        gf3d_uniforms.objects[i].inUse = true;
+        gf3d_uniforms_object_set_model(i,NULL);
+        return i;
+    }
+    slog("no free uniform object slots");
+    return -1;
+}
+
+void gf3d_uniforms_object_free(Sint32 object)
+{
+    if ((object < 0)||(object >= gf3d_uniforms.maxObjects))return;
+    gf3d_uniforms.objects[object].inUse = false;
+}
+
+void gf3d_uniforms_object_set_model(Sint32 object,Matrix4 model)
+{
+    UniformObject *obj;
+    if ((object < 0)||(object >= gf3d_uniforms.maxObjects))return;
+    obj = &gf3d_uniforms.objects[object];
+    if (model)
+    {
+        gf3d_matrix_copy(obj->model,model);
+    }
+    else
+    {
+        gf3d_matrix_identity(obj->model);
+    }
+    if (!obj->staleFrames)
+    {
+        gf3d_uniforms.dirtyObjects[gf3d_uniforms.dirtyCount++] = object;
+    }
+    obj->staleFrames = gf3d_uniforms.allFrames;
+}
+
+void gf3d_uniforms_update(Uint32 frame)
+{
+    Uint32 i;
+    Uint32 bit;
+    Uint32 object;
+    Uint8 *frameData;
+    UniformObject *obj;
+
+    if (!gf3d_uniforms.buffer.mapped)return;
+    if (frame >= gf3d_uniforms.frameCount)return;
+    bit = 1U << frame;
+    frameData = (Uint8 *)gf3d_uniforms.buffer.mapped + (gf3d_uniforms.frameStride * frame);
+
+    gf3d_uniforms_camera_refresh();
+    if (gf3d_uniforms.cameraStaleFrames & bit)
+    {
+        memcpy(frameData,&gf3d_uniforms.camera,sizeof(CameraUniform));
+        gf3d_uniforms.cameraStaleFrames &= ~bit;
+        gf3d_uniforms.stats.cameraUploads++;
+    }
+
+    // only objects that changed are visited, and each is dropped once every frame has its new matrix
+    for (i = 0; i < gf3d_uniforms.dirtyCount;)
+    {
+        object = gf3d_uniforms.dirtyObjects[i];
+        obj = &gf3d_uniforms.objects[object];
+        if (obj->staleFrames & bit)
+        {
+            memcpy(frameData + gf3d_uniforms.cameraStride + (gf3d_uniforms.objectStride * object),obj->model,sizeof(Matrix4));
+            obj->staleFrames &= ~bit;
+            gf3d_uniforms.stats.objectUploads++;
+        }
+        if (!obj->staleFrames)
+        {
+            gf3d_uniforms.dirtyObjects[i] = gf3d_uniforms.dirtyObjects[--gf3d_uniforms.dirtyCount];
+            continue;
+        }
+        i++;
+    }
+}
+
+VkDescriptorSet gf3d_uniforms_get_set(Uint32 frame)
+{
+    DescriptorBinding bindings[2] = {0};
+
+    if (gf3d_uniforms.layout == VK_NULL_HANDLE)return VK_NULL_HANDLE;
+    if (frame >= gf3d_uniforms.frameCount)return VK_NULL_HANDLE;
+
+    bindings[0].binding = 0;
+    bindings[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].bufferInfo.buffer = gf3d_uniforms.buffer.buffer;
+    bindings[0].bufferInfo.offset = gf3d_uniforms.frameStride * frame;
+    bindings[0].bufferInfo.range = sizeof(CameraUniform);
+
+    bindings[1].binding = 1;
+    bindings[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[1].bufferInfo.buffer = gf3d_uniforms.buffer.buffer;
+    bindings[1].bufferInfo.offset = (gf3d_uniforms.frameStride * frame) + gf3d_uniforms.cameraStride;
+    bindings[1].bufferInfo.range = sizeof(Matrix4);
+
+    // the set for a frame never changes, so after the first lookup it comes straight out of the cache
+    return gf3d_descriptors_get_cached(gf3d_uniforms.layout,bindings,2);
+}
+
+void gf3d_uniforms_bind_set(VkCommandBuffer commandBuffer,VkPipelineLayout pipelineLayout,VkDescriptorSet set,Sint32 object)
+{
+    Uint32 dynamicOffset;
+
+    if (set == VK_NULL_HANDLE)return;
+    if ((object < 0)||(object >= gf3d_uniforms.maxObjects))object = 0;
+
+    dynamicOffset = (Uint32)(gf3d_uniforms.objectStride * object);
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        0,
+        1,
+        &set,
+        1,
+        &dynamicOffset);
+}
+
+void gf3d_uniforms_bind(VkCommandBuffer commandBuffer,VkPipelineLayout pipelineLayout,Uint32 frame,Sint32 object)
+{
+    gf3d_uniforms_bind_set(commandBuffer,pipelineLayout,gf3d_uniforms_get_set(frame),object);
+}
+
+void gf3d_uniforms_get_stats(UniformStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_uniforms.stats,sizeof(UniformStats));
+}
+
+/*eol@eof*/
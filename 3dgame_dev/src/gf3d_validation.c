@@ -1,3 +1,5 @@
+#define SLOG_CATEGORY "validation"
+
 #include <vulkan/vulkan.h>
 
 #include "gf3d_validation.h"
@@ -7,6 +9,7 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "gf3d_memory.h"
 #include "simple_logger.h"
 
 // validation layers
@@ -23,18 +26,18 @@ void gf3d_validation_query_layer_properties()
 {
     int i;
     vkEnumerateInstanceLayerProperties(&gf3d_validation.layerCount, NULL);
-    slog("discovered %i validation layers",gf3d_validation.layerCount);
+    slog_debug("discovered %i validation layers",gf3d_validation.layerCount);
     
     if (!gf3d_validation.layerCount)return;
     
-    gf3d_validation.availableLayers = (VkLayerProperties *)gf3d_allocate_array(sizeof(VkLayerProperties),gf3d_validation.layerCount);
+    gf3d_validation.availableLayers = (VkLayerProperties *)gf3d_memory_allocate(MT_Graphics,sizeof(VkLayerProperties),gf3d_validation.layerCount);
     vkEnumerateInstanceLayerProperties(&gf3d_validation.layerCount, gf3d_validation.availableLayers);
     
-    gf3d_validation.layerNames = (const char* * )gf3d_allocate_array(sizeof(const char *),gf3d_validation.layerCount);
+    gf3d_validation.layerNames = (const char* * )gf3d_memory_allocate(MT_Graphics,sizeof(const char *),gf3d_validation.layerCount);
     for (i = 0; i < gf3d_validation.layerCount;i++)
     {
         gf3d_validation.layerNames[i] = (const char *)gf3d_validation.availableLayers[i].layerName;
-        slog("Validation layer available: %s",gf3d_validation.availableLayers[i].layerName);
+        slog_debug("Validation layer available: %s",gf3d_validation.availableLayers[i].layerName);
     }
 }
 
@@ -42,12 +45,12 @@ void gf3d_validation_close()
 {
     if (gf3d_validation.availableLayers)
     {
-        free(gf3d_validation.availableLayers);
+        gf3d_memory_free(gf3d_validation.availableLayers);
         gf3d_validation.availableLayers = NULL;
     }
     if (gf3d_validation.layerNames)
     {
-        free(gf3d_validation.layerNames);
+        gf3d_memory_free(gf3d_validation.layerNames);
         gf3d_validation.layerNames = NULL;
     }
     memset(&gf3d_validation,0,sizeof(vValidation));
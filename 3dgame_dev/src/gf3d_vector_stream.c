@@ -0,0 +1,597 @@
+#include <math.h>
+#include <string.h>
+#include "gf3d_vector_stream.h"
+#include "gf3d_memory.h"
+#include "simple_logger.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GF3D_VECTOR_STREAM_SSE
+#define GF3D_VECTOR_STREAM_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(GF3D_VECTOR_STREAM_AVX)
+#include <intrin.h>
+#define GF3D_VECTOR_STREAM_TARGET_AVX
+#elif defined(GF3D_VECTOR_STREAM_AVX)
+#define GF3D_VECTOR_STREAM_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+#define GF3D_VECTOR_STREAM_PAD 8       // arrays are padded to a whole AVX register
+
+/**
+ * @brief every kernel works on vectors first to count, the SIMD ones hand the last partial register to the scalar one
+ */
+typedef void (*VectorStreamBinaryKernel)(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count);
+typedef void (*VectorStreamScaleKernel)(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count);
+typedef void (*VectorStreamFloatKernel)(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count);
+typedef void (*VectorStreamUnaryKernel)(VectorStream3D out,VectorStream3D a,Uint32 first,Uint32 count);
+
+typedef struct
+{
+    MatrixSimd                  simd;
+    VectorStreamBinaryKernel    add;
+    VectorStreamBinaryKernel    sub;
+    VectorStreamBinaryKernel    cross;
+    VectorStreamScaleKernel     scale;          /**<b is ignored*/
+    VectorStreamScaleKernel     scaleAdd;
+    VectorStreamFloatKernel     dot;
+    VectorStreamFloatKernel     length;         /**<b is ignored*/
+    VectorStreamUnaryKernel     normalize;
+}VectorStreamKernels;
+
+static VectorStreamKernels gf3d_vector_stream_kernels = {0};
+
+/**
+ * SCALAR KERNELS
+ */
+
+void gf3d_vector_stream3d_add_scalar(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out.x[i] = a.x[i] + b.x[i];
+        out.y[i] = a.y[i] + b.y[i];
+        out.z[i] = a.z[i] + b.z[i];
+    }
+}
+
+void gf3d_vector_stream3d_sub_scalar(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out.x[i] = a.x[i] - b.x[i];
+        out.y[i] = a.y[i] - b.y[i];
+        out.z[i] = a.z[i] - b.z[i];
+    }
+}
+
+void gf3d_vector_stream3d_cross_scalar(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    float x,y,z;
+    for (i = first; i < count; i++)
+    {
+        x = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+        y = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+        z = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+        out.x[i] = x;
+        out.y[i] = y;
+        out.z[i] = z;
+    }
+}
+
+void gf3d_vector_stream3d_scale_scalar(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out.x[i] = a.x[i] * scale;
+        out.y[i] = a.y[i] * scale;
+        out.z[i] = a.z[i] * scale;
+    }
+}
+
+void gf3d_vector_stream3d_scale_add_scalar(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out.x[i] = a.x[i] + b.x[i] * scale;
+        out.y[i] = a.y[i] + b.y[i] * scale;
+        out.z[i] = a.z[i] + b.z[i] * scale;
+    }
+}
+
+void gf3d_vector_stream3d_dot_scalar(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+    }
+}
+
+void gf3d_vector_stream3d_length_scalar(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i < count; i++)
+    {
+        out[i] = sqrtf(a.x[i] * a.x[i] + a.y[i] * a.y[i] + a.z[i] * a.z[i]);
+    }
+}
+
+void gf3d_vector_stream3d_normalize_scalar(VectorStream3D out,VectorStream3D a,Uint32 first,Uint32 count)
+{
+    int i;
+    float length;
+    for (i = first; i < count; i++)
+    {
+        length = sqrtf(a.x[i] * a.x[i] + a.y[i] * a.y[i] + a.z[i] * a.z[i]);
+        if (length == 0)
+        {
+            out.x[i] = out.y[i] = out.z[i] = 0;
+            continue;
+        }
+        out.x[i] = a.x[i] / length;
+        out.y[i] = a.y[i] / length;
+        out.z[i] = a.z[i] / length;
+    }
+}
+
+#ifdef GF3D_VECTOR_STREAM_SSE
+
+/**
+ * SSE KERNELS
+ */
+
+void gf3d_vector_stream3d_add_sse(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        _mm_storeu_ps(out.x + i,_mm_add_ps(_mm_loadu_ps(a.x + i),_mm_loadu_ps(b.x + i)));
+        _mm_storeu_ps(out.y + i,_mm_add_ps(_mm_loadu_ps(a.y + i),_mm_loadu_ps(b.y + i)));
+        _mm_storeu_ps(out.z + i,_mm_add_ps(_mm_loadu_ps(a.z + i),_mm_loadu_ps(b.z + i)));
+    }
+    gf3d_vector_stream3d_add_scalar(out,a,b,i,count);
+}
+
+void gf3d_vector_stream3d_sub_sse(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        _mm_storeu_ps(out.x + i,_mm_sub_ps(_mm_loadu_ps(a.x + i),_mm_loadu_ps(b.x + i)));
+        _mm_storeu_ps(out.y + i,_mm_sub_ps(_mm_loadu_ps(a.y + i),_mm_loadu_ps(b.y + i)));
+        _mm_storeu_ps(out.z + i,_mm_sub_ps(_mm_loadu_ps(a.z + i),_mm_loadu_ps(b.z + i)));
+    }
+    gf3d_vector_stream3d_sub_scalar(out,a,b,i,count);
+}
+
+void gf3d_vector_stream3d_cross_sse(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 ax,ay,az,bx,by,bz;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        ax = _mm_loadu_ps(a.x + i);
+        ay = _mm_loadu_ps(a.y + i);
+        az = _mm_loadu_ps(a.z + i);
+        bx = _mm_loadu_ps(b.x + i);
+        by = _mm_loadu_ps(b.y + i);
+        bz = _mm_loadu_ps(b.z + i);
+        _mm_storeu_ps(out.x + i,_mm_sub_ps(_mm_mul_ps(ay,bz),_mm_mul_ps(az,by)));
+        _mm_storeu_ps(out.y + i,_mm_sub_ps(_mm_mul_ps(az,bx),_mm_mul_ps(ax,bz)));
+        _mm_storeu_ps(out.z + i,_mm_sub_ps(_mm_mul_ps(ax,by),_mm_mul_ps(ay,bx)));
+    }
+    gf3d_vector_stream3d_cross_scalar(out,a,b,i,count);
+}
+
+void gf3d_vector_stream3d_scale_sse(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 s = _mm_set1_ps(scale);
+    for (i = first; i + 3 < count; i += 4)
+    {
+        _mm_storeu_ps(out.x + i,_mm_mul_ps(_mm_loadu_ps(a.x + i),s));
+        _mm_storeu_ps(out.y + i,_mm_mul_ps(_mm_loadu_ps(a.y + i),s));
+        _mm_storeu_ps(out.z + i,_mm_mul_ps(_mm_loadu_ps(a.z + i),s));
+    }
+    gf3d_vector_stream3d_scale_scalar(out,a,b,scale,i,count);
+}
+
+void gf3d_vector_stream3d_scale_add_sse(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 s = _mm_set1_ps(scale);
+    for (i = first; i + 3 < count; i += 4)
+    {
+        _mm_storeu_ps(out.x + i,_mm_add_ps(_mm_loadu_ps(a.x + i),_mm_mul_ps(_mm_loadu_ps(b.x + i),s)));
+        _mm_storeu_ps(out.y + i,_mm_add_ps(_mm_loadu_ps(a.y + i),_mm_mul_ps(_mm_loadu_ps(b.y + i),s)));
+        _mm_storeu_ps(out.z + i,_mm_add_ps(_mm_loadu_ps(a.z + i),_mm_mul_ps(_mm_loadu_ps(b.z + i),s)));
+    }
+    gf3d_vector_stream3d_scale_add_scalar(out,a,b,scale,i,count);
+}
+
+void gf3d_vector_stream3d_dot_sse(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 d;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        d = _mm_mul_ps(_mm_loadu_ps(a.x + i),_mm_loadu_ps(b.x + i));
+        d = _mm_add_ps(d,_mm_mul_ps(_mm_loadu_ps(a.y + i),_mm_loadu_ps(b.y + i)));
+        d = _mm_add_ps(d,_mm_mul_ps(_mm_loadu_ps(a.z + i),_mm_loadu_ps(b.z + i)));
+        _mm_storeu_ps(out + i,d);
+    }
+    gf3d_vector_stream3d_dot_scalar(out,a,b,i,count);
+}
+
+void gf3d_vector_stream3d_length_sse(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 x,y,z;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        x = _mm_loadu_ps(a.x + i);
+        y = _mm_loadu_ps(a.y + i);
+        z = _mm_loadu_ps(a.z + i);
+        x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,x),_mm_mul_ps(y,y)),_mm_mul_ps(z,z));
+        _mm_storeu_ps(out + i,_mm_sqrt_ps(x));
+    }
+    gf3d_vector_stream3d_length_scalar(out,a,b,i,count);
+}
+
+void gf3d_vector_stream3d_normalize_sse(VectorStream3D out,VectorStream3D a,Uint32 first,Uint32 count)
+{
+    int i;
+    __m128 x,y,z,length,nonZero;
+    for (i = first; i + 3 < count; i += 4)
+    {
+        x = _mm_loadu_ps(a.x + i);
+        y = _mm_loadu_ps(a.y + i);
+        z = _mm_loadu_ps(a.z + i);
+        length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,x),_mm_mul_ps(y,y)),_mm_mul_ps(z,z)));
+        // a true divide, not the reciprocal estimate, so the results match the scalar ones
+        nonZero = _mm_cmpneq_ps(length,_mm_setzero_ps());
+        _mm_storeu_ps(out.x + i,_mm_and_ps(_mm_div_ps(x,length),nonZero));
+        _mm_storeu_ps(out.y + i,_mm_and_ps(_mm_div_ps(y,length),nonZero));
+        _mm_storeu_ps(out.z + i,_mm_and_ps(_mm_div_ps(z,length),nonZero));
+    }
+    gf3d_vector_stream3d_normalize_scalar(out,a,i,count);
+}
+
+#endif
+
+#ifdef GF3D_VECTOR_STREAM_AVX
+
+/**
+ * AVX KERNELS
+ */
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_add_avx(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        _mm256_storeu_ps(out.x + i,_mm256_add_ps(_mm256_loadu_ps(a.x + i),_mm256_loadu_ps(b.x + i)));
+        _mm256_storeu_ps(out.y + i,_mm256_add_ps(_mm256_loadu_ps(a.y + i),_mm256_loadu_ps(b.y + i)));
+        _mm256_storeu_ps(out.z + i,_mm256_add_ps(_mm256_loadu_ps(a.z + i),_mm256_loadu_ps(b.z + i)));
+    }
+    gf3d_vector_stream3d_add_scalar(out,a,b,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_sub_avx(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        _mm256_storeu_ps(out.x + i,_mm256_sub_ps(_mm256_loadu_ps(a.x + i),_mm256_loadu_ps(b.x + i)));
+        _mm256_storeu_ps(out.y + i,_mm256_sub_ps(_mm256_loadu_ps(a.y + i),_mm256_loadu_ps(b.y + i)));
+        _mm256_storeu_ps(out.z + i,_mm256_sub_ps(_mm256_loadu_ps(a.z + i),_mm256_loadu_ps(b.z + i)));
+    }
+    gf3d_vector_stream3d_sub_scalar(out,a,b,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_cross_avx(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 ax,ay,az,bx,by,bz;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        ax = _mm256_loadu_ps(a.x + i);
+        ay = _mm256_loadu_ps(a.y + i);
+        az = _mm256_loadu_ps(a.z + i);
+        bx = _mm256_loadu_ps(b.x + i);
+        by = _mm256_loadu_ps(b.y + i);
+        bz = _mm256_loadu_ps(b.z + i);
+        _mm256_storeu_ps(out.x + i,_mm256_sub_ps(_mm256_mul_ps(ay,bz),_mm256_mul_ps(az,by)));
+        _mm256_storeu_ps(out.y + i,_mm256_sub_ps(_mm256_mul_ps(az,bx),_mm256_mul_ps(ax,bz)));
+        _mm256_storeu_ps(out.z + i,_mm256_sub_ps(_mm256_mul_ps(ax,by),_mm256_mul_ps(ay,bx)));
+    }
+    gf3d_vector_stream3d_cross_scalar(out,a,b,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_scale_avx(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 s = _mm256_set1_ps(scale);
+    for (i = first; i + 7 < count; i += 8)
+    {
+        _mm256_storeu_ps(out.x + i,_mm256_mul_ps(_mm256_loadu_ps(a.x + i),s));
+        _mm256_storeu_ps(out.y + i,_mm256_mul_ps(_mm256_loadu_ps(a.y + i),s));
+        _mm256_storeu_ps(out.z + i,_mm256_mul_ps(_mm256_loadu_ps(a.z + i),s));
+    }
+    gf3d_vector_stream3d_scale_scalar(out,a,b,scale,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_scale_add_avx(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 s = _mm256_set1_ps(scale);
+    for (i = first; i + 7 < count; i += 8)
+    {
+        _mm256_storeu_ps(out.x + i,_mm256_add_ps(_mm256_loadu_ps(a.x + i),_mm256_mul_ps(_mm256_loadu_ps(b.x + i),s)));
+        _mm256_storeu_ps(out.y + i,_mm256_add_ps(_mm256_loadu_ps(a.y + i),_mm256_mul_ps(_mm256_loadu_ps(b.y + i),s)));
+        _mm256_storeu_ps(out.z + i,_mm256_add_ps(_mm256_loadu_ps(a.z + i),_mm256_mul_ps(_mm256_loadu_ps(b.z + i),s)));
+    }
+    gf3d_vector_stream3d_scale_add_scalar(out,a,b,scale,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_dot_avx(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 d;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        d = _mm256_mul_ps(_mm256_loadu_ps(a.x + i),_mm256_loadu_ps(b.x + i));
+        d = _mm256_add_ps(d,_mm256_mul_ps(_mm256_loadu_ps(a.y + i),_mm256_loadu_ps(b.y + i)));
+        d = _mm256_add_ps(d,_mm256_mul_ps(_mm256_loadu_ps(a.z + i),_mm256_loadu_ps(b.z + i)));
+        _mm256_storeu_ps(out + i,d);
+    }
+    gf3d_vector_stream3d_dot_scalar(out,a,b,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_length_avx(float *out,VectorStream3D a,VectorStream3D b,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 x,y,z;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        x = _mm256_loadu_ps(a.x + i);
+        y = _mm256_loadu_ps(a.y + i);
+        z = _mm256_loadu_ps(a.z + i);
+        x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x,x),_mm256_mul_ps(y,y)),_mm256_mul_ps(z,z));
+        _mm256_storeu_ps(out + i,_mm256_sqrt_ps(x));
+    }
+    gf3d_vector_stream3d_length_scalar(out,a,b,i,count);
+}
+
+GF3D_VECTOR_STREAM_TARGET_AVX void gf3d_vector_stream3d_normalize_avx(VectorStream3D out,VectorStream3D a,Uint32 first,Uint32 count)
+{
+    int i;
+    __m256 x,y,z,length,nonZero;
+    for (i = first; i + 7 < count; i += 8)
+    {
+        x = _mm256_loadu_ps(a.x + i);
+        y = _mm256_loadu_ps(a.y + i);
+        z = _mm256_loadu_ps(a.z + i);
+        length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x,x),_mm256_mul_ps(y,y)),_mm256_mul_ps(z,z)));
+        // a true divide, not the reciprocal estimate, so the results match the scalar ones
+        nonZero = _mm256_cmp_ps(length,_mm256_setzero_ps(),_CMP_NEQ_OQ);
+        _mm256_storeu_ps(out.x + i,_mm256_and_ps(_mm256_div_ps(x,length),nonZero));
+        _mm256_storeu_ps(out.y + i,_mm256_and_ps(_mm256_div_ps(y,length),nonZero));
+        _mm256_storeu_ps(out.z + i,_mm256_and_ps(_mm256_div_ps(z,length),nonZero));
+    }
+    gf3d_vector_stream3d_normalize_scalar(out,a,i,count);
+}
+
+#endif
+
+/**
+ * DISPATCH
+ */
+
+Bool gf3d_vector_stream_cpu_has_avx()
+{
+#if defined(_MSC_VER) && defined(GF3D_VECTOR_STREAM_AVX)
+    int info[4];
+    __cpuid(info,1);
+    // the CPU must support AVX and the OS must save the YMM registers
+    if (!((info[2] & (1 << 27)) && (info[2] & (1 << 28))))return false;
+    return ((_xgetbv(0) & 6) == 6);
+#elif defined(GF3D_VECTOR_STREAM_AVX)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+MatrixSimd gf3d_vector_stream_simd_set(MatrixSimd simd)
+{
+    if ((simd >= MS_AVX)&&(!gf3d_vector_stream_cpu_has_avx()))simd = MS_SSE;
+#ifndef GF3D_VECTOR_STREAM_SSE
+    simd = MS_Scalar;
+#endif
+    switch (simd)
+    {
+#ifdef GF3D_VECTOR_STREAM_AVX
+        case MS_AVX:
+        case MS_MAX:
+            gf3d_vector_stream_kernels.add = gf3d_vector_stream3d_add_avx;
+            gf3d_vector_stream_kernels.sub = gf3d_vector_stream3d_sub_avx;
+            gf3d_vector_stream_kernels.cross = gf3d_vector_stream3d_cross_avx;
+            gf3d_vector_stream_kernels.scale = gf3d_vector_stream3d_scale_avx;
+            gf3d_vector_stream_kernels.scaleAdd = gf3d_vector_stream3d_scale_add_avx;
+            gf3d_vector_stream_kernels.dot = gf3d_vector_stream3d_dot_avx;
+            gf3d_vector_stream_kernels.length = gf3d_vector_stream3d_length_avx;
+            gf3d_vector_stream_kernels.normalize = gf3d_vector_stream3d_normalize_avx;
+            simd = MS_AVX;
+            break;
+#endif
+#ifdef GF3D_VECTOR_STREAM_SSE
+        case MS_SSE:
+            gf3d_vector_stream_kernels.add = gf3d_vector_stream3d_add_sse;
+            gf3d_vector_stream_kernels.sub = gf3d_vector_stream3d_sub_sse;
+            gf3d_vector_stream_kernels.cross = gf3d_vector_stream3d_cross_sse;
+            gf3d_vector_stream_kernels.scale = gf3d_vector_stream3d_scale_sse;
+            gf3d_vector_stream_kernels.scaleAdd = gf3d_vector_stream3d_scale_add_sse;
+            gf3d_vector_stream_kernels.dot = gf3d_vector_stream3d_dot_sse;
+            gf3d_vector_stream_kernels.length = gf3d_vector_stream3d_length_sse;
+            gf3d_vector_stream_kernels.normalize = gf3d_vector_stream3d_normalize_sse;
+            break;
+#endif
+        default:
+            gf3d_vector_stream_kernels.add = gf3d_vector_stream3d_add_scalar;
+            gf3d_vector_stream_kernels.sub = gf3d_vector_stream3d_sub_scalar;
+            gf3d_vector_stream_kernels.cross = gf3d_vector_stream3d_cross_scalar;
+            gf3d_vector_stream_kernels.scale = gf3d_vector_stream3d_scale_scalar;
+            gf3d_vector_stream_kernels.scaleAdd = gf3d_vector_stream3d_scale_add_scalar;
+            gf3d_vector_stream_kernels.dot = gf3d_vector_stream3d_dot_scalar;
+            gf3d_vector_stream_kernels.length = gf3d_vector_stream3d_length_scalar;
+            gf3d_vector_stream_kernels.normalize = gf3d_vector_stream3d_normalize_scalar;
+            simd = MS_Scalar;
+            break;
+    }
+    gf3d_vector_stream_kernels.simd = simd;
+    return simd;
+}
+
+/**
+ * @brief pick the best kernels the first time they are needed
+ * @note racing threads all store the same pointers, so no lock is needed
+ */
+static inline void gf3d_vector_stream_kernels_check()
+{
+    if (!gf3d_vector_stream_kernels.add)gf3d_vector_stream_simd_set(MS_MAX);
+}
+
+MatrixSimd gf3d_vector_stream_simd_get()
+{
+    gf3d_vector_stream_kernels_check();
+    return gf3d_vector_stream_kernels.simd;
+}
+
+/**
+ * STREAMS
+ */
+
+Bool gf3d_vector_stream3d_new(VectorStream3D *stream,Uint32 count)
+{
+    Uint32 padded;
+    float *block;
+    if (!stream)return false;
+    memset(stream,0,sizeof(VectorStream3D));
+    // one block for all three arrays, x owns it
+    padded = (count + GF3D_VECTOR_STREAM_PAD - 1) & ~(GF3D_VECTOR_STREAM_PAD - 1);
+    block = (float *)gf3d_memory_allocate(MT_General,sizeof(float),padded * 3);
+    if (!block)
+    {
+        slog("failed to allocate a vector stream of %i vectors",count);
+        return false;
+    }
+    stream->x = block;
+    stream->y = block + padded;
+    stream->z = block + padded * 2;
+    return true;
+}
+
+void gf3d_vector_stream3d_free(VectorStream3D *stream)
+{
+    if (!stream)return;
+    if (stream->x)gf3d_memory_free(stream->x);
+    memset(stream,0,sizeof(VectorStream3D));
+}
+
+VectorStream3D gf3d_vector_stream3d_slice(VectorStream3D stream,Uint32 first)
+{
+    VectorStream3D slice;
+    slice.x = stream.x + first;
+    slice.y = stream.y + first;
+    slice.z = stream.z + first;
+    return slice;
+}
+
+void gf3d_vector_stream3d_load(VectorStream3D stream,const Vector3D *vectors,Uint32 count)
+{
+    int i;
+    if (!vectors)return;
+    for (i = 0; i < count; i++)
+    {
+        stream.x[i] = vectors[i].x;
+        stream.y[i] = vectors[i].y;
+        stream.z[i] = vectors[i].z;
+    }
+}
+
+void gf3d_vector_stream3d_store(Vector3D *vectors,VectorStream3D stream,Uint32 count)
+{
+    int i;
+    if (!vectors)return;
+    for (i = 0; i < count; i++)
+    {
+        vectors[i].x = stream.x[i];
+        vectors[i].y = stream.y[i];
+        vectors[i].z = stream.z[i];
+    }
+}
+
+/**
+ * OPERATIONS
+ */
+
+void gf3d_vector_stream3d_add(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.add(out,a,b,0,count);
+}
+
+void gf3d_vector_stream3d_sub(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.sub(out,a,b,0,count);
+}
+
+void gf3d_vector_stream3d_scale(VectorStream3D out,VectorStream3D a,float scale,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.scale(out,a,a,scale,0,count);
+}
+
+void gf3d_vector_stream3d_scale_add(VectorStream3D out,VectorStream3D a,VectorStream3D b,float scale,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.scaleAdd(out,a,b,scale,0,count);
+}
+
+void gf3d_vector_stream3d_cross(VectorStream3D out,VectorStream3D a,VectorStream3D b,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.cross(out,a,b,0,count);
+}
+
+void gf3d_vector_stream3d_dot(float *out,VectorStream3D a,VectorStream3D b,Uint32 count)
+{
+    if (!out)return;
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.dot(out,a,b,0,count);
+}
+
+void gf3d_vector_stream3d_length(float *out,VectorStream3D a,Uint32 count)
+{
+    if (!out)return;
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.length(out,a,a,0,count);
+}
+
+void gf3d_vector_stream3d_normalize(VectorStream3D out,VectorStream3D a,Uint32 count)
+{
+    gf3d_vector_stream_kernels_check();
+    gf3d_vector_stream_kernels.normalize(out,a,0,count);
+}
+
+/*eol@eof*/
@@ -2,6 +2,8 @@
  * @purpose vulkan graphics setup and abstraction
 */
 
+#define SLOG_CATEGORY "vgraphics"
+
 #include <SDL.h>
 #include <SDL_vulkan.h>
 #include <vulkan/vulkan.h>
@@ -18,6 +20,17 @@
 #include "gf3d_vgraphics.h"
 #include "gf3d_pipeline.h"
 #include "gf3d_commands.h"
+#include "gf3d_descriptors.h"
+#include "gf3d_buffers.h"
+#include "gf3d_uniforms.h"
+#include "gf3d_camera.h"
+#include "gf3d_mesh.h"
+#include "gf3d_batch.h"
+#include "gf3d_indirect.h"
+#include "gf3d_render_queue.h"
+#include "gf3d_render_graph.h"
+#include "gf3d_trace.h"
+#include "gf3d_memory.h"
 
 #include "simple_logger.h"
 
@@ -38,8 +51,6 @@ typedef struct
     unsigned int                enabled_layer_count;
 
     //devices
-    Uint32                      device_count;
-    VkPhysicalDevice           *devices;
     VkPhysicalDevice            gpu;
     Bool                        logicalDeviceCreated;
     
@@ -55,6 +66,8 @@ typedef struct
     
     VkSemaphore                 imageAvailableSemaphore;
     VkSemaphore                 renderFinishedSemaphore;
+    Uint32                      inFlightFenceCount;
+    VkFence                    *inFlightFences;         // one per swap chain image
     
     Pipeline                   *pipe;
 }vGraphics;
@@ -66,7 +79,8 @@ void gf3d_vgraphics_logical_device_close();
 void gf3d_vgraphics_extension_init();
 void gf3d_vgraphics_setup_debug();
 void gf3d_vgraphics_semaphores_create();
-VkPhysicalDevice gf3d_vgraphics_select_device();
+void gf3d_vgraphics_fences_create(Uint32 count);
+VkPhysicalDevice gf3d_vgraphics_select_device(VkPhysicalDevice *devices,Uint32 deviceCount);
 VkDeviceCreateInfo gf3d_vgraphics_get_device_info(Bool enableValidationLayers);
 void gf3d_vgraphics_debug_close();
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT callback, const VkAllocationCallbacks* pAllocator);
@@ -90,6 +104,8 @@ void gf3d_vgraphics_init(
 {
     VkDevice device;
 
+    GF3D_TRACE_BEGIN("gf3d_vgraphics_init");
+    GF3D_TRACE_BEGIN("gf3d_vgraphics_setup");
     gf3d_vgraphics_setup(
         windowName,
         renderWidth,
@@ -97,18 +113,41 @@ void gf3d_vgraphics_init(
         bgcolor,
         fullscreen,
         enableValidation);
+    GF3D_TRACE_END();
     
     device = gf3d_vgraphics_get_default_logical_device();
     
-    gf3d_pipeline_init(2);
+    GF3D_TRACE_BEGIN("subsystems init");
+    gf3d_descriptors_init(device,gf3d_swapchain_get_frame_buffer_count(),64);
+    
+    gf3d_camera_init(8);
+    
+    gf3d_uniforms_init(device,gf3d_swapchain_get_frame_buffer_count(),1024);
+    
+    gf3d_mesh_init(256);
+    
+    gf3d_batch_init(gf3d_swapchain_get_frame_buffer_count(),65536,256);
+    
+    gf3d_render_queue_init(1024);
     
-    gf3d_vgraphics.pipe = gf3d_pipeline_graphics_load(device,"shaders/vert.spv","shaders/frag.spv",gf3d_vgraphics_get_view_extent());
+    gf3d_pipeline_init(8);
+    
+    gf3d_indirect_init(device,gf3d_swapchain_get_frame_buffer_count(),65536,256,"shaders/cull.spv");
+    
+    gf3d_render_graph_init(device,16,16);
+    GF3D_TRACE_END();
+    
+    gf3d_vgraphics.pipe = gf3d_pipeline_graphics_load(device,"shaders/vert.spv","shaders/frag.spv");
 
+    GF3D_TRACE_BEGIN("frame resources create");
     gf3d_swapchain_setup_frame_buffers(gf3d_vgraphics.pipe);
 
-    gf3d_command_pool_setup(device,gf3d_swapchain_get_frame_buffer_count(),gf3d_vgraphics.pipe);
+    gf3d_command_pool_setup(device,gf3d_swapchain_get_frame_buffer_count());
     
     gf3d_vgraphics_semaphores_create();
+    gf3d_vgraphics_fences_create(gf3d_swapchain_get_frame_buffer_count());
+    GF3D_TRACE_END();
+    GF3D_TRACE_END();
 }
 
 
@@ -125,10 +164,14 @@ void gf3d_vgraphics_setup(
     Uint32 i;
     Uint32 enabledExtensionCount = 0;
     VkDeviceCreateInfo createInfo = {0};
+    VkResult result;
+    Uint32 deviceCount = 0;
+    VkPhysicalDevice *devices;
+    MemoryScratch scratch;
     
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
     {
-        slog("Unable to initilaize SDL system: %s",SDL_GetError());
+        slog_error("Unable to initilaize SDL system: %s",SDL_GetError());
         return;
     }
     atexit(SDL_Quit);
@@ -143,15 +186,17 @@ void gf3d_vgraphics_setup(
             flags |= SDL_WINDOW_FULLSCREEN;
         }
     }
+    GF3D_TRACE_BEGIN("create window");
     gf3d_vgraphics.main_window = SDL_CreateWindow(windowName,
                              SDL_WINDOWPOS_UNDEFINED,
                              SDL_WINDOWPOS_UNDEFINED,
                              renderWidth, renderHeight,
                              flags);
+    GF3D_TRACE_END();
 
     if (!gf3d_vgraphics.main_window)
     {
-        slog("failed to create main window: %s",SDL_GetError());
+        slog_error("failed to create main window: %s",SDL_GetError());
         gf3d_vgraphics_close();
         exit(0);
         return;
@@ -164,18 +209,18 @@ void gf3d_vgraphics_setup(
     SDL_Vulkan_GetInstanceExtensions(gf3d_vgraphics.main_window, &(gf3d_vgraphics.sdl_extension_count), NULL);
     if (gf3d_vgraphics.sdl_extension_count > 0)
     {
-        gf3d_vgraphics.sdl_extension_names = gf3d_allocate_array(sizeof(const char *),gf3d_vgraphics.sdl_extension_count);
+        gf3d_vgraphics.sdl_extension_names = gf3d_memory_allocate(MT_Graphics,sizeof(const char *),gf3d_vgraphics.sdl_extension_count);
         
         SDL_Vulkan_GetInstanceExtensions(gf3d_vgraphics.main_window, &(gf3d_vgraphics.sdl_extension_count), gf3d_vgraphics.sdl_extension_names);
         for (i = 0; i < gf3d_vgraphics.sdl_extension_count;i++)
         {
-            slog("SDL Vulkan extensions support: %s",gf3d_vgraphics.sdl_extension_names[i]);
+            slog_debug("SDL Vulkan extensions support: %s",gf3d_vgraphics.sdl_extension_names[i]);
             gf3d_extensions_enable(ET_Instance, gf3d_vgraphics.sdl_extension_names[i]);
         }
     }
     else
     {
-        slog("SDL / Vulkan not supported");
+        slog_error("SDL / Vulkan not supported");
         gf3d_vgraphics_close();
         exit(0);
         return;
@@ -213,11 +258,13 @@ void gf3d_vgraphics_setup(
     gf3d_vgraphics.vk_instance_info.enabledExtensionCount = enabledExtensionCount;
 
     // create instance
+    GF3D_TRACE_BEGIN("create instance");
     vkCreateInstance(&gf3d_vgraphics.vk_instance_info, NULL, &gf3d_vgraphics.vk_instance);
+    GF3D_TRACE_END();
 
     if (!gf3d_vgraphics.vk_instance)
     {
-        slog("failed to create a vulkan instance");
+        slog_error("failed to create a vulkan instance");
         gf3d_vgraphics_close();
         return;
     }
@@ -229,21 +276,28 @@ void gf3d_vgraphics_setup(
     atexit(gf3d_vgraphics_close);
     
     //get a gpu to do work with
-    vkEnumeratePhysicalDevices(gf3d_vgraphics.vk_instance, &gf3d_vgraphics.device_count, NULL);
-    slog("vulkan discovered %i device(s) with this instance",gf3d_vgraphics.device_count);
-    if (!gf3d_vgraphics.device_count)
+    vkEnumeratePhysicalDevices(gf3d_vgraphics.vk_instance, &deviceCount, NULL);
+    slog_debug("vulkan discovered %i device(s) with this instance",deviceCount);
+    if (!deviceCount)
     {
-        slog("failed to create a vulkan instance with a usable device");
+        slog_error("failed to create a vulkan instance with a usable device");
         gf3d_vgraphics_close();
         return;
     }
 
-    gf3d_vgraphics.devices = (VkPhysicalDevice *)malloc(sizeof(VkPhysicalDevice)*gf3d_vgraphics.device_count);
-    vkEnumeratePhysicalDevices(gf3d_vgraphics.vk_instance, &gf3d_vgraphics.device_count, gf3d_vgraphics.devices);
+    scratch = gf3d_scratch_begin();
+    devices = (VkPhysicalDevice *)gf3d_arena_allocate_array(scratch.arena,sizeof(VkPhysicalDevice),deviceCount);
+    if (devices)
+    {
+        vkEnumeratePhysicalDevices(gf3d_vgraphics.vk_instance, &deviceCount, devices);
     
-    gf3d_vgraphics.gpu = gf3d_vgraphics_select_device();
+        GF3D_TRACE_BEGIN("select device");
+        gf3d_vgraphics.gpu = gf3d_vgraphics_select_device(devices,deviceCount);
+        GF3D_TRACE_END();
+    }
+    gf3d_scratch_end(scratch);
     if(!gf3d_vgraphics.gpu){
-        slog("Failed to select graphics card. If using integrated graphics, change variable in h file.");
+        slog_error("Failed to select graphics card. If using integrated graphics, change variable in h file.");
         gf3d_vgraphics_close();
         return;
     }
@@ -261,15 +315,20 @@ void gf3d_vgraphics_setup(
 
     createInfo = gf3d_vgraphics_get_device_info(enableValidation);
     
-    if (vkCreateDevice(gf3d_vgraphics.gpu, &createInfo, NULL, &gf3d_vgraphics.device) != VK_SUCCESS)
+    GF3D_TRACE_BEGIN("create logical device");
+    result = vkCreateDevice(gf3d_vgraphics.gpu, &createInfo, NULL, &gf3d_vgraphics.device);
+    GF3D_TRACE_END();
+    if (result != VK_SUCCESS)
     {
-        slog("failed to create logical device");
+        slog_error("failed to create logical device");
         gf3d_vgraphics_close();
         return;
     }
     gf3d_vgraphics.logicalDeviceCreated = true;
     
     gf3d_vqueues_setup_device_queues(gf3d_vgraphics.device);
+    
+    gf3d_buffers_init(gf3d_vgraphics.gpu,gf3d_vgraphics.device);
 
     // swap chain!!!
     gf3d_swapchain_init(gf3d_vgraphics.gpu,gf3d_vgraphics.device,gf3d_vgraphics.surface,renderWidth,renderHeight);
@@ -277,19 +336,15 @@ void gf3d_vgraphics_setup(
 
 void gf3d_vgraphics_close()
 {
-    slog("cleaning up vulkan graphics");
+    slog_debug("cleaning up vulkan graphics");
     gf3d_vgraphics_debug_close();
     if (gf3d_vgraphics.logicalDeviceCreated)
     {
         vkDestroyDevice(gf3d_vgraphics.device, NULL);
     }
-    if (gf3d_vgraphics.devices)
-    {
-        free(gf3d_vgraphics.devices);
-    }
     if (gf3d_vgraphics.sdl_extension_names)
     {
-        free(gf3d_vgraphics.sdl_extension_names);
+        gf3d_memory_free(gf3d_vgraphics.sdl_extension_names);
     }
     if(gf3d_vgraphics.surface && gf3d_vgraphics.vk_instance)
     {
@@ -351,7 +406,9 @@ VkDeviceCreateInfo gf3d_vgraphics_get_device_info(Bool enableValidationLayers)
 
 void gf3d_vgraphics_clear()
 {
-    
+    gf3d_memory_begin_frame();
+    gf3d_batch_begin();
+    gf3d_render_queue_begin();
 }
 
 void gf3d_vgraphics_render()
@@ -363,14 +420,17 @@ void gf3d_vgraphics_render()
     VkSemaphore signalSemaphores[] = {gf3d_vgraphics.renderFinishedSemaphore};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSwapchainKHR swapChains[1] = {0};
+    VkFence frameFence = VK_NULL_HANDLE;
 
     /*
     Acquire an image from the swap chain
     Execute the command buffer with that image as attachment in the framebuffer
     Return the image to the swap chain for presentation
     */
+    GF3D_TRACE_BEGIN("gf3d_vgraphics_render");
     swapChains[0] = gf3d_swapchain_get();
     
+    GF3D_TRACE_BEGIN("acquire image");
     vkAcquireNextImageKHR(
         gf3d_vgraphics.device,
         swapChains[0],
@@ -378,7 +438,29 @@ void gf3d_vgraphics_render()
         gf3d_vgraphics.imageAvailableSemaphore,
         VK_NULL_HANDLE,
         &imageIndex);
+    GF3D_TRACE_END();
+    GF3D_TRACE_COUNTER("swap image",imageIndex);
     
+    if (imageIndex < gf3d_vgraphics.inFlightFenceCount)
+    {
+        // the last submission that drew into this image must finish before its per frame resources are reused
+        GF3D_TRACE_BEGIN("wait frame fence");
+        vkWaitForFences(gf3d_vgraphics.device, 1, &gf3d_vgraphics.inFlightFences[imageIndex], VK_TRUE, UINT64_MAX);
+        vkResetFences(gf3d_vgraphics.device, 1, &gf3d_vgraphics.inFlightFences[imageIndex]);
+        frameFence = gf3d_vgraphics.inFlightFences[imageIndex];
+        GF3D_TRACE_END();
+    }
+    GF3D_TRACE_BEGIN("frame update");
+    gf3d_descriptors_begin_frame(imageIndex);
+    gf3d_uniforms_update(imageIndex);
+    gf3d_batch_end(imageIndex);
+    gf3d_render_queue_end();
+    gf3d_indirect_update(imageIndex);
+    GF3D_TRACE_END();
+    GF3D_TRACE_BEGIN("record commands");
+    gf3d_command_buffer_record(imageIndex,gf3d_vgraphics.pipe);
+    GF3D_TRACE_END();
+
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
     submitInfo.waitSemaphoreCount = 1;
@@ -390,10 +472,13 @@ void gf3d_vgraphics_render()
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
     
-    if (vkQueueSubmit(gf3d_vqueues_get_graphics_queue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    GF3D_TRACE_BEGIN("submit");
+    if (vkQueueSubmit(gf3d_vqueues_get_graphics_queue(), 1, &submitInfo, frameFence) != VK_SUCCESS)
     {
-        slog("failed to submit draw command buffer!");
+        slog_error("failed to submit draw command buffer!");
+        GF3D_TRACE_INSTANT("submit failed");
     }
+    GF3D_TRACE_END();
     
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -405,7 +490,10 @@ void gf3d_vgraphics_render()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = NULL; // Optional
     
+    GF3D_TRACE_BEGIN("present");
     vkQueuePresentKHR(gf3d_vqueues_get_present_queue(), &presentInfo);
+    GF3D_TRACE_END();
+    GF3D_TRACE_END();
 }
 
 /**
@@ -420,25 +508,31 @@ Bool gf3d_vgraphics_device_validate(VkPhysicalDevice device)
     vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-    slog("Device Name: %s",deviceProperties.deviceName);
-    slog("Dedicated GPU: %i",(deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)?1:0);
-    slog("apiVersion: %i",deviceProperties.apiVersion);
-    slog("driverVersion: %i",deviceProperties.driverVersion);
-    slog("supports Geometry Shader: %i",deviceFeatures.geometryShader);
+    slog_info("Device Name: %s",deviceProperties.deviceName);
+    slog_debug("Dedicated GPU: %i",(deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)?1:0);
+    slog_debug("apiVersion: %i",deviceProperties.apiVersion);
+    slog_debug("driverVersion: %i",deviceProperties.driverVersion);
+    slog_debug("supports Geometry Shader: %i",deviceFeatures.geometryShader);
     return (deviceProperties.deviceType == GF3D_VGRAPHICS_DISCRETE)&&(deviceFeatures.geometryShader);
 }
 
-VkPhysicalDevice gf3d_vgraphics_select_device()
+VkPhysicalDevice gf3d_vgraphics_select_device(VkPhysicalDevice *devices,Uint32 deviceCount)
 {
     int i;
     VkPhysicalDevice chosen = VK_NULL_HANDLE;
-    for (i = 0; i < gf3d_vgraphics.device_count; i++)
+    for (i = 0; i < deviceCount; i++)
     {
-        if (gf3d_vgraphics_device_validate(gf3d_vgraphics.devices[i]))
+        if (gf3d_vgraphics_device_validate(devices[i]))
         {
-            chosen = gf3d_vgraphics.devices[i];
+            chosen = devices[i];
         }
     }
+    if ((chosen == VK_NULL_HANDLE)&&(deviceCount > 0))
+    {
+        // no preferred device, fall back to whatever is there so integrated and software drivers still run
+        slog_warn("no device matched the preferred type, using the first device found");
+        chosen = devices[0];
+    }
 
     return chosen;
 }
@@ -454,8 +548,11 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL gf3d_vgraphics_debug_parse(
     const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
     void* pUserData)
 {
-    //setting this up to always log the message, but this can be adjusted later
-    slog("VULKAN DEBUG [%i]:%s",messageSeverity,pCallbackData->pMessage);
+    // map onto the log levels, so the vgraphics filter decides what gets through
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)slog_error("VULKAN DEBUG [%i]:%s",messageSeverity,pCallbackData->pMessage);
+    else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)slog_warn("VULKAN DEBUG [%i]:%s",messageSeverity,pCallbackData->pMessage);
+    else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)slog_debug("VULKAN DEBUG [%i]:%s",messageSeverity,pCallbackData->pMessage);
+    else slog_trace("VULKAN DEBUG [%i]:%s",messageSeverity,pCallbackData->pMessage);
     return VK_FALSE;
 }
 
@@ -526,9 +623,51 @@ void gf3d_vgraphics_semaphores_create()
     if ((vkCreateSemaphore(gf3d_vgraphics.device, &semaphoreInfo, NULL, &gf3d_vgraphics.imageAvailableSemaphore) != VK_SUCCESS) ||
         (vkCreateSemaphore(gf3d_vgraphics.device, &semaphoreInfo, NULL, &gf3d_vgraphics.renderFinishedSemaphore) != VK_SUCCESS))
     {
-        slog("failed to create semaphores!");
+        slog_error("failed to create semaphores!");
     }
     atexit(gf3d_vgraphics_semaphores_close);
 }
+
+void gf3d_vgraphics_fences_close()
+{
+    int i;
+    if (gf3d_vgraphics.inFlightFences)
+    {
+        for (i = 0; i < gf3d_vgraphics.inFlightFenceCount; i++)
+        {
+            vkDestroyFence(gf3d_vgraphics.device, gf3d_vgraphics.inFlightFences[i], NULL);
+        }
+        gf3d_memory_free(gf3d_vgraphics.inFlightFences);
+        gf3d_vgraphics.inFlightFences = NULL;
+    }
+    gf3d_vgraphics.inFlightFenceCount = 0;
+}
+
+void gf3d_vgraphics_fences_create(Uint32 count)
+{
+    int i;
+    VkFenceCreateInfo fenceInfo = {0};
+    
+    if (!count)return;
+    gf3d_vgraphics.inFlightFences = (VkFence *)gf3d_memory_allocate(MT_Graphics,sizeof(VkFence),count);
+    if (!gf3d_vgraphics.inFlightFences)
+    {
+        slog_error("failed to allocate frame fences");
+        return;
+    }
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;     // nothing is in flight yet
+    
+    for (i = 0; i < count; i++)
+    {
+        if (vkCreateFence(gf3d_vgraphics.device, &fenceInfo, NULL, &gf3d_vgraphics.inFlightFences[i]) != VK_SUCCESS)
+        {
+            slog_error("failed to create frame fence!");
+            break;
+        }
+    }
+    gf3d_vgraphics.inFlightFenceCount = i;
+    atexit(gf3d_vgraphics_fences_close);
+}
 /*eol@eof*/
 
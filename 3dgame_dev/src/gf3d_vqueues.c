@@ -1,6 +1,9 @@
+#define SLOG_CATEGORY "vqueues"
+
 #include "gf3d_vqueues.h"
 #include "gf3d_vector.h"
 #include "simple_logger.h"
+#include "gf3d_memory.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -9,7 +12,6 @@ typedef struct
 {
     VkDeviceQueueCreateInfo     queue_info;
     Uint32                      queue_family_count;
-    VkQueueFamilyProperties    *queue_properties;
     VkQueue                     device_queue;
     Sint32                      graphics_queue_family;
     Sint32                      present_queue_family;
@@ -32,6 +34,8 @@ void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
 {
     Uint32 i;
     VkBool32 supported;
+    MemoryScratch scratch;
+    VkQueueFamilyProperties *queue_properties;
 
     gf3d_vqueues.graphics_queue_family = -1;
     gf3d_vqueues.present_queue_family = -1;
@@ -43,60 +47,69 @@ void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
     
     if (!gf3d_vqueues.queue_family_count)
     {
-        slog("failed to get any queue properties");
+        slog_error("failed to get any queue properties");
         gf3d_vqueues_close();
         return;
     }
     
-    gf3d_vqueues.queue_properties = (VkQueueFamilyProperties*)gf3d_allocate_array(sizeof(VkQueueFamilyProperties),gf3d_vqueues.queue_family_count);
+    // the properties are only needed to pick the families
+    scratch = gf3d_scratch_begin();
+    queue_properties = (VkQueueFamilyProperties*)gf3d_arena_allocate_array(scratch.arena,sizeof(VkQueueFamilyProperties),gf3d_vqueues.queue_family_count);
+    if (!queue_properties)
+    {
+        gf3d_scratch_end(scratch);
+        gf3d_vqueues_close();
+        return;
+    }
     
     vkGetPhysicalDeviceQueueFamilyProperties(
         device,
         &gf3d_vqueues.queue_family_count,
-        gf3d_vqueues.queue_properties);
+        queue_properties);
     
-    slog("discoverd %i queue family properties",gf3d_vqueues.queue_family_count);
+    slog_debug("discoverd %i queue family properties",gf3d_vqueues.queue_family_count);
     for (i = 0; i < gf3d_vqueues.queue_family_count; i++)
     {
-        slog("Queue family %i:",i);
-        slog("queue flag bits %i",gf3d_vqueues.queue_properties[i].queueFlags);
-        slog("queue count %i",gf3d_vqueues.queue_properties[i].queueCount);
-        slog("queue timestamp valid bits %i",gf3d_vqueues.queue_properties[i].timestampValidBits);
-        slog("queue min image transfer granularity %iw %ih %id",
-             gf3d_vqueues.queue_properties[i].minImageTransferGranularity.width,
-             gf3d_vqueues.queue_properties[i].minImageTransferGranularity.height,
-             gf3d_vqueues.queue_properties[i].minImageTransferGranularity.depth);
+        slog_debug("Queue family %i:",i);
+        slog_debug("queue flag bits %i",queue_properties[i].queueFlags);
+        slog_debug("queue count %i",queue_properties[i].queueCount);
+        slog_debug("queue timestamp valid bits %i",queue_properties[i].timestampValidBits);
+        slog_debug("queue min image transfer granularity %iw %ih %id",
+             queue_properties[i].minImageTransferGranularity.width,
+             queue_properties[i].minImageTransferGranularity.height,
+             queue_properties[i].minImageTransferGranularity.depth);
         vkGetPhysicalDeviceSurfaceSupportKHR(
             device,
             i,
             surface,
             &supported);
-        if (gf3d_vqueues.queue_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (queue_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
         {
             gf3d_vqueues.graphics_queue_family = i;
             gf3d_vqueues.graphics_queue_priority = 1.0f;
-            slog("Queue handles graphics calls");
+            slog_debug("Queue handles graphics calls");
         }
         if (supported)
         {
             gf3d_vqueues.present_queue_family = i;
             gf3d_vqueues.present_queue_priority = 1.0f;
-            slog("Queue handles present calls");
+            slog_debug("Queue handles present calls");
         }
     }
-    slog("using queue family %i for graphics commands",gf3d_vqueues.graphics_queue_family);
-    slog("using queue family %i for rendering pipeline",gf3d_vqueues.present_queue_family);
+    gf3d_scratch_end(scratch);
+    slog_debug("using queue family %i for graphics commands",gf3d_vqueues.graphics_queue_family);
+    slog_debug("using queue family %i for rendering pipeline",gf3d_vqueues.present_queue_family);
     
     if (gf3d_vqueues.graphics_queue_family != -1)gf3d_vqueues.work_queue_count++;
     if ((gf3d_vqueues.present_queue_family != -1) && (gf3d_vqueues.present_queue_family != gf3d_vqueues.graphics_queue_family))gf3d_vqueues.work_queue_count++;
 
     if (!gf3d_vqueues.work_queue_count)
     {
-        slog("No suitable queues for graphics calls or presentation");
+        slog_error("No suitable queues for graphics calls or presentation");
     }
     else
     {
-        gf3d_vqueues.queue_create_info = (VkDeviceQueueCreateInfo*)gf3d_allocate_array(sizeof(VkDeviceQueueCreateInfo),gf3d_vqueues.work_queue_count);
+        gf3d_vqueues.queue_create_info = (VkDeviceQueueCreateInfo*)gf3d_memory_allocate(MT_Graphics,sizeof(VkDeviceQueueCreateInfo),gf3d_vqueues.work_queue_count);
         i = 0;
         if (gf3d_vqueues.graphics_queue_family != -1)
         {
@@ -151,21 +164,17 @@ void gf3d_vqueues_setup_device_queues(VkDevice device)
 
 void gf3d_vqueues_close()
 {
-    slog("cleaning up vulkan queues");
+    slog_debug("cleaning up vulkan queues");
     if (gf3d_vqueues.queue_create_info)
     {
-        free(gf3d_vqueues.queue_create_info);
-    }
-    if (gf3d_vqueues.queue_properties)
-    {
-        free(gf3d_vqueues.queue_properties);
+        gf3d_memory_free(gf3d_vqueues.queue_create_info);
     }
     memset(&gf3d_vqueues,0,sizeof(vQueues));
 }
 
 void gf3d_vqueues_create_presentation_queues()
 {
-    gf3d_vqueues.presentation_queue_info = (VkDeviceQueueCreateInfo*)gf3d_allocate_array(sizeof(VkDeviceQueueCreateInfo),gf3d_vqueues.queue_family_count);
+    gf3d_vqueues.presentation_queue_info = (VkDeviceQueueCreateInfo*)gf3d_memory_allocate(MT_Graphics,sizeof(VkDeviceQueueCreateInfo),gf3d_vqueues.queue_family_count);
 }
 
 Sint32 gf3d_vqueues_get_graphics_queue_family()
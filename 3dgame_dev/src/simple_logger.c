@@ -2,57 +2,417 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
 
-static FILE * __log_file = NULL;
-static int dirty = 0;
+#ifdef _MSC_VER
+#define SLOG_THREAD_LOCAL __declspec(thread)
+#else
+#define SLOG_THREAD_LOCAL __thread
+#endif
+
+#define SLOG_QUEUE_SIZE 4096    /**<messages the queue holds, a power of two*/
+#define SLOG_QUEUE_MASK (SLOG_QUEUE_SIZE - 1)
+#define SLOG_IDLE_WAIT  10      /**<ms the writer sleeps when there is nothing to do*/
+#define SLOG_WAKE_BATCH 256     /**<producers only wake a sleeping writer this often, waking it per message costs more than the format*/
+
+typedef struct
+{
+    SDL_atomic_t    sequence;   /**<equals the queue position when free, position + 1 once written*/
+    unsigned int    length;
+    char            text[SLOG_MESSAGE_MAX];
+}LogRecord;
+
+typedef struct
+{
+    FILE           *file;
+    LogRecord      *queue;
+    SDL_atomic_t    head;           /**<next position a producer will claim*/
+    Uint32          tail;           /**<next position the writer reads, only the writer touches it*/
+    SDL_atomic_t    idle;           /**<the writer is, or is about to be, waiting for work*/
+    SDL_atomic_t    running;
+    SDL_atomic_t    dropped;
+    SDL_atomic_t    truncated;
+    Uint32          droppedReported;
+    SDL_Thread     *thread;
+    SDL_sem        *wake;
+    SDL_mutex      *syncLock;
+    SDL_cond       *synced;
+    SDL_atomic_t    syncPending;    /**<a slog_sync call is waiting*/
+    Uint32          syncTarget;     /**<the furthest queue position a waiting slog_sync needs written*/
+    Uint32          flushed;        /**<every position before this is written and flushed*/
+}Logger;
+
+static Logger __logger = {0};
+
+#define SLOG_CATEGORY_MAX 64
+
+/**
+ * @brief categories live outside the logger: call sites keep pointers to them, and log before init and after cleanup
+ */
+static SlogCategory __slog_categories[SLOG_CATEGORY_MAX];
+static SlogCategory __slog_category_overflow = {"",SLOG_INFO,0};
+static int          __slog_category_count = 0;
+static int          __slog_default_level = SLOG_INFO;
+static SDL_SpinLock __slog_categories_lock = 0;
+
+static const char *__slog_level_names[] = {"trace","debug","info","warn","error","none"};
+static const char *__slog_level_tags[] = {"trace: ","debug: ","","warning: ","error: "};
+
+/**
+ * @brief per thread scratch, so formatting never contends
+ */
+static SLOG_THREAD_LOCAL char __slog_buffer[SLOG_MESSAGE_MAX];
+
+/**
+ * @brief write one message to stdout and the log file
+ */
+static void slog_write(const char *text,unsigned int length)
+{
+    /*echo all logging to stdout*/
+    fwrite(text,1,length,stdout);
+    fputs("\n\n",stdout);
+    if (__logger.file != NULL)
+    {
+        fwrite(text,1,length,__logger.file);
+        fputc('\n',__logger.file);
+    }
+}
+
+static void slog_flush()
+{
+    fflush(stdout);
+    if (__logger.file != NULL)fflush(__logger.file);
+}
+
+/**
+ * @brief write everything the producers have finished queueing, in order
+ * @return how many messages were written
+ */
+static Uint32 slog_drain()
+{
+    LogRecord *record;
+    Uint32 count = 0;
+    Uint32 dropped;
+    int length;
+    char note[128];
+    for (;;)
+    {
+        record = &__logger.queue[__logger.tail & SLOG_QUEUE_MASK];
+        if ((Sint32)((Uint32)SDL_AtomicGet(&record->sequence) - (__logger.tail + 1)) < 0)break;
+        slog_write(record->text,record->length);
+        SDL_AtomicSet(&record->sequence,__logger.tail + SLOG_QUEUE_SIZE);
+        __logger.tail++;
+        count++;
+    }
+    dropped = SDL_AtomicGet(&__logger.dropped);
+    if (dropped != __logger.droppedReported)
+    {
+        length = snprintf(note,sizeof(note),"simple_logger: %u messages dropped, the queue was full",dropped - __logger.droppedReported);
+        slog_write(note,length);
+        __logger.droppedReported = dropped;
+    }
+    return count;
+}
+
+/**
+ * @brief the background writer: drain the queue, answer slog_sync calls and sleep when there is nothing to do
+ */
+static int slog_thread(void *data)
+{
+    Uint32 written,wait;
+    int dirty = 0;
+    for (;;)
+    {
+        written = slog_drain();
+        if (written)dirty = 1;
+        wait = SLOG_IDLE_WAIT;
+        if (SDL_AtomicGet(&__logger.syncPending))
+        {
+            SDL_LockMutex(__logger.syncLock);
+            if ((Sint32)(__logger.tail - __logger.syncTarget) >= 0)
+            {
+                slog_flush();
+                dirty = 0;
+                __logger.flushed = __logger.tail;
+                SDL_AtomicSet(&__logger.syncPending,0);
+                SDL_CondBroadcast(__logger.synced);
+            }
+            else wait = 1;  // a producer claimed a slot and has not filled it yet
+            SDL_UnlockMutex(__logger.syncLock);
+        }
+        if (written)continue;
+        if (dirty)
+        {
+            // out of work: a good time to get the log onto disk
+            slog_flush();
+            dirty = 0;
+        }
+        if (!SDL_AtomicGet(&__logger.running))break;
+        SDL_AtomicSet(&__logger.idle,1);
+        SDL_SemWaitTimeout(__logger.wake,wait);
+        SDL_AtomicSet(&__logger.idle,0);
+    }
+    slog_drain();
+    slog_flush();
+    return 0;
+}
 
 void close_logger()
 {
-    if (__log_file != NULL)
+    if (__logger.thread != NULL)
     {
-        fclose(__log_file);
-        __log_file = NULL;
+        SDL_AtomicSet(&__logger.running,0);
+        SDL_SemPost(__logger.wake);
+        SDL_WaitThread(__logger.thread,NULL);
+        __logger.thread = NULL;
     }
+    if (__logger.synced != NULL)SDL_DestroyCond(__logger.synced);
+    if (__logger.syncLock != NULL)SDL_DestroyMutex(__logger.syncLock);
+    if (__logger.wake != NULL)SDL_DestroySemaphore(__logger.wake);
+    if (__logger.queue != NULL)free(__logger.queue);
+    if (__logger.file != NULL)fclose(__logger.file);
+    memset(&__logger,0,sizeof(Logger));
 }
 
 void init_logger(const char *log_file_path)
 {
+    int i;
+    if (__logger.file != NULL)return;
     if (log_file_path == NULL)
     {
-        __log_file = fopen("output.log","a");
+        __logger.file = fopen("output.log","a");
     }
     else
     {
-        __log_file = fopen(log_file_path,"a");
+        __logger.file = fopen(log_file_path,"a");
     }
     atexit(close_logger);
+    if (getenv("SLOG_FILTER"))slog_configure(getenv("SLOG_FILTER"));
+    __logger.queue = (LogRecord *)malloc(sizeof(LogRecord) * SLOG_QUEUE_SIZE);
+    __logger.wake = SDL_CreateSemaphore(0);
+    __logger.syncLock = SDL_CreateMutex();
+    __logger.synced = SDL_CreateCond();
+    if ((!__logger.queue)||(!__logger.wake)||(!__logger.syncLock)||(!__logger.synced))
+    {
+        slog_error("simple_logger: failed to set up the log queue, logging synchronously");
+        return;
+    }
+    for (i = 0; i < SLOG_QUEUE_SIZE; i++)
+    {
+        SDL_AtomicSet(&__logger.queue[i].sequence,i);
+    }
+    SDL_AtomicSet(&__logger.running,1);
+    __logger.thread = SDL_CreateThread(slog_thread,"simple_logger",NULL);
+    if (__logger.thread == NULL)
+    {
+        slog_error("simple_logger: failed to start the log thread, logging synchronously: %s",SDL_GetError());
+    }
+}
+
+/**
+ * @brief format a message and queue it for the writer
+ */
+static void slog_queue(int level,char *f,int l,char *msg,va_list ap)
+{
+    int length,prefix;
+    Sint32 difference;
+    Uint32 position;
+    LogRecord *record;
+
+    prefix = snprintf(__slog_buffer,SLOG_MESSAGE_MAX,"%s:%i: %s",f,l,__slog_level_tags[level]);
+    if ((prefix < 0)||(prefix >= SLOG_MESSAGE_MAX))prefix = 0;
+    length = vsnprintf(__slog_buffer + prefix,SLOG_MESSAGE_MAX - prefix,msg,ap);
+    if (length < 0)length = 0;
+    length += prefix;
+    if (length >= SLOG_MESSAGE_MAX)
+    {
+        SDL_AtomicIncRef(&__logger.truncated);
+        length = SLOG_MESSAGE_MAX - 1;
+    }
+    if (__logger.thread == NULL)
+    {
+        slog_write(__slog_buffer,length);
+        return;
+    }
+    // claim a slot: a slot is free for a position when its sequence equals that position
+    position = SDL_AtomicGet(&__logger.head);
+    for (;;)
+    {
+        record = &__logger.queue[position & SLOG_QUEUE_MASK];
+        difference = (Sint32)((Uint32)SDL_AtomicGet(&record->sequence) - position);
+        if (difference == 0)
+        {
+            if (SDL_AtomicCAS(&__logger.head,position,position + 1))break;
+        }
+        else if (difference < 0)
+        {
+            // the writer has not got to this slot's last message yet: the queue is full
+            SDL_AtomicIncRef(&__logger.dropped);
+            return;
+        }
+        position = SDL_AtomicGet(&__logger.head);
+    }
+    memcpy(record->text,__slog_buffer,length);
+    record->length = length;
+    SDL_AtomicSet(&record->sequence,position + 1);
+    if (((position & (SLOG_WAKE_BATCH - 1)) == 0)&&(SDL_AtomicGet(&__logger.idle))&&(SDL_AtomicCAS(&__logger.idle,1,0)))
+    {
+        SDL_SemPost(__logger.wake);
+    }
 }
 
 void _slog(char *f,int l,char *msg,...)
 {
     va_list ap;
-    dirty = 1;
-    /*echo all logging to stdout*/
     va_start(ap,msg);
-    fprintf(stdout,"%s:%i: ",f,l);
-    vfprintf(stdout,msg,ap);
-    fprintf(stdout,"\n");
+    slog_queue(SLOG_INFO,f,l,msg,ap);
+    va_end(ap);
+}
+
+void _slog_level(int level,char *f,int l,char *msg,...)
+{
+    va_list ap;
+    if ((level < SLOG_TRACE)||(level > SLOG_ERROR))level = SLOG_ERROR;
+    va_start(ap,msg);
+    slog_queue(level,f,l,msg,ap);
     va_end(ap);
-    fprintf(stdout,"\n");
-    if (__log_file != NULL)
+}
+
+/**
+ * CATEGORIES
+ */
+
+SlogCategory *slog_category_get(const char *name)
+{
+    int i;
+    SlogCategory *category = NULL;
+    if (!name)name = "";
+    SDL_AtomicLock(&__slog_categories_lock);
+    for (i = 0; i < __slog_category_count; i++)
+    {
+        if (strcmp(__slog_categories[i].name,name) != 0)continue;
+        category = &__slog_categories[i];
+        break;
+    }
+    if ((!category)&&(__slog_category_count < SLOG_CATEGORY_MAX))
+    {
+        category = &__slog_categories[__slog_category_count++];
+        strncpy(category->name,name,SLOG_CATEGORY_NAME - 1);
+        category->level = __slog_default_level;
+    }
+    SDL_AtomicUnlock(&__slog_categories_lock);
+    if (!category)return &__slog_category_overflow;
+    return category;
+}
+
+void slog_set_level(const char *category,int level)
+{
+    int i;
+    SlogCategory *c;
+    if (level < SLOG_TRACE)level = SLOG_TRACE;
+    if (level > SLOG_NONE)level = SLOG_NONE;
+    if (category)
+    {
+        c = slog_category_get(category);
+        c->level = level;
+        c->set = 1;
+        return;
+    }
+    SDL_AtomicLock(&__slog_categories_lock);
+    __slog_default_level = level;
+    __slog_category_overflow.level = level;
+    for (i = 0; i < __slog_category_count; i++)
     {
-        va_start(ap,msg);
-        fprintf(__log_file,"%s:%i: ",f,l);
-        vfprintf(__log_file,msg,ap);
-        fprintf(__log_file,"\n");
-        va_end(ap);
+        // a level set by name wins over the default whichever order they were set in
+        if (__slog_categories[i].set)continue;
+        __slog_categories[i].level = level;
     }
+    SDL_AtomicUnlock(&__slog_categories_lock);
+}
+
+int slog_get_level(const char *category)
+{
+    if (!category)return __slog_default_level;
+    return slog_category_get(category)->level;
+}
+
+int slog_configure(const char *filter)
+{
+    int i,level;
+    const char *entry,*end,*equals;
+    char name[SLOG_CATEGORY_NAME];
+    char value[16];
+    size_t length;
+    if (!filter)return 0;
+    for (entry = filter; *entry; entry = (*end)?end + 1:end)
+    {
+        end = strchr(entry,',');
+        if (!end)end = entry + strlen(entry);
+        if (end == entry)continue;
+        equals = memchr(entry,'=',end - entry);
+        if ((!equals)||(equals == entry)||(equals - entry >= SLOG_CATEGORY_NAME)||(end - equals - 1 >= sizeof(value)))
+        {
+            slog_error("bad log filter entry '%.*s', expected category=level",(int)(end - entry),entry);
+            return 0;
+        }
+        length = equals - entry;
+        memcpy(name,entry,length);
+        name[length] = 0;
+        length = end - equals - 1;
+        memcpy(value,equals + 1,length);
+        value[length] = 0;
+        level = -1;
+        for (i = 0; i <= SLOG_NONE; i++)
+        {
+            if (strcmp(value,__slog_level_names[i]) == 0)level = i;
+        }
+        if (level < 0)
+        {
+            slog_error("bad log level '%s', expected trace, debug, info, warn, error or none",value);
+            return 0;
+        }
+        slog_set_level((strcmp(name,"*") == 0)?NULL:name,level);
+    }
+    return 1;
 }
 
 void slog_sync()
 {
-    if ((__log_file == NULL)||(!dirty))return;
-    dirty = 0;
-    fflush(__log_file);
+    Uint32 target;
+    if (__logger.thread == NULL)
+    {
+        slog_flush();
+        return;
+    }
+    SDL_LockMutex(__logger.syncLock);
+    target = SDL_AtomicGet(&__logger.head);
+    if ((!SDL_AtomicGet(&__logger.syncPending))||((Sint32)(target - __logger.syncTarget) > 0))
+    {
+        __logger.syncTarget = target;
+    }
+    SDL_AtomicSet(&__logger.syncPending,1);
+    SDL_SemPost(__logger.wake);
+    while ((Sint32)(__logger.flushed - target) < 0)
+    {
+        SDL_CondWait(__logger.synced,__logger.syncLock);
+    }
+    SDL_UnlockMutex(__logger.syncLock);
+}
+
+unsigned int slog_get_dropped()
+{
+    return SDL_AtomicGet(&__logger.dropped);
+}
+
+unsigned int slog_get_truncated()
+{
+    return SDL_AtomicGet(&__logger.truncated);
+}
+
+unsigned int slog_get_memory_usage()
+{
+    if (__logger.queue == NULL)return 0;
+    return (unsigned int)(sizeof(LogRecord) * SLOG_QUEUE_SIZE);
 }
 /*eol@eof*/